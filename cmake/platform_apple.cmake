@@ -39,4 +39,9 @@ function(set_dylib_properties)
             "-framework Security"
             "-framework SystemConfiguration"
             z)
+
+    # For the background maintenance task, which only iOS and tvOS support:
+    if(CMAKE_SYSTEM_NAME STREQUAL "iOS" OR CMAKE_SYSTEM_NAME STREQUAL "tvOS")
+        target_link_libraries(cblite PUBLIC "-weak_framework BackgroundTasks")
+    endif()
 endfunction()
@@ -23,6 +23,7 @@
 #include <functional>
 #include <cassert>
 #include <memory>
+#include <new>
 #include <utility>
 
 #if DEBUG
@@ -93,6 +94,7 @@ namespace cbl {
 
         friend class Extension;
         friend class Transaction;
+        template <class T> friend class Borrowed;
     };
 
 // Internal use only: Copy/move ctors and assignment ops that have to be declared in subclasses
@@ -105,6 +107,9 @@ public: \
     bool operator==(const CLASS &other) const     {return _ref == other._ref;} \
     bool operator!=(const CLASS &other) const     {return _ref != other._ref;} \
     C_TYPE* _cbl_nullable ref() const             {return (C_TYPE*)_ref;}\
+    /** Gives up this object's reference, without releasing it; the caller must release it. */ \
+    [[nodiscard]] C_TYPE* _cbl_nullable detach() noexcept {auto r = ref(); _ref = nullptr; return r;} \
+    template <class T> friend class Borrowed; \
 protected: \
     explicit CLASS(C_TYPE* _cbl_nullable ref)     :SUPER((CBLRefCounted*)ref) { }
 
@@ -116,6 +121,55 @@ public: \
     CLASS& operator=(const CLASS &other) noexcept {SUPER::operator=(other); return *this;} \
     CLASS& operator=(CLASS &&other) noexcept      {SUPER::operator=((SUPER&&)other); return *this;}
 
+    /** A non-owning view of a wrapper object, with the same API, that is made and destroyed
+        without retaining or releasing the underlying object. Use it to pass an object that
+        the caller keeps alive, such as a collection or a document, through code that would
+        otherwise copy it, or to wrap a C reference you don't own.
+        The view only gives const access to the object; call \ref retained to get an owning
+        wrapper for non-const methods.
+        @warning  The object must outlive the view. Copying the view's object with
+                  \ref retained makes an owning wrapper. */
+    template <class T>
+    class Borrowed {
+    public:
+        using CRef = decltype(std::declval<const T&>().ref());
+
+        Borrowed(const T &owner) noexcept               :Borrowed(owner.ref()) { }
+
+        explicit Borrowed(CRef _cbl_nullable ref) noexcept {
+            new (&_value) T();
+            static_cast<RefCounted&>(_value)._ref = (CBLRefCounted*)ref;
+        }
+
+        Borrowed(const Borrowed &other) noexcept        :Borrowed(other.ref()) { }
+
+        Borrowed& operator=(const Borrowed &other) noexcept {
+            static_cast<RefCounted&>(_value)._ref = static_cast<const RefCounted&>(other._value)._ref;
+            return *this;
+        }
+
+        ~Borrowed() noexcept {
+            static_cast<RefCounted&>(_value)._ref = nullptr;    // so the destructor won't release it
+            _value.~T();
+        }
+
+        // Only const access, so the borrowed wrapper can't be assigned or moved from, which
+        // would release or retain the object behind the view's back:
+        const T& operator*() const noexcept             {return _value;}
+        const T* operator->() const noexcept            {return &_value;}
+        operator const T&() const noexcept              {return _value;}
+
+        CRef _cbl_nullable ref() const noexcept         {return _value.ref();}
+        explicit operator bool() const noexcept         {return _value.valid();}
+
+        /** Returns an owning wrapper of the object, retaining it. */
+        [[nodiscard]] T retained() const                {return _value;}
+
+    private:
+        union { T _value; };
+    };
+
+
     /** A token representing a registered listener; instances are returned from the various
         methods that register listeners, such as \ref Database::addListener.
         When this object goes out of scope, the listener will be unregistered.
@@ -28,6 +28,7 @@
 CBL_ASSUME_NONNULL_BEGIN
 
 namespace cbl {
+    class BlobMapping;
     class BlobReadStream;
     class BlobWriteStream;
 
@@ -87,6 +88,10 @@ namespace cbl {
             return content;
         }
 
+        /** Maps the blob's content into memory without copying it, if possible.
+            (See \ref CBLBlob_MapContent.) */
+        inline BlobMapping mapContent() const;
+
         /** Opens a stream for reading a blob's content. */
         inline BlobReadStream* openContentStream();
 
@@ -96,6 +101,20 @@ namespace cbl {
         CBL_REFCOUNTED_BOILERPLATE(Blob, RefCounted, CBLBlob)
     };
 
+    /** A read-only view of a blob's content in memory, returned by \ref Blob::mapContent. */
+    class BlobMapping : protected RefCounted {
+    public:
+        /** The blob's content. It's valid as long as this object (or a copy) exists. */
+        slice content() const                       {return CBLBlobMapping_Content(ref());}
+
+        /** True if the content is mapped from the blob's file rather than copied into memory. */
+        bool isMapped() const                       {return CBLBlobMapping_IsMapped(ref());}
+
+    protected:
+        friend class Blob;
+        CBL_REFCOUNTED_BOILERPLATE(BlobMapping, RefCounted, CBLBlobMapping)
+    };
+
     /** A stream for writing a new blob to the database. */
     class BlobReadStream {
     public:
@@ -122,6 +141,20 @@ namespace cbl {
             return size_t(bytesRead);
         }
 
+        /** Sets the size of the readahead buffer; 0 disables it.
+            (See \ref CBLBlobReader_SetReadahead.) */
+        void setReadahead(size_t bufferSize)        {CBLBlobReader_SetReadahead(_stream, bufferSize);}
+
+        /** Reads several ranges of the blob, without changing the stream's position.
+            @return The total number of bytes read. */
+        size_t readV(CBLBlobReadRange ranges[], size_t count) {
+            CBLError error;
+            int64_t bytesRead = CBLBlobReader_ReadV(_stream, ranges, count, &error);
+            if (bytesRead < 0)
+                throw error;
+            return size_t(bytesRead);
+        }
+
     private:
         CBLBlobReadStream* _cbl_nullable _stream {nullptr};
     };
@@ -159,6 +192,17 @@ namespace cbl {
                 throw error;
         }
 
+        /** Writes data at the given offset. Chunks may be written in any order, from any thread,
+            but must not overlap. (See \ref CBLBlobWriter_WriteAt.)
+            @param offset  The position in the blob's content at which to write the data.
+            @param src  The address of the data to write.
+            @param length  The length of the data to write. */
+        void writeAt(uint64_t offset, const void *src, size_t length) {
+            CBLError error;
+            if (!CBLBlobWriter_WriteAt(_writer, offset, src, length, &error))
+                throw error;
+        }
+
     private:
         friend class Blob;
         CBLBlobWriteStream* _cbl_nullable _writer {nullptr};
@@ -168,6 +212,14 @@ namespace cbl {
         _ref = (CBLRefCounted*) CBLBlob_CreateWithStream(contentType, writer._writer);
         writer._writer = nullptr;
     }
+
+    inline BlobMapping Blob::mapContent() const {
+        CBLError error;
+        BlobMapping mapping;
+        mapping._ref = (CBLRefCounted*) CBLBlob_MapContent(ref(), &error);
+        check(mapping._ref, error);
+        return mapping;
+    }
 }
 
 CBL_ASSUME_NONNULL_END
@@ -23,6 +23,10 @@
 #include "cbl/CBLScope.h"
 #include "fleece/Mutable.hh"
 #include <functional>
+#include <future>
+#include <ranges>
+#include <span>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -43,6 +47,11 @@ namespace cbl {
     using CollectionConflictHandler = std::function<bool(MutableDocument documentBeingSaved,
                                                          Document conflictingDocument)>;
 
+    /** Callback invoked when an asynchronous write of a document has completed.
+        The error is NULL if the document was written. */
+    using DocumentWriteCallback = std::function<void(Document document,
+                                                     const CBLError* _cbl_nullable error)>;
+
     /**
      A Collection class represent a collection which is a container for documents.
      A collection can be thought as a table in the relational database. Each collection belongs to
@@ -98,6 +107,13 @@ namespace cbl {
             @return A new \ref Document instance, or NULL if the doc doesn't exist, or throws if an error occurred. */
         inline MutableDocument getMutableDocument(slice docID) const;
 
+        /** Reads many documents from the collection in an immutable form, locking it only once.
+            (See \ref CBLCollection_GetDocuments.)
+            @param docIDs  The IDs of the documents.
+            @return The documents, in the same order as \p docIDs. A document that doesn't exist
+                    is NULL. */
+        inline std::vector<Document> getDocuments(std::span<const slice> docIDs) const;
+
         /** Saves a (mutable) document to the collection.
             @warning If a newer revision has been saved since \p doc was loaded, it will be overwritten by
                     this one. This can lead to data loss! To avoid this, call
@@ -125,6 +141,27 @@ namespace cbl {
         _cbl_warn_unused
         inline bool saveDocument(MutableDocument &doc, CollectionConflictHandler handler);
 
+        /** Saves multiple (mutable) documents to the collection in a single transaction.
+            A document that can't be saved, e.g. because of a conflict, doesn't prevent the others
+            from being saved; its failure is reported in the returned results instead.
+            @param docs  The mutable documents to save.
+            @param concurrency  Conflict-handling strategy (fail or overwrite).
+            @return The outcome of saving each document, in the same order as \p docs.
+                    A zero error code means the document was saved. */
+        inline std::vector<CBLError> saveDocuments(std::span<MutableDocument> docs,
+                                                   CBLConcurrencyControl concurrency =kCBLConcurrencyControlLastWriteWins);
+
+        /** Saves multiple (mutable) documents to the collection in a single transaction, as
+            \ref saveDocuments(std::span<MutableDocument>, CBLConcurrencyControl) does, from any
+            range of documents such as a `std::deque` or a view. The documents aren't copied.
+            @param docs  The mutable documents to save.
+            @param concurrency  Conflict-handling strategy (fail or overwrite).
+            @return The outcome of saving each document, in the order of \p docs. */
+        template <std::ranges::input_range Range>
+            requires std::is_convertible_v<std::ranges::range_reference_t<Range>, MutableDocument&>
+        std::vector<CBLError> saveDocuments(Range &&docs,
+                                            CBLConcurrencyControl concurrency =kCBLConcurrencyControlLastWriteWins);
+
         /** Deletes a document from the collection. Deletions are replicated.
             @param doc  The document to delete. */
         inline void deleteDocument(Document &doc);
@@ -136,6 +173,35 @@ namespace cbl {
         _cbl_warn_unused
         inline bool deleteDocument(Document &doc, CBLConcurrencyControl concurrency);
 
+        /** Queues a save of a (mutable) document, without waiting for it; see
+            \ref CBLCollection_SaveDocumentAsync. Throws if the save can't be queued, for example
+            with \ref kCBLErrorBusy if too many writes are already queued.
+            @param doc  The mutable document to save.
+            @param concurrency  Conflict-handling strategy (fail or overwrite).
+            @return A future that becomes true once the document is saved, false if it couldn't
+                    be because of a conflict, or holds the error if the save failed. */
+        inline std::future<bool> saveDocumentAsync(MutableDocument &doc,
+                                                   CBLConcurrencyControl concurrency =kCBLConcurrencyControlLastWriteWins);
+
+        /** Queues a save of a (mutable) document, and calls the callback on a background thread
+            once it has completed. This is the form to adapt to an event loop or coroutines.
+            @param doc  The mutable document to save.
+            @param concurrency  Conflict-handling strategy (fail or overwrite).
+            @param callback  The callback to be invoked with the outcome of the save. */
+        inline void saveDocumentAsync(MutableDocument &doc, CBLConcurrencyControl concurrency,
+                                      DocumentWriteCallback callback);
+
+        /** Queues a deletion of a document, without waiting for it.
+            See \ref Collection::saveDocumentAsync(MutableDocument &doc, CBLConcurrencyControl concurrency). */
+        inline std::future<bool> deleteDocumentAsync(Document &doc,
+                                                     CBLConcurrencyControl concurrency =kCBLConcurrencyControlLastWriteWins);
+
+        /** Queues a deletion of a document, and calls the callback on a background thread once
+            it has completed.
+            See \ref Collection::saveDocumentAsync(MutableDocument &doc, CBLConcurrencyControl concurrency, DocumentWriteCallback callback). */
+        inline void deleteDocumentAsync(Document &doc, CBLConcurrencyControl concurrency,
+                                        DocumentWriteCallback callback);
+
         /** Purges a document from the collection. This removes all traces of the document.
             Purges are _not_ replicated. If the document is changed on a server, it will be re-created
             when pulled.
@@ -176,6 +242,59 @@ namespace cbl {
             check(CBLCollection_SetDocumentExpiration(ref(), docID, expiration, &error), error);
         }
         
+        /** Purges many documents, given their IDs, in transactions of \p chunkSize.
+            (See \ref CBLCollection_PurgeDocuments.) IDs of documents that don't exist are skipped.
+            @param docIDs  The IDs of the documents to purge.
+            @param chunkSize  The number of documents to purge per transaction; 0 means 1000.
+            @return The number of documents purged. */
+        size_t purgeDocuments(std::span<const slice> docIDs, size_t chunkSize =0) {
+            size_t purged = 0;
+            CBLError error;
+            check(CBLCollection_PurgeDocuments(ref(), (const FLString*)docIDs.data(), docIDs.size(), chunkSize,
+                                               nullptr, nullptr, &purged, &error), error);
+            return purged;
+        }
+
+        /** Deletes many documents, given their IDs, in transactions of \p chunkSize.
+            (See \ref CBLCollection_DeleteDocuments.) IDs of documents that don't exist or are
+            already deleted are skipped.
+            @param docIDs  The IDs of the documents to delete.
+            @param concurrency  Whether to delete documents with unresolved conflicts.
+            @param chunkSize  The number of documents to delete per transaction; 0 means 1000.
+            @return The number of documents deleted. */
+        size_t deleteDocuments(std::span<const slice> docIDs,
+                               CBLConcurrencyControl concurrency = kCBLConcurrencyControlLastWriteWins,
+                               size_t chunkSize =0)
+        {
+            size_t deleted = 0;
+            CBLError error;
+            check(CBLCollection_DeleteDocuments(ref(), (const FLString*)docIDs.data(), docIDs.size(),
+                                                chunkSize, concurrency, nullptr, nullptr, nullptr,
+                                                &deleted, &error), error);
+            return deleted;
+        }
+
+        /** Sets or clears the expiration times of many documents, in transactions of \p chunkSize.
+            (See \ref CBLCollection_SetDocumentExpirations.) IDs of documents that don't exist are skipped.
+            @param docIDs  The IDs of the documents.
+            @param expirations  The documents' expiration times, as in \ref setDocumentExpiration;
+                                there must be one for each document ID.
+            @param chunkSize  The number of documents to update per transaction; 0 means 1000.
+            @return The number of documents updated. */
+        size_t setDocumentExpirations(std::span<const slice> docIDs,
+                                      std::span<const CBLTimestamp> expirations,
+                                      size_t chunkSize =0)
+        {
+            if (expirations.size() != docIDs.size())
+                throw std::invalid_argument("There must be one expiration per document ID");
+            size_t updated = 0;
+            CBLError error;
+            check(CBLCollection_SetDocumentExpirations(ref(), (const FLString*)docIDs.data(),
+                                                       expirations.data(), docIDs.size(), chunkSize,
+                                                       nullptr, nullptr, &updated, &error), error);
+            return updated;
+        }
+
         // Indexes:
 
         /** Creates a value index in the collection.
@@ -228,6 +347,19 @@ namespace cbl {
             check(CBLCollection_DeleteIndex(ref(), name, &error), error);
         }
 
+        /** Suspends the maintenance of the collection's value, full-text and array indexes during
+            a bulk import, by deleting them until \ref resumeIndexes creates them again. */
+        void suspendIndexes() {
+            CBLError error;
+            check(CBLCollection_SuspendIndexes(ref(), &error), error);
+        }
+
+        /** Creates the indexes suspended by \ref suspendIndexes again, in one pass each. */
+        void resumeIndexes() {
+            CBLError error;
+            check(CBLCollection_ResumeIndexes(ref(), &error), error);
+        }
+
         /** Returns the names of the indexes in the collection, as a Fleece array of strings. */
         fleece::RetainedArray getIndexNames() {
             CBLError error;
@@ -290,21 +422,29 @@ namespace cbl {
     
     private:
         
+        static void _callWriteCallback(void* _cbl_nullable context, const CBLDocument* doc,
+                                       const CBLError* _cbl_nullable error);
+        
+        static std::future<bool> _writeFuture(std::function<void(DocumentWriteCallback)> write);
+        
         static void _callListener(void* _cbl_nullable context, const CBLCollectionChange* change) {
             Collection col = Collection((CBLCollection*)change->collection);
             std::vector<slice> docIDs((slice*)&change->docIDs[0], (slice*)&change->docIDs[change->numDocs]);
-            auto ch = std::make_unique<CollectionChange>(col, docIDs);
+            auto ch = std::make_unique<CollectionChange>(std::move(col), std::move(docIDs));
             CollectionChangeListener::call(context, ch.get());
         }
 
         static void _callDocListener(void* _cbl_nullable context, const CBLDocumentChange* change) {
             Collection col = Collection((CBLCollection*)change->collection);
             slice docID = change->docID;
-            auto ch = std::make_unique<DocumentChange>(col, docID);
+            auto ch = std::make_unique<DocumentChange>(std::move(col), docID);
             CollectionDocumentChangeListener::call(context, ch.get());
         }
     };
 
+    /** A non-owning view of a Collection, which doesn't retain or release it. */
+    using BorrowedCollection = Borrowed<Collection>;
+
     /** Collection change info notified to the collection change listener's callback. */
     class CollectionChange {
     public:
@@ -347,6 +487,12 @@ namespace cbl {
         slice _docID;
     };
 
+    // Transaction method bodies:
+
+    inline Transaction::Transaction(const Collection &collection)
+    :Transaction(CBLCollection_Database(collection.ref()))
+    { }
+
     // Database method bodies:
 
     inline Collection Database::getCollection(slice collectionName, slice scopeName) const {
@@ -0,0 +1,431 @@
+//
+// Coroutines.hh
+//
+// Copyright (c) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "cbl++/Collection.hh"
+#include "cbl++/Document.hh"
+#include "cbl++/Query.hh"
+#include "cbl++/Replicator.hh"
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// VOLATILE API: Couchbase Lite C++ API is not finalized, and may change in
+// future releases.
+
+// Awaitables for C++20 coroutines, built on the asynchronous C APIs. Awaiting one doesn't
+// allocate: its state lives in the coroutine frame, and is the C callback's context.
+// A coroutine that suspends is resumed on the thread that calls the callback -- a query
+// executor thread, the database's writer, or a listener notification thread -- so it should
+// move to its own executor before doing anything slow.
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl {
+
+    /** Base of the awaiters that are completed by a callback, which may be called on another
+        thread before the coroutine has even finished suspending. Whichever of `complete` and
+        `suspendUnlessCompleted` comes second resumes the coroutine. */
+    class CallbackAwaiter {
+    public:
+        CallbackAwaiter() = default;
+        CallbackAwaiter(const CallbackAwaiter&) = delete;
+        CallbackAwaiter& operator=(const CallbackAwaiter&) = delete;
+
+        bool await_ready() const noexcept                   {return false;}
+
+    protected:
+        /** Call from `await_suspend` before starting the operation. */
+        void setHandle(std::coroutine_handle<> h) noexcept  {_handle = h;}
+
+        /** Call from `await_suspend` after starting the operation, and return its result.
+            After this `*this` may have been destroyed by the resumed coroutine. */
+        bool suspendUnlessCompleted() noexcept              {return !_completed.exchange(true);}
+
+        /** Call from the callback, after storing the result.
+            After this `*this` may have been destroyed by the resumed coroutine. */
+        void complete() {
+            if (_completed.exchange(true))
+                _handle.resume();
+        }
+
+    private:
+        std::coroutine_handle<>     _handle;
+        std::atomic<bool>           _completed {false};
+    };
+
+
+    /** Awaits a query's asynchronous execution; see \ref awaitExecute. */
+    class QueryAwaiter : public CallbackAwaiter {
+    public:
+        explicit QueryAwaiter(Query query)                  :_query(std::move(query)) { }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            setHandle(h);
+            CBLQueryExecution *execution = CBLQuery_ExecuteAsync(_query.ref(), &_callback, this);
+            if (!execution)
+                return false;                               // The callback won't be called
+            CBLQueryExecution_Release(execution);           // (It keeps running)
+            return suspendUnlessCompleted();
+        }
+
+        ResultSet await_resume() {
+            if (!_results) {
+                if (_error.code != 0)
+                    throw _error;
+                throw std::runtime_error("Couldn't start query execution");
+            }
+            return std::move(_results);
+        }
+
+    private:
+        static void _callback(void* _cbl_nullable context, CBLQuery*,
+                              CBLResultSet* _cbl_nullable rs, const CBLError* _cbl_nullable error)
+        {
+            auto self = (QueryAwaiter*)context;
+            if (rs)
+                self->_results = Borrowed<ResultSet>(rs).retained();
+            else
+                self->_error = *error;
+            self->complete();
+        }
+
+        Query       _query;
+        ResultSet   _results;
+        CBLError    _error {};
+    };
+
+    /** Runs a query in the background and returns its results, or throws its error.
+        Usage: `ResultSet results = co_await awaitExecute(query);` */
+    [[nodiscard]] inline QueryAwaiter awaitExecute(Query query) {
+        return QueryAwaiter(std::move(query));
+    }
+
+
+    /** Awaits an asynchronous save or deletion of a document; see \ref awaitSave. */
+    class DocumentWriteAwaiter : public CallbackAwaiter {
+    public:
+        DocumentWriteAwaiter(Collection collection, Document doc,
+                             CBLConcurrencyControl concurrency, bool deleting)
+        :_collection(std::move(collection))
+        ,_doc(std::move(doc))
+        ,_concurrency(concurrency)
+        ,_deleting(deleting)
+        { }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            setHandle(h);
+            bool queued;
+            if (_deleting)
+                queued = CBLCollection_DeleteDocumentAsync(_collection.ref(), _doc.ref(),
+                                                           _concurrency, &_callback, this, &_error);
+            else
+                queued = CBLCollection_SaveDocumentAsync(_collection.ref(), (CBLDocument*)_doc.ref(),
+                                                         _concurrency, &_callback, this, &_error);
+            if (!queued)
+                return false;                               // The callback won't be called
+            return suspendUnlessCompleted();
+        }
+
+        /** Returns true if the document was written, false if a conflict prevented it. */
+        bool await_resume() {
+            if (_error.code == 0)
+                return true;
+            if (_error.domain == kCBLDomain && _error.code == kCBLErrorConflict)
+                return false;
+            throw _error;
+        }
+
+    private:
+        static void _callback(void* _cbl_nullable context, const CBLDocument*,
+                              const CBLError* _cbl_nullable error)
+        {
+            auto self = (DocumentWriteAwaiter*)context;
+            if (error)
+                self->_error = *error;
+            self->complete();
+        }
+
+        Collection              _collection;
+        Document                _doc;
+        CBLConcurrencyControl   _concurrency;
+        bool                    _deleting;
+        CBLError                _error {};
+    };
+
+    /** Saves a document as \ref Collection::saveDocumentAsync does, returning true once it's
+        saved or false if a conflict prevented it, and throwing any other error.
+        Usage: `bool saved = co_await awaitSave(collection, doc);` */
+    [[nodiscard]] inline DocumentWriteAwaiter awaitSave(Collection collection, MutableDocument &doc,
+                                                        CBLConcurrencyControl concurrency =kCBLConcurrencyControlLastWriteWins)
+    {
+        return DocumentWriteAwaiter(std::move(collection), doc, concurrency, false);
+    }
+
+    /** Deletes a document as \ref Collection::deleteDocumentAsync does. See \ref awaitSave. */
+    [[nodiscard]] inline DocumentWriteAwaiter awaitDelete(Collection collection, Document &doc,
+                                                          CBLConcurrencyControl concurrency =kCBLConcurrencyControlLastWriteWins)
+    {
+        return DocumentWriteAwaiter(std::move(collection), doc, concurrency, true);
+    }
+
+
+    /** Awaits a replicator's reaching an activity level; see \ref awaitActivity. */
+    class ReplicatorActivityAwaiter : public CallbackAwaiter {
+    public:
+        ReplicatorActivityAwaiter(Replicator replicator, CBLReplicatorActivityLevel activity)
+        :_replicator(std::move(replicator))
+        ,_activity(activity)
+        { }
+
+        ~ReplicatorActivityAwaiter()                        {CBLListener_Remove(_token);}
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            setHandle(h);
+            _token = CBLReplicator_AddChangeListener(_replicator.ref(), &_callback, this);
+            // The replicator may have got there before the listener was added:
+            CBLReplicatorStatus status = _replicator.status();
+            if (status.activity == _activity && !_reached.exchange(true)) {
+                _status = status;
+                return false;
+            }
+            return suspendUnlessCompleted();
+        }
+
+        /** Returns the status with the awaited activity level. */
+        CBLReplicatorStatus await_resume() const            {return _status;}
+
+    private:
+        static void _callback(void* _cbl_nullable context, CBLReplicator*,
+                              const CBLReplicatorStatus *status)
+        {
+            auto self = (ReplicatorActivityAwaiter*)context;
+            if (status->activity == self->_activity && !self->_reached.exchange(true)) {
+                self->_status = *status;
+                self->complete();
+            }
+        }
+
+        Replicator                          _replicator;
+        CBLReplicatorActivityLevel const    _activity;
+        CBLListenerToken* _cbl_nullable     _token {nullptr};
+        std::atomic<bool>                   _reached {false};
+        CBLReplicatorStatus                 _status {};
+    };
+
+    /** Waits until a replicator's activity level is `activity`, such as `kCBLReplicatorIdle`
+        or `kCBLReplicatorStopped`, and returns its status then. Returns at once if it already is.
+        Usage: `auto status = co_await awaitActivity(replicator, kCBLReplicatorStopped);` */
+    [[nodiscard]] inline ReplicatorActivityAwaiter awaitActivity(Replicator replicator,
+                                                                 CBLReplicatorActivityLevel activity)
+    {
+        return ReplicatorActivityAwaiter(std::move(replicator), activity);
+    }
+
+
+    /** A queue of items pushed by a listener, which one coroutine at a time takes in order with
+        `co_await queue.next()`. It's thread-safe. */
+    template <class T>
+    class AsyncQueue {
+    public:
+        AsyncQueue() = default;
+        AsyncQueue(const AsyncQueue&) = delete;
+        AsyncQueue& operator=(const AsyncQueue&) = delete;
+
+        /** Adds an item, resuming the coroutine waiting for one, if any. If `last` is true,
+            also closes the queue; the resumed coroutine may destroy the queue, so this is the
+            way to close it after the last item from a callback. */
+        void push(T item, bool last =false) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_closed)
+                return;
+            _items.push_back(std::move(item));
+            _closed = last;
+            resumeWaiter(lock);
+        }
+
+        /** Marks the end of the items; once the queued ones are taken, `next` returns nothing. */
+        void close() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _closed = true;
+            resumeWaiter(lock);
+        }
+
+        class NextAwaiter {
+        public:
+            bool await_ready() const {
+                std::lock_guard<std::mutex> lock(_queue._mutex);
+                return !_queue._items.empty() || _queue._closed;
+            }
+
+            bool await_suspend(std::coroutine_handle<> h) {
+                std::lock_guard<std::mutex> lock(_queue._mutex);
+                if (!_queue._items.empty() || _queue._closed)
+                    return false;
+                assert(!_queue._waiter);                    // Only one coroutine may wait
+                _queue._waiter = h;
+                return true;
+            }
+
+            /** Returns the next item, or nothing if the queue is closed and empty. */
+            std::optional<T> await_resume() {
+                std::lock_guard<std::mutex> lock(_queue._mutex);
+                if (_queue._items.empty())
+                    return std::nullopt;
+                std::optional<T> item(std::move(_queue._items.front()));
+                _queue._items.pop_front();
+                return item;
+            }
+
+        private:
+            explicit NextAwaiter(AsyncQueue &queue)         :_queue(queue) { }
+            AsyncQueue& _queue;
+            friend class AsyncQueue;
+        };
+
+        /** Awaits the next item. */
+        [[nodiscard]] NextAwaiter next()                    {return NextAwaiter(*this);}
+
+    private:
+        void resumeWaiter(std::unique_lock<std::mutex> &lock) {
+            auto waiter = std::exchange(_waiter, std::coroutine_handle<>());
+            lock.unlock();
+            if (waiter)
+                waiter.resume();
+        }
+
+        std::mutex                  _mutex;
+        std::deque<T>               _items;
+        std::coroutine_handle<>     _waiter;
+        bool                        _closed {false};
+    };
+
+
+    /** A stream of a replicator's status changes. It's closed after the replicator stops.
+        Usage: `while (auto status = co_await stream.next()) ...` */
+    class ReplicatorStatusStream : public AsyncQueue<CBLReplicatorStatus> {
+    public:
+        explicit ReplicatorStatusStream(Replicator replicator)
+        :_replicator(std::move(replicator))
+        {
+            _token = CBLReplicator_AddChangeListener(_replicator.ref(), &_callback, this);
+        }
+
+        ~ReplicatorStatusStream()                           {CBLListener_Remove(_token);}
+
+    private:
+        static void _callback(void* _cbl_nullable context, CBLReplicator*,
+                              const CBLReplicatorStatus *status)
+        {
+            auto self = (ReplicatorStatusStream*)context;
+            self->push(*status, status->activity == kCBLReplicatorStopped);
+        }
+
+        Replicator                          _replicator;
+        CBLListenerToken* _cbl_nullable     _token;
+    };
+
+
+    /** A stream of the IDs of the documents changed in a collection, one vector per
+        notification. Usage: `while (auto docIDs = co_await stream.next()) ...` */
+    class CollectionChangeStream : public AsyncQueue<std::vector<alloc_slice>> {
+    public:
+        explicit CollectionChangeStream(Collection collection)
+        :_collection(std::move(collection))
+        {
+            _token = CBLCollection_AddChangeListener(_collection.ref(), &_callback, this);
+        }
+
+        ~CollectionChangeStream()                           {CBLListener_Remove(_token);}
+
+    private:
+        static void _callback(void* _cbl_nullable context, const CBLCollectionChange *change) {
+            // The IDs are only valid during the callback, so they have to be copied:
+            std::vector<alloc_slice> docIDs(change->docIDs, change->docIDs + change->numDocs);
+            ((CollectionChangeStream*)context)->push(std::move(docIDs));
+        }
+
+        Collection                          _collection;
+        CBLListenerToken* _cbl_nullable     _token;
+    };
+
+
+    /** Reads a query's results in batches, running the query in the background when the first
+        batch is awaited. Usage:
+        ```
+        ResultStream stream(query, 1000);
+        while (const ResultBatch *batch = co_await stream.next()) {
+            for (size_t row = 0; row < batch->count(); ++row)
+                ... batch->value(row, 0) ...
+        }
+        ``` */
+    class ResultStream {
+    public:
+        ResultStream(Query query, size_t batchSize)
+        :_query(std::move(query))
+        ,_batchSize(batchSize)
+        { }
+
+        ResultStream(const ResultStream&) = delete;
+        ResultStream& operator=(const ResultStream&) = delete;
+
+        class NextAwaiter {
+        public:
+            bool await_ready() {
+                if (_stream._results)
+                    return true;
+                _execution.emplace(_stream._query);
+                return false;
+            }
+
+            bool await_suspend(std::coroutine_handle<> h)   {return _execution->await_suspend(h);}
+
+            /** Returns the next batch, which is valid until the next call, or nullptr at the end
+                of the results. Throws if the query failed. */
+            const ResultBatch* _cbl_nullable await_resume() {
+                if (_execution)
+                    _stream._results = _execution->await_resume();
+                return _stream._results.nextBatch(_stream._batchSize, _stream._batch)
+                            ? &_stream._batch : nullptr;
+            }
+
+        private:
+            explicit NextAwaiter(ResultStream &stream)      :_stream(stream) { }
+            ResultStream&               _stream;
+            std::optional<QueryAwaiter> _execution;
+            friend class ResultStream;
+        };
+
+        /** Awaits the next batch of results. */
+        [[nodiscard]] NextAwaiter next()                    {return NextAwaiter(*this);}
+
+    private:
+        Query       _query;
+        size_t      _batchSize;
+        ResultSet   _results;
+        ResultBatch _batch;
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
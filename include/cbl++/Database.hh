@@ -352,6 +352,9 @@ namespace cbl {
             @return  The new query object. */
         inline Query createQuery(CBLQueryLanguage language, slice queryString);
 
+        /** Returns the statistics of the database's cache of compiled queries. */
+        CBLQueryCacheStats queryCacheStats() const      {return CBLDatabase_QueryCacheStats(ref());}
+
         // Indexes:
 
         /** Creates a value index in the default collection.
@@ -558,6 +561,18 @@ namespace cbl {
             _db = db;
         }
 
+        /** Begins a transaction on the database of a collection. */
+        explicit inline Transaction(const Collection &collection);
+
+        Transaction(Transaction &&other) noexcept
+        :_db(other._db)
+        {
+            other._db = nullptr;
+        }
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
         /** Commits changes and ends the transaction. */
         void commit()   {end(true);}
 
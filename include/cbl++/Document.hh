@@ -21,6 +21,8 @@
 #include "cbl++/Database.hh"
 #include "cbl/CBLDocument.h"
 #include "fleece/Mutable.hh"
+#include <future>
+#include <memory>
 #include <string>
 
 // VOLATILE API: Couchbase Lite C++ API is not finalized, and may change in
@@ -101,6 +103,10 @@ namespace cbl {
     };
 
 
+    /** A non-owning view of a Document, which doesn't retain or release it. */
+    using DocumentRef = Borrowed<Document>;
+
+
     /** Mutable Document. */
     class MutableDocument : public Document {
     public:
@@ -217,6 +223,47 @@ namespace cbl {
                                                           &conflictHandler, &error), error);
     }
 
+    inline std::vector<CBLError> Collection::saveDocuments(std::span<MutableDocument> docs,
+                                                           CBLConcurrencyControl c)
+    {
+        std::vector<CBLDocument*> refs;
+        refs.reserve(docs.size());
+        for (auto &doc : docs)
+            refs.push_back(doc.ref());
+        std::vector<CBLError> results(docs.size());
+        CBLError error;
+        check(CBLCollection_SaveDocuments(ref(), refs.data(), refs.size(), c,
+                                          results.data(), &error), error);
+        return results;
+    }
+
+    template <std::ranges::input_range Range>
+        requires std::is_convertible_v<std::ranges::range_reference_t<Range>, MutableDocument&>
+    std::vector<CBLError> Collection::saveDocuments(Range &&docs, CBLConcurrencyControl c) {
+        std::vector<CBLDocument*> refs;
+        if constexpr (std::ranges::sized_range<Range>)
+            refs.reserve(std::ranges::size(docs));
+        for (MutableDocument &doc : docs)
+            refs.push_back(doc.ref());
+        std::vector<CBLError> results(refs.size());
+        CBLError error;
+        check(CBLCollection_SaveDocuments(ref(), refs.data(), refs.size(), c,
+                                          results.data(), &error), error);
+        return results;
+    }
+
+    inline std::vector<Document> Collection::getDocuments(std::span<const slice> docIDs) const {
+        std::vector<const CBLDocument*> refs(docIDs.size());
+        CBLError error {};
+        check(CBLCollection_GetDocuments(ref(), (const FLString*)docIDs.data(), docIDs.size(),
+                                         refs.data(), &error), error);
+        std::vector<Document> docs;
+        docs.reserve(refs.size());
+        for (const CBLDocument *d : refs)
+            docs.push_back(Document::adopt(d, &error));
+        return docs;
+    }
+
     inline void Collection::deleteDocument(Document &doc) {
         (void) deleteDocument(doc, kCBLConcurrencyControlLastWriteWins);
     }
@@ -227,6 +274,61 @@ namespace cbl {
             CBLCollection_DeleteDocumentWithConcurrencyControl(ref(), doc.ref(), cc, &error), error);
     }
 
+    inline void Collection::saveDocumentAsync(MutableDocument &doc, CBLConcurrencyControl c,
+                                              DocumentWriteCallback callback)
+    {
+        auto context = new DocumentWriteCallback(std::move(callback));
+        CBLError error;
+        if (!CBLCollection_SaveDocumentAsync(ref(), doc.ref(), c, &_callWriteCallback, context, &error)) {
+            delete context;
+            throw error;
+        }
+    }
+
+    inline std::future<bool> Collection::saveDocumentAsync(MutableDocument &doc, CBLConcurrencyControl c) {
+        return _writeFuture([&](DocumentWriteCallback callback) {
+            saveDocumentAsync(doc, c, std::move(callback));
+        });
+    }
+
+    inline void Collection::deleteDocumentAsync(Document &doc, CBLConcurrencyControl c,
+                                                DocumentWriteCallback callback)
+    {
+        auto context = new DocumentWriteCallback(std::move(callback));
+        CBLError error;
+        if (!CBLCollection_DeleteDocumentAsync(ref(), doc.ref(), c, &_callWriteCallback, context, &error)) {
+            delete context;
+            throw error;
+        }
+    }
+
+    inline std::future<bool> Collection::deleteDocumentAsync(Document &doc, CBLConcurrencyControl c) {
+        return _writeFuture([&](DocumentWriteCallback callback) {
+            deleteDocumentAsync(doc, c, std::move(callback));
+        });
+    }
+
+    inline void Collection::_callWriteCallback(void* _cbl_nullable context, const CBLDocument* doc,
+                                               const CBLError* _cbl_nullable error)
+    {
+        std::unique_ptr<DocumentWriteCallback> callback((DocumentWriteCallback*)context);
+        (*callback)(Document(doc), error);
+    }
+
+    inline std::future<bool> Collection::_writeFuture(std::function<void(DocumentWriteCallback)> write) {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future = promise->get_future();
+        write([promise](Document, const CBLError* _cbl_nullable error) {
+            if (!error)
+                promise->set_value(true);
+            else if (error->code == kCBLErrorConflict && error->domain == kCBLDomain)
+                promise->set_value(false);
+            else
+                promise->set_exception(std::make_exception_ptr(*error));
+        });
+        return future;
+    }
+
     inline void Collection::purgeDocument(Document &doc) {
         CBLError error;
         check(CBLCollection_PurgeDocument(ref(), doc.ref(), &error), error);
@@ -19,8 +19,19 @@
 #pragma once
 #include "cbl++/Database.hh"
 #include "cbl/CBLQuery.h"
+#include <array>
+#include <bit>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 // VOLATILE API: Couchbase Lite C++ API is not finalized, and may change in
@@ -32,6 +43,8 @@ namespace cbl {
     class Query;
     class ResultSet;
     class ResultSetIterator;
+    class ResultBatch;
+    template <class Row> class TypedResultSet;
 
     /** A database query. */
     class Query : private RefCounted {
@@ -75,9 +88,47 @@ namespace cbl {
         /** Returns the query's current parameter bindings, if any. */
         fleece::Dict parameters() const             {return CBLQuery_Parameters(ref());}
 
+        /** Assigns a value to one of the query's parameters, leaving the others unchanged.
+            This is cheaper than \ref setParameters when only some values change; see
+            \ref CBLQuery_SetParamInt64. The value may be a boolean, a number, a string, a
+            vector of floats (anything convertible to `std::span<const float>`, such as the
+            target of `APPROX_VECTOR_DISTANCE`), or a Fleece value.
+            @param name  The parameter name, without the `$`.
+            @param value  The parameter value. */
+        template <class T>
+        inline void setParameter(slice name, const T &value);
+
         /** Runs the query, returning the results. */
         inline ResultSet execute();
 
+        /** Runs the query, reading each result into a `Row` struct as described by its
+            \ref RowMapping specialization. Named columns are looked up once, not per result. */
+        template <class Row>
+        inline TypedResultSet<Row> execute();
+
+        class AsyncExecution;
+
+        /** Starts running the query in the background, on the executor set by
+            \ref CBLQuery_SetAsyncExecutor. The returned object's `get()` waits for the results,
+            or throws the query's error. */
+        [[nodiscard]] inline AsyncExecution executeAsync();
+
+        /** A callback that receives the next chunk of JSON output; it returns false to stop. */
+        using JSONWriter = std::function<bool(slice chunk)>;
+
+        /** Runs the query and writes its results as JSON, passing the output in chunks to the
+            writer. Each result is written as an object mapping column names to values.
+            @return  True if all the results were written, false if the writer stopped. */
+        bool executeToJSON(CBLQueryJSONFormat format, const JSONWriter &writer) {
+            CBLError error;
+            bool ok = CBLQuery_ExecuteToJSON(ref(), [](void* context, FLSlice chunk) {
+                return (*(const JSONWriter*)context)(chunk);
+            }, (void*)&writer, format, &error);
+            if (!ok && error.code != 0)
+                check(false, error);
+            return ok;
+        }
+
         /** Returns information about the query, including the translated SQLite form, and the search
             strategy. You can use this to help optimize the query: the word `SCAN` in the strategy
             indicates a linear scan of the entire database, which should be avoided by adding an index.
@@ -101,6 +152,14 @@ namespace cbl {
             @return A Change Listener Token. Call \ref ListenerToken::remove() method to remove the listener. */
         [[nodiscard]] inline ChangeListener addChangeListener(ListenerToken<Change>::Callback callback);
 
+        /** Registers a change listener callback to the query, with options for coalescing
+            bursts of changes into a single notification.
+            @param options  The coalescing options.
+            @param callback  The callback to be invoked.
+            @return A Change Listener Token. Call \ref ListenerToken::remove() method to remove the listener. */
+        [[nodiscard]] inline ChangeListener addChangeListener(const CBLQueryChangeListenerOptions &options,
+                                                              ListenerToken<Change>::Callback callback);
+
     private:
         static void _callListener(void *context, CBLQuery*, CBLListenerToken* token);
         CBL_REFCOUNTED_BOILERPLATE(Query, RefCounted, CBLQuery)
@@ -149,6 +208,33 @@ namespace cbl {
         friend class ResultSetIterator;
     };
 
+    /** A batch of consecutive query results, filled in by \ref ResultSet::nextBatch.
+        It can be reused for every batch, to avoid reallocating its storage. */
+    class ResultBatch {
+    public:
+        /** The number of results in the batch. */
+        size_t count() const                        {return _count;}
+
+        /** The number of columns in each result. */
+        unsigned columnCount() const                {return _columnCount;}
+
+        /** Returns a column value of a result in the batch. This may return a NULL Value,
+            indicating `MISSING`, if the value doesn't exist. */
+        fleece::Value value(size_t row, unsigned column) const {
+            assert(row < _count && column < _columnCount);
+            return _values[row * _columnCount + column];
+        }
+
+    private:
+        std::vector<FLValue> _values;
+        size_t _count {0};
+        unsigned _columnCount {0};
+        friend class ResultSet;
+    };
+
+    /** A non-owning view of a Query, which doesn't retain or release it. */
+    using BorrowedQuery = Borrowed<Query>;
+
     /** The results of a query. The only access to the individual Results is to iterate them. */
     class ResultSet : private RefCounted {
     public:
@@ -156,6 +242,25 @@ namespace cbl {
         inline iterator begin();
         inline iterator end();
 
+        /** Reads up to `maxRows` of the following results into `batch`, which is much faster than
+            iterating them one at a time. Usage:
+            ```
+            ResultBatch batch;
+            while (results.nextBatch(1000, batch)) {
+                for (size_t row = 0; row < batch.count(); ++row)
+                    ... batch.value(row, 0) ...
+            }
+            ```
+            @note  The values remain valid until the ResultSet is released.
+            @return  True if any results were read, false at the end of the results. */
+        bool nextBatch(size_t maxRows, ResultBatch &batch) {
+            unsigned nCols = CBLQuery_ColumnCount(CBLResultSet_GetQuery(ref()));
+            batch._columnCount = nCols;
+            batch._values.resize(maxRows * nCols);
+            batch._count = CBLResultSet_NextBatch(ref(), maxRows, batch._values.data());
+            return batch._count > 0;
+        }
+
     private:
         static ResultSet adopt(const CBLResultSet *d) {
             ResultSet rs;
@@ -164,6 +269,7 @@ namespace cbl {
         }
 
         friend class Query;
+        friend class Query::AsyncExecution;
         CBL_REFCOUNTED_BOILERPLATE(ResultSet, RefCounted, CBLResultSet)
     };
 
@@ -194,6 +300,193 @@ namespace cbl {
         friend class ResultSet;
     };
 
+    /** Maps a field of a row struct to a query column, by index or by name.
+        Create these with \ref column, in a \ref RowMapping. */
+    template <class Row, class Field>
+    struct RowColumn {
+        Field Row::*                member;
+        const char* _cbl_nullable   name;       // nullptr if the column is given by index
+        unsigned                    index;
+    };
+
+    /** Maps a field of a row struct to the query column with the given (zero-based) index. */
+    template <class Row, class Field>
+    constexpr RowColumn<Row,Field> column(int index, Field Row::* member) {
+        return {member, nullptr, unsigned(index)};
+    }
+
+    /** Maps a field of a row struct to the query column with the given name. */
+    template <class Row, class Field>
+    constexpr RowColumn<Row,Field> column(const char *name, Field Row::* member) {
+        return {member, name, 0};
+    }
+
+    /** Specialize this to read query results into a struct with \ref Query::execute<Row>.
+        It needs a `static constexpr` tuple of \ref column mappings named `columns`:
+        ```
+        struct Person {std::string first; int64_t age;};
+        template<> struct cbl::RowMapping<Person> {
+            static constexpr auto columns = std::make_tuple(cbl::column("first", &Person::first),
+                                                            cbl::column(1, &Person::age));
+        };
+        ```
+        Fields not mapped to a column are left default-initialized. */
+    template <class Row> struct RowMapping;
+
+    /** Returns a vector stored as Fleece data -- contiguous little-endian 32-bit floats, as
+        an embedding model or `APPROX_VECTOR_DISTANCE` input would be saved -- as a span pointing
+        into the value, without copying or decoding it.
+        Returns an empty span if the value is not data, its size is not a multiple of 4, or it
+        cannot be read in place because it is not aligned to a float or this CPU is big-endian;
+        in those cases read the bytes from `Value::asData` instead.
+        @note  The span is only valid as long as the value is, e.g. until the next query result. */
+    inline std::span<const float> asVector(fleece::Value value) {
+        slice data = value.asData();
+        if constexpr (std::endian::native != std::endian::little)
+            return {};
+        if (data.size % sizeof(float) != 0 || uintptr_t(data.buf) % alignof(float) != 0)
+            return {};
+        return {static_cast<const float*>(data.buf), data.size / sizeof(float)};
+    }
+
+    /** Converts a column value to a field's type. It supports `bool`, integers, floating-point,
+        `std::string`, `slice`, `alloc_slice`, `Value`, `Array`, `Dict`, `std::span<const float>`
+        (see \ref asVector), and `std::optional` of those, which is empty if the value is
+        `MISSING`. Specialize it for other types.
+        @note  A `slice`, `Value`, `Array`, `Dict` or span field is only valid until the next result. */
+    template <class T>
+    struct ColumnDecoder {
+        static T decode(fleece::Value v) {
+            if constexpr (std::is_same_v<T, bool>)
+                return v.asBool();
+            else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+                return T(v.asInt());
+            else if constexpr (std::is_integral_v<T>)
+                return T(v.asUnsigned());
+            else if constexpr (std::is_floating_point_v<T>)
+                return T(v.asDouble());
+            else if constexpr (std::is_same_v<T, std::string>)
+                return std::string(v.asString());
+            else if constexpr (std::is_same_v<T, slice>)
+                return v.asString();
+            else if constexpr (std::is_same_v<T, alloc_slice>)
+                return alloc_slice(v.asString());
+            else if constexpr (std::is_same_v<T, fleece::Value>)
+                return v;
+            else if constexpr (std::is_same_v<T, fleece::Array>)
+                return v.asArray();
+            else if constexpr (std::is_same_v<T, fleece::Dict>)
+                return v.asDict();
+            else if constexpr (std::is_same_v<T, std::span<const float>>)
+                return asVector(v);
+            else
+                static_assert(sizeof(T) == 0, "No cbl::ColumnDecoder for this field type");
+        }
+    };
+
+    template <class T>
+    struct ColumnDecoder<std::optional<T>> {
+        static std::optional<T> decode(fleece::Value v) {
+            if (!v)
+                return std::nullopt;
+            return ColumnDecoder<T>::decode(v);
+        }
+    };
+
+    /** The results of \ref Query::execute<Row>, read into `Row` structs. Like \ref ResultSet,
+        it can only be iterated once. */
+    template <class Row>
+    class TypedResultSet {
+    public:
+        class iterator;
+        inline iterator begin();
+        inline iterator end();
+
+        /** Reads the next result into `row`.
+            @return  True if there was a result, false at the end of the results. */
+        bool next(Row &row) {
+            if (!CBLResultSet_Next(_rs.ref()))
+                return false;
+            decodeRow(row, std::make_index_sequence<kColumnCount>());
+            return true;
+        }
+
+        /** The underlying results. */
+        ResultSet& results()                                {return _rs;}
+
+    private:
+        static constexpr auto& kColumns = RowMapping<Row>::columns;
+        static constexpr size_t kColumnCount = std::tuple_size_v<std::remove_cvref_t<decltype(kColumns)>>;
+
+        explicit TypedResultSet(ResultSet rs)
+        :_rs(std::move(rs))
+        {
+            const CBLQuery *query = CBLResultSet_GetQuery(_rs.ref());
+            unsigned nCols = CBLQuery_ColumnCount(query);
+            size_t i = 0;
+            std::apply([&](const auto& ...col) {
+                ((_indices[i++] = resolveColumn(query, nCols, col.name, col.index)), ...);
+            }, kColumns);
+        }
+
+        static unsigned resolveColumn(const CBLQuery *query, unsigned nCols,
+                                      const char* _cbl_nullable name, unsigned index)
+        {
+            if (name) {
+                for (unsigned i = 0; i < nCols; ++i) {
+                    if (slice(CBLQuery_ColumnName(query, i)) == slice(name))
+                        return i;
+                }
+                throw std::invalid_argument(std::string("Query has no column named ") + name);
+            }
+            if (index >= nCols)
+                throw std::out_of_range("Query column index out of range");
+            return index;
+        }
+
+        template <size_t... I>
+        void decodeRow(Row &row, std::index_sequence<I...>) const {
+            (decodeField(row.*(std::get<I>(kColumns).member), _indices[I]), ...);
+        }
+
+        template <class Field>
+        void decodeField(Field &field, unsigned index) const {
+            field = ColumnDecoder<Field>::decode(CBLResultSet_ValueAtIndex(_rs.ref(), index));
+        }
+
+        ResultSet _rs;
+        std::array<unsigned, kColumnCount> _indices;
+        friend class Query;
+    };
+
+    // Implementation of TypedResultSet::iterator
+    template <class Row>
+    class TypedResultSet<Row>::iterator {
+    public:
+        const Row& operator*()  const {return _row;}
+        const Row* operator->() const {return &_row;}
+
+        bool operator== (const iterator &i) const {return _results == i._results;}
+        bool operator!= (const iterator &i) const {return _results != i._results;}
+
+        iterator& operator++() {
+            if (!_results->next(_row))
+                _results = nullptr;
+            return *this;
+        }
+    private:
+        iterator() = default;
+        explicit iterator(TypedResultSet *results)
+        :_results(results)
+        {
+            ++*this;
+        }
+
+        TypedResultSet* _cbl_nullable _results {nullptr};
+        Row _row {};
+        friend class TypedResultSet;
+    };
+
     // Method implementations:
 
     inline std::vector<std::string> Query::columnNames() const {
@@ -214,6 +507,83 @@ namespace cbl {
         return ResultSet::adopt(rs);
     }
 
+    template <class Row>
+    inline TypedResultSet<Row> Query::execute() {
+        return TypedResultSet<Row>(execute());
+    }
+
+    template <class Row>
+    inline typename TypedResultSet<Row>::iterator TypedResultSet<Row>::begin()  {return iterator(this);}
+
+    template <class Row>
+    inline typename TypedResultSet<Row>::iterator TypedResultSet<Row>::end()    {return iterator();}
+
+    /** A query running in the background, returned by \ref Query::executeAsync. */
+    class Query::AsyncExecution {
+    public:
+        /** Waits for the query to finish and returns the results, or throws its error.
+            After a successful \ref cancel, throws `std::future_error`. */
+        ResultSet get()                                 {return _future.get();}
+
+        /** The future of the results, for use with other `std::future` utilities. */
+        std::future<ResultSet>& future()                {return _future;}
+
+        /** Cancels the execution, unless it has already finished.
+            @return  True if it was cancelled. */
+        bool cancel() {
+            if (!_execution || !CBLQueryExecution_Cancel(_execution))
+                return false;
+            delete _promise;    // The callback won't be called, so this breaks the promise
+            _promise = nullptr;
+            return true;
+        }
+
+        AsyncExecution(AsyncExecution &&other) noexcept
+        :_promise(other._promise)
+        ,_future(std::move(other._future))
+        ,_execution(other._execution)
+        {
+            other._promise = nullptr;
+            other._execution = nullptr;
+        }
+
+        AsyncExecution& operator=(AsyncExecution&&) = delete;
+
+        ~AsyncExecution()                               {CBLQueryExecution_Release(_execution);}
+
+    private:
+        friend class Query;
+
+        using Promise = std::promise<ResultSet>;
+
+        explicit AsyncExecution(CBLQuery* query)
+        :_promise(new Promise)
+        ,_future(_promise->get_future())
+        {
+            _execution = CBLQuery_ExecuteAsync(query, [](void *context, CBLQuery*,
+                                                         CBLResultSet *rs, const CBLError *error) {
+                std::unique_ptr<Promise> promise((Promise*)context);
+                if (rs)
+                    promise->set_value(ResultSet::adopt(CBLResultSet_Retain(rs)));
+                else
+                    promise->set_exception(std::make_exception_ptr(*error));
+            }, _promise);
+            if (!_execution) {
+                delete _promise;
+                _promise = nullptr;
+                throw std::runtime_error("Couldn't start query execution");
+            }
+        }
+
+        Promise* _cbl_nullable _promise;            // Owned by the callback, unless cancelled
+        std::future<ResultSet> _future;
+        CBLQueryExecution* _cbl_nullable _execution {nullptr};
+    };
+
+    inline Query::AsyncExecution Query::executeAsync() {
+        return AsyncExecution(ref());
+    }
+
     class Query::ChangeListener : public ListenerToken<Change> {
     public:
         ChangeListener(): ListenerToken<Change>() { }
@@ -254,6 +624,11 @@ namespace cbl {
             return _query;
         }
 
+        /** The number of changes to the results coalesced into this notification. */
+        uint32_t coalescedChanges() {
+            return CBLQuery_CoalescedChangeCount(_query.ref(), _token);
+        }
+
     private:
         friend class Query;
         Change(Query q, CBLListenerToken* token) : _query(q), _token(token) {}
@@ -270,6 +645,14 @@ namespace cbl {
     }
 
 
+    inline Query::ChangeListener Query::addChangeListener(const CBLQueryChangeListenerOptions &options,
+                                                          ChangeListener::Callback f) {
+        auto l = ChangeListener(*this, f);
+        l.setToken( CBLQuery_AddChangeListenerWithOptions(ref(), &_callListener, l.context(), &options) );
+        return l;
+    }
+
+
     inline void Query::_callListener(void *context, CBLQuery *q, CBLListenerToken* token) {
         ChangeListener::call(context, Change{Query(q), token});
     }
@@ -283,6 +666,207 @@ namespace cbl {
         return iterator();
     }
 
+    template <class T>
+    inline void Query::setParameter(slice name, const T &value) {
+        if constexpr (std::is_same_v<T, bool>)
+            CBLQuery_SetParamBool(ref(), name, value);
+        else if constexpr (std::is_integral_v<T>)
+            CBLQuery_SetParamInt64(ref(), name, int64_t(value));
+        else if constexpr (std::is_floating_point_v<T>)
+            CBLQuery_SetParamDouble(ref(), name, double(value));
+        else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+            std::string_view str = value;
+            CBLQuery_SetParamString(ref(), name, slice(str.data(), str.size()));
+        } else if constexpr (std::is_convertible_v<const T&, slice>)
+            CBLQuery_SetParamString(ref(), name, slice(value));
+        else if constexpr (std::is_convertible_v<const T&, std::span<const float>>) {
+            std::span<const float> vector = value;
+            CBLQuery_SetParamVector(ref(), name, vector.data(), vector.size());
+        }
+        else if constexpr (std::is_convertible_v<const T&, fleece::Value>)
+            CBLQuery_SetParamValue(ref(), name, fleece::Value(value));
+        else
+            static_assert(sizeof(T) == 0, "Unsupported query parameter type");
+    }
+
+
+    /** The text of a N1QL query as a compile-time constant, to be the template parameter of a
+        \ref PreparedQuery. Constant fragments can be joined with `+`. */
+    template <size_t N>
+    struct QueryString {
+        char chars[N] {};
+
+        constexpr QueryString() = default;
+
+        constexpr QueryString(const char (&str)[N]) {
+            for (size_t i = 0; i < N; ++i)
+                chars[i] = str[i];
+        }
+
+        constexpr std::string_view view() const             {return {chars, N - 1};}
+
+        /** Finds the names of the `$` parameters outside of string literals and quoted
+            identifiers, without duplicates. Returns an array holding them, and their number. */
+        constexpr auto parameters() const {
+            auto isNameChar = [](char c) {
+                return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+                    || c == '_';
+            };
+            std::string_view text = view();
+            std::array<std::string_view, N / 2 + 1> names {};
+            size_t count = 0;
+            char quote = 0;
+            for (size_t i = 0; i < text.size(); ++i) {
+                char c = text[i];
+                if (quote) {
+                    if (c == quote)
+                        quote = 0;
+                } else if (c == '\'' || c == '"' || c == '`') {
+                    quote = c;
+                } else if (c == '$' && i + 1 < text.size() && isNameChar(text[i + 1])) {
+                    size_t start = i + 1;
+                    while (i + 1 < text.size() && isNameChar(text[i + 1]))
+                        ++i;
+                    std::string_view name = text.substr(start, i + 1 - start);
+                    bool seen = false;
+                    for (size_t j = 0; j < count; ++j)
+                        seen = seen || names[j] == name;
+                    if (!seen)
+                        names[count++] = name;
+                }
+            }
+            return std::pair{names, count};
+        }
+
+        template <size_t M>
+        constexpr QueryString<N + M - 1> operator+ (const QueryString<M> &other) const {
+            QueryString<N + M - 1> result;
+            for (size_t i = 0; i < N - 1; ++i)
+                result.chars[i] = chars[i];
+            for (size_t i = 0; i < M; ++i)
+                result.chars[N - 1 + i] = other.chars[i];
+            return result;
+        }
+
+        template <size_t M>
+        constexpr QueryString<N + M - 1> operator+ (const char (&other)[M]) const {
+            return *this + QueryString<M>(other);
+        }
+    };
+
+
+    /** A N1QL query whose text is fixed at compile time, which is compiled the first time it
+        runs on a database and then reused. The names of its parameters are found at compile
+        time, and the arguments to \ref execute are bound to them in the order they first
+        appear in the text. Usage:
+        ```
+        static cbl::PreparedQuery<"SELECT name FROM _ WHERE zip = $zip AND age > $age"> sByZip;
+        for (auto &result : sByZip.execute(db, zip, 21)) ...
+        ```
+        A PreparedQuery is thread-safe. Each execution binds its arguments to a compiled query
+        of its own, so executions on the same database run concurrently; another copy of the
+        query is compiled when all of the ones compiled so far are in use.
+        @note  It keeps a reference to each database it has run on, until \ref forget. */
+    template <QueryString Text>
+    class PreparedQuery {
+    public:
+        /** The query text. */
+        static constexpr std::string_view text = Text.view();
+
+        /** The names of the query's parameters, without the `$`, in order of first appearance. */
+        static constexpr auto parameterNames = [] {
+            constexpr auto found = Text.parameters();
+            std::array<std::string_view, found.second> names {};
+            for (size_t i = 0; i < found.second; ++i)
+                names[i] = found.first[i];
+            return names;
+        }();
+
+        /** Runs the query on a database, with the arguments bound to its parameters. */
+        template <class... Args>
+        ResultSet execute(const Database &db, const Args&... args) {
+            Lease lease(*this, db);
+            return bind(lease.query, args...).execute();
+        }
+
+        /** Runs the query on a database, with the arguments bound to its parameters, and reads
+            the results into `Row` structs as \ref Query::execute<Row> does. */
+        template <class Row, class... Args>
+        TypedResultSet<Row> executeRows(const Database &db, const Args&... args) {
+            Lease lease(*this, db);
+            return bind(lease.query, args...).template execute<Row>();
+        }
+
+        /** Releases the queries compiled for a database, and the references to the database.
+            (Ones being executed meanwhile are released when they finish.) */
+        void forget(const Database &db) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            std::erase_if(_queries, [&](auto &entry) {return entry.first == db.ref();});
+        }
+
+    private:
+        // A compiled query taken from the idle ones for a database, or compiled for the purpose,
+        // for the duration of one execution; then it's put back.
+        struct Lease {
+            Lease(PreparedQuery &owner, const Database &db)
+            :_owner(owner)
+            ,_db(db.ref())
+            ,query(owner.take(db))
+            { }
+
+            ~Lease()                                    {_owner.putBack(_db, std::move(query));}
+
+            Lease(const Lease&) =delete;
+            Lease& operator=(const Lease&) =delete;
+
+        private:
+            PreparedQuery&  _owner;
+            CBLDatabase*    _db;
+        public:
+            Query           query;
+        };
+
+        Query take(const Database &db) {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                for (auto &entry : _queries) {
+                    if (entry.first == db.ref() && !entry.second.empty()) {
+                        Query query = std::move(entry.second.back());
+                        entry.second.pop_back();
+                        return query;
+                    }
+                }
+            }
+            return Query(db, kCBLN1QLLanguage, slice(text.data(), text.size()));
+        }
+
+        void putBack(CBLDatabase *db, Query &&query) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (auto &entry : _queries) {
+                if (entry.first == db) {
+                    entry.second.push_back(std::move(query));
+                    return;
+                }
+            }
+            _queries.emplace_back(db, std::vector<Query>{}).second.push_back(std::move(query));
+        }
+
+        template <class... Args>
+        static Query& bind(Query &query, const Args&... args) {
+            static_assert(sizeof...(Args) == parameterNames.size(),
+                          "The number of arguments must match the number of query parameters");
+            size_t i = 0;
+            ((query.setParameter(slice(parameterNames[i].data(), parameterNames[i].size()), args),
+              ++i), ...);
+            return query;
+        }
+
+        std::mutex                                              _mutex;
+        // Idle compiled queries, by database; usually just one database:
+        std::vector<std::pair<CBLDatabase*, std::vector<Query>>> _queries;
+    };
+
+
     // Query
     
     Query Database::createQuery(CBLQueryLanguage language, slice queryString) {
@@ -23,6 +23,8 @@
 #include "cbl++/Base.hh"
 #include "cbl++/Collection.hh"
 #include "cbl/CBLQueryIndex.h"
+#include <span>
+#include <stdexcept>
 
 CBL_ASSUME_NONNULL_BEGIN
 
@@ -99,6 +101,32 @@ namespace cbl {
             check(CBLIndexUpdater_SetVector(ref(), index, vector, dimension, &error), error);
         }
         
+        /** Sets the vectors for `count` consecutive values starting at `startIndex`, from
+            `count` contiguous arrays of `dimension` floats. (See \ref CBLIndexUpdater_SetVectors.) */
+        void setVectors(size_t startIndex, const float* vectors, size_t count, size_t dimension) {
+            CBLError error;
+            check(CBLIndexUpdater_SetVectors(ref(), startIndex, vectors, count, dimension, &error), error);
+        }
+        
+        /** Sets the vector for the value corresponding to the given index, from a span of floats
+            such as a `std::vector<float>`; the floats are not copied by the caller.
+            An empty span with no data means that there is no vector for the value.
+            @param index The zero-based index.
+            @param vector  The vector. Its size must be equal to the dimension value set in the vector index config. */
+        void setVector(unsigned index, std::span<const float> vector) {
+            setVector(index, vector.data(), vector.size());
+        }
+
+        /** Sets the vectors for consecutive values starting at `startIndex`, from a span holding
+            contiguous arrays of `dimension` floats, as returned by a batch embedding model.
+            The number of vectors is the span's size divided by `dimension`.
+            @throws std::invalid_argument if the span's size is not a multiple of `dimension`. */
+        void setVectors(std::span<const float> vectors, size_t dimension, size_t startIndex = 0) {
+            if (dimension == 0 || vectors.size() % dimension != 0)
+                throw std::invalid_argument("Vector data size is not a multiple of the dimension");
+            setVectors(startIndex, vectors.data(), vectors.size() / dimension, dimension);
+        }
+
         /** Skip setting the vector for the value corresponding to the index.
             The vector will be required to compute and set again when the \ref QueryIndex::beginUpdate is later called.
             @param index The zero-based index. */
@@ -133,6 +161,31 @@ namespace cbl {
         auto updater = CBLQueryIndex_BeginUpdate(ref(), limit, &error);
         return IndexUpdater::adopt(updater, &error);
     }
+
+    /** ENTERPRISE EDITION ONLY
+     
+        Keeps a lazy vector index up to date in the background, computing vectors with the
+        configuration's embedder. (See \ref CBLLazyIndexWorker_Create.) */
+    class LazyIndexWorker : private RefCounted {
+    public:
+        LazyIndexWorker(const QueryIndex &index, const CBLLazyIndexWorkerConfiguration &config) {
+            CBLError error {};
+            _ref = (CBLRefCounted*) CBLLazyIndexWorker_Create(index.ref(), &config, &error);
+            check(_ref, error);
+        }
+        
+        /** Starts updating the index, now and after each change to its collection. The worker
+            keeps running, even once this object is gone, until it's stopped. */
+        void start()                                    {CBLLazyIndexWorker_Start(ref());}
+        
+        /** Stops updating the index. */
+        void stop()                                     {CBLLazyIndexWorker_Stop(ref());}
+        
+        /** The worker's statistics. */
+        CBLLazyIndexWorkerStats stats() const           {return CBLLazyIndexWorker_Stats(ref());}
+        
+        CBL_REFCOUNTED_BOILERPLATE(LazyIndexWorker, RefCounted, CBLLazyIndexWorker)
+    };
 #endif
 
     QueryIndex Collection::getIndex(slice name) {
@@ -138,6 +138,17 @@ namespace cbl {
         /** Optional callback to validate incoming docs. */
         ReplicationFilter pullFilter;
         
+        /** Optional N1QL filter expression that docs must match to be pushed; evaluated without
+            creating a Document. See \ref CBLReplicationCollection::pushFilterExpression. */
+        std::string pushFilterExpression;
+        
+        /** Optional N1QL filter expression that incoming docs must match. */
+        std::string pullFilterExpression;
+        
+        /** Optional priority; conflicts in collections with higher priorities are resolved first.
+            It only orders conflict resolution, not the changes and revisions being transferred. */
+        int priority = 0;
+        
         //-- Conflict Resolver:
         /** Optional conflict-resolver callback. */
         ConflictResolver conflictResolver;
@@ -229,6 +240,34 @@ namespace cbl {
             to save by default. */
         bool acceptParentDomainCookies      = kCBLDefaultReplicatorAcceptParentCookies;
         
+        //-- Conflict resolution:
+        /** The maximum number of background tasks resolving conflicts at once.
+            Specify 0 to use the default value of 4. */
+        unsigned maxConcurrentConflictResolvers = 0;
+        /** The maximum number of conflict resolutions saved in one transaction.
+            Specify 0 to use the default value of 50. */
+        unsigned conflictResolverBatchSize  = 0;
+        /** The maximum time in milliseconds to wait for more conflicts to fill a batch.
+            The default, 0, resolves pending conflicts right away. */
+        unsigned conflictResolverBatchDelay = 0;
+        
+        //-- Document listener delivery:
+        /** The maximum time in milliseconds that document replication events are held back so
+            they can be delivered together. The default, 0, doesn't hold them back. */
+        unsigned documentListenerMaxDelay   = 0;
+        /** The maximum number of documents per document listener call when events are held
+            back. The default, 0, means no limit. */
+        unsigned documentListenerMaxBatch   = 0;
+        
+        //-- Checkpoints:
+        /** How often, in seconds, the checkpoint is saved while busy.
+            Specify 0 to use LiteCore's interval. */
+        unsigned checkpointInterval         = 0;
+        
+        //-- Delta Sync:
+        /** If false, revisions are always transferred whole instead of as deltas. */
+        bool enableDeltas                   = true;
+        
         //-- TLS settings:
         /** An X.509 cert (PEM or DER) to "pin" for TLS connections. The pinned cert will be evaluated against any certs
             in a cert chain, and the cert chain will be valid only if the cert chain contains the pinned cert. */
@@ -279,6 +318,13 @@ namespace cbl {
             conf.heartbeat = heartbeat;
             conf.authenticator = authenticator.ref();
             conf.acceptParentDomainCookies = acceptParentDomainCookies;
+            conf.maxConcurrentConflictResolvers = maxConcurrentConflictResolvers;
+            conf.conflictResolverBatchSize = conflictResolverBatchSize;
+            conf.conflictResolverBatchDelay = conflictResolverBatchDelay;
+            conf.documentListenerMaxDelay = documentListenerMaxDelay;
+            conf.documentListenerMaxBatch = documentListenerMaxBatch;
+            conf.checkpointInterval = checkpointInterval;
+            conf.disableDeltas = !enableDeltas;
             conf.proxy = proxy;
             if (!headers.empty())
                 conf.headers = headers;
@@ -348,6 +394,16 @@ namespace cbl {
                     replCol.documentIDs = col.documentIDs;
                 }
 
+                if (!col.pushFilterExpression.empty()) {
+                    replCol.pushFilterExpression = slice(col.pushFilterExpression);
+                }
+
+                if (!col.pullFilterExpression.empty()) {
+                    replCol.pullFilterExpression = slice(col.pullFilterExpression);
+                }
+
+                replCol.priority = col.priority;
+
                 if (col.pushFilter) {
                     replCol.pushFilter = [](void* context,
                                             CBLDocument* cDoc,
@@ -498,6 +554,31 @@ namespace cbl {
             return pending;
         }
         
+        /** Indicates, for each of the given document IDs in the given collection, whether the
+            document has local changes that have not yet been pushed to the server by this
+            replicator. This is faster than calling \ref Replicator::isDocumentPending for each one.
+            @warning If the given collection is not part of the replication, an error will be thrown. */
+        std::vector<bool> arePendingDocuments(const std::vector<fleece::slice> &docIDs,
+                                              Collection& collection) const {
+            std::vector<FLString> ids(docIDs.begin(), docIDs.end());
+            std::unique_ptr<bool[]> pending(new bool[ids.size()]);
+            CBLError error;
+            check(CBLReplicator_ArePendingDocuments(ref(), ids.data(), ids.size(), collection.ref(),
+                                                    pending.get(), &error), error);
+            return std::vector<bool>(pending.get(), pending.get() + ids.size());
+        }
+
+        /** Pulls the documents with the given IDs in the given collection now, ahead of the rest
+            of the changes the replicator has yet to pull. The document listeners are called as
+            each one is pulled. See \ref CBLReplicator_PullDocumentsNow for details.
+            @warning If the given collection is not part of the replication, an error will be thrown. */
+        void pullDocumentsNow(const std::vector<fleece::slice> &docIDs, Collection& collection) {
+            std::vector<FLString> ids(docIDs.begin(), docIDs.end());
+            CBLError error;
+            check(CBLReplicator_PullDocumentsNow(ref(), collection.ref(), ids.data(), ids.size(),
+                                                 &error), error);
+        }
+
         /** A change listener that notifies you when the replicator's status changes.
             @note The listener's callback will be called on a background thread managed by the replicator.
                   It must pay attention to thread-safety. It should not take a long time to return,
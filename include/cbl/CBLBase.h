@@ -166,6 +166,40 @@ unsigned CBL_InstanceCount(void) CBLAPI;
     @note  May only be functional in debug builds of Couchbase Lite. */
 void CBL_DumpInstances(void) CBLAPI;
 
+/** The number of live objects of one kind, and roughly how much memory they hold. */
+typedef struct {
+    uint64_t count;                 ///< Number of live objects
+    uint64_t bytes;                 ///< Approximate bytes they hold, including their own size
+} CBLMemoryUsage;
+
+/** Memory held by live Couchbase Lite objects, by category, from \ref CBL_GetMemoryStats.
+    The byte counts are estimates: they include the objects and the data they own, like a
+    document's revision body, but not the smaller allocations of their members. */
+typedef struct {
+    CBLMemoryUsage documents;       ///< CBLDocuments, with their revision bodies; changes made
+                                    ///< to a mutable document's properties aren't counted
+    CBLMemoryUsage resultSets;      ///< CBLResultSets, with their encoded rows once read
+    CBLMemoryUsage blobs;           ///< CBLBlobs, with the contents of new blobs not yet saved
+    CBLMemoryUsage replicators;     ///< CBLReplicators, with their buffered document events
+    CBLMemoryUsage databases;       ///< CBLDatabases, including their internal read-only
+                                    ///< connections; `bytes` is SQLite's whole heap, including
+                                    ///< the page caches
+    uint64_t totalObjects;          ///< All live objects, as in \ref CBL_InstanceCount
+} CBLMemoryStats;
+
+/** Returns the memory held by live Couchbase Lite objects. It's cheap enough to poll. */
+CBLMemoryStats CBL_GetMemoryStats(void) CBLAPI;
+
+/** Turns on or off recording where each object counted by \ref CBL_GetMemoryStats was
+    allocated, so that \ref CBL_DumpTrackedObjects can report it; this makes creating objects
+    much slower, so it's for debugging leaks. Objects created while it's off aren't tracked. */
+void CBL_SetMemoryTracking(bool enabled) CBLAPI;
+
+/** Logs the category, size and allocation backtrace of each live object created while memory
+    tracking was on, as warnings in the Database domain, and returns their number. Call it when
+    the objects should have been freed, to find the leaked ones. */
+unsigned CBL_DumpTrackedObjects(void) CBLAPI;
+
 // Declares retain/release functions for TYPE. For internal use only.
 #define CBL_REFCOUNTED(TYPE, NAME) \
     static inline const TYPE CBL##NAME##_Retain(const TYPE _cbl_nullable t) \
@@ -180,6 +214,9 @@ void CBL_DumpInstances(void) CBLAPI;
      @{ */
 /** A connection to an open database. */
 typedef struct CBLDatabase   CBLDatabase;
+
+/** Maintenance operations performed a few at a time, within time budgets. */
+typedef struct CBLMaintenanceTask CBLMaintenanceTask;
 /** @} */
 
 /** \defgroup scope  Scope
@@ -192,6 +229,15 @@ typedef struct CBLScope CBLScope;
      @{ */
 /** A collection, a document container. */
 typedef struct CBLCollection    CBLCollection;
+
+/** A batch of changes read from a collection's sequence index. */
+typedef struct CBLChangeFeedBatch CBLChangeFeedBatch;
+
+/** A background task that spreads out the purging of a collection's expired documents. */
+typedef struct CBLExpirationSweeper CBLExpirationSweeper;
+
+/** A count and sums per group of a collection's documents, kept up to date as they change. */
+typedef struct CBLAggregateView CBLAggregateView;
 /** @} */
 
 /** \defgroup documents  Documents
@@ -216,6 +262,9 @@ typedef struct CBLQuery      CBLQuery;
 
 /** An iterator over the rows resulting from running a query. */
 typedef struct CBLResultSet  CBLResultSet;
+
+/** A query execution running in the background. */
+typedef struct CBLQueryExecution CBLQueryExecution;
 /** @} */
 
 /** \defgroup index  Index
@@ -223,8 +272,12 @@ typedef struct CBLResultSet  CBLResultSet;
 /** A query index. */
 typedef struct CBLQueryIndex      CBLQueryIndex;
 
+/** An index being created in the background. */
+typedef struct CBLIndexBuild      CBLIndexBuild;
+
 #ifdef COUCHBASE_ENTERPRISE
 typedef struct CBLIndexUpdater      CBLIndexUpdater;
+typedef struct CBLLazyIndexWorker   CBLLazyIndexWorker;
 #endif
 /** @} */
 
@@ -105,6 +105,28 @@ CBL_CAPI_BEGIN
     FLSliceResult CBLBlob_Content(const CBLBlob* blob,
                                   CBLError* _cbl_nullable outError) CBLAPI;
 
+    /** A read-only view of a blob's content in memory. */
+    typedef struct CBLBlobMapping CBLBlobMapping;
+    CBL_REFCOUNTED(CBLBlobMapping*, BlobMapping);
+
+    /** Makes a blob's content available in memory without copying it: the blob's file is mapped
+        read-only into the address space, so the data can be handed to `sendfile`, a GPU upload, etc.
+        straight from the page cache. The content stays valid until the mapping is released, even
+        if the blob is deleted from the database in the meantime.
+        If the blob can't be mapped -- because the database is encrypted, the blob hasn't been
+        saved yet, or the platform doesn't support it -- the content is read into memory instead,
+        as by \ref CBLBlob_Content.
+        @note  You are responsible for releasing the result by calling \ref CBLBlobMapping_Release. */
+    _cbl_warn_unused
+    CBLBlobMapping* _cbl_nullable CBLBlob_MapContent(const CBLBlob* blob,
+                                                     CBLError* _cbl_nullable outError) CBLAPI;
+
+    /** Returns the content of a \ref CBLBlobMapping. It's valid until the mapping is released. */
+    FLSlice CBLBlobMapping_Content(const CBLBlobMapping*) CBLAPI;
+
+    /** Returns true if a \ref CBLBlobMapping maps the blob's file, false if it's a copy in memory. */
+    bool CBLBlobMapping_IsMapped(const CBLBlobMapping*) CBLAPI;
+
     /** A stream for reading a blob's content. */
     typedef struct CBLBlobReadStream CBLBlobReadStream;
 
@@ -145,6 +167,35 @@ CBL_CAPI_BEGIN
     /** Returns the current position of a CBLBlobReadStream. */
     uint64_t CBLBlobReader_Position(CBLBlobReadStream* stream) CBLAPI;
 
+    /** Sets the size of a CBLBlobReadStream's readahead buffer. Reads smaller than this are
+        served from the buffer, which is filled by one larger read of the blob file, so a series
+        of small reads -- even with seeks in between -- costs far fewer file reads, and in an
+        encrypted database each block is decrypted only once. Reads at least this large bypass
+        the buffer. The size is rounded up to a multiple of 4KB.
+        The default, 0, disables readahead. */
+    void CBLBlobReader_SetReadahead(CBLBlobReadStream* stream, size_t bufferSize) CBLAPI;
+
+    /** One of the ranges to read with \ref CBLBlobReader_ReadV. */
+    typedef struct {
+        uint64_t offset;            ///< The position in the blob to read from
+        void* buffer;               ///< Where to copy the data to
+        size_t length;              ///< The maximum number of bytes to read
+        size_t bytesRead;           ///< On return, the number of bytes read (fewer at EOF)
+    } CBLBlobReadRange;
+
+    /** Reads several ranges of a blob at once. The ranges are read in order of their offsets,
+        so the file is read sequentially, through the readahead buffer if one has been set
+        (see \ref CBLBlobReader_SetReadahead.) The stream's position isn't changed.
+        @param stream  The stream to read from.
+        @param ranges  The ranges to read; each one's `bytesRead` is set on return.
+        @param count  The number of ranges.
+        @param outError  On failure, an error will be stored here if non-NULL.
+        @return  The total number of bytes read, or -1 on error. */
+    int64_t CBLBlobReader_ReadV(CBLBlobReadStream* stream,
+                                CBLBlobReadRange ranges[_cbl_nonnull],
+                                size_t count,
+                                CBLError* _cbl_nullable outError) CBLAPI;
+
     /** Closes a CBLBlobReadStream. */
     void CBLBlobReader_Close(CBLBlobReadStream* _cbl_nullable) CBLAPI;
 
@@ -190,6 +241,26 @@ CBL_CAPI_BEGIN
                              size_t length,
                              CBLError* _cbl_nullable outError) CBLAPI;
 
+    /** Writes data to a new blob at the given offset, for producers that each fill in part of
+        the content. It may be called on several threads at once, and chunks may arrive in any
+        order; data is streamed to disk, and into the digest, as soon as everything before it has
+        been written, and a chunk that arrives early is copied and held until then.
+        Chunks must not overlap. If any gap is left, \ref CBLBlob_CreateWithStream fails and
+        returns NULL, and the stream stays open.
+        @note  A blob's digest covers all of its content, so it can't be added to a document
+               until all of the data has been written.
+        @param writer  The stream to write to.
+        @param offset  The position in the blob's content at which to write the data.
+        @param data  The address of the data to write.
+        @param length  The length of the data to write.
+        @param outError  On failure, error info will be written here.
+        @return  True on success, false on failure. */
+    bool CBLBlobWriter_WriteAt(CBLBlobWriteStream* writer,
+                               uint64_t offset,
+                               const void *data,
+                               size_t length,
+                               CBLError* _cbl_nullable outError) CBLAPI;
+
     /** Creates a new blob after its data has been written to a \ref CBLBlobWriteStream.
         You should then add the blob to a mutable document as a property -- see
         \ref FLSlot_SetBlob.
@@ -196,6 +196,21 @@ CBLDatabase* CBLCollection_Database(const CBLCollection* collection) CBLAPI;
     @return  the number of documents in the collection. */
 uint64_t CBLCollection_Count(const CBLCollection* collection) CBLAPI;
 
+/** Returns the collection as seen through one of its database's read-only connections; see
+    \ref CBLDatabase_AcquireReader.
+    All the collections of a database share its lock, since LiteCore allows only one thread at a
+    time to use a database connection. Reads through the returned collection take the reader's
+    lock instead, so they can run in parallel with reads and writes of other collections (or of
+    this one) on the database, such as an ingest into another collection.
+    @note You are responsible for releasing the returned collection, which keeps its reader
+          until then.
+    @param collection  The collection.
+    @param outError  On failure, the error will be written here.
+    @return  The collection on a reader, or NULL on failure. */
+_cbl_warn_unused
+CBLCollection* _cbl_nullable CBLCollection_AcquireReader(CBLCollection* collection,
+                                                         CBLError* _cbl_nullable outError) CBLAPI;
+
 /** @} */
 
 /** \name  Document lifecycle
@@ -215,6 +230,23 @@ const CBLDocument* _cbl_nullable CBLCollection_GetDocument(const CBLCollection*
                                                            FLString docID,
                                                            CBLError* _cbl_nullable outError) CBLAPI;
 
+/** Reads a batch of documents from the collection, creating a new (immutable) \ref CBLDocument
+    object for each one that exists. This is faster than calling \ref CBLCollection_GetDocument
+    for each ID, since the collection is locked only once and the documents are read in key order.
+    @note  The documents must later be released, for example by \ref CBLDocument_ReleaseAll.
+    @param collection  The collection.
+    @param docIDs  The IDs of the documents.
+    @param count  The number of document IDs.
+    @param outDocs  An array of \p count entries to receive the documents, in the same order as
+                    \p docIDs. An entry is set to NULL if that document doesn't exist.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false if an error occurred, in which case no documents are returned. */
+bool CBLCollection_GetDocuments(const CBLCollection* collection,
+                                const FLString docIDs[_cbl_nonnull],
+                                size_t count,
+                                const CBLDocument* _cbl_nullable outDocs[_cbl_nonnull],
+                                CBLError* _cbl_nullable outError) CBLAPI;
+
 /** Saves a (mutable) document to the collection.
     @warning  If a newer revision has been saved since the doc was loaded, it will be
               overwritten by this one. This can lead to data loss! To avoid this, call
@@ -257,6 +289,109 @@ bool CBLCollection_SaveDocumentWithConflictHandler(CBLCollection* collection,
                                                    void* _cbl_nullable context,
                                                    CBLError* _cbl_nullable outError) CBLAPI;
 
+/** Saves multiple (mutable) documents to the collection in a single transaction.
+    This is considerably faster than saving the documents one at a time, since the collection
+    is locked and the transaction is committed only once for the whole batch.
+    
+    If \p outResults is non-NULL, each document's outcome is written to the corresponding
+    entry (a zero error code means it was saved), and a document that can't be saved, for
+    example because of a conflict with \ref kCBLConcurrencyControlFailOnConflict, is skipped
+    without affecting the others. If \p outResults is NULL, the batch is all-or-nothing: the
+    first failure aborts the transaction and is returned in \p outError.
+    @param collection  The collection to save to.
+    @param docs  The mutable documents to save.
+    @param count  The number of documents in \p docs.
+    @param concurrency  Conflict-handling strategy (fail or overwrite).
+    @param outResults  An array of \p count errors to receive each document's outcome, or NULL.
+    @param outError  On failure, the error will be written here.
+    @return  True if the batch was committed, false if it failed as a whole, in which case
+             none of the documents were saved. */
+bool CBLCollection_SaveDocuments(CBLCollection* collection,
+                                 CBLDocument* const docs[_cbl_nonnull],
+                                 size_t count,
+                                 CBLConcurrencyControl concurrency,
+                                 CBLError* _cbl_nullable outResults,
+                                 CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Saves a document to the collection directly from JSON, creating it if it doesn't exist.
+    The JSON is converted once, straight into the encoding of the new revision, without creating
+    an intermediate \ref CBLDocument. This makes it the fastest way to save documents whose
+    content is already in JSON form.
+    If a document with the same ID already exists, the \p concurrency parameter specifies
+    whether the save should fail or the existing revision should be overwritten.
+    @param collection  The collection to save to.
+    @param docID  The ID of the document.
+    @param json  The document's properties, as a JSON object.
+    @param concurrency  Conflict-handling strategy (fail or overwrite).
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false on failure. */
+bool CBLCollection_SaveJSON(CBLCollection* collection,
+                            FLString docID,
+                            FLString json,
+                            CBLConcurrencyControl concurrency,
+                            CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Options for \ref CBLCollection_ImportJSONLines. */
+typedef struct {
+    /** The number of documents saved in each transaction. Larger batches are faster, but hold
+        the database longer. 0 means \ref kCBLDefaultImportBatchSize. */
+    uint32_t batchSize;
+    
+    /** The number of threads parsing JSON. 0 means one per CPU core. */
+    uint32_t threads;
+    
+    /** Conflict-handling strategy for documents that already exist. Documents that fail with
+        \ref kCBLConcurrencyControlFailOnConflict are skipped. */
+    CBLConcurrencyControl concurrency;
+    
+    /** If true, the collection's indexes are updated as each document is saved. By default
+        they're suspended during the import, as by \ref CBLCollection_SuspendIndexes, and
+        created again at the end, which is much faster. (If indexes are already suspended, they're
+        left that way.) */
+    bool keepIndexes;
+} CBLImportOptions;
+
+/** The progress of \ref CBLCollection_ImportJSONLines. */
+typedef struct {
+    uint64_t documentsImported;         ///< Documents saved so far
+    uint64_t documentsSkipped;          ///< Documents skipped because they already existed
+    uint64_t bytesRead;                 ///< Bytes of the file read so far
+    uint64_t totalBytes;                ///< The size of the file
+    double   documentsPerSecond;        ///< The average rate of documents saved so far
+} CBLImportProgress;
+
+/** Called by \ref CBLCollection_ImportJSONLines after each batch of documents is committed.
+    Returning false stops the import; the documents already saved remain. */
+typedef bool (*CBLImportProgressCallback)(void* _cbl_nullable context,
+                                          const CBLImportProgress* progress);
+
+/** Imports a file of JSON Lines, one JSON object per line, as documents of the collection.
+    This is the fastest way to load a large number of documents: the JSON is parsed by several
+    threads while the previous batch of documents is being saved, the documents are saved in
+    large transactions, and the collection's indexes are created only once at the end.
+    Blank lines are ignored.
+    @param collection  The collection to import into.
+    @param path  The path of the file.
+    @param idProperty  The name of the top-level property holding each document's ID, which must
+                       be a string or an integer. If it's empty, or a document doesn't have it,
+                       the document is given a unique ID. The property stays in the document.
+    @param options  The options, or NULL for the defaults.
+    @param callback  An optional function to call after each batch is committed.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outProgress  If non-NULL, the final progress is written here, whether or not the import
+                        was successful.
+    @param outError  On failure, the error will be written here. The documents committed before a
+                     line that isn't a JSON object remain.
+    @return  True on success, or if the callback stopped the import; false on failure. */
+bool CBLCollection_ImportJSONLines(CBLCollection* collection,
+                                   FLString path,
+                                   FLString idProperty,
+                                   const CBLImportOptions* _cbl_nullable options,
+                                   CBLImportProgressCallback _cbl_nullable callback,
+                                   void* _cbl_nullable context,
+                                   CBLImportProgress* _cbl_nullable outProgress,
+                                   CBLError* _cbl_nullable outError) CBLAPI;
+
 /** Deletes a document from the collection. Deletions are replicated.
     @warning  You are still responsible for releasing the CBLDocument.
     @param collection  The collection containing the document.
@@ -328,6 +463,275 @@ bool CBLCollection_SetDocumentExpiration(CBLCollection* collection,
                                          FLSlice docID,
                                          CBLTimestamp expiration,
                                          CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Called by \ref CBLCollection_PurgeDocuments, \ref CBLCollection_SetDocumentExpirations and
+    the other batch functions after each transaction is committed.
+    @param context  The value given to the function.
+    @param completed  The number of documents processed so far.
+    @param total  The number of documents to process.
+    @return  True to go on, false to stop. */
+typedef bool (*CBLBatchProgressCallback)(void* _cbl_nullable context, size_t completed, size_t total);
+
+/** Purges many documents, given their IDs. The documents are purged in transactions of
+    \p chunkSize, and the collection is unlocked between them so that other threads can use it;
+    this is much faster than purging them one at a time, without holding the database for the
+    whole operation. IDs of documents that don't exist are skipped.
+    @param collection  The collection.
+    @param docIDs  The IDs of the documents to purge.
+    @param count  The number of IDs in \p docIDs.
+    @param chunkSize  The number of documents to purge per transaction; 0 means 1000.
+    @param callback  An optional function to call after each transaction is committed.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outPurged  If non-NULL, the number of documents purged is written here, even on failure.
+    @param outError  On failure, the error will be written here. The documents purged by the
+                     transactions committed before the failure stay purged.
+    @return  True on success, or if the callback stopped the purge; false on failure. */
+bool CBLCollection_PurgeDocuments(CBLCollection* collection,
+                                  const FLString docIDs[_cbl_nonnull],
+                                  size_t count,
+                                  size_t chunkSize,
+                                  CBLBatchProgressCallback _cbl_nullable callback,
+                                  void* _cbl_nullable context,
+                                  size_t* _cbl_nullable outPurged,
+                                  CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Deletes many documents, given their IDs, in transactions of \p chunkSize, as described by
+    \ref CBLCollection_PurgeDocuments. Unlike purges, deletions are replicated.
+    Each document's current revision is replaced by a tombstone, without reading it into a
+    \ref CBLDocument. A document that doesn't exist or is already deleted isn't given another
+    tombstone, so an ID that's repeated is only deleted once.
+    @param collection  The collection.
+    @param docIDs  The IDs of the documents to delete.
+    @param count  The number of IDs in \p docIDs.
+    @param chunkSize  The number of documents to delete per transaction; 0 means 1000.
+    @param concurrency  With \ref kCBLConcurrencyControlFailOnConflict, a document with
+                        unresolved conflicting revisions isn't deleted. With
+                        \ref kCBLConcurrencyControlLastWriteWins, its current revision is.
+    @param callback  An optional function to call after each transaction is committed.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outResults  An array of \p count errors to receive each document's outcome, or NULL.
+                       A zero error code means the document was deleted; otherwise it's
+                       \ref kCBLErrorNotFound or \ref kCBLErrorConflict. If a transaction fails,
+                       its documents and the ones after them get its error. If the callback
+                       stops the deletion, the entries of the rest are left unchanged.
+    @param outDeleted  If non-NULL, the number of documents deleted is written here, even on failure.
+    @param outError  On failure, the error will be written here. The documents deleted by the
+                     transactions committed before the failure stay deleted.
+    @return  True on success, or if the callback stopped the deletion; false on failure. */
+bool CBLCollection_DeleteDocuments(CBLCollection* collection,
+                                   const FLString docIDs[_cbl_nonnull],
+                                   size_t count,
+                                   size_t chunkSize,
+                                   CBLConcurrencyControl concurrency,
+                                   CBLBatchProgressCallback _cbl_nullable callback,
+                                   void* _cbl_nullable context,
+                                   CBLError* _cbl_nullable outResults,
+                                   size_t* _cbl_nullable outDeleted,
+                                   CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Sets or clears the expiration times of many documents, in transactions of \p chunkSize, as
+    described by \ref CBLCollection_PurgeDocuments. IDs of documents that don't exist are skipped.
+    @param collection  The collection.
+    @param docIDs  The IDs of the documents.
+    @param expirations  The documents' expiration times, as in \ref CBLCollection_SetDocumentExpiration.
+    @param count  The number of IDs in \p docIDs and times in \p expirations.
+    @param chunkSize  The number of documents to update per transaction; 0 means 1000.
+    @param callback  An optional function to call after each transaction is committed.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outUpdated  If non-NULL, the number of documents updated is written here, even on failure.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, or if the callback stopped the update; false on failure. */
+bool CBLCollection_SetDocumentExpirations(CBLCollection* collection,
+                                          const FLString docIDs[_cbl_nonnull],
+                                          const CBLTimestamp expirations[_cbl_nonnull],
+                                          size_t count,
+                                          size_t chunkSize,
+                                          CBLBatchProgressCallback _cbl_nullable callback,
+                                          void* _cbl_nullable context,
+                                          size_t* _cbl_nullable outUpdated,
+                                          CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Adds many new documents, for collections that are only ever appended to, like time series
+    with sequential IDs. Each document is saved as a new document with a single revision, in
+    transactions of \p chunkSize as described by \ref CBLCollection_PurgeDocuments, without
+    reading an existing revision or resolving conflicts; documents whose IDs already exist are
+    skipped. Blobs in the properties must already have been saved with \ref CBLDatabase_SaveBlob.
+    @param collection  The collection.
+    @param docIDs  The IDs of the new documents. They can't be empty.
+    @param properties  The documents' properties.
+    @param count  The number of IDs in \p docIDs and dictionaries in \p properties.
+    @param chunkSize  The number of documents to save per transaction; 0 means 1000.
+    @param callback  An optional function to call after each transaction is committed.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outAppended  If non-NULL, the number of documents saved is written here, even on failure.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, or if the callback stopped the appends; false on failure. */
+bool CBLCollection_AppendDocuments(CBLCollection* collection,
+                                   const FLString docIDs[_cbl_nonnull],
+                                   const FLDict properties[_cbl_nonnull],
+                                   size_t count,
+                                   size_t chunkSize,
+                                   CBLBatchProgressCallback _cbl_nullable callback,
+                                   void* _cbl_nullable context,
+                                   size_t* _cbl_nullable outAppended,
+                                   CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Purges every document whose ID starts with \p prefix, such as the entries of a time series
+    up to some time, in transactions of \p chunkSize as described by
+    \ref CBLCollection_PurgeDocuments. The IDs are found by a range scan of the document IDs.
+    @param collection  The collection.
+    @param prefix  The prefix of the IDs of the documents to purge. If empty, every document is purged.
+    @param chunkSize  The number of documents to purge per transaction; 0 means 1000.
+    @param callback  An optional function to call after each transaction is committed.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outPurged  If non-NULL, the number of documents purged is written here, even on failure.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, or if the callback stopped the purge; false on failure. */
+bool CBLCollection_PurgeDocumentsWithPrefix(CBLCollection* collection,
+                                            FLString prefix,
+                                            size_t chunkSize,
+                                            CBLBatchProgressCallback _cbl_nullable callback,
+                                            void* _cbl_nullable context,
+                                            size_t* _cbl_nullable outPurged,
+                                            CBLError* _cbl_nullable outError) CBLAPI;
+
+/** A daily period of time, in minutes after midnight UTC. A window whose end is before its start
+    runs past midnight. */
+typedef struct {
+    uint16_t startMinute;               ///< The start of the window, from 0 to 1439.
+    uint16_t endMinute;                 ///< The end of the window, from 0 to 1440.
+} CBLTimeWindow;
+
+/** Options for \ref CBLCollection_StartExpirationSweeper. */
+typedef struct {
+    /** The most documents to purge per second; 0 means no limit. */
+    uint32_t maxPurgesPerSecond;
+    
+    /** The number of documents purged together; 0 means 100. */
+    uint32_t chunkSize;
+    
+    /** The times of day when documents may be purged, or NULL for any time. */
+    const CBLTimeWindow* _cbl_nullable windows;
+    
+    /** The number of windows in \p windows. */
+    size_t windowCount;
+    
+    /** How often the sweeper looks for documents about to expire; 0 means every minute. */
+    uint32_t scanIntervalMs;
+} CBLExpirationSweeperOptions;
+
+/** The state of a \ref CBLExpirationSweeper's backlog as of its last scan. */
+typedef struct {
+    CBLTimestamp lastScan;              ///< When the last scan ran, or 0 if none has.
+    uint64_t pendingDocuments;          ///< Documents due to be purged by the end of the next scan
+    uint64_t deferredDocuments;         ///< How many of them the last scan postponed
+    CBLTimestamp nextPurge;             ///< When the next document will be purged, or 0
+    CBLTimestamp backlogClearedAt;      ///< When the last pending document will be purged, or 0
+} CBLExpirationBacklog;
+
+/** Starts a background task that spreads out the purging of expired documents, so that a large
+    number of documents expiring together don't cause a latency spike.
+    LiteCore purges documents as soon as they expire, all at once. So the sweeper looks ahead,
+    every \ref CBLExpirationSweeperOptions.scanIntervalMs, at the documents due to expire before
+    its next scan, and postpones their expiration times as needed to purge them in chunks no
+    faster than the maximum rate, and only in the allowed time windows.
+    @note  A document's expiration may be postponed, never brought forward, so documents can
+           outlive their expiration times while there's a backlog. A document given an
+           expiration time sooner than the next scan is purged on time, unthrottled.
+    @note  Stop the sweeper before closing the database. Releasing it also stops it.
+    @param collection  The collection.
+    @param options  The options, or NULL for no limits (then the sweeper only reports metrics).
+    @param outError  On failure, the error will be written here.
+    @return  The new sweeper, or NULL on failure. */
+_cbl_warn_unused
+CBLExpirationSweeper* _cbl_nullable CBLCollection_StartExpirationSweeper(CBLCollection* collection,
+                                                                         const CBLExpirationSweeperOptions* _cbl_nullable options,
+                                                                         CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Scans for documents about to expire right away, instead of waiting for the next scan. */
+bool CBLExpirationSweeper_Scan(CBLExpirationSweeper* sweeper,
+                               CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Returns the state of the sweeper's backlog. */
+CBLExpirationBacklog CBLExpirationSweeper_Backlog(const CBLExpirationSweeper* sweeper) CBLAPI;
+
+/** Stops the sweeper. Expiration times it has postponed remain, so LiteCore will purge those
+    documents at those times. */
+void CBLExpirationSweeper_Stop(CBLExpirationSweeper* sweeper) CBLAPI;
+
+CBL_REFCOUNTED(CBLExpirationSweeper*, ExpirationSweeper);
+/** @} */
+
+/** \name  Aggregate Views
+    @{
+    An aggregate view keeps the equivalent of
+    `SELECT groupBy, COUNT(*), SUM(prop1), SUM(prop2)... GROUP BY groupBy` up to date as the
+    collection changes, so reading it doesn't run a query: it costs time in proportion to the
+    number of groups, not documents. Only the changed documents are looked at: each one's old
+    contribution is taken out of its group, and its new one added.
+    To do that the view keeps every document's contribution, its group and the values summed,
+    in memory, so its size grows with the number of documents in the collection. For a very
+    large collection, a query using an index on the group property may be preferable. */
+
+/** The configuration of a \ref CBLAggregateView. */
+typedef struct {
+    /** The key path of the property to group documents by, e.g. "type" or "address.city".
+        Documents without it form a group of their own. Arrays and dictionaries are grouped by
+        their JSON, as a string. */
+    FLString groupBy;
+
+    /** The key paths of the properties to sum in each group. Values that aren't numbers count
+        as 0. */
+    const FLString* _cbl_nullable sumProperties;
+
+    /** The number of key paths in \p sumProperties. */
+    size_t sumPropertyCount;
+} CBLAggregateViewConfiguration;
+
+/** An aggregate view change listener callback.
+    @param context  An arbitrary value given when the callback was registered.
+    @param view  The view that changed.
+    @param deltas  The changes to the groups, in the same form as the results of
+                   \ref CBLAggregateView_Results, except that the count and sums are the
+                   amounts they changed by. A group whose count drops to 0 is removed.
+                   Only valid during the callback. */
+typedef void (*CBLAggregateViewChangeListener)(void* _cbl_nullable context,
+                                               CBLAggregateView* view,
+                                               FLArray deltas);
+
+/** Creates an aggregate view of a collection. It reads every document once, then follows the
+    collection's changes.
+    @note  The view is updated when the collection's change listeners are notified, so it
+           follows \ref CBLDatabase_BufferNotifications, and it may lag behind a commit briefly.
+    @note  Release the view before closing the database.
+    @param collection  The collection.
+    @param config  The grouping and the properties to sum.
+    @param outError  On failure, the error will be written here.
+    @return  The new view, or NULL on failure. */
+_cbl_warn_unused
+CBLAggregateView* _cbl_nullable CBLCollection_CreateAggregateView(CBLCollection* collection,
+                                                                  CBLAggregateViewConfiguration config,
+                                                                  CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Returns the view's groups, ordered by the JSON of their group values. Each is a dictionary
+    with the keys `group` (missing for the documents without one), `count`, and `sums`, a dictionary
+    from each summed key path to its sum.
+    @note  You are responsible for releasing the returned array. */
+_cbl_warn_unused
+FLMutableArray CBLAggregateView_Results(const CBLAggregateView* view) CBLAPI;
+
+/** Registers a listener that's called with the changes to the view's groups after it's updated.
+    @note  The listener token retains the view until the listener is removed.
+    @param view  The view to observe.
+    @param listener  The callback to be invoked.
+    @param context  An opaque value that will be passed to the callback.
+    @return  A token to be passed to \ref CBLListener_Remove when it's time to remove the listener.*/
+_cbl_warn_unused
+CBLListenerToken* CBLAggregateView_AddChangeListener(CBLAggregateView* view,
+                                                     CBLAggregateViewChangeListener listener,
+                                                     void* _cbl_nullable context) CBLAPI;
+
+CBL_REFCOUNTED(CBLAggregateView*, AggregateView);
 /** @} */
 
 /** \name  Mutable documents
@@ -351,6 +755,55 @@ CBLDocument* _cbl_nullable CBLCollection_GetMutableDocument(CBLCollection* colle
                                                             CBLError* _cbl_nullable outError) CBLAPI;
 /** @} */
 
+/** \name  Asynchronous writes
+    @{
+    A document can be saved or deleted without blocking the calling thread. The write is queued
+    and performed later by the database's writer, which commits the writes queued meanwhile in
+    one transaction; a callback is then invoked with the outcome of each write, in the order
+    they were queued.
+    The database holds at most `asyncWriteLimit` queued writes (see \ref CBLDatabaseConfiguration);
+    beyond that, a write fails right away with \ref kCBLErrorBusy, and should be retried once
+    earlier writes have completed.
+    @warning  Don't change a document while a write of it is queued, and don't close the
+              database from a write's callback.
+ */
+
+/** A callback to be invoked on a background thread when an asynchronous write has completed.
+    @param context  The `context` value passed to the function that queued the write.
+    @param doc  The document that was written.
+    @param error  If the write failed, the error, with code \ref kCBLErrorConflict if a
+                  conflicting revision prevented it; else NULL. */
+typedef void (*CBLDocumentWriteCallback)(void* _cbl_nullable context,
+                                         const CBLDocument* doc,
+                                         const CBLError* _cbl_nullable error);
+
+/** Queues a save of a (mutable) document, as \ref CBLCollection_SaveDocumentWithConcurrencyControl
+    would do it. The document is retained until the callback has been invoked.
+    @param collection  The collection to save to.
+    @param doc  The mutable document to save.
+    @param concurrency  Conflict-handling strategy (fail or overwrite).
+    @param callback  The callback to be invoked once the save has completed, or NULL.
+    @param context  An opaque value that will be passed to the callback.
+    @param outError  If the write couldn't be queued, the error will be written here.
+    @return  True if the write was queued, false if not, in which case the callback won't be
+             invoked. */
+bool CBLCollection_SaveDocumentAsync(CBLCollection* collection,
+                                     CBLDocument* doc,
+                                     CBLConcurrencyControl concurrency,
+                                     CBLDocumentWriteCallback _cbl_nullable callback,
+                                     void* _cbl_nullable context,
+                                     CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Queues a deletion of a document, as \ref CBLCollection_DeleteDocumentWithConcurrencyControl
+    would do it. See \ref CBLCollection_SaveDocumentAsync. */
+bool CBLCollection_DeleteDocumentAsync(CBLCollection* collection,
+                                       const CBLDocument* doc,
+                                       CBLConcurrencyControl concurrency,
+                                       CBLDocumentWriteCallback _cbl_nullable callback,
+                                       void* _cbl_nullable context,
+                                       CBLError* _cbl_nullable outError) CBLAPI;
+/** @} */
+
 /** \name  Query Indexes
     @{
  */
@@ -406,6 +859,82 @@ bool CBLCollection_CreateVectorIndex(CBLCollection *collection,
                                      CBLVectorIndexConfiguration config,
                                      CBLError* _cbl_nullable outError) CBLAPI;
 
+/** ENTERPRISE EDITION ONLY
+ 
+    Recommends the centroids, encoding and number of probes of a vector index, by sampling the
+    collection's vectors and simulating candidate configurations on them: every encoding, with
+    the recommended number of centroids and half and twice as many. Of the candidates whose
+    estimated recall and memory meet the targets, it picks the one that's fastest to query.
+    If there's none, it picks the one with the best recall within the memory budget, or else the
+    smallest one, and sets `meetsTargets` to false.
+ 
+    The estimates are extrapolated from the sample, so they're only a guide, especially for a
+    collection much larger than the sample. The build time is scaled up from the simulation's
+    own, so it's most useful for comparing configurations.
+    @warning  This can take a few seconds, so don't call it on a UI thread.
+    @param collection  The collection.
+    @param config  On input, the index's `expressionLanguage`, `expression`, `dimensions` and
+                   `metric`; the expression must return the vectors, so it can't be lazy.
+                   On output, `centroids`, `encoding` and `numProbes` are set. You are
+                   responsible for freeing the encoding with \ref CBLVectorEncoding_Free.
+    @param options  The targets, or NULL for the defaults.
+    @param outEstimate  On success, the recommended configuration's estimates are written here.
+    @param outError  On failure, an error is written here.
+    @return  True on success, false on failure. */
+bool CBLCollection_AdviseVectorIndex(const CBLCollection *collection,
+                                     CBLVectorIndexConfiguration *config,
+                                     const CBLVectorIndexAdvisorOptions* _cbl_nullable options,
+                                     CBLVectorIndexEstimate* _cbl_nullable outEstimate,
+                                     CBLError* _cbl_nullable outError) CBLAPI;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Finds the documents whose vectors are nearest to a target. When few documents match --
+    a small collection, or a selective `where` condition -- this computes the exact distance of
+    every one with SIMD instructions, which is faster than building and probing a vector index,
+    and needs no index. When more than `maxScanCount` match, it runs an APPROX_VECTOR_DISTANCE
+    query if there's a vector index to use, or else still searches them all.
+ 
+    With a `where` condition, the search pre-filters when the collection has at most
+    `maxScanCount` documents, or there's no vector index: only the matching documents' vectors
+    are read, so the results are exact however selective the condition is. Otherwise it first
+    counts the matching documents, and if there are few enough, pre-filters too. Otherwise it
+    post-filters: the index query fetches enough nearest vectors that, at the condition's
+    selectivity, `limit` of them should match. If that would be more than 10000, or fewer than
+    `limit` match after all, it pre-filters instead.
+    \ref CBLCollection_ExplainVectorSearch describes the choice.
+ 
+    Documents whose vectors don't have `dimensions` numbers are skipped.
+    @param collection  The collection.
+    @param search  The expression returning the vectors, and the search's options.
+    @param target  The vector to search for.
+    @param dimensions  The number of floats in `target`.
+    @param outError  On failure, an error is written here.
+    @return  An array of up to `limit` dictionaries, nearest first, each with the document's
+             ID as `id` and its distance from the target as `distance`; or NULL on failure.
+             You are responsible for releasing it. */
+_cbl_warn_unused
+FLMutableArray _cbl_nullable CBLCollection_FindNearestVectors(const CBLCollection *collection,
+                                                              const CBLVectorSearch *search,
+                                                              const float target[_cbl_nonnull],
+                                                              unsigned dimensions,
+                                                              CBLError* _cbl_nullable outError) CBLAPI;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Describes how \ref CBLCollection_FindNearestVectors would run a search: whether it scans
+    the documents exactly or queries a vector index, and with a `where` condition, whether it
+    pre-filters or post-filters, and the condition's estimated selectivity.
+    @param collection  The collection.
+    @param search  The search.
+    @param outError  On failure, an error is written here.
+    @return  A description of the search's plan, or a null slice on failure.
+             You are responsible for releasing the result by calling \ref FLSliceResult_Release. */
+_cbl_warn_unused
+FLSliceResult CBLCollection_ExplainVectorSearch(const CBLCollection *collection,
+                                                const CBLVectorSearch *search,
+                                                CBLError* _cbl_nullable outError) CBLAPI;
+
 #endif
 
 /** Deletes an index in the collection by name.
@@ -417,6 +946,30 @@ bool CBLCollection_DeleteIndex(CBLCollection *collection,
                                FLString name,
                                CBLError* _cbl_nullable outError) CBLAPI;
 
+/** Suspends the maintenance of the collection's value, full-text and array indexes, to speed up
+    a bulk import: the indexes are deleted, and their definitions are saved in the database, until
+    \ref CBLCollection_ResumeIndexes creates them again. Creating an index over existing documents
+    builds it in one pass, which is much faster than updating it for every document saved.
+    While the indexes are suspended, queries can't use them, and may be much slower.
+    Creating or deleting an index with the name of a suspended one stops it being suspended.
+    @note  Vector indexes are not suspended. Neither are full-text or array indexes created before
+           this collection object was opened, since their options aren't known; value indexes
+           always are.
+    @param collection  The collection.
+    @param outError  On failure, an error is written here.
+    @return  True on success, false on failure. */
+bool CBLCollection_SuspendIndexes(CBLCollection *collection,
+                                  CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Creates the indexes suspended by \ref CBLCollection_SuspendIndexes again, indexing all of the
+    collection's documents. This works after the database has been reopened, too.
+    Does nothing if no indexes are suspended.
+    @param collection  The collection.
+    @param outError  On failure, an error is written here.
+    @return  True on success, false on failure. */
+bool CBLCollection_ResumeIndexes(CBLCollection *collection,
+                                 CBLError* _cbl_nullable outError) CBLAPI;
+
 /** Returns the names of the indexes in the collection, as a Fleece array of strings.
     @note  You are responsible for releasing the returned Fleece array.
     @param collection  The collection.
@@ -439,6 +992,98 @@ CBLQueryIndex* _cbl_nullable CBLCollection_GetIndex(CBLCollection* collection,
 
 /** @} */
 
+/** \name  Asynchronous index creation
+    @{
+    An index can be created in the background, so that the calling thread doesn't block until
+    it's built. If an index with the same name but a different configuration exists, it's
+    replaced when the new one is ready, and queries can use it until then.
+    @note  LiteCore builds an index in a single step while holding the database, so other calls
+           on the same database wait until it's finished. To keep a large lazy vector index up to
+           date in smaller steps, use a \ref CBLLazyIndexWorker instead.
+ */
+
+/** The states of an asynchronous index creation. */
+typedef CBL_ENUM(uint8_t, CBLIndexBuildState) {
+    kCBLIndexBuildPending,          ///< Waiting to start
+    kCBLIndexBuildRunning,          ///< Building the index
+    kCBLIndexBuildFinished,         ///< The index was created
+    kCBLIndexBuildFailed,           ///< The index couldn't be created
+    kCBLIndexBuildCancelled         ///< Cancelled before it started
+};
+
+/** A callback to be invoked on a background thread when an asynchronous index creation starts
+    running, and again when it has finished or failed.
+    @param context  The `context` value passed to the function that started the creation.
+    @param build  The index creation.
+    @param state  \ref kCBLIndexBuildRunning, \ref kCBLIndexBuildFinished or \ref kCBLIndexBuildFailed.
+    @param error  If the creation failed, the error; else NULL. */
+typedef void (*CBLIndexBuildCallback)(void* _cbl_nullable context,
+                                      CBLIndexBuild* build,
+                                      CBLIndexBuildState state,
+                                      const CBLError* _cbl_nullable error);
+
+/** Starts creating a value index in the background, as \ref CBLCollection_CreateValueIndex does.
+    @note  You must release the returned \ref CBLIndexBuild when you're finished with it.
+    @param collection  The collection.
+    @param name  The name of the index.
+    @param config  The index configuration.
+    @param callback  The callback to be invoked as the creation progresses, or NULL.
+    @param context  An opaque value that will be passed to the callback.
+    @return  A handle to the creation, which can be used to cancel it. */
+_cbl_warn_unused
+CBLIndexBuild* CBLCollection_CreateValueIndexAsync(CBLCollection *collection,
+                                                   FLString name,
+                                                   CBLValueIndexConfiguration config,
+                                                   CBLIndexBuildCallback _cbl_nullable callback,
+                                                   void* _cbl_nullable context) CBLAPI;
+
+/** Starts creating a full-text index in the background, as
+    \ref CBLCollection_CreateFullTextIndex does. See \ref CBLCollection_CreateValueIndexAsync. */
+_cbl_warn_unused
+CBLIndexBuild* CBLCollection_CreateFullTextIndexAsync(CBLCollection *collection,
+                                                      FLString name,
+                                                      CBLFullTextIndexConfiguration config,
+                                                      CBLIndexBuildCallback _cbl_nullable callback,
+                                                      void* _cbl_nullable context) CBLAPI;
+
+/** Starts creating an array index in the background, as \ref CBLCollection_CreateArrayIndex does.
+    See \ref CBLCollection_CreateValueIndexAsync. */
+_cbl_warn_unused
+CBLIndexBuild* CBLCollection_CreateArrayIndexAsync(CBLCollection *collection,
+                                                   FLString name,
+                                                   CBLArrayIndexConfiguration config,
+                                                   CBLIndexBuildCallback _cbl_nullable callback,
+                                                   void* _cbl_nullable context) CBLAPI;
+
+#ifdef COUCHBASE_ENTERPRISE
+/** ENTERPRISE EDITION ONLY
+ 
+    Starts creating a vector index in the background, as \ref CBLCollection_CreateVectorIndex does.
+    The configuration, including its encoding, is copied. An invalid configuration is reported
+    to the callback. See \ref CBLCollection_CreateValueIndexAsync. */
+_cbl_warn_unused
+CBLIndexBuild* CBLCollection_CreateVectorIndexAsync(CBLCollection *collection,
+                                                    FLString name,
+                                                    CBLVectorIndexConfiguration config,
+                                                    CBLIndexBuildCallback _cbl_nullable callback,
+                                                    void* _cbl_nullable context) CBLAPI;
+#endif
+
+/** Returns the name of the index being created. */
+FLString CBLIndexBuild_IndexName(const CBLIndexBuild* build) CBLAPI;
+
+/** Returns the current state of an asynchronous index creation. */
+CBLIndexBuildState CBLIndexBuild_State(const CBLIndexBuild* build) CBLAPI;
+
+/** Cancels an asynchronous index creation. If it hasn't started running it never will, and its
+    callback won't be called. A creation that's running can't be interrupted.
+    @return  True if the creation was cancelled, false if it has already started. */
+bool CBLIndexBuild_Cancel(CBLIndexBuild* build) CBLAPI;
+
+CBL_REFCOUNTED(CBLIndexBuild*, IndexBuild);
+
+/** @} */
+
 /** \name  Change Listeners
     @{
     A collection change listener lets you detect changes made to all documents in a collection.
@@ -472,6 +1117,101 @@ CBLListenerToken* CBLCollection_AddChangeListener(const CBLCollection* collectio
                                                   CBLCollectionChangeListener listener,
                                                   void* _cbl_nullable context) CBLAPI;
 
+/** Information about one document change, as given to a \ref CBLCollectionChangeBatchListener. */
+typedef struct {
+    FLString docID;                     ///< The document's ID.
+    FLString revID;                     ///< The ID of the revision the document changed to.
+    uint64_t sequence;                  ///< The document's new sequence number.
+    uint32_t bodySize;                  ///< The size in bytes of the revision's body.
+    bool deleted;                       ///< True if the document was deleted.
+    bool external;                      ///< True if the change was made by another CBLDatabase
+                                        ///< instance on the same file, e.g. by a replicator.
+} CBLCollectionChangeEntry;
+
+/** A batch of changes to a collection, as given to a \ref CBLCollectionChangeBatchListener. */
+typedef struct {
+    const CBLCollection* collection;    ///< The collection that changed.
+    size_t numChanges;                  ///< The number of changes (size of the `changes` array).
+    const CBLCollectionChangeEntry* changes; ///< The changes, in sequence order.
+} CBLCollectionChangeBatch;
+
+/** A collection change listener callback that receives every pending change at once, with
+    details of each change.
+    @warning  The batch, including its strings, is only valid during the callback.
+    @param context  An arbitrary value given when the callback was registered.
+    @param batch  The changes. */
+typedef void (*CBLCollectionChangeBatchListener)(void* _cbl_nullable context,
+                                                 const CBLCollectionChangeBatch* batch);
+
+/** Registers a collection change listener callback that is called with all the changes made
+    since its previous call, in one batch, instead of in batches of up to 100 document IDs.
+    Each change carries its sequence, revision ID, body size and flags, so the listener doesn't
+    have to read the document to find out about it.
+    @param collection  The collection to observe.
+    @param listener  The callback to be invoked.
+    @param context  An opaque value that will be passed to the callback.
+    @return  A token to be passed to \ref CBLListener_Remove when it's time to remove the listener.*/
+_cbl_warn_unused
+CBLListenerToken* CBLCollection_AddChangeBatchListener(const CBLCollection* collection,
+                                                       CBLCollectionChangeBatchListener listener,
+                                                       void* _cbl_nullable context) CBLAPI;
+
+/** @} */
+
+/** \name  Change Feed
+    @{
+    A change feed reads a collection's changes in sequence order, a batch at a time, instead of
+    being called as they happen. Since every change has a sequence number that only increases,
+    a consumer can store the last sequence it has processed and resume from it after a restart,
+    which makes it suitable for exporting changes to another system.
+    @note  Each document appears once, at its latest sequence: the feed reads the current
+           revisions, so a document changed several times since the sequence shows only its last
+           change. Purged documents don't appear. */
+
+/** A change read from a change feed: the current revision of a document. */
+typedef struct {
+    uint64_t sequence;                  ///< The document's sequence number.
+    FLString docID;                     ///< The document's ID.
+    FLString revID;                     ///< The ID of the document's current revision.
+    bool deleted;                       ///< True if the document has been deleted.
+    FLDict _cbl_nullable body;          ///< The revision's properties, if requested; NULL if deleted.
+} CBLChangeFeedEntry;
+
+CBL_REFCOUNTED(CBLChangeFeedBatch*, ChangeFeedBatch);
+
+/** Reads the changes to a collection after a sequence, in sequence order.
+    If there are none, waits up to \p waitMs milliseconds for a change to be committed, by this
+    or another \ref CBLDatabase instance on the same file, before returning an empty batch; this
+    allows long-polling without querying repeatedly.
+    @warning  A wait blocks the calling thread, so don't wait on a UI thread.
+    @note  You must release the batch when you're finished with it.
+    @param collection  The collection.
+    @param sinceSequence  Only changes with a greater sequence are returned; 0 returns them all.
+    @param limit  The most changes to return; 0 means no limit.
+    @param includeBodies  True to read each revision's properties.
+    @param waitMs  How long to wait for a change if there are none yet; 0 doesn't wait.
+    @param outError  On failure, the error will be written here.
+    @return  The batch of changes, or NULL on failure. */
+_cbl_warn_unused
+CBLChangeFeedBatch* _cbl_nullable CBLCollection_ChangesSince(const CBLCollection* collection,
+                                                             uint64_t sinceSequence,
+                                                             uint32_t limit,
+                                                             bool includeBodies,
+                                                             uint32_t waitMs,
+                                                             CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Returns the number of changes in a batch. */
+size_t CBLChangeFeedBatch_Count(const CBLChangeFeedBatch* batch) CBLAPI;
+
+/** Returns a change in a batch. Its strings and body remain valid until the batch is released.
+    @param batch  The batch.
+    @param index  The index of the change, less than \ref CBLChangeFeedBatch_Count. */
+CBLChangeFeedEntry CBLChangeFeedBatch_Entry(const CBLChangeFeedBatch* batch, size_t index) CBLAPI;
+
+/** Returns the sequence to pass to the next \ref CBLCollection_ChangesSince call: the last
+    change's sequence, or the requested sequence if the batch is empty. */
+uint64_t CBLChangeFeedBatch_LastSequence(const CBLChangeFeedBatch* batch) CBLAPI;
+
 /** @} */
 
 /** \name  Document listeners
@@ -0,0 +1,141 @@
+//
+// CBLConflictFree.h
+//
+// Copyright (c) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLBase.h"
+
+CBL_CAPI_BEGIN
+
+/** \defgroup conflictfree Conflict-Free Values
+    @{
+
+    Conflict-free values are properties that the replicator can merge by itself when a document
+    has been changed on both sides, without calling a conflict resolver.
+
+    Like \ref CBLBlob and \ref CBLEncryptable, each is a dictionary with a special `"@type"`
+    property:
+
+    * A counter (`"@type":"counter"`) can only be incremented. Its `counts` dictionary maps
+      each database that has incremented it to that database's total, and its value is their
+      sum. Merging takes the larger total for each database, so no increment is lost.
+
+    * An observed-remove set (`"@type":"orset"`) holds strings. Each addition of a member is
+      tagged uniquely, and removing the member removes the tags it has seen. Merging unites the
+      tags, so a member is present if either side added it in a way the other side hadn't seen
+      removed. The `adds` and `removes` dictionaries map members to their tags. Removed tags are
+      kept, so a set that's often changed grows.
+
+    When the replicator finds a conflict in which the two revisions differ only in conflict-free
+    values, it saves the merged revision instead of calling the conflict resolver. If any other
+    property differs, or is only in one of the revisions, the conflict resolver is called as
+    usual.
+
+    Use the functions below to create and change these values, rather than editing their
+    dictionaries directly. Changes need the database the document will be saved in, to tell
+    its changes apart from other databases'.
+ */
+
+CBL_PUBLIC extern const FLSlice kCBLCounterType;               ///< `"counter"`
+CBL_PUBLIC extern const FLSlice kCBLORSetType;                 ///< `"orset"`
+
+#ifdef __APPLE__
+#pragma mark - COUNTERS:
+#endif
+
+/** Checks whether the given dictionary is a counter or not. */
+bool FLDict_IsCounter(FLDict _cbl_nullable) CBLAPI;
+
+/** Checks whether the given FLValue is a counter or not. */
+static inline bool FLValue_IsCounter(FLValue _cbl_nullable value) {
+    return FLDict_IsCounter(FLValue_AsDict(value));
+}
+
+/** Returns the value of a counter: the sum of every database's increments. Returns 0 if the
+    dictionary isn't a counter. */
+uint64_t FLDict_GetCounterValue(FLDict _cbl_nullable counter) CBLAPI;
+
+/** Returns the value of a counter, or 0 if the value isn't a counter. */
+static inline uint64_t FLValue_GetCounterValue(FLValue _cbl_nullable value) {
+    return FLDict_GetCounterValue(FLValue_AsDict(value));
+}
+
+/** Increments the counter in a mutable dictionary's property, creating the counter if the
+    property doesn't exist.
+    @param dict  The dictionary containing the counter, e.g. a document's properties.
+    @param key  The counter's property name.
+    @param db  The database the document will be saved in.
+    @param amount  The amount to add.
+    @param outError  On failure, an error is written here.
+    @return  True on success; false if the property exists but isn't a counter. */
+bool FLMutableDict_IncrementCounter(FLMutableDict dict,
+                                    FLString key,
+                                    const CBLDatabase* db,
+                                    uint64_t amount,
+                                    CBLError* _cbl_nullable outError) CBLAPI;
+
+#ifdef __APPLE__
+#pragma mark - SETS:
+#endif
+
+/** Checks whether the given dictionary is an observed-remove set or not. */
+bool FLDict_IsORSet(FLDict _cbl_nullable) CBLAPI;
+
+/** Checks whether the given FLValue is an observed-remove set or not. */
+static inline bool FLValue_IsORSet(FLValue _cbl_nullable value) {
+    return FLDict_IsORSet(FLValue_AsDict(value));
+}
+
+/** Checks whether an observed-remove set contains a string. */
+bool FLDict_ORSetContains(FLDict _cbl_nullable set, FLString member) CBLAPI;
+
+/** Returns the members of an observed-remove set, in ascending order, or NULL if the
+    dictionary isn't a set.
+    @note  You are responsible for releasing the returned array. */
+_cbl_warn_unused
+FLMutableArray _cbl_nullable FLDict_GetORSetMembers(FLDict _cbl_nullable set) CBLAPI;
+
+/** Adds a string to the observed-remove set in a mutable dictionary's property, creating the
+    set if the property doesn't exist.
+    @param dict  The dictionary containing the set, e.g. a document's properties.
+    @param key  The set's property name.
+    @param db  The database the document will be saved in.
+    @param member  The string to add.
+    @param outError  On failure, an error is written here.
+    @return  True on success; false if the property exists but isn't a set. */
+bool FLMutableDict_AddToORSet(FLMutableDict dict,
+                              FLString key,
+                              const CBLDatabase* db,
+                              FLString member,
+                              CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Removes a string from the observed-remove set in a mutable dictionary's property. Additions
+    of the string that this revision hasn't seen, made in other databases, aren't removed.
+    @param dict  The dictionary containing the set, e.g. a document's properties.
+    @param key  The set's property name.
+    @param member  The string to remove.
+    @param outError  On failure, an error is written here.
+    @return  True on success, including if the set doesn't contain the string; false if the
+             property doesn't exist or isn't a set. */
+bool FLMutableDict_RemoveFromORSet(FLMutableDict dict,
+                                   FLString key,
+                                   FLString member,
+                                   CBLError* _cbl_nullable outError) CBLAPI;
+
+/** @} */
+
+CBL_CAPI_END
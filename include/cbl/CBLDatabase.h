@@ -99,6 +99,25 @@ typedef struct {
      @note Memory-mapped I/O is always disabled on macOS to prevent database corruption,
            so setting mmapDisabled value has no effect on the macOS platform. */
     bool mmapDisabled;
+
+    /** The maximum number of compiled queries the database keeps for reuse. When this is nonzero,
+        \ref CBLDatabase_CreateQuery returns a query sharing the already compiled form of a
+        recently created query with the same language and text, instead of compiling it again.
+        Each returned query still has its own parameters. Zero disables the cache. */
+    uint32_t queryCacheSize;
+
+    /** Enables group commit, if nonzero: a document save that isn't part of an explicit
+        transaction waits up to this many milliseconds for saves on other threads, and then all
+        of them are committed in one transaction, with one disk sync. Each save still returns
+        its own result, once the transaction has been committed. This raises the throughput of
+        concurrent writers, especially with `fullSync`, at the cost of the added latency.
+        Zero (the default) commits each save by itself. */
+    uint32_t groupCommitWindow;
+
+    /** The maximum number of asynchronous writes, such as \ref CBLCollection_SaveDocumentAsync,
+        that can be waiting to be performed; more fail with \ref kCBLErrorBusy.
+        Zero means \ref kCBLDefaultAsyncWriteLimit. */
+    uint32_t asyncWriteLimit;
 } CBLDatabaseConfiguration;
 
 /** Returns the default database configuration. */
@@ -145,7 +164,12 @@ bool CBL_DatabaseExists(FLString name, FLString inDirectory) CBLAPI;
     @param toName  The new database name (without the ".cblite2" extension.)
     @param config  The database configuration (directory and encryption option.)
     @param outError  On return, will be set to the error that occurred, if applicable.
-    @note While a database is open, one or more of its files may be in use.  Attempting to copy a file, while it is in use, will fail.  We recommend that you close a database before attempting to copy it. */
+    @note While a database is open, one or more of its files may be in use.  Attempting to copy a file, while it is in use, will fail.  We recommend that you close a database before attempting to copy it.
+    @note The files are copied by LiteCore, which then opens the copy to give it its new UUIDs,
+          so the copy can't simply share the original's storage. Where LiteCore's file copy
+          uses the filesystem's cloning, a copy on the same volume as the original is fastest;
+          for a prebuilt database shipped with an app, that means unpacking it onto the same
+          volume as the destination directory. */
 bool CBL_CopyDatabase(FLString fromPath,
                       FLString toName,
                       const CBLDatabaseConfiguration* _cbl_nullable config,
@@ -197,6 +221,22 @@ CBL_REFCOUNTED(CBLDatabase*, Database);
 bool CBLDatabase_Delete(CBLDatabase*,
                         CBLError* _cbl_nullable outError) CBLAPI;
 
+/** Returns a read-only connection to the same database file, for reading on other threads
+    without waiting for this instance, for instance while it's in a long transaction. Documents,
+    queries and counts read through the reader don't take this instance's lock, and SQLite lets
+    them run alongside a write transaction; each read sees the database as of the last commit.
+    (Successive reads may see different commits.) Writing through it fails with
+    \ref kCBLErrorNotWriteable.
+    The readers come from a small pool kept by the database. Release a reader with
+    \ref CBLDatabase_Release when done, which returns it to the pool; don't close it. Readers are
+    closed when this database is closed.
+    @param db  The database.
+    @param outError  On failure, the error will be written here.
+    @return  The reader, or NULL on failure. */
+_cbl_warn_unused
+CBLDatabase* _cbl_nullable CBLDatabase_AcquireReader(CBLDatabase* db,
+                                                     CBLError* _cbl_nullable outError) CBLAPI;
+
 /** Begins a transaction. You **must** later call \ref
     CBLDatabase_EndTransaction to commit or abort the transaction.
     @note  Multiple writes are much faster when grouped in a transaction.
@@ -220,6 +260,68 @@ bool CBLDatabase_EndTransaction(CBLDatabase*,
 bool CBLDatabase_ChangeEncryptionKey(CBLDatabase*,
                                      const CBLEncryptionKey* _cbl_nullable newKey,
                                      CBLError* outError) CBLAPI;
+
+/** Progress of an incremental change of encryption key, from \ref CBLDatabase_RekeyStep. */
+typedef struct {
+    uint64_t documentsCopied;       ///< Documents copied by this step
+    uint64_t blobsCopied;           ///< Blobs copied by this step
+    uint64_t sequencesRemaining;    ///< At most this many changes are left to copy
+} CBLRekeyProgress;
+
+/** Changes a database's encryption key a step at a time, while the database stays usable;
+    an alternative to \ref CBLDatabase_ChangeEncryptionKey, which blocks the database until
+    all of it has been re-encrypted.
+
+    Each step copies up to \p maxDocuments changed documents, and the blobs they refer to, into
+    a copy of the database encrypted with \p newKey, alongside it in the same directory. The
+    copy is read from a separate connection, so other threads can keep reading and writing.
+    Progress is saved in the copy, so steps can continue after the app restarts, as long as
+    they're given the same key. Call steps until \p sequencesRemaining is small, then call
+    \ref CBLDatabase_FinishRekey.
+
+    Everything in the database is copied: documents with their revision history, expirations
+    and blobs, the value indexes, suspended index definitions, the database's UUIDs, and the
+    remote databases it has replicated with and the revisions each is known to have. Only
+    replicators' checkpoints aren't, since they can't be listed; so the first replication
+    after the rekey checks the remote's changes from the start, though it transfers nothing
+    the remote already has, and sees no conflicts that aren't. A step fails with
+    \ref kCBLErrorUnsupported, leaving the database as it was, if the database has state that
+    can't be copied:
+    - It has an index other than a value index, whose options can't be read back. Delete the
+      index before the rekey and recreate it afterwards.
+    - A document has a conflict. Resolve it first.
+    @param db  The database.
+    @param newKey  The new key, or NULL to decrypt the database.
+    @param maxDocuments  The most documents to copy in this step.
+    @param outProgress  On success, the progress made.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false on failure. */
+bool CBLDatabase_RekeyStep(CBLDatabase* db,
+                           const CBLEncryptionKey* _cbl_nullable newKey,
+                           uint64_t maxDocuments,
+                           CBLRekeyProgress* _cbl_nullable outProgress,
+                           CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Finishes a change of encryption key begun by \ref CBLDatabase_RekeyStep: copies the
+    remaining changes, stops the database's replicators and live queries, checks every document
+    of the copy against the database, and replaces the database with its re-encrypted copy.
+    Like a step, it fails with \ref kCBLErrorUnsupported if the database has state that can't
+    be copied. Other threads can keep writing while every document is checked; the database
+    is only blocked while the documents changed meanwhile are copied and checked, then it's
+    closed; reopen it with the new key. If the app exits while the copy is replacing the
+    database, the next \ref CBLDatabase_Open completes the replacement.
+    @param db  The database. It's closed on success, but must still be released.
+    @param newKey  The new key, the same one given to the steps.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false on failure. */
+bool CBLDatabase_FinishRekey(CBLDatabase* db,
+                             const CBLEncryptionKey* _cbl_nullable newKey,
+                             CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Abandons a change of encryption key begun by \ref CBLDatabase_RekeyStep, deleting the
+    partial copy of the database. */
+bool CBLDatabase_CancelRekey(CBLDatabase* db,
+                             CBLError* _cbl_nullable outError) CBLAPI;
 #endif
 
 /** Maintenance Type used when performing database maintenance. */
@@ -248,6 +350,212 @@ bool CBLDatabase_PerformMaintenance(CBLDatabase* db,
                                     CBLMaintenanceType type,
                                     CBLError* _cbl_nullable outError) CBLAPI;
 
+CBL_REFCOUNTED(CBLMaintenanceTask*, MaintenanceTask);
+
+/** The progress of a \ref CBLMaintenanceTask. Estimates are based on how long the same
+    operation last took on this database since it was opened; an operation that hasn't been
+    performed yet is estimated, on the high side, from the size of the database file. */
+typedef struct {
+    unsigned stepsCompleted;            ///< Operations performed so far
+    unsigned stepsRemaining;            ///< Operations not performed yet
+    uint64_t nextStepEstimatedMs;       ///< Estimated duration of the next operation
+    uint64_t estimatedRemainingMs;      ///< Estimated duration of all the remaining operations
+} CBLMaintenanceProgress;
+
+/** Creates a task that performs a list of maintenance operations in order, a few at a time, as
+    \ref CBLMaintenanceTask_Run is called with a time budget. The task remembers which
+    operations it has performed, and the database is free for other work between calls, so
+    maintenance can be spread over idle periods instead of taking the database offline.
+    @note  Each operation, such as compaction, is performed by LiteCore as a single step that
+           holds the database until it's finished, so an operation can't be spread over several
+           calls. Use \ref CBLMaintenanceProgress.nextStepEstimatedMs to schedule a long one.
+    @note  You must release the task when you're finished with it.
+    @param db  The database.
+    @param types  The maintenance operations to perform, in order.
+    @param count  The number of operations in \p types.
+    @param outError  On failure, the error will be written here.
+    @return  The new task, or NULL if a type is invalid. */
+_cbl_warn_unused
+CBLMaintenanceTask* _cbl_nullable CBLDatabase_CreateMaintenanceTask(CBLDatabase* db,
+                                                                    const CBLMaintenanceType types[_cbl_nonnull],
+                                                                    size_t count,
+                                                                    CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Performs the task's next maintenance operations, as many as are expected to finish within
+    the budget. The next operation is always performed, even if it's expected to take longer,
+    so that every call makes progress; with a budget of 0, exactly one operation is performed.
+    If an operation fails, it remains the next one, and the error is returned.
+    @param task  The maintenance task.
+    @param budgetMs  The time the operations should take, in milliseconds.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false if an operation failed. */
+bool CBLMaintenanceTask_Run(CBLMaintenanceTask* task,
+                            uint32_t budgetMs,
+                            CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Returns the progress of a maintenance task. When `stepsRemaining` is 0, the task is done. */
+CBLMaintenanceProgress CBLMaintenanceTask_Progress(const CBLMaintenanceTask* task) CBLAPI;
+
+/** Enables background maintenance of the database: the given operations are performed, in
+    order, when the OS schedules maintenance. See \ref CBL_RunBackgroundMaintenance.
+    Enabling it again replaces the operations. It stays enabled until the database is closed
+    or \ref CBLDatabase_DisableBackgroundMaintenance is called.
+    @note  The database is retained while background maintenance is enabled.
+    @param db  The database.
+    @param types  The maintenance operations to perform, in order.
+    @param count  The number of operations in \p types.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false if a type is invalid or the database is closing. */
+bool CBLDatabase_EnableBackgroundMaintenance(CBLDatabase* db,
+                                             const CBLMaintenanceType types[_cbl_nonnull],
+                                             size_t count,
+                                             CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Disables background maintenance of the database. If an operation is being performed, this
+    waits for it to finish. */
+void CBLDatabase_DisableBackgroundMaintenance(CBLDatabase* db) CBLAPI;
+
+/** Returns statistics about the database's storage, to help decide when maintenance such as
+    compaction is worthwhile. The result is a dictionary with these keys:
+    - `totalBytes`: The size of all the database's files.
+    - `databaseBytes`: The size of the main database file.
+    - `walBytes`, `sharedMemoryBytes`: The sizes of SQLite's write-ahead log and its index.
+      A large WAL means there are commits that haven't been checkpointed yet.
+    - `blobCount`, `blobBytes`: The number and size of the blobs in the blob store.
+    - `sharedKeys`: A dictionary with the `count` of property names in the database's table of
+      shared keys, and its `capacity`. Documents store a shared property name as a small
+      number; once the table is full, new names are stored in full in every document using
+      them. The table is shared by all the database's collections, so collections with many
+      distinct property names can fill it; storing them in separate databases avoids that.
+    - `collections`: A dictionary from each collection's full name (`scope.collection`) to a
+      dictionary with its `documentCount` and `lastSequence`.
+    - `maintenance`: A dictionary from each maintenance operation performed since the database was
+      opened (`compact`, `reindex`, `integrityCheck`, `optimize`, `fullOptimize`) to a dictionary
+      with its `count` and `lastDurationMs`; `compact` also has `lastReclaimedBytes`, the amount
+      by which the last compaction shrank the database's files.
+    @note  The database file's internal layout, such as its free pages, isn't available, so the
+           space a compaction would reclaim can only be judged from the files' sizes.
+    @note  You are responsible for releasing the returned dictionary.
+    @param db  The database.
+    @param outError  On failure, the error will be written here.
+    @return  The statistics, or NULL on failure. */
+_cbl_warn_unused
+FLDict _cbl_nullable CBLDatabase_GetStorageStats(const CBLDatabase* db,
+                                                 CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Options for \ref CBLDatabase_Export and \ref CBLDatabase_ExportToFile. */
+typedef struct {
+    /** The checkpoint returned by a previous export, to export only the documents that have
+        changed since it, including deletions; or NULL to export every document. */
+    FLDict _cbl_nullable since;
+    
+    /** The size of the chunks passed to the callback. 0 means \ref kCBLDefaultExportChunkSize. */
+    size_t chunkSize;
+    
+    /** The most bytes to export per second, to leave the disk to the app; 0 means no limit. */
+    uint64_t maxBytesPerSecond;
+} CBLExportOptions;
+
+/** Called by \ref CBLDatabase_Export with each chunk of the export, in order.
+    Returns false if the chunk couldn't be written, to stop the export. */
+typedef bool (*CBLExportWriteCallback)(void* _cbl_nullable context, FLSlice chunk);
+
+/** Exports a consistent snapshot of an open database, while other threads go on using it, as a
+    stream of JSON Lines passed to a callback in chunks. The lines are:
+    - `{"type":"header", "version":1, "database":..., "incremental":...}`
+    - For each collection, `{"type":"collection", "scope":..., "name":...}`, followed by its
+      documents: `{"type":"document", "id":..., "revisionID":..., "sequence":..., "body":{...}}`,
+      or `"deleted":true` instead of a body for a deletion in an incremental export.
+      Each blob is exported before the first document that refers to it, as
+      `{"type":"blob", "digest":..., "data":...}` with the contents base64-encoded.
+      A collection that was deleted since the checkpoint appears with `"deleted":true`.
+    - `{"type":"end", "checkpoint":{...}}`
+    The export reads from its own connection to the database, so it doesn't block writers,
+    and it sees the database as it was when it started.
+    @note  The callback is called on the calling thread.
+    @note  You are responsible for releasing the returned checkpoint.
+    @param db  The database.
+    @param options  The options, or NULL for the defaults.
+    @param callback  The function that writes each chunk.
+    @param context  An arbitrary value to be passed to the callback.
+    @param outError  On failure, the error will be written here. If the callback stopped the
+                     export, the error is \ref kCBLErrorIOError.
+    @return  A checkpoint dictionary, which can be passed as \ref CBLExportOptions.since to a
+             later export, or NULL on failure. */
+_cbl_warn_unused
+FLDict _cbl_nullable CBLDatabase_Export(CBLDatabase* db,
+                                        const CBLExportOptions* _cbl_nullable options,
+                                        CBLExportWriteCallback callback,
+                                        void* _cbl_nullable context,
+                                        CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Exports a snapshot of an open database to a file, as described by \ref CBLDatabase_Export.
+    The file is replaced if it exists, and deleted if the export fails.
+    @note  You are responsible for releasing the returned checkpoint.
+    @param db  The database.
+    @param path  The path of the file to write.
+    @param options  The options, or NULL for the defaults.
+    @param outError  On failure, the error will be written here.
+    @return  A checkpoint dictionary, or NULL on failure. */
+_cbl_warn_unused
+FLDict _cbl_nullable CBLDatabase_ExportToFile(CBLDatabase* db,
+                                              FLString path,
+                                              const CBLExportOptions* _cbl_nullable options,
+                                              CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Called when \ref CBLDatabase_Prewarm has finished, with an estimate of the bytes it read. */
+typedef void (*CBLDatabasePrewarmCallback)(void* _cbl_nullable context, uint64_t bytesRead);
+
+/** Reads value indexes, and then the documents of their collections, on a background thread,
+    so that the first queries after opening the database find them in SQLite's page cache and
+    the filesystem cache instead of waiting for the disk.
+    @param db  The database.
+    @param indexNames  The names of the value indexes to read, in any collection, or NULL to read
+                       every value index and every collection.
+    @param budgetBytes  Stops reading after about this many bytes; 0 means no limit. Indexes are
+                        read before documents, in the order given.
+    @param callback  An optional function to call when it's done.
+    @param context  An arbitrary value to be passed to the callback. */
+void CBLDatabase_Prewarm(CBLDatabase* db,
+                         FLArray _cbl_nullable indexNames,
+                         uint64_t budgetBytes,
+                         CBLDatabasePrewarmCallback _cbl_nullable callback,
+                         void* _cbl_nullable context) CBLAPI;
+
+/** How much cached memory \ref CBL_TrimMemory and \ref CBLDatabase_TrimMemory release. */
+typedef CBL_ENUM(uint32_t, CBLMemoryTrimLevel) {
+    /// Releases the least recently used half of the caches.
+    kCBLMemoryTrimModerate,
+    /// Empties the caches, as when the app is about to be killed for lack of memory.
+    kCBLMemoryTrimCritical
+};
+
+/** What \ref CBL_TrimMemory or \ref CBLDatabase_TrimMemory released. */
+typedef struct {
+    uint64_t bytesFreed;            ///< Bytes of cached predictions and pooled objects freed
+    uint32_t queriesReleased;       ///< Compiled queries dropped from the query cache
+} CBLMemoryTrimStats;
+
+/** Releases memory cached by this library that isn't tied to a database, for instance when the
+    OS signals memory pressure: the outputs cached by predictive models (see `cacheSize` in
+    \ref CBLPredictiveModel), and the free lists of documents and result sets kept by each
+    thread. The calling thread's lists are freed at once and counted in `bytesFreed`; other
+    threads free theirs the next time they create or release a document or result set.
+    Outputs precomputed by \ref CBL_PrecomputePredictions are kept.
+    @param level  How much to release.
+    @return  What was released. */
+CBLMemoryTrimStats CBL_TrimMemory(CBLMemoryTrimLevel level) CBLAPI;
+
+/** Does the same as \ref CBL_TrimMemory, and also releases compiled queries from the database's
+    query cache (see `queryCacheSize` in \ref CBLDatabaseConfiguration). The memory of a dropped
+    query is freed once no \ref CBLQuery created from it is left; it isn't counted in
+    `bytesFreed`, since its size isn't known. SQLite's page cache is managed by LiteCore and
+    isn't affected.
+    @param db  The database.
+    @param level  How much to release.
+    @return  What was released. */
+CBLMemoryTrimStats CBLDatabase_TrimMemory(CBLDatabase* db, CBLMemoryTrimLevel level) CBLAPI;
+
 /** @} */
 
 #ifdef __APPLE__
@@ -397,6 +705,38 @@ void CBLDatabase_BufferNotifications(CBLDatabase *db,
 /** Immediately issues all pending notifications for this database, by calling their listener
     callbacks. */
 void CBLDatabase_SendNotifications(CBLDatabase *db) CBLAPI;
+
+/** A batch of pending notifications that belong together, such as consecutive changes to one
+    collection, or to one query's results. */
+typedef struct CBLNotificationWorkItem CBLNotificationWorkItem;
+
+/** Callback that runs notifications on the application's own threads. It's given a work item,
+    which the application must eventually run, exactly once, by calling
+    \ref CBLNotificationWorkItem_Run on whatever thread it chooses.
+    Work items for different collections (or queries, or replicators) may run in parallel, but
+    the database won't hand out another work item for the same one until the previous one has
+    run, so its listeners are still called in order.
+    @warning  This can be called from arbitrary threads, including from inside
+              \ref CBLNotificationWorkItem_Run. It should do as little work as possible, just
+              scheduling the work item. */
+typedef void (*CBLNotificationExecutor)(void* _cbl_nullable context,
+                                        CBLDatabase* db,
+                                        CBLNotificationWorkItem* item);
+
+/** Dispatches this database's notifications to an executor, such as a thread pool, instead of
+    calling them immediately. This replaces \ref CBLDatabase_BufferNotifications; setting either
+    one turns the other off. Passing a NULL executor goes back to immediate notifications.
+    @param db  The database whose notifications are to be dispatched.
+    @param executor  The function to be called with each batch of notifications.
+    @param context  An arbitrary value that will be passed to the executor. */
+void CBLDatabase_SetNotificationExecutor(CBLDatabase *db,
+                                         CBLNotificationExecutor _cbl_nullable executor,
+                                         void* _cbl_nullable context) CBLAPI;
+
+/** Calls the listeners for all the notifications in a work item, then frees it.
+    @warning  Every work item must be run exactly once, or its notifications (and any later ones
+              for the same collection or query) will never be delivered. */
+void CBLNotificationWorkItem_Run(CBLNotificationWorkItem *item) CBLAPI;
                                      
 /** @} */
 /** @} */    // end of outer \defgroup
@@ -44,6 +44,30 @@ CBL_PUBLIC extern const bool kCBLDefaultDatabaseFullSync;
 /** [false] Memory mapped database files are enabled by default */
 CBL_PUBLIC extern const bool kCBLDefaultDatabaseMmapDisabled;
 
+/** [0] The cache of compiled queries is disabled by default */
+CBL_PUBLIC extern const uint32_t kCBLDefaultDatabaseQueryCacheSize;
+
+/** [1000] At most 1000 asynchronous writes can be waiting to be performed, by default */
+CBL_PUBLIC extern const uint32_t kCBLDefaultAsyncWriteLimit;
+
+/** @} */
+
+/** \name CBLImportOptions
+    @{
+*/
+
+/** [10000] Imported documents are saved in transactions of 10000, by default */
+CBL_PUBLIC extern const uint32_t kCBLDefaultImportBatchSize;
+
+/** @} */
+
+/** \name CBLExportOptions
+    @{
+*/
+
+/** [65536] Exports are written in 64 KiB chunks, by default */
+CBL_PUBLIC extern const size_t kCBLDefaultExportChunkSize;
+
 /** @} */
 
 /** \name CBLLogFileConfiguration
@@ -106,6 +130,12 @@ CBL_PUBLIC extern const bool kCBLDefaultReplicatorDisableAutoPurge;
 /** [false] Whether or not a replicator only accepts cookies for the sender's parent domains */
 CBL_PUBLIC extern const bool kCBLDefaultReplicatorAcceptParentCookies;
 
+/** [4] Up to 4 conflicts are resolved at once */
+CBL_PUBLIC extern const unsigned kCBLDefaultReplicatorMaxConcurrentConflictResolvers;
+
+/** [50] Up to 50 conflict resolutions are saved in one transaction */
+CBL_PUBLIC extern const unsigned kCBLDefaultReplicatorConflictResolverBatchSize;
+
 /** @} */
 
 #ifdef COUCHBASE_ENTERPRISE
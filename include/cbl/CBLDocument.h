@@ -75,6 +75,13 @@ const CBLDocument* _cbl_nullable CBLDatabase_GetDocument(const CBLDatabase* data
 
 CBL_REFCOUNTED(CBLDocument*, Document);
 
+/** Releases every document in an array, such as the one filled in by
+    \ref CBLCollection_GetDocuments. NULL entries are skipped.
+    @param docs  The documents to release.
+    @param count  The number of entries in \p docs. */
+void CBLDocument_ReleaseAll(const CBLDocument* _cbl_nullable docs[_cbl_nonnull],
+                            size_t count) CBLAPI;
+
 /** Saves a (mutable) document to the default collection.
     @warning If a newer revision has been saved since \p doc was loaded, it will be overwritten by
             this one. This can lead to data loss! To avoid this, call
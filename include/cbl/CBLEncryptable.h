@@ -156,6 +156,30 @@ static inline const CBLEncryptable* _cbl_nullable FLValue_GetEncryptableValue(FL
     return FLDict_GetEncryptableValue(FLValue_AsDict(value));
 }
 
+/** Returns the value of an encryptable dictionary, or NULL if the dictionary is not a
+    \ref CBLEncryptable. Unlike \ref FLDict_GetEncryptableValue, it reads the value in place,
+    without creating a \ref CBLEncryptable object for the dictionary. */
+FLValue _cbl_nullable FLDict_GetEncryptableContent(FLDict _cbl_nullable encryptableDict) CBLAPI;
+
+/** Returns the value of an encryptable dictionary, or NULL if the value is not a
+    \ref CBLEncryptable, without creating a \ref CBLEncryptable object. */
+static inline FLValue _cbl_nullable FLValue_GetEncryptableContent(FLValue _cbl_nullable value) {
+    return FLDict_GetEncryptableContent(FLValue_AsDict(value));
+}
+
+/** \name Setting scalar encryptables directly
+    @{
+    These put a new encryptable dictionary holding the value into a mutable dictionary's slot,
+    without creating a \ref CBLEncryptable object that has to be released afterwards.
+    The result is the same as setting a \ref CBLEncryptable created with the value. */
+void FLSlot_SetEncryptableNull(FLSlot slot) CBLAPI;
+void FLSlot_SetEncryptableBool(FLSlot slot, bool value) CBLAPI;
+void FLSlot_SetEncryptableInt(FLSlot slot, int64_t value) CBLAPI;
+void FLSlot_SetEncryptableUInt(FLSlot slot, uint64_t value) CBLAPI;
+void FLSlot_SetEncryptableDouble(FLSlot slot, double value) CBLAPI;
+void FLSlot_SetEncryptableString(FLSlot slot, FLString value) CBLAPI;
+/** @} */
+
 /** Set a \ref CBLEncryptable's dictionary into a mutable dictionary's slot. */
 void FLSlot_SetEncryptableValue(FLSlot slot, const CBLEncryptable* encryptable) CBLAPI;
 
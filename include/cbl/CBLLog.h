@@ -104,6 +104,137 @@ CBLLogCallback CBLLog_Callback(void) CBLAPI;
 /** Sets the callback for receiving log messages. If set to NULL, no messages are logged to the console. */
 void CBLLog_SetCallback(CBLLogCallback _cbl_nullable callback) CBLAPI;
 
+/** The types of the arguments of a \ref CBLLogRecord. */
+typedef CBL_ENUM(uint8_t, CBLLogArgType) {
+    kCBLLogArgInt,          ///< `intValue`, from `%d`, `%i` or `%c`
+    kCBLLogArgUInt,         ///< `uintValue`, from `%u`, `%o`, `%x` or `%X`
+    kCBLLogArgDouble,       ///< `doubleValue`, from `%f`, `%e`, `%g` or `%a`
+    kCBLLogArgString,       ///< `stringValue`, from `%s` or `%.*s`; null if the string was NULL
+    kCBLLogArgPointer       ///< `uintValue`, from `%p`
+};
+
+/** An argument of a \ref CBLLogRecord. Only the field its type names is set. */
+typedef struct {
+    CBLLogArgType type;
+    int64_t intValue;
+    uint64_t uintValue;
+    double doubleValue;
+    FLString stringValue;
+} CBLLogArg;
+
+/** A log message, as given to a \ref CBLStructuredLogCallback: its format and arguments, not
+    yet formatted. Its strings and arguments are only valid during the callback. */
+typedef struct {
+    CBLLogDomain domain;            ///< The domain, or \ref kCBLLogDomainDatabase if it's not one of them
+    FLString domainName;            ///< LiteCore's name for the domain, e.g. "Sync" or "BLIPMessages"
+    CBLLogLevel level;              ///< The severity level
+    uint64_t timestamp;             ///< A monotonic time in nanoseconds, from an arbitrary start
+    FLString objectID;              ///< The object that logged it, e.g. "Repl#12", or null
+    FLString format;                ///< The `printf`-style format, without the object ID
+    const CBLLogArg* args;          ///< The arguments of the format
+    size_t argCount;                ///< The number of arguments (at most 32)
+} CBLLogRecord;
+
+/** A logging callback that receives messages unformatted, so that it can record their
+    arguments as data, and format them only if needed.
+    @param record  The message. */
+typedef void (*CBLStructuredLogCallback)(const CBLLogRecord* record);
+
+/** Gets the current structured log callback. */
+CBLStructuredLogCallback _cbl_nullable CBLLog_StructuredCallback(void) CBLAPI;
+
+/** Sets a callback that receives log messages unformatted, at or above the level set by
+    \ref CBLLog_SetCallbackLevel. It can be set along with the regular callback; then messages
+    are only formatted if the regular callback or the console takes them.
+    @note  The structured callback is always called on the thread that logged, even in async
+           mode, since the arguments only live as long as the call.
+    @note  Messages logged with \ref CBL_LogMessage have the format "%.*s". */
+void CBLLog_SetStructuredCallback(CBLStructuredLogCallback _cbl_nullable callback) CBLAPI;
+
+/** @} */
+
+
+
+/** \name Log Domain Levels and Throttling
+    @{
+    By default every domain logs at every level, and messages are filtered by the console,
+    callback and file levels after they're generated. A domain's own level filters its messages
+    in LiteCore, before they're formatted, for every kind of logging. A throttle samples and
+    rate-limits a busy domain's messages for the console and the callbacks.
+    Domains are named as in LiteCore: "DB", "Query", "Sync", "WS", and more detailed ones such
+    as "SyncBusy", "Changes", "BLIPMessages", "TLS" and "Zip". */
+
+/** Gets a domain's level, or \ref kCBLLogNone if there's no such domain. */
+CBLLogLevel CBLLog_DomainLevel(FLString domain) CBLAPI;
+
+/** Sets the lowest level a domain logs at, for all kinds of logging.
+    @return  True, or false if there's no such domain. */
+bool CBLLog_SetDomainLevel(FLString domain, CBLLogLevel level) CBLAPI;
+
+/** How to thin out a domain's messages below \ref kCBLLogWarning. Warnings and errors
+    always pass. */
+typedef struct {
+    /** Pass 1 message in this many; 0 or 1 passes all. */
+    uint32_t sampleRate;
+    
+    /** The most messages per second to pass from each place they're logged from (each
+        format string); 0 means no limit. Places are told apart by the address of the format
+        string, so use a string literal as the format of \ref CBL_Log; messages with formats
+        built at run time may share a limit. */
+    uint32_t maxPerSecond;
+} CBLLogThrottle;
+
+/** Sets a domain's throttle, applied before its messages are formatted for the console and
+    the callbacks. (Log files are written at the domain's level, unthrottled.)
+    @param domain  The name of the domain.
+    @param throttle  The throttle; zeros turn it off.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false if there's no such domain. */
+bool CBLLog_SetDomainThrottle(FLString domain,
+                              CBLLogThrottle throttle,
+                              CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Returns the number of messages dropped by throttles. */
+uint64_t CBLLog_ThrottledMessageCount(void) CBLAPI;
+
+/** @} */
+
+/** \name Asynchronous Logging
+    @{
+    By default the console and the callback are written to on the thread that logged, which
+    slows down busy threads such as the replicator's when verbose logging is on. In async mode,
+    logging only copies the message into a lock-free ring buffer, and a background thread writes
+    it to the console and calls the callback. File logging isn't affected. */
+
+/** What to do with a message logged while the async log buffer is full. */
+typedef CBL_ENUM(uint8_t, CBLLogDropPolicy) {
+    kCBLLogDropNewest,      ///< Drop the new message.
+    kCBLLogDropOldest,      ///< Drop the oldest buffered message to make room.
+    kCBLLogBlock            ///< Wait for room. (Messages logged by the callback itself, or
+                            ///< while async logging is being turned off, are dropped.)
+};
+
+/** Options for \ref CBLLog_SetAsync. */
+typedef struct {
+    /** The number of messages the buffer holds, rounded up to a power of 2; 0 means 4096. */
+    uint32_t capacity;
+    
+    /** What to do with a message when the buffer is full. */
+    CBLLogDropPolicy dropPolicy;
+} CBLLogAsyncOptions;
+
+/** Turns async logging on with the given options, or off if NULL. Messages buffered when it's
+    turned off or the options change are delivered first. */
+void CBLLog_SetAsync(const CBLLogAsyncOptions* _cbl_nullable options) CBLAPI;
+
+/** Waits until the messages logged so far in async mode have been written to the console and
+    passed to the callback. Does nothing if async logging is off, or if called by the callback. */
+void CBLLog_Flush(void) CBLAPI;
+
+/** Returns the number of messages dropped because the async log buffer was full, since async
+    logging was last turned on. */
+uint64_t CBLLog_DroppedMessageCount(void) CBLAPI;
+
 /** @} */
 
 
@@ -140,6 +271,58 @@ bool CBLLog_SetFileConfig(CBLLogFileConfiguration, CBLError* _cbl_nullable outEr
 
 /** @} */
 
+
+
+/** \name Tracing
+    @{
+    A trace callback receives an event when each traced operation begins and ends, so that it
+    can record them as spans, for instance with OpenTelemetry, and attribute latency to them.
+    Spans nest: an operation that runs within another one on the same thread, like the commit
+    of a save, is its child. While no callback is set, tracing costs one atomic load per
+    operation. */
+
+/** The operations that are traced. */
+typedef CBL_ENUM(uint8_t, CBLTraceOperation) {
+    kCBLTraceSave,                  ///< Saving or deleting a document, or a batch of them
+    kCBLTraceEncode,                ///< Encoding a document's properties
+    kCBLTraceBlobInstall,           ///< Installing a new blob into the database when saving
+    kCBLTraceCommit,                ///< Committing a transaction
+    kCBLTraceQueryCompile,          ///< Compiling a query (not when it comes from the cache)
+    kCBLTraceQueryExecute,          ///< Running a query
+    kCBLTraceQueryFirstRow,         ///< Reading a query's first result row
+    kCBLTraceIndexUpdate,           ///< Finishing an update of a lazy index
+    kCBLTraceConflictResolution,    ///< Resolving and saving a batch of replication conflicts
+    kCBLTraceReplicatorImport       ///< Handling a batch of documents a replicator pulled
+};
+
+/** A traced operation's begin or end event. Its strings are only valid during the callback. */
+typedef struct {
+    CBLTraceOperation operation;    ///< The operation
+    bool end;                       ///< False for the begin event, true for the end event
+    bool failed;                    ///< (End only) True if the operation failed
+    uint64_t traceID;               ///< The spanID of the outermost span this one is nested in
+    uint64_t spanID;                ///< Unique to the span; its begin and end events share it
+    uint64_t parentSpanID;          ///< The span this one is nested in, or 0
+    FLString subject;               ///< The document ID, query string, replicator, or null
+    uint64_t durationNanos;         ///< (End only) The operation's duration
+    uint64_t byteCount;             ///< (End only) Bytes encoded, installed, etc.; 0 if N/A
+    uint64_t itemCount;             ///< (End only) Documents saved, rows indexed, etc.; 0 if N/A
+} CBLTraceEvent;
+
+/** A trace callback. It's called on the thread doing the operation, so it should be quick.
+    @param context  The context given to \ref CBL_SetTraceCallback.
+    @param event  The event. */
+typedef void (*CBLTraceCallback)(void* _cbl_nullable context, const CBLTraceEvent* event);
+
+/** Sets the callback that receives trace events, or turns tracing off if it's NULL. Spans
+    that are already underway when the callback changes may only get one of their events.
+    The callback and context are replaced together, but this doesn't wait for calls already in
+    progress: the previous callback may still be called, with its own context, for a short time
+    after this returns, so don't free that context right away. */
+void CBL_SetTraceCallback(CBLTraceCallback _cbl_nullable callback, void* _cbl_nullable context) CBLAPI;
+
+/** @} */
+
 /** @} */
 
 CBL_CAPI_END
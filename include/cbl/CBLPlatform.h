@@ -49,6 +49,8 @@ typedef struct {
     to be called the first time before using the CouchbaseLite library otherwise an error will be
     returned when calling CBLDatabase_Open to open a database. Call \r CBL_Init more than once will
     return an error.
+    @note  To configure the threads that run background work, call \ref CBL_ConfigureThreadPool
+           too, right after this.
     @param context  The application context information.
     @param outError  On failure, the error will be written here. */
 bool CBL_Init(CBLInitContext context, CBLError* _cbl_nullable outError) CBLAPI;
@@ -57,4 +59,128 @@ bool CBL_Init(CBLInitContext context, CBLError* _cbl_nullable outError) CBLAPI;
 
 #endif
 
+
+/** \defgroup threads  Threads
+     @{
+    Couchbase Lite does some of its work on background threads: resolving replication conflicts,
+    saving documents asynchronously, building indexes, prewarming databases and calling
+    predictive models. By default it shares LiteCore's internal threads, which it can't size or
+    prioritize, except for long-running work (asynchronous saves, index builds and prewarming),
+    which gets a few threads of its own; a thread pool configuration gives all of it threads of
+    its own, or an executor of the app's, instead.
+    @note  This doesn't change the threads that LiteCore itself runs the replicator and live
+           query observers on. Listener callbacks can be moved to the app's threads with
+           \ref CBLDatabase_BufferNotifications or \ref CBLDatabase_SetNotificationExecutor. */
+
+/** The scheduling priority of the pool's threads, relative to the app's. */
+typedef CBL_ENUM(uint32_t, CBLThreadPriority) {
+    kCBLThreadPriorityNormal,           ///< The platform's default
+    kCBLThreadPriorityLow,              ///< Below normal, leaving the CPU to the app's threads
+    kCBLThreadPriorityHigh              ///< Above normal, if the process is allowed to raise it
+};
+
+/** A background task; an executor calls it with the task context. */
+typedef void (*CBLTask)(void* _cbl_nullable taskContext);
+
+/** A function that runs a task asynchronously, on a thread of its choice.
+    @param executorContext  The `executorContext` of the \ref CBLThreadPoolConfiguration.
+    @param task  The task to run, by calling `task(taskContext)`. It must be run exactly once,
+                 and not on the calling thread before this function returns.
+    @param taskContext  The value to pass to the task. */
+typedef void (*CBLTaskExecutor)(void* _cbl_nullable executorContext,
+                                CBLTask task,
+                                void* _cbl_nullable taskContext);
+
+/** The configuration of the threads that run background work. */
+typedef struct {
+    /** The number of worker threads; 0 to use LiteCore's shared threads, which is the default.
+        Tasks queue up while all the workers are busy, so a few are usually enough. */
+    unsigned workerCount;
+
+    /** The priority of the worker threads. */
+    CBLThreadPriority priority;
+
+    /** The CPUs the worker threads may run on, as a bitmask (bit N being CPU N), or 0 for any.
+        Supported on Linux, Android and Windows; ignored on Apple platforms, which don't allow
+        setting affinity. */
+    uint64_t cpuAffinity;
+
+    /** An executor to run the tasks instead of worker threads, or NULL. If this is set, the other
+        fields are ignored. */
+    CBLTaskExecutor _cbl_nullable executor;
+
+    /** The value to pass to the executor. */
+    void* _cbl_nullable executorContext;
+} CBLThreadPoolConfiguration;
+
+/** The largest allowed \ref CBLThreadPoolConfiguration.workerCount. */
+#define kCBLMaxThreadPoolWorkers 64
+
+/** Configures the threads that run Couchbase Lite's background work. This must be called before
+    any is started, so preferably before opening a database; afterwards it fails with
+    \ref kCBLErrorUnsupported. It may be called more than once until then; the last
+    configuration is used.
+    @param config  The configuration.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false if the configuration is invalid or it's too late. */
+bool CBL_ConfigureThreadPool(const CBLThreadPoolConfiguration* config,
+                             CBLError* _cbl_nullable outError) CBLAPI;
+
+/** @} */
+
+
+/** \defgroup background_maintenance  Background Maintenance
+     @{
+    Maintenance such as compaction is best done while the device is idle and charging, rather
+    than while the user is waiting. A database's maintenance operations can be enabled with
+    \ref CBLDatabase_EnableBackgroundMaintenance, to be performed when the OS schedules it:
+
+    * On iOS and tvOS, \ref CBL_RegisterBackgroundMaintenanceTask registers a `BGProcessingTask`
+      that requires external power, which the OS runs while the device is idle.
+
+    * On Android, schedule a WorkManager `Worker` whose constraints require the device to be
+      idle and charging. Its `doWork` should call \ref CBL_RunBackgroundMaintenance, and its
+      `onStopped` \ref CBL_CancelBackgroundMaintenance, through JNI.
+
+    * Elsewhere, call \ref CBL_RunBackgroundMaintenance from whatever the app uses to schedule
+      work. */
+
+/** Performs the maintenance of the databases that have it enabled, one operation at a time,
+    continuing where the last call left off. Each database's operations are performed in order;
+    once every database's have been performed, the next call starts them all over.
+    Like \ref CBLMaintenanceTask_Run, an operation is only started if it's expected to finish
+    within the budget, except that the first one is always started.
+    A failed operation is logged, and remains the database's next one.
+    @param budgetMs  The time the operations should take, in milliseconds.
+    @return  True if every database's operations have been performed; false if some remain
+             because of the budget, a failure or \ref CBL_CancelBackgroundMaintenance. */
+bool CBL_RunBackgroundMaintenance(uint32_t budgetMs) CBLAPI;
+
+/** Makes a running \ref CBL_RunBackgroundMaintenance return as soon as its current operation
+    finishes, e.g. when the OS ends the app's background time; a call that's waiting for another
+    to finish returns without starting. Operations can't be interrupted. It has no effect on
+    calls made after it. */
+void CBL_CancelBackgroundMaintenance(void) CBLAPI;
+
+#ifdef __APPLE__
+
+/** Registers a `BGProcessingTask` that calls \ref CBL_RunBackgroundMaintenance, and schedules
+    it, requiring external power. When the OS expires the task, the maintenance is canceled; each
+    time the task runs, it's scheduled again. Only supported on iOS and tvOS 13 or later.
+    @note  This must be called before the app finishes launching, and the identifier must be
+           listed under `BGTaskSchedulerPermittedIdentifiers` in the app's Info.plist, or the
+           OS raises an exception.
+    @param identifier  The task identifier.
+    @param budgetMs  The budget for each run, in milliseconds.
+    @param outError  On failure, the error will be written here.
+    @return  True on success; false if the task couldn't be registered, or the platform doesn't
+             support background tasks. */
+bool CBL_RegisterBackgroundMaintenanceTask(FLString identifier,
+                                           uint32_t budgetMs,
+                                           CBLError* _cbl_nullable outError) CBLAPI;
+
+#endif
+
+/** @} */
+
 CBL_CAPI_END
@@ -31,16 +31,54 @@ typedef struct {
     /** Prediction callback, called from within a query (or document indexing) to run the prediction.
         @param context  The value of the CBLPredictiveModel's `context` field.
         @param input  The input dictionary from the query.
+        @note  May be NULL if `batchPrediction` is set; then single inputs are predicted by calling
+               `batchPrediction` with a count of 1.
         @return The output of the prediction function as an FLMutableDict, or NULL if there is no output.
         @note The output FLMutableDict will be automatically released after the prediction callback is called.
         @warning This function must be "pure": given the same input parameters it must always
                  produce the same output (otherwise indexes or queries may be messed up).
                  It MUST NOT alter the database or any documents, nor run a query: either of
                  those are very likely to cause a crash. */
-    FLMutableDict _cbl_nullable (* _cbl_nonnull prediction)(void* _cbl_nullable context, FLDict input);
+    FLMutableDict _cbl_nullable (* _cbl_nullable prediction)(void* _cbl_nullable context, FLDict input);
 
-    /** Unregistered callback, called if the model is unregistered, so it can release resources. */
+    /** Unregistered callback, called if the model is unregistered, so it can release resources.
+        If \ref CBL_PrecomputePredictions is running with the model, it's called when that returns. */
     void (*_cbl_nullable unregistered)(void* context);
+
+    /** Optional batch prediction callback, which runs the prediction on many inputs at once.
+        It's called by \ref CBL_PrecomputePredictions, whose results are then used by queries
+        and indexing instead of calling `prediction` for each of those inputs.
+        @param context  The value of the CBLPredictiveModel's `context` field.
+        @param inputs  The input dictionaries.
+        @param count  The number of inputs.
+        @param outputs  An array of `count` NULLs, in which the callback stores the output of the
+                        prediction of each input, or leaves NULL if there is no output.
+        @note The output FLMutableDicts will be automatically released after the callback returns.
+        @warning The same restrictions apply as to the `prediction` callback. */
+    void (*_cbl_nullable batchPrediction)(void* _cbl_nullable context,
+                                          const FLDict inputs[],
+                                          size_t count,
+                                          FLMutableDict _cbl_nullable outputs[]);
+
+    /** The maximum number of inputs passed to `batchPrediction` at once; 0 means 100. */
+    unsigned batchSize;
+
+    /** The maximum memory, in bytes, used to cache the model's outputs by input, so that an input
+        that has been predicted before isn't predicted again; when the cache is full, the least
+        recently used outputs are removed. 0 (the default) disables the cache.
+        Call \ref CBL_ClearPredictionCache if the model changes, to discard cached outputs. */
+    size_t cacheSize;
+
+    /** If nonzero, the maximum time in milliseconds that a query waits for a prediction. The
+        callback is then called on another thread, and if it hasn't returned in time the
+        prediction has no output; its output, once it returns, is kept to be used the next time
+        the same input is predicted. While two timed-out calls are still running, further
+        predictions that would need a new call have no output.
+        Index updates always wait for the prediction, so that no document is left out of the index.
+        @note  A query or an index update waiting for a prediction keeps the database's writers
+               waiting too. A slow model should also be run ahead of time with
+               \ref CBL_PrecomputePredictions, which calls it without holding the database's lock. */
+    unsigned timeout;
 } CBLPredictiveModel;
 
 /** Registers a predictive model.
@@ -52,6 +90,33 @@ void CBL_RegisterPredictiveModel(FLString name, CBLPredictiveModel model) CBLAPI
     @param name  The name of the registered predictive model. */
 void CBL_UnregisterPredictiveModel(FLString name) CBLAPI;
 
+/** Discards the outputs a predictive model has cached, and those precomputed for it by
+    \ref CBL_PrecomputePredictions, so that every input is predicted again. Call this when the
+    model changes; indexes using it need to be recreated to pick up the change.
+    @param name  The name of the registered predictive model.
+    @return  True if the model is registered, false if not. */
+bool CBL_ClearPredictionCache(FLString name) CBLAPI;
+
+/** Runs a registered model's `batchPrediction` callback on the inputs the model will be given
+    for the documents of a collection, and keeps the outputs, so that a query or an index that
+    calls `PREDICTION()` with the same input expression uses them instead of running the model
+    once per document. Call this before creating a predictive index, or before running a query
+    over many documents.
+    The kept outputs are used by every prediction of their inputs until they're discarded: each
+    call replaces the outputs kept by the last call, and \ref CBL_ClearPredictionCache or
+    unregistering the model discards them. They're kept regardless of the model's `cacheSize`.
+    @param name  The name of the registered predictive model.
+    @param collection  The collection whose documents will be used.
+    @param input  The input expression, in N1QL, as passed to `PREDICTION()`;
+                  for example "{\"word\": word}".
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false if the model isn't registered, has no `batchPrediction`
+             callback, or the input expression is invalid. */
+bool CBL_PrecomputePredictions(FLString name,
+                               const CBLCollection* collection,
+                               FLString input,
+                               CBLError* _cbl_nullable outError) CBLAPI;
+
 CBL_CAPI_END
 
 #endif
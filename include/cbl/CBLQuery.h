@@ -43,7 +43,8 @@ CBL_CAPI_BEGIN
 
 /** Creates a new query by compiling the input string.
     This is fast, but not instantaneous. If you need to run the same query many times, keep the
-    \ref CBLQuery around instead of compiling it each time. If you need to run related queries
+    \ref CBLQuery around instead of compiling it each time, or enable the database's query cache
+    with `queryCacheSize` in \ref CBLDatabaseConfiguration. If you need to run related queries
     with only some values different, create one query with placeholder parameter(s), and substitute
     the desired value(s) with \ref CBLQuery_SetParameters each time you run the query.
     @note  You must release the \ref CBLQuery when you're finished with it.
@@ -82,6 +83,69 @@ void CBLQuery_SetParameters(CBLQuery* query,
 /** Returns the query's current parameter bindings, if any. */
 FLDict _cbl_nullable CBLQuery_Parameters(const CBLQuery* query) CBLAPI;
 
+/** Assigns a value to one of the query's parameters, leaving the others unchanged.
+    This is cheaper than \ref CBLQuery_SetParameters when only one or two values change between
+    executions, as in paginated queries: the bindings are only encoded once, when the query
+    next runs.
+    @param query  The query.
+    @param name  The parameter name, without the `$`.
+    @param value  The parameter value. */
+void CBLQuery_SetParamInt64(CBLQuery* query, FLString name, int64_t value) CBLAPI;
+
+/** Assigns a floating-point value to one of the query's parameters, leaving the others unchanged.
+    See \ref CBLQuery_SetParamInt64. */
+void CBLQuery_SetParamDouble(CBLQuery* query, FLString name, double value) CBLAPI;
+
+/** Assigns a string value to one of the query's parameters, leaving the others unchanged.
+    See \ref CBLQuery_SetParamInt64. */
+void CBLQuery_SetParamString(CBLQuery* query, FLString name, FLString value) CBLAPI;
+
+/** Assigns a boolean value to one of the query's parameters, leaving the others unchanged.
+    See \ref CBLQuery_SetParamInt64. */
+void CBLQuery_SetParamBool(CBLQuery* query, FLString name, bool value) CBLAPI;
+
+/** Assigns a Fleece value, such as an array or dictionary, to one of the query's parameters,
+    leaving the others unchanged. The value is copied. See \ref CBLQuery_SetParamInt64. */
+void CBLQuery_SetParamValue(CBLQuery* query, FLString name, FLValue value) CBLAPI;
+
+/** Assigns a vector, i.e. an array of numbers, to one of the query's parameters, leaving the
+    others unchanged; for example the target vector of a vector search.
+    See \ref CBLQuery_SetParamInt64.
+    @param query  The query.
+    @param name  The parameter name, without the `$`.
+    @param vector  The vector's components.
+    @param dimensions  The number of components. */
+void CBLQuery_SetParamVector(CBLQuery* query, FLString name,
+                             const float vector[_cbl_nonnull], size_t dimensions) CBLAPI;
+
+/** Caches the query's results for up to `maxEntries` sets of parameter values; 0, the default,
+    disables the cache. Running the query again with the same parameters, before anything has
+    changed the database, then returns the same results without running it.
+    - Any commit that changes a collection, by this or another connection or by a replicator,
+      makes the cached results stale. So do creating and deleting collections.
+    - Results aren't cached inside an explicit transaction.
+    - A result set's results are cached when it's released, so result sets still in use are
+      never shared; running the query meanwhile runs it again.
+    - Executions with stats (\ref CBLQuery_ExecuteWithStats) always run the query.
+    - Results of an execution in which a predictive model timed out, leaving a `PREDICTION()`
+      without output, aren't cached.
+    - Only database changes make results stale, not time: don't enable the cache for queries
+      whose results depend on the current time, such as ones calling `NOW()` or
+      `STR_TO_MILLIS(NOW())`. */
+void CBLQuery_SetResultCacheSize(CBLQuery* query, uint32_t maxEntries) CBLAPI;
+
+/** Statistics of a query's result cache. (See \ref CBLQuery_SetResultCacheSize.) */
+typedef struct {
+    uint64_t hits;              ///< Executions that returned cached results
+    uint64_t misses;            ///< Executions that ran the query
+    uint64_t invalidations;     ///< Cached results dropped because the database had changed
+    uint32_t count;             ///< Sets of results currently cached
+} CBLQueryResultCacheStats;
+
+/** Returns the statistics of the query's result cache. All the values are zero if the cache
+    has never been enabled. */
+CBLQueryResultCacheStats CBLQuery_ResultCacheStats(const CBLQuery* query) CBLAPI;
+
 /** Runs the query, returning the results.
     To obtain the results you'll typically call \ref CBLResultSet_Next in a `while` loop,
     examining the values in the \ref CBLResultSet each time around.
@@ -90,6 +154,36 @@ _cbl_warn_unused
 CBLResultSet* _cbl_nullable CBLQuery_Execute(CBLQuery*,
                                              CBLError* _cbl_nullable outError) CBLAPI;
 
+/** Output formats for \ref CBLQuery_ExecuteToJSON. */
+typedef CBL_ENUM(uint32_t, CBLQueryJSONFormat) {
+    kCBLQueryJSONArray,     ///< A JSON array containing an object for each result
+    kCBLQueryNDJSON         ///< Newline-delimited JSON: an object for each result, each followed by a newline
+};
+
+/** A callback that receives the next chunk of a query's JSON output.
+    @param context  The value given to \ref CBLQuery_ExecuteToJSON.
+    @param chunk  The next chunk of output; it's only valid until the callback returns.
+    @return  True to continue, false to stop writing. */
+typedef bool (*CBLQueryJSONWriteCallback)(void* _cbl_nullable context, FLSlice chunk);
+
+/** Runs the query and writes its results as JSON, passing the output in chunks of several
+    kilobytes to the callback. Each result is written as an object mapping column names to
+    values, like \ref CBLResultSet_ResultDict. This avoids creating a dictionary and a JSON string
+    for every result, and the callback can apply backpressure simply by blocking.
+    @param query  The query.
+    @param callback  The callback that writes the output.
+    @param context  An arbitrary value passed to the callback.
+    @param format  Whether to write a JSON array or newline-delimited JSON.
+    @param outError  On failure, the error will be written here. If the callback stops writing,
+                     the error code will be 0.
+    @return  True if all the results were written, false if the query failed or the callback
+             stopped writing. */
+bool CBLQuery_ExecuteToJSON(CBLQuery* query,
+                            CBLQueryJSONWriteCallback callback,
+                            void* _cbl_nullable context,
+                            CBLQueryJSONFormat format,
+                            CBLError* _cbl_nullable outError) CBLAPI;
+
 /** Returns information about the query, including the translated SQLite form, and the search
     strategy. You can use this to help optimize the query: the word `SCAN` in the strategy
     indicates a linear scan of the entire database, which should be avoided by adding an index.
@@ -110,6 +204,20 @@ unsigned CBLQuery_ColumnCount(const CBLQuery*) CBLAPI;
 FLSlice CBLQuery_ColumnName(const CBLQuery*,
                             unsigned columnIndex) CBLAPI;
 
+/** Statistics of a database's cache of compiled queries.
+    (See `queryCacheSize` in \ref CBLDatabaseConfiguration.) */
+typedef struct {
+    uint64_t hits;              ///< Queries created from an already compiled query
+    uint64_t misses;            ///< Queries that had to be compiled
+    uint64_t evictions;         ///< Least recently used queries dropped to make room for others
+    uint64_t invalidations;     ///< Times the cache was emptied because indexes or collections changed
+    uint32_t count;             ///< Compiled queries currently in the cache
+} CBLQueryCacheStats;
+
+/** Returns the statistics of the database's cache of compiled queries. All the values are zero
+    if the cache is disabled. */
+CBLQueryCacheStats CBLDatabase_QueryCacheStats(const CBLDatabase* db) CBLAPI;
+
 /** @} */
 
 
@@ -140,6 +248,63 @@ FLSlice CBLQuery_ColumnName(const CBLQuery*,
 _cbl_warn_unused
 bool CBLResultSet_Next(CBLResultSet*) CBLAPI;
 
+/** Moves the result-set iterator forward by up to `maxRows` results at once, copying the column
+    values of each of them into `outValues`. This is much faster than calling
+    \ref CBLResultSet_Next and \ref CBLResultSet_ValueAtIndex for every row and column.
+    The values are stored row by row: column `c` of the `r`th row read is at
+    `outValues[r * columnCount + c]`, where `columnCount` is \ref CBLQuery_ColumnCount.
+    A `MISSING` value is stored as a NULL pointer.
+    Afterwards the current result is the last row read, as though \ref CBLResultSet_Next had been
+    called that many times.
+    @note  The values remain valid until the result set is released.
+    @param rs  The result set.
+    @param maxRows  The maximum number of results to read.
+    @param outValues  An array with room for at least `maxRows * columnCount` values.
+    @return  The number of results read; zero if there are no more. */
+_cbl_warn_unused
+size_t CBLResultSet_NextBatch(CBLResultSet* rs,
+                              size_t maxRows,
+                              FLValue _cbl_nullable outValues[_cbl_nonnull]) CBLAPI;
+
+/** Moves the result-set iterator forward by up to `maxRows` results at once, storing one column's
+    numeric value in each result into a contiguous array of doubles.
+    This lets numeric query output go straight into vectorized math code without a function call
+    per value. Afterwards the current result is the last row read.
+    @param rs  The result set.
+    @param column  The (zero-based) index of the column to read.
+    @param outValues  An array with room for at least `maxRows` values. A value that's `MISSING`,
+                      null or not a number is stored as 0.
+    @param maxRows  The maximum number of results to read.
+    @param outNullBitmap  If non-NULL, a bitmap with room for at least `(maxRows + 7) / 8` bytes.
+                      Bit `r % 8` of byte `r / 8` is set if the `r`th value was `MISSING`, null, or
+                      not a number, else it's cleared.
+    @return  The number of results read; zero if there are no more. */
+_cbl_warn_unused
+size_t CBLResultSet_ReadColumnDoubles(CBLResultSet* rs,
+                                      unsigned column,
+                                      double outValues[_cbl_nonnull],
+                                      size_t maxRows,
+                                      uint8_t* _cbl_nullable outNullBitmap) CBLAPI;
+
+/** Same as \ref CBLResultSet_ReadColumnDoubles, but stores the values as 64-bit integers.
+    Non-integral numbers are truncated. */
+_cbl_warn_unused
+size_t CBLResultSet_ReadColumnInt64s(CBLResultSet* rs,
+                                     unsigned column,
+                                     int64_t outValues[_cbl_nonnull],
+                                     size_t maxRows,
+                                     uint8_t* _cbl_nullable outNullBitmap) CBLAPI;
+
+/** Same as \ref CBLResultSet_ReadColumnDoubles, but stores string values. A value that's
+    `MISSING`, null or not a string is stored as a null slice, and flagged in the bitmap.
+    @note  The strings remain valid until the result set is released. */
+_cbl_warn_unused
+size_t CBLResultSet_ReadColumnStrings(CBLResultSet* rs,
+                                      unsigned column,
+                                      FLString outValues[_cbl_nonnull],
+                                      size_t maxRows,
+                                      uint8_t* _cbl_nullable outNullBitmap) CBLAPI;
+
 /** Returns the value of a column of the current result, given its (zero-based) numeric index.
     This may return a NULL pointer, indicating `MISSING`, if the value doesn't exist, e.g. if
     the column is a property that doesn't exist in the document. */
@@ -156,14 +321,23 @@ FLValue _cbl_nullable CBLResultSet_ValueForKey(const CBLResultSet*,
 
 /** Returns the current result as an array of column values.
     @warning The array reference is only valid until the result-set is advanced or released.
-            If you want to keep it for longer, call \ref FLArray_Retain (and release it when done.) */
+            If you want to keep it for longer, call \ref FLArray_Retain (and release it when done.)
+            If \ref CBLResultSet_SetReuseResults is on, copy it instead. */
 FLArray CBLResultSet_ResultArray(const CBLResultSet*) CBLAPI;
 
 /** Returns the current result as a dictionary mapping column names to values.
     @warning The dict reference is only valid until the result-set is advanced or released.
-            If you want to keep it for longer, call \ref FLDict_Retain (and release it when done.) */
+            If you want to keep it for longer, call \ref FLDict_Retain (and release it when done.)
+            If \ref CBLResultSet_SetReuseResults is on, copy it instead. */
 FLDict CBLResultSet_ResultDict(const CBLResultSet*) CBLAPI;
 
+/** Makes \ref CBLResultSet_ResultArray and \ref CBLResultSet_ResultDict refill the same array
+    and dict for every result, instead of allocating new ones, which saves two allocations per
+    result. It's off by default. When it's on, retaining the array or dict doesn't keep its
+    values: to keep them past the current result, copy it with \ref FLArray_MutableCopy or
+    \ref FLDict_MutableCopy using `kFLDeepCopyImmutables`. */
+void CBLResultSet_SetReuseResults(CBLResultSet*, bool reuse) CBLAPI;
+
 /** Returns the Query that created this ResultSet. */
 CBLQuery* CBLResultSet_GetQuery(const CBLResultSet *rs) CBLAPI;
 
@@ -172,6 +346,286 @@ CBL_REFCOUNTED(CBLResultSet*, ResultSet);
 /** @} */
 
 
+
+/** \name  Keyset pagination
+    @{
+    Paging through a large ordered result with `OFFSET` gets slower with every page, since the
+    skipped rows still have to be read. Instead, a page query can start after the sort key of the
+    previous page's last row, which an index on that key can seek to directly:
+
+        SELECT name, meta().id FROM _
+        WHERE name >= $cursor0
+          AND (name > $cursor0 OR (name = $cursor0 AND meta().id > $cursor1))
+        ORDER BY name, meta().id LIMIT 100
+
+    The leading `name >= $cursor0` is redundant, but it's what lets SQLite seek in the index;
+    it can't for the `OR` alone. (For a descending first key, use `<=` and `<`.)
+
+    A cursor holds the values of the result's key columns, in this case `[name, id]`, and
+    binds them to the parameters `$cursor0`, `$cursor1`, ... of the page query.
+    For the first page, bind a cursor whose values sort before any key, for example an empty
+    string; or use the same query without the `WHERE` clause.
+ */
+
+/** Copies the values of the given columns of the current result row, for use as a cursor to
+    the next page of results. Missing values are stored as null.
+    @note  You are responsible for releasing the cursor with \ref FLMutableArray_Release.
+    @param rs  The result set, positioned at the last row of a page.
+    @param keyColumns  The indexes of the columns holding the sort key.
+    @param numKeyColumns  The number of key columns.
+    @return  A new array of the key values. */
+_cbl_warn_unused
+FLMutableArray CBLResultSet_CopyCursor(const CBLResultSet* rs,
+                                       const unsigned keyColumns[_cbl_nonnull],
+                                       size_t numKeyColumns) CBLAPI;
+
+/** Binds a cursor's key values to the query parameters `$cursor0`, `$cursor1`, ..., in order,
+    leaving any other parameters unchanged. The cursor can come from
+    \ref CBLResultSet_CopyCursor, or be any array, for example one saved as JSON.
+    @param query  The page query.
+    @param cursor  The key values of the last row of the previous page. */
+void CBLQuery_SetCursor(CBLQuery* query, FLArray cursor) CBLAPI;
+
+/** @} */
+
+
+
+/** \name  Querying many collections
+    @{
+    When each tenant or account has a collection of its own, a report over all of them runs the
+    same query on each. \ref CBLDatabase_QueryCollections runs a query template on many
+    collections in parallel, each on a read-only connection of its own, and merges the results
+    as if they came from one collection:
+
+        SELECT meta().id, total FROM {{collection}} WHERE total > $min ORDER BY total DESC
+
+    The template is SQL++ (N1QL); every `{{collection}}` in it is replaced by a collection's
+    scope and name, each quoted with backquotes. Its `ORDER BY` columns must be given as
+    \ref CBLQuerySortColumn "sort columns", so that the collections' results can be merged in
+    order; `LIMIT` must be left out, and the limit given instead, so that it's applied to each
+    collection as well as to the merged results.
+    @note  The collections are read at about the same time, but not in one transaction, so a
+           write committed meanwhile may be seen by some of them and not others.
+ */
+
+/** The placeholder in a query template that is replaced by each collection's name. */
+#define kCBLQueryCollectionPlaceholder "{{collection}}"
+
+/** A result column that the rows of a query template are ordered by. */
+typedef struct {
+    unsigned column;            ///< The index of the result column
+    bool descending;            ///< True if it's ordered with `DESC`
+} CBLQuerySortColumn;
+
+/** Runs a query template on each of a database's collections, in parallel, and returns the
+    merged results. The rows are merged by comparing the values of their sort columns in order:
+    missing and null values come first, then numbers (booleans counting as 0 and 1), then strings,
+    by their UTF-8 bytes like an `ORDER BY` without `COLLATE`, and then arrays and dictionaries.
+    Rows whose sort columns are equal are in the order of their collections.
+    @note  You are responsible for releasing the results with \ref FLMutableArray_Release.
+    @param db  The database the collections belong to.
+    @param queryTemplate  The SQL++ query, which must contain \ref kCBLQueryCollectionPlaceholder.
+    @param collections  The collections to query.
+    @param numCollections  The number of collections.
+    @param parameters  The values of the query's parameters, or NULL if it has none.
+    @param sortColumns  The columns of the template's `ORDER BY`, or NULL if it has none.
+    @param numSortColumns  The number of sort columns.
+    @param limit  The most rows to return, or 0 for no limit.
+    @param outError  On failure, the error will be written here.
+    @return  A new array of result rows, each an array of column values; or NULL on failure. */
+_cbl_warn_unused
+FLMutableArray _cbl_nullable CBLDatabase_QueryCollections(CBLDatabase* db,
+                                                          FLString queryTemplate,
+                                                          const CBLCollection* const collections[_cbl_nonnull],
+                                                          size_t numCollections,
+                                                          FLDict _cbl_nullable parameters,
+                                                          const CBLQuerySortColumn sortColumns[_cbl_nullable],
+                                                          size_t numSortColumns,
+                                                          uint64_t limit,
+                                                          CBLError* _cbl_nullable outError) CBLAPI;
+
+/** @} */
+
+
+
+/** \name  Full-text search results
+    @{
+    A full-text query selects documents with `MATCH(index, terms)` and can order them by
+    relevance with `RANK(index)`. To show the matches, select the indexed property along with
+    them, and pass its value and the terms to these functions; the documents don't have to be
+    read again:
+
+        SELECT meta().id, description FROM _
+        WHERE MATCH(descIndex, 'quick fox*') ORDER BY RANK(descIndex)
+
+    The words of the text are compared with the terms case-insensitively, and a term ending in
+    `*` matches the words it's a prefix of. The operators `AND`, `OR`, `NEAR`, parentheses,
+    quotation marks and column filters in the terms are skipped, as is the term after `NOT`.
+    The index's stemming and `ignoreAccents` aren't applied, so a word the index matched only
+    by its stem, like "bigger" for "big", isn't found unless the term is "big*".
+ */
+
+/** The location of a word that matches a full-text search term. */
+typedef struct {
+    size_t offset;                  ///< The byte offset of the word in the text
+    size_t length;                  ///< The length of the word in bytes
+} CBLFullTextMatch;
+
+/** Finds the words of a text that match full-text search terms.
+    @param text  A value of the property that was indexed.
+    @param terms  The terms given to `MATCH()`.
+    @param outMatches  The matches are written here, in the order they appear in the text.
+    @param maxMatches  The capacity of `outMatches`.
+    @return  The number of matches in the text, which may be more than `maxMatches`. */
+size_t CBLFullText_FindMatches(FLString text,
+                               FLString terms,
+                               CBLFullTextMatch outMatches[_cbl_nullable],
+                               size_t maxMatches) CBLAPI;
+
+/** Options for \ref CBLFullText_Snippet. Zeroed fields get the defaults. */
+typedef struct {
+    FLString startMark;             ///< Inserted before each match; defaults to "<b>"
+    FLString endMark;               ///< Inserted after each match; defaults to "</b>"
+    FLString ellipsis;              ///< Marks text left out of the snippet; defaults to "..."
+    unsigned maxWords;              ///< The length of the snippet in words; defaults to 15
+} CBLFullTextSnippetOptions;
+
+/** Returns an excerpt of a text around the words that match full-text search terms, with the
+    matches marked. The excerpt is the run of words with the most different terms in it, and
+    then the most matches. If nothing matches, it's the start of the text.
+    @note  You are responsible for releasing the result by calling \ref FLSliceResult_Release.
+    @param text  A value of the property that was indexed.
+    @param terms  The terms given to `MATCH()`.
+    @param options  The marks and length of the snippet, or NULL for the defaults.
+    @return  The snippet. */
+_cbl_warn_unused
+FLSliceResult CBLFullText_Snippet(FLString text,
+                                  FLString terms,
+                                  const CBLFullTextSnippetOptions* _cbl_nullable options) CBLAPI;
+
+/** @} */
+
+
+
+/** \name  Asynchronous execution
+    @{
+    A query can be run in the background, so that the calling thread doesn't block until the
+    results are ready. By default it runs on a small pool of threads belonging to Couchbase Lite;
+    call \ref CBLQuery_SetAsyncExecutor to run it on your own threads instead.
+    @note  Executions of queries on the same database still take turns accessing it, but any
+           number of them may be pending, including several executions of the same query.
+ */
+
+/** A callback to be invoked when an asynchronous query execution has finished.
+    @param context  The `context` value passed to \ref CBLQuery_ExecuteAsync.
+    @param query  The query that was run.
+    @param results  The results, or NULL if the query failed. They are released after the
+                    callback returns, so call \ref CBLResultSet_Retain to keep them longer.
+    @param error  If the query failed, the error; else NULL. */
+typedef void (*CBLQueryExecuteCallback)(void* _cbl_nullable context,
+                                        CBLQuery* query,
+                                        CBLResultSet* _cbl_nullable results,
+                                        const CBLError* _cbl_nullable error);
+
+/** Starts running a query in the background. The callback will be called on the executor's
+    thread when it's finished, unless the execution is cancelled first.
+    @note  The query's parameters are those given when the execution starts running, not when
+           this function is called.
+    @note  You must release the execution when you're finished with it.
+    @param query  The query to run.
+    @param callback  The callback to be invoked with the results.
+    @param context  An opaque value that will be passed to the callback.
+    @return  A handle to the execution, which can be used to cancel it. */
+_cbl_warn_unused
+CBLQueryExecution* CBLQuery_ExecuteAsync(CBLQuery* query,
+                                         CBLQueryExecuteCallback callback,
+                                         void* _cbl_nullable context) CBLAPI;
+
+/** Cancels an asynchronous query execution. If it hasn't started running it never will;
+    if it's running, its results will be discarded.
+    @return  True if the execution's callback won't be called, false if it already has been
+             or is being called. */
+bool CBLQueryExecution_Cancel(CBLQueryExecution* execution) CBLAPI;
+
+CBL_REFCOUNTED(CBLQueryExecution*, QueryExecution);
+
+/** A task for a \ref CBLQueryExecutor to run; call it with the task context. */
+typedef void (*CBLQueryTask)(void* _cbl_nullable taskContext);
+
+/** A function that runs a task asynchronously on a thread of its choice.
+    @param executorContext  The `context` value passed to \ref CBLQuery_SetAsyncExecutor.
+    @param task  The task to run, by calling `task(taskContext)`. It must be run exactly once.
+    @param taskContext  The value to pass to the task. */
+typedef void (*CBLQueryExecutor)(void* _cbl_nullable executorContext,
+                                 CBLQueryTask task,
+                                 void* _cbl_nullable taskContext);
+
+/** Sets the executor that runs asynchronous query executions from now on,
+    or restores the default thread pool if `executor` is NULL. */
+void CBLQuery_SetAsyncExecutor(CBLQueryExecutor _cbl_nullable executor,
+                               void* _cbl_nullable context) CBLAPI;
+
+/** @} */
+
+
+/** \name  Profiling
+    @{
+    A query execution can be profiled, to find out how long it took and how its query plan
+    used the database's indexes. Profiling can be requested for a single execution, or for a
+    sample of all executions, which is cheap enough to leave on in production.
+ */
+
+/** Performance statistics of a query execution. The timings are in milliseconds. */
+typedef struct {
+    double compileTime;         ///< Time to compile the query (0 if it came from the query cache)
+    double firstRowTime;        ///< Time from starting the execution until the first row was read
+    double totalTime;           ///< Time from starting the execution until the last row was read
+    uint64_t rowsReturned;      ///< Number of rows read from the result set so far
+    bool fullScan;              ///< True if the query plan scans a collection without an index
+    bool usesTempBTree;         ///< True if the plan needs a temporary B-tree to sort or group
+    FLArray indexesUsed;        ///< Names of the indexes in the query plan (valid as long as the query)
+} CBLQueryStats;
+
+/** Runs the query like \ref CBLQuery_Execute, but with profiling enabled, so that its statistics
+    can be read with \ref CBLResultSet_GetStats as the rows are read.
+    @note  You must release the result set when you're finished with it.
+    @param query  The query to run.
+    @param outError  On failure, an error will be stored here.
+    @return  A new result set, or NULL on failure. */
+_cbl_warn_unused
+CBLResultSet* _cbl_nullable CBLQuery_ExecuteWithStats(CBLQuery* query,
+                                                      CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Gets the statistics of a profiled query execution. The timings and row count are updated as
+    rows are read; they're final once \ref CBLResultSet_Next has returned false.
+    @param rs  The result set.
+    @param outStats  The statistics will be stored here.
+    @return  True if the execution was profiled, false if not. */
+bool CBLResultSet_GetStats(const CBLResultSet* rs,
+                           CBLQueryStats* outStats) CBLAPI;
+
+/** A callback that receives the statistics of a sampled query execution. It's called on the
+    thread that finished reading the results, so it should return quickly.
+    @param context  The `context` value passed to \ref CBLQuery_SetStatsSampler.
+    @param query  The query that was executed.
+    @param stats  The execution's statistics. */
+typedef void (*CBLQueryStatsCallback)(void* _cbl_nullable context,
+                                      const CBLQuery* query,
+                                      const CBLQueryStats* stats);
+
+/** Profiles every Nth execution of any query (of the C API's \ref CBLQuery_Execute and its
+    variants, but not of live queries), and passes its statistics to a callback once its result
+    set has been read to the end or released.
+    @param sampleInterval  Profile one execution out of this many; 0 stops sampling.
+    @param callback  The callback, or NULL to stop sampling.
+    @param context  An opaque value that will be passed to the callback. */
+void CBLQuery_SetStatsSampler(uint32_t sampleInterval,
+                              CBLQueryStatsCallback _cbl_nullable callback,
+                              void* _cbl_nullable context) CBLAPI;
+
+/** @} */
+
+
 /** \name  Change listener
     @{
     Adding a change listener to a query turns it into a "live query". When changes are made to
@@ -179,7 +633,8 @@ CBL_REFCOUNTED(CBLResultSet*, ResultSet);
     results; if the new results are different, the listener callback will be called.
 
     @note  The result set passed to the listener is the _entire new result set_, not just the
-            rows that changed.
+            rows that changed. To be told only which rows changed, use
+            \ref CBLQuery_AddDiffListener instead.
  */
 
 /** A callback to be invoked after the query's results have changed.
@@ -211,6 +666,40 @@ CBLListenerToken* CBLQuery_AddChangeListener(CBLQuery* query,
                                              CBLQueryChangeListener listener,
                                              void* _cbl_nullable context) CBLAPI;
 
+/** Options for delaying and coalescing a query listener's notifications, so that a burst of
+    changes to the results produces a single call. */
+typedef struct {
+    /** The listener isn't called until the results have stopped changing for this long,
+        in milliseconds. Zero disables coalescing. */
+    uint32_t minIntervalMS;
+    /** The longest time, in milliseconds, that a change to the results can be held back while
+        waiting for the changes to stop. If less than `minIntervalMS`, that is used instead. */
+    uint32_t maxLatencyMS;
+} CBLQueryChangeListenerOptions;
+
+/** Registers a change listener callback with a query, like \ref CBLQuery_AddChangeListener, but
+    with options for coalescing its notifications.
+    @param query  The query to observe.
+    @param listener  The callback to be invoked.
+    @param context  An opaque value that will be passed to the callback.
+    @param options  The coalescing options, or NULL for none.
+    @return  A token to be passed to \ref CBLListener_Remove when it's time to remove the
+            listener.*/
+_cbl_warn_unused
+CBLListenerToken* CBLQuery_AddChangeListenerWithOptions(CBLQuery* query,
+                                                        CBLQueryChangeListener listener,
+                                                        void* _cbl_nullable context,
+                                                        const CBLQueryChangeListenerOptions* _cbl_nullable options) CBLAPI;
+
+/** Returns the number of changes to the query's results that were coalesced into the listener's
+    most recent notification; this is 1 if no changes were coalesced. Useful for tuning the
+    \ref CBLQueryChangeListenerOptions.
+    @param query  The query being listened to.
+    @param listener  The query listener that was notified.
+    @return  The number of coalesced changes, or 0 if the listener hasn't been notified yet. */
+uint32_t CBLQuery_CoalescedChangeCount(const CBLQuery* query,
+                                       CBLListenerToken *listener) CBLAPI;
+
 /** Returns the query's _entire_ current result set, after it's been announced via a call to the
     listener's callback.
     @note  You must release the result set when you're finished with it.
@@ -223,6 +712,55 @@ CBLResultSet* _cbl_nullable CBLQuery_CopyCurrentResults(const CBLQuery* query,
                                                         CBLListenerToken *listener,
                                                         CBLError* _cbl_nullable outError) CBLAPI;
 
+/** The ways a result row can change, as reported to a \ref CBLQueryDiffListener. */
+typedef CBL_ENUM(uint8_t, CBLQueryRowChangeType) {
+    kCBLQueryRowInserted,       ///< The row is new
+    kCBLQueryRowRemoved,        ///< The row is no longer in the results
+    kCBLQueryRowUpdated,        ///< The row has the same key, but other columns have changed
+    kCBLQueryRowMoved           ///< The row has moved relative to the others (and other columns
+                                ///< may also have changed)
+};
+
+/** A change to one row of a live query's results. */
+typedef struct {
+    CBLQueryRowChangeType type; ///< What happened to the row
+    uint32_t index;             ///< The row's position in the new results (old results if removed)
+    FLValue key;                ///< The row's identity: the value of its first column
+    FLArray row;                ///< The row's column values (the old ones if removed)
+    uint32_t oldIndex;          ///< The row's position in the old results (same as `index` if inserted)
+} CBLQueryRowChange;
+
+/** A callback to be invoked with the rows that changed since the query's previous results.
+    The first call reports every row as inserted.
+    @warning  The change array and its values are only valid during the callback.
+    @param context  The same `context` value that you passed when adding the listener.
+    @param query  The query that triggered the listener.
+    @param changes  The changed rows: first those inserted, updated or moved in the order of
+                    the new results, then those removed in the order of the old results.
+    @param numChanges  The number of changes. */
+typedef void (*CBLQueryDiffListener)(void* _cbl_nullable context,
+                                     CBLQuery* query,
+                                     const CBLQueryRowChange changes[_cbl_nonnull],
+                                     size_t numChanges);
+
+/** Registers a listener with a query that, instead of the entire result set, is given the rows
+    that were added, removed or changed each time the results change. This makes it cheap to
+    keep a large list up to date.
+
+    Rows are identified by the value of their first column, which should therefore be unique,
+    for example `meta().id`. A row whose other columns change is reported as updated. When the
+    order of the rows changes, as few rows as possible are reported as moved: a row that only
+    shifts because others were inserted or removed before it isn't.
+    @param query  The query to observe.
+    @param listener  The callback to be invoked.
+    @param context  An opaque value that will be passed to the callback.
+    @return  A token to be passed to \ref CBLListener_Remove when it's time to remove the
+            listener.*/
+_cbl_warn_unused
+CBLListenerToken* CBLQuery_AddDiffListener(CBLQuery* query,
+                                           CBLQueryDiffListener listener,
+                                           void* _cbl_nullable context) CBLAPI;
+
 /** @} */
 
 /** @} */
@@ -71,6 +71,29 @@ FLString CBLQueryIndex_Name(const CBLQueryIndex* index) CBLAPI;
     @return A \ref CBLCollection instance that the index belongs to. */
 CBLCollection* CBLQueryIndex_Collection(const CBLQueryIndex* index) CBLAPI;
 
+/** How much an index has been used by queries, while index usage tracking was enabled
+    (see \ref CBLDatabase_SetIndexUsageTracking.) */
+typedef struct {
+    uint64_t queryCount;                ///< Query executions whose query plan used the index
+    uint64_t rowsReturned;              ///< Rows returned by those executions
+    CBLTimestamp lastUsed;              ///< When it was last used, or 0 if never
+} CBLQueryIndexStats;
+
+/** Enables or disables tracking which indexes a database's queries use, for
+    \ref CBLQueryIndex_Stats. It's disabled by default, since it needs the query plan of every
+    query that's run. Disabling it discards the statistics collected so far.
+    @note  Executions of \ref CBLQuery_Execute and its variants are counted; those of live
+           queries aren't. Full-text indexes are counted; vector indexes aren't, since they
+           don't appear in query plans. */
+void CBLDatabase_SetIndexUsageTracking(CBLDatabase* db, bool enabled) CBLAPI;
+
+/** Returns how much an index has been used by queries since index usage tracking was enabled.
+    An index that's never used still costs time on every write to its collection, so consider
+    deleting it.
+    @param index  The index.
+    @return The index's statistics. */
+CBLQueryIndexStats CBLQueryIndex_Stats(const CBLQueryIndex* index) CBLAPI;
+
 #ifdef COUCHBASE_ENTERPRISE
 
 CBL_REFCOUNTED(CBLIndexUpdater*, IndexUpdater);
@@ -133,6 +156,28 @@ bool CBLIndexUpdater_SetVector(CBLIndexUpdater* updater,
                                size_t dimension,
                                CBLError* _cbl_nullable outError) CBLAPI;
 
+/** ENTERPRISE EDITION ONLY
+ 
+    Sets the vectors for a range of consecutive values, e.g. the output of a batch embedding model.
+    This is equivalent to calling \ref CBLIndexUpdater_SetVector for each of them, but takes the
+    updater's lock only once. Threads computing vectors in parallel may each submit their own
+    range, but the updater's calls are serialized: one thread's range is set while the others
+    wait. Call \ref CBLIndexUpdater_Finish once every thread's call has returned; it then saves
+    all the vectors in a single transaction.
+    @param updater  The index updater.
+    @param startIndex  The zero-based index of the first value.
+    @param vectors  The vectors, stored contiguously: `count` arrays of `dimension` floats.
+    @param count  The number of vectors. `startIndex + count` must not exceed the updater's count.
+    @param dimension  The dimension of each vector. Must be equal to the dimension value set in the vector index config.
+    @param outError  On failure, an error is written here.
+    @return True if success, or False if an error occurred. */
+bool CBLIndexUpdater_SetVectors(CBLIndexUpdater* updater,
+                                size_t startIndex,
+                                const float vectors[_cbl_nonnull],
+                                size_t count,
+                                size_t dimension,
+                                CBLError* _cbl_nullable outError) CBLAPI;
+
 /** ENTERPRISE EDITION ONLY
  
     Skip setting the vector for the value corresponding to the index.
@@ -152,6 +197,104 @@ void CBLIndexUpdater_SkipVector(CBLIndexUpdater* updater, size_t index) CBLAPI;
     @return True if success, or False if an error occurred. */
 bool CBLIndexUpdater_Finish(CBLIndexUpdater* updater, CBLError* _cbl_nullable outError) CBLAPI;
 
+/** @} */
+
+/** \name LazyIndexWorker
+    @{
+    CBLLazyIndexWorker keeps a lazy vector index up to date in the background: after its start,
+    and whenever the index's collection changes, it updates the index in batches, calling an
+    embedding callback to compute each batch's vectors, until the index has caught up.
+ */
+
+CBL_REFCOUNTED(CBLLazyIndexWorker*, LazyIndexWorker);
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Computes the vectors for a batch of values from a lazy index's expression.
+    It's called on a background thread, one batch at a time.
+    @param context  The `context` given in the \ref CBLLazyIndexWorkerConfiguration.
+    @param values  The values to compute vectors for. A value may be NULL if the expression has no value.
+    @param count  The number of values.
+    @param dimension  The dimension of each vector.
+    @param vectors  Where to store the vectors: `count` arrays of `dimension` floats, contiguously.
+    @param hasVector  For each value, initially true; set it to false if the value has no vector,
+                      which removes the document from the index.
+    @return  True on success; false to skip this batch, leaving its documents to be indexed
+             after the next change to the collection. */
+typedef bool (*CBLLazyIndexEmbedder)(void* _cbl_nullable context,
+                                     const FLValue _cbl_nullable values[_cbl_nonnull],
+                                     size_t count,
+                                     size_t dimension,
+                                     float vectors[_cbl_nonnull],
+                                     bool hasVector[_cbl_nonnull]);
+
+/** ENTERPRISE EDITION ONLY
+ 
+    The configuration of a \ref CBLLazyIndexWorker. */
+typedef struct {
+    CBLLazyIndexEmbedder embedder;      ///< Computes the vectors (required)
+    void* _cbl_nullable context;        ///< Passed to `embedder`
+    size_t dimension;                   ///< The dimension of the index's vectors (required)
+    
+    /** The maximum number of documents per batch. The default, 0, means 256. */
+    unsigned batchSize;
+    
+    /** How long, in milliseconds, to wait after a change before updating the index, so that
+        changes made close together are indexed in the same batch. The default is 0. */
+    unsigned changeDelay;
+    
+    /** The maximum percentage of time the worker spends updating the index while it's catching
+        up: after each batch, it pauses long enough to stay within it. This bounds the CPU and
+        power the worker uses. The default, 0, means 100%, i.e. no pauses. */
+    unsigned maxBusyPercent;
+} CBLLazyIndexWorkerConfiguration;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    The statistics of a \ref CBLLazyIndexWorker. */
+typedef struct {
+    bool caughtUp;                      ///< True if no documents are known to need vectors
+    uint64_t pendingChanges;            ///< Documents changed since the worker last caught up
+    uint64_t documentsIndexed;          ///< Documents whose vectors have been saved
+    uint64_t batchCount;                ///< Batches saved
+    uint64_t failedBatchCount;          ///< Batches skipped by the embedder, or that failed
+    double busyTime;                    ///< Total time spent on batches, in milliseconds
+    double documentsPerSecond;          ///< Throughput while busy
+} CBLLazyIndexWorkerStats;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Creates a worker that keeps a lazy vector index up to date. Call \ref CBLLazyIndexWorker_Start
+    to start it.
+    @note You are responsible for releasing the returned \ref CBLLazyIndexWorker, after stopping it.
+    @param index  The lazy vector index.
+    @param config  The worker's configuration.
+    @param outError  On failure, an error is written here.
+    @return A new \ref CBLLazyIndexWorker, or NULL if an error occurred. */
+_cbl_warn_unused
+CBLLazyIndexWorker* _cbl_nullable CBLLazyIndexWorker_Create(CBLQueryIndex* index,
+                                                            const CBLLazyIndexWorkerConfiguration* config,
+                                                            CBLError* _cbl_nullable outError) CBLAPI;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Starts the worker: it updates the index until it has caught up, then again after each change
+    to the index's collection. Does nothing if the worker is already running.
+    @note  A running worker is retained until it's stopped, so it isn't freed by releasing it. */
+void CBLLazyIndexWorker_Start(CBLLazyIndexWorker* worker) CBLAPI;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Stops the worker. A batch already in progress is finished first, asynchronously. Call this
+    when the app should stop using CPU in the background, e.g. when the battery is low, and
+    \ref CBLLazyIndexWorker_Start to resume. */
+void CBLLazyIndexWorker_Stop(CBLLazyIndexWorker* worker) CBLAPI;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    Returns the worker's statistics. */
+CBLLazyIndexWorkerStats CBLLazyIndexWorker_Stats(const CBLLazyIndexWorker* worker) CBLAPI;
+
 #endif
 
 /** @} */
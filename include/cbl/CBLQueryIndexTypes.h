@@ -36,6 +36,18 @@ typedef struct {
     /** The expressions describing each coloumn of the index. The expressions could be specified
         in a JSON Array or in N1QL syntax using comma delimiter. */
     FLString expressions;
+
+    /** An optional expression, in the same language as `expressions`, that selects the documents
+        to index; documents it doesn't match are left out of the index. Such a partial index is
+        smaller and cheaper to update, and is used by queries whose WHERE clause includes the
+        same condition. */
+    FLString where;
+
+    /** Optional expressions, in the same language and syntax as `expressions`, whose values are
+        stored in the index without being used to look it up. They're stored as trailing columns
+        of the index, which makes it larger; whether a query returning them can then skip reading
+        documents is up to the query planner, so check \ref CBLQuery_Explain if it matters. */
+    FLString includedExpressions;
 } CBLValueIndexConfiguration;
 
 /** Full-Text Index Configuration. */
@@ -83,6 +95,10 @@ typedef struct {
         using comma delimiter. If the array specified by the path contains scalar values,
         the expressions should be left unset or set to null. */
     FLString expressions;
+
+    /** An optional expression, in the same language as `expressions`, that selects the documents
+        whose arrays are indexed, as in \ref CBLValueIndexConfiguration. */
+    FLString where;
 } CBLArrayIndexConfiguration;
 
 #ifdef COUCHBASE_ENTERPRISE
@@ -197,6 +213,60 @@ typedef struct {
     unsigned numProbes;
 } CBLVectorIndexConfiguration;
 
+/** ENTERPRISE EDITION ONLY
+ 
+    Options for \ref CBLCollection_AdviseVectorIndex. */
+typedef struct {
+    /** The recall@10 to achieve: the fraction of a query's 10 nearest vectors that the index
+        finds, from 0 to 1. The default, 0, means 0.9. */
+    double targetRecall;
+    
+    /** The maximum estimated size of the index, in bytes. The default, 0, means no limit. */
+    uint64_t memoryBudget;
+    
+    /** The number of vectors to sample, at random, from the collection. Choosing them reads every
+        document once. A tenth of them, up to 100, are used as queries. The default, 0, means 2000. */
+    unsigned sampleSize;
+} CBLVectorIndexAdvisorOptions;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    The estimated performance of a vector index configuration, returned by
+    \ref CBLCollection_AdviseVectorIndex. */
+typedef struct {
+    double recall;              ///< Estimated recall@10, from 0 to 1
+    uint64_t memory;            ///< Estimated size of the index, in bytes
+    double buildTime;           ///< Estimated time to train the index and index every vector, in seconds
+    unsigned sampleSize;        ///< The number of vectors the estimates are based on
+    bool meetsTargets;          ///< False if no configuration met the target recall within the memory budget
+} CBLVectorIndexEstimate;
+
+/** ENTERPRISE EDITION ONLY
+ 
+    A search for the vectors nearest to a target, by \ref CBLCollection_FindNearestVectors. */
+typedef struct {
+    /** The language of `expression` and `where`. */
+    CBLQueryLanguage expressionLanguage;
+    
+    /** The expression returning each document's vector, as for a vector index: an array of
+        numbers, or their little-endian floats as data or in Base64. (Required) */
+    FLString expression;
+    
+    /** An optional condition selecting the documents to search. */
+    FLString where;
+    
+    /** The distance metric. The default, 0, means \ref kCBLDistanceMetricEuclideanSquared. */
+    CBLDistanceMetric metric;
+    
+    /** The maximum number of results. (Required) */
+    unsigned limit;
+    
+    /** The most documents to search exactly. If more match, a vector index of the expression
+        and metric is used instead, if there is one, and the results are approximate.
+        The default, 0, means 50000. */
+    uint64_t maxScanCount;
+} CBLVectorSearch;
+
 #endif
 
 /** @} */
@@ -58,6 +58,86 @@ CBLEndpoint* CBLEndpoint_CreateWithLocalDB(CBLDatabase*) CBLAPI;
 void CBLEndpoint_Free(CBLEndpoint* _cbl_nullable) CBLAPI;
 
 
+/** A connection of a custom transport, created by the replicator for a \ref CBLTransportFactory.
+    It stays valid until the factory's `dispose` callback. */
+typedef struct CBLTransport CBLTransport;
+
+/** The callbacks of a custom transport, which carries a replicator's connection instead of the
+    built-in TCP/TLS WebSocket; for example a QUIC stream, or shared memory with a local process.
+    The callbacks may be called on any thread, and should return quickly.
+
+    The replicator hands over ownership of the buffers it sends, instead of copying them. Both
+    directions have flow control, so a fast peer can't make either side buffer without limit:
+    - Sending: call \ref CBLTransport_SendCompleted as data is sent; the replicator stops
+      sending while too much is outstanding.
+    - Receiving: `receiveCompleted` reports the bytes the replicator has processed; stop reading
+      from the transport while more than about 100KB hasn't been reported yet. */
+typedef struct {
+    /** True if the transport delivers whole messages, keeping their boundaries, as QUIC streams
+        with length prefixes or IPC channels can; false if it's a byte stream, in which case the
+        replicator frames the messages as WebSocket does. */
+    bool messageFraming;
+
+    /** Opens a connection to the endpoint's URL. Call \ref CBLTransport_Opened when it's open,
+        or \ref CBLTransport_Closed with an error if it fails. */
+    void (*open)(void* _cbl_nullable context, CBLTransport* transport, FLString url);
+
+    /** Sends data. The transport takes ownership of the buffer, and must release it with
+        `FLSliceResult_Release` once it's sent, then call \ref CBLTransport_SendCompleted. */
+    void (*send)(CBLTransport* transport, FLSliceResult data);
+
+    /** Called when the replicator has processed `byteCount` bytes of received data. */
+    void (*receiveCompleted)(CBLTransport* transport, size_t byteCount);
+
+    /** Closes the connection. With message framing, `status` and `message` are the reason (a
+        WebSocket close code and message) to send to the peer before closing; otherwise they're
+        0 and null, as the replicator has already sent it. Call \ref CBLTransport_Closed when
+        the connection is closed. */
+    void (*close)(CBLTransport* transport, int status, FLString message);
+
+    /** Called when the replicator is done with the connection, which was closed; the transport
+        should free whatever it associated with it. Optional. */
+    void (* _cbl_nullable dispose)(CBLTransport* transport);
+
+    /** The value passed to `open`. */
+    void* _cbl_nullable context;
+} CBLTransportFactory;
+
+/** Creates an endpoint that connects with a custom transport instead of a WebSocket.
+    @param factory  The transport's callbacks, which are copied.
+    @param url  The URL of the remote, which is passed to the `open` callback. It can have any
+                scheme; its path must be the name of the remote database, as with
+                \ref CBLEndpoint_CreateWithURL.
+    @param outError  On failure, the error will be written here. */
+_cbl_warn_unused
+CBLEndpoint* _cbl_nullable CBLEndpoint_CreateWithTransport(const CBLTransportFactory* factory,
+                                                           FLString url,
+                                                           CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Tells the replicator that the connection is open. */
+void CBLTransport_Opened(CBLTransport* transport) CBLAPI;
+
+/** Passes received data to the replicator, which copies what it needs, so the buffer can be
+    reused when this returns. With message framing, `data` is exactly one message. */
+void CBLTransport_Received(CBLTransport* transport, FLSlice data) CBLAPI;
+
+/** Tells the replicator that `byteCount` bytes of the data it sent have been sent. */
+void CBLTransport_SendCompleted(CBLTransport* transport, size_t byteCount) CBLAPI;
+
+/** Tells the replicator that the peer asked to close the connection, with message framing.
+    The replicator then calls the `close` callback. */
+void CBLTransport_CloseRequested(CBLTransport* transport, int status, FLString message) CBLAPI;
+
+/** Tells the replicator that the connection has closed, normally if `error` is NULL. */
+void CBLTransport_Closed(CBLTransport* transport, const CBLError* _cbl_nullable error) CBLAPI;
+
+/** Associates a value of the transport's with the connection, such as its stream handle. */
+void CBLTransport_SetContext(CBLTransport* transport, void* _cbl_nullable context) CBLAPI;
+
+/** Returns the value set by \ref CBLTransport_SetContext, or NULL. */
+void* _cbl_nullable CBLTransport_GetContext(CBLTransport* transport) CBLAPI;
+
+
 /** An opaque object representing authentication credentials for a remote server. */
 typedef struct CBLAuthenticator CBLAuthenticator;
 
@@ -131,6 +211,33 @@ typedef const CBLDocument* _cbl_nullable (*CBLConflictResolver)(void* _cbl_nulla
 /** Default conflict resolver. This always returns `localDocument`. */
 CBL_PUBLIC extern const CBLConflictResolver CBLDefaultConflictResolver;
 
+/** A conflict passed to a \ref CBLBatchConflictResolver. */
+typedef struct {
+    FLString documentID;                            ///< The ID of the conflicted document
+    const CBLDocument* _cbl_nullable localDocument; ///< The local revision, or NULL if deleted
+    const CBLDocument* _cbl_nullable remoteDocument;///< The remote revision, or NULL if deleted
+    /** On return: the resolved document, with the same meaning as the return value of a
+        \ref CBLConflictResolver. It starts out as `localDocument`, so a conflict left alone
+        keeps the local revision; set it to NULL to delete the document. */
+    const CBLDocument* _cbl_nullable resolved;
+} CBLConflict;
+
+/** Conflict-resolution callback that resolves several conflicts in a collection at once, for
+    resolvers with a high cost per call. The replicator collects conflicts into batches, up to
+    the replicator's `conflictResolverBatchSize`, waiting up to its `conflictResolverBatchDelay`
+    for a batch to fill. The callback sets the `resolved` field of each conflict it resolves;
+    those it leaves alone keep their local revision.
+    @warning  This callback will be called on a background thread managed by the replicator,
+                like a \ref CBLConflictResolver, and has the same requirements.
+    @param context  The `context` field of the \ref CBLReplicatorConfiguration.
+    @param collection  The collection containing the conflicted documents.
+    @param conflicts  The conflicts to resolve.
+    @param count  The number of conflicts. */
+typedef void (*CBLBatchConflictResolver)(void* _cbl_nullable context,
+                                         CBLCollection* collection,
+                                         CBLConflict conflicts[_cbl_nonnull],
+                                         size_t count);
+
 
 /** Types of proxy servers, for CBLProxySettings. */
 typedef CBL_ENUM(uint8_t, CBLProxyType) {
@@ -288,6 +395,57 @@ typedef FLSliceResult (*CBLDocumentPropertyDecryptor) (
     CBLError* error             ///< On return: error (Optional)
 );
 
+/** A property passed to a \ref CBLBatchPropertyEncryptor or \ref CBLBatchPropertyDecryptor.
+    The replicator owns the memory of its input fields; the inputs of a batch are contiguous. */
+typedef struct {
+    FLString documentID;        ///< Document ID
+    FLString keyPath;           ///< Key path of the property
+    FLSlice input;              ///< Data to be encrypted or decrypted
+    FLString algorithm;         ///< Decryption: the algorithm name. Encryption: on return, optional algorithm name
+    FLString kid;               ///< Decryption: the key ID, if any. Encryption: on return, optional key ID
+    FLSlice output;             ///< On return: the encrypted or decrypted data
+} CBLEncryptableProperty;
+
+/** Callback that encrypts the \ref CBLEncryptable properties of a document in one call, instead of
+    calling a \ref CBLDocumentPropertyEncryptor for each one.
+    
+    Set each property's `output` to its encrypted data. Outputs, algorithm names and key IDs may
+    point into `outputBuffer`, a buffer owned and reused by the replicator whose capacity is at
+    least the total size of the inputs plus 64 bytes per property, or to memory of the callback's
+    own that stays valid until it's called again. They're copied when the callback returns.
+     
+    If an error is set to the out error parameter, it applies to every property in the batch, with
+    the same meaning as for \ref CBLDocumentPropertyEncryptor. Leaving a property's `output` null
+    without an error skips its encryption, which fails the document with a crypto error.
+    @note  Calls for the replicator's encryptor are never concurrent, so the callback may keep
+           reusable state (such as a cipher context) in the replicator's context. */
+typedef void (*CBLBatchPropertyEncryptor) (
+    void* context,                          ///< Replicator’s context
+    FLString scope,                         ///< Scope's name of the collection
+    FLString collection,                    ///< Collection's name
+    CBLEncryptableProperty properties[],    ///< The properties to encrypt
+    size_t count,                           ///< The number of properties
+    void* outputBuffer,                     ///< Buffer that outputs may be written to
+    size_t outputCapacity,                  ///< Size of `outputBuffer`
+    CBLError* error                         ///< On return: error (Optional)
+);
+
+/** Callback that decrypts the encrypted \ref CBLEncryptable properties of a pulled document in one
+    call, instead of calling a \ref CBLDocumentPropertyDecryptor for each one.
+    Outputs follow the same rules as for \ref CBLBatchPropertyEncryptor, and errors have the same
+    meaning as for \ref CBLDocumentPropertyDecryptor. Leaving a property's `output` null without an
+    error keeps its encrypted data as-is. */
+typedef void (*CBLBatchPropertyDecryptor) (
+    void* context,                          ///< Replicator’s context
+    FLString scope,                         ///< Scope's name of the collection
+    FLString collection,                    ///< Collection's name
+    CBLEncryptableProperty properties[],    ///< The properties to decrypt
+    size_t count,                           ///< The number of properties
+    void* outputBuffer,                     ///< Buffer that outputs may be written to
+    size_t outputCapacity,                  ///< Size of `outputBuffer`
+    CBLError* error                         ///< On return: error (Optional)
+);
+
 #endif
 
 /** The collection and the configuration that can be configured specifically for the replication. */
@@ -303,6 +461,32 @@ typedef struct {
         @note Channels are not supported in Peer-to-Peer and Database-to-Database replication. */
     FLArray _cbl_nullable channels;
     FLArray _cbl_nullable documentIDs;                  ///< Optional set of document IDs to replicate
+    
+    /** Optional callback that resolves conflicts in batches. If set, it's used instead of
+        `conflictResolver`. */
+    CBLBatchConflictResolver _cbl_nullable batchConflictResolver;
+
+    /** Optional filter expression that docs must match to be pushed, in N1QL `WHERE` clause
+        syntax, e.g. `type = 'order' AND total > 100`. It's compiled once, when the replicator is
+        created, and evaluated on each revision's properties without creating a \ref CBLDocument;
+        if `pushFilter` is also set, it's only called for revisions that match.
+        Deleted revisions, and revisions the user lost access to, always match since they have
+        no properties.
+        @note  Only a subset of N1QL is supported: property paths, string/number/boolean literals,
+               the comparisons `=`, `==`, `!=`, `<>`, `<`, `<=`, `>` and `>=` between a property
+               and a literal, `[NOT] IN [...]`, `IS [NOT] NULL`, `IS [NOT] MISSING`,
+               `IS [NOT] VALUED`, `AND`, `OR`, `NOT` and parentheses. A property whose type
+               differs from the literal's compares as N1QL collates them: booleans before
+               numbers, before strings, before arrays, before dictionaries. */
+    FLString pushFilterExpression;
+    FLString pullFilterExpression;                      ///< Like `pushFilterExpression`, for incoming docs.
+    
+    /** Optional conflict-resolution priority of the collection. Conflicts in collections with
+        higher priorities are resolved before those in lower ones. The default is 0.
+        @note  This only orders the queue of conflicts waiting for a resolver. It doesn't affect
+               the order or bandwidth in which changes and revisions of the collections are sent
+               and received, which LiteCore decides. */
+    int priority;
 } CBLReplicationCollection;
 
 /** The configuration of a replicator. */
@@ -425,7 +609,9 @@ typedef struct {
     CBLDocumentPropertyDecryptor _cbl_nullable documentPropertyDecryptor;
 #endif
     
-    /** The collections to replicate with the target's endpoint (Required if the database is not set). */
+    /** The collections to replicate with the target's endpoint (Required if the database is not set).
+        Each replicator opens its own connection, so replicating several collections with one
+        replicator costs one TLS handshake and heartbeat instead of one per replicator. */
     CBLReplicationCollection* _cbl_nullable collections;
     
     /** The number of collections (Required if the database is not set */
@@ -442,6 +628,63 @@ typedef struct {
         This option is disabled by default (see \ref kCBLDefaultReplicatorAcceptParentCookies) which means
         that the parent-domain cookies are not permitted to save by default. */
     bool acceptParentDomainCookies;
+    
+    //-- Conflict resolution:
+    
+    /** The maximum number of background tasks resolving conflicts at once. Custom conflict
+        resolvers may be called in parallel up to this number.
+        Specify 0 to use the default value of \ref kCBLDefaultReplicatorMaxConcurrentConflictResolvers. */
+    unsigned maxConcurrentConflictResolvers;
+    
+    /** The maximum number of conflict resolutions saved together in one transaction, and passed
+        together to a \ref CBLBatchConflictResolver.
+        Specify 0 to use the default value of \ref kCBLDefaultReplicatorConflictResolverBatchSize. */
+    unsigned conflictResolverBatchSize;
+    
+    /** The maximum time, in milliseconds, to wait for more conflicts to fill a batch before
+        resolving it. The default, 0, resolves whatever conflicts are pending right away. */
+    unsigned conflictResolverBatchDelay;
+    
+    //-- Document listener delivery:
+    
+    /** The maximum time, in milliseconds, that document replication events are held back so they
+        can be delivered to \ref CBLDocumentReplicationListener "document listeners" together.
+        The default, 0, delivers each batch of events as the replicator reports it. */
+    unsigned documentListenerMaxDelay;
+    
+    /** The maximum number of documents per document-listener callback when events are held back
+        (see `documentListenerMaxDelay`.) Reaching it delivers the events right away.
+        The default, 0, means no limit. */
+    unsigned documentListenerMaxBatch;
+    
+    //-- Checkpoints:
+    
+    /** How often, in seconds, the replicator saves its checkpoint while it's busy. Saving less
+        often means fewer writes to slow storage, at the cost of more revisions being fetched again
+        if the replication is interrupted.
+        The default, 0, uses LiteCore's interval.
+        @note  The pull side's insertion batch size and commit delay are fixed inside LiteCore,
+               and can't be configured. */
+    unsigned checkpointInterval;
+    
+    //-- Delta Sync:
+    
+    /** If true, revisions are always transferred whole instead of as deltas from an earlier
+        revision. The default, false, lets the replicator send deltas when the peer supports them.
+        @note  The replicator decides when a delta is worth sending, and doesn't report the bytes
+               it saved; the threshold and ancestor search depth are fixed inside LiteCore. */
+    bool disableDeltas;
+    
+#ifdef COUCHBASE_ENTERPRISE
+    //-- Batched Property Encryption
+    /** Optional callback to encrypt all the \ref CBLEncryptable values of a document at once.
+        If set, it's used instead of `documentPropertyEncryptor` and `propertyEncryptor`. */
+    CBLBatchPropertyEncryptor _cbl_nullable documentPropertyBatchEncryptor;
+    
+    /** Optional callback to decrypt all the encrypted \ref CBLEncryptable values of a document at once.
+        If set, it's used instead of `documentPropertyDecryptor` and `propertyDecryptor`. */
+    CBLBatchPropertyDecryptor _cbl_nullable documentPropertyBatchDecryptor;
+#endif
 } CBLReplicatorConfiguration;
 
 
@@ -517,16 +760,64 @@ typedef struct {
     uint64_t documentCount;     ///< Number of documents transferred so far
 } CBLReplicatorProgress;
 
+/** Statistics of a replicator's conflict resolution. Conflicts are resolved in batches, each
+    of whose resolutions are saved in one transaction. The timings are in milliseconds. */
+typedef struct {
+    uint64_t batchCount;        ///< Number of batches resolved so far
+    uint64_t documentCount;     ///< Number of conflicted documents in those batches
+    unsigned lastBatchSize;     ///< Number of documents in the most recent batch
+    double lastBatchTime;       ///< Time the most recent batch took
+    double totalTime;           ///< Total time of all batches
+} CBLConflictResolutionStats;
+
 /** A replicator's current status. */
 typedef struct {
     CBLReplicatorActivityLevel activity;    ///< Current state
     CBLReplicatorProgress progress;         ///< Approximate fraction complete
     CBLError error;                         ///< Error, if any
+    CBLConflictResolutionStats conflictResolution;  ///< Conflict resolution so far
 } CBLReplicatorStatus;
 
 /** Returns the replicator's current status. */
 CBLReplicatorStatus CBLReplicator_Status(CBLReplicator*) CBLAPI;
 
+/** The number of buckets in a \ref CBLTimingStats histogram. */
+#define kCBLTimingHistogramBuckets 8
+
+/** Statistics of the time spent in one kind of operation. The times are in milliseconds.
+    Bucket `i` of the histogram counts the operations that took less than 10^(i-3) ms, and
+    at least 10^(i-4) ms (so the first bucket is under 1µs); the last bucket counts all the
+    operations that took 1 second or more. */
+typedef struct {
+    uint64_t count;                         ///< Number of operations
+    double totalTime;                       ///< Total time of all the operations
+    double maxTime;                         ///< Time of the slowest operation
+    uint64_t histogram[kCBLTimingHistogramBuckets]; ///< Operation counts by duration
+} CBLTimingStats;
+
+/** Throughput and timing metrics of a replicator, accumulated since it was created. */
+typedef struct {
+    double activeTime;                      ///< Time since the replicator was last started, in ms
+    uint64_t documentsPushed;               ///< Number of documents pushed
+    uint64_t documentsPulled;               ///< Number of documents pulled
+    uint64_t documentErrors;                ///< Number of documents that failed to replicate
+    double documentsPushedPerSecond;        ///< Push rate since the replicator was last started
+    double documentsPulledPerSecond;        ///< Pull rate since the replicator was last started
+    uint64_t progressUnitsCompleted;        ///< Raw progress units (see \ref CBLReplicatorProgress)
+    uint64_t progressUnitsTotal;            ///< Raw progress units expected
+    CBLTimingStats pushFilter;              ///< Time spent in push filters
+    CBLTimingStats pullFilter;              ///< Time spent in pull filters
+    CBLTimingStats conflictResolver;        ///< Time spent deciding each batch of conflicts
+    CBLTimingStats conflictTransaction;     ///< Time spent saving each batch of resolved conflicts
+    CBLTimingStats propertyEncryptor;       ///< Time spent in property encryptors (EE only)
+    CBLTimingStats propertyDecryptor;       ///< Time spent in property decryptors (EE only)
+} CBLReplicatorMetrics;
+
+/** Returns a snapshot of the replicator's metrics. This doesn't take any locks, so it's cheap
+    enough to poll frequently; but the values are read one by one while the replicator runs, so
+    they may not be exactly consistent with each other. */
+CBLReplicatorMetrics CBLReplicator_GetMetrics(CBLReplicator*) CBLAPI;
+
 /** Indicates which documents in the default collection have local changes that have not yet
     been pushed to the server by this replicator. This is of course a snapshot, that will
     go out of date as the replicator makes progress and/or documents are saved locally.
@@ -586,10 +877,64 @@ bool CBLReplicator_IsDocumentPending2(CBLReplicator *repl,
                                       const CBLCollection* collection,
                                       CBLError* _cbl_nullable outError) CBLAPI;
 
+/** Indicates, for each of the given document IDs in the given collection, whether the document
+    has local changes that have not yet been pushed to the server by this replicator.
+ 
+    This is equivalent to calling \ref CBLReplicator_IsDocumentPending2 for each ID, but it reads
+    the replicator's checkpoint and the collection's changes only once for the whole set.
+    @param repl  The replicator.
+    @param docIDs  The document IDs to check.
+    @param count  The number of document IDs.
+    @param collection  The collection containing the documents.
+    @param outPending  On return, `outPending[i]` is true if `docIDs[i]` is pending. Its size must
+                       be at least `count`.
+    @param outError  On failure, the error will be written here.
+    @return  True on success, false on failure.
+    @warning If the given collection is not part of the replication, false with an error will be returned. */
+bool CBLReplicator_ArePendingDocuments(CBLReplicator *repl,
+                                       const FLString docIDs[_cbl_nonnull],
+                                       size_t count,
+                                       const CBLCollection* collection,
+                                       bool outPending[_cbl_nonnull],
+                                       CBLError* _cbl_nullable outError) CBLAPI;
+
+/** Pulls the documents with the given IDs in the given collection now, ahead of the rest of the
+    changes the replicator has yet to pull. Use this when the user opens a document that hasn't
+    been pulled yet, rather than waiting for the replicator to reach it.
+
+    The documents are pulled by a separate one-shot replication with the same configuration,
+    restricted to the given IDs; it runs whether or not the replicator itself is running, and
+    stops by itself when it's done. As each document is pulled, the replicator's
+    \ref CBLDocumentReplicationListener "document listeners" are called just as if the replicator
+    had pulled it; a document that doesn't exist on the other side isn't reported. If that
+    replication stops with an error, each requested document it didn't pull is reported to the
+    document listeners with that error.
+
+    Only one such replication runs at a time per collection. Documents requested while one is
+    running are pulled together by the next one, which starts when it stops.
+    @note  The replicator pulls these documents again when it reaches them, but as they're
+           already up to date, that costs only a comparison of revisions.
+    @note  Each replication of a distinct set of document IDs saves its own checkpoint, so prefer
+           requesting related documents in one call.
+    @param repl  The replicator, which must be a pull or push-and-pull replicator.
+    @param collection  The collection containing the documents.
+    @param docIDs  The document IDs to pull.
+    @param count  The number of document IDs.
+    @param outError  On failure, the error will be written here.
+    @return  True if the documents are being pulled, false on failure.
+    @warning If the given collection is not part of the replication, false with an error will be returned. */
+bool CBLReplicator_PullDocumentsNow(CBLReplicator *repl,
+                                    const CBLCollection* collection,
+                                    const FLString docIDs[_cbl_nonnull],
+                                    size_t count,
+                                    CBLError* _cbl_nullable outError) CBLAPI;
+
 /** A callback that notifies you when the replicator's status changes.
     @note This callback will be called on a background thread managed by the replicator.
           It must pay attention to thread-safety. It should not take a long time to return,
-          or it will slow down the replicator.
+          or it will slow down the replicator. If the database's notifications are buffered or
+          given to an executor (\ref CBLDatabase_BufferNotifications,
+          \ref CBLDatabase_SetNotificationExecutor), it's called from those instead.
     @param context  The value given when the listener was added.
     @param replicator  The replicator.
     @param status  The replicator's status. */
@@ -616,7 +961,8 @@ typedef struct {
 /** A callback that notifies you when documents are replicated.
     @note This callback will be called on a background thread managed by the replicator.
           It must pay attention to thread-safety. It should not take a long time to return,
-          or it will slow down the replicator.
+          or it will slow down the replicator. Like the change listener, it follows the
+          database's buffered notifications or notification executor, if any.
     @param context  The value given when the listener was added.
     @param replicator  The replicator.
     @param isPush  True if the document(s) were pushed, false if pulled.
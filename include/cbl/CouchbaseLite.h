@@ -20,6 +20,7 @@
 #include "CBLBase.h"
 #include "CBLBlob.h"
 #include "CBLCollection.h"
+#include "CBLConflictFree.h"
 #include "CBLDatabase.h"
 #include "CBLDefaults.h"
 #include "CBLDocument.h"
@@ -0,0 +1,174 @@
+//
+// BackgroundMaintenance.cc
+//
+// Copyright (c) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "BackgroundMaintenance.hh"
+#include "CBLDatabase_Internal.hh"
+#include "Internal.hh"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+using namespace std;
+using namespace std::chrono;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    namespace {
+
+        // A database with background maintenance enabled. It's a stoppable of the database,
+        // so that closing the database disables it.
+        struct Entry final : public CBLRefCounted {
+            struct Stoppable : public CBLStoppable {
+                Stoppable(Entry *entry)             :CBLStoppable(entry) { }
+                void stop() const override          {BackgroundMaintenance::disable(((Entry*)_ref)->db);}
+            };
+
+            Entry(CBLDatabase *db_, vector<CBLMaintenanceType> steps_)
+            :db(db_)
+            ,steps(std::move(steps_))
+            ,stoppable(this)
+            { }
+
+            // Waits for a running operation, then unregisters from the database.
+            void stop() {
+                LOCK(stepMutex);
+                if (stopped)
+                    return;
+                stopped = true;
+                db->unregisterStoppable(&stoppable);
+            }
+
+            Retained<CBLDatabase> const         db;
+            vector<CBLMaintenanceType> const    steps;
+            Stoppable                           stoppable;
+            std::mutex                          stepMutex;  // Held while performing an operation
+            Retained<CBLMaintenanceTask>        task;       // The current round of `steps`
+            bool                                stopped {false};
+        };
+
+        std::mutex                  sMutex;                 // Guards sEntries
+        vector<Retained<Entry>>     sEntries;
+        std::mutex                  sRunMutex;              // Held by `run`
+        std::mutex                  sCancelMutex;           // Guards changes to the two below
+        unsigned                    sRuns = 0;              // Calls to `run`, running or waiting
+        atomic<bool>                sCanceled {false};      // Cleared when the last run finishes
+
+        // Counts a call to `run` for as long as it's in scope, so that `cancel` reaches the runs
+        // in progress or waiting when it's called, and none that start later.
+        struct RunScope {
+            RunScope()  {LOCK(sCancelMutex); ++sRuns;}
+            ~RunScope() {
+                LOCK(sCancelMutex);
+                if (--sRuns == 0)
+                    sCanceled = false;
+            }
+        };
+
+
+        Retained<Entry> removeEntry(CBLDatabase *db) {
+            LOCK(sMutex);
+            auto i = find_if(sEntries.begin(), sEntries.end(), [db](auto &e) {return e->db == db;});
+            if (i == sEntries.end())
+                return nullptr;
+            Retained<Entry> entry = *i;
+            sEntries.erase(i);
+            return entry;
+        }
+
+    }
+
+
+    void BackgroundMaintenance::enable(CBLDatabase *db, vector<CBLMaintenanceType> steps) {
+        disable(db);
+        Retained<Entry> entry = new Entry(db, std::move(steps));
+        if (!db->registerStoppable(&entry->stoppable))
+            C4Error::raise(LiteCoreDomain, kC4ErrorNotOpen, "The database is closing or closed.");
+        LOCK(sMutex);
+        sEntries.push_back(entry);
+    }
+
+
+    void BackgroundMaintenance::disable(CBLDatabase *db) {
+        if (Retained<Entry> entry = removeEntry(db))
+            entry->stop();
+    }
+
+
+    bool BackgroundMaintenance::run(milliseconds budget) {
+        RunScope scope;
+        LOCK(sRunMutex);
+        if (sCanceled)
+            return false;
+        vector<Retained<Entry>> entries;
+        {
+            LOCK(sMutex);
+            entries = sEntries;
+        }
+
+        // Once every database has finished the last round, start a new one. A database
+        // enabled since then joins the current round:
+        bool newRound = true;
+        for (auto &entry : entries) {
+            LOCK(entry->stepMutex);
+            if (entry->task && entry->task->progress().stepsRemaining > 0)
+                newRound = false;
+        }
+
+        auto start = steady_clock::now();
+        bool first = true, done = true;
+        for (auto &entry : entries) {
+            LOCK(entry->stepMutex);
+            if (!entry->task || newRound)
+                entry->task = new CBLMaintenanceTask(entry->db, entry->steps);
+            while (!entry->stopped) {
+                if (sCanceled)
+                    return false;
+                auto progress = entry->task->progress();
+                if (progress.stepsRemaining == 0)
+                    break;
+                // As in CBLMaintenanceTask::run, only start an operation expected to finish in time:
+                auto expected = milliseconds(progress.nextStepEstimatedMs);
+                if (!first && steady_clock::now() - start + expected >= budget) {
+                    done = false;
+                    break;
+                }
+                first = false;
+                try {
+                    entry->task->run(0ms);      // Performs exactly one operation
+                } catch (...) {
+                    C4Error error = C4Error::fromCurrentException();
+                    CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                            "Background maintenance of database '%.*s' failed: %s",
+                            FMTSLICE(entry->db->name()), error.description().c_str());
+                    done = false;
+                    break;
+                }
+            }
+        }
+        return done;
+    }
+
+
+    void BackgroundMaintenance::cancel() {
+        LOCK(sCancelMutex);
+        if (sRuns > 0)
+            sCanceled = true;
+    }
+
+}
@@ -0,0 +1,49 @@
+//
+// BackgroundMaintenance.hh
+//
+// Copyright (c) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLDatabase.h"
+#include <chrono>
+#include <vector>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** The databases whose maintenance runs when the OS schedules it; see CBLPlatform.h.
+        A database stays enabled until it's disabled or closed. */
+    class BackgroundMaintenance {
+    public:
+        /** Enables a database's background maintenance, or replaces its operations.
+            Throws if the database is closing. */
+        static void enable(CBLDatabase*, std::vector<CBLMaintenanceType> steps);
+
+        /** Disables a database's background maintenance, waiting for a running operation. */
+        static void disable(CBLDatabase*);
+
+        /** Performs the enabled databases' operations, one at a time, until they're done, the
+            budget is used or `cancel` is called. Returns true if they're done. */
+        static bool run(std::chrono::milliseconds budget);
+
+        /** Makes `run` return after its current operation. */
+        static void cancel();
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
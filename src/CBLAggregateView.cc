@@ -0,0 +1,234 @@
+//
+// CBLAggregateView.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLAggregateView_Internal.hh"
+#include "CBLDocument_Internal.hh"
+#include "fleece/Fleece.hh"
+
+using namespace std;
+using namespace fleece;
+
+static constexpr uint32_t kScanBatchSize = 1000;
+
+
+CBLAggregateView::CBLAggregateView(CBLCollection *collection,
+                                   const CBLAggregateViewConfiguration &config)
+:_collection(collection)
+,_sumNames(config.sumProperties, config.sumProperties + (config.sumProperties ? config.sumPropertyCount : 0))
+{
+    auto compile = [](const string &path) {
+        FLError flErr;
+        KeyPath keyPath(FLKeyPath_New(FLStr(path.c_str()), &flErr));
+        if (!keyPath)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Invalid property path '%s'", path.c_str());
+        return keyPath;
+    };
+    if (!config.groupBy.buf || config.groupBy.size == 0)
+        C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Aggregate view needs a groupBy path");
+    _groupBy = compile(string(slice(config.groupBy)));
+    for (auto &name : _sumNames)
+        _sumPaths.push_back(compile(name));
+}
+
+
+// The collection listener's context is the view itself, unretained, so the view can be freed
+// while it follows the collection. Removing the token here waits for a call in progress, since
+// a token's callback runs under its mutex, so `changed` can't run on a freed view. (It doesn't
+// call any of the view's own listeners then, as their tokens retain the view.)
+CBLAggregateView::~CBLAggregateView() {
+    if (_listenerToken)
+        _listenerToken->remove();
+}
+
+
+void CBLAggregateView::start() {
+    // The listener is added first, so no change is missed. A document changed during the scan
+    // may then be seen by both; whichever comes second is ignored if its sequence is older.
+    // Deleted documents are remembered until the scan ends, so the scan can't bring them back.
+    {
+        LOCK(_mutex);
+        _scanning = true;
+    }
+    _listenerToken = _collection->addChangeListener(&changed, this);
+    uint64_t since = 0;
+    while (true) {
+        auto batch = _collection->changesSince(since, kScanBatchSize, true, 0);
+        if (batch->count() == 0)
+            break;
+        LOCK(_mutex);
+        for (size_t i = 0; i < batch->count(); ++i) {
+            auto &entry = batch->entry(i);
+            apply(entry.docID, entry.sequence, entry.deleted ? nullptr : entry.body, nullptr);
+        }
+        since = batch->lastSequence();
+    }
+
+    LOCK(_mutex);
+    _scanning = false;
+    for (auto i = _documents.begin(); i != _documents.end(); ) {
+        if (i->second.count == 0)
+            i = _documents.erase(i);
+        else
+            ++i;
+    }
+}
+
+
+CBLAggregateView::Contribution CBLAggregateView::contribution(FLDict body) const {
+    Contribution c;
+    c.count = 1;
+    c.sums.resize(_sumPaths.size());
+    Value group = FLKeyPath_Eval(_groupBy.get(), (FLValue)body);
+    if (group) {
+        // Arrays and dicts are grouped by their JSON, as a string:
+        c.group = string(group.toJSONString());
+        Encoder enc;
+        if (group.type() == kFLArray || group.type() == kFLDict)
+            enc.writeString(c.group);
+        else
+            enc.writeValue(group);
+        c.groupValue = enc.finish();
+    }
+    for (size_t i = 0; i < _sumPaths.size(); ++i) {
+        Value value = FLKeyPath_Eval(_sumPaths[i].get(), (FLValue)body);
+        if (value.type() == kFLNumber)
+            c.sums[i] = value.asDouble();
+    }
+    return c;
+}
+
+
+// Must be called with `_mutex` locked.
+void CBLAggregateView::apply(slice docID, uint64_t sequence, FLDict body,
+                             map<string, Contribution> *deltas) {
+    string key(docID);
+    auto i = _documents.find(key);
+    if (i != _documents.end()) {
+        if (sequence <= i->second.sequence)
+            return;                             // Already applied this revision or a newer one
+        if (i->second.count > 0)
+            add(i->second, -1, deltas);
+    }
+    Contribution c;
+    if (body) {
+        c = contribution(body);
+        add(c, +1, deltas);
+    } else if (!_scanning) {
+        if (i != _documents.end())
+            _documents.erase(i);
+        return;
+    }
+    c.sequence = sequence;
+    if (i != _documents.end())
+        i->second = std::move(c);
+    else
+        _documents.emplace(std::move(key), std::move(c));
+}
+
+
+// Must be called with `_mutex` locked.
+void CBLAggregateView::add(const Contribution &c, int sign, map<string, Contribution> *deltas) {
+    auto &group = _groups[c.group];
+    if (group.count == 0) {
+        group.group = c.group;
+        group.groupValue = c.groupValue;
+        group.sums.resize(c.sums.size());
+    }
+    group.count += sign;
+    for (size_t i = 0; i < c.sums.size(); ++i)
+        group.sums[i] += sign * c.sums[i];
+
+    if (deltas) {
+        auto &delta = (*deltas)[c.group];
+        if (delta.sums.empty()) {
+            delta.group = c.group;
+            delta.groupValue = c.groupValue;
+            delta.sums.resize(c.sums.size());
+        }
+        delta.count += sign;
+        for (size_t i = 0; i < c.sums.size(); ++i)
+            delta.sums[i] += sign * c.sums[i];
+    }
+    if (group.count == 0)
+        _groups.erase(c.group);
+}
+
+
+MutableDict CBLAggregateView::encode(const Contribution &c) const {
+    auto dict = MutableDict::newDict();
+    if (c.groupValue)
+        dict["group"_sl] = ValueFromData(c.groupValue, kFLTrusted);
+    dict["count"_sl] = c.count;
+    auto sums = MutableDict::newDict();
+    for (size_t i = 0; i < _sumNames.size(); ++i)
+        sums[slice(_sumNames[i])] = c.sums[i];
+    dict["sums"_sl] = sums;
+    return dict;
+}
+
+
+MutableArray CBLAggregateView::results() const {
+    auto results = MutableArray::newArray();
+    LOCK(_mutex);
+    for (auto &[key, group] : _groups)
+        results.append(encode(group));
+    return results;
+}
+
+
+void CBLAggregateView::changed(void *context, const CBLCollectionChange *change) {
+    auto view = (CBLAggregateView*)context;
+    try {
+        // Read the documents' current revisions before locking, then apply them together.
+        // A purged document has no sequence, so the collection's last sequence stands in for
+        // it: any revision of it read earlier is older than that.
+        vector<Retained<C4Document>> docs(change->numDocs);
+        vector<uint64_t> sequences(change->numDocs);
+        view->_collection->useLocked([&](C4Collection *c4col) {
+            for (unsigned i = 0; i < change->numDocs; ++i) {
+                docs[i] = c4col->getDocument(change->docIDs[i], true, kDocGetCurrentRev);
+                sequences[i] = uint64_t(docs[i] ? docs[i]->sequence() : c4col->getLastSequence());
+            }
+        });
+
+        map<string, Contribution> deltas;
+        {
+            LOCK(view->_mutex);
+            for (unsigned i = 0; i < change->numDocs; ++i) {
+                FLDict body = nullptr;
+                if (docs[i] && !(docs[i]->flags() & kDocDeleted))
+                    body = docs[i]->getProperties();
+                view->apply(change->docIDs[i], sequences[i], body, &deltas);
+            }
+        }
+
+        auto changes = MutableArray::newArray();
+        for (auto &[key, delta] : deltas) {
+            bool unchanged = (delta.count == 0);
+            for (double sum : delta.sums)
+                unchanged = unchanged && (sum == 0.0);
+            if (!unchanged)
+                changes.append(view->encode(delta));
+        }
+        if (!changes.empty())
+            view->_listeners.call(view, FLArray(changes));
+    } catch (...) {
+        BridgeException(__FUNCTION__, nullptr);
+    }
+}
@@ -0,0 +1,97 @@
+//
+// CBLAggregateView_Internal.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLCollection_Internal.hh"
+#include "Listener.hh"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+/** An incrementally maintained count and sums per group, as described by
+    \ref CBLCollection_CreateAggregateView. The view remembers each document's contribution,
+    so when the collection's change listener reports a document, its old contribution is taken
+    out of its group and its current one is added. It also remembers the sequence each
+    contribution came from, so that an older revision read by the initial scan can't replace a
+    newer one the listener has already applied. */
+struct CBLAggregateView final : public CBLRefCounted {
+public:
+    CBLAggregateView(CBLCollection *collection, const CBLAggregateViewConfiguration &config);
+    ~CBLAggregateView();
+
+    /** Adds every document in the collection, and starts following its changes. */
+    void start();
+
+    fleece::MutableArray results() const;
+
+    /** The token retains the view until it's removed, so a listener is never called with a
+        view that's being destructed. */
+    Retained<CBLListenerToken> addChangeListener(CBLAggregateViewChangeListener listener,
+                                                 void* _cbl_nullable context)
+    {
+        auto token = _listeners.add(listener, context);
+        retain(this);
+        token->extraInfo() = {this, [](void *view) {release((CBLAggregateView*)view);}};
+        return token;
+    }
+
+private:
+    struct KeyPathFree {
+        void operator() (FLKeyPath path) const      {FLKeyPath_Free(path);}
+    };
+    using KeyPath = std::unique_ptr<std::remove_pointer_t<FLKeyPath>, KeyPathFree>;
+
+    // A document's part in the view, or a group's totals, or a change to them:
+    struct Contribution {
+        std::string             group;              // JSON of the group value; empty if missing
+        fleece::alloc_slice     groupValue;         // The group value as Fleece
+        int64_t                 count {0};
+        std::vector<double>     sums;
+        uint64_t                sequence {0};       // Sequence of the revision it came from
+    };
+
+    static void changed(void* _cbl_nullable context, const CBLCollectionChange* change);
+    Contribution contribution(FLDict _cbl_nullable body) const;
+    void apply(slice docID, uint64_t sequence, FLDict _cbl_nullable body,
+               std::map<std::string, Contribution>* _cbl_nullable deltas);
+    void add(const Contribution &c, int sign,
+             std::map<std::string, Contribution>* _cbl_nullable deltas);
+    fleece::MutableDict encode(const Contribution &c) const;
+
+    Retained<CBLCollection> const                       _collection;
+    std::vector<std::string> const                      _sumNames;
+    KeyPath                                             _groupBy;
+    std::vector<KeyPath>                                _sumPaths;
+
+    mutable std::mutex                                  _mutex;
+    std::unordered_map<std::string, Contribution>       _documents;     // Keyed by doc ID; during
+                                                                        // the scan, includes
+                                                                        // deleted ones (count 0)
+    bool                                                _scanning {false};
+    std::map<std::string, Contribution>                 _groups;        // Keyed by group JSON
+    Retained<CBLListenerToken>                          _listenerToken;
+    cbl_internal::Listeners<CBLAggregateViewChangeListener> _listeners;
+};
+
+CBL_ASSUME_NONNULL_END
@@ -20,6 +20,7 @@
 #include "CBLPrivate.h"
 #include "Internal.hh"
 #include "Listener.hh"
+#include "MemoryStats.hh"
 #include <iostream>
 
 
@@ -63,6 +64,20 @@ void CBL_DumpInstances(void) noexcept {
 #endif
 }
 
+CBLMemoryStats CBL_GetMemoryStats(void) noexcept {
+    return cbl_internal::MemoryAccount::stats();
+}
+
+void CBL_SetMemoryTracking(bool enabled) noexcept {
+    cbl_internal::MemoryAccount::setTracking(enabled);
+}
+
+unsigned CBL_DumpTrackedObjects(void) noexcept {
+    try {
+        return cbl_internal::MemoryAccount::dumpTracked();
+    } catchAndWarn()
+}
+
 void CBLListener_Remove(CBLListenerToken *token) noexcept {
     if (token) {
         token->remove();
@@ -18,6 +18,13 @@
 
 #include "CBLBlob_Internal.hh"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 using namespace std;
 using namespace fleece;
 
@@ -84,10 +91,71 @@ uint64_t CBLBlobReader_Position(CBLBlobReadStream* stream) noexcept {
     return stream->position();
 }
 
+void CBLBlobReader_SetReadahead(CBLBlobReadStream* stream, size_t bufferSize) noexcept {
+    stream->setReadahead(bufferSize);
+}
+
+int64_t CBLBlobReader_ReadV(CBLBlobReadStream* stream,
+                            CBLBlobReadRange ranges[],
+                            size_t count,
+                            CBLError *outError) noexcept
+{
+    try {
+        return int64_t(stream->readV(ranges, count));
+    } catchAndBridgeReturning(outError, -1)
+}
+
 void CBLBlobReader_Close(CBLBlobReadStream* stream) noexcept {
     delete stream;
 }
 
+
+CBLBlobMapping::CBLBlobMapping(const CBLBlob &blob) {
+#ifndef _WIN32
+    // An unencrypted blob's file is just its content, and it's never modified:
+    if (alloc_slice path = blob.contentFilePath(); path) {
+        int fd = ::open(string(path).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+                void *map = ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                if (map != MAP_FAILED) {
+                    _map = map;
+                    _mapSize = size_t(st.st_size);
+                    _content = slice(_map, _mapSize);
+                }
+            }
+            ::close(fd);
+        }
+        if (_map)
+            return;
+    }
+#endif
+    _copy = blob.content();
+    _content = _copy;
+}
+
+CBLBlobMapping::~CBLBlobMapping() {
+#ifndef _WIN32
+    if (_map)
+        ::munmap(_map, _mapSize);
+#endif
+}
+
+CBLBlobMapping* CBLBlob_MapContent(const CBLBlob* blob, CBLError *outError) noexcept {
+    try {
+        return retain(new CBLBlobMapping(*blob));
+    } catchAndBridge(outError)
+}
+
+FLSlice CBLBlobMapping_Content(const CBLBlobMapping* mapping) noexcept {
+    return mapping->content();
+}
+
+bool CBLBlobMapping_IsMapped(const CBLBlobMapping* mapping) noexcept {
+    return mapping->isMapped();
+}
+
 bool CBLBlob_Equals(CBLBlob* blob, CBLBlob* anotherBlob) noexcept {
     return FLSlice_Equal(blob->digest(), anotherBlob->digest());
 }
@@ -133,6 +201,18 @@ bool CBLBlobWriter_Write(CBLBlobWriteStream* writer,
     } catchAndBridge(outError)
 }
 
+bool CBLBlobWriter_WriteAt(CBLBlobWriteStream* writer,
+                           uint64_t offset,
+                           const void *data,
+                           size_t length,
+                           CBLError *outError) noexcept
+{
+    try {
+        writer->writeAt(offset, {data, length});
+        return true;
+    } catchAndBridge(outError)
+}
+
 
 #pragma mark - FLEECE UTILITIES:
 
@@ -28,12 +28,16 @@
 #endif
 
 #include "Internal.hh"
+#include "MemoryStats.hh"
 #include "c4BlobStore.hh"
 #include "c4Document.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
 #include <algorithm>
+#include <cstring>
+#include <map>
 #include <mutex>
+#include <vector>
 #include "betterassert.hh"
 
 CBL_ASSUME_NONNULL_BEGIN
@@ -81,6 +85,20 @@ public:
         return properties()[kCBLBlobContentTypeProperty].asString();
     }
 
+    // The path of the file holding the content, or null if the content can't be read from it
+    // directly because the blob hasn't been saved yet or the database is encrypted.
+    alloc_slice contentFilePath() const {
+        if (!_db)
+            return fleece::nullslice;
+        try {
+            return blobStore()->getFilePath(_key);
+        } catch (litecore::error& e) {
+            if (e == litecore::error::WrongFormat)
+                return fleece::nullslice;
+            throw;
+        }
+    }
+
 protected:
     friend struct CBLDocument;
     friend struct CBLDatabase;
@@ -142,6 +160,8 @@ protected:
         return _db->blobStore();
     }
 
+    cbl_internal::MemoryAccount       _memory {cbl_internal::MemoryCategory::kBlobs, this, sizeof(CBLBlob)};
+
 private:
     friend struct CBLBlobReadStream;
 
@@ -159,6 +179,7 @@ public:
     {
         precondition(contents);
         _content = contents;
+        _memory.setBytes(sizeof(CBLNewBlob) + _content.size);
         CBLDocument::registerNewBlob(this);
     }
 
@@ -181,6 +202,7 @@ public:
             if (_content) {
                 db->blobStore()->createBlob(_content, &expectedKey);
                 _content = fleece::nullslice;
+                _memory.setBytes(sizeof(CBLNewBlob));
             } else if (_writer) {
                 if (db->blobStore() != &_writer->blobStore())
                     C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
@@ -219,21 +241,21 @@ struct CBLBlobReadStream {
     { }
 
     size_t read(void *buffer, size_t maxBytes)  {
-        size_t n = _c4stream.read(buffer, maxBytes);
+        size_t n = readAt(_pos, buffer, maxBytes);
         _pos += n;
         return n;
     }
 
+    // Only moves the position; the file is repositioned by the next read, if it needs to be.
     int64_t seek(int64_t pos, CBLSeekBase base) {
         switch (base) {
             case kCBLSeekModeFromStart: break;
             case kCBLSeekModeRelative:  pos += _pos; break;
-            case kCBLSeekModeFromEnd:   pos += _c4stream.getLength(); break;
+            case kCBLSeekModeFromEnd:   pos += length(); break;
         }
         if (pos < 0)
             C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Seek to negative position");
-        pos = std::min(pos, (int64_t) _c4stream.getLength());
-        _c4stream.seek(pos);
+        pos = std::min(pos, length());
         _pos = pos;
         return pos;
     }
@@ -242,19 +264,157 @@ struct CBLBlobReadStream {
 
     int64_t length() const                      {return _c4stream.getLength();}
 
+    void setReadahead(size_t size) {
+        _readahead = (size + kBlockSize - 1) / kBlockSize * kBlockSize;
+        _buffer.clear();
+        _buffer.shrink_to_fit();
+        _bufferLength = 0;
+    }
+
+    size_t readV(CBLBlobReadRange ranges[], size_t count) {
+        std::vector<CBLBlobReadRange*> sorted(count);
+        for (size_t i = 0; i < count; ++i)
+            sorted[i] = &ranges[i];
+        std::stable_sort(sorted.begin(), sorted.end(), [](auto a, auto b) {return a->offset < b->offset;});
+        uint64_t len = uint64_t(length());
+        size_t total = 0;
+        for (auto range : sorted) {
+            range->bytesRead = 0;
+            if (range->offset < len)
+                range->bytesRead = readAt(range->offset, range->buffer,
+                                          size_t(std::min(uint64_t(range->length), len - range->offset)));
+            total += range->bytesRead;
+        }
+        return total;
+    }
+
+private:
+    // Encrypted blob files are decrypted in blocks of this size, so the buffer is aligned to it.
+    static constexpr size_t kBlockSize = 4096;
+
+    size_t readAt(uint64_t offset, void *dst, size_t maxBytes) {
+        auto out = (uint8_t*)dst;
+        size_t total = 0;
+        while (maxBytes > 0) {
+            if (offset >= _bufferStart && offset < _bufferStart + _bufferLength) {
+                size_t n = std::min(maxBytes, size_t(_bufferStart + _bufferLength - offset));
+                memcpy(out, &_buffer[size_t(offset - _bufferStart)], n);
+                out += n;
+                offset += n;
+                maxBytes -= n;
+                total += n;
+            } else if (maxBytes >= _readahead) {
+                total += readFile(offset, out, maxBytes);
+                break;
+            } else {
+                // Refill the buffer with the blocks starting at `offset`:
+                _buffer.resize(_readahead);
+                _bufferStart = offset - offset % kBlockSize;
+                _bufferLength = readFile(_bufferStart, _buffer.data(), _readahead);
+                if (offset >= _bufferStart + _bufferLength)
+                    break;      // EOF
+            }
+        }
+        return total;
+    }
+
+    size_t readFile(uint64_t offset, void *dst, size_t maxBytes) {
+        if (offset != _filePos) {
+            _c4stream.seek(offset);
+            _filePos = offset;
+        }
+        size_t n = _c4stream.read(dst, maxBytes);
+        _filePos += n;
+        return n;
+    }
+
+    C4ReadStream         _c4stream;
+    uint64_t             _pos = 0;              // Position of the next `read`
+    uint64_t             _filePos = 0;          // Position of `_c4stream`
+    size_t               _readahead = 0;        // Size of the buffer, if any
+    std::vector<uint8_t> _buffer;
+    uint64_t             _bufferStart = 0;      // Offset in the blob of _buffer[0]
+    size_t               _bufferLength = 0;     // Number of valid bytes in _buffer
+};
+
+
+
+struct CBLBlobMapping : public CBLRefCounted {
+public:
+    explicit CBLBlobMapping(const CBLBlob &blob);
+
+    slice content() const                       {return _content;}
+    bool isMapped() const                       {return _map != nullptr;}
+
+protected:
+    ~CBLBlobMapping();
+
 private:
-    C4ReadStream _c4stream;
-    uint64_t     _pos = 0;
+    slice                 _content;
+    void* _cbl_nullable   _map {nullptr};      // Address of the mapped file, if any
+    size_t                _mapSize {0};
+    alloc_slice           _copy;               // Content read into memory, if not mapped
 };
 
 
 
 struct CBLBlobWriteStream {
     CBLBlobWriteStream(CBLDatabase *db)         :_c4stream(*db->blobStore()) { }
-    void write(fleece::slice data)              {return _c4stream.write(data);}
+
+    void write(fleece::slice data) {
+        LOCK(_mutex);
+        _writeAt(_written, data);
+    }
+
+    // Chunks may arrive in any order, from any thread. The digest has to be computed over the
+    // bytes in order, so a chunk past the end of the contiguous data is held until the gap fills.
+    void writeAt(uint64_t offset, fleece::slice data) {
+        LOCK(_mutex);
+        _writeAt(offset, data);
+    }
+
 private:
     friend struct CBLNewBlob;
-    C4WriteStream _c4stream;
+
+    void _writeAt(uint64_t offset, fleece::slice data) {
+        auto next = _pending.lower_bound(offset);
+        if (offset < _written
+                || (next != _pending.end() && next->first < offset + data.size)
+                || (next != _pending.begin() && std::prev(next)->first + std::prev(next)->second.size > offset))
+            overlap(offset);
+        if (offset > _written) {
+            _pending.emplace(offset, alloc_slice(data));
+            return;
+        }
+        _c4stream.write(data);
+        _written += data.size;
+        // Write any held-back chunks that are now contiguous:
+        for (auto i = _pending.begin(); i != _pending.end() && i->first == _written; i = _pending.erase(i)) {
+            _c4stream.write(i->second);
+            _written += i->second.size;
+        }
+    }
+
+    [[noreturn]] static void overlap(uint64_t offset) {
+        C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                       "Blob data written at offset %llu overlaps data already written",
+                       (unsigned long long)offset);
+    }
+
+    // The key of the finished content. Called by CBLNewBlob once all data has been written.
+    C4BlobKey computeBlobKey() {
+        LOCK(_mutex);
+        if (!_pending.empty())
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Blob stream is missing data before offset %llu",
+                           (unsigned long long)_pending.begin()->first);
+        return _c4stream.computeBlobKey();
+    }
+
+    std::mutex                          _mutex;
+    C4WriteStream                       _c4stream;
+    uint64_t                            _written {0};   // Length of the contiguous data written
+    std::map<uint64_t, alloc_slice>     _pending;       // Chunks past `_written`, by offset
 };
 
 
@@ -295,7 +455,7 @@ inline std::unique_ptr<CBLBlobReadStream> CBLBlob::openContentStream() const {
 
 
 inline CBLNewBlob::CBLNewBlob(slice contentType, CBLBlobWriteStream &&writer)
-:CBLBlob(writer._c4stream.computeBlobKey(), writer._c4stream.getBytesWritten(), contentType) {
+:CBLBlob(writer.computeBlobKey(), writer._c4stream.getBytesWritten(), contentType) {
     _writer.emplace(std::move(writer._c4stream));
     // Nothing more will be written, but don't install the stream until the owning document
     // is saved and calls my install() method.
@@ -19,7 +19,14 @@
 #include "CBLCollection_Internal.hh"
 #include "Internal.hh"
 #include "CBLQueryIndex_Internal.hh"
+#include "JSONLinesReader.hh"
+#include "c4BlobStore.hh"
+#include "c4DocEnumerator.hh"
 #include "c4Index.hh"
+#include "c4Query.hh"
+#include <chrono>
+#include <condition_variable>
+#include <future>
 
 using namespace fleece;
 using namespace cbl_internal;
@@ -73,7 +80,7 @@ namespace cbl_internal {
             change.docID = _docID;
 
             auto db = _collection->database();
-            db->notify(this, change);
+            db->notify(_collection.get(), this, change);
         }
 
         Retained<CBLCollection> _collection;
@@ -92,7 +99,649 @@ CBLCollection::addDocumentListener(slice docID, CBLCollectionDocumentChangeListe
     return token;
 }
 
+Retained<CBLCollection> CBLCollection::acquireReader() const {
+    // The collection retains the reader, which keeps it out of the pool until it's released:
+    Retained<CBLDatabase> reader = _database->acquireReader();
+    Retained<CBLCollection> collection = reader->getCollection(_name, _scopeName);
+    if (!collection)
+        C4Error::raise(LiteCoreDomain, kC4ErrorNotFound, "Collection doesn't exist");
+    return collection;
+}
+
 Retained<CBLQueryIndex> CBLCollection::getIndex(slice name) {
     auto index = _c4col.useLocked()->getIndex(name);
     return index ? new CBLQueryIndex(std::move(index), this) : nullptr;
 }
+
+
+#pragma mark - CHANGE FEED:
+
+
+Retained<CBLChangeFeedBatch> CBLCollection::changesSince(uint64_t sinceSequence, uint32_t limit,
+                                                         bool includeBodies, uint32_t waitMs) const
+{
+    auto readChanges = [&](C4Collection *c4col) {
+        auto batch = make_retained<CBLChangeFeedBatch>(sinceSequence);
+        C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
+        options.flags |= kC4IncludeDeleted;
+        if (!includeBodies)
+            options.flags &= ~kC4IncludeBodies;
+        C4DocEnumerator e(c4col, C4SequenceNumber(sinceSequence), options);
+        while ((limit == 0 || batch->count() < limit) && e.next())
+            batch->add(e.getDocument(), e.documentInfo(), includeBodies);
+        return batch;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool changed = false;
+    std::unique_ptr<C4CollectionObserver> observer;
+    {
+        auto c4col = _c4col.useLocked();
+        auto batch = readChanges(c4col);
+        if (batch->count() > 0 || waitMs == 0)
+            return batch;
+        // Observe commits, before the lock is released so none is missed:
+        observer = c4col->observe([&](C4CollectionObserver*) {
+            LOCK(mutex);
+            changed = true;
+            cond.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait_for(lock, std::chrono::milliseconds(waitMs), [&] {return changed;});
+    }
+    auto c4col = _c4col.useLocked();
+    observer.reset();
+    return readChanges(c4col);
+}
+
+
+#pragma mark - INDEXES:
+
+
+// SQLite has no INCLUDE clause, so included expressions become trailing columns of the index;
+// a query that only needs the index's columns doesn't read the documents.
+alloc_slice CBLCollection::appendIndexExpressions(CBLQueryLanguage language, slice exprs, slice more) {
+    if (language == kCBLN1QLLanguage)
+        return alloc_slice(std::string(exprs) + ", " + std::string(more));
+
+    // JSON: concatenate the two arrays of expressions.
+    JSONEncoder enc;
+    enc.beginArray();
+    for (slice json : {exprs, more}) {
+        Doc doc = Doc::fromJSON(convertJSON5(json));
+        Array array = doc.asArray();
+        if (!array)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Index expressions must be a JSON array");
+        for (Array::iterator i(array); i; ++i)
+            enc.writeValue(*i);
+    }
+    enc.endArray();
+    return enc.finish();
+}
+
+
+void CBLCollection::createC4Index(C4Collection *c4col, const IndexSpec &spec) {
+    C4IndexOptions options = {};
+    std::string ftsLanguage, unnestPath, where;
+    if (spec.type == kC4FullTextIndex) {
+        options.ignoreDiacritics = spec.ignoreDiacritics;
+        if (spec.ftsLanguage) {
+            ftsLanguage = std::string(spec.ftsLanguage);
+            options.language = ftsLanguage.c_str();
+        }
+    } else if (spec.type == kC4ArrayIndex && spec.unnestPath) {
+        unnestPath = std::string(spec.unnestPath);
+        options.unnestPath = unnestPath.c_str();
+    }
+    if (spec.where) {
+        where = std::string(spec.where);
+        options.where = where.c_str();
+    }
+    c4col->createIndex(spec.name, spec.expressions, spec.language, spec.type, &options);
+}
+
+
+void CBLCollection::createIndex(const IndexSpec &spec) {
+    _c4col.useLocked([&](C4Collection* c4col) {
+        auto c4db = c4col->getDatabase();
+        C4Database::Transaction t(c4db);
+        unsuspendIndex(c4db, spec.name);
+        createC4Index(c4col, spec);
+        t.commit();
+        _indexSpecs[std::string(spec.name)] = spec;
+    });
+    _database->invalidateQueryCache();
+}
+
+
+void CBLCollection::deleteIndex(slice name) {
+    _c4col.useLocked([&](C4Collection* c4col) {
+        auto c4db = c4col->getDatabase();
+        C4Database::Transaction t(c4db);
+        if (!unsuspendIndex(c4db, name))
+            c4col->deleteIndex(name);
+        t.commit();
+        _indexSpecs.erase(std::string(name));
+    });
+    _database->indexUsage().forget(name);
+    _database->invalidateQueryCache();
+}
+
+
+Retained<CBLIndexBuild> CBLCollection::createIndexAsync(IndexSpec spec,
+                                                        CBLIndexBuildCallback callback,
+                                                        void* context)
+{
+    Retained<CBLCollection> self = this;
+    alloc_slice name = spec.name;
+    Retained<CBLIndexBuild> build = new CBLIndexBuild(name, [self, spec = std::move(spec)] {
+        self->createIndex(spec);
+    }, callback, context);
+    build->start();
+    return build;
+}
+
+
+#ifdef COUCHBASE_ENTERPRISE
+
+Retained<CBLIndexBuild> CBLCollection::createVectorIndexAsync(slice name,
+                                                              CBLVectorIndexConfiguration config,
+                                                              CBLIndexBuildCallback callback,
+                                                              void* context)
+{
+    // Copy what the configuration points to, since the caller may free it:
+    std::shared_ptr<CBLVectorEncoding> encoding;
+    if (config.encoding) {
+        auto &c4enc = config.encoding->c4encoding();
+        CBLVectorEncoding *enc;
+        switch (c4enc.type) {
+            case kC4VectorEncodingNone:
+                enc = CBLVectorEncoding_CreateNone();
+                break;
+            case kC4VectorEncodingPQ:
+                enc = CBLVectorEncoding_CreateProductQuantizer(c4enc.pq_subquantizers, c4enc.bits);
+                break;
+            default:
+                enc = CBLVectorEncoding_CreateScalarQuantizer(CBLScalarQuantizerType(c4enc.bits));
+                break;
+        }
+        encoding.reset(enc, CBLVectorEncoding_Free);
+    }
+    alloc_slice expression(config.expression);
+    
+    Retained<CBLCollection> self = this;
+    alloc_slice indexName(name);
+    Retained<CBLIndexBuild> build = new CBLIndexBuild(name, [=]() mutable {
+        config.expression = expression;
+        config.encoding = encoding.get();
+        self->createVectorIndex(indexName, config);
+    }, callback, context);
+    build->start();
+    return build;
+}
+
+#endif
+
+
+std::vector<CBLCollection::IndexSpec> CBLCollection::suspendedIndexes(C4Database *c4db) const {
+    std::vector<IndexSpec> specs;
+    alloc_slice body;
+    c4db->getRawDocument(kSuspendedIndexesStore, _fullName, [&](C4RawDocument *doc) {
+        if (doc)
+            body = alloc_slice(doc->body);
+    });
+    Doc doc(body, kFLTrusted);
+    for (Array::iterator i(doc.root().asArray()); i; ++i) {
+        Dict dict = i.value().asDict();
+        specs.push_back({alloc_slice(dict["name"].asString()),
+                         C4IndexType(dict["type"].asInt()),
+                         C4QueryLanguage(dict["lang"].asInt()),
+                         alloc_slice(dict["expr"].asString()),
+                         dict["ignoreDiacritics"].asBool(),
+                         alloc_slice(dict["language"].asString()),
+                         alloc_slice(dict["unnestPath"].asString()),
+                         alloc_slice(dict["where"].asString())});
+    }
+    return specs;
+}
+
+
+void CBLCollection::saveSuspendedIndexes(C4Database *c4db, const std::vector<IndexSpec> &specs) const {
+    C4RawDocument doc = {};
+    doc.key = _fullName;
+    alloc_slice body;
+    if (!specs.empty()) {
+        Encoder enc;
+        enc.beginArray();
+        for (auto &spec : specs) {
+            enc.beginDict();
+            enc.writeKey("name"_sl);
+            enc.writeString(spec.name);
+            enc.writeKey("type"_sl);
+            enc.writeInt(spec.type);
+            enc.writeKey("lang"_sl);
+            enc.writeInt(spec.language);
+            if (spec.expressions) {
+                enc.writeKey("expr"_sl);
+                enc.writeString(spec.expressions);
+            }
+            if (spec.ignoreDiacritics) {
+                enc.writeKey("ignoreDiacritics"_sl);
+                enc.writeBool(true);
+            }
+            if (spec.ftsLanguage) {
+                enc.writeKey("language"_sl);
+                enc.writeString(spec.ftsLanguage);
+            }
+            if (spec.unnestPath) {
+                enc.writeKey("unnestPath"_sl);
+                enc.writeString(spec.unnestPath);
+            }
+            if (spec.where) {
+                enc.writeKey("where"_sl);
+                enc.writeString(spec.where);
+            }
+            enc.endDict();
+        }
+        enc.endArray();
+        body = enc.finish();
+        doc.body = body;
+    }
+    // A null body and meta deletes the raw document:
+    c4db->putRawDocument(kSuspendedIndexesStore, doc);
+}
+
+
+bool CBLCollection::unsuspendIndex(C4Database *c4db, slice name) const {
+    auto specs = suspendedIndexes(c4db);
+    auto i = std::find_if(specs.begin(), specs.end(), [&](const IndexSpec &spec) {
+        return spec.name == name;
+    });
+    if (i == specs.end())
+        return false;
+    specs.erase(i);
+    saveSuspendedIndexes(c4db, specs);
+    return true;
+}
+
+
+void CBLCollection::suspendIndexes() {
+    _c4col.useLocked([&](C4Collection* c4col) {
+        auto c4db = c4col->getDatabase();
+        C4Database::Transaction t(c4db);
+        auto specs = suspendedIndexes(c4db);
+        Doc info(c4col->getIndexesInfo());
+        for (Array::iterator i(info.root().asArray()); i; ++i) {
+            Dict dict = i.value().asDict();
+            slice name = dict["name"].asString();
+            auto type = C4IndexType(dict["type"].asInt());
+            IndexSpec spec;
+            if (auto s = _indexSpecs.find(std::string(name)); s != _indexSpecs.end() && s->second.type == type) {
+                spec = s->second;
+            } else if (type == kC4ValueIndex) {
+                // A value index is defined by its expressions, and its condition if partial:
+                spec = {alloc_slice(name), type, indexLanguage(dict),
+                        alloc_slice(dict["expr"].asString()), false, nullslice,
+                        nullslice, alloc_slice(dict["where"].asString())};
+            } else {
+                continue;
+            }
+            c4col->deleteIndex(name);
+            specs.push_back(std::move(spec));
+        }
+        saveSuspendedIndexes(c4db, specs);
+        t.commit();
+    });
+    _database->invalidateQueryCache();
+}
+
+
+void CBLCollection::resumeIndexes() {
+    _c4col.useLocked([&](C4Collection* c4col) {
+        auto c4db = c4col->getDatabase();
+        C4Database::Transaction t(c4db);
+        auto specs = suspendedIndexes(c4db);
+        if (specs.empty())
+            return;
+        for (auto &spec : specs) {
+            createC4Index(c4col, spec);
+            _indexSpecs[std::string(spec.name)] = spec;
+        }
+        saveSuspendedIndexes(c4db, {});
+        t.commit();
+    });
+    _database->invalidateQueryCache();
+}
+
+
+bool CBLCollection::saveJSON(slice docID, slice json, CBLConcurrencyControl concurrency) {
+#ifdef COUCHBASE_ENTERPRISE
+    if (json.find("\"encryptable\""_sl)) {
+        // Encryptables have to be validated, which needs the regular save path:
+        auto doc = make_retained<CBLDocument>(docID, true);
+        doc->setPropertiesAsJSON(json);
+        return doc->save(this, {concurrency});
+    }
+#endif
+    
+    // Note: shared lock b/w database and collection
+    return _c4col.useLocked<bool>([&](C4Collection* c4col) {
+        auto c4db = c4col->getDatabase();
+        C4Database::Transaction t(c4db);
+        
+        // Transcode the JSON straight into the database's encoder:
+        alloc_slice body;
+        {
+            SharedEncoder enc(c4db->sharedFleeceEncoder());
+            enc.convertJSON(json);
+            FLError flErr;
+            body = enc.finish(&flErr);
+            if (!body)
+                C4Error::raise(FleeceDomain, flErr, "Invalid JSON");
+        }
+        Dict root = ValueFromData(body, kFLTrusted).asDict();
+        if (!root)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "JSON must be an object");
+        
+        // Only properties that could belong to a blob make it worth looking for one:
+        C4RevisionFlags revFlags = 0;
+        if (json.find("\"digest\""_sl) || json.find("\"_attachments\""_sl)) {
+            if (C4Blob::dictContainsBlobs(root))
+                revFlags |= kRevHasAttachments;
+        }
+        
+        if (!putBody(c4col, docID, body, revFlags, concurrency))
+            return false;
+        t.commit();
+        return true;
+    });
+}
+
+
+bool CBLCollection::putBody(C4Collection *c4col, slice docID, slice body, C4RevisionFlags revFlags,
+                            CBLConcurrencyControl concurrency)
+{
+    C4DocPutRequest rq = {};
+    rq.body = body;
+    rq.docID = docID;
+    rq.revFlags = revFlags;
+    rq.save = true;
+    C4Error c4err;
+    Retained<C4Document> newDoc = c4col->putDocument(rq, nullptr, &c4err);
+    if (!newDoc) {
+        if (c4err != C4Error{LiteCoreDomain, kC4ErrorConflict})
+            C4Error::raise(c4err);
+        if (concurrency != kCBLConcurrencyControlLastWriteWins)
+            return false;
+        // Last-write-wins; overwrite the current revision:
+        Retained<C4Document> current = c4col->getDocument(docID, true, kDocGetCurrentRev);
+        if (!current || !(newDoc = current->update(body, revFlags)))
+            return false;
+    }
+    return true;
+}
+
+
+void CBLCollection::inChunks(size_t count, size_t chunkSize, CBLBatchProgressCallback callback,
+                             void* context, size_t &outChanged,
+                             fleece::function_ref<bool(C4Collection*, size_t)> fn)
+{
+    static constexpr size_t kDefaultChunkSize = 1000;
+    if (chunkSize == 0)
+        chunkSize = kDefaultChunkSize;
+    outChanged = 0;
+    for (size_t start = 0; start < count; start += chunkSize) {
+        size_t end = std::min(start + chunkSize, count);
+        _c4col.useLocked([&](C4Collection* c4col) {
+            C4Database::Transaction t(c4col->getDatabase());
+            size_t changed = 0;
+            for (size_t i = start; i < end; ++i) {
+                if (fn(c4col, i))
+                    ++changed;
+            }
+            t.commit();
+            outChanged += changed;
+        });
+        if (callback && !callback(context, end, count))
+            break;
+    }
+}
+
+
+void CBLCollection::purgeDocuments(const FLString docIDs[], size_t count, size_t chunkSize,
+                                   CBLBatchProgressCallback callback, void* context,
+                                   size_t &outPurged)
+{
+    inChunks(count, chunkSize, callback, context, outPurged, [&](C4Collection* c4col, size_t i) {
+        return c4col->purgeDocument(docIDs[i]);
+    });
+}
+
+
+void CBLCollection::deleteDocuments(const FLString docIDs[], size_t count, size_t chunkSize,
+                                    CBLConcurrencyControl concurrency,
+                                    CBLBatchProgressCallback callback, void* context,
+                                    CBLError* outResults, size_t &outDeleted)
+{
+    // A document's result is only known once its transaction is committed, so the results
+    // of the current one are held until the progress callback:
+    struct Progress {
+        CBLBatchProgressCallback _cbl_nullable  callback;
+        void* _cbl_nullable                     context;
+        CBLError* _cbl_nullable                 results;
+        size_t                                  committed {0};
+        std::vector<std::pair<size_t, C4Error>> pending;
+    } progress {callback, context, outResults};
+
+    auto onCommit = [](void *ctx, size_t completed, size_t total) {
+        auto p = (Progress*)ctx;
+        if (p->results) {
+            for (auto &[i, error] : p->pending)
+                p->results[i] = external(error);
+        }
+        p->pending.clear();
+        p->committed = completed;
+        return !p->callback || p->callback(p->context, completed, total);
+    };
+
+    try {
+        inChunks(count, chunkSize, onCommit, &progress, outDeleted, [&](C4Collection* c4col, size_t i) {
+            // Only the current revision is needed to add a tombstone to it:
+            Retained<C4Document> c4doc = c4col->getDocument(docIDs[i], false, kDocGetCurrentRev);
+            C4Error error {};
+            if (!c4doc || (c4doc->flags() & kDocDeleted)) {
+                error = {LiteCoreDomain, kC4ErrorNotFound};
+            } else if ((c4doc->flags() & kDocConflicted) &&
+                       concurrency == kCBLConcurrencyControlFailOnConflict) {
+                error = {LiteCoreDomain, kC4ErrorConflict};
+            } else if (!c4doc->update(fleece::nullslice, kRevDeleted)) {
+                error = {LiteCoreDomain, kC4ErrorConflict};
+            }
+            progress.pending.emplace_back(i, error);
+            return error.code == 0;
+        });
+    } catch (...) {
+        if (outResults) {
+            C4Error error = C4Error::fromCurrentException();
+            for (size_t i = progress.committed; i < count; ++i)
+                outResults[i] = external(error);
+        }
+        throw;
+    }
+}
+
+
+void CBLCollection::setDocumentExpirations(const FLString docIDs[], const CBLTimestamp expirations[],
+                                           size_t count, size_t chunkSize,
+                                           CBLBatchProgressCallback callback, void* context,
+                                           size_t &outUpdated)
+{
+    inChunks(count, chunkSize, callback, context, outUpdated, [&](C4Collection* c4col, size_t i) {
+        if (!c4col->setExpiration(docIDs[i], C4Timestamp(expirations[i])))
+            return false;
+#ifdef COUCHBASE_ENTERPRISE
+        _database->rekeyExpirationChanged(_fullName, docIDs[i]);
+#endif
+        return true;
+    });
+}
+
+
+void CBLCollection::appendDocuments(const FLString docIDs[], const FLDict properties[],
+                                    size_t count, size_t chunkSize,
+                                    CBLBatchProgressCallback callback, void* context,
+                                    size_t &outAppended)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (!slice(docIDs[i]) || !properties[i])
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Appended documents need an ID and properties");
+    }
+    inChunks(count, chunkSize, callback, context, outAppended, [&](C4Collection* c4col, size_t i) {
+        alloc_slice body;
+        {
+            SharedEncoder enc(c4col->getDatabase()->sharedFleeceEncoder());
+            enc.writeValue(Dict(properties[i]));
+            body = enc.finish();
+        }
+        C4RevisionFlags revFlags = C4Blob::dictContainsBlobs(Dict(properties[i])) ? kRevHasAttachments : 0;
+        // Saving with no parent revision fails if the document exists, which skips it:
+        return putBody(c4col, docIDs[i], body, revFlags, kCBLConcurrencyControlFailOnConflict);
+    });
+}
+
+
+void CBLCollection::purgeDocumentsWithPrefix(slice prefix, size_t chunkSize,
+                                             CBLBatchProgressCallback callback, void* context,
+                                             size_t &outPurged)
+{
+    // The IDs starting with the prefix are those from it up to, but not including, the prefix
+    // with its last byte below 0xFF incremented:
+    std::string end(prefix);
+    while (!end.empty() && uint8_t(end.back()) == 0xFF)
+        end.pop_back();
+    if (!end.empty())
+        end.back() = char(uint8_t(end.back()) + 1);
+
+    std::string queryStr = "SELECT META().id FROM `" + std::string(_scopeName) + "`.`"
+                         + std::string(_name) + "` WHERE META().id >= $start";
+    if (!end.empty())
+        queryStr += " AND META().id < $end";
+    Retained<C4Query> query = _database->compileQuery(kCBLN1QLLanguage, slice(queryStr), nullptr);
+    if (!query)
+        C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Can't query document IDs");
+
+    Encoder enc;
+    enc.beginDict();
+    enc.writeKey("start"_sl);
+    enc.writeString(prefix);
+    if (!end.empty()) {
+        enc.writeKey("end"_sl);
+        enc.writeString(slice(end));
+    }
+    enc.endDict();
+    alloc_slice params = enc.finish();
+
+    std::vector<alloc_slice> ids;
+    {
+        auto e = _c4col.useLocked<C4Query::Enumerator>([&](C4Collection*) {
+            return query->run(params);
+        });
+        while (e.next()) {
+            slice docID = e.column(0).asString();
+            if (docID.hasPrefix(prefix))
+                ids.emplace_back(docID);
+        }
+    }
+    inChunks(ids.size(), chunkSize, callback, context, outPurged, [&](C4Collection* c4col, size_t i) {
+        return c4col->purgeDocument(ids[i]);
+    });
+}
+
+
+bool CBLCollection::importJSONLines(slice path, slice idProperty, const CBLImportOptions &options,
+                                    CBLImportProgressCallback callback, void* context,
+                                    CBLImportProgress &progress)
+{
+    size_t batchSize = options.batchSize ? options.batchSize : kCBLDefaultImportBatchSize;
+    JSONLinesReader reader(std::string(path), idProperty, options.threads);
+    progress = {};
+    progress.totalBytes = reader.totalBytes();
+    auto start = std::chrono::steady_clock::now();
+
+    bool suspend = !options.keepIndexes
+                && _c4col.useLocked<bool>([&](C4Collection* c4col) {
+                       return suspendedIndexes(c4col->getDatabase()).empty();
+                   });
+    if (suspend)
+        suspendIndexes();
+
+    bool stopped = false;
+    try {
+        // The next batch is read and parsed while the current one is being saved:
+        auto next = std::async(std::launch::async, [&] {return reader.read(batchSize);});
+        while (true) {
+            auto docs = next.get();
+            if (docs.empty())
+                break;
+            uint64_t bytesRead = reader.bytesRead();
+            next = std::async(std::launch::async, [&] {return reader.read(batchSize);});
+
+            _c4col.useLocked([&](C4Collection* c4col) {
+                auto c4db = c4col->getDatabase();
+                C4Database::Transaction t(c4db);
+                for (auto &doc : docs) {
+                    bool saved;
+                    if (doc.json) {
+                        saved = saveJSON(doc.docID, doc.json, options.concurrency);
+                    } else {
+                        // Re-encode the properties with the database's shared keys:
+                        alloc_slice body;
+                        Dict root = ValueFromData(doc.fleece, kFLTrusted).asDict();
+                        {
+                            SharedEncoder enc(c4db->sharedFleeceEncoder());
+                            enc.writeValue(root);
+                            body = enc.finish();
+                        }
+                        C4RevisionFlags revFlags = 0;
+                        if (doc.mayHaveBlobs && C4Blob::dictContainsBlobs(root))
+                            revFlags |= kRevHasAttachments;
+                        saved = putBody(c4col, doc.docID, body, revFlags, options.concurrency);
+                    }
+                    if (saved)
+                        ++progress.documentsImported;
+                    else
+                        ++progress.documentsSkipped;
+                }
+                t.commit();
+            });
+
+            progress.bytesRead = bytesRead;
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() > 0)
+                progress.documentsPerSecond = progress.documentsImported / elapsed.count();
+            if (callback && !callback(context, &progress)) {
+                stopped = true;
+                break;
+            }
+        }
+        // Don't leave the reader running after a stop:
+        if (next.valid())
+            next.wait();
+    } catch (...) {
+        if (suspend)
+            resumeIndexes();
+        throw;
+    }
+    if (suspend)
+        resumeIndexes();
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "Imported %llu documents from %.*s at %.0f docs/sec%s",
+            (unsigned long long)progress.documentsImported, FMTSLICE(path),
+            progress.documentsPerSecond, (stopped ? " (stopped)" : ""));
+    return true;
+}
@@ -17,9 +17,13 @@
 //
 
 #include "CBLCollection.h"
+#include "CBLAggregateView_Internal.hh"
 #include "CBLCollection_Internal.hh"
 #include "CBLDatabase_Internal.hh"
+#include "CBLExpirationSweeper_Internal.hh"
 #include "CBLQueryIndex_Internal.hh"
+#include "VectorIndexAdvisor.hh"
+#include "VectorSearch.hh"
 
 using namespace fleece;
 
@@ -122,6 +126,12 @@ uint64_t CBLCollection_Count(const CBLCollection* collection) noexcept {
     } catchAndWarn()
 }
 
+CBLCollection* CBLCollection_AcquireReader(CBLCollection* collection, CBLError* outError) noexcept {
+    try {
+        return collection->acquireReader().detach();
+    } catchAndBridge(outError)
+}
+
 /** Private API */
 uint64_t CBLCollection_LastSequence(const CBLCollection* collection) noexcept {
     try {
@@ -142,6 +152,20 @@ const CBLDocument* CBLCollection_GetDocument(const CBLCollection* collection, FL
     } catchAndBridge(outError)
 }
 
+bool CBLCollection_GetDocuments(const CBLCollection* collection,
+                                const FLString docIDs[],
+                                size_t count,
+                                const CBLDocument* outDocs[],
+                                CBLError* outError) noexcept
+{
+    try {
+        auto docs = collection->getDocuments(docIDs, count);
+        for (size_t i = 0; i < count; ++i)
+            outDocs[i] = docs[i].detach();
+        return true;
+    } catchAndBridge(outError)
+}
+
 CBLDocument* CBLCollection_GetMutableDocument(CBLCollection* collection, FLString docID,
                                               CBLError* outError) noexcept
 {
@@ -189,6 +213,55 @@ bool CBLCollection_SaveDocumentWithConflictHandler(CBLCollection* collection,
     } catchAndBridge(outError)
 }
 
+bool CBLCollection_SaveDocuments(CBLCollection* collection,
+                                 CBLDocument* const docs[],
+                                 size_t count,
+                                 CBLConcurrencyControl concurrency,
+                                 CBLError* outResults,
+                                 CBLError* outError) noexcept
+{
+    try {
+        collection->saveDocuments(docs, count, concurrency, outResults);
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool CBLCollection_SaveJSON(CBLCollection* collection,
+                            FLString docID,
+                            FLString json,
+                            CBLConcurrencyControl concurrency,
+                            CBLError* outError) noexcept
+{
+    try {
+        if (collection->saveJSON(docID, json, concurrency))
+            return true;
+        C4Error::set(LiteCoreDomain, kC4ErrorConflict, {}, internal(outError));
+        return false;
+    } catchAndBridge(outError)
+}
+
+bool CBLCollection_ImportJSONLines(CBLCollection* collection,
+                                   FLString path,
+                                   FLString idProperty,
+                                   const CBLImportOptions* options,
+                                   CBLImportProgressCallback callback,
+                                   void* context,
+                                   CBLImportProgress* outProgress,
+                                   CBLError* outError) noexcept
+{
+    CBLImportProgress progress {};
+    bool ok = false;
+    try {
+        ok = collection->importJSONLines(path, idProperty, (options ? *options : CBLImportOptions{}),
+                                         callback, context, progress);
+    } catch (...) {
+        cbl_internal::BridgeException(__FUNCTION__, outError);
+    }
+    if (outProgress)
+        *outProgress = progress;
+    return ok;
+}
+
 bool CBLCollection_DeleteDocument(CBLCollection *collection,
                                   const CBLDocument* doc,
                                   CBLError* outError) noexcept
@@ -211,6 +284,33 @@ bool CBLCollection_DeleteDocumentWithConcurrencyControl(CBLCollection *collectio
     } catchAndBridge(outError)
 }
 
+bool CBLCollection_SaveDocumentAsync(CBLCollection* collection,
+                                     CBLDocument* doc,
+                                     CBLConcurrencyControl concurrency,
+                                     CBLDocumentWriteCallback callback,
+                                     void* context,
+                                     CBLError* outError) noexcept
+{
+    try {
+        collection->database()->writeAsync(collection, doc, concurrency, false, callback, context);
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool CBLCollection_DeleteDocumentAsync(CBLCollection* collection,
+                                       const CBLDocument* doc,
+                                       CBLConcurrencyControl concurrency,
+                                       CBLDocumentWriteCallback callback,
+                                       void* context,
+                                       CBLError* outError) noexcept
+{
+    try {
+        collection->database()->writeAsync(collection, const_cast<CBLDocument*>(doc),
+                                           concurrency, true, callback, context);
+        return true;
+    } catchAndBridge(outError)
+}
+
 bool CBLCollection_DeleteDocumentByID(CBLCollection* collection,
                                       FLString docID,
                                       CBLError* _cbl_nullable outError) noexcept
@@ -265,6 +365,176 @@ bool CBLCollection_SetDocumentExpiration(CBLCollection* collection,
     } catchAndBridge(outError)
 }
 
+bool CBLCollection_PurgeDocuments(CBLCollection* collection,
+                                  const FLString docIDs[],
+                                  size_t count,
+                                  size_t chunkSize,
+                                  CBLBatchProgressCallback callback,
+                                  void* context,
+                                  size_t* outPurged,
+                                  CBLError* outError) noexcept
+{
+    size_t purged = 0;
+    bool ok = false;
+    try {
+        collection->purgeDocuments(docIDs, count, chunkSize, callback, context, purged);
+        ok = true;
+    } catch (...) {
+        cbl_internal::BridgeException(__FUNCTION__, outError);
+    }
+    if (outPurged)
+        *outPurged = purged;
+    return ok;
+}
+
+bool CBLCollection_DeleteDocuments(CBLCollection* collection,
+                                   const FLString docIDs[],
+                                   size_t count,
+                                   size_t chunkSize,
+                                   CBLConcurrencyControl concurrency,
+                                   CBLBatchProgressCallback callback,
+                                   void* context,
+                                   CBLError* outResults,
+                                   size_t* outDeleted,
+                                   CBLError* outError) noexcept
+{
+    size_t deleted = 0;
+    bool ok = false;
+    try {
+        collection->deleteDocuments(docIDs, count, chunkSize, concurrency, callback, context,
+                                    outResults, deleted);
+        ok = true;
+    } catch (...) {
+        cbl_internal::BridgeException(__FUNCTION__, outError);
+    }
+    if (outDeleted)
+        *outDeleted = deleted;
+    return ok;
+}
+
+bool CBLCollection_SetDocumentExpirations(CBLCollection* collection,
+                                          const FLString docIDs[],
+                                          const CBLTimestamp expirations[],
+                                          size_t count,
+                                          size_t chunkSize,
+                                          CBLBatchProgressCallback callback,
+                                          void* context,
+                                          size_t* outUpdated,
+                                          CBLError* outError) noexcept
+{
+    size_t updated = 0;
+    bool ok = false;
+    try {
+        collection->setDocumentExpirations(docIDs, expirations, count, chunkSize,
+                                           callback, context, updated);
+        ok = true;
+    } catch (...) {
+        cbl_internal::BridgeException(__FUNCTION__, outError);
+    }
+    if (outUpdated)
+        *outUpdated = updated;
+    return ok;
+}
+
+bool CBLCollection_AppendDocuments(CBLCollection* collection,
+                                   const FLString docIDs[],
+                                   const FLDict properties[],
+                                   size_t count,
+                                   size_t chunkSize,
+                                   CBLBatchProgressCallback callback,
+                                   void* context,
+                                   size_t* outAppended,
+                                   CBLError* outError) noexcept
+{
+    size_t appended = 0;
+    bool ok = false;
+    try {
+        collection->appendDocuments(docIDs, properties, count, chunkSize, callback, context, appended);
+        ok = true;
+    } catch (...) {
+        cbl_internal::BridgeException(__FUNCTION__, outError);
+    }
+    if (outAppended)
+        *outAppended = appended;
+    return ok;
+}
+
+bool CBLCollection_PurgeDocumentsWithPrefix(CBLCollection* collection,
+                                            FLString prefix,
+                                            size_t chunkSize,
+                                            CBLBatchProgressCallback callback,
+                                            void* context,
+                                            size_t* outPurged,
+                                            CBLError* outError) noexcept
+{
+    size_t purged = 0;
+    bool ok = false;
+    try {
+        collection->purgeDocumentsWithPrefix(prefix, chunkSize, callback, context, purged);
+        ok = true;
+    } catch (...) {
+        cbl_internal::BridgeException(__FUNCTION__, outError);
+    }
+    if (outPurged)
+        *outPurged = purged;
+    return ok;
+}
+
+CBLExpirationSweeper* CBLCollection_StartExpirationSweeper(CBLCollection* collection,
+                                                           const CBLExpirationSweeperOptions* options,
+                                                           CBLError* outError) noexcept
+{
+    try {
+        auto sweeper = make_retained<CBLExpirationSweeper>(collection, (options ? *options
+                                                                                : CBLExpirationSweeperOptions{}));
+        sweeper->start();
+        return sweeper.detach();
+    } catchAndBridge(outError)
+}
+
+bool CBLExpirationSweeper_Scan(CBLExpirationSweeper* sweeper, CBLError* outError) noexcept {
+    try {
+        sweeper->scan();
+        return true;
+    } catchAndBridge(outError)
+}
+
+CBLExpirationBacklog CBLExpirationSweeper_Backlog(const CBLExpirationSweeper* sweeper) noexcept {
+    return sweeper->backlog();
+}
+
+void CBLExpirationSweeper_Stop(CBLExpirationSweeper* sweeper) noexcept {
+    try {
+        sweeper->stop();
+    } catch (...) {
+        BridgeException(__FUNCTION__, nullptr);
+    }
+}
+
+CBLAggregateView* CBLCollection_CreateAggregateView(CBLCollection* collection,
+                                                   CBLAggregateViewConfiguration config,
+                                                   CBLError* outError) noexcept
+{
+    try {
+        auto view = make_retained<CBLAggregateView>(collection, config);
+        view->start();
+        return view.detach();
+    } catchAndBridge(outError)
+}
+
+FLMutableArray CBLAggregateView_Results(const CBLAggregateView* view) noexcept {
+    try {
+        return FLMutableArray_Retain(view->results());
+    } catchAndWarn()
+}
+
+CBLListenerToken* CBLAggregateView_AddChangeListener(CBLAggregateView* view,
+                                                     CBLAggregateViewChangeListener listener,
+                                                     void* context) noexcept
+{
+    return view->addChangeListener(listener, context).detach();
+}
+
 #pragma mark - INDEXES:
 
 bool CBLCollection_CreateValueIndex(CBLCollection *collection,
@@ -313,6 +583,42 @@ bool CBLCollection_CreateVectorIndex(CBLCollection *collection,
     } catchAndBridge(outError)
 }
 
+bool CBLCollection_AdviseVectorIndex(const CBLCollection *collection,
+                                     CBLVectorIndexConfiguration *config,
+                                     const CBLVectorIndexAdvisorOptions *options,
+                                     CBLVectorIndexEstimate *outEstimate,
+                                     CBLError *outError) noexcept
+{
+    try {
+        CBLVectorIndexEstimate estimate {};
+        AdviseVectorIndex(collection, *config, options ? *options : CBLVectorIndexAdvisorOptions {},
+                          estimate);
+        if (outEstimate)
+            *outEstimate = estimate;
+        return true;
+    } catchAndBridge(outError)
+}
+
+FLMutableArray CBLCollection_FindNearestVectors(const CBLCollection *collection,
+                                                const CBLVectorSearch *search,
+                                                const float target[],
+                                                unsigned dimensions,
+                                                CBLError *outError) noexcept
+{
+    try {
+        return FindNearestVectors(collection, *search, target, dimensions);
+    } catchAndBridge(outError)
+}
+
+FLSliceResult CBLCollection_ExplainVectorSearch(const CBLCollection *collection,
+                                                const CBLVectorSearch *search,
+                                                CBLError *outError) noexcept
+{
+    try {
+        return FLSliceResult(ExplainVectorSearch(collection, *search));
+    } catchAndBridge(outError)
+}
+
 /** Private API for testing purpose */
 bool CBLCollection_IsIndexTrained(const CBLCollection* collection,
                                   FLString name,
@@ -335,6 +641,83 @@ bool CBLCollection_DeleteIndex(CBLCollection *collection,
     } catchAndBridge(outError)
 }
 
+CBLIndexBuild* CBLCollection_CreateValueIndexAsync(CBLCollection *collection,
+                                                   FLString name,
+                                                   CBLValueIndexConfiguration config,
+                                                   CBLIndexBuildCallback callback,
+                                                   void* context) noexcept
+{
+    try {
+        auto spec = CBLCollection::valueIndexSpec(name, config);
+        return collection->createIndexAsync(std::move(spec), callback, context).detach();
+    } catchAndWarn();
+}
+
+CBLIndexBuild* CBLCollection_CreateFullTextIndexAsync(CBLCollection *collection,
+                                                      FLString name,
+                                                      CBLFullTextIndexConfiguration config,
+                                                      CBLIndexBuildCallback callback,
+                                                      void* context) noexcept
+{
+    try {
+        auto spec = CBLCollection::fullTextIndexSpec(name, config);
+        return collection->createIndexAsync(std::move(spec), callback, context).detach();
+    } catchAndWarn();
+}
+
+CBLIndexBuild* CBLCollection_CreateArrayIndexAsync(CBLCollection *collection,
+                                                   FLString name,
+                                                   CBLArrayIndexConfiguration config,
+                                                   CBLIndexBuildCallback callback,
+                                                   void* context) noexcept
+{
+    try {
+        auto spec = CBLCollection::arrayIndexSpec(name, config);
+        return collection->createIndexAsync(std::move(spec), callback, context).detach();
+    } catchAndWarn();
+}
+
+#ifdef COUCHBASE_ENTERPRISE
+
+CBLIndexBuild* CBLCollection_CreateVectorIndexAsync(CBLCollection *collection,
+                                                    FLString name,
+                                                    CBLVectorIndexConfiguration config,
+                                                    CBLIndexBuildCallback callback,
+                                                    void* context) noexcept
+{
+    try {
+        return collection->createVectorIndexAsync(name, config, callback, context).detach();
+    } catchAndWarn();
+}
+
+#endif
+
+FLString CBLIndexBuild_IndexName(const CBLIndexBuild* build) noexcept {
+    return build->name();
+}
+
+CBLIndexBuildState CBLIndexBuild_State(const CBLIndexBuild* build) noexcept {
+    return build->state();
+}
+
+bool CBLIndexBuild_Cancel(CBLIndexBuild* build) noexcept {
+    return build->cancel();
+}
+
+bool CBLCollection_SuspendIndexes(CBLCollection *collection, CBLError *outError) noexcept {
+    try {
+        collection->suspendIndexes();
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool CBLCollection_ResumeIndexes(CBLCollection *collection, CBLError *outError) noexcept {
+    try {
+        collection->resumeIndexes();
+        return true;
+    } catchAndBridge(outError)
+}
+
 FLMutableArray CBLCollection_GetIndexNames(CBLCollection *collection, CBLError *outError) noexcept {
     try {
         return FLMutableArray_Retain(collection->indexNames());
@@ -367,6 +750,42 @@ CBLListenerToken* CBLCollection_AddChangeListener(const CBLCollection* collectio
     } catchAndBridgeReturning(nullptr, make_retained<CBLListenerToken>((const void*)listener, nullptr).detach())
 }
 
+CBLListenerToken* CBLCollection_AddChangeBatchListener(const CBLCollection* collection,
+                                                       CBLCollectionChangeBatchListener listener,
+                                                       void* _cbl_nullable context) noexcept
+{
+    try {
+        // NOTE: In case there is an exception the function will log and return a dummy token.
+        return const_cast<CBLCollection*>(collection)->addChangeBatchListener(listener, context).detach();
+    } catchAndBridgeReturning(nullptr, make_retained<CBLListenerToken>((const void*)listener, nullptr).detach())
+}
+
+CBLChangeFeedBatch* CBLCollection_ChangesSince(const CBLCollection* collection,
+                                               uint64_t sinceSequence,
+                                               uint32_t limit,
+                                               bool includeBodies,
+                                               uint32_t waitMs,
+                                               CBLError* outError) noexcept
+{
+    try {
+        return collection->changesSince(sinceSequence, limit, includeBodies, waitMs).detach();
+    } catchAndBridge(outError)
+}
+
+size_t CBLChangeFeedBatch_Count(const CBLChangeFeedBatch* batch) noexcept {
+    return batch->count();
+}
+
+CBLChangeFeedEntry CBLChangeFeedBatch_Entry(const CBLChangeFeedBatch* batch, size_t index) noexcept {
+    try {
+        return batch->entry(index);
+    } catchAndWarn()
+}
+
+uint64_t CBLChangeFeedBatch_LastSequence(const CBLChangeFeedBatch* batch) noexcept {
+    return batch->lastSequence();
+}
+
 CBLListenerToken* CBLCollection_AddDocumentChangeListener(const CBLCollection* collection,
                                                         FLString docID,
                                                         CBLCollectionDocumentChangeListener listener,
@@ -24,11 +24,19 @@
 #include "CBLScope_Internal.hh"
 #include "CBLVectorIndexConfig.hh"
 #include "Defer.hh"
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 CBL_ASSUME_NONNULL_BEGIN
 
 using CollectionSpec = C4Database::CollectionSpec;
 
+struct CBLIndexBuild;
+
 using namespace litecore;
 
 struct CBLCollection final : public CBLRefCounted {
@@ -37,13 +45,13 @@ public:
     
 #pragma mark - CONSTRUCTORS:
     
-    CBLCollection(C4Collection* c4col, CBLScope* scope, CBLDatabase* database)
+    CBLCollection(C4Collection* c4col, CBLDatabase* database)
     :_c4col(c4col, database)
-    ,_scope(scope)
     ,_database(retain(database))
     ,_name(c4col->getName())
+    ,_scopeName(c4col->getScope())
     {
-        _fullName = alloc_slice(_scope->name());
+        _fullName = alloc_slice(_scopeName);
         _fullName.append(".");
         _fullName.append(_name);
     }
@@ -57,15 +65,38 @@ public:
     
 #pragma mark - ACCESSORS:
     
-    Retained<CBLScope> scope() const noexcept   {return _scope;}
     slice name() const noexcept                 {return _name;}
+    slice scopeName() const noexcept            {return _scopeName;}
     slice fullName() const noexcept             {return _fullName;}
-    C4CollectionSpec spec() const noexcept      {return {_name, _scope->name()};}
+    C4CollectionSpec spec() const noexcept      {return {_name, _scopeName};}
+
+    /** The scope object is only made when it's first asked for. An adopted collection's isn't
+        kept, since it would retain the database. */
+    Retained<CBLScope> scope() const {
+        LOCK(_adoptMutex);
+        if (_scope)
+            return _scope;
+        Retained<CBLScope> scope = new CBLScope(_scopeName, _database);
+        if (!_adopted)
+            _scope = scope;
+        return scope;
+    }
     bool isValid() const noexcept               {return _c4col.isValid();}
-    uint64_t count() const                      {return _c4col.useLocked()->getDocumentCount();}
+    
+    uint64_t count() const {
+        // The count is cached until a commit changes the collection:
+        if (int64_t cached = _database->cachedDocumentCount(_documentCount); cached >= 0)
+            return uint64_t(cached);
+        auto c4col = _c4col.useLocked();
+        return _database->documentCount(c4col.get(), _fullName, _documentCount);
+    }
+    
     uint64_t lastSequence() const               {return static_cast<uint64_t>(_c4col.useLocked()->getLastSequence());}
     CBLDatabase* database() const               {return _database; }
     
+    /** Implements \ref CBLCollection_AcquireReader. */
+    Retained<CBLCollection> acquireReader() const;
+    
 #pragma mark - DOCUMENTS:
     
     RetainedConst<CBLDocument> getDocument(slice docID, bool allRevisions =false) const {
@@ -76,12 +107,69 @@ public:
         return getDocument(docID, true, true);
     }
     
+    // Reads a batch of documents under a single lock. The lookups are made in docID order,
+    // for locality, but the results are in the same order as `docIDs`; missing (or deleted)
+    // documents are null.
+    std::vector<RetainedConst<CBLDocument>> getDocuments(const FLString docIDs[_cbl_nonnull],
+                                                         size_t count) const
+    {
+        std::vector<size_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            return slice(docIDs[a]) < slice(docIDs[b]);
+        });
+        
+        std::vector<Retained<C4Document>> c4docs(count);
+        {
+            auto c4col = _c4col.useLocked();
+            for (size_t i : order) {
+                try {
+                    c4docs[i] = c4col->getDocument(docIDs[i], true, kDocGetCurrentRev);
+                } catch (litecore::error& e) {
+                    if (e != litecore::error::BadDocID)
+                        throw;
+                    CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                            "Invalid document ID '%.*s' used", FMTSLICE(slice(docIDs[i])));
+                }
+            }
+        }
+        
+        std::vector<RetainedConst<CBLDocument>> docs(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (c4docs[i] && !(c4docs[i]->flags() & kDocDeleted))
+                docs[i] = new CBLDocument(docIDs[i], const_cast<CBLCollection*>(this), c4docs[i], false);
+        }
+        return docs;
+    }
+    
     bool deleteDocument(const CBLDocument *doc, CBLConcurrencyControl concurrency) {
         CBLDocument::SaveOptions opt(concurrency);
         opt.deleting = true;
         return const_cast<CBLDocument*>(doc)->save(this, opt);
     }
     
+    size_t saveDocuments(CBLDocument* const docs[_cbl_nonnull],
+                         size_t count,
+                         CBLConcurrencyControl concurrency,
+                         CBLError* _cbl_nullable outResults)
+    {
+        return CBLDocument::saveDocuments(this, docs, count, concurrency, outResults);
+    }
+    
+    // Creates or updates a document from JSON, transcoding it directly into the database's
+    // shared encoder without creating a CBLDocument or mutable dictionary. With
+    // kCBLConcurrencyControlFailOnConflict the save fails if the document already exists.
+    bool saveJSON(slice docID, slice json, CBLConcurrencyControl concurrency);
+    
+    /** Implements \ref CBLCollection_ImportJSONLines. */
+    bool importJSONLines(slice path, slice idProperty, const CBLImportOptions &options,
+                         CBLImportProgressCallback _cbl_nullable callback,
+                         void* _cbl_nullable context, CBLImportProgress &progress);
+    
+    /** Implements \ref CBLCollection_ChangesSince. */
+    Retained<CBLChangeFeedBatch> changesSince(uint64_t sinceSequence, uint32_t limit,
+                                              bool includeBodies, uint32_t waitMs) const;
+    
     bool deleteDocument(slice docID) {
         auto c4col = _c4col.useLocked();
         C4Database::Transaction t(c4col->getDatabase());
@@ -106,47 +194,105 @@ public:
         if (!_c4col.useLocked()->setExpiration(docID, C4Timestamp(expiration))) {
             C4Error::raise(LiteCoreDomain, kC4ErrorNotFound, "Document not found");
         }
+#ifdef COUCHBASE_ENTERPRISE
+        _database->rekeyExpirationChanged(_fullName, docID);
+#endif
     }
     
+    /** Implements \ref CBLCollection_PurgeDocuments; `outPurged` is updated as it goes. */
+    void purgeDocuments(const FLString docIDs[_cbl_nonnull], size_t count, size_t chunkSize,
+                        CBLBatchProgressCallback _cbl_nullable callback, void* _cbl_nullable context,
+                        size_t &outPurged);
+
+    /** Implements \ref CBLCollection_DeleteDocuments; `outDeleted` is updated as it goes. */
+    void deleteDocuments(const FLString docIDs[_cbl_nonnull], size_t count, size_t chunkSize,
+                         CBLConcurrencyControl concurrency,
+                         CBLBatchProgressCallback _cbl_nullable callback, void* _cbl_nullable context,
+                         CBLError* _cbl_nullable outResults, size_t &outDeleted);
+
+    /** Implements \ref CBLCollection_AppendDocuments; `outAppended` is updated as it goes. */
+    void appendDocuments(const FLString docIDs[_cbl_nonnull], const FLDict properties[_cbl_nonnull],
+                         size_t count, size_t chunkSize,
+                         CBLBatchProgressCallback _cbl_nullable callback, void* _cbl_nullable context,
+                         size_t &outAppended);
+    
+    /** Implements \ref CBLCollection_PurgeDocumentsWithPrefix; `outPurged` is updated as it goes. */
+    void purgeDocumentsWithPrefix(slice prefix, size_t chunkSize,
+                                  CBLBatchProgressCallback _cbl_nullable callback,
+                                  void* _cbl_nullable context, size_t &outPurged);
+    
+    /** Implements \ref CBLCollection_SetDocumentExpirations; `outUpdated` is updated as it goes. */
+    void setDocumentExpirations(const FLString docIDs[_cbl_nonnull],
+                                const CBLTimestamp expirations[_cbl_nonnull],
+                                size_t count, size_t chunkSize,
+                                CBLBatchProgressCallback _cbl_nullable callback,
+                                void* _cbl_nullable context, size_t &outUpdated);
+    
 #pragma mark - INDEXES:
     
-    void createValueIndex(slice name, CBLValueIndexConfiguration config) {
-        C4IndexOptions options = {};
-        _c4col.useLocked()->createIndex(name, config.expressions,
-                                        (C4QueryLanguage)config.expressionLanguage,
-                                        kC4ValueIndex, &options);
+    // The definition of a value, full-text or array index, as needed to create it again:
+    struct IndexSpec {
+        alloc_slice     name;
+        C4IndexType     type;
+        C4QueryLanguage language;
+        alloc_slice     expressions;
+        bool            ignoreDiacritics {false};   // Full-text index
+        alloc_slice     ftsLanguage;                // Full-text index
+        alloc_slice     unnestPath;                 // Array index
+        alloc_slice     where;                      // Value or array index, if partial
+    };
+    
+    static IndexSpec valueIndexSpec(slice name, const CBLValueIndexConfiguration &config) {
+        alloc_slice exprs = config.expressions;
+        if (config.includedExpressions.buf)
+            exprs = appendIndexExpressions(config.expressionLanguage, exprs, config.includedExpressions);
+        return {name, kC4ValueIndex, (C4QueryLanguage)config.expressionLanguage, exprs,
+                false, nullslice, nullslice, config.where};
     }
+
+    /** Appends `more` to the index expressions `exprs`, both in the given language. */
+    static alloc_slice appendIndexExpressions(CBLQueryLanguage language, slice exprs, slice more);
     
-    void createFullTextIndex(slice name, CBLFullTextIndexConfiguration config) {
-        C4IndexOptions options = {};
-        options.ignoreDiacritics = config.ignoreAccents;
-        
-        std::string languageStr;
-        if (config.language.buf) {
-            languageStr = std::string(config.language);
-            options.language = languageStr.c_str();
-        }
-        
-        _c4col.useLocked()->createIndex(name, config.expressions,
-                                        (C4QueryLanguage)config.expressionLanguage,
-                                        kC4FullTextIndex, &options);
+    static IndexSpec fullTextIndexSpec(slice name, const CBLFullTextIndexConfiguration &config) {
+        return {name, kC4FullTextIndex, (C4QueryLanguage)config.expressionLanguage,
+                config.expressions, config.ignoreAccents, config.language};
     }
     
-    void createArrayIndex(slice name, CBLArrayIndexConfiguration config) {
-        C4IndexOptions options = {};
-        options.unnestPath = (char*)config.path.buf;
-        
+    static IndexSpec arrayIndexSpec(slice name, const CBLArrayIndexConfiguration &config) {
         auto exprs = config.expressions;
         if (!exprs.buf && config.expressionLanguage == kCBLJSONLanguage) {
             exprs = FLStr("[]");
         }
-        
-        config.expressions = exprs;
-        _c4col.useLocked()->createIndex(name, exprs,
-                                        (C4QueryLanguage)config.expressionLanguage,
-                                        kC4ArrayIndex, &options);
+        return {name, kC4ArrayIndex, (C4QueryLanguage)config.expressionLanguage,
+                exprs, false, nullslice, config.path, config.where};
+    }
+    
+    void createValueIndex(slice name, CBLValueIndexConfiguration config) {
+        createIndex(valueIndexSpec(name, config));
     }
     
+    void createFullTextIndex(slice name, CBLFullTextIndexConfiguration config) {
+        createIndex(fullTextIndexSpec(name, config));
+    }
+    
+    void createArrayIndex(slice name, CBLArrayIndexConfiguration config) {
+        createIndex(arrayIndexSpec(name, config));
+    }
+    
+    /** Creates a value, full-text or array index in the background. */
+    Retained<CBLIndexBuild> createIndexAsync(IndexSpec spec,
+                                             CBLIndexBuildCallback _cbl_nullable callback,
+                                             void* _cbl_nullable context);
+    
+    /** Deletes the collection's value, full-text and array indexes, saving their definitions in
+        the database so that \ref resumeIndexes can create them again. Indexes that were created
+        before the collection was opened are suspended only if they're value indexes, since
+        LiteCore doesn't return the options of the others. */
+    void suspendIndexes();
+    
+    /** Creates the indexes suspended by \ref suspendIndexes again, each in one pass. */
+    void resumeIndexes();
+    
 #ifdef COUCHBASE_ENTERPRISE
     
     void createVectorIndex(slice name, CBLVectorIndexConfiguration config) {
@@ -205,17 +351,21 @@ public:
         _c4col.useLocked()->createIndex(name, config.expression,
                                         (C4QueryLanguage)config.expressionLanguage,
                                         kC4VectorIndex, &options);
+        _database->invalidateQueryCache();
     }
     
+    /** Creates a vector index in the background, with a copy of the configuration. */
+    Retained<CBLIndexBuild> createVectorIndexAsync(slice name, CBLVectorIndexConfiguration config,
+                                                   CBLIndexBuildCallback _cbl_nullable callback,
+                                                   void* _cbl_nullable context);
+    
     bool isIndexTrained(slice name) const {
         return _c4col.useLocked()->isIndexTrained(name);
     }
 
 #endif
     
-    void deleteIndex(slice name) {
-        _c4col.useLocked()->deleteIndex(name);
-    }
+    void deleteIndex(slice name);
 
     fleece::MutableArray indexNames() {
         Doc doc(_c4col.useLocked()->getIndexesInfo());
@@ -229,6 +379,17 @@ public:
     
     Retained<CBLQueryIndex> getIndex(slice name);
     
+    /** The raw-document store where the definitions of suspended indexes are saved, keyed by
+        collection full name. */
+    static constexpr slice kSuspendedIndexesStore = "cbl_suspendedIndexes"_sl;
+
+    /** The query language of an index's expressions, from its entry in `indexesInfo`. */
+    static C4QueryLanguage indexLanguage(Dict info) {
+        if (Value lang = info["lang"]; lang)
+            return (lang.asString() == "json"_sl) ? kC4JSONQuery : kC4N1QLQuery;
+        return info["expr"].asString().hasPrefix("["_sl) ? kC4JSONQuery : kC4N1QLQuery;
+    }
+    
     fleece::MutableArray indexesInfo() const {
         Doc doc(_c4col.useLocked()->getIndexesInfo());
         return doc.root().asArray().mutableCopy();
@@ -242,6 +403,12 @@ public:
         return addListener([&]{ return _listeners.add(listener, ctx); });
     }
     
+    Retained<CBLListenerToken> addChangeBatchListener(CBLCollectionChangeBatchListener listener,
+                                                      void* _cbl_nullable ctx)
+    {
+        return addListener([&]{ return _batchListeners.add(listener, ctx); });
+    }
+    
     Retained<CBLListenerToken> addDocumentListener(slice docID,
                                                    CBLCollectionDocumentChangeListener listener,
                                                    void* _cbl_nullable ctx);
@@ -270,7 +437,8 @@ protected:
         assert(_database == db);
         LOCK(_adoptMutex);
         if (!_adopted) {
-            _scope->adopt(db);
+            if (_scope)
+                _scope->adopt(db);
             release(_database);
             _adopted = true;
         }
@@ -302,6 +470,28 @@ private:
         return new CBLDocument(docID, const_cast<CBLCollection*>(this), c4doc, isMutable);
     }
     
+    // Calls `fn` with each index in [0, count), in transactions of `chunkSize`, unlocking the
+    // collection between them. `fn` returns true if it changed the document.
+    void inChunks(size_t count, size_t chunkSize, CBLBatchProgressCallback _cbl_nullable callback,
+                  void* _cbl_nullable context, size_t &outChanged,
+                  fleece::function_ref<bool(C4Collection*, size_t)> fn);
+    
+    // Saves a revision whose body is already encoded with the database's shared keys.
+    // Returns false if the document exists and `concurrency` is kCBLConcurrencyControlFailOnConflict.
+    static bool putBody(C4Collection *c4col, slice docID, slice body, C4RevisionFlags revFlags,
+                        CBLConcurrencyControl concurrency);
+    
+#pragma mark - INDEXES:
+    
+    void createIndex(const IndexSpec &spec);
+    static void createC4Index(C4Collection *c4col, const IndexSpec &spec);
+    
+    std::vector<IndexSpec> suspendedIndexes(C4Database *c4db) const;
+    void saveSuspendedIndexes(C4Database *c4db, const std::vector<IndexSpec> &specs) const;
+    
+    // Returns true if a suspended index with the given name was removed from the list:
+    bool unsuspendIndex(C4Database *c4db, slice name) const;
+    
 #pragma mark - LISTENERS:
     
     Retained<CBLListenerToken> addListener(fleece::function_ref<Retained<CBLListenerToken>()> cb) {
@@ -314,11 +504,15 @@ private:
     }
     
     void collectionChanged() {
-        _database->notify(std::bind(&CBLCollection::callCollectionChangeListeners, this));
+        _database->notify(this, [this] {callCollectionChangeListeners();});
     }
 
     void callCollectionChangeListeners() {
         static const uint32_t kMaxChanges = 100;
+        // Batch listeners get all the changes at once, so they're accumulated here:
+        std::vector<C4CollectionObserver::Change> batch;
+        std::vector<bool> batchExternal;
+        bool batching = !_batchListeners.empty();
         while (true) {
             C4CollectionObserver::Change c4changes[kMaxChanges];
             auto result = _observer->getChanges(c4changes, kMaxChanges);
@@ -337,6 +531,23 @@ private:
                 change.docIDs = docIDs;
                 _listeners.call(&change);
             }
+            
+            if (batching) {
+                batch.insert(batch.end(), std::make_move_iterator(&c4changes[0]),
+                             std::make_move_iterator(&c4changes[nChanges]));
+                batchExternal.resize(batch.size(), result.external);
+            }
+        }
+        
+        if (!batch.empty()) {
+            std::vector<CBLCollectionChangeEntry> entries(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i) {
+                auto &c4change = batch[i];
+                entries[i] = {c4change.docID, c4change.revID, uint64_t(c4change.sequence), c4change.bodySize,
+                              (c4change.flags & kRevDeleted) != 0, bool(batchExternal[i])};
+            }
+            CBLCollectionChangeBatch changes = {this, entries.size(), entries.data()};
+            _batchListeners.call(&changes);
         }
     }
     
@@ -364,6 +575,21 @@ private:
             LOCK_GUARD lock(getMutex());
             return _isValid();
         }
+
+        // These time the lock, when enabled by CBL_SetLockTiming:
+        using shared_access_lock::useLocked;
+
+        template <class CALLBACK>
+        decltype(auto) useLocked(CALLBACK callback) {
+            cbl_internal::TimedLock timing(getMutex(), cbl_internal::LockTiming::kCollection, std::defer_lock);
+            return shared_access_lock::useLocked(callback);
+        }
+
+        auto useLocked() {
+            cbl_internal::TimedLock timing(getMutex(), cbl_internal::LockTiming::kCollection, std::defer_lock);
+            timing.skipHoldTime();
+            return shared_access_lock::useLocked();
+        }
         
     private:
         // Unsafe: need to call under lock:
@@ -378,16 +604,55 @@ private:
     C4CollectionAccessLock                                  _c4col;     // Shared lock with _c4db
     
     alloc_slice                                             _name;
+    alloc_slice                                             _scopeName;
     alloc_slice                                             _fullName;
-    Retained<CBLScope>                                      _scope;
+    mutable Retained<CBLScope>                              _scope;            // Made on demand; under _adoptMutex
     
     CBLDatabase*                                            _database;         // Retained unless being adopted
     bool                                                    _adopted {false};  // Adopted by the database
     mutable std::mutex                                      _adoptMutex;
     
+    std::unordered_map<std::string, IndexSpec>              _indexSpecs;       // Indexes created via this object; under _c4col's lock
+    
+    mutable std::atomic<CBLDatabase::DocumentCount*>        _documentCount {nullptr};  // Set by the database
+    
     std::unique_ptr<C4CollectionObserver>                   _observer;
     Listeners<CBLCollectionChangeListener>                  _listeners;
+    Listeners<CBLCollectionChangeBatchListener>             _batchListeners;
     Listeners<CBLCollectionDocumentChangeListener>          _docListeners;
 };
 
+
+struct CBLChangeFeedBatch final : public CBLRefCounted {
+public:
+    CBLChangeFeedBatch(uint64_t sinceSequence)
+    :_lastSequence(sinceSequence)
+    { }
+    
+    void add(Retained<C4Document> doc, const C4DocumentInfo &info, bool includeBody) {
+        // The entry's strings and body belong to the document, which the batch keeps:
+        CBLChangeFeedEntry entry {uint64_t(info.sequence), doc->docID(), doc->revID(),
+                                  (info.flags & kDocDeleted) != 0, nullptr};
+        if (includeBody && !entry.deleted)
+            entry.body = doc->getProperties();
+        _entries.push_back(entry);
+        _docs.push_back(std::move(doc));
+        _lastSequence = entry.sequence;
+    }
+    
+    size_t count() const                                {return _entries.size();}
+    
+    const CBLChangeFeedEntry& entry(size_t index) const {
+        precondition(index < _entries.size());
+        return _entries[index];
+    }
+    
+    uint64_t lastSequence() const                       {return _lastSequence;}
+    
+private:
+    std::vector<CBLChangeFeedEntry>     _entries;
+    std::vector<Retained<C4Document>>   _docs;
+    uint64_t                            _lastSequence;
+};
+
 CBL_ASSUME_NONNULL_END
@@ -17,7 +17,11 @@
 //
 
 #import <Foundation/Foundation.h>
+#if TARGET_OS_IOS || TARGET_OS_TV
+#import <BackgroundTasks/BackgroundTasks.h>
+#endif
 #include "CBLDatabase_Internal.hh"
+#include "CBLPlatform.h"
 #include "c4Error.h"
 
 
@@ -71,3 +75,66 @@ std::string CBLDatabase::defaultDirectory() {
         return path.fileSystemRepresentation;
     }
 }
+
+
+#pragma mark - BACKGROUND MAINTENANCE:
+
+
+#if TARGET_OS_IOS || TARGET_OS_TV
+API_AVAILABLE(ios(13.0), tvos(13.0))
+static void scheduleBackgroundMaintenance(NSString* identifier) {
+    // A processing task only runs while the device is idle; requiring power adds "charging":
+    BGProcessingTaskRequest* request = [[BGProcessingTaskRequest alloc] initWithIdentifier: identifier];
+    request.requiresExternalPower = YES;
+    request.requiresNetworkConnectivity = NO;
+    NSError* error;
+    if (![BGTaskScheduler.sharedScheduler submitTaskRequest: request error: &error]) {
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                "Could not schedule background maintenance: %s",
+                error.localizedDescription.UTF8String);
+    }
+}
+#endif
+
+
+bool CBL_RegisterBackgroundMaintenanceTask(FLString identifier,
+                                           uint32_t budgetMs,
+                                           CBLError* _cbl_nullable outError) noexcept
+{
+    try {
+#if TARGET_OS_IOS || TARGET_OS_TV
+        if (@available(iOS 13.0, tvOS 13.0, *)) {
+            @autoreleasepool {
+                NSString* taskID = [[NSString alloc] initWithBytes: identifier.buf
+                                                            length: identifier.size
+                                                          encoding: NSUTF8StringEncoding];
+                if (!taskID.length) {
+                    C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                                   "Invalid background task identifier");
+                }
+                BOOL registered = [BGTaskScheduler.sharedScheduler
+                                   registerForTaskWithIdentifier: taskID
+                                   usingQueue: nil
+                                   launchHandler: ^(BGTask* task) {
+                    // This is called on a background queue, so the maintenance can run here:
+                    task.expirationHandler = ^{
+                        CBL_CancelBackgroundMaintenance();
+                    };
+                    bool done = CBL_RunBackgroundMaintenance(budgetMs);
+                    scheduleBackgroundMaintenance(taskID);
+                    [task setTaskCompletedWithSuccess: done];
+                }];
+                if (!registered) {
+                    C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported,
+                                   "Could not register background task %s",
+                                   taskID.UTF8String);
+                }
+                scheduleBackgroundMaintenance(taskID);
+                return true;
+            }
+        }
+#endif
+        C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported,
+                       "Background tasks are not supported on this platform");
+    } catchAndBridge(outError)
+}
@@ -19,14 +19,24 @@
 #include "CBLDatabase_Internal.hh"
 #include "CBLBlob_Internal.hh"
 #include "CBLCollection_Internal.hh"
+#include "CBLPrediction_Internal.hh"
 #include "CBLQuery_Internal.hh"
 #include "CBLPrivate.h"
 #include "CBLScope_Internal.hh"
+#include "c4DocEnumerator.hh"
 #include "c4Observer.hh"
 #include "c4Query.hh"
 #include "Internal.hh"
+#include "Trace.hh"
+#include "TaskPool.hh"
+#include "FilePath.hh"
 #include "fleece/function_ref.hh"
 #include "fleece/PlatformCompat.hh"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <thread>
+#include <unordered_set>
 #include <sys/stat.h>
 
 #ifndef CMAKE
@@ -82,9 +92,10 @@ bool CBLEncryptionKey_FromPasswordOld(CBLEncryptionKey *key, FLString password)
 #pragma mark - CONSTRUCTORS:
 
 
-CBLDatabase::CBLDatabase(C4Database* _cbl_nonnull db, slice name_, slice dir_)
+CBLDatabase::CBLDatabase(C4Database* _cbl_nonnull db, slice name_, slice dir_, size_t queryCacheSize)
 :_dir(dir_)
 ,_name(name_)
+,_queryCache(queryCacheSize)
 ,_notificationQueue(this)
 {
     _c4db = std::make_shared<C4DatabaseAccessLock>(db);
@@ -103,9 +114,22 @@ CBLDatabase::~CBLDatabase() {
 
 void CBLDatabase::close() {
     stopActiveStoppables();
+    finishAsyncWrites();
+    closeReaders();
+#ifdef COUCHBASE_ENTERPRISE
+    {
+        LOCK(_rekeyMutex);
+        if (_rekeyDB) {
+            _rekeyDB->close();
+            _rekeyDB = nullptr;
+        }
+    }
+#endif
     
     try {
         auto db = _c4db->useLocked();
+        closeDocumentCounts();
+        closeVersionObservers();
         db->close();
         _closed();
     } catch (litecore::error& e) {
@@ -119,8 +143,15 @@ void CBLDatabase::close() {
 
 void CBLDatabase::closeAndDelete() {
     stopActiveStoppables();
+    finishAsyncWrites();
+    closeReaders();
+#ifdef COUCHBASE_ENTERPRISE
+    cancelRekey();
+#endif
     
     auto db = _c4db->useLocked();
+    closeDocumentCounts();
+    closeVersionObservers();
     db->closeAndDeleteFile();
     _closed();
 }
@@ -128,11 +159,373 @@ void CBLDatabase::closeAndDelete() {
 
 /** Must called under _c4db lock. */
 void CBLDatabase::_closed() {
+    // Release the cached queries and collections, which refer to the C4Database:
+    _queryCache.clear();
+    clearCollectionCache();
+    
     // Close the access lock:
     _c4db->close();
 }
 
 
+// The most read-only connections kept for reuse by acquireReader:
+static constexpr size_t kMaxPooledReaders = 4;
+
+
+Retained<CBLDatabase> CBLDatabase::acquireReader() {
+    if (_isReader)
+        return this;
+    {
+        LOCK(_readersMutex);
+        for (auto &reader : _readers) {
+            if (reader->refCount() == 1 && !reader->_c4db->isClosedNoLock())
+                return reader;
+        }
+    }
+    
+    Retained<CBLDatabase> reader;
+    {
+        auto c4db = _c4db->useLocked();
+        C4DatabaseConfig2 c4config = c4db->getConfiguration();
+        c4config.flags = (c4config.flags & ~kC4DB_Create) | kC4DB_ReadOnly;
+        Retained<C4Database> c4reader = C4Database::openNamed(_name, c4config);
+        reader = new CBLDatabase(c4reader, _name, c4config.parentDirectory, _queryCache.capacity());
+    }
+    reader->_isReader = true;
+    
+    LOCK(_readersMutex);
+    // Replace a reader the app closed, or add this one if the pool isn't full:
+    auto closed = std::find_if(_readers.begin(), _readers.end(), [](auto &r) {
+        return r->refCount() == 1 && r->_c4db->isClosedNoLock();
+    });
+    if (closed != _readers.end())
+        *closed = reader;
+    else if (_readers.size() < kMaxPooledReaders)
+        _readers.push_back(reader);
+    return reader;
+}
+
+
+void CBLDatabase::closeReaders() {
+    std::vector<Retained<CBLDatabase>> readers;
+    {
+        LOCK(_readersMutex);
+        readers.swap(_readers);
+    }
+    for (auto &reader : readers)
+        reader->close();
+}
+
+
+#pragma mark - GROUP COMMIT:
+
+
+struct CBLDatabase::GroupWrite {
+    CBLCollection*                              collection;
+    function_ref<bool(C4Collection*)>           write;
+    std::exception_ptr                          error;
+    bool                                        done {false};
+};
+
+
+void CBLDatabase::writeInTransaction(CBLCollection* collection,
+                                     function_ref<bool(C4Collection*)> write)
+{
+    // Writes in an explicit transaction are committed with it:
+    if (_groupCommitWindow.count() == 0 || _c4db->useLocked()->isInTransaction()) {
+        collection->useLocked([&](C4Collection* c4col) {
+            C4Database::Transaction t(c4col->getDatabase());
+            if (write(c4col)) {
+                TraceSpan span(kCBLTraceCommit);
+                span.addItems(1);
+                t.commit();
+            }
+        });
+        return;
+    }
+
+    GroupWrite groupWrite {collection, write};
+    std::unique_lock<std::mutex> lock(_groupMutex);
+    _groupWrites.push_back(&groupWrite);
+    if (_groupGathering) {
+        // Another thread will commit this write along with its own:
+        _groupCond.wait(lock, [&] {return groupWrite.done;});
+    } else {
+        // Give other threads' writes time to join this one, then commit them all:
+        _groupGathering = true;
+        lock.unlock();
+        std::this_thread::sleep_for(_groupCommitWindow);
+        lock.lock();
+        std::vector<GroupWrite*> writes;
+        writes.swap(_groupWrites);
+        _groupGathering = false;
+        lock.unlock();
+
+        commitGroup(writes);
+
+        lock.lock();
+        for (auto w : writes)
+            w->done = true;
+        _groupCond.notify_all();
+    }
+    if (groupWrite.error)
+        std::rethrow_exception(groupWrite.error);
+}
+
+
+void CBLDatabase::commitGroup(const std::vector<GroupWrite*> &writes) {
+    try {
+        _c4db->useLocked([&](Retained<C4Database> &c4db) {
+            C4Database::Transaction t(c4db);
+            for (auto w : writes) {
+                try {
+                    w->collection->useLocked([&](C4Collection* c4col) {
+                        w->write(c4col);
+                    });
+                } catch (...) {
+                    w->error = std::current_exception();
+                }
+            }
+            TraceSpan span(kCBLTraceCommit);
+            span.addItems(writes.size());
+            t.commit();
+        });
+    } catch (...) {
+        // The transaction wasn't committed, so none of the writes were saved:
+        for (auto w : writes) {
+            if (!w->error)
+                w->error = std::current_exception();
+        }
+    }
+}
+
+
+#pragma mark - DOCUMENT COUNTS:
+
+
+uint64_t CBLDatabase::documentCount(C4Collection* c4col, slice fullName,
+                                    std::atomic<DocumentCount*> &cache)
+{
+    DocumentCount* count = cache.load(std::memory_order_acquire);
+    if (!count) {
+        // Every CBLCollection object for the collection shares one cache:
+        auto &entry = _documentCounts[string(fullName)];
+        if (!entry)
+            entry = std::make_unique<DocumentCount>();
+        count = entry.get();
+        cache.store(count, std::memory_order_release);
+    }
+    
+    if (!count->observer) {
+        // The observer is told of commits on this and other connections to the database:
+        count->observer = c4col->observe([count](C4CollectionObserver*) {
+            count->invalidate();
+        });
+    } else {
+        // It calls back once until its changes are read, so read them:
+        C4CollectionObserver::Change changes[100];
+        while (count->observer->getChanges(changes, 100).numChanges > 0) { }
+    }
+    
+    int64_t known = count->value.load();
+    if (known >= 0 && _transactionLevel == 0)
+        return uint64_t(known);
+    uint64_t n = c4col->getDocumentCount();
+    // Cache it, unless a commit has invalidated the count meanwhile:
+    if (_transactionLevel == 0)
+        count->value.compare_exchange_strong(known, int64_t(n));
+    return n;
+}
+
+
+/** Must be called under _c4db lock. */
+void CBLDatabase::closeDocumentCount(slice fullName) {
+    if (auto i = _documentCounts.find(string(fullName)); i != _documentCounts.end()) {
+        i->second->observer.reset();
+        i->second->invalidate();
+    }
+}
+
+
+/** Must be called under _c4db lock. */
+void CBLDatabase::closeDocumentCounts() {
+    for (auto &entry : _documentCounts) {
+        entry.second->observer.reset();
+        entry.second->invalidate();
+    }
+}
+
+
+#pragma mark - DATA VERSION:
+
+
+// Counts collection creations and deletions by every database in the process, so that
+// `dataVersion` only lists the collections again when one may have appeared or gone.
+// (Changes by other processes aren't seen until this database is reopened.)
+static std::atomic<uint64_t> sCollectionChanges {0};
+
+
+uint64_t CBLDatabase::dataVersion() const {
+    auto c4db = _c4db->useLocked();
+    if (_transactionLevel > 0)
+        return 0;
+
+    // The observers are told of commits on this and other connections to the database, but
+    // another connection can also create or delete collections, so the collections are listed
+    // again whenever that's happened; one that's appeared or gone changes the version:
+    uint64_t generation = sCollectionChanges.load();
+    if (!_versionObserversOpen || generation != _versionCollectionsGeneration) {
+        std::unordered_set<string> current;
+        c4db->forEachScope([&](slice scope) {
+            c4db->forEachCollection(scope, [&](C4CollectionSpec spec) {
+                string fullName = string(slice(spec.scope)) + "." + string(slice(spec.name));
+                current.insert(fullName);
+                if (_versionObservers.count(fullName))
+                    return;
+                C4Collection *c4col = c4db->getCollection(spec);
+                if (!c4col)
+                    return;
+                auto obs = std::make_unique<VersionObserver>();
+                obs->observer = c4col->observe([this, o = obs.get()](C4CollectionObserver*) {
+                    o->notified = true;
+                    ++_dataVersion;
+                });
+                _versionObservers.emplace(std::move(fullName), std::move(obs));
+                if (_versionObserversOpen)
+                    ++_dataVersion;
+            });
+        });
+        for (auto i = _versionObservers.begin(); i != _versionObservers.end(); ) {
+            if (!current.count(i->first)) {
+                i = _versionObservers.erase(i);
+                ++_dataVersion;
+            } else {
+                ++i;
+            }
+        }
+        _versionObserversOpen = true;
+        _versionCollectionsGeneration = generation;
+    }
+
+    // An observer calls back once until its changes are read, so read them:
+    C4CollectionObserver::Change changes[100];
+    for (auto &[fullName, obs] : _versionObservers) {
+        if (obs->notified.exchange(false)) {
+            while (obs->observer->getChanges(changes, 100).numChanges > 0) { }
+        }
+    }
+    return _dataVersion;
+}
+
+
+/** Must be called under _c4db lock. */
+void CBLDatabase::closeVersionObservers() const {
+    _versionObservers.clear();
+    _versionObserversOpen = false;
+    ++_dataVersion;
+}
+
+
+#pragma mark - ASYNC WRITES:
+
+
+struct CBLDatabase::AsyncWrite {
+    Retained<CBLCollection>                     collection;
+    Retained<CBLDocument>                       doc;
+    CBLConcurrencyControl                       concurrency;
+    bool                                        deleting;
+    CBLDocumentWriteCallback _cbl_nullable      callback;
+    void* _cbl_nullable                         context;
+};
+
+
+void CBLDatabase::writeAsync(CBLCollection* collection, CBLDocument* doc,
+                             CBLConcurrencyControl concurrency, bool deleting,
+                             CBLDocumentWriteCallback callback, void* context)
+{
+    if (!deleting && !doc->isMutable())
+        C4Error::raise(LiteCoreDomain, kC4ErrorNotWriteable, "Document object is immutable");
+    CBLDocument::checkCollectionMatches(doc->collection(), collection);
+    
+    LOCK(_asyncMutex);
+    if (_asyncClosed)
+        C4Error::raise(LiteCoreDomain, kC4ErrorNotOpen, "Database is closing");
+    if (_asyncWrites.size() >= _asyncWriteLimit)
+        C4Error::raise(LiteCoreDomain, kC4ErrorBusy, "Too many asynchronous writes are queued");
+    _asyncWrites.push_back({collection, doc, concurrency, deleting, callback, context});
+    if (!_asyncWriting) {
+        // The task owns a reference to the database until it has written the queue:
+        _asyncWriting = true;
+        retain(this);
+        AsyncTasks::runBlocking([](void* context) {
+            auto self = (CBLDatabase*)context;
+            self->runAsyncWrites();
+            release(self);
+        }, this);
+    }
+}
+
+
+void CBLDatabase::runAsyncWrites() {
+    while (true) {
+        std::vector<AsyncWrite> writes;
+        {
+            LOCK(_asyncMutex);
+            if (_asyncWrites.empty()) {
+                _asyncWriting = false;
+                _asyncCond.notify_all();
+                return;
+            }
+            writes.swap(_asyncWrites);
+        }
+        
+        // Everything queued since the last batch is committed in one transaction:
+        std::vector<CBLError> errors(writes.size());
+        try {
+            _c4db->useLocked([&](Retained<C4Database> &c4db) {
+                C4Database::Transaction t(c4db);
+                for (size_t i = 0; i < writes.size(); ++i) {
+                    auto &w = writes[i];
+                    try {
+                        bool ok;
+                        if (w.deleting)
+                            ok = w.collection->deleteDocument(w.doc, w.concurrency);
+                        else
+                            ok = w.doc->save(w.collection, {w.concurrency});
+                        if (!ok)
+                            errors[i] = external(C4Error{LiteCoreDomain, kC4ErrorConflict});
+                    } catch (...) {
+                        errors[i] = external(C4Error::fromCurrentException());
+                    }
+                }
+                t.commit();
+            });
+        } catch (...) {
+            // The transaction wasn't committed, so none of the writes were saved:
+            CBLError error = external(C4Error::fromCurrentException());
+            for (auto &e : errors) {
+                if (!e.code)
+                    e = error;
+            }
+        }
+        
+        for (size_t i = 0; i < writes.size(); ++i) {
+            auto &w = writes[i];
+            if (w.callback)
+                w.callback(w.context, w.doc, errors[i].code ? &errors[i] : nullptr);
+        }
+    }
+}
+
+
+/** Stops accepting asynchronous writes, and waits for the queued ones to be committed. */
+void CBLDatabase::finishAsyncWrites() {
+    std::unique_lock<std::mutex> lock(_asyncMutex);
+    _asyncClosed = true;
+    _asyncCond.wait(lock, [this] {return !_asyncWriting;});
+}
+
+
 #pragma mark - SCOPES:
 
 
@@ -140,6 +533,17 @@ Retained<CBLScope> CBLDatabase::getScope(slice scopeName) {
     if (!scopeName)
         scopeName = kC4DefaultScopeID;
     
+    // A scope exists if a collection in it does:
+    {
+        std::shared_lock<std::shared_mutex> lock(_collectionCacheMutex);
+        if (collectionCacheIsCurrent()) {
+            for (auto &[fullName, c4col] : _collectionCache) {
+                if (c4col->getScope() == scopeName)
+                    return new CBLScope(scopeName, this);
+            }
+        }
+    }
+    
     auto c4db = _c4db->useLocked();
     
     bool exist = c4db->hasScope(scopeName);
@@ -153,19 +557,68 @@ Retained<CBLScope> CBLDatabase::getScope(slice scopeName) {
 #pragma mark - COLLECTIONS:
 
 
+// Counts collection deletions by every database in the process. A database's cache of the
+// collections it has looked up is only used while this hasn't changed, since one of them may
+// have been deleted through another database instance. (Deletions by other processes aren't
+// seen, as with the CBLCollection objects themselves.)
+// It's incremented both before and after a deletion: a lookup that ran while the collection
+// was being deleted read the count before the second increment, so its result isn't cached.
+static std::atomic<uint64_t> sCollectionDeletions {0};
+
+
+bool CBLDatabase::collectionCacheIsCurrent() const {
+    return _collectionCacheGeneration == sCollectionDeletions.load() && !_c4db->isClosedNoLock();
+}
+
+
+// `generation` is the value of sCollectionDeletions from before the collection was looked up.
+void CBLDatabase::cacheCollection(const string &fullName, C4Collection* _cbl_nullable c4col,
+                                  uint64_t generation)
+{
+    std::unique_lock<std::shared_mutex> lock(_collectionCacheMutex);
+    if (generation != sCollectionDeletions.load())
+        return;     // A collection was deleted meanwhile, so `c4col` may be stale
+    if (generation != _collectionCacheGeneration) {
+        _collectionCache.clear();
+        _collectionCacheGeneration = generation;
+    }
+    if (c4col)
+        _collectionCache[fullName] = c4col;
+    else
+        _collectionCache.erase(fullName);
+}
+
+
+void CBLDatabase::clearCollectionCache() {
+    std::unique_lock<std::shared_mutex> lock(_collectionCacheMutex);
+    _collectionCache.clear();
+}
+
+
 Retained<CBLCollection> CBLDatabase::getCollection(slice collectionName, slice scopeName) {
     if (!scopeName)
         scopeName = kC4DefaultScopeID;
     
+    string fullName = string(scopeName) + "." + string(collectionName);
+    {
+        // A collection looked up before is found without the database lock:
+        std::shared_lock<std::shared_mutex> lock(_collectionCacheMutex);
+        if (collectionCacheIsCurrent()) {
+            if (auto i = _collectionCache.find(fullName); i != _collectionCache.end())
+                return new CBLCollection(i->second, this);
+        }
+    }
+    
     auto c4db = _c4db->useLocked();
     
     auto spec = C4Database::CollectionSpec(collectionName, scopeName);
+    uint64_t generation = sCollectionDeletions.load();
     auto c4col = c4db->getCollection(spec);
+    cacheCollection(fullName, c4col, generation);
     if (!c4col) {
         return nullptr;
     }
-    auto scope = new CBLScope(scopeName, this);
-    return new CBLCollection(c4col, scope, this);
+    return new CBLCollection(c4col, this);
 }
 
 
@@ -176,9 +629,13 @@ Retained<CBLCollection> CBLDatabase::createCollection(slice collectionName, slic
     auto c4db = _c4db->useLocked();
     
     auto spec = C4Database::CollectionSpec(collectionName, scopeName);
+    uint64_t generation = sCollectionDeletions.load();
     auto c4col = c4db->createCollection(spec);
-    auto scope = new CBLScope(scopeName, this);
-    return new CBLCollection(c4col, scope, this);
+    ++sCollectionChanges;
+    _queryCache.invalidate();
+    closeVersionObservers();
+    cacheCollection(string(scopeName) + "." + string(collectionName), c4col, generation);
+    return new CBLCollection(c4col, this);
 }
 
 
@@ -189,7 +646,14 @@ bool CBLDatabase::deleteCollection(slice collectionName, slice scopeName) {
     auto c4db = _c4db->useLocked();
     
     auto spec = C4Database::CollectionSpec(collectionName, scopeName);
+    string fullName = string(slice(scopeName)) + "." + string(collectionName);
+    closeDocumentCount(slice(fullName));
+    closeVersionObservers();
+    ++sCollectionDeletions;
     c4db->deleteCollection(spec);
+    ++sCollectionDeletions;
+    ++sCollectionChanges;
+    _queryCache.invalidate();
     return true;
 }
 
@@ -225,17 +689,1330 @@ Retained<CBLQuery> CBLDatabase::createQuery(CBLQueryLanguage language,
         json = convertJSON5(queryString); // allow JSON5 as a convenience
         queryString = json;
     }
-    auto c4query = _c4db->useLocked()->newQuery((C4QueryLanguage)language, queryString, outErrPos);
-    if (!c4query)
-        return nullptr;
-    return new CBLQuery(this, std::move(c4query), *_c4db);
+    
+    auto c4db = _c4db->useLocked();
+    double compileTime = 0.0;
+    Retained<C4Query> c4query = _queryCache.get((C4QueryLanguage)language, queryString);
+    if (!c4query) {
+        TraceSpan span(kCBLTraceQueryCompile, queryString);
+        auto start = std::chrono::steady_clock::now();
+        c4query = c4db->newQuery((C4QueryLanguage)language, queryString, outErrPos);
+        if (!c4query) {
+            span.setFailed();
+            return nullptr;
+        }
+        compileTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                - start).count();
+        _queryCache.put((C4QueryLanguage)language, queryString, c4query);
+    }
+    // Queries from the cache share their C4Query with the cache and with each other:
+    bool shared = _queryCache.capacity() > 0;
+    return new CBLQuery(this, std::move(c4query), *_c4db, language, queryString, shared,
+                        compileTime);
+}
+
+
+#pragma mark - MAINTENANCE:
+
+
+namespace {
+    // The sizes of the files in a database bundle:
+    struct FileSizes {
+        int64_t database = 0, wal = 0, shm = 0, blobs = 0, blobCount = 0, total = 0;
+    };
+
+    FileSizes fileSizes(slice bundlePath) {
+        FileSizes sizes;
+        litecore::FilePath bundle(string(bundlePath), "");
+        bundle.forEachFile([&](const litecore::FilePath &file) {
+            if (file.isDir()) {
+                // The blob store, which is the only subdirectory:
+                file.forEachFile([&](const litecore::FilePath &blob) {
+                    if (!blob.isDir()) {
+                        sizes.blobs += blob.dataSize();
+                        ++sizes.blobCount;
+                    }
+                });
+                sizes.total += sizes.blobs;
+                return;
+            }
+            int64_t size = file.dataSize();
+            slice name(file.fileName());
+            if (name.hasSuffix("-wal"_sl))
+                sizes.wal += size;
+            else if (name.hasSuffix("-shm"_sl))
+                sizes.shm += size;
+            else
+                sizes.database += size;
+            sizes.total += size;
+        });
+        return sizes;
+    }
+}
+
+
+void CBLDatabase::performMaintenance(CBLMaintenanceType type) {
+    int64_t sizeBefore = (type == kCBLMaintenanceTypeCompact) ? fileSizes(path()).total : 0;
+    auto start = std::chrono::steady_clock::now();
+    _c4db->useLocked()->maintenance((C4MaintenanceType)type);
+    auto took = std::chrono::steady_clock::now() - start;
+    if (type < _maintenanceMs.size()) {
+        _maintenanceMs[type] = std::chrono::duration_cast<std::chrono::milliseconds>(took).count();
+        ++_maintenanceCount[type];
+    }
+    if (type == kCBLMaintenanceTypeCompact)
+        _compactReclaimedBytes = std::max(sizeBefore - fileSizes(path()).total, int64_t(0));
+}
+
+
+// Rough throughputs of the maintenance operations, in bytes of database file per ms, for
+// estimating the duration of one that hasn't been performed yet. They're on the slow side, so
+// that an operation of unknown duration isn't started when it won't fit in a task's budget:
+// compaction and reindexing rewrite the file or its indexes, an integrity check and a full
+// optimize read all of it, and an optimize only samples the indexes.
+static constexpr std::array<int64_t, kCBLMaintenanceTypeFullOptimize + 1> kMaintenanceBytesPerMs {
+    10'000,     // compact
+    10'000,     // reindex
+    50'000,     // integrityCheck
+    500'000,    // optimize
+    50'000,     // fullOptimize
+};
+
+
+uint64_t CBLDatabase::maintenanceDuration(CBLMaintenanceType type) const {
+    if (type >= _maintenanceMs.size())
+        return 0;
+    if (_maintenanceCount[type] > 0)
+        return _maintenanceMs[type].load();
+    // The main file and the WAL; the blob store doesn't affect these operations:
+    int64_t size = 0;
+    litecore::FilePath bundle(string(path()), "");
+    bundle.forEachFile([&](const litecore::FilePath &file) {
+        if (!file.isDir())
+            size += file.dataSize();
+    });
+    return uint64_t(size / kMaintenanceBytesPerMs[type]) + 1;
+}
+
+
+// The size of a database's shared-key table (Fleece's SharedKeys::kDefaultMaxCount).
+static constexpr unsigned kMaxSharedKeys = 2048;
+
+
+MutableDict CBLDatabase::storageStats() const {
+    MutableDict stats = MutableDict::newDict();
+    FileSizes sizes = fileSizes(path());
+    stats["totalBytes"] = sizes.total;
+    stats["databaseBytes"] = sizes.database;
+    stats["walBytes"] = sizes.wal;
+    stats["sharedMemoryBytes"] = sizes.shm;
+    stats["blobBytes"] = sizes.blobs;
+    stats["blobCount"] = sizes.blobCount;
+
+    MutableDict collections = MutableDict::newDict();
+    {
+        auto db = _c4db->useLocked();
+        // Property names are only shared until the table is full; after that, new names are
+        // written out in full in every document that uses them:
+        MutableDict sharedKeys = MutableDict::newDict();
+        sharedKeys["count"] = FLSharedKeys_Count(db->getFleeceSharedKeys());
+        sharedKeys["capacity"] = kMaxSharedKeys;
+        stats["sharedKeys"] = sharedKeys;
+
+        db->forEachScope([&](slice scope) {
+            db->forEachCollection(scope, [&](C4CollectionSpec spec) {
+                C4Collection *c4col = db->getCollection(spec);
+                if (!c4col)
+                    return;
+                MutableDict col = MutableDict::newDict();
+                col["documentCount"] = c4col->getDocumentCount();
+                col["lastSequence"] = uint64_t(c4col->getLastSequence());
+                string fullName = string(slice(spec.scope)) + "." + string(slice(spec.name));
+                collections[slice(fullName)] = col;
+            });
+        });
+    }
+    stats["collections"] = collections;
+
+    static constexpr const char* kMaintenanceNames[] = {
+        "compact", "reindex", "integrityCheck", "optimize", "fullOptimize"};
+    MutableDict maintenance = MutableDict::newDict();
+    for (size_t type = 0; type < _maintenanceMs.size(); ++type) {
+        if (unsigned count = _maintenanceCount[type]; count > 0) {
+            MutableDict op = MutableDict::newDict();
+            op["count"] = count;
+            op["lastDurationMs"] = _maintenanceMs[type].load();
+            if (type == kCBLMaintenanceTypeCompact)
+                op["lastReclaimedBytes"] = _compactReclaimedBytes.load();
+            maintenance[kMaintenanceNames[type]] = op;
+        }
+    }
+    stats["maintenance"] = maintenance;
+    return stats;
+}
+
+
+void CBLMaintenanceTask::run(std::chrono::milliseconds budget) {
+    LOCK(_mutex);
+    auto start = std::chrono::steady_clock::now();
+    for (bool first = true; _next < _steps.size(); first = false) {
+        CBLMaintenanceType type = _steps[_next];
+        // A step can't be interrupted, so only start one that's expected to finish in time:
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        auto expected = std::chrono::milliseconds(_db->maintenanceDuration(type));
+        if (!first && elapsed + expected >= budget)
+            break;
+        _db->performMaintenance(type);
+        ++_next;
+    }
+}
+
+
+CBLMaintenanceProgress CBLMaintenanceTask::progress() const {
+    LOCK(_mutex);
+    CBLMaintenanceProgress progress {};
+    progress.stepsCompleted = unsigned(_next);
+    progress.stepsRemaining = unsigned(_steps.size() - _next);
+    for (size_t i = _next; i < _steps.size(); ++i) {
+        uint64_t ms = _db->maintenanceDuration(_steps[i]);
+        if (i == _next)
+            progress.nextStepEstimatedMs = ms;
+        progress.estimatedRemainingMs += ms;
+    }
+    return progress;
+}
+
+
+#pragma mark - EXPORT:
+
+
+namespace {
+    // Passes an export's lines to its callback in chunks, no faster than the maximum rate:
+    class ExportWriter {
+    public:
+        ExportWriter(CBLExportWriteCallback callback, void* context, const CBLExportOptions &options)
+        :_callback(callback)
+        ,_context(context)
+        ,_chunkSize(options.chunkSize ? options.chunkSize : kCBLDefaultExportChunkSize)
+        ,_maxBytesPerSecond(options.maxBytesPerSecond)
+        ,_start(std::chrono::steady_clock::now())
+        { }
+
+        void writeLine(slice json) {
+            _buffer.append((const char*)json.buf, json.size);
+            _buffer += '\n';
+            size_t pos = 0;
+            for (; _buffer.size() - pos >= _chunkSize; pos += _chunkSize)
+                writeChunk(slice(&_buffer[pos], _chunkSize));
+            _buffer.erase(0, pos);
+        }
+
+        void finish() {
+            if (!_buffer.empty())
+                writeChunk(slice(_buffer));
+            _buffer.clear();
+        }
+
+    private:
+        void writeChunk(slice chunk) {
+            if (!_callback(_context, chunk))
+                C4Error::raise(LiteCoreDomain, kC4ErrorIOError, "The export's writer failed");
+            _bytesWritten += chunk.size;
+            if (_maxBytesPerSecond > 0) {
+                auto due = _start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(double(_bytesWritten) / _maxBytesPerSecond));
+                std::this_thread::sleep_until(due);
+            }
+        }
+
+        CBLExportWriteCallback const                _callback;
+        void* const                                 _context;
+        size_t const                                _chunkSize;
+        uint64_t const                              _maxBytesPerSecond;
+        std::chrono::steady_clock::time_point const _start;
+        string                                      _buffer;
+        uint64_t                                    _bytesWritten {0};
+    };
+}
+
+
+MutableDict CBLDatabase::exportSnapshot(const CBLExportOptions &options,
+                                        CBLExportWriteCallback callback,
+                                        void* context)
+{
+    Dict since(options.since);
+    ExportWriter out(callback, context, options);
+    MutableDict checkpoint = MutableDict::newDict();
+
+    // A reader connection of our own, so that writers aren't blocked while the export runs:
+    Retained<CBLDatabase> reader = acquireReader();
+    auto c4db = reader->_c4db->useLocked();
+
+    Encoder enc(kFLEncodeJSON);
+    enc.beginDict();
+    enc.writeKey("type"_sl);        enc.writeString("header"_sl);
+    enc.writeKey("version"_sl);     enc.writeInt(1);
+    enc.writeKey("database"_sl);    enc.writeString(_name);
+    enc.writeKey("incremental"_sl); enc.writeBool(bool(since));
+    enc.endDict();
+    out.writeLine(enc.finish());
+
+    // Start enumerating every collection before reading any of them: the SQLite read
+    // transaction lasts while any enumerator is active, so they all see the same snapshot.
+    struct Source {
+        alloc_slice                     scope, name;
+        string                          fullName;
+        C4SequenceNumber                lastSequence;
+        unique_ptr<C4DocEnumerator>     e;
+        bool                            more;
+    };
+    vector<Source> sources;
+    c4db->forEachScope([&](slice scope) {
+        c4db->forEachCollection(scope, [&](C4CollectionSpec spec) {
+            string fullName = string(slice(spec.scope)) + "." + string(slice(spec.name));
+            sources.push_back({alloc_slice(spec.scope), alloc_slice(spec.name), fullName,
+                               C4SequenceNumber(since[slice(fullName)].asUnsigned()), nullptr, false});
+        });
+    });
+    for (auto &source : sources) {
+        C4Collection *c4col = c4db->getCollection({source.name, source.scope});
+        if (!c4col)
+            continue;
+        C4EnumeratorOptions enumOptions = kC4DefaultEnumeratorOptions;
+        if (since)
+            enumOptions.flags |= kC4IncludeDeleted;
+        source.e = make_unique<C4DocEnumerator>(c4col, source.lastSequence, enumOptions);
+        source.more = source.e->next();
+    }
+
+    C4BlobStore &blobStore = c4db->getBlobStore();
+    std::unordered_set<string> blobsWritten;
+    for (auto &source : sources) {
+        enc.beginDict();
+        enc.writeKey("type"_sl);    enc.writeString("collection"_sl);
+        enc.writeKey("scope"_sl);   enc.writeString(source.scope);
+        enc.writeKey("name"_sl);    enc.writeString(source.name);
+        enc.endDict();
+        out.writeLine(enc.finish());
+
+        for (; source.more; source.more = source.e->next()) {
+            C4DocumentInfo info = source.e->documentInfo();
+            Retained<C4Document> doc = source.e->getDocument();
+            bool deleted = (info.flags & kDocDeleted) != 0;
+            Dict body = deleted ? Dict() : Dict(doc->getProperties());
+
+            if (info.flags & kDocHasAttachments) {
+                C4Blob::findBlobReferences(body, [&](FLDict blob) {
+                    auto key = C4Blob::keyFromDigestProperty(blob);
+                    if (!key || !blobsWritten.insert(key->digestString()).second)
+                        return true;
+                    alloc_slice contents;
+                    try {
+                        contents = blobStore.getContents(*key);
+                    } catch (...) {
+                        CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                                "Export: blob %s of doc '%.*s' is missing",
+                                key->digestString().c_str(), FMTSLICE(slice(info.docID)));
+                        return true;
+                    }
+                    enc.beginDict();
+                    enc.writeKey("type"_sl);    enc.writeString("blob"_sl);
+                    enc.writeKey("digest"_sl);  enc.writeString(key->digestString());
+                    enc.writeKey("data"_sl);    enc.writeData(contents);
+                    enc.endDict();
+                    out.writeLine(enc.finish());
+                    return true;
+                });
+            }
+
+            enc.beginDict();
+            enc.writeKey("type"_sl);        enc.writeString("document"_sl);
+            enc.writeKey("id"_sl);          enc.writeString(info.docID);
+            enc.writeKey("revisionID"_sl);  enc.writeString(info.revID);
+            enc.writeKey("sequence"_sl);    enc.writeUInt(uint64_t(info.sequence));
+            if (deleted) {
+                enc.writeKey("deleted"_sl); enc.writeBool(true);
+            } else {
+                enc.writeKey("body"_sl);    enc.writeValue(body);
+            }
+            enc.endDict();
+            out.writeLine(enc.finish());
+            source.lastSequence = std::max(source.lastSequence, info.sequence);
+        }
+        source.e.reset();
+        checkpoint[slice(source.fullName)] = uint64_t(source.lastSequence);
+    }
+
+    // Collections in the checkpoint that no longer exist have been deleted:
+    for (Dict::iterator i(since); i; ++i) {
+        slice fullName = i.keyString();
+        if (checkpoint.get(fullName))
+            continue;
+        const void *dot = fullName.findByte('.');
+        if (!dot)
+            continue;
+        enc.beginDict();
+        enc.writeKey("type"_sl);    enc.writeString("collection"_sl);
+        enc.writeKey("scope"_sl);   enc.writeString(slice(fullName.buf, dot));
+        enc.writeKey("name"_sl);    enc.writeString(slice(offsetby(dot, 1), fullName.end()));
+        enc.writeKey("deleted"_sl); enc.writeBool(true);
+        enc.endDict();
+        out.writeLine(enc.finish());
+    }
+
+    enc.beginDict();
+    enc.writeKey("type"_sl);        enc.writeString("end"_sl);
+    enc.writeKey("checkpoint"_sl);  enc.writeValue(checkpoint);
+    enc.endDict();
+    out.writeLine(enc.finish());
+    out.finish();
+    return checkpoint;
+}
+
+
+MutableDict CBLDatabase::exportToFile(slice path, const CBLExportOptions &options) {
+    string pathStr(path);
+    FILE *file = fopen(pathStr.c_str(), "wb");
+    if (!file)
+        C4Error::raise(LiteCoreDomain, kC4ErrorCantOpenFile, "Can't create %s", pathStr.c_str());
+    auto write = [](void* context, FLSlice chunk) {
+        return fwrite(chunk.buf, 1, chunk.size, (FILE*)context) == chunk.size;
+    };
+    try {
+        MutableDict checkpoint = exportSnapshot(options, write, file);
+        if (fclose(file) != 0) {
+            file = nullptr;
+            C4Error::raise(LiteCoreDomain, kC4ErrorIOError, "Couldn't write %s", pathStr.c_str());
+        }
+        return checkpoint;
+    } catch (...) {
+        if (file)
+            fclose(file);
+        remove(pathStr.c_str());
+        throw;
+    }
+}
+
+
+#pragma mark - REKEY:
+
+
+#ifdef COUCHBASE_ENTERPRISE
+
+namespace {
+    // The raw-document store in the re-encrypted copy where its checkpoint is saved: the last
+    // sequence copied from each collection, by full name.
+    constexpr slice kRekeyStore = "cbl_rekey"_sl;
+    constexpr slice kRekeyCheckpointKey = "checkpoint"_sl;
+
+    string rekeyName(slice name) {
+        return string(name) + "~rekey";
+    }
+
+    litecore::FilePath bundlePath(slice name, slice dir) {
+        return litecore::FilePath(string(dir), "").subdirectoryNamed(string(name) + kC4DatabaseFilenameExtension);
+    }
+
+    // Exists while the re-encrypted copy is replacing the database:
+    litecore::FilePath rekeyDoneMarker(slice name, slice dir) {
+        return litecore::FilePath(string(dir), rekeyName(name) + ".done");
+    }
+
+
+    // LiteCore's store of database info, where it keeps the database's UUIDs, and the IDs it
+    // assigns to the remote databases it replicates with:
+    constexpr slice kInfoStore = "info"_sl;
+    constexpr slice kRemoteDBsKey = "remotes"_sl;
+    constexpr slice kUUIDKeys[] = {"publicUUID"_sl, "privateUUID"_sl};
+
+
+    // The IDs LiteCore has given the remote databases this one has replicated with. Each
+    // document records, by these IDs, the revision each remote is known to have.
+    vector<C4RemoteID> rekeyRemoteIDs(C4Database *source) {
+        alloc_slice body;
+        source->getRawDocument(kInfoStore, kRemoteDBsKey, [&](C4RawDocument *doc) {
+            if (doc)
+                body = alloc_slice(doc->body);
+        });
+        vector<C4RemoteID> remotes;
+        Doc doc(body, kFLTrusted);
+        for (Dict::iterator i(doc.root().asDict()); i; ++i)
+            remotes.push_back(C4RemoteID(i.value().asUnsigned()));
+        return remotes;
+    }
+
+
+    // Whether two copies of a document agree on the revisions the remotes are known to have,
+    // which change without a new sequence when a replicator pushes the document.
+    bool sameRemoteRevisions(C4Collection *from, C4Collection *to, slice docID,
+                             const vector<C4RemoteID> &remotes)
+    {
+        Retained<C4Document> original = from->getDocument(docID, true, kDocGetAll);
+        Retained<C4Document> copy = to->getDocument(docID, true, kDocGetAll);
+        if (!original || !copy)
+            return false;
+        for (C4RemoteID remote : remotes) {
+            if (original->remoteAncestorRevID(remote) != copy->remoteAncestorRevID(remote))
+                return false;
+        }
+        return true;
+    }
+
+
+    // Copies a raw document, or deletes it from `to` if `from` doesn't have it.
+    void copyRawDocument(C4Database *from, C4Database *to, slice store, slice key) {
+        alloc_slice meta, body;
+        from->getRawDocument(store, key, [&](C4RawDocument *doc) {
+            if (doc) {
+                meta = alloc_slice(doc->meta);
+                body = alloc_slice(doc->body);
+            }
+        });
+        // A null body and meta deletes the raw document:
+        C4RawDocument doc = {};
+        doc.key = key;
+        doc.meta = meta;
+        doc.body = body;
+        to->putRawDocument(store, doc);
+    }
+
+
+    // Makes the copy's indexes match the collection's. Only a value index is described fully
+    // by its info; the options of the other kinds (full-text language and diacritics, array
+    // unnest path, vector encoding, predictive model) can't be read back, so they can't be
+    // copied.
+    void syncRekeyIndexes(C4Collection *from, C4Collection *to) {
+        Doc info(from->getIndexesInfo()), copiedInfo(to->getIndexesInfo());
+        std::unordered_map<slice, Dict> copied;
+        for (Array::iterator i(copiedInfo.root().asArray()); i; ++i) {
+            Dict dict = i.value().asDict();
+            copied.emplace(dict["name"].asString(), dict);
+        }
+        for (Array::iterator i(info.root().asArray()); i; ++i) {
+            Dict dict = i.value().asDict();
+            slice name = dict["name"].asString();
+            if (C4IndexType(dict["type"].asInt()) != kC4ValueIndex)
+                C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported,
+                               "Index '%.*s' can't be copied by an incremental rekey; delete it "
+                               "and recreate it afterwards", FMTSLICE(name));
+            if (auto c = copied.find(name); c != copied.end()) {
+                Dict old = c->second;
+                copied.erase(c);
+                if (old["expr"].isEqual(dict["expr"]) && old["where"].isEqual(dict["where"])
+                        && CBLCollection::indexLanguage(old) == CBLCollection::indexLanguage(dict))
+                    continue;
+                to->deleteIndex(name);
+            }
+            string where(dict["where"].asString());
+            C4IndexOptions options = {};
+            if (!where.empty())
+                options.where = where.c_str();
+            to->createIndex(name, dict["expr"].asString(), CBLCollection::indexLanguage(dict),
+                            kC4ValueIndex, &options);
+        }
+        for (auto &c : copied)
+            to->deleteIndex(c.first);
+    }
+
+
+    // Copies the current revision of a document, with its history, expiration, blobs and the
+    // revisions the remotes are known to have. Returns the number of blobs copied.
+    unsigned copyRekeyDocument(C4Document *doc, C4Timestamp expiration, C4Collection *to,
+                               C4BlobStore &fromBlobs, C4BlobStore &toBlobs,
+                               const vector<C4RemoteID> &remotes)
+    {
+        // Only the current revision is copied, which would silently resolve a conflict:
+        if (doc->flags() & kDocConflicted)
+            C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported,
+                           "Document '%.*s' has a conflict, which must be resolved before an "
+                           "incremental rekey", FMTSLICE(doc->docID()));
+        doc->selectCurrentRevision();
+        C4RevisionFlags flags = doc->selectedRev().flags & (kRevDeleted | kRevHasAttachments);
+        Dict body = doc->getProperties();
+
+        unsigned blobsCopied = 0;
+        if (flags & kRevHasAttachments) {
+            C4Blob::findBlobReferences(body, [&](FLDict blob) {
+                auto key = C4Blob::keyFromDigestProperty(blob);
+                if (!key || toBlobs.getSize(*key) >= 0)
+                    return true;
+                try {
+                    toBlobs.createBlob(fromBlobs.getContents(*key), &*key);
+                    ++blobsCopied;
+                } catch (...) {
+                    CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                            "Rekey: blob %s of doc '%.*s' is missing",
+                            key->digestString().c_str(), FMTSLICE(doc->docID()));
+                }
+                return true;
+            });
+        }
+
+        // A version vector is a single revision ID; a rev-tree history lists every ancestor:
+        alloc_slice history = doc->getRevisionHistory(UINT_MAX, nullptr, 0);
+        vector<C4String> revIDs;
+        if (history.findByte('@')) {
+            revIDs.push_back(history);
+        } else {
+            size_t start = 0;
+            for (size_t i = 0; i <= history.size; ++i) {
+                if (i == history.size || history[i] == ',') {
+                    revIDs.push_back(slice(history.offset(start), i - start));
+                    start = i + 1;
+                }
+            }
+        }
+
+        alloc_slice newBody;
+        {
+            SharedEncoder enc(to->getDatabase()->sharedFleeceEncoder());
+            if (body) {
+                enc.writeValue(body);
+            } else {
+                enc.beginDict();
+                enc.endDict();
+            }
+            newBody = enc.finish();
+        }
+
+        // Replace any older revision, rather than adding this one to its history, since the
+        // document may have been purged and recreated meanwhile:
+        slice docID = doc->docID();
+        to->purgeDocument(docID);
+        C4DocPutRequest rq = {};
+        rq.body = newBody;
+        rq.docID = docID;
+        rq.revFlags = flags;
+        rq.existingRevision = true;
+        rq.history = revIDs.data();
+        rq.historyCount = revIDs.size();
+        rq.save = true;
+        C4Error c4err;
+        Retained<C4Document> copy = to->putDocument(rq, nullptr, &c4err);
+        if (!copy)
+            C4Error::raise(c4err);
+
+        // Without these, replication would see conflicts that aren't:
+        bool remotesChanged = false;
+        for (C4RemoteID remote : remotes) {
+            if (alloc_slice revID = doc->remoteAncestorRevID(remote)) {
+                copy->setRemoteAncestorRevID(remote, revID);
+                remotesChanged = true;
+            }
+        }
+        if (remotesChanged)
+            copy->save();
+        if (expiration)
+            to->setExpiration(docID, expiration);
+        return blobsCopied;
+    }
+
+
+    // Makes the copy of a collection match it exactly, by comparing every document's current
+    // revision, expiration and remote revisions (which can change without a new sequence):
+    // copies the documents that differ and purges those that are gone. Both enumerate in docID
+    // order.
+    void reconcileRekeyCollection(C4Collection *from, C4Collection *to,
+                                  C4BlobStore &fromBlobs, C4BlobStore &toBlobs,
+                                  const vector<C4RemoteID> &remotes, CBLRekeyProgress &progress)
+    {
+        C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
+        options.flags |= kC4IncludeDeleted;
+        options.flags &= ~kC4IncludeBodies;
+        C4DocEnumerator source(from, options), target(to, options);
+        vector<alloc_slice> changed, removed;
+        bool moreSource = source.next(), moreTarget = target.next();
+        while (moreSource || moreTarget) {
+            C4DocumentInfo fromInfo {}, toInfo {};
+            if (moreSource)
+                fromInfo = source.documentInfo();
+            if (moreTarget)
+                toInfo = target.documentInfo();
+            int cmp = !moreSource ? 1 : !moreTarget ? -1
+                                  : slice(fromInfo.docID).compare(slice(toInfo.docID));
+            if (cmp < 0) {
+                changed.emplace_back(fromInfo.docID);
+            } else if (cmp > 0) {
+                removed.emplace_back(toInfo.docID);
+            } else if (slice(fromInfo.revID) != slice(toInfo.revID)
+                       || fromInfo.expiration != toInfo.expiration
+                       || (!remotes.empty()
+                           && !sameRemoteRevisions(from, to, fromInfo.docID, remotes))) {
+                changed.emplace_back(fromInfo.docID);
+            }
+            if (cmp <= 0)
+                moreSource = source.next();
+            if (cmp >= 0)
+                moreTarget = target.next();
+        }
+        for (auto &docID : removed)
+            to->purgeDocument(docID);
+        for (auto &docID : changed) {
+            if (Retained<C4Document> doc = from->getDocument(docID, true, kDocGetAll)) {
+                progress.blobsCopied += copyRekeyDocument(doc, from->getExpiration(docID), to,
+                                                          fromBlobs, toBlobs, remotes);
+                ++progress.documentsCopied;
+            }
+        }
+    }
+
+
+    // Makes the copy of the given documents match the collection's: copies them again, or
+    // purges them from the copy if they're gone.
+    void reconcileRekeyDocuments(C4Collection *from, C4Collection *to,
+                                 const std::set<string> &docIDs,
+                                 C4BlobStore &fromBlobs, C4BlobStore &toBlobs,
+                                 const vector<C4RemoteID> &remotes, CBLRekeyProgress &progress)
+    {
+        for (auto &docID : docIDs) {
+            if (Retained<C4Document> doc = from->getDocument(docID, true, kDocGetAll)) {
+                progress.blobsCopied += copyRekeyDocument(doc, from->getExpiration(docID), to,
+                                                          fromBlobs, toBlobs, remotes);
+                ++progress.documentsCopied;
+            } else {
+                to->purgeDocument(docID);
+            }
+        }
+    }
+
+
+    // Whether a checkpoint was saved for this collection, rather than for one that has been
+    // deleted and recreated with the same name. Sequences start over in a new collection, but
+    // a document's sequence only grows, so the last document copied must still be there with
+    // at least the sequence it had. (If it was purged instead, the collection is copied again,
+    // which is slower but still right.)
+    bool isCheckpointedCollection(C4Collection *from, Dict checkpoint) {
+        auto since = C4SequenceNumber(checkpoint["seq"].asUnsigned());
+        if (since > from->getLastSequence())
+            return false;
+        slice lastDocID = checkpoint["doc"].asString();
+        if (!lastDocID)
+            return true;
+        Retained<C4Document> doc = from->getDocument(lastDocID, true, kDocGetMetadata);
+        return doc && uint64_t(doc->sequence()) >= checkpoint["docSeq"].asUnsigned();
+    }
+
+
+    // Copies up to `limit` changed documents from `source` to `target`, starting from the
+    // checkpoint saved in `target`, and saves the new checkpoint in the same transaction.
+    // The database's UUIDs, remote database IDs and suspended index definitions are copied too.
+    // If `finishing`, also makes `target` match `source` exactly, removing what's been purged
+    // or deleted: if `changed` is given, only the documents it lists are compared, except in
+    // collections it has no entry for, which are compared in full.
+    void copyRekeyChanges(C4Database *source, C4Database *target, uint64_t limit, bool finishing,
+                          const CBLDatabase::RekeyDocIDs* _cbl_nullable changed,
+                          CBLRekeyProgress &progress)
+    {
+        alloc_slice saved;
+        target->getRawDocument(kRekeyStore, kRekeyCheckpointKey, [&](C4RawDocument *doc) {
+            if (doc)
+                saved = alloc_slice(doc->body);
+        });
+        Doc savedDoc(saved, kFLTrusted);
+        Dict savedCheckpoint = savedDoc.root().asDict();
+        MutableDict checkpoint = savedCheckpoint ? savedCheckpoint.mutableCopy() : MutableDict::newDict();
+
+        struct Spec {
+            alloc_slice scope, name;
+        };
+        vector<Spec> specs;
+        source->forEachScope([&](slice scope) {
+            source->forEachCollection(scope, [&](C4CollectionSpec spec) {
+                specs.push_back({alloc_slice(spec.scope), alloc_slice(spec.name)});
+            });
+        });
+
+        C4BlobStore &fromBlobs = source->getBlobStore(), &toBlobs = target->getBlobStore();
+        C4Database::Transaction t(target);
+        for (slice key : kUUIDKeys)
+            copyRawDocument(source, target, kInfoStore, key);
+        copyRawDocument(source, target, kInfoStore, kRemoteDBsKey);
+        vector<C4RemoteID> remotes = rekeyRemoteIDs(source);
+        std::unordered_set<string> fullNames;
+        uint64_t copied = 0;
+        for (auto &s : specs) {
+            C4CollectionSpec spec {s.name, s.scope};
+            C4Collection *from = source->getCollection(spec);
+            if (!from)
+                continue;
+            string fullName = string(s.scope) + "." + string(s.name);
+            fullNames.insert(fullName);
+            Dict collectionCheckpoint = checkpoint[slice(fullName)].asDict();
+            auto since = C4SequenceNumber(collectionCheckpoint["seq"].asUnsigned());
+            alloc_slice lastDocID(collectionCheckpoint["doc"].asString());
+            uint64_t lastDocSeq = collectionCheckpoint["docSeq"].asUnsigned();
+            C4SequenceNumber last = from->getLastSequence();
+
+            C4Collection *to = target->getCollection(spec);
+            if (to && !isCheckpointedCollection(from, collectionCheckpoint)) {
+                // The collection has been deleted and recreated since the last step:
+                target->deleteCollection(spec);
+                to = nullptr;
+                since = C4SequenceNumber(0);
+                lastDocID = nullslice;
+                lastDocSeq = 0;
+            }
+            if (!to)
+                to = target->createCollection(spec);
+            syncRekeyIndexes(from, to);
+            copyRawDocument(source, target, CBLCollection::kSuspendedIndexesStore, slice(fullName));
+
+            if (since < last && copied < limit) {
+                C4EnumeratorOptions options = kC4DefaultEnumeratorOptions;
+                options.flags |= kC4IncludeDeleted;
+                options.flags &= ~kC4IncludeBodies;
+                C4DocEnumerator e(from, since, options);
+                for (;;) {
+                    if (copied >= limit)
+                        break;
+                    if (!e.next()) {
+                        since = last;
+                        break;
+                    }
+                    C4DocumentInfo info = e.documentInfo();
+                    // Documents purged since the enumeration began are skipped:
+                    if (Retained<C4Document> doc = from->getDocument(info.docID, true, kDocGetAll)) {
+                        progress.blobsCopied += copyRekeyDocument(doc, info.expiration, to,
+                                                                  fromBlobs, toBlobs, remotes);
+                        ++copied;
+                        lastDocID = alloc_slice(info.docID);
+                        lastDocSeq = uint64_t(info.sequence);
+                    }
+                    since = info.sequence;
+                }
+            }
+            MutableDict entry = MutableDict::newDict();
+            entry["seq"] = uint64_t(since);
+            if (lastDocID) {
+                entry["doc"] = lastDocID;
+                entry["docSeq"] = lastDocSeq;
+            }
+            checkpoint[slice(fullName)] = entry;
+            progress.sequencesRemaining += uint64_t(last) - uint64_t(since);
+
+            if (finishing) {
+                const std::set<string>* changedIDs = nullptr;
+                if (changed) {
+                    if (auto c = changed->find(fullName); c != changed->end())
+                        changedIDs = &c->second;
+                }
+                if (changedIDs)
+                    reconcileRekeyDocuments(from, to, *changedIDs, fromBlobs, toBlobs, remotes, progress);
+                else
+                    reconcileRekeyCollection(from, to, fromBlobs, toBlobs, remotes, progress);
+            }
+        }
+
+        if (finishing) {
+            vector<Spec> deleted;
+            target->forEachScope([&](slice scope) {
+                target->forEachCollection(scope, [&](C4CollectionSpec spec) {
+                    string fullName = string(slice(spec.scope)) + "." + string(slice(spec.name));
+                    if (fullNames.find(fullName) == fullNames.end())
+                        deleted.push_back({alloc_slice(spec.scope), alloc_slice(spec.name)});
+                });
+            });
+            for (auto &s : deleted) {
+                target->deleteCollection({s.name, s.scope});
+                string fullName = string(s.scope) + "." + string(s.name);
+                copyRawDocument(source, target, CBLCollection::kSuspendedIndexesStore, slice(fullName));
+            }
+        }
+
+        Encoder enc;
+        enc.writeValue(checkpoint);
+        alloc_slice body = enc.finish();
+        C4RawDocument doc = {};
+        doc.key = kRekeyCheckpointKey;
+        doc.body = body;
+        target->putRawDocument(kRekeyStore, doc);
+        t.commit();
+        progress.documentsCopied += copied;
+    }
+}
+
+
+C4Database* CBLDatabase::rekeyTarget(const CBLEncryptionKey* newKey) {
+    C4EncryptionKey c4key = asC4Key(newKey);
+    if (_rekeyDB) {
+        auto &current = _rekeyDB->getConfiguration().encryptionKey;
+        if (current.algorithm != c4key.algorithm || (c4key.algorithm != kC4EncryptionNone &&
+                                                     memcmp(current.bytes, c4key.bytes, sizeof(c4key.bytes)) != 0))
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "A rekey to a different key is in progress");
+        return _rekeyDB;
+    }
+    C4DatabaseConfig2 config = _c4db->useLocked()->getConfiguration();
+    config.flags = (config.flags | kC4DB_Create) & ~kC4DB_ReadOnly;
+    config.encryptionKey = c4key;
+    _rekeyDB = C4Database::openNamed(rekeyName(_name), config);
+    return _rekeyDB;
+}
+
+
+CBLRekeyProgress CBLDatabase::rekeyStep(const CBLEncryptionKey* newKey, uint64_t maxDocuments) {
+    LOCK(_rekeyMutex);
+    C4Database *target = rekeyTarget(newKey);
+    CBLRekeyProgress progress {};
+    // Read from a connection of our own, so that writers aren't blocked meanwhile:
+    Retained<CBLDatabase> reader = acquireReader();
+    reader->_c4db->useLocked([&](Retained<C4Database> &source) {
+        copyRekeyChanges(source, target, maxDocuments, false, nullptr, progress);
+    });
+    return progress;
+}
+
+
+void CBLDatabase::finishRekey(const CBLEncryptionKey* newKey) {
+    LOCK(_rekeyMutex);
+    C4Database *target = rekeyTarget(newKey);
+    auto copyFromReader = [&](bool finishing) {
+        CBLRekeyProgress progress {};
+        Retained<CBLDatabase> reader = acquireReader();
+        reader->_c4db->useLocked([&](Retained<C4Database> &source) {
+            copyRekeyChanges(source, target, UINT64_MAX, finishing, nullptr, progress);
+        });
+    };
+
+    // Catch up as far as possible while the database is still usable:
+    copyFromReader(false);
+
+    // Replicators change the revisions known to remotes without a new sequence, so stop them,
+    // then compare the whole copy with the database, still without blocking writers. The
+    // documents changed meanwhile are noted, and only they are compared again below:
+    stopActiveStoppables();
+    _c4db->useLocked([&](Retained<C4Database> &c4db) {
+        startRekeyTracking(c4db);
+    });
+    try {
+        copyFromReader(true);
+        finishAsyncWrites();
+        closeReaders();
+        _c4db->useLocked([&](Retained<C4Database> &c4db) {
+            // Copy the last changes with writers blocked, then close, so none are lost:
+            RekeyDocIDs changed = stopRekeyTracking();
+            CBLRekeyProgress progress {};
+            copyRekeyChanges(c4db, target, UINT64_MAX, true, &changed, progress);
+            closeDocumentCounts();
+            closeVersionObservers();
+            c4db->close();
+            _closed();
+        });
+    } catch (...) {
+        _c4db->useLocked([&](Retained<C4Database>&) {
+            stopRekeyTracking();
+        });
+        throw;
+    }
+    _rekeyDB->close();
+    _rekeyDB = nullptr;
+
+    // Once the marker exists, opening the database completes the replacement if it's interrupted:
+    string marker = rekeyDoneMarker(_name, _dir).path();
+    FILE *file = fopen(marker.c_str(), "wb");
+    if (!file || fclose(file) != 0)
+        C4Error::raise(LiteCoreDomain, kC4ErrorIOError, "Couldn't create %s", marker.c_str());
+    finishInterruptedRekey(_name, _dir);
+}
+
+
+void CBLDatabase::startRekeyTracking(C4Database *c4db) {
+    auto tracking = std::make_unique<RekeyTracking>();
+    c4db->forEachScope([&](slice scope) {
+        c4db->forEachCollection(scope, [&](C4CollectionSpec spec) {
+            if (C4Collection *c4col = c4db->getCollection(spec)) {
+                string fullName = string(slice(spec.scope)) + "." + string(slice(spec.name));
+                // Its changes are read when tracking stops, so it needn't call back:
+                tracking->observers.emplace(std::move(fullName),
+                                            c4col->observe([](C4CollectionObserver*) { }));
+            }
+        });
+    });
+    LOCK(_rekeyTrackingMutex);
+    _rekeyTracking = std::move(tracking);
+}
+
+
+CBLDatabase::RekeyDocIDs CBLDatabase::stopRekeyTracking() {
+    std::unique_ptr<RekeyTracking> tracking;
+    {
+        LOCK(_rekeyTrackingMutex);
+        tracking = std::move(_rekeyTracking);
+    }
+    RekeyDocIDs changed;
+    if (!tracking)
+        return changed;
+    // New revisions and purges come from the observers, expirations from CBLCollection:
+    C4CollectionObserver::Change changes[100];
+    for (auto &[fullName, observer] : tracking->observers) {
+        auto &docIDs = changed[fullName];
+        for (;;) {
+            auto result = observer->getChanges(changes, 100);
+            if (result.numChanges == 0)
+                break;
+            for (uint32_t i = 0; i < result.numChanges; ++i)
+                docIDs.emplace(slice(changes[i].docID));
+        }
+        if (auto e = tracking->expirations.find(fullName); e != tracking->expirations.end())
+            docIDs.insert(e->second.begin(), e->second.end());
+    }
+    return changed;
+}
+
+
+void CBLDatabase::rekeyExpirationChanged(slice collectionName, slice docID) {
+    LOCK(_rekeyTrackingMutex);
+    if (!_rekeyTracking)
+        return;
+    string fullName(collectionName);
+    // A collection created since tracking began is compared in full anyway:
+    if (_rekeyTracking->observers.count(fullName))
+        _rekeyTracking->expirations[fullName].emplace(docID);
+}
+
+
+void CBLDatabase::cancelRekey() {
+    LOCK(_rekeyMutex);
+    if (_rekeyDB) {
+        _rekeyDB->closeAndDeleteFile();
+        _rekeyDB = nullptr;
+    } else {
+        C4Database::deleteNamed(rekeyName(_name), _dir);
+    }
+}
+
+
+/*static*/ void CBLDatabase::finishInterruptedRekey(slice name, slice dir) {
+    litecore::FilePath marker = rekeyDoneMarker(name, dir);
+    if (!marker.exists())
+        return;
+    string copyName = rekeyName(name);
+    if (C4Database::exists(slice(copyName), dir)) {
+        // Fails if other connections still have the old database open:
+        C4Database::deleteNamed(name, dir);
+        bundlePath(slice(copyName), dir).moveTo(bundlePath(name, dir));
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo,
+                "Replaced database '%.*s' with its re-encrypted copy", FMTSLICE(name));
+    }
+    marker.del();
+}
+
+#endif
+
+
+#pragma mark - MEMORY:
+
+
+CBLMemoryTrimStats CBLDatabase::trimMemory(CBLMemoryTrimLevel level) {
+    CBLMemoryTrimStats stats = trimSharedMemory(level);
+    auto lock = _c4db->useLocked();
+    size_t keep = (level == kCBLMemoryTrimCritical) ? 0 : _queryCache.count() / 2;
+    stats.queriesReleased = uint32_t(_queryCache.trim(keep));
+    return stats;
+}
+
+
+CBLMemoryTrimStats CBLDatabase::trimSharedMemory(CBLMemoryTrimLevel level) {
+    CBLMemoryTrimStats stats {};
+    stats.bytesFreed = CBLDocument::releaseFreeList() + CBLResultSet::releaseFreeList();
+#ifdef COUCHBASE_ENTERPRISE
+    stats.bytesFreed += PredictiveModel::trimCaches(level == kCBLMemoryTrimCritical);
+#endif
+    return stats;
+}
+
+
+#pragma mark - PREWARMING:
+
+
+// Rows read by each query while prewarming, so the database isn't locked for long at a time:
+static constexpr int64_t kPrewarmChunkSize = 1000;
+
+
+namespace {
+    struct PrewarmTask {
+        Retained<CBLDatabase>       db;
+        bool                        onlyNamed;
+        vector<alloc_slice>         indexNames;
+        uint64_t                    budget;
+        CBLDatabasePrewarmCallback  callback;
+        void*                       context;
+    };
+
+    size_t approximateSize(Value value) {
+        switch (value.type()) {
+            case kFLString:     return value.asString().size;
+            case kFLData:       return value.asData().size;
+            case kFLArray:
+            case kFLDict:       return value.toJSON().size;
+            default:            return 8;
+        }
+    }
+
+
+    // Splits a N1QL index's comma-separated expressions, ignoring commas in nested
+    // parentheses, brackets, braces and quotes.
+    vector<string> splitExpressions(const string &exprs) {
+        vector<string> result;
+        int depth = 0;
+        char quote = 0;
+        size_t start = 0;
+        for (size_t i = 0; i < exprs.size(); ++i) {
+            char c = exprs[i];
+            if (quote) {
+                if (c == '\\')
+                    ++i;
+                else if (c == quote)
+                    quote = 0;
+            } else if (c == '\'' || c == '"' || c == '`') {
+                quote = c;
+            } else if (c == '(' || c == '[' || c == '{') {
+                ++depth;
+            } else if (c == ')' || c == ']' || c == '}') {
+                --depth;
+            } else if (c == ',' && depth == 0) {
+                result.push_back(exprs.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+        result.push_back(exprs.substr(start));
+        return result;
+    }
+
+    // Combines conditions with a binary operator, in N1QL or JSON:
+    string combine(const vector<string> &terms, const char *op, bool json) {
+        string result = terms.back();
+        for (auto i = terms.rbegin() + 1; i != terms.rend(); ++i) {
+            if (json)
+                result = string("[\"") + op + "\"," + *i + "," + result + "]";
+            else
+                result = "(" + *i + " " + op + " " + result + ")";
+        }
+        return result;
+    }
+
+    // The condition for a row to come after the cursor `$cursor0, $cursor1, ...` in the order
+    // of the ascending sort keys `keys`, in N1QL or JSON. It starts with `keys[0] >= $cursor0`,
+    // which SQLite can use to seek in the index; it can't use an OR of alternatives.
+    string afterCursor(const vector<string> &keys, bool json) {
+        vector<string> alternatives;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            vector<string> terms;
+            for (size_t j = 0; j <= i; ++j) {
+                string param = "cursor" + to_string(j);
+                const char *op = (j < i) ? "=" : ">";
+                if (json)
+                    terms.push_back(string("[\"") + op + "\"," + keys[j] + ",[\"$" + param + "\"]]");
+                else
+                    terms.push_back(keys[j] + " " + op + " $" + param);
+            }
+            alternatives.push_back(combine(terms, "AND", json));
+        }
+        string after = combine(alternatives, "OR", json);
+        if (keys.size() == 1)
+            return after;
+        string seek;
+        if (json)
+            seek = "[\">=\"," + keys[0] + ",[\"$cursor0\"]]";
+        else
+            seek = keys[0] + " >= $cursor0";
+        return combine({seek, after}, "AND", json);
+    }
+}
+
+
+void CBLDatabase::prewarm(bool onlyNamed, vector<alloc_slice> indexNames, uint64_t budget,
+                          CBLDatabasePrewarmCallback callback, void* context)
+{
+    auto task = new PrewarmTask{this, onlyNamed, std::move(indexNames), budget, callback, context};
+    AsyncTasks::runBlocking([](void* ctx) {
+        unique_ptr<PrewarmTask> task((PrewarmTask*)ctx);
+        uint64_t bytesRead = 0;
+        try {
+            task->db->prewarmNow(task->onlyNamed, task->indexNames, task->budget, bytesRead);
+        } catch (...) {
+            BridgeException(__FUNCTION__, nullptr);
+        }
+        if (task->callback)
+            task->callback(task->context, bytesRead);
+    }, task);
+}
+
+
+void CBLDatabase::prewarmNow(bool onlyNamed, const vector<alloc_slice> &indexNames, uint64_t budget,
+                             uint64_t &bytesRead)
+{
+    vector<pair<alloc_slice, alloc_slice>> specs;       // Scope and collection names
+    {
+        auto c4db = _c4db->useLocked();
+        c4db->forEachScope([&](slice scope) {
+            c4db->forEachCollection(scope, [&](C4CollectionSpec spec) {
+                specs.emplace_back(spec.scope, spec.name);
+            });
+        });
+    }
+
+    // Find the value indexes to read, in the order they were named, and their collections.
+    // Each is read with a query ordered by the index's expressions, which makes SQLite walk the
+    // whole index, and paged with the expressions and the doc ID as the keyset (see
+    // CBLQuery_SetCursor), so each page starts where the last one ended instead of skipping
+    // the rows before it. The query's columns are the doc ID, then the expressions.
+    struct Index {
+        size_t          order;
+        PrewarmQuery    query;
+    };
+    vector<Index> indexes;
+    vector<string> collections;
+    for (auto &[scopeName, collectionName] : specs) {
+        auto collection = getCollection(collectionName, scopeName);
+        if (!collection)
+            continue;
+        string from = "`" + string(scopeName) + "`.`" + string(collectionName) + "`";
+        bool found = !onlyNamed;
+        auto info = collection->indexesInfo();
+        for (Array::iterator i(info); i; ++i) {
+            Dict dict = i.value().asDict();
+            if (C4IndexType(dict["type"].asInt()) != kC4ValueIndex)
+                continue;
+            size_t order = 0;
+            if (onlyNamed) {
+                auto n = std::find(indexNames.begin(), indexNames.end(), dict["name"].asString());
+                if (n == indexNames.end())
+                    continue;
+                order = n - indexNames.begin();
+            }
+            string expr(dict["expr"].asString());
+            PrewarmQuery query;
+            vector<string> keys;
+            if (CBLCollection::indexLanguage(dict) == kC4N1QLQuery) {
+                keys = splitExpressions(expr);
+                keys.push_back("META().id");
+                string select = "SELECT META().id, " + expr + " FROM " + from;
+                string orderBy = " ORDER BY " + expr + ", META().id LIMIT $limit";
+                query.language = kCBLN1QLLanguage;
+                query.first = select + orderBy + " OFFSET $offset";
+                query.next = select + " WHERE " + afterCursor(keys, false) + orderBy;
+            } else {
+                Doc exprs = Doc::fromJSON(slice(expr));
+                for (Array::iterator e(exprs.root().asArray()); e; ++e)
+                    keys.emplace_back(e.value().toJSONString());
+                if (keys.empty())
+                    continue;
+                keys.emplace_back(R"(["._id"])");
+                string select = R"({"WHAT":[["._id"],)" + expr.substr(1)
+                              + R"(,"FROM":[{"COLLECTION":")" + string(collectionName)
+                              + R"(","SCOPE":")" + string(scopeName) + R"("}],"ORDER_BY":)"
+                              + expr.substr(0, expr.size() - 1) + R"(,["._id"]],"LIMIT":["$limit"])";
+                query.language = kCBLJSONLanguage;
+                query.first = select + R"(,"OFFSET":["$offset"]})";
+                query.next = select + R"(,"WHERE":)" + afterCursor(keys, true) + "}";
+            }
+            // The cursor is the expressions' columns, then the doc ID's:
+            for (unsigned col = 1; col < keys.size(); ++col)
+                query.keyColumns.push_back(col);
+            query.keyColumns.push_back(0);
+            indexes.push_back({order, std::move(query)});
+            found = true;
+        }
+        if (found)
+            collections.push_back(std::move(from));
+    }
+    std::stable_sort(indexes.begin(), indexes.end(), [](const Index &a, const Index &b) {
+        return a.order < b.order;
+    });
+
+    for (auto &index : indexes)
+        readQuery(index.query, budget, bytesRead);
+    // Then the documents, in doc ID order:
+    for (auto &from : collections) {
+        string select = "SELECT META().id, * FROM " + from;
+        string orderBy = " ORDER BY META().id LIMIT $limit";
+        readQuery({kCBLN1QLLanguage,
+                   select + orderBy + " OFFSET $offset",
+                   select + " WHERE META().id > $cursor0" + orderBy,
+                   {0}},
+                  budget, bytesRead);
+    }
+}
+
+
+// Runs a prewarming query a page at a time, adding up the sizes of the rows, until it runs out
+// of rows or the budget is used up. Rows whose first key is null or missing sort first, and
+// can't be compared with a cursor, so until the first key has a value the pages are read with
+// `first` at increasing offsets.
+void CBLDatabase::readQuery(const PrewarmQuery &q, uint64_t budget, uint64_t &bytesRead) const {
+    if (budget > 0 && bytesRead >= budget)
+        return;
+    Retained<C4Query> first = compileQuery(q.language, slice(q.first), nullptr);
+    Retained<C4Query> next = compileQuery(q.language, slice(q.next), nullptr);
+    if (!first || !next)
+        return;
+
+    auto encodeParams = [&](int64_t offset, fleece::function_ref<void(Encoder&)> cursor) {
+        Encoder enc;
+        enc.beginDict();
+        enc.writeKey("limit"_sl);
+        enc.writeInt(kPrewarmChunkSize);
+        if (offset >= 0) {
+            enc.writeKey("offset"_sl);
+            enc.writeInt(offset);
+        } else {
+            cursor(enc);
+        }
+        enc.endDict();
+        return enc.finish();
+    };
+
+    C4Query *query = first;
+    int64_t offset = 0;
+    alloc_slice params = encodeParams(offset, [](Encoder&) { });
+    while (true) {
+        // The query reads all of its rows when it's run; the enumerator only iterates them:
+        auto e = [&] {
+            auto lock = _c4db->useLocked();
+            return query->run(params);
+        }();
+        unsigned nCols = query->columnCount();
+        int64_t rows = 0;
+        while (e.next()) {
+            ++rows;
+            for (unsigned col = 0; col < nCols; ++col)
+                bytesRead += approximateSize(e.column(col));
+            if (budget > 0 && bytesRead >= budget)
+                return;
+            if (rows == kPrewarmChunkSize) {
+                // The last row of a full page: the next page starts after it.
+                Value firstKey = e.column(q.keyColumns[0]);
+                if (query == first.get() && (!firstKey || firstKey.type() == kFLNull)) {
+                    offset += rows;
+                    params = encodeParams(offset, [](Encoder&) { });
+                } else {
+                    query = next;
+                    params = encodeParams(-1, [&](Encoder &enc) {
+                        for (size_t i = 0; i < q.keyColumns.size(); ++i) {
+                            enc.writeKey(slice("cursor" + to_string(i)));
+                            if (Value key = e.column(q.keyColumns[i]); key)
+                                enc.writeValue(key);
+                            else
+                                enc.writeNull();
+                        }
+                    });
+                }
+            }
+        }
+        if (rows < kPrewarmChunkSize)
+            return;
+    }
 }
 
 
 namespace cbl_internal {
 
     void ListenerToken<CBLQueryChangeListener>::queryChanged() {
-        _query->database()->notify(this);
+        if (_minInterval > Clock::duration::zero())
+            coalesceChange();
+        else
+            _query->database()->notify(_query.get(), this, uint32_t(1));
     }
 
 }
@@ -21,6 +21,7 @@
 #include "CBLCollection_Internal.hh"
 #include "CBLDatabase.h"
 #include "CBLDocument_Internal.hh"
+#include "BackgroundMaintenance.hh"
 
 
 using namespace std;
@@ -113,6 +114,37 @@ bool CBLDatabase_ChangeEncryptionKey(CBLDatabase *db,
         return true;
     } catchAndBridge(outError)
 }
+
+bool CBLDatabase_RekeyStep(CBLDatabase* db,
+                           const CBLEncryptionKey* newKey,
+                           uint64_t maxDocuments,
+                           CBLRekeyProgress* outProgress,
+                           CBLError* outError) noexcept
+{
+    try {
+        CBLRekeyProgress progress = db->rekeyStep(newKey, maxDocuments);
+        if (outProgress)
+            *outProgress = progress;
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool CBLDatabase_FinishRekey(CBLDatabase* db,
+                             const CBLEncryptionKey* newKey,
+                             CBLError* outError) noexcept
+{
+    try {
+        db->finishRekey(newKey);
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool CBLDatabase_CancelRekey(CBLDatabase* db, CBLError* outError) noexcept {
+    try {
+        db->cancelRekey();
+        return true;
+    } catchAndBridge(outError)
+}
 #endif
 
 bool CBLDatabase_PerformMaintenance(CBLDatabase* db,
@@ -125,6 +157,112 @@ bool CBLDatabase_PerformMaintenance(CBLDatabase* db,
     } catchAndBridge(outError)
 }
 
+static std::vector<CBLMaintenanceType> maintenanceSteps(const CBLMaintenanceType types[], size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (types[i] > kCBLMaintenanceTypeFullOptimize)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Invalid maintenance type");
+    }
+    return std::vector<CBLMaintenanceType>(types, types + count);
+}
+
+CBLMaintenanceTask* CBLDatabase_CreateMaintenanceTask(CBLDatabase* db,
+                                                      const CBLMaintenanceType types[],
+                                                      size_t count,
+                                                      CBLError* outError) noexcept
+{
+    try {
+        return retain(new CBLMaintenanceTask(db, maintenanceSteps(types, count)));
+    } catchAndBridge(outError)
+}
+
+bool CBLMaintenanceTask_Run(CBLMaintenanceTask* task, uint32_t budgetMs, CBLError* outError) noexcept {
+    try {
+        task->run(std::chrono::milliseconds(budgetMs));
+        return true;
+    } catchAndBridge(outError)
+}
+
+CBLMaintenanceProgress CBLMaintenanceTask_Progress(const CBLMaintenanceTask* task) noexcept {
+    return task->progress();
+}
+
+bool CBLDatabase_EnableBackgroundMaintenance(CBLDatabase* db,
+                                             const CBLMaintenanceType types[],
+                                             size_t count,
+                                             CBLError* outError) noexcept
+{
+    try {
+        BackgroundMaintenance::enable(db, maintenanceSteps(types, count));
+        return true;
+    } catchAndBridge(outError)
+}
+
+void CBLDatabase_DisableBackgroundMaintenance(CBLDatabase* db) noexcept {
+    BackgroundMaintenance::disable(db);
+}
+
+FLDict CBLDatabase_GetStorageStats(const CBLDatabase* db, CBLError* outError) noexcept {
+    try {
+        return FLMutableDict_Retain(db->storageStats());
+    } catchAndBridge(outError)
+}
+
+FLDict CBLDatabase_Export(CBLDatabase* db,
+                          const CBLExportOptions* options,
+                          CBLExportWriteCallback callback,
+                          void* context,
+                          CBLError* outError) noexcept
+{
+    try {
+        return FLMutableDict_Retain(db->exportSnapshot((options ? *options : CBLExportOptions{}),
+                                                       callback, context));
+    } catchAndBridge(outError)
+}
+
+FLDict CBLDatabase_ExportToFile(CBLDatabase* db,
+                                FLString path,
+                                const CBLExportOptions* options,
+                                CBLError* outError) noexcept
+{
+    try {
+        return FLMutableDict_Retain(db->exportToFile(path, (options ? *options : CBLExportOptions{})));
+    } catchAndBridge(outError)
+}
+
+CBLMemoryTrimStats CBL_TrimMemory(CBLMemoryTrimLevel level) noexcept {
+    try {
+        return CBLDatabase::trimSharedMemory(level);
+    } catchAndWarn()
+}
+
+CBLMemoryTrimStats CBLDatabase_TrimMemory(CBLDatabase* db, CBLMemoryTrimLevel level) noexcept {
+    try {
+        return db->trimMemory(level);
+    } catchAndWarn()
+}
+
+CBLDatabase* CBLDatabase_AcquireReader(CBLDatabase* db, CBLError* outError) noexcept {
+    try {
+        return db->acquireReader().detach();
+    } catchAndBridge(outError)
+}
+
+void CBLDatabase_Prewarm(CBLDatabase* db,
+                         FLArray indexNames,
+                         uint64_t budgetBytes,
+                         CBLDatabasePrewarmCallback callback,
+                         void* context) noexcept
+{
+    try {
+        std::vector<alloc_slice> names;
+        for (Array::iterator i(indexNames); i; ++i)
+            names.emplace_back(i.value().asString());
+        db->prewarm(indexNames != nullptr, std::move(names), budgetBytes, callback, context);
+    } catch (...) {
+        BridgeException(__FUNCTION__, nullptr);
+    }
+}
+
 
 FLString CBLDatabase_Name(const CBLDatabase* db) noexcept {
     return db->name();
@@ -155,6 +293,31 @@ uint64_t CBLDatabase_LastSequence(const CBLDatabase* db) noexcept {
     } catchAndWarn()
 }
 
+/** Private API */
+void CBL_SetLockTiming(bool enabled) noexcept {
+    LockTiming::setEnabled(enabled);
+}
+
+/** Private API */
+CBLLockWaitStats CBL_LockWaitStats(void) noexcept {
+    return LockTiming::totals();
+}
+
+/** Private API */
+unsigned CBL_GetLockStats(CBLLockStats stats[], unsigned maxCount) noexcept {
+    unsigned count = LockTiming::kNumSites;
+    for (unsigned i = 0; i < count && i < maxCount; ++i)
+        stats[i] = LockTiming::stats(LockTiming::Site(i));
+    return count;
+}
+
+/** Private API */
+FLSliceResult CBL_DumpLockStats(void) noexcept {
+    try {
+        return FLSliceResult(alloc_slice(LockTiming::dump()));
+    } catchAndBridgeReturning(nullptr, FLSliceResult(alloc_slice(kFLSliceNull)));
+}
+
 
 #pragma mark - DOCUMENTS:
 
@@ -404,6 +567,21 @@ void CBLDatabase_SendNotifications(CBLDatabase *db) noexcept {
     db->sendNotifications();
 }
 
+void CBLDatabase_SetNotificationExecutor(CBLDatabase *db,
+                                         CBLNotificationExecutor executor,
+                                         void *context) noexcept
+{
+    db->setNotificationExecutor(executor, context);
+}
+
+void CBLNotificationWorkItem_Run(CBLNotificationWorkItem *item) noexcept {
+    try {
+        item->run();
+    } catch (...) {
+        BridgeException(__FUNCTION__, nullptr);
+    }
+}
+
 
 CBLListenerToken* CBLDatabase_AddDocumentChangeListener(const CBLDatabase* db,
                                                         FLString docID,
@@ -18,6 +18,7 @@
 
 #pragma once
 #include "CBLDatabase.h"
+#include "CBLDefaults.h"
 #include "CBLDocument_Internal.hh"
 #include "CBLLog_Internal.hh"
 #include "CBLPrivate.h"
@@ -27,13 +28,25 @@
 #include "Error.hh"
 #include "Internal.hh"
 #include "Listener.hh"
+#include "IndexUsage.hh"
+#include "LockTiming.hh"
+#include "MemoryStats.hh"
+#include "QueryCache.hh"
 #include "access_lock.hh"
 #include "fleece/function_ref.hh"
 #include "fleece/Mutable.hh"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <memory>
+#include <set>
+#include <shared_mutex>
 #include <string>
 #include <utility>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 CBL_ASSUME_NONNULL_BEGIN
 
@@ -63,6 +76,8 @@ public:
     static CBLDatabaseConfiguration defaultConfiguration() {
         CBLDatabaseConfiguration config = {};
         config.directory = effectiveDir(fleece::nullslice);
+        config.queryCacheSize = kCBLDefaultDatabaseQueryCacheSize;
+        config.asyncWriteLimit = kCBLDefaultAsyncWriteLimit;
         return config;
     }
 
@@ -95,27 +110,126 @@ public:
 #endif
         CBLLog_Init();
         C4DatabaseConfig2 c4config = asC4Config(config);
+#ifdef COUCHBASE_ENTERPRISE
+        finishInterruptedRekey(name, c4config.parentDirectory);
+#endif
         Retained<C4Database> c4db = C4Database::openNamed(name, c4config);
-        return new CBLDatabase(c4db, name, c4config.parentDirectory);
+        uint32_t queryCacheSize = config ? config->queryCacheSize : kCBLDefaultDatabaseQueryCacheSize;
+        Retained<CBLDatabase> db = new CBLDatabase(c4db, name, c4config.parentDirectory, queryCacheSize);
+        if (config) {
+            db->_groupCommitWindow = std::chrono::milliseconds(config->groupCommitWindow);
+            if (config->asyncWriteLimit)
+                db->_asyncWriteLimit = config->asyncWriteLimit;
+        }
+        return db;
     }
 
-    void performMaintenance(CBLMaintenanceType type) {
-        _c4db->useLocked()->maintenance((C4MaintenanceType)type);
-    }
+    void performMaintenance(CBLMaintenanceType type);
+
+    /** How long the last maintenance operation of this type took, in ms; or if it hasn't been
+        performed yet, a conservative estimate from the size of the database file. */
+    uint64_t maintenanceDuration(CBLMaintenanceType type) const;
+
+    /** Sizes of the database's files and collections, as described by \ref CBLDatabase_GetStorageStats. */
+    fleece::MutableDict storageStats() const;
+
+    /** Implements \ref CBLDatabase_Export. */
+    fleece::MutableDict exportSnapshot(const CBLExportOptions &options,
+                                       CBLExportWriteCallback callback,
+                                       void* _cbl_nullable context);
+
+    /** Implements \ref CBLDatabase_ExportToFile. */
+    fleece::MutableDict exportToFile(slice path, const CBLExportOptions &options);
+
+    /** Reads indexes and documents into the caches on a background thread. If `onlyNamed`
+        is false, every value index and collection is read. */
+    void prewarm(bool onlyNamed, std::vector<alloc_slice> indexNames, uint64_t budget,
+                 CBLDatabasePrewarmCallback _cbl_nullable callback, void* _cbl_nullable context);
 
 #ifdef COUCHBASE_ENTERPRISE
     void changeEncryptionKey(const CBLEncryptionKey* _cbl_nullable newKey) {
         C4EncryptionKey c4key = asC4Key(newKey);
         _c4db->useLocked()->rekey(&c4key);
     }
+
+    /** Implements \ref CBLDatabase_RekeyStep. */
+    CBLRekeyProgress rekeyStep(const CBLEncryptionKey* _cbl_nullable newKey, uint64_t maxDocuments);
+
+    /** Implements \ref CBLDatabase_FinishRekey. Closes the database. */
+    void finishRekey(const CBLEncryptionKey* _cbl_nullable newKey);
+
+    /** Implements \ref CBLDatabase_CancelRekey. */
+    void cancelRekey();
+
+    /** The IDs of the documents changed in each collection, by full name. */
+    using RekeyDocIDs = std::unordered_map<std::string, std::set<std::string>>;
+
+    /** Tells a `finishRekey` in progress that a document's expiration was set, which changes
+        neither its sequence nor what collection observers are told. */
+    void rekeyExpirationChanged(slice collectionName, slice docID);
 #endif
 
-    void beginTransaction()                          {_c4db->useLocked()->beginTransaction();}
-    void endTransaction(bool commit)                 {_c4db->useLocked()->endTransaction(commit);}
+    /** Calls `write` with the database locked and in a transaction, which is committed unless
+        it returns false. With group commit enabled, the transaction may include other threads'
+        writes; this returns, or throws, once it has been committed. */
+    void writeInTransaction(CBLCollection* collection,
+                            fleece::function_ref<bool(C4Collection*)> write);
+
+    /** Queues a save or deletion of a document, to be performed on a background thread along
+        with the other writes queued meanwhile, as described in CBLCollection.h. */
+    void writeAsync(CBLCollection* collection, CBLDocument* doc, CBLConcurrencyControl concurrency,
+                    bool deleting, CBLDocumentWriteCallback _cbl_nullable callback,
+                    void* _cbl_nullable context);
+
+    void beginTransaction() {
+        auto c4db = _c4db->useLocked();
+        c4db->beginTransaction();
+        ++_transactionLevel;
+    }
+
+    void endTransaction(bool commit) {
+        auto c4db = _c4db->useLocked();
+        --_transactionLevel;
+        c4db->endTransaction(commit);
+    }
+
+    /** A collection's cached document count; see `documentCount`. */
+    struct DocumentCount {
+        // The count if it's known; else a negative number, a different one after each change,
+        // so that a count read before a change can't be cached after it:
+        std::atomic<int64_t>                    value {-1};
+        std::atomic<int64_t>                    changes {1};
+        std::unique_ptr<C4CollectionObserver>   observer;       // Guarded by the _c4db lock
+        
+        void invalidate() noexcept              {value = -(++changes);}
+    };
+
+    /** Returns the number of documents in a collection, which must be locked, and caches it
+        until a commit changes the collection, as seen by an observer. `cache` is the
+        collection's own pointer to the cache, set the first time. */
+    uint64_t documentCount(C4Collection* c4col, slice fullName, std::atomic<DocumentCount*> &cache);
+
+    /** Returns the count cached by `documentCount`, without locking, or -1 if it has changed or
+        wouldn't be accurate: inside a transaction the count includes uncommitted changes. */
+    int64_t cachedDocumentCount(const std::atomic<DocumentCount*> &cache) const noexcept {
+        DocumentCount* count = cache.load(std::memory_order_acquire);
+        if (!count || _transactionLevel > 0)
+            return -1;
+        return count->value.load();
+    }
     
+    /** A number that changes whenever a commit, by this or another connection, changes any
+        collection, or a collection is created or deleted; results read at one version are stale
+        at another. Returns 0, never a version, inside a transaction, since its changes aren't
+        seen until it commits. */
+    uint64_t dataVersion() const;
+
     void close();
     void closeAndDelete();
 
+    /** Implements \ref CBLDatabase_AcquireReader. */
+    Retained<CBLDatabase> acquireReader();
+
 
 #pragma mark - Accessors:
 
@@ -132,6 +246,9 @@ public:
 #endif
         config.fullSync = (c4config.flags & kC4DB_DiskSyncFull) == kC4DB_DiskSyncFull;
         config.mmapDisabled = (c4config.flags & kC4DB_MmapDisabled) == kC4DB_MmapDisabled;
+        config.queryCacheSize = uint32_t(_queryCache.capacity());
+        config.groupCommitWindow = uint32_t(_groupCommitWindow.count());
+        config.asyncWriteLimit = _asyncWriteLimit;
         return config;
     }
 
@@ -186,6 +303,45 @@ public:
     Retained<CBLQuery> createQuery(CBLQueryLanguage language,
                                    slice queryString,
                                    int* _cbl_nullable outErrPos) const;
+
+    /** Compiles a query without going through the query cache. JSON queries must already have
+        been converted from JSON5. Returns null on a syntax error. */
+    Retained<C4Query> compileQuery(CBLQueryLanguage language,
+                                   slice queryString,
+                                   int* _cbl_nullable outErrPos) const
+    {
+        return _c4db->useLocked()->newQuery((C4QueryLanguage)language, queryString, outErrPos);
+    }
+
+    /** Implements \ref CBLDatabase_QueryCollections. */
+    fleece::MutableArray queryCollections(slice queryTemplate,
+                                          const CBLCollection* const collections[],
+                                          size_t numCollections,
+                                          Dict parameters,
+                                          const CBLQuerySortColumn* _cbl_nullable sortColumns,
+                                          size_t numSortColumns,
+                                          uint64_t limit);
+
+    CBLQueryCacheStats queryCacheStats() const {
+        auto lock = _c4db->useLocked();
+        return _queryCache.stats();
+    }
+
+    /** Implements \ref CBLDatabase_TrimMemory. */
+    CBLMemoryTrimStats trimMemory(CBLMemoryTrimLevel level);
+
+    /** Implements \ref CBL_TrimMemory. */
+    static CBLMemoryTrimStats trimSharedMemory(CBLMemoryTrimLevel level);
+
+    /** Which indexes the database's queries use, if tracking is enabled. */
+    cbl_internal::IndexUsage& indexUsage() const    {return _indexUsage;}
+
+    /** Called when indexes or collections change, since the plans of the cached queries depend
+        on them. */
+    void invalidateQueryCache() const {
+        auto lock = _c4db->useLocked();
+        _queryCache.invalidate();
+    }
     
 
 #pragma mark - Listeners:
@@ -199,6 +355,10 @@ public:
         _notificationQueue.setCallback(callback, context);
     }
 
+    void setNotificationExecutor(CBLNotificationExecutor _cbl_nullable executor, void* _cbl_nullable context) {
+        _notificationQueue.setExecutor(executor, context);
+    }
+
 
 #pragma mark - Binding Dev Support for Blob:
     
@@ -246,6 +406,21 @@ protected:
             LOCK_GUARD lock(getMutex());
             _closed = true;
         }
+
+        // These time the lock, when enabled by CBL_SetLockTiming:
+        using access_lock::useLocked;
+
+        template <class CALLBACK>
+        decltype(auto) useLocked(CALLBACK callback) {
+            cbl_internal::TimedLock timing(getMutex(), cbl_internal::LockTiming::kDatabase, std::defer_lock);
+            return access_lock::useLocked(callback);
+        }
+
+        auto useLocked() {
+            cbl_internal::TimedLock timing(getMutex(), cbl_internal::LockTiming::kDatabase, std::defer_lock);
+            timing.skipHoldTime();
+            return access_lock::useLocked();
+        }
         
         bool isClosedNoLock() {
             return _closed;
@@ -270,15 +445,24 @@ protected:
     
     C4BlobStore* blobStore() const                  {return &(_c4db->useLocked()->getBlobStore());}
 
+    /** Queues a call to a listener. The key is the object the notification is about, usually
+        a collection or query; notifications with the same key are always called in order. */
     template <class LISTENER, class... Args>
-    void notify(ListenerToken<LISTENER>* _cbl_nonnull listener, Args... args) const {
+    void notify(const void* key, ListenerToken<LISTENER>* _cbl_nonnull listener, Args... args) const {
         Retained<ListenerToken<LISTENER>> retained = listener;
-        notify([=]() {
+        notify(key, [=]() {
             retained->call(args...);
         });
     }
 
-    void notify(Notification n) const   {const_cast<CBLDatabase*>(this)->_notificationQueue.add(n);}
+    template <class FN>
+    void notify(const void* key, FN &&fn) const {
+        const_cast<CBLDatabase*>(this)->_notificationQueue.add(key, std::forward<FN>(fn));
+    }
+
+    /** True if notifications are called as they're made, not buffered or given to an executor,
+        so a listener's arguments don't have to outlive the call to `notify`. */
+    bool notifiesImmediately() const                {return _notificationQueue.immediate();}
 
     auto useLocked()                    {return _c4db->useLocked();}
     template <class LAMBDA>
@@ -288,14 +472,58 @@ protected:
 
 private:
     
-    CBLDatabase(C4Database* _cbl_nonnull db, slice name_, slice dir_);
+    CBLDatabase(C4Database* _cbl_nonnull db, slice name_, slice dir_, size_t queryCacheSize);
 
     virtual ~CBLDatabase();
 
     // Default location for databases. This is platform-dependent.
     static std::string defaultDirectory();
 
+    void closeReaders();
+
+    struct GroupWrite;
+    void commitGroup(const std::vector<GroupWrite*> &writes);
+
+    struct AsyncWrite;
+    void runAsyncWrites();
+    void finishAsyncWrites();
+
+    void closeDocumentCount(slice fullName);
+    void closeDocumentCounts();
+    void closeVersionObservers() const;
+
+    bool collectionCacheIsCurrent() const;     // Call with _collectionCacheMutex locked
+    void cacheCollection(const std::string &fullName, C4Collection* _cbl_nullable c4col,
+                         uint64_t generation);
+    void clearCollectionCache();
+
+    void prewarmNow(bool onlyNamed, const std::vector<alloc_slice> &indexNames, uint64_t budget,
+                    uint64_t &bytesRead);
+    // A prewarming query, read a page at a time by `readQuery`: `first` reads the first page,
+    // given the parameters `$limit` and `$offset`; `next` reads the page after the row whose
+    // `keyColumns` are bound to `$cursor0`, `$cursor1`, ..., given `$limit`.
+    struct PrewarmQuery {
+        CBLQueryLanguage        language;
+        std::string             first, next;
+        std::vector<unsigned>   keyColumns;
+    };
+    void readQuery(const PrewarmQuery&, uint64_t budget, uint64_t &bytesRead) const;
+
 #ifdef COUCHBASE_ENTERPRISE
+    // Opens the re-encrypted copy being made by `rekeyStep`. Must be called under _rekeyMutex.
+    C4Database* rekeyTarget(const CBLEncryptionKey* _cbl_nullable newKey);
+
+    // Replaces a database with its re-encrypted copy, if `finishRekey` was interrupted doing so.
+    static void finishInterruptedRekey(slice name, slice dir);
+
+    // Starts noting the documents changed in each collection, for `stopRekeyTracking`.
+    // Must be called under the _c4db lock.
+    void startRekeyTracking(C4Database*);
+
+    // Stops noting changes, and returns the documents changed since `startRekeyTracking` in
+    // each collection that existed then. Must be called under the _c4db lock.
+    RekeyDocIDs stopRekeyTracking();
+
     static C4EncryptionKey asC4Key(const CBLEncryptionKey* _cbl_nullable key) {
         C4EncryptionKey c4key;
         if (key) {
@@ -409,14 +637,101 @@ private:
     
     Retained<CBLCollection>                     _defaultCollection;     // Internal default collection
     
+    mutable cbl_internal::QueryCache            _queryCache;            // Guarded by the _c4db lock
+    mutable cbl_internal::IndexUsage            _indexUsage;            // Thread-safe
+    
+    // The collections looked up so far, by full name, and the number of collection deletions
+    // when they were; see `getCollection`:
+    mutable std::shared_mutex                   _collectionCacheMutex;
+    std::unordered_map<std::string, Retained<C4Collection>> _collectionCache;
+    uint64_t                                    _collectionCacheGeneration {0};
+    
+    // Cached document counts, by collection full name; guarded by the _c4db lock:
+    std::unordered_map<std::string, std::unique_ptr<DocumentCount>> _documentCounts;
+
+    // Observers of every collection, by full name, which change the data version; see
+    // `dataVersion`. Guarded by the _c4db lock:
+    struct VersionObserver {
+        std::unique_ptr<C4CollectionObserver>   observer;
+        std::atomic<bool>                       notified {false};   // Must read its changes
+    };
+    mutable std::unordered_map<std::string, std::unique_ptr<VersionObserver>> _versionObservers;
+    mutable bool                                _versionObserversOpen {false};
+    mutable uint64_t                            _versionCollectionsGeneration {0};
+    mutable std::atomic<uint64_t>               _dataVersion {1};
+    std::atomic<int>                            _transactionLevel {0};  // Explicit transactions
+    
+    // Duration of the last maintenance operation of each type, in ms, how many times each has
+    // been performed, and the bytes the last compaction reclaimed:
+    std::array<std::atomic<uint64_t>, kCBLMaintenanceTypeFullOptimize + 1> _maintenanceMs {};
+    std::array<std::atomic<unsigned>, kCBLMaintenanceTypeFullOptimize + 1> _maintenanceCount {};
+    std::atomic<int64_t>                        _compactReclaimedBytes {0};
+
+#ifdef COUCHBASE_ENTERPRISE
+    // The re-encrypted copy of the database being made by `rekeyStep`, if open:
+    std::mutex                                  _rekeyMutex;
+    Retained<C4Database>                        _rekeyDB;
+
+    // While `finishRekey` compares the copy with the database without blocking writers, the
+    // documents that change meanwhile; only they are compared again once writers are blocked:
+    struct RekeyTracking {
+        std::unordered_map<std::string, std::unique_ptr<C4CollectionObserver>> observers;
+        RekeyDocIDs                             expirations;    // Reported by CBLCollection
+    };
+    std::mutex                                  _rekeyTrackingMutex;
+    std::unique_ptr<RekeyTracking>              _rekeyTracking;     // Guarded by _rekeyTrackingMutex
+#endif
+    
     // For sending notifications:
     NotificationQueue                           _notificationQueue;
     
+    // Read-only connections; one whose only reference is the pool's is idle:
+    bool                                        _isReader {false};
+    std::mutex                                  _readersMutex;
+    std::vector<Retained<CBLDatabase>>          _readers;
+    
+    // Group commit: the writes waiting for the thread that's gathering them to commit:
+    std::chrono::milliseconds                   _groupCommitWindow {0};
+    std::mutex                                  _groupMutex;
+    std::condition_variable                     _groupCond;
+    std::vector<GroupWrite*>                    _groupWrites;
+    bool                                        _groupGathering {false};
+    
+    // Asynchronous writes, waiting for the writer task:
+    uint32_t                                    _asyncWriteLimit {kCBLDefaultAsyncWriteLimit};
+    std::mutex                                  _asyncMutex;
+    std::condition_variable                     _asyncCond;
+    std::vector<AsyncWrite>                     _asyncWrites;
+    bool                                        _asyncWriting {false};  // Writer task is running
+    bool                                        _asyncClosed {false};   // Database is closing
+    
     // For Active Stoppables:
     bool                                        _stopping {false};
     mutable std::mutex                          _stopMutex;
     std::condition_variable                     _stopCond;
     std::unordered_set<CBLStoppable*>           _stoppables;
+
+    cbl_internal::MemoryAccount                 _memory {cbl_internal::MemoryCategory::kDatabases, this, sizeof(CBLDatabase)};
+};
+
+
+/** Performs a list of maintenance operations a few at a time; see CBLDatabase.h. */
+struct CBLMaintenanceTask final : public CBLRefCounted {
+public:
+    CBLMaintenanceTask(CBLDatabase* db, std::vector<CBLMaintenanceType> steps)
+    :_db(db)
+    ,_steps(std::move(steps))
+    { }
+    
+    void run(std::chrono::milliseconds budget);
+    
+    CBLMaintenanceProgress progress() const;
+    
+private:
+    Retained<CBLDatabase> const             _db;
+    std::vector<CBLMaintenanceType> const   _steps;
+    mutable std::mutex                      _mutex;
+    size_t                                  _next {0};      // Index of the next step to perform
 };
 
 CBL_ASSUME_NONNULL_END
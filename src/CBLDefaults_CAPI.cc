@@ -28,6 +28,16 @@
 
 CBL_PUBLIC const bool kCBLDefaultDatabaseFullSync = false;
 CBL_PUBLIC const bool kCBLDefaultDatabaseMmapDisabled = false;
+CBL_PUBLIC const uint32_t kCBLDefaultDatabaseQueryCacheSize = 0;
+CBL_PUBLIC const uint32_t kCBLDefaultAsyncWriteLimit = 1000;
+
+#pragma mark - CBLImportOptions
+
+CBL_PUBLIC const uint32_t kCBLDefaultImportBatchSize = 10000;
+
+#pragma mark - CBLExportOptions
+
+CBL_PUBLIC const size_t kCBLDefaultExportChunkSize = 65536;
 
 #pragma mark - CBLLogFileConfiguration
 
@@ -51,6 +61,8 @@ CBL_PUBLIC const unsigned kCBLDefaultReplicatorMaxAttemptsWaitTime = 300;
 CBL_PUBLIC const unsigned kCBLDefaultReplicatorMaxAttemptWaitTime = 300;
 CBL_PUBLIC const bool kCBLDefaultReplicatorDisableAutoPurge = false;
 CBL_PUBLIC const bool kCBLDefaultReplicatorAcceptParentCookies = false;
+CBL_PUBLIC const unsigned kCBLDefaultReplicatorMaxConcurrentConflictResolvers = 4;
+CBL_PUBLIC const unsigned kCBLDefaultReplicatorConflictResolverBatchSize = 50;
 
 #ifdef COUCHBASE_ENTERPRISE
 
@@ -21,10 +21,16 @@
 #include "CBLCollection_Internal.hh"
 #include "CBLDocument_Internal.hh"
 #include "CBLBlob_Internal.hh"
+#include "Trace.hh"
 #include "c4BlobStore.hh"
 #include "c4Private.h"
 #include "betterassert.hh"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
 #include <mutex>
+#include <vector>
 
 #ifdef COUCHBASE_ENTERPRISE
 #include "CBLEncryptable_Internal.hh"
@@ -53,6 +59,7 @@ CBLDocument::CBLDocument(slice docID, CBLCollection *collection, C4Document *c4d
     if (c4doc) {
         c4doc->extraInfo() = {this, nullptr};
         _revID = c4doc->selectedRev().revID;
+        accountMemory(c4doc);
     }
 }
 
@@ -76,18 +83,17 @@ CBLDatabase* _cbl_nullable CBLDocument::database() const {
 
 
 bool CBLDocument::save(CBLCollection* collection, const SaveOptions &opt) {
+    TraceSpan span(kCBLTraceSave, _docID);
     Retained<C4Document> orignalDoc = nullptr, savingDoc = nullptr;
     bool success = false, retrying = false;
     
     do {
         bool handleConflictNeeded = false;
         RetainedConst<CBLDocument> conflictingDoc = nullptr;
+        Retained<C4Document> newDoc;
         
         // Note: shared lock b/w database and collection
-        collection->useLocked([&](C4Collection* c4col) {
-            auto c4db = c4col->getDatabase();
-            C4Database::Transaction t(c4db);
-            
+        collection->database()->writeInTransaction(collection, [&](C4Collection* c4col) {
             auto c4doc = _c4doc.useLocked();
             
             if (!retrying) {
@@ -110,43 +116,12 @@ bool CBLDocument::save(CBLCollection* collection, const SaveOptions &opt) {
                 precondition(c4doc.get() == orignalDoc);
             }
             
-            alloc_slice body;
-            C4RevisionFlags revFlags;
-            if (!opt.deleting) {
-                body = encodeBody(collection->database(), c4db, false, revFlags);
-            } else {
-                revFlags = kRevDeleted;
-            }
-            
             retrying = false;
-            Retained<C4Document> newDoc = nullptr;
             conflictingDoc = nullptr;
             
-            if (savingDoc) {
-                // Update existing doc:
-                newDoc = savingDoc->update(body, revFlags);
-            } else {
-                // Create new doc:
-                C4DocPutRequest rq = {};
-                rq.allocedBody = {body.buf, body.size};
-                rq.docID = _docID;
-                rq.revFlags = revFlags;
-                rq.save = true;
-                C4Error c4err;
-                newDoc = c4col->putDocument(rq, nullptr, &c4err);
-                if (!newDoc && c4err != C4Error{LiteCoreDomain, kC4ErrorConflict})
-                    C4Error::raise(c4err);
-            }
+            newDoc = putRevision(c4col, collection->database(), savingDoc, opt.deleting);
             
-            if (newDoc) {
-                // Success:
-                t.commit();
-                _collection = collection;
-                // HACK: Replace the inner reference of the c4doc with the one from newDoc.
-                c4doc.get() = std::move(newDoc);
-                _revID = c4doc->selectedRev().revID;
-                success = true;
-            } else {
+            if (!newDoc) {
                 // Conflict:
                 if (opt.concurrency == kCBLConcurrencyControlLastWriteWins) {
                     // Last-write-wins; load current revision and retry:
@@ -159,8 +134,20 @@ bool CBLDocument::save(CBLCollection* collection, const SaveOptions &opt) {
                     handleConflictNeeded = true;
                 }
             }
+            return newDoc != nullptr;
         });
         
+        if (newDoc) {
+            // Success, now that the transaction has been committed:
+            auto c4doc = _c4doc.useLocked();
+            _collection = collection;
+            // HACK: Replace the inner reference of the c4doc with the one from newDoc.
+            c4doc.get() = std::move(newDoc);
+            _revID = c4doc->selectedRev().revID;
+            accountMemory(c4doc.get());
+            success = true;
+        }
+        
         // Conflict will be handled outside document and database lock:
         if (handleConflictNeeded) {
             // Use conflict handler to solve the conflict; conflictingDoc should be non-null
@@ -181,27 +168,180 @@ bool CBLDocument::save(CBLCollection* collection, const SaveOptions &opt) {
         }
     } while (retrying);
     
+    if (success)
+        span.addItems(1);
     return success;
 }
 
 
+size_t CBLDocument::saveDocuments(CBLCollection* collection,
+                                  CBLDocument* const docs[],
+                                  size_t count,
+                                  CBLConcurrencyControl concurrency,
+                                  CBLError* _cbl_nullable outResults)
+{
+    if (outResults)
+        std::fill(outResults, outResults + count, CBLError{});
+    if (count == 0)
+        return 0;
+    
+    TraceSpan span(kCBLTraceSave);
+    std::vector<Retained<C4Document>> newDocs(count);
+    size_t saved = 0;
+    
+    // Note: shared lock b/w database and collection
+    collection->useLocked([&](C4Collection* c4col) {
+        auto db = collection->database();
+        C4Database::Transaction t(c4col->getDatabase());
+        
+        for (size_t i = 0; i < count; ++i) {
+            CBLDocument* doc = docs[i];
+            try {
+                auto c4doc = doc->_c4doc.useLocked();
+                doc->checkMutable();
+                checkCollectionMatches(doc->_collection, collection);
+                
+                Retained<C4Document> newDoc = doc->putRevision(c4col, db, c4doc.get(), false);
+                if (!newDoc && concurrency == kCBLConcurrencyControlLastWriteWins) {
+                    // Last-write-wins; we hold the lock so the current revision can't change again:
+                    Retained<C4Document> current = c4col->getDocument(doc->_docID, true, kDocGetCurrentRev);
+                    newDoc = doc->putRevision(c4col, db, current, false);
+                }
+                if (!newDoc)
+                    C4Error::raise(LiteCoreDomain, kC4ErrorConflict, "Document update conflict");
+                newDocs[i] = std::move(newDoc);
+                ++saved;
+            } catch (...) {
+                // Without per-document results, the batch is all-or-nothing:
+                if (!outResults)
+                    throw;
+                outResults[i] = external(C4Error::fromCurrentException());
+            }
+        }
+        
+        if (saved == 0)
+            return;
+        {
+            TraceSpan commitSpan(kCBLTraceCommit);
+            commitSpan.addItems(saved);
+            t.commit();
+        }
+        
+        // The batch is committed; update the documents with their new revisions:
+        for (size_t i = 0; i < count; ++i) {
+            if (!newDocs[i])
+                continue;
+            CBLDocument* doc = docs[i];
+            auto c4doc = doc->_c4doc.useLocked();
+            doc->_collection = collection;
+            // HACK: Replace the inner reference of the c4doc with the one from newDoc.
+            c4doc.get() = std::move(newDocs[i]);
+            doc->_revID = c4doc->selectedRev().revID;
+            doc->accountMemory(c4doc.get());
+        }
+    });
+    span.addItems(saved);
+    return saved;
+}
+
+
+Retained<C4Document> CBLDocument::putRevision(C4Collection* c4col,
+                                              CBLDatabase* db,
+                                              C4Document* _cbl_nullable parent,
+                                              bool deleting) const
+{
+    alloc_slice body;
+    C4RevisionFlags revFlags;
+    if (!deleting) {
+        body = encodeBody(db, c4col->getDatabase(), false, revFlags);
+    } else {
+        revFlags = kRevDeleted;
+    }
+    
+    if (parent) {
+        // Update existing doc:
+        return parent->update(body, revFlags);
+    }
+    
+    // Create new doc:
+    C4DocPutRequest rq = {};
+    rq.allocedBody = {body.buf, body.size};
+    rq.docID = _docID;
+    rq.revFlags = revFlags;
+    rq.save = true;
+    C4Error c4err;
+    Retained<C4Document> newDoc = c4col->putDocument(rq, nullptr, &c4err);
+    if (!newDoc && c4err != C4Error{LiteCoreDomain, kC4ErrorConflict})
+        C4Error::raise(c4err);
+    return newDoc;
+}
+
+
+// Roughly how many bytes encoding `v` from scratch takes; it only has to be within a small
+// factor of the real size.
+static size_t encodedSizeEstimate(Value v) {
+    switch (v.type()) {
+        case kFLString:
+        case kFLData:
+            return 2 + v.asData().size;
+        case kFLArray: {
+            size_t size = 4;
+            for (Array::iterator i(v.asArray()); i; ++i)
+                size += 4 + encodedSizeEstimate(i.value());
+            return size;
+        }
+        case kFLDict: {
+            size_t size = 4;
+            for (Dict::iterator i(v.asDict()); i; ++i)
+                size += 8 + i.keyString().size + encodedSizeEstimate(i.value());
+            return size;
+        }
+        default:
+            return 8;
+    }
+}
+
+
 alloc_slice CBLDocument::encodeBody(CBLDatabase* db,
                                     C4Database* c4db,
                                     bool releaseNewBlob,
                                     C4RevisionFlags &outRevFlags) const
 {
+    TraceSpan span(kCBLTraceEncode, _docID);
     auto c4doc = _c4doc.useLocked();
     // Save new blobs and check encryptables in arrays:
     bool hasBlobs = saveBlobsAndCheckEncryptables(db, releaseNewBlob);
     outRevFlags = hasBlobs ? kRevHasAttachments : 0;
 
+    // If this is an edited copy of a large enough saved revision, encode only the delta:
+    // unchanged values from the revision are written as pointers back into its body, instead
+    // of being re-encoded. The result is then the old body with the delta appended.
+    // Values that were replaced stay in the body as garbage, so once it's grown to more than
+    // twice what a fresh encoding would take, it's re-encoded whole instead, which drops them.
+    slice base;
+    if (c4doc && isMutable() && !_fromJSON) {
+        base = c4doc->getRevisionBody();
+        if (base.size < kMinDeltaBaseSize
+                || base.size > 2 * encodedSizeEstimate(properties()))
+            base = nullslice;
+    }
+
     // Now encode the properties to Fleece:
     SharedEncoder enc(c4db->sharedFleeceEncoder());
+    if (base)
+        enc.amend(base, true);
     enc.writeValue(properties());
     FLError flErr;
     alloc_slice body = enc.finish(&flErr);
     if (!body)
         C4Error::raise(FleeceDomain, flErr);
+    if (base) {
+        alloc_slice delta = std::move(body);
+        body = alloc_slice(base.size + delta.size);
+        memcpy((void*)body.buf, base.buf, base.size);
+        memcpy((void*)body.offset(base.size), delta.buf, delta.size);
+    }
+    span.addBytes(body.size);
     return body;
 }
 
@@ -215,8 +355,7 @@ bool CBLDocument::resolveConflict(Resolution resolution, const CBLDocument * _cb
     if (!c4doc)
         C4Error::raise(LiteCoreDomain, kC4ErrorNotFound, "Document has not been saved to a database");
 
-    _properties = nullptr;
-    _fromJSON = nullptr;
+    clearProperties();
 
     // Remote Revision always win so that the resolved revision will not conflict with the remote:
     slice winner(c4doc->selectedRev().revID), loser(c4doc->revID());
@@ -259,30 +398,64 @@ bool CBLDocument::resolveConflict(Resolution resolution, const CBLDocument * _cb
 #pragma mark - BLOBS:
 
 
-using UnretainedValueToBlobMap = litecore::access_lock<std::unordered_map<slice, CBLNewBlob*>>;
+namespace {
+    // Registry of new blobs that haven't been installed yet, keyed by digest. It's split into
+    // shards, each with its own lock, so threads creating or looking up different blobs rarely
+    // contend with each other.
+    class NewBlobRegistry {
+    public:
+        using Shard = litecore::access_lock<std::unordered_map<slice, CBLNewBlob*>>;
+        
+        Shard& shardFor(slice digest) {
+            return _shards[std::hash<slice>{}(digest) % kNumShards];
+        }
+        
+        void added()                            {_count.fetch_add(1, std::memory_order_relaxed);}
+        void removed()                          {_count.fetch_sub(1, std::memory_order_relaxed);}
+        bool empty() const                      {return _count.load(std::memory_order_relaxed) == 0;}
+        
+    private:
+        static constexpr size_t kNumShards = 32;
+        
+        std::array<Shard, kNumShards> _shards;
+        std::atomic<size_t>           _count {0};
+    };
+}
 
-static UnretainedValueToBlobMap& newBlobs() {
-    static UnretainedValueToBlobMap sNewBlobs;
+static NewBlobRegistry& newBlobs() {
+    static NewBlobRegistry sNewBlobs;
     return sNewBlobs;
 }
 
 
 void CBLDocument::registerNewBlob(CBLNewBlob* blob) {
-    newBlobs().useLocked()->insert({blob->digest(), blob});
+    auto& registry = newBlobs();
+    slice digest = blob->digest();
+    if (registry.shardFor(digest).useLocked()->insert({digest, blob}).second)
+        registry.added();
 }
 
 
 void CBLDocument::unregisterNewBlob(CBLNewBlob* blob) {
-    newBlobs().useLocked().get().erase(blob->digest());
+    auto& registry = newBlobs();
+    slice digest = blob->digest();
+    if (registry.shardFor(digest).useLocked()->erase(digest) > 0)
+        registry.removed();
+}
+
+
+bool CBLDocument::hasNewBlobs() {
+    return !newBlobs().empty();
 }
 
 
 CBLNewBlob* CBLDocument::findNewBlob(FLDict dict) {
     if (!Dict(dict).asMutable())
         return nullptr;
-    return newBlobs().useLocked<CBLNewBlob*>([dict](auto &newBlobs) -> CBLNewBlob* {
-        auto digest = Dict(dict)[kCBLBlobDigestProperty].asString();
-        assert(digest);
+    auto digest = Dict(dict)[kCBLBlobDigestProperty].asString();
+    assert(digest);
+    auto& shard = newBlobs().shardFor(digest);
+    return shard.useLocked<CBLNewBlob*>([digest](auto &newBlobs) -> CBLNewBlob* {
         auto i = newBlobs.find(digest);
         if (i == newBlobs.end()) {
             CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
@@ -298,8 +471,8 @@ CBLNewBlob* CBLDocument::findNewBlob(FLDict dict) {
 CBLBlob* CBLDocument::getBlob(FLDict dict, const C4BlobKey &key) {
     auto c4doc = _c4doc.useLocked();
     // Is it already registered by a previous call to getBlob?
-    if (auto i = _blobs.find(dict); i != _blobs.end())
-        return i->second;
+    if (auto blob = _blobs.find(dict); blob)
+        return blob;
 
     // Verify it's either a blob or an old-style attachment:
     if (!C4Blob::isBlob(dict) && !C4Blob::isAttachmentIn(dict, properties()))
@@ -312,8 +485,7 @@ CBLBlob* CBLDocument::getBlob(FLDict dict, const C4BlobKey &key) {
 
     // Create a new CBLBlob and remember it:
     auto blob = new CBLBlob(db, dict, key);
-    _blobs.insert({dict, retained(blob)});
-    return blob;
+    return _blobs.insert(dict, blob);
 }
 
 
@@ -326,13 +498,12 @@ CBLEncryptable* CBLDocument::getEncryptableValue(FLDict dict) {
     auto c4doc = _c4doc.useLocked();
     
     // Is it already registered by a previous call to getEncryptableValue?
-    if (auto i = _encryptables.find(dict); i != _encryptables.end())
-        return i->second;
+    if (auto prop = _encryptables.find(dict); prop)
+        return prop;
     
     // Create a new CBLEncryptable and remember it:
     auto prop = new CBLEncryptable(dict);
-    _encryptables.insert({dict, retained(prop)});
-    return prop;
+    return _encryptables.insert(dict, prop);
 }
 
 #endif
@@ -352,11 +523,21 @@ bool CBLDocument::saveBlobsAndCheckEncryptables(CBLDatabase *db, bool releaseNew
     // Note: If the same new blob is used in multiple places inside the object tree, the
     // blob will be installed only once as it will be unregistered from global sNewBlobs
     // HashTable.
+    //
+    // Immutable collections that are part of the document's own revision body haven't been
+    // touched since that revision was saved, so only the mutated parts of the tree (and any
+    // values inserted from elsewhere) are visited. The blobs in the untouched parts are known
+    // from the revision's kRevHasAttachments flag.
     auto c4doc = _c4doc.useLocked();
     if (!isMutable())
         return C4Blob::dictContainsBlobs(properties());
     
+    slice revBody;
     bool foundBlobs = false;
+    if (c4doc && !_fromJSON) {
+        revBody = c4doc->getRevisionBody();
+        foundBlobs = (c4doc->selectedRev().flags & kRevHasAttachments) != 0;
+    }
     
     // In EE, encryptables need to be checked, but this adds a lot of overhead so in CE this will be
     // skipped. By defining a constant bool like this, the compiler should optimize out all of the
@@ -367,7 +548,17 @@ bool CBLDocument::saveBlobsAndCheckEncryptables(CBLDatabase *db, bool releaseNew
     const bool validateEncryptables = false;
 #endif
 
+    // If the revision already has blobs and there are no unsaved new blobs anywhere, there is
+    // nothing to install and the outcome is known without walking the tree at all:
+    if (foundBlobs && !validateEncryptables && !hasNewBlobs())
+        return true;
+
     for (DeepIterator i(properties()); i; ++i) {
+        if (revBody && revBody.containsAddress(i.value())) {
+            // Unchanged part of the saved revision:
+            i.skipChildren();
+            continue;
+        }
         Dict dict = i.value().asDict();
         if (dict) {
             if (validateEncryptables && FLDict_IsEncryptableValue(dict)) {
@@ -397,6 +588,8 @@ bool CBLDocument::saveBlobsAndCheckEncryptables(CBLDatabase *db, bool releaseNew
                 foundBlobs = true;
                 CBLNewBlob *newBlob = findNewBlob(dict);
                 if (newBlob) {
+                    TraceSpan blobSpan(kCBLTraceBlobInstall, _docID);
+                    blobSpan.addBytes(newBlob->contentLength());
                     newBlob->install(db);
                     if (releaseNewBlob) {
                         CBLBlob_Release(newBlob);
@@ -18,6 +18,7 @@
 
 #include "CBLDocument_Internal.hh"
 #include "CBLPrivate.h"
+#include "ConflictFree.hh"
 
 using namespace fleece;
 
@@ -35,6 +36,11 @@ CBLDocument* CBLDocument_MutableCopy(const CBLDocument* doc) noexcept {
     return make_retained<CBLDocument>(doc).detach();
 }
 
+void CBLDocument_ReleaseAll(const CBLDocument* docs[], size_t count) noexcept {
+    for (size_t i = 0; i < count; ++i)
+        CBLDocument_Release(docs[i]);
+}
+
 FLSlice CBLDocument_ID(const CBLDocument* doc) noexcept                 {return doc->docID();}
 FLSlice CBLDocument_RevisionID(const CBLDocument* doc) noexcept         {return doc->revisionID();}
 uint64_t CBLDocument_Timestamp(const CBLDocument* doc) noexcept         {return doc->timestamp();}
@@ -52,6 +58,11 @@ FLSliceResult CBLDocument_GetRevisionHistory(const CBLDocument* doc) noexcept {
     return FLSliceResult(doc->getRevisionHistory());
 }
 
+/** Private API */
+uint64_t CBLDocument_HeapAllocationCount(void) noexcept {
+    return CBLDocument::heapAllocationCount();
+}
+
 FLMutableDict CBLDocument_MutableProperties(CBLDocument* doc) noexcept {
     return doc->mutableProperties();
 }
@@ -70,3 +81,65 @@ bool CBLDocument_SetJSON(CBLDocument* doc, FLSlice json, CBLError* outError) noe
         return true;
     } catchAndBridge(outError)
 }
+
+
+#pragma mark - CONFLICT-FREE VALUES:
+
+
+CBL_PUBLIC const FLSlice kCBLCounterType    = FLSTR("counter");
+CBL_PUBLIC const FLSlice kCBLORSetType      = FLSTR("orset");
+
+bool FLDict_IsCounter(FLDict dict) noexcept {
+    return ConflictFree::isCounter(dict);
+}
+
+uint64_t FLDict_GetCounterValue(FLDict dict) noexcept {
+    return ConflictFree::counterValue(dict);
+}
+
+bool FLMutableDict_IncrementCounter(FLMutableDict dict,
+                                    FLString key,
+                                    const CBLDatabase* db,
+                                    uint64_t amount,
+                                    CBLError* outError) noexcept
+{
+    try {
+        ConflictFree::incrementCounter(dict, key, db, amount);
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool FLDict_IsORSet(FLDict dict) noexcept {
+    return ConflictFree::isORSet(dict);
+}
+
+bool FLDict_ORSetContains(FLDict set, FLString member) noexcept {
+    return ConflictFree::setContains(set, member);
+}
+
+FLMutableArray FLDict_GetORSetMembers(FLDict set) noexcept {
+    return FLMutableArray_Retain(ConflictFree::setMembers(set));
+}
+
+bool FLMutableDict_AddToORSet(FLMutableDict dict,
+                              FLString key,
+                              const CBLDatabase* db,
+                              FLString member,
+                              CBLError* outError) noexcept
+{
+    try {
+        ConflictFree::addToSet(dict, key, db, member);
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool FLMutableDict_RemoveFromORSet(FLMutableDict dict,
+                                   FLString key,
+                                   FLString member,
+                                   CBLError* outError) noexcept
+{
+    try {
+        ConflictFree::removeFromSet(dict, key, member);
+        return true;
+    } catchAndBridge(outError)
+}
@@ -19,11 +19,14 @@
 #pragma once
 #include "CBLDocument.h"
 #include "Internal.hh"
+#include "MemoryStats.hh"
+#include "ObjectPool.hh"
 #include "c4Document.hh"
 #include "access_lock.hh"
 #include "fleece/Expert.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <atomic>
 #include <climits>
 #include <sstream>
 #include <unordered_map>
@@ -37,7 +40,7 @@ struct CBLNewBlob;
 struct CBLEncryptable;
 #endif
 
-struct CBLDocument final : public CBLRefCounted {
+struct CBLDocument final : public CBLRefCounted, public cbl_internal::Pooled<CBLDocument> {
 public:
     // Construct a new document (not in any database yet)
     CBLDocument(slice docID, bool isMutable)
@@ -121,17 +124,20 @@ public:
 
 
     Dict properties() const {
-        //TODO: Convert this to use C4Document::getProperties()
+        // Fast path: an immutable document's properties don't change once loaded, so after
+        // the first access they're returned without taking the lock.
+        if (!_mutable) {
+            if (FLDict props = _immutableProperties.load(std::memory_order_acquire))
+                return props;
+        }
+        
         auto c4doc = _c4doc.useLocked();
         if (!_properties) {
-            slice storage;
             if (_fromJSON)
-                storage = _fromJSON.data();
+                _properties = _fromJSON.root();
             else if (c4doc)
-                storage = c4doc->getRevisionBody();
-
-            if (storage)
-                _properties = ValueFromData(storage);
+                _properties = Dict(c4doc->getProperties());   // LiteCore's already-parsed root
+            
             if (_mutable) {
                 if (_properties)
                     _properties = _properties.asDict().mutableCopy();
@@ -142,7 +148,11 @@ public:
                     _properties = Dict::emptyDict();
             }
         }
-        return _properties.asDict();
+        
+        Dict props = _properties.asDict();
+        if (!_mutable)
+            _immutableProperties.store(props, std::memory_order_release);
+        return props;
     }
 
 
@@ -190,6 +200,9 @@ public:
     static void unregisterNewBlob(CBLNewBlob* blob);
 
     static CBLNewBlob* _cbl_nullable findNewBlob(FLDict dict);
+
+    // True if any new blob has been created but not yet installed by a save.
+    static bool hasNewBlobs();
     
     
 #ifdef COUCHBASE_ENTERPRISE
@@ -219,6 +232,17 @@ public:
     
     bool save(CBLCollection* collection, const SaveOptions &opt);
     
+    // Saves a batch of documents in a single transaction, locking the collection only once.
+    // If outResults is non-null, the outcome of each document is written to the corresponding
+    // entry (zero error code on success), and documents that fail are skipped without affecting
+    // the others. Otherwise the batch is all-or-nothing and the first failure is thrown.
+    // Returns the number of documents saved.
+    static size_t saveDocuments(CBLCollection* collection,
+                                CBLDocument* const docs[_cbl_nonnull],
+                                size_t count,
+                                CBLConcurrencyControl concurrency,
+                                CBLError* _cbl_nullable outResults);
+    
 
 #pragma mark - Conflict resolution:
 
@@ -229,8 +253,7 @@ public:
         if (!c4doc || !c4doc->selectRevision(revID, true))
             return false;
         _revID = revID;
-        _properties = nullptr;
-        _fromJSON = nullptr;
+        clearProperties();
         return true;
     }
 
@@ -240,8 +263,7 @@ public:
         auto c4doc = _c4doc.useLocked();
         if (!c4doc)
             return false;
-        _properties = nullptr;
-        _fromJSON = nullptr;
+        clearProperties();
         while (c4doc->selectNextLeafRevision(true, true))
             if (c4doc->selectedRev().flags & kRevIsConflict) {
                 _revID = c4doc->selectedRev().revID;
@@ -287,6 +309,20 @@ private:
     
     virtual ~CBLDocument();
 
+    // Forgets the cached properties, so they'll be reloaded from the selected revision.
+    // Must be called with the _c4doc lock held.
+    void clearProperties() {
+        _properties = nullptr;
+        _fromJSON = nullptr;
+        _immutableProperties.store(nullptr, std::memory_order_release);
+    }
+
+    // Updates the memory accounted to me, when my revision changes. Only the revision body is
+    // counted: mutable properties change without my knowing, so they'd cost a walk to measure.
+    void accountMemory(C4Document* _cbl_nullable c4doc) {
+        _memory.setBytes(sizeof(CBLDocument) + (c4doc ? c4doc->getRevisionBody().size : 0));
+    }
+
     void checkMutable() const {
         if (!_usuallyTrue(_mutable))
             C4Error::raise(LiteCoreDomain, kC4ErrorNotWriteable, "Document object is immutable");
@@ -314,15 +350,29 @@ private:
     //
     // The outRevFlags will be updated with kRevHasAttachments if there is a blob found while
     // encoding the document body.
+    //
+    // If the document was loaded from a revision at least kMinDeltaBaseSize bytes long, only
+    // the changes are encoded, as a Fleece delta appended to the revision's body. A body
+    // that deltas have grown past about twice its live data is re-encoded whole.
     alloc_slice encodeBody(CBLDatabase* db,
                            C4Database* c4db,
                            bool releaseNewBlob,
                            C4RevisionFlags &outRevFlags) const;
 
+    // Writes the current properties (or a tombstone if deleting) as a new revision on top of
+    // the parent revision, or as a new document if the parent is null. Must be called inside
+    // a transaction with the collection locked. Returns null if there was a conflict.
+    Retained<C4Document> putRevision(C4Collection* c4col,
+                                     CBLDatabase* db,
+                                     C4Document* _cbl_nullable parent,
+                                     bool deleting) const;
+
+    static constexpr size_t kMinDeltaBaseSize = 8 * 1024;
+
     // Custom object cache:
-    using ValueToBlobMap = std::unordered_map<FLDict, Retained<CBLBlob>>;
+    using ValueToBlobMap = cbl_internal::LazyValueMap<CBLBlob>;
 #ifdef COUCHBASE_ENTERPRISE
-    using ValueToEncryptableMap = std::unordered_map<FLDict, Retained<CBLEncryptable>>;
+    using ValueToEncryptableMap = cbl_internal::LazyValueMap<CBLEncryptable>;
 #endif
 
     Retained<CBLCollection>       _collection;      // Collection (null for new doc)
@@ -331,11 +381,13 @@ private:
     mutable alloc_slice           _revID;           // Revision ID
     fleece::Doc                   _fromJSON;        // Properties read from JSON
     mutable fleece::RetainedValue _properties;      // Properties, initialized lazily
+    mutable std::atomic<FLDict>   _immutableProperties {nullptr}; // Lock-free copy, if immutable
     ValueToBlobMap                _blobs;           // Maps Dicts in _properties to CBLBlobs
 #ifdef COUCHBASE_ENTERPRISE
     ValueToEncryptableMap         _encryptables;    // Maps Dicts in _properties to CBLEncryptables
 #endif
     bool const                    _mutable {false}; // True iff I am mutable
+    cbl_internal::MemoryAccount   _memory {cbl_internal::MemoryCategory::kDocuments, this, sizeof(CBLDocument)};
 };
 
 CBL_ASSUME_NONNULL_END
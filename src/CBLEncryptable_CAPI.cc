@@ -81,6 +81,34 @@ const CBLEncryptable* FLDict_GetEncryptableValue(FLDict _cbl_nullable dict) noex
     return CBLEncryptable::getEncryptableValue(dict);
 }
 
+FLValue FLDict_GetEncryptableContent(FLDict _cbl_nullable dict) noexcept {
+    return CBLEncryptable::valueOf(dict);
+}
+
+void FLSlot_SetEncryptableNull(FLSlot slot) noexcept {
+    CBLEncryptable::setInSlot(slot, [](FLSlot s) {FLSlot_SetNull(s);});
+}
+
+void FLSlot_SetEncryptableBool(FLSlot slot, bool value) noexcept {
+    CBLEncryptable::setInSlot(slot, [=](FLSlot s) {FLSlot_SetBool(s, value);});
+}
+
+void FLSlot_SetEncryptableInt(FLSlot slot, int64_t value) noexcept {
+    CBLEncryptable::setInSlot(slot, [=](FLSlot s) {FLSlot_SetInt(s, value);});
+}
+
+void FLSlot_SetEncryptableUInt(FLSlot slot, uint64_t value) noexcept {
+    CBLEncryptable::setInSlot(slot, [=](FLSlot s) {FLSlot_SetUInt(s, value);});
+}
+
+void FLSlot_SetEncryptableDouble(FLSlot slot, double value) noexcept {
+    CBLEncryptable::setInSlot(slot, [=](FLSlot s) {FLSlot_SetDouble(s, value);});
+}
+
+void FLSlot_SetEncryptableString(FLSlot slot, FLString value) noexcept {
+    CBLEncryptable::setInSlot(slot, [=](FLSlot s) {FLSlot_SetString(s, value);});
+}
+
 void FLSlot_SetEncryptableValue(FLSlot slot, const CBLEncryptable* encryptable) noexcept {
     Dict props = encryptable->properties();
     MutableDict mProps = props.asMutable();
@@ -45,6 +45,20 @@ public:
         return cbltype && slice(FLValue_AsString(cbltype)) == C4Document::kObjectType_Encryptable;
     }
     
+    /** The value of an encryptable dict, read in place without a CBLEncryptable. */
+    static FLValue _cbl_nullable valueOf(FLDict _cbl_nullable dict) {
+        return isEncryptableValue(dict) ? FLDict_Get(dict, kCBLEncryptableValueProperty) : nullptr;
+    }
+    
+    /** Puts a new encryptable dict into a slot, calling `setValue` to set its value, without
+        creating a CBLEncryptable. */
+    template <class FN>
+    static void setInSlot(FLSlot slot, FN setValue) {
+        MutableDict dict = createDict();
+        setValue(FLMutableDict_Set(dict, kCBLEncryptableValueProperty));
+        FLSlot_SetDict(slot, dict);
+    }
+    
     static CBLEncryptable* _cbl_nullable getEncryptableValue(Dict dict) {
         if (!isEncryptableValue(dict))
             return nullptr;
@@ -116,8 +130,8 @@ public:
     }
 
 private:
-    static FLMutableDict createDict() {
-        auto dict = FLMutableDict_New();
+    static MutableDict createDict() {
+        auto dict = MutableDict::newDict();
         FLSlot_SetString(FLMutableDict_Set(dict, kCBLTypeProperty), kCBLEncryptableType);
         return dict;
     }
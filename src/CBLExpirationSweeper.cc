@@ -0,0 +1,205 @@
+//
+// CBLExpirationSweeper.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLExpirationSweeper_Internal.hh"
+#include "Listener.hh"
+#include "TaskPool.hh"
+#include "fleece/Fleece.hh"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+using namespace fleece;
+using namespace cbl_internal;
+
+static constexpr size_t       kDefaultChunkSize    = 100;
+static constexpr uint32_t     kDefaultScanInterval = 60 * 1000;
+static constexpr int64_t      kMsPerMinute         = 60 * 1000;
+static constexpr int64_t      kMsPerDay            = 24 * 60 * kMsPerMinute;
+
+
+CBLExpirationSweeper::CBLExpirationSweeper(CBLCollection *collection,
+                                           const CBLExpirationSweeperOptions &options)
+:_collection(collection)
+,_msPerPurge(options.maxPurgesPerSecond ? 1000.0 / options.maxPurgesPerSecond : 0.0)
+,_chunkSize(options.chunkSize ? options.chunkSize : kDefaultChunkSize)
+,_windows(options.windows, options.windows + (options.windows ? options.windowCount : 0))
+,_scanInterval(options.scanIntervalMs ? options.scanIntervalMs : kDefaultScanInterval)
+{
+    for (auto &window : _windows) {
+        if (window.startMinute >= 1440 || window.endMinute > 1440)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Invalid time window");
+    }
+    string from = "`" + string(collection->scopeName()) + "`.`" + string(collection->name()) + "`";
+    string query = "SELECT META().id, META().expiration FROM " + from
+                 + " WHERE META().expiration > 0 AND META().expiration <= $until"
+                 + " ORDER BY META().expiration";
+    _query = collection->database()->compileQuery(kCBLN1QLLanguage, slice(query), nullptr);
+    if (!_query)
+        C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Can't query document expirations");
+}
+
+
+CBLExpirationSweeper::~CBLExpirationSweeper() {
+    stop();
+}
+
+
+void CBLExpirationSweeper::start() {
+    _schedule = make_shared<Schedule>();
+    _schedule->sweeper = this;
+    scheduleScan(_schedule, 0ms);
+}
+
+
+void CBLExpirationSweeper::stop() {
+    if (!_schedule)
+        return;
+    unique_lock<mutex> lock(_schedule->mutex);
+    _schedule->sweeper = nullptr;
+    _schedule->cond.wait(lock, [&] {return !_schedule->scanning;});
+}
+
+
+// Each scan is a task of its own, started by the shared listener timer; it schedules the next
+// when it's done. None is left waiting on a thread between scans.
+void CBLExpirationSweeper::scheduleScan(shared_ptr<Schedule> schedule, chrono::milliseconds delay) {
+    ListenerTimer::shared().schedule(ListenerTimer::Clock::now() + delay, [schedule] {
+        AsyncTasks::run(&runScan, new shared_ptr<Schedule>(schedule));
+    });
+}
+
+
+void CBLExpirationSweeper::runScan(void *context) {
+    shared_ptr<Schedule> schedule = std::move(*(shared_ptr<Schedule>*)context);
+    delete (shared_ptr<Schedule>*)context;
+
+    CBLExpirationSweeper* sweeper;
+    {
+        LOCK(schedule->mutex);
+        sweeper = schedule->sweeper;
+        if (!sweeper)
+            return;
+        schedule->scanning = true;      // `stop` waits for this, so `sweeper` stays valid
+    }
+    try {
+        sweeper->scan();
+    } catch (...) {
+        BridgeException(__FUNCTION__, nullptr);
+    }
+    {
+        LOCK(schedule->mutex);
+        schedule->scanning = false;
+        if (schedule->sweeper)
+            scheduleScan(schedule, sweeper->_scanInterval);
+    }
+    schedule->cond.notify_all();
+}
+
+
+CBLTimestamp CBLExpirationSweeper::nextAllowedTime(CBLTimestamp t) const {
+    if (_windows.empty())
+        return t;
+    int64_t today = t - (t % kMsPerDay);
+    CBLTimestamp best = LLONG_MAX;
+    // Yesterday's windows may run past midnight into today:
+    for (int64_t day = today - kMsPerDay; day <= today + kMsPerDay; day += kMsPerDay) {
+        for (auto &window : _windows) {
+            int64_t start = day + window.startMinute * kMsPerMinute;
+            int64_t end = day + window.endMinute * kMsPerMinute;
+            if (window.endMinute <= window.startMinute)
+                end += kMsPerDay;
+            if (t >= start && t < end)
+                return t;
+            if (start > t)
+                best = std::min(best, CBLTimestamp(start));
+        }
+    }
+    return best;
+}
+
+
+void CBLExpirationSweeper::scan() {
+    LOCK(_scanMutex);
+    auto now = static_cast<CBLTimestamp>(c4_now());
+    CBLTimestamp until = std::max(now + 2 * CBLTimestamp(_scanInterval.count()), _lastPurge);
+
+    Encoder enc;
+    enc.beginDict();
+    enc.writeKey("until"_sl);
+    enc.writeInt(until);
+    enc.endDict();
+    alloc_slice params = enc.finish();
+
+    vector<alloc_slice> docIDs;
+    vector<CBLTimestamp> expirations;
+    {
+        auto e = _collection->useLocked<C4Query::Enumerator>([&](C4Collection*) {
+            return _query->run(params);
+        });
+        while (e.next()) {
+            docIDs.emplace_back(e.column(0).asString());
+            expirations.push_back(e.column(1).asInt());
+        }
+    }
+
+    // Give the documents purge times, in expiration order. A chunk's documents are purged
+    // together, and the next chunk waits until the rate allows it:
+    vector<FLString> changedIDs;
+    vector<CBLTimestamp> purgeTimes;
+    CBLTimestamp chunkTime = 0, firstPurge = 0, lastPurge = 0;
+    size_t inChunk = 0;
+    for (size_t i = 0; i < docIDs.size(); ++i) {
+        CBLTimestamp expiration = expirations[i];
+        if (inChunk > 0 && inChunk < _chunkSize && nextAllowedTime(expiration) <= chunkTime) {
+            ++inChunk;
+        } else {
+            auto due = CBLTimestamp(std::ceil(double(chunkTime) + double(inChunk) * _msPerPurge));
+            chunkTime = nextAllowedTime(std::max({expiration, due, now}));
+            inChunk = 1;
+        }
+        if (i == 0)
+            firstPurge = chunkTime;
+        lastPurge = chunkTime;
+        if (chunkTime > std::max(expiration, now)) {
+            changedIDs.push_back(docIDs[i]);
+            purgeTimes.push_back(chunkTime);
+        }
+    }
+
+    size_t updated = 0;
+    if (!changedIDs.empty()) {
+        _collection->setDocumentExpirations(changedIDs.data(), purgeTimes.data(), changedIDs.size(),
+                                            0, nullptr, nullptr, updated);
+    }
+    _lastPurge = lastPurge;
+
+    unique_lock<mutex> lock(_mutex);
+    _backlog.lastScan = now;
+    _backlog.pendingDocuments = docIDs.size();
+    _backlog.deferredDocuments = changedIDs.size();
+    _backlog.nextPurge = firstPurge;
+    _backlog.backlogClearedAt = lastPurge;
+}
+
+
+CBLExpirationBacklog CBLExpirationSweeper::backlog() const {
+    LOCK(_mutex);
+    return _backlog;
+}
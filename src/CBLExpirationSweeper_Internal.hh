@@ -0,0 +1,80 @@
+//
+// CBLExpirationSweeper_Internal.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLCollection_Internal.hh"
+#include "c4Query.hh"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+/** Spreads out LiteCore's purging of expired documents, as described by
+    \ref CBLCollection_StartExpirationSweeper: each scan gives the documents due to expire
+    before the next scan a purge time, in chunks spaced to keep to the maximum rate and inside
+    the allowed windows, and sets it as their expiration time. */
+struct CBLExpirationSweeper final : public CBLRefCounted {
+public:
+    CBLExpirationSweeper(CBLCollection *collection, const CBLExpirationSweeperOptions &options);
+    ~CBLExpirationSweeper();
+
+    /** Starts scanning periodically, as background tasks. */
+    void start();
+
+    /** Stops scanning, waiting for a scan in progress to finish. */
+    void stop();
+
+    /** Schedules the documents due to expire before the next scan. */
+    void scan();
+
+    CBLExpirationBacklog backlog() const;
+
+private:
+    // The earliest time at or after `t` that's in an allowed window:
+    CBLTimestamp nextAllowedTime(CBLTimestamp t) const;
+
+    // The scheduling state, shared with the timer and the tasks, which may outlive me:
+    struct Schedule {
+        std::mutex                          mutex;
+        std::condition_variable             cond;
+        CBLExpirationSweeper* _cbl_nullable sweeper;    // Null once stopped
+        bool                                scanning {false};
+    };
+
+    static void scheduleScan(std::shared_ptr<Schedule>, std::chrono::milliseconds delay);
+    static void runScan(void *context);
+
+    Retained<CBLCollection> const       _collection;
+    double const                        _msPerPurge;            // 0 if there's no maximum rate
+    size_t const                        _chunkSize;
+    std::vector<CBLTimeWindow> const    _windows;
+    std::chrono::milliseconds const     _scanInterval;
+    Retained<C4Query>                   _query;
+
+    std::mutex                          _scanMutex;             // One scan at a time
+    CBLTimestamp                        _lastPurge {0};         // Latest purge time scheduled
+
+    mutable std::mutex                  _mutex;
+    CBLExpirationBacklog                _backlog {};
+    std::shared_ptr<Schedule>           _schedule;
+};
+
+CBL_ASSUME_NONNULL_END
@@ -21,14 +21,23 @@
 #include "CBLPrivate.h"
 #include "c4Base.hh"
 #include "Internal.hh"
+#include "Trace.hh"
 #include "fleece/slice.hh"
 #include "betterassert.hh"
 #include "LogDecoder.hh"
+#include "LogQueue.hh"
+#include "LogThrottle.hh"
 #include "ParseDate.hh"
 #include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <mutex>
+#include <string>
+#include <thread>
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -37,6 +46,7 @@
 using namespace std;
 using namespace fleece;
 using namespace litecore;
+using namespace cbl_internal;
 
 static const C4LogDomain kC4Domains[] = { kC4DatabaseLog, kC4QueryLog, kC4SyncLog, kC4WebSocketLog };
 
@@ -47,11 +57,30 @@ static atomic<CBLLogLevel> sConsoleLogLevel = kCBLLogWarning;
 static atomic<CBLLogCallback> sCustomCallback = nullptr;
 static atomic<CBLLogLevel> sCustomLogLevel = kCBLLogWarning;
 
+static atomic<CBLStructuredLogCallback> sStructuredCallback = nullptr;
+
+static LogThrottle sThrottle;
+
+// The async queue is used by logging threads without a lock. So that a replaced queue can be
+// deleted once no thread is using it, users count themselves in one of two counters, chosen
+// by the parity of sAsyncEpoch, while they read and use the queue; CBLLog_SetAsync advances the
+// epoch after replacing the queue, then waits for the old epoch's counter to drop to zero.
+static atomic<LogQueue*> sAsyncQueue = nullptr;
+static atomic<unsigned> sAsyncEpoch = 0;
+static atomic<unsigned> sAsyncUsers[2] = {};
+static mutex sAsyncMutex;
+
 static CBLLogFileConfiguration sLogFileConfig;
 static alloc_slice sLogFileDir;
 
 static void c4LogCallback(C4LogDomain domain, C4LogLevel level, const char *fmt, va_list args);
 
+static void c4LogFormatCallback(C4LogDomain domain, C4LogLevel level, const char *fmt, va_list args);
+
+static void registerC4Callback();
+
+static bool wantsUnformatted();
+
 static C4LogLevel effectiveC4CallbackLogLevel();
 
 static void updateC4CallbackLogLevel();
@@ -81,7 +110,7 @@ void CBLLog_Init() {
         }
         
         // Register log callback:
-        c4log_writeToCallback(effectiveC4CallbackLogLevel(), &c4LogCallback, true /*preformatted*/);
+        registerC4Callback();
     });
 }
 
@@ -122,8 +151,87 @@ void CBLLog_SetCallback(CBLLogCallback callback) CBLAPI {
 }
 
 
+CBLStructuredLogCallback CBLLog_StructuredCallback() CBLAPI {
+    return sStructuredCallback;
+}
+
+
+void CBLLog_SetStructuredCallback(CBLStructuredLogCallback callback) CBLAPI {
+    CBLLog_Init();
+    bool wasUnformatted = wantsUnformatted();
+    sStructuredCallback = callback;
+    if (wantsUnformatted() != wasUnformatted)
+        registerC4Callback();
+    else
+        updateC4CallbackLogLevel();
+}
+
+
+// LiteCore formats messages for a preformatted callback, so the unformatted one is only
+// registered while there's a structured callback to pass the format and arguments to, or a
+// throttle to apply before formatting:
+static bool wantsUnformatted() {
+    return sStructuredCallback != nullptr || sThrottle.active();
+}
+
+
+static void registerC4Callback() {
+    if (wantsUnformatted())
+        c4log_writeToCallback(effectiveC4CallbackLogLevel(), &c4LogFormatCallback, false);
+    else
+        c4log_writeToCallback(effectiveC4CallbackLogLevel(), &c4LogCallback, true /*preformatted*/);
+}
+
+
+static C4LogDomain findC4Domain(FLString name) {
+    if (!name.buf)
+        return nullptr;
+    return c4log_getDomain(string(slice(name)).c_str(), false);
+}
+
+
+CBLLogLevel CBLLog_DomainLevel(FLString domainName) CBLAPI {
+    CBLLog_Init();
+    C4LogDomain domain = findC4Domain(domainName);
+    return domain ? CBLLogLevel(c4log_getLevel(domain)) : kCBLLogNone;
+}
+
+
+bool CBLLog_SetDomainLevel(FLString domainName, CBLLogLevel level) CBLAPI {
+    CBLLog_Init();
+    C4LogDomain domain = findC4Domain(domainName);
+    if (!domain)
+        return false;
+    c4log_setLevel(domain, C4LogLevel(level));
+    return true;
+}
+
+
+bool CBLLog_SetDomainThrottle(FLString domainName, CBLLogThrottle throttle,
+                              CBLError* outError) CBLAPI
+{
+    CBLLog_Init();
+    try {
+        C4LogDomain domain = findC4Domain(domainName);
+        if (!domain)
+            C4Error::raise(LiteCoreDomain, kC4ErrorNotFound, "No such log domain");
+        bool wasUnformatted = wantsUnformatted();
+        sThrottle.set(domain, throttle);
+        if (wantsUnformatted() != wasUnformatted)
+            registerC4Callback();
+        return true;
+    } catchAndBridge(outError)
+}
+
+
+uint64_t CBLLog_ThrottledMessageCount() CBLAPI {
+    return sThrottle.throttled();
+}
+
+
 static C4LogLevel effectiveC4CallbackLogLevel() {
-    CBLLogLevel customLogLevel = sCustomCallback != nullptr ? sCustomLogLevel.load() : kCBLLogNone;
+    bool hasCallback = sCustomCallback != nullptr || sStructuredCallback != nullptr;
+    CBLLogLevel customLogLevel = hasCallback ? sCustomLogLevel.load() : kCBLLogNone;
     return C4LogLevel(std::min(sConsoleLogLevel.load(), customLogLevel));
 }
 
@@ -135,41 +243,278 @@ static void updateC4CallbackLogLevel() {
 }
 
 
+static void writeToConsole(C4LogDomain domain, C4LogLevel level,
+                           const LogDecoder::Timestamp &timestamp, const char *msg)
+{
+    auto domainName = c4log_getDomainName(domain);
+#ifdef __ANDROID__
+    string tag("CouchbaseLite");
+    string domainStr(domainName);
+    if (!domainStr.empty())
+        tag += " [" + domainStr + "]";
+    static const int androidLevels[5] = {ANDROID_LOG_DEBUG, ANDROID_LOG_INFO,
+                                         ANDROID_LOG_INFO, ANDROID_LOG_WARN,
+                                         ANDROID_LOG_ERROR};
+    __android_log_write(androidLevels[(int) level], tag.c_str(), msg);
+#else
+    auto levelName = kLogLevelNames[(int)level];
+    ostream& os = CBLLogLevel(level) < kCBLLogWarning ? cout : cerr;
+    LogDecoder::writeTimestamp(timestamp, os);
+    LogDecoder::writeHeader(levelName, domainName, os);
+    os << msg << '\n';
+#endif
+}
+
+
+// Called on the async queue's thread.
+static void deliverQueuedMessage(const LogQueue::Message &message) {
+    if (message.toConsole)
+        writeToConsole(message.domain, message.level, message.timestamp, message.text.c_str());
+    CBLLogCallback callback = sCustomCallback;
+    if (message.toCallback && callback)
+        callback(getCBLLogDomain(message.domain), CBLLogLevel(message.level), slice(message.text));
+}
+
+
+namespace {
+    // Keeps the async queue, if any, from being deleted while this is in scope.
+    class AsyncQueueRef {
+    public:
+        AsyncQueueRef()
+        :_users(sAsyncUsers[sAsyncEpoch.load() & 1])
+        {
+            ++_users;
+            _queue = sAsyncQueue.load();
+        }
+
+        ~AsyncQueueRef()                            {--_users;}
+
+        LogQueue* get() const                       {return _queue;}
+
+        AsyncQueueRef(const AsyncQueueRef&) =delete;
+        AsyncQueueRef& operator=(const AsyncQueueRef&) =delete;
+
+    private:
+        atomic<unsigned>&   _users;
+        LogQueue*           _queue;
+    };
+}
+
+
 static void c4LogCallback(C4LogDomain domain, C4LogLevel level, const char *msg, va_list args) {
     CBLLogLevel msgLevel = CBLLogLevel(level);
-    
-    // Log to console:
-    CBLLogLevel consoleLogLevel = sConsoleLogLevel;
-    if (msgLevel >= consoleLogLevel) {
-        auto domainName = c4log_getDomainName(domain);
-        auto levelName = kLogLevelNames[(int)level];
-    #ifdef __ANDROID__
-        string tag("CouchbaseLite");
-        string domainStr(domainName);
-        if (!domainStr.empty())
-            tag += " [" + domainStr + "]";
-        static const int androidLevels[5] = {ANDROID_LOG_DEBUG, ANDROID_LOG_INFO,
-                                             ANDROID_LOG_INFO, ANDROID_LOG_WARN,
-                                             ANDROID_LOG_ERROR};
-        __android_log_write(androidLevels[(int) level], tag.c_str(), msg);
-    #else
-        ostream& os = msgLevel < kCBLLogWarning ? cout : cerr;
-        LogDecoder::writeTimestamp(LogDecoder::now(), os);
-        LogDecoder::writeHeader(levelName, domainName, os);
-        os << msg << '\n';
-    #endif
-    }
-    
-    // Log to custom callback if available:
+    bool toConsole = msgLevel >= sConsoleLogLevel;
     CBLLogCallback callback = sCustomCallback;
-    if (!callback)
+    bool toCallback = callback && msgLevel >= sCustomLogLevel;
+    if (!toConsole && !toCallback)
         return;
     
-    CBLLogLevel customLogLevel = sCustomLogLevel;
-    if (msgLevel >= customLogLevel) {
-        // msg is preformatted
+    // msg is preformatted
+    if (AsyncQueueRef queue; queue.get()) {
+        queue.get()->push(domain, level, toConsole, toCallback, slice(msg));
+        return;
+    }
+    if (toConsole)
+        writeToConsole(domain, level, LogDecoder::now(), msg);
+    if (toCallback)
         callback(getCBLLogDomain(domain), msgLevel, slice(msg));
+}
+
+
+// Formats a message into `buffer` if it fits, else into `heap`. Returns nullptr on error.
+static const char* formatMessage(char *buffer, size_t bufferSize, string &heap,
+                                 const char *fmt, va_list args)
+{
+    va_list copy;
+    va_copy(copy, args);
+    int len = vsnprintf(buffer, bufferSize, fmt, copy);
+    va_end(copy);
+    if (len < 0)
+        return nullptr;
+    if (size_t(len) < bufferSize)
+        return buffer;
+    heap.resize(size_t(len));
+    va_copy(copy, args);
+    vsnprintf(&heap[0], heap.size() + 1, fmt, copy);
+    va_end(copy);
+    return heap.c_str();
+}
+
+
+// Reads the arguments of a printf-style format. Stops at a conversion it doesn't know, since
+// it can't tell how to skip its argument.
+static size_t readLogArgs(const char *fmt, va_list args, CBLLogArg outArgs[], size_t maxArgs) {
+    enum Length {kDefault, kLong, kLongLong, kSize, kMax, kPtrdiff, kLongDouble};
+    size_t n = 0;
+    for (const char *p = fmt; *p && n < maxArgs; ++p) {
+        if (*p != '%' || *++p == '%')
+            continue;
+        while (*p && strchr("-+ #0'", *p))
+            ++p;
+        if (*p == '*') {
+            (void)va_arg(args, int);
+            ++p;
+        } else {
+            while (isdigit((uint8_t)*p))
+                ++p;
+        }
+        int precision = -1;
+        if (*p == '.') {
+            ++p;
+            if (*p == '*') {
+                precision = va_arg(args, int);
+                ++p;
+            } else {
+                precision = 0;
+                while (isdigit((uint8_t)*p))
+                    precision = 10 * precision + (*p++ - '0');
+            }
+        }
+        Length length = kDefault;
+        switch (*p) {
+            case 'h':   while (*p == 'h') ++p; break;
+            case 'l':   ++p; length = kLong; if (*p == 'l') {++p; length = kLongLong;} break;
+            case 'q':   ++p; length = kLongLong; break;
+            case 'z':   ++p; length = kSize; break;
+            case 'j':   ++p; length = kMax; break;
+            case 't':   ++p; length = kPtrdiff; break;
+            case 'L':   ++p; length = kLongDouble; break;
+        }
+
+        CBLLogArg &arg = outArgs[n];
+        arg = {};
+        switch (*p) {
+            case 'd': case 'i':
+                arg.type = kCBLLogArgInt;
+                switch (length) {
+                    case kLong:     arg.intValue = va_arg(args, long); break;
+                    case kLongLong: arg.intValue = va_arg(args, long long); break;
+                    case kSize:     arg.intValue = int64_t(va_arg(args, size_t)); break;
+                    case kMax:      arg.intValue = va_arg(args, intmax_t); break;
+                    case kPtrdiff:  arg.intValue = va_arg(args, ptrdiff_t); break;
+                    default:        arg.intValue = va_arg(args, int); break;
+                }
+                break;
+            case 'u': case 'o': case 'x': case 'X':
+                arg.type = kCBLLogArgUInt;
+                switch (length) {
+                    case kLong:     arg.uintValue = va_arg(args, unsigned long); break;
+                    case kLongLong: arg.uintValue = va_arg(args, unsigned long long); break;
+                    case kSize:     arg.uintValue = va_arg(args, size_t); break;
+                    case kMax:      arg.uintValue = va_arg(args, uintmax_t); break;
+                    case kPtrdiff:  arg.uintValue = uint64_t(va_arg(args, ptrdiff_t)); break;
+                    default:        arg.uintValue = va_arg(args, unsigned); break;
+                }
+                break;
+            case 'c':
+                arg.type = kCBLLogArgInt;
+                arg.intValue = va_arg(args, int);
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                arg.type = kCBLLogArgDouble;
+                if (length == kLongDouble)
+                    arg.doubleValue = double(va_arg(args, long double));
+                else
+                    arg.doubleValue = va_arg(args, double);
+                break;
+            case 's': {
+                arg.type = kCBLLogArgString;
+                const char *str = va_arg(args, const char*);
+                if (str) {
+                    size_t size = (precision >= 0) ? strnlen(str, size_t(precision)) : strlen(str);
+                    arg.stringValue = {str, size};
+                }
+                break;
+            }
+            case 'p':
+                arg.type = kCBLLogArgPointer;
+                arg.uintValue = uintptr_t(va_arg(args, void*));
+                break;
+            default:
+                return n;
+        }
+        ++n;
+    }
+    return n;
+}
+
+
+static void callStructuredCallback(CBLStructuredLogCallback callback, C4LogDomain domain,
+                                   C4LogLevel level, const char *fmt, va_list args)
+{
+    static constexpr size_t kMaxArgs = 32;
+    CBLLogRecord record = {};
+    record.domain = getCBLLogDomain(domain);
+    record.domainName = slice(c4log_getDomainName(domain));
+    record.level = CBLLogLevel(level);
+    record.timestamp = uint64_t(chrono::duration_cast<chrono::nanoseconds>(
+                                    chrono::steady_clock::now().time_since_epoch()).count());
+    // A leading "{...}" identifies the object that logged the message:
+    slice format(fmt);
+    if (format.hasPrefix("{"_sl)) {
+        if (const void *end = format.findByte('}')) {
+            record.objectID = slice(format.offset(1), end);
+            format.setStart(offsetby(end, 1));
+            if (format.hasPrefix(" "_sl))
+                format.moveStart(1);
+        }
     }
+    record.format = format;
+    CBLLogArg logArgs[kMaxArgs];
+    va_list copy;
+    va_copy(copy, args);
+    record.argCount = readLogArgs(fmt, copy, logArgs, kMaxArgs);
+    va_end(copy);
+    record.args = logArgs;
+    callback(&record);
+}
+
+
+static void c4LogFormatCallback(C4LogDomain domain, C4LogLevel level, const char *fmt, va_list args) {
+    if (!sThrottle.allow(domain, level, fmt))
+        return;
+    CBLLogLevel msgLevel = CBLLogLevel(level);
+    CBLStructuredLogCallback structured = sStructuredCallback;
+    if (structured && msgLevel >= sCustomLogLevel)
+        callStructuredCallback(structured, domain, level, fmt, args);
+
+    // Only format the message if the console or the plain callback wants it:
+    if (msgLevel < sConsoleLogLevel && !(sCustomCallback && msgLevel >= sCustomLogLevel))
+        return;
+    char buffer[512];
+    string heap;
+    if (const char *message = formatMessage(buffer, sizeof(buffer), heap, fmt, args))
+        c4LogCallback(domain, level, message, args);
+}
+
+
+void CBLLog_SetAsync(const CBLLogAsyncOptions *options) CBLAPI {
+    CBLLog_Init();
+    LOCK(sAsyncMutex);
+    LogQueue *queue = options ? new LogQueue(*options, &deliverQueuedMessage) : nullptr;
+    LogQueue *old = sAsyncQueue.exchange(queue);
+    if (!old)
+        return;
+    // Stopping it delivers its messages and wakes any thread waiting for room in it:
+    old->stop();
+    unsigned epoch = sAsyncEpoch.fetch_add(1);
+    while (sAsyncUsers[epoch & 1].load() > 0)
+        this_thread::yield();
+    // (If this is called by the log callback, the old queue's thread is the one running it.)
+    if (!old->onQueueThread())
+        delete old;
+}
+
+
+void CBLLog_Flush() CBLAPI {
+    if (AsyncQueueRef queue; queue.get())
+        queue.get()->flush();
+}
+
+
+uint64_t CBLLog_DroppedMessageCount() CBLAPI {
+    AsyncQueueRef queue;
+    return queue.get() ? queue.get()->dropped() : 0;
 }
 
 
@@ -188,13 +533,23 @@ static CBLLogDomain getCBLLogDomain(C4LogDomain domain) {
 void CBL_Log(CBLLogDomain domain, CBLLogLevel level, const char *format, ...) CBLAPI {
     precondition((domain <= kCBLLogDomainNetwork));
     precondition((level <= kCBLLogNone));
-    char *message = nullptr;
+    C4LogDomain c4Domain = kC4Domains[domain];
+    if (!c4log_willLog(c4Domain, C4LogLevel(level)))
+        return;
+    
     va_list args;
     va_start(args, format);
-    vasprintf(&message, format, args);
+    if (wantsUnformatted()) {
+        // Pass the format and arguments through, for the structured callback or the throttle:
+        c4vlog(c4Domain, C4LogLevel(level), format, args);
+    } else {
+        // Most messages fit in a stack buffer; longer ones are formatted again into a string:
+        char buffer[256];
+        string heap;
+        if (const char *message = formatMessage(buffer, sizeof(buffer), heap, format, args))
+            C4LogToAt(c4Domain, C4LogLevel(level), "%s", message);
+    }
     va_end(args);
-    C4LogToAt(kC4Domains[domain], C4LogLevel(level), "%s", message);
-    free(message);
 }
 
 
@@ -237,6 +592,11 @@ bool CBLLog_SetFileConfig(CBLLogFileConfiguration config, CBLError *outError) CB
 }
 
 
+
+void CBL_SetTraceCallback(CBLTraceCallback callback, void* context) CBLAPI {
+    cbl_internal::TraceSpan::setCallback(callback, context);
+}
+
 extern "C" CBL_PUBLIC std::atomic_int gC4ExpectExceptions;
 
 /** Private API */
@@ -0,0 +1,41 @@
+//
+// CBLPlatform_CAPI.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLPlatform.h"
+#include "BackgroundMaintenance.hh"
+#include "Internal.hh"
+#include "TaskPool.hh"
+
+bool CBL_ConfigureThreadPool(const CBLThreadPoolConfiguration* config,
+                             CBLError* _cbl_nullable outError) noexcept
+{
+    try {
+        AsyncTasks::configure(*config);
+        return true;
+    } catchAndBridge(outError);
+}
+
+bool CBL_RunBackgroundMaintenance(uint32_t budgetMs) noexcept {
+    try {
+        return BackgroundMaintenance::run(std::chrono::milliseconds(budgetMs));
+    } catchAndWarn();
+}
+
+void CBL_CancelBackgroundMaintenance(void) noexcept {
+    BackgroundMaintenance::cancel();
+}
@@ -17,9 +17,17 @@
 //
 
 #include "CBLPrediction_Internal.hh"
+#include "CBLCollection_Internal.hh"
+#include "CBLQuery_Internal.hh"
 #include "c4PredictiveQuery.h"
 #include "fleece/Mutable.hh"
 #include "Defer.hh"
+#include "CBLLog.h"
+#include "TaskPool.hh"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 
 #ifdef COUCHBASE_ENTERPRISE
 
@@ -28,39 +36,273 @@ namespace cbl_internal {
     using namespace fleece;
     using namespace litecore;
 
+    static constexpr unsigned kDefaultBatchSize = 100;
+
+    // Memory counted for each cached output besides its input and output data:
+    static constexpr size_t kCacheEntryOverhead = 96;
+
+    // Calls that timed out and are still running, after which no more are started:
+    static constexpr unsigned kMaxAbandonedCalls = 2;
+
+    // Outputs of timed-out calls kept when there's no cache:
+    static constexpr size_t kMaxLateOutputs = 100;
+
+    // The registered models, by name, so that CBL_PrecomputePredictions can find them:
+    static mutex sModelsMutex;
+    static unordered_map<string, Retained<PredictiveModel>> sModels;
+
+
+    PredictiveModel::~PredictiveModel() {
+        if (_model.unregistered) {
+            _model.unregistered(_model.context);
+        }
+    }
+
+
+    alloc_slice PredictiveModel::encodeOutput(FLMutableDict dict) {
+        DEFER {
+            FLMutableDict_Release(dict);
+        };
+        
+        if (!dict) {
+            return nullslice;
+        }
+        
+        Encoder enc;
+        enc.writeValue(Dict(dict));
+        return enc.finish();
+    }
+
+
+    void PredictiveModel::predictBatch(const vector<FLDict>& inputs, vector<alloc_slice>& outputs) {
+        vector<FLMutableDict> dicts(inputs.size(), nullptr);
+        _model.batchPrediction(_model.context, inputs.data(), inputs.size(), dicts.data());
+        for (auto dict : dicts) {
+            outputs.push_back(encodeOutput(dict));
+        }
+    }
+
+
+    alloc_slice PredictiveModel::run(FLDict input) {
+        if (_model.prediction) {
+            return encodeOutput(_model.prediction(_model.context, input));
+        } else if (_model.batchPrediction) {
+            vector<alloc_slice> outputs;
+            predictBatch({input}, outputs);
+            return outputs[0];
+        }
+        return nullslice;
+    }
+
+
+    // A call of the model on a background thread, which callers wait for up to the timeout:
+    struct PredictiveModel::Call {
+        Retained<PredictiveModel>   model;
+        Doc                         input;          // A copy: the caller's input is only valid during its call
+        string                      key;
+        std::mutex                  doneMutex;
+        condition_variable          doneCond;
+        alloc_slice                 output;
+        bool                        done {false}, abandoned {false};
+    };
+
+
+    // Runs the model on a background thread, and waits for it for up to the model's timeout.
+    // If it takes longer, its output is kept for the next time the same input is predicted.
+    // A call still running for the same input is waited for instead of starting another, and
+    // once kMaxAbandonedCalls calls have timed out and are still running, no more are started,
+    // so that a stuck model can't take over the task pool's threads.
+    bool PredictiveModel::runWithTimeout(FLDict input, const string &key, alloc_slice &outOutput) {
+        shared_ptr<Call> call;
+        bool start = false;
+        {
+            lock_guard<std::mutex> lock(_mutex);
+            if (auto i = _calls.find(key); i != _calls.end()) {
+                call = i->second;
+            } else if (_abandonedCalls >= kMaxAbandonedCalls) {
+                CBL_Log(kCBLLogDomainQuery, kCBLLogWarning,
+                        "Predictive model has %u calls still running after timing out; "
+                        "the prediction has no output", _abandonedCalls);
+                return false;
+            } else {
+                Encoder enc;
+                enc.writeValue(Dict(input));
+                call = make_shared<Call>();
+                call->model = this;
+                call->input = Doc(enc.finish());
+                call->key = key;
+                _calls.emplace(key, call);
+                start = true;
+            }
+        }
+        
+        if (start) {
+            AsyncTasks::run([](void *context) {
+                auto callPtr = (shared_ptr<Call>*)context;
+                auto call = std::move(*callPtr);
+                delete callPtr;
+                
+                alloc_slice output = call->model->run(call->input.asDict());
+                bool abandoned;
+                {
+                    unique_lock<std::mutex> lock(call->doneMutex);
+                    call->output = output;
+                    call->done = true;
+                    abandoned = call->abandoned;
+                }
+                call->doneCond.notify_all();
+                
+                auto &m = *call->model;
+                lock_guard<std::mutex> lock(m._mutex);
+                m._calls.erase(call->key);
+                if (abandoned) {
+                    --m._abandonedCalls;
+                    m.keepLateOutput(std::move(call->key), std::move(output));
+                }
+            }, new shared_ptr<Call>(call));
+        }
+        
+        unique_lock<std::mutex> lock(call->doneMutex);
+        if (!call->doneCond.wait_for(lock, chrono::milliseconds(_model.timeout), [&] {return call->done;})) {
+            if (!call->abandoned) {
+                call->abandoned = true;
+                lock_guard<std::mutex> modelLock(_mutex);
+                ++_abandonedCalls;
+            }
+            CBL_Log(kCBLLogDomainQuery, kCBLLogWarning,
+                    "Predictive model timed out after %u ms; the prediction has no output", _model.timeout);
+            return false;
+        }
+        outOutput = call->output;
+        return true;
+    }
+
+
+    // Keeps the output of a call that timed out, for the next prediction of its input: in the
+    // cache if there is one, else with the last kMaxLateOutputs others. Must be called with
+    // _mutex locked.
+    void PredictiveModel::keepLateOutput(string key, alloc_slice output) {
+        if (_model.cacheSize > 0) {
+            addToCache(std::move(key), std::move(output));
+            return;
+        }
+        if (_lateOutputs.count(key) == 0)
+            _lateOutputOrder.push_back(key);
+        _lateOutputs[std::move(key)] = std::move(output);
+        while (_lateOutputOrder.size() > kMaxLateOutputs) {
+            _lateOutputs.erase(_lateOutputOrder.front());
+            _lateOutputOrder.pop_front();
+        }
+    }
+
+
+    // The timeout only applies to queries: a prediction made to update an index waits for the
+    // model, since an index entry without the output would stay missing until the document
+    // changed again.
+    alloc_slice PredictiveModel::predict(FLDict input) {
+        bool timed = _model.timeout > 0 && CBLQuery::isExecuting();
+        string key;
+        {
+            lock_guard<mutex> lock(_mutex);
+            if (!_outputs.empty() || !_lateOutputs.empty() || _model.cacheSize > 0 || timed) {
+                key = string(alloc_slice(FLValue_ToJSONX((FLValue)input, false, true)));
+                if (auto i = _outputs.find(key); i != _outputs.end())
+                    return i->second;           // Kept until replaced or cleared
+                if (auto i = _lateOutputs.find(key); i != _lateOutputs.end()) {
+                    alloc_slice output = std::move(i->second);
+                    _lateOutputs.erase(i);
+                    _lateOutputOrder.erase(find(_lateOutputOrder.begin(), _lateOutputOrder.end(), key));
+                    return output;
+                }
+                if (auto i = _cacheIndex.find(key); i != _cacheIndex.end()) {
+                    _cache.splice(_cache.begin(), _cache, i->second);
+                    return i->second->second;
+                }
+            }
+        }
+        
+        alloc_slice output;
+        if (timed) {
+            if (!runWithTimeout(input, key, output)) {
+                CBLQuery::predictionTimedOut();
+                return nullslice;
+            }
+        } else {
+            output = run(input);
+        }
+        
+        if (_model.cacheSize > 0) {
+            lock_guard<mutex> lock(_mutex);
+            addToCache(std::move(key), output);
+        }
+        return output;
+    }
+
+
+    // Must be called with _mutex locked.
+    void PredictiveModel::addToCache(string key, alloc_slice output) {
+        size_t size = key.size() + output.size + kCacheEntryOverhead;
+        if (size > _model.cacheSize || _cacheIndex.count(key) > 0) {
+            return;
+        }
+        
+        _cache.emplace_front(std::move(key), std::move(output));
+        _cacheIndex.emplace(string_view(_cache.front().first), _cache.begin());
+        _cacheBytes += size;
+        
+        // Remove the least recently used outputs until the cache fits:
+        while (_cacheBytes > _model.cacheSize) {
+            auto &entry = _cache.back();
+            _cacheBytes -= entry.first.size() + entry.second.size + kCacheEntryOverhead;
+            _cacheIndex.erase(string_view(entry.first));
+            _cache.pop_back();
+        }
+    }
+
+
+    Retained<PredictiveModel> PredictiveModel::named(slice name) {
+        lock_guard<mutex> lock(sModelsMutex);
+        if (auto i = sModels.find(string(name)); i != sModels.end()) {
+            return i->second;
+        }
+        return nullptr;
+    }
+
+
     void PredictiveModel::registerModel(const slice name, const CBLPredictiveModel& model) {
         auto prediction = [](void* context, FLDict input, C4Database *db, C4Error *outError) {
             auto m = (PredictiveModel*)context;
-            auto dict = m->_model.prediction(m->_model.context, input);
-            DEFER {
-                FLMutableDict_Release(dict);
-            };
-            
-            if (!dict) {
-                return FLSliceResult_CreateWith(nullptr, 0);
-            }
-            
-            Encoder enc;
-            enc.writeValue(Dict(dict));
-            return (FLSliceResult) enc.finish();
+            return (FLSliceResult) m->predict(input);
         };
         
         auto unregistered = [](void* context) {
             auto m = (PredictiveModel*)context;
-            if (m->_model.unregistered) {
-                m->_model.unregistered(m->_model.context);
+            {
+                lock_guard<mutex> lock(sModelsMutex);
+                auto i = find_if(sModels.begin(), sModels.end(), [&](auto &entry) {
+                    return entry.second == m;
+                });
+                if (i != sModels.end()) {
+                    sModels.erase(i);
+                }
             }
-            delete m;
+            // The model's `unregistered` callback is called once no precomputation is using it:
+            release(m);
         };
         
         unregisterModel(name);
         
+        Retained<PredictiveModel> m = new PredictiveModel(model);
+        auto nameStr = name.asString();
+        {
+            lock_guard<mutex> lock(sModelsMutex);
+            sModels[nameStr] = m;
+        }
+        
         C4PredictiveModel c4model { };
-        c4model.context = new PredictiveModel(model);
+        c4model.context = retain(m.get());
         c4model.prediction = prediction;
         c4model.unregistered = unregistered;
-        
-        auto nameStr = name.asString();
         c4pred_registerModel(nameStr.c_str(), c4model);
     }
 
@@ -68,6 +310,107 @@ namespace cbl_internal {
         auto nameStr = name.asString();
         c4pred_unregisterModel(nameStr.c_str());
     }
+
+    void PredictiveModel::precompute(slice name, const CBLCollection* collection, slice input) {
+        Retained<PredictiveModel> m = named(name);
+        if (!m) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorNotFound, "No predictive model is registered as '%.*s'.",
+                           FMTSLICE(name));
+        }
+        if (!m->_model.batchPrediction) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported,
+                           "The predictive model has no batchPrediction callback.");
+        }
+        
+        string queryString = "SELECT " + string(input) + " FROM `" + string(collection->scopeName())
+                           + "`.`" + string(collection->name()) + "`";
+        auto query = collection->database()->createQuery(kCBLN1QLLanguage, slice(queryString), nullptr);
+        if (!query) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Invalid prediction input expression.");
+        }
+        
+        const size_t batchSize = m->_model.batchSize ? m->_model.batchSize : kDefaultBatchSize;
+        unordered_map<string, alloc_slice> outputs;
+        vector<string> batchKeys;
+        vector<Doc> batchDocs;
+        vector<FLDict> batch;
+        vector<alloc_slice> batchOutputs;
+        
+        auto runBatch = [&] {
+            batchOutputs.clear();
+            m->predictBatch(batch, batchOutputs);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                outputs[batchKeys[i]] = std::move(batchOutputs[i]);
+            }
+            batch.clear();
+            batchDocs.clear();
+            batchKeys.clear();
+        };
+        
+        // Each input is copied out of its row, and inputs that occur more than once are
+        // predicted once:
+        auto results = query->execute();
+        while (results->next()) {
+            Dict dict = results->column(0).asDict();
+            if (!dict) {
+                continue;
+            }
+            alloc_slice json(FLValue_ToJSONX((FLValue)dict, false, true));
+            if (!outputs.emplace(string(json), nullslice).second) {
+                continue;
+            }
+            batchDocs.push_back(Doc::fromJSON(json));
+            batch.push_back(batchDocs.back().asDict());
+            batchKeys.emplace_back(json);
+            if (batch.size() >= batchSize) {
+                runBatch();
+            }
+        }
+        if (!batch.empty()) {
+            runBatch();
+        }
+        
+        lock_guard<mutex> lock(m->_mutex);
+        m->_outputs = std::move(outputs);
+    }
+
+    bool PredictiveModel::clearCache(slice name) {
+        Retained<PredictiveModel> m = named(name);
+        if (!m) {
+            return false;
+        }
+        lock_guard<mutex> lock(m->_mutex);
+        m->_outputs.clear();
+        m->_lateOutputs.clear();
+        m->_lateOutputOrder.clear();
+        m->_cacheIndex.clear();
+        m->_cache.clear();
+        m->_cacheBytes = 0;
+        return true;
+    }
+
+    size_t PredictiveModel::trimCaches(bool all) {
+        vector<Retained<PredictiveModel>> models;
+        {
+            lock_guard<mutex> lock(sModelsMutex);
+            for (auto &entry : sModels)
+                models.push_back(entry.second);
+        }
+        size_t freed = 0;
+        for (auto &m : models) {
+            lock_guard<mutex> lock(m->_mutex);
+            size_t target = all ? 0 : m->_cacheBytes / 2;
+            while (m->_cacheBytes > target && !m->_cache.empty()) {
+                auto &entry = m->_cache.back();
+                size_t size = entry.first.size() + entry.second.size + kCacheEntryOverhead;
+                m->_cacheIndex.erase(string_view(entry.first));
+                m->_cache.pop_back();
+                m->_cacheBytes -= size;
+                freed += size;
+            }
+        }
+        return freed;
+    }
 }
 
 #endif
@@ -30,4 +30,19 @@ void CBL_UnregisterPredictiveModel(FLString name) noexcept {
     PredictiveModel::unregisterModel(name);
 }
 
+bool CBL_ClearPredictionCache(FLString name) noexcept {
+    return PredictiveModel::clearCache(name);
+}
+
+bool CBL_PrecomputePredictions(FLString name,
+                               const CBLCollection* collection,
+                               FLString input,
+                               CBLError* outError) noexcept
+{
+    try {
+        PredictiveModel::precompute(name, collection, input);
+        return true;
+    } catchAndBridge(outError)
+}
+
 #endif
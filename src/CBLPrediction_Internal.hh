@@ -20,25 +20,72 @@
 #include "CBLPrediction.h"
 #include "fleece/Fleece.hh"
 #include "fleece/slice.hh"
+#include "fleece/RefCounted.hh"
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #ifdef COUCHBASE_ENTERPRISE
 
 namespace cbl_internal {
     using namespace fleece;
 
-    struct PredictiveModel {
+    struct PredictiveModel : public RefCounted {
         static void registerModel(const slice name, const CBLPredictiveModel& model);
         
         static void unregisterModel(const slice name);
         
+        /** Implements \ref CBL_PrecomputePredictions. */
+        static void precompute(slice name, const CBLCollection* collection, slice input);
+        
+        /** Implements \ref CBL_ClearPredictionCache. */
+        static bool clearCache(slice name);
+        
+        /** Evicts the least recently used outputs from every model's cache, half of them or all,
+            returning the number of bytes freed. */
+        static size_t trimCaches(bool all);
+        
     private:
         PredictiveModel(const CBLPredictiveModel& model) : _model(model) { }
         
-        ~PredictiveModel() = default;
+        ~PredictiveModel() override;
+        
+        static alloc_slice encodeOutput(FLMutableDict dict);
+        
+        alloc_slice predict(FLDict input);
+        
+        alloc_slice run(FLDict input);
+        
+        bool runWithTimeout(FLDict input, const std::string& key, alloc_slice& outOutput);
         
-        alloc_slice encodeOutput(Dict dict);
+        void keepLateOutput(std::string key, alloc_slice output);
+        
+        void predictBatch(const std::vector<FLDict>& inputs, std::vector<alloc_slice>& outputs);
+        
+        void addToCache(std::string key, alloc_slice output);
+        
+        static Retained<PredictiveModel> named(slice name);
+        
+        using CacheEntry = std::pair<std::string, alloc_slice>;     // Input JSON, output
+        
+        struct Call;                                                // A call on another thread
         
         CBLPredictiveModel const _model;
+        
+        std::mutex _mutex;                                          // Protects the members below
+        std::unordered_map<std::string, alloc_slice> _outputs;      // Precomputed, by input JSON
+        std::unordered_map<std::string, std::shared_ptr<Call>> _calls; // Running, by input JSON
+        unsigned _abandonedCalls {0};                               // Running, but timed out
+        std::unordered_map<std::string, alloc_slice> _lateOutputs;  // Of timed-out calls, by input
+        std::deque<std::string> _lateOutputOrder;                   // Keys of _lateOutputs, oldest first
+        std::list<CacheEntry> _cache;                               // Cached, most recent first
+        std::unordered_map<std::string_view, std::list<CacheEntry>::iterator> _cacheIndex;
+        size_t _cacheBytes {0};
     };
 }
 
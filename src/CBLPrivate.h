@@ -75,10 +75,60 @@ FLMutableArray CBLCollection_GetIndexesInfo(const CBLCollection* collection,
     
     FLSlice CBLReplicator_UserAgent(const CBLReplicator* repl) CBLAPI;
 
+    /** Returns the options dictionary the replicator passes to LiteCore, as JSON. */
+    FLSliceResult CBLReplicator_OptionsJSON(const CBLReplicator* repl) CBLAPI;
+
     /** Adding a delay in MS before processing the callback from C4QueryObserver. 
         This is for testing to ensure that the callback has handle the case that the callback
         is called after the query listener token as removed correctly without accessing
         any invalidated objects. */
     void CBLQuery_SetListenerCallbackDelay(int delay) CBLAPI;
 
+    /** Returns the number of CBLDocument objects whose memory came from the heap rather than
+        from the per-thread pool of recently freed documents. For allocation tests. */
+    uint64_t CBLDocument_HeapAllocationCount(void) CBLAPI;
+
+    /** Returns the number of CBLResultSet objects whose memory came from the heap rather than
+        from the per-thread pool of recently freed result sets. For allocation tests. */
+    uint64_t CBLResultSet_HeapAllocationCount(void) CBLAPI;
+
+    /** Totals of the instrumented locks' stats, from \ref CBL_LockWaitStats. */
+    typedef struct {
+        uint64_t acquisitions;      ///< Number of times a lock was acquired
+        uint64_t contended;         ///< Number of those times another thread held the lock
+        uint64_t waitNanos;         ///< Total time spent waiting for a lock, in nanoseconds
+    } CBLLockWaitStats;
+
+    /** The number of buckets in \ref CBLLockStats.waitHistogram. */
+    #define kCBLLockWaitBuckets 8
+
+    /** One instrumented lock's stats, from \ref CBL_GetLockStats. Each covers every instance
+        of one kind of lock, such as all databases' access locks. */
+    typedef struct {
+        const char* name;           ///< The lock's name, e.g. "database" or "replicator"
+        uint64_t acquisitions;      ///< Number of times it was acquired
+        uint64_t contended;         ///< Number of those times another thread held it
+        uint64_t waitNanos;         ///< Total time spent waiting for it, in nanoseconds
+        uint64_t maxHoldNanos;      ///< Longest time it was held, in nanoseconds
+        /** Acquisitions by wait time: bucket i counts waits under 10^i microseconds (so bucket 0
+            includes the uncontended ones), and the last bucket counts the rest. */
+        uint64_t waitHistogram[kCBLLockWaitBuckets];
+    } CBLLockStats;
+
+    /** Starts or stops timing the instrumented locks -- databases' and collections' access
+        locks, listener lists, the context manager and replicators -- and resets their stats.
+        Timing is off by default, since it adds some cost to every lock; while it's off the
+        cost is one atomic load per lock. */
+    void CBL_SetLockTiming(bool enabled) CBLAPI;
+
+    /** Returns the totals of the locks' stats since \ref CBL_SetLockTiming was last called. */
+    CBLLockWaitStats CBL_LockWaitStats(void) CBLAPI;
+
+    /** Copies up to `maxCount` locks' stats since \ref CBL_SetLockTiming was last called into
+        `stats`, and returns the number of instrumented locks. */
+    unsigned CBL_GetLockStats(CBLLockStats stats[_cbl_nullable], unsigned maxCount) CBLAPI;
+
+    /** Returns all the locks' stats as a JSON object keyed by lock name, for logging. */
+    FLSliceResult CBL_DumpLockStats(void) CBLAPI;
+
 CBL_CAPI_END
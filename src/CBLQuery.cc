@@ -18,8 +18,23 @@
 
 #include "CBLDatabase_Internal.hh"
 #include "CBLBlob_Internal.hh"
+#include "CBLCollection_Internal.hh"
 #include "CBLQuery_Internal.hh"
 #include "CBLEncryptable_Internal.hh"
+#include "TaskPool.hh"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 
 using namespace std;
@@ -48,6 +63,58 @@ void ListenerToken<CBLQueryChangeListener>::setEnabled(bool enabled) {
 }
 
 
+#pragma mark - LISTENER COALESCING:
+
+
+// A notification is delivered once the results have been quiet for the minimum interval, or
+// the oldest undelivered change has waited for the maximum latency, whichever comes first.
+ListenerToken<CBLQueryChangeListener>::Clock::time_point
+ListenerToken<CBLQueryChangeListener>::coalesceDeadline() const {
+    return std::min(_lastPendingChange + _minInterval, _firstPendingChange + _maxLatency);
+}
+
+
+void ListenerToken<CBLQueryChangeListener>::coalesceChange() {
+    LOCK(_coalesceMutex);
+    auto now = Clock::now();
+    if (_pendingChanges++ == 0)
+        _firstPendingChange = now;
+    _lastPendingChange = now;
+    if (!_timerScheduled) {
+        _timerScheduled = true;
+        scheduleCoalesceTimer(coalesceDeadline());
+    }
+}
+
+
+void ListenerToken<CBLQueryChangeListener>::scheduleCoalesceTimer(Clock::time_point when) {
+    void* ctx = _contextID;
+    ListenerTimer::shared().schedule(when, [ctx] {
+        // The token may have been removed in the meantime:
+        auto obj = ContextManager::shared().getObject(ctx);
+        if (auto self = dynamic_cast<ListenerToken<CBLQueryChangeListener>*>(obj.get()))
+            self->coalesceTimerFired();
+    });
+}
+
+
+void ListenerToken<CBLQueryChangeListener>::coalesceTimerFired() {
+    uint32_t changes;
+    {
+        LOCK(_coalesceMutex);
+        if (auto deadline = coalesceDeadline(); deadline > Clock::now()) {
+            // More changes arrived since the timer was set, so wait for them to settle:
+            scheduleCoalesceTimer(deadline);
+            return;
+        }
+        _timerScheduled = false;
+        changes = _pendingChanges;
+        _pendingChanges = 0;
+    }
+    _query->database()->notify(_query.get(), this, changes);
+}
+
+
 CBLResultSet::CBLResultSet(CBLQuery* query, C4Query::Enumerator qe)
 :_query(query)
 ,_enum(std::move(qe))
@@ -57,12 +124,36 @@ CBLResultSet::CBLResultSet(CBLQuery* query, C4Query::Enumerator qe)
 CBLResultSet::~CBLResultSet() {
     if (_fleeceDoc)
         _fleeceDoc.setAssociated(nullptr, "CBLResultSet");
+    if (_profile && _profile->sampled && !_profile->finished) {
+        try {
+            reportSample();
+        } catch (...) {
+            BridgeException(__FUNCTION__, nullptr);
+        }
+    }
+    if (_cacheDataVersion) {
+        try {
+            _query->_cacheResults(std::move(_cacheParameters), _cacheDataVersion, std::move(_enum));
+        } catch (...) {
+            BridgeException(__FUNCTION__, nullptr);
+        }
+    }
 }
 
 
 bool CBLResultSet::next() {
-    _asArray = nullptr;
-    _asDict = nullptr;
+    if (_firstRowTrace.spanID) {
+        cbl_internal::TraceSpan span(kCBLTraceQueryFirstRow, nullslice, std::exchange(_firstRowTrace, {}));
+        bool found = readRow();
+        span.addItems(found);
+        return found;
+    }
+    return readRow();
+}
+
+
+bool CBLResultSet::readRow() {
+    _asArrayCurrent = _asDictCurrent = false;
     _blobs.clear();
 #ifdef COUCHBASE_ENTERPRISE
     _encryptables.clear();
@@ -76,48 +167,171 @@ bool CBLResultSet::next() {
                 _fleeceDoc = Doc::containing(v);
                 if (!_fleeceDoc.setAssociated(this, "CBLResultSet"))
                     C4Warn("Couldn't associate CBLResultSet with FLDoc %p", FLDoc(_fleeceDoc));
+                _memory.setBytes(sizeof(CBLResultSet) + _fleeceDoc.data().size);
             }
         }
+        if (_profile)
+            profileRow(true);
         return true;
     } else {
         _fleeceDoc = nullptr;
+        if (_profile)
+            profileRow(false);
         return false;
     }
 }
 
 
+size_t CBLResultSet::nextBatch(size_t maxRows, FLValue outValues[]) {
+    unsigned nCols = _query->columnCount();
+    size_t nRows = 0;
+    while (nRows < maxRows && next()) {
+        for (unsigned col = 0; col < nCols; ++col)
+            *outValues++ = column(col);
+        ++nRows;
+    }
+    return nRows;
+}
+
+
+template <class T, class ACCESSOR>
+size_t CBLResultSet::readColumn(unsigned col, FLValueType type, T outValues[], size_t maxRows,
+                                uint8_t* outNulls, ACCESSOR accessor)
+{
+    if (col >= _query->columnCount())
+        C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Column index out of range");
+    if (outNulls)
+        memset(outNulls, 0, (maxRows + 7) / 8);
+    size_t nRows = 0;
+    while (nRows < maxRows && next()) {
+        Value val = column(col);
+        if (val.type() == type) {
+            outValues[nRows] = accessor(val);
+        } else {
+            outValues[nRows] = T {};
+            if (outNulls)
+                outNulls[nRows / 8] |= uint8_t(1 << (nRows % 8));
+        }
+        ++nRows;
+    }
+    return nRows;
+}
+
+
+size_t CBLResultSet::readColumn(unsigned col, double outValues[], size_t maxRows, uint8_t* outNulls) {
+    return readColumn(col, kFLNumber, outValues, maxRows, outNulls,
+                      [](Value val) {return val.asDouble();});
+}
+
+
+size_t CBLResultSet::readColumn(unsigned col, int64_t outValues[], size_t maxRows, uint8_t* outNulls) {
+    return readColumn(col, kFLNumber, outValues, maxRows, outNulls,
+                      [](Value val) {return val.asInt();});
+}
+
+
+size_t CBLResultSet::readColumn(unsigned col, FLString outValues[], size_t maxRows, uint8_t* outNulls) {
+    return readColumn(col, kFLString, outValues, maxRows, outNulls,
+                      [](Value val) {return FLString(val.asString());});
+}
+
+
+bool CBLQuery::executeToJSON(CBLQueryJSONFormat format, function_ref<bool(slice)> write) {
+    // Rows are encoded into a JSON array, which is flushed whenever it's over this size:
+    static constexpr size_t kChunkSize = 32 * 1024;
+    
+    Retained<CBLResultSet> rs = execute();
+    auto &titles = columns().titles;
+    auto nCols = unsigned(titles.size());
+    
+    Encoder enc(kFLEncodeJSON);
+    vector<size_t> rowEnds;     // Offsets of the ',' or ']' following each row in the chunk
+    bool first = true, more = true;
+    while (more) {
+        rowEnds.clear();
+        enc.beginArray();
+        while (enc.bytesWritten() < kChunkSize && (more = rs->next())) {
+            enc.beginDict(nCols);
+            for (unsigned col = 0; col < nCols; ++col) {
+                if (Value val = rs->column(col); val) {
+                    enc.writeKey(titles[col]);
+                    enc.writeValue(val);
+                }
+            }
+            enc.endDict();
+            rowEnds.push_back(enc.bytesWritten());
+        }
+        enc.endArray();
+        alloc_slice chunk = enc.finish();
+        if (!chunk)
+            C4Error::raise(FleeceDomain, enc.error(), "%s", enc.errorMessage());
+        enc.reset();
+        if (rowEnds.empty())
+            break;
+        
+        // Turn the encoded array into the next chunk of output, in place:
+        auto buf = (char*)chunk.buf;
+        slice output;
+        if (format == kCBLQueryNDJSON) {
+            for (size_t end : rowEnds)
+                buf[end] = '\n';
+            output = slice(buf + 1, chunk.size - 1);
+        } else {
+            if (!first)
+                buf[0] = ',';
+            output = slice(buf, chunk.size - 1);
+        }
+        first = false;
+        if (!write(output))
+            return false;
+    }
+    
+    if (format == kCBLQueryJSONArray)
+        return write(first ? "[]"_sl : "]"_sl);
+    return true;
+}
+
+
 Value CBLResultSet::property(slice prop) const {
     int col = _query->columnNamed(prop);
     return (col >= 0) ? column(col) : nullptr;
 }
 
 
+// The Array and Dict are only valid until the next row, but the caller may retain them, so new
+// ones are made for each row -- unless the caller has opted in to having the same ones refilled.
+// Either way, they're only filled in if they're asked for.
+
 Array CBLResultSet::asArray() const {
-    if (!_asArray) {
-        auto array = MutableArray::newArray();
+    if (!_asArrayCurrent) {
         unsigned nCols = _query->columnCount();
-        array.resize(uint32_t(nCols));
+        if (!_asArray || !_reuseResults) {
+            _asArray = MutableArray::newArray();
+            _asArray.resize(uint32_t(nCols));
+        }
         for (unsigned i = 0; i < nCols; ++i) {
             Value val = column(i);
-            array[i] = val ? val : Value(kFLUndefinedValue);
+            _asArray[i] = val ? val : Value(kFLUndefinedValue);
         }
-        _asArray = array;
+        _asArrayCurrent = true;
     }
     return _asArray;
 }
 
 
 Dict CBLResultSet::asDict() const {
-    if (!_asDict) {
-        auto dict = MutableDict::newDict();
+    if (!_asDictCurrent) {
+        if (!_asDict || !_reuseResults)
+            _asDict = MutableDict::newDict();
         unsigned nCols = _query->columnCount();
         for (unsigned i = 0; i < nCols; ++i) {
-            if (Value val = column(i); val) {
-                slice key = _query->columnName(i);
-                dict[key] = val;
-            }
+            slice key = _query->columnName(i);
+            if (Value val = column(i); val)
+                _asDict[key] = val;
+            else
+                _asDict.remove(key);
         }
-        _asDict = dict;
+        _asDictCurrent = true;
     }
     return _asDict;
 }
@@ -133,12 +347,10 @@ CBLBlob* CBLResultSet::getBlob(Dict blobDict, const C4BlobKey &key) {
     // (It's not really necessary to cache the CBLBlobs -- they're lightweight objects --
     // but otherwise we'd have to return a `Retained<CBLBlob>`, which would complicate
     // the public C API by making the caller release it afterwards.)
-    auto i = _blobs.find(blobDict);
-    if (i == _blobs.end()) {
-        auto db = const_cast<CBLDatabase*>(query()->database());
-        i = _blobs.emplace(blobDict, new CBLBlob(db, blobDict, key)).first;
-    }
-    return i->second;
+    if (auto blob = _blobs.find(blobDict); blob)
+        return blob;
+    auto db = const_cast<CBLDatabase*>(query()->database());
+    return _blobs.insert(blobDict, new CBLBlob(db, blobDict, key));
 }
 
 
@@ -146,11 +358,542 @@ CBLBlob* CBLResultSet::getBlob(Dict blobDict, const C4BlobKey &key) {
 
 CBLEncryptable* CBLResultSet::getEncryptableValue(Dict encDict) {
     // Find or create a CBLEncryptable, then cache it.
-    auto i = _encryptables.find(encDict);
-    if (i == _encryptables.end()) {
-        i = _encryptables.emplace(encDict, new CBLEncryptable(encDict)).first;
-    }
-    return i->second;
+    if (auto prop = _encryptables.find(encDict); prop)
+        return prop;
+    return _encryptables.insert(encDict, new CBLEncryptable(encDict));
 }
 
 #endif
+
+
+MutableArray CBLResultSet::copyCursor(const unsigned keyColumns[], size_t numKeyColumns) const {
+    unsigned nCols = _query->columnCount();
+    auto cursor = MutableArray::newArray();
+    for (size_t i = 0; i < numKeyColumns; ++i) {
+        if (keyColumns[i] >= nCols)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Column index out of range");
+        if (Value value = column(keyColumns[i]); value)
+            FLSlot_SetValue(FLMutableArray_Append(cursor), value);
+        else
+            FLSlot_SetNull(FLMutableArray_Append(cursor));
+    }
+    // The cursor has to outlive the result set, so it mustn't point into the result data:
+    return cursor.mutableCopy(kFLDeepCopyImmutables);
+}
+
+
+#pragma mark - QUERY DIFFER:
+
+
+string QueryDiffer::rowKey(Array row) {
+    // Canonical JSON, so that equal keys encoded differently still match:
+    alloc_slice json(FLValue_ToJSONX(row[0], false, true));
+    return string(json);
+}
+
+
+const vector<CBLQueryRowChange>& QueryDiffer::diff(CBLResultSet* rs) {
+    // Copy the rows, since they have to be compared with the next result set:
+    unsigned nCols = rs->query()->columnCount();
+    Encoder enc;
+    enc.beginArray();
+    while (rs->next()) {
+        enc.beginArray(nCols);
+        for (unsigned col = 0; col < nCols; ++col) {
+            if (Value val = rs->column(col); val)
+                enc.writeValue(val);
+            else
+                enc.writeNull();
+        }
+        enc.endArray();
+    }
+    enc.endArray();
+    
+    _oldRows = std::move(_rows);
+    _oldIndex.swap(_index);
+    _index.clear();
+    _rows = enc.finishDoc();
+    if (!_rows)
+        C4Error::raise(FleeceDomain, enc.error(), "%s", enc.errorMessage());
+    
+    _changes.clear();
+    Array rows = _rows.root().asArray();
+    Array oldRows = _oldRows ? _oldRows.root().asArray() : Array();
+
+    // Index the new rows, and find the old index of each that was already there:
+    struct Kept {uint32_t index, oldIndex;};
+    vector<Kept> kept;
+    uint32_t index = 0;
+    for (Array::iterator i(rows); i; ++i, ++index) {
+        string key = rowKey(i.value().asArray());
+        if (auto old = _oldIndex.find(key); old != _oldIndex.end())
+            kept.push_back({index, old->second});
+        _index.emplace(std::move(key), index);
+    }
+
+    // The kept rows forming the longest run in their old order stay put; the rest have moved.
+    // (Patience sorting: `tails[n]` is the kept row ending the best run of length n+1.)
+    vector<uint32_t> tails, prev(kept.size(), UINT32_MAX);
+    for (uint32_t k = 0; k < kept.size(); ++k) {
+        auto pos = std::lower_bound(tails.begin(), tails.end(), kept[k].oldIndex,
+                                    [&](uint32_t t, uint32_t oldIndex) {
+                                        return kept[t].oldIndex < oldIndex;
+                                    });
+        if (pos != tails.begin())
+            prev[k] = *(pos - 1);
+        if (pos == tails.end())
+            tails.push_back(k);
+        else
+            *pos = k;
+    }
+    vector<bool> stayed(kept.size(), false);
+    for (uint32_t k = tails.empty() ? UINT32_MAX : tails.back(); k != UINT32_MAX; k = prev[k])
+        stayed[k] = true;
+
+    auto nextKept = kept.begin();
+    index = 0;
+    for (Array::iterator i(rows); i; ++i, ++index) {
+        Array row = i.value().asArray();
+        if (nextKept == kept.end() || nextKept->index != index) {
+            _changes.push_back({kCBLQueryRowInserted, index, row[0], row, index});
+            continue;
+        }
+        uint32_t oldIndex = nextKept->oldIndex;
+        if (!stayed[nextKept - kept.begin()])
+            _changes.push_back({kCBLQueryRowMoved, index, row[0], row, oldIndex});
+        else if (!oldRows[oldIndex].isEqual(row))
+            _changes.push_back({kCBLQueryRowUpdated, index, row[0], row, oldIndex});
+        ++nextKept;
+    }
+    index = 0;
+    for (Array::iterator i(oldRows); i; ++i, ++index) {
+        Array row = i.value().asArray();
+        if (_index.find(rowKey(row)) == _index.end())
+            _changes.push_back({kCBLQueryRowRemoved, index, row[0], row, index});
+    }
+    return _changes;
+}
+
+
+#pragma mark - PROFILING:
+
+
+const CBLQuery::Plan& CBLQuery::plan() const {
+    call_once(_oncePlan, [this]{
+        // Each line of the strategy SQLite describes is like "7|0|0| SEARCH kv_default USING
+        // INDEX byName (key=?)" or "12|0|0| USE TEMP B-TREE FOR ORDER BY":
+        alloc_slice explanation = explain();
+        string_view text(explanation);
+        vector<string_view> ftsNames;
+        Encoder enc;
+        enc.beginArray();
+        for (size_t pos = 0; pos < text.size(); ) {
+            size_t end = std::min(text.find('\n', pos), text.size());
+            string_view line = text.substr(pos, end - pos);
+            pos = end + 1;
+            if (line.find("USE TEMP B-TREE") != string_view::npos)
+                _plan.usesTempBTree = true;
+            if (size_t i = line.find(" INDEX "); i != string_view::npos) {
+                string_view name = line.substr(i + 7);
+                name = name.substr(0, name.find(' '));
+                enc.writeString(slice(name.data(), name.size()));
+            } else if (line.find("SCAN ") != string_view::npos) {
+                _plan.fullScan = true;
+            }
+        }
+        // A full-text index is a virtual table named like "kv_default::index", which the SQL
+        // at the start of the explanation joins with:
+        for (size_t pos = 0; (pos = text.find("::", pos)) != string_view::npos; ) {
+            size_t start = text.rfind('"', pos);
+            pos += 2;
+            size_t end = text.find('"', pos);
+            if (start == string_view::npos || end == string_view::npos
+                    || text.substr(start + 1, 3) != "kv_")
+                continue;
+            string_view name = text.substr(pos, end - pos);
+            if (std::find(ftsNames.begin(), ftsNames.end(), name) == ftsNames.end()) {
+                ftsNames.push_back(name);
+                enc.writeString(slice(name.data(), name.size()));
+            }
+        }
+        enc.endArray();
+        _plan.indexesUsed = enc.finishDoc();
+    });
+    return _plan;
+}
+
+
+namespace {
+    std::mutex              sSamplerMutex;
+    std::atomic<uint32_t>   sSampleInterval {0};     // 0 means not sampling
+    std::atomic<uint32_t>   sSampleCounter {0};
+    CBLQueryStatsCallback   sSamplerCallback = nullptr;
+    void*                   sSamplerContext = nullptr;
+}
+
+
+void CBLResultSet::setSampler(uint32_t interval, CBLQueryStatsCallback callback, void* context) {
+    LOCK(sSamplerMutex);
+    sSamplerCallback = callback;
+    sSamplerContext = context;
+    sSampleInterval = callback ? interval : 0;
+    sSampleCounter = 0;
+}
+
+
+bool CBLResultSet::shouldSample() {
+    uint32_t interval = sSampleInterval.load(std::memory_order_relaxed);
+    if (interval == 0)
+        return false;
+    return sSampleCounter.fetch_add(1, std::memory_order_relaxed) % interval == 0;
+}
+
+
+void CBLResultSet::startProfiling(std::chrono::steady_clock::time_point start, bool sampled) {
+    _profile = std::make_unique<Profile>();
+    _profile->start = start;
+    _profile->sampled = sampled;
+}
+
+
+void CBLResultSet::profileRow(bool more) {
+    if (_profile->finished)
+        return;
+    double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                               - _profile->start).count();
+    auto &stats = _profile->stats;
+    if (more) {
+        if (stats.rowsReturned++ == 0)
+            stats.firstRowTime = elapsed;
+    } else {
+        _profile->finished = true;
+        if (stats.rowsReturned == 0)
+            stats.firstRowTime = elapsed;
+        if (_profile->sampled)
+            reportSample();
+    }
+    stats.totalTime = elapsed;
+}
+
+
+bool CBLResultSet::getStats(CBLQueryStats &outStats) const {
+    if (!_profile)
+        return false;
+    auto &plan = _query->plan();
+    outStats = _profile->stats;
+    outStats.compileTime = _query->compileTime();
+    outStats.fullScan = plan.fullScan;
+    outStats.usesTempBTree = plan.usesTempBTree;
+    outStats.indexesUsed = plan.indexesUsed.root().asArray();
+    return true;
+}
+
+
+void CBLResultSet::reportSample() {
+    CBLQueryStats stats;
+    getStats(stats);
+    CBLQueryStatsCallback callback;
+    void* context;
+    {
+        LOCK(sSamplerMutex);
+        callback = sSamplerCallback;
+        context = sSamplerContext;
+    }
+    if (callback)
+        callback(context, _query, &stats);
+}
+
+
+#pragma mark - ASYNC EXECUTION:
+
+
+namespace {
+
+    // The default executor for asynchronous queries, unless the app configured a thread pool:
+    // a small pool of worker threads. Like the configured pool, it's never deleted, since at
+    // exit its workers may be running queries whose objects are already destroyed.
+    WorkerPool& queryThreadPool() {
+        static auto sPool = new WorkerPool(std::clamp(std::thread::hardware_concurrency(), 2u, 4u));
+        return *sPool;
+    }
+
+    std::mutex          sExecutorMutex;
+    CBLQueryExecutor    sExecutor = nullptr;    // Custom executor, if any
+    void*               sExecutorContext = nullptr;
+
+    // Runs a task on the current executor.
+    void runQueryTask(CBLQueryTask task, void* context) {
+        CBLQueryExecutor executor;
+        void* executorContext;
+        {
+            LOCK(sExecutorMutex);
+            executor = sExecutor;
+            executorContext = sExecutorContext;
+        }
+        if (executor)
+            executor(executorContext, task, context);
+        else if (AsyncTasks::configured())
+            AsyncTasks::run(task, context);
+        else
+            queryThreadPool().enqueue(task, context);
+    }
+
+}
+
+
+void CBLQueryExecution::setExecutor(CBLQueryExecutor executor, void* context) {
+    LOCK(sExecutorMutex);
+    sExecutor = executor;
+    sExecutorContext = context;
+}
+
+
+void CBLQueryExecution::start() {
+    // The task owns a reference to the execution until it has run:
+    retain(this);
+    runQueryTask([](void* context) {
+        auto self = (CBLQueryExecution*)context;
+        self->run();
+        release(self);
+    }, this);
+}
+
+
+void CBLQueryExecution::run() {
+    State state = kPending;
+    if (!_state.compare_exchange_strong(state, kRunning))
+        return;     // Cancelled before it started
+    
+    Retained<CBLResultSet> results;
+    CBLError error {};
+    try {
+        results = _query->execute();
+    } catch (...) {
+        BridgeException(__FUNCTION__, &error);
+    }
+    
+    state = kRunning;
+    if (!_state.compare_exchange_strong(state, kCalledBack))
+        return;     // Cancelled while it ran
+    _callback(_context, _query, results, results ? nullptr : &error);
+}
+
+
+#pragma mark - QUERYING MANY COLLECTIONS:
+
+
+namespace {
+
+    // The most connections a fan-out query reads with at once, counting the calling thread's;
+    // no more than the database keeps for reuse, so that each query doesn't open its own.
+    constexpr size_t kMaxFanOutConnections = 4;
+
+    // The state shared by the threads running a fan-out query. Each thread claims the next
+    // collection's query until none are left, so a task that starts late finds nothing to do.
+    struct FanOut final : public CBLRefCounted {
+        Retained<CBLDatabase>           db;
+        vector<alloc_slice>             queries;        // The query for each collection
+        alloc_slice                     parameters;     // Fleece-encoded, or null
+        vector<CBLQuerySortColumn>      sortColumns;
+        vector<Doc>                     results;        // Each collection's rows, encoded
+        vector<exception_ptr>           errors;         // Each collection's error, if any
+        atomic<size_t>                  nextQuery {0};
+        mutex                           finishedMutex;
+        condition_variable              finishedCond;
+        size_t                          finished {0};   // Guarded by finishedMutex
+
+        void work() {
+            Retained<CBLDatabase> reader;
+            for (size_t i = nextQuery++; i < queries.size(); i = nextQuery++) {
+                try {
+                    if (!reader)
+                        reader = db->acquireReader();
+                    results[i] = run(reader, queries[i]);
+                } catch (...) {
+                    errors[i] = current_exception();
+                }
+                LOCK(finishedMutex);
+                if (++finished == queries.size())
+                    finishedCond.notify_all();
+            }
+        }
+
+        void waitUntilFinished() {
+            unique_lock<mutex> lock(finishedMutex);
+            finishedCond.wait(lock, [&] {return finished == queries.size();});
+        }
+
+        // Runs a collection's query, copying its rows, since they're read after it's released.
+        Doc run(CBLDatabase *reader, slice queryString) {
+            Retained<CBLQuery> query = reader->createQuery(kCBLN1QLLanguage, queryString, nullptr);
+            if (!query)
+                C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Invalid query: %.*s",
+                               FMTSLICE(queryString));
+            unsigned nCols = query->columnCount();
+            for (auto &sort : sortColumns) {
+                if (sort.column >= nCols)
+                    C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                                   "Sort column index out of range");
+            }
+            if (parameters)
+                query->setParameters(ValueFromData(parameters, kFLTrusted).asDict());
+
+            Retained<CBLResultSet> rs = query->execute();
+            Encoder enc;
+            enc.beginArray();
+            while (rs->next()) {
+                enc.beginArray(nCols);
+                for (unsigned col = 0; col < nCols; ++col) {
+                    if (Value val = rs->column(col); val)
+                        enc.writeValue(val);
+                    else
+                        enc.writeNull();
+                }
+                enc.endArray();
+            }
+            enc.endArray();
+            Doc rows = enc.finishDoc();
+            if (!rows)
+                C4Error::raise(FleeceDomain, enc.error(), "%s", enc.errorMessage());
+            return rows;
+        }
+    };
+
+
+    // The order of a value's type when merging: missing and null, numbers, strings, the rest.
+    // (Booleans are numbers, as they are in SQLite.)
+    int typeRank(Value v) {
+        switch (v.type()) {
+            case kFLUndefined:
+            case kFLNull:       return 0;
+            case kFLBoolean:
+            case kFLNumber:     return 1;
+            case kFLString:     return 2;
+            default:            return 3;
+        }
+    }
+
+
+    int compareValues(Value a, Value b) {
+        int rankA = typeRank(a), rankB = typeRank(b);
+        if (rankA != rankB)
+            return rankA < rankB ? -1 : 1;
+        switch (rankA) {
+            case 0:
+                return 0;
+            case 1:
+                if (a.isInteger() && b.isInteger() && !a.isUnsigned() && !b.isUnsigned()) {
+                    int64_t x = a.asInt(), y = b.asInt();
+                    return (x > y) - (x < y);
+                } else {
+                    double x = a.asDouble(), y = b.asDouble();
+                    return (x > y) - (x < y);
+                }
+            case 2:
+                return a.asString().compare(b.asString());
+            default:
+                // Arrays and dicts have no natural order; their JSON at least makes it stable:
+                return alloc_slice(a.toJSON()).compare(b.toJSON());
+        }
+    }
+
+
+    int compareRows(Array a, Array b, const vector<CBLQuerySortColumn> &sortColumns) {
+        for (auto &sort : sortColumns) {
+            if (int cmp = compareValues(a[sort.column], b[sort.column]); cmp != 0)
+                return sort.descending ? -cmp : cmp;
+        }
+        return 0;
+    }
+
+}
+
+
+MutableArray CBLDatabase::queryCollections(slice queryTemplate,
+                                           const CBLCollection* const collections[],
+                                           size_t numCollections,
+                                           Dict parameters,
+                                           const CBLQuerySortColumn* sortColumns,
+                                           size_t numSortColumns,
+                                           uint64_t limit)
+{
+    const string placeholder = kCBLQueryCollectionPlaceholder;
+    if (!queryTemplate.find(slice(placeholder)))
+        C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                       "The query template doesn't contain " kCBLQueryCollectionPlaceholder);
+
+    Retained<FanOut> fanOut = new FanOut;
+    fanOut->db = this;
+    if (numSortColumns > 0)
+        fanOut->sortColumns.assign(sortColumns, sortColumns + numSortColumns);
+    if (parameters) {
+        Encoder enc;
+        enc.writeValue(parameters);
+        fanOut->parameters = enc.finish();
+    }
+    for (size_t i = 0; i < numCollections; ++i) {
+        const CBLCollection *col = collections[i];
+        if (col->database() != this)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Collection %.*s isn't from this database", FMTSLICE(col->fullName()));
+        if (!col->isValid())
+            C4Error::raise(LiteCoreDomain, kC4ErrorNotOpen,
+                           "Invalid collection: either deleted or db closed");
+        // Each collection's query has the limit too, since no more of its rows can be used:
+        string name = "`" + string(col->scopeName()) + "`.`" + string(col->name()) + "`";
+        string query(queryTemplate);
+        for (size_t pos = 0; (pos = query.find(placeholder, pos)) != string::npos; pos += name.size())
+            query.replace(pos, placeholder.size(), name);
+        if (limit > 0)
+            query += " LIMIT " + to_string(limit);
+        fanOut->queries.emplace_back(query);
+    }
+    fanOut->results.resize(numCollections);
+    fanOut->errors.resize(numCollections);
+
+    // Each task owns a reference to the state until it has run. The calling thread works too,
+    // so the query finishes even if the executor's threads are all busy, or it's one of them:
+    size_t nTasks = std::min(numCollections, kMaxFanOutConnections);
+    for (size_t i = 1; i < nTasks; ++i) {
+        retain(fanOut.get());
+        runQueryTask([](void* context) {
+            auto fanOut = (FanOut*)context;
+            fanOut->work();
+            release(fanOut);
+        }, fanOut.get());
+    }
+    fanOut->work();
+    fanOut->waitUntilFinished();
+    for (auto &error : fanOut->errors) {
+        if (error)
+            rethrow_exception(error);
+    }
+
+    // Merge the collections' rows, each already in order, taking the first of their next rows:
+    struct Next {
+        Array       rows;
+        uint32_t    row;
+        size_t      collection;
+        Array current() const   {return rows[row].asArray();}
+    };
+    auto after = [&](const Next &a, const Next &b) {
+        int cmp = compareRows(a.current(), b.current(), fanOut->sortColumns);
+        return cmp != 0 ? cmp > 0 : a.collection > b.collection;
+    };
+    priority_queue<Next, vector<Next>, decltype(after)> heads(after);
+    for (size_t i = 0; i < numCollections; ++i) {
+        if (Array rows = fanOut->results[i].root().asArray(); !rows.empty())
+            heads.push({rows, 0, i});
+    }
+    auto merged = MutableArray::newArray();
+    while (!heads.empty() && (limit == 0 || merged.count() < limit)) {
+        Next next = heads.top();
+        heads.pop();
+        Value row = next.current();
+        FLSlot_SetValue(FLMutableArray_Append(merged), row);
+        if (++next.row < next.rows.count())
+            heads.push(next);
+    }
+    // The results have to outlive the collections' rows, so they mustn't point into them:
+    return merged.mutableCopy(kFLDeepCopyImmutables);
+}
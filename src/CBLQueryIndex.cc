@@ -19,7 +19,10 @@
 #include "CBLQueryIndex_Internal.hh"
 #include "CBLBlob_Internal.hh"
 #include "CBLCollection_Internal.hh"
+#include "Trace.hh"
+#include "TaskPool.hh"
 #include "c4Index.hh"
+#include <algorithm>
 
 using namespace fleece;
 
@@ -38,6 +41,40 @@ slice CBLQueryIndex::name() const {
     return _c4Index.useLocked()->getName();
 }
 
+#pragma mark - CBLIndexBuild:
+
+void CBLIndexBuild::start() {
+    // The task owns a reference to the build until it has run:
+    retain(this);
+    AsyncTasks::runBlocking([](void* context) {
+        auto self = (CBLIndexBuild*)context;
+        self->run();
+        release(self);
+    }, this);
+}
+
+void CBLIndexBuild::run() {
+    CBLIndexBuildState state = kCBLIndexBuildPending;
+    if (!_state.compare_exchange_strong(state, kCBLIndexBuildRunning))
+        return;     // Cancelled before it started
+    callBack(kCBLIndexBuildRunning, nullptr);
+    
+    CBLError error {};
+    try {
+        _builder();
+    } catch (...) {
+        BridgeException(__FUNCTION__, &error);
+    }
+    state = error.code ? kCBLIndexBuildFailed : kCBLIndexBuildFinished;
+    _state = state;
+    callBack(state, error.code ? &error : nullptr);
+}
+
+void CBLIndexBuild::callBack(CBLIndexBuildState state, const CBLError* error) {
+    if (_callback)
+        _callback(_context, this, state, error);
+}
+
 #ifdef COUCHBASE_ENTERPRISE
 
 Retained<CBLIndexUpdater> CBLQueryIndex::beginUpdate(size_t limit) {
@@ -99,6 +136,16 @@ void CBLIndexUpdater::setVector(size_t index, const float* _cbl_nullable vector,
     _c4IndexUpdater->setVectorAt(index, vector, dimension);
 }
 
+void CBLIndexUpdater::setVectors(size_t startIndex, const float* vectors, size_t count, size_t dimension) {
+    LOCK(_mutex);
+    
+    checkFinishedUnLock();
+    precondition(startIndex <= _c4IndexUpdater->count() && count <= _c4IndexUpdater->count() - startIndex);
+    
+    for (size_t i = 0; i < count; ++i)
+        _c4IndexUpdater->setVectorAt(startIndex + i, vectors + i * dimension, dimension);
+}
+
 void CBLIndexUpdater::skipVector(size_t index) {
     LOCK(_mutex);
     
@@ -113,6 +160,8 @@ void CBLIndexUpdater::finish() {
     
     checkFinishedUnLock();
     
+    cbl_internal::TraceSpan span(kCBLTraceIndexUpdate);
+    span.addItems(_c4IndexUpdater->count());
     auto lock = _db->c4db()->useLocked();
     _c4IndexUpdater->finish(); // Ignore return value
     _c4IndexUpdater = nullptr;
@@ -141,4 +190,182 @@ CBLBlob* CBLIndexUpdater::getBlob(Dict blobDict, const C4BlobKey &key) {
     return i->second;
 }
 
+#pragma mark - CBLLazyIndexWorker:
+
+static constexpr unsigned kDefaultLazyIndexBatchSize = 256;
+
+static CBLLazyIndexWorkerConfiguration withDefaults(CBLLazyIndexWorkerConfiguration config) {
+    if (config.batchSize == 0)
+        config.batchSize = kDefaultLazyIndexBatchSize;
+    if (config.maxBusyPercent == 0 || config.maxBusyPercent > 100)
+        config.maxBusyPercent = 100;
+    return config;
+}
+
+CBLLazyIndexWorker::CBLLazyIndexWorker(CBLQueryIndex* index, const CBLLazyIndexWorkerConfiguration& config)
+:_index(index)
+,_config(withDefaults(config))
+,_values(_config.batchSize)
+,_vectors(_config.batchSize * _config.dimension)
+,_hasVector(new bool[_config.batchSize])
+{ }
+
+CBLLazyIndexWorker::~CBLLazyIndexWorker() {
+    stop();
+}
+
+void CBLLazyIndexWorker::start() {
+    // The listener is added and removed without holding `_mutex`, since it's called with the
+    // collection's listener lock held, and takes `_mutex` itself:
+    std::lock_guard<std::mutex> startStopLock(_startStopMutex);
+    if (_listenerToken)
+        return;
+    auto token = _index->collection()->addChangeListener(&changed, this);
+    // The token retains me until `stop` removes it, so `changed` is never called on a worker
+    // that's being freed:
+    retain(this);
+    token->extraInfo() = {this, [](void *worker) {release((CBLLazyIndexWorker*)worker);}};
+    
+    LOCK(_mutex);
+    _listenerToken = std::move(token);
+    _running = true;
+    if (!_scheduled)
+        scheduleUnLock(Clock::duration::zero());
+}
+
+void CBLLazyIndexWorker::stop() {
+    // The token is released last, after the locks, since releasing it may free me:
+    Retained<CBLListenerToken> token;
+    {
+        LOCK(_startStopMutex);
+        {
+            LOCK(_mutex);
+            _running = false;
+            token = std::move(_listenerToken);
+        }
+        if (token)
+            token->remove();
+    }
+}
+
+CBLLazyIndexWorkerStats CBLLazyIndexWorker::stats() const {
+    LOCK(_mutex);
+    return _stats;
+}
+
+void CBLLazyIndexWorker::changed(void* context, const CBLCollectionChange* change) {
+    ((CBLLazyIndexWorker*)context)->changed(change->numDocs);
+}
+
+void CBLLazyIndexWorker::changed(unsigned numDocs) {
+    LOCK(_mutex);
+    _stats.pendingChanges += numDocs;
+    _stats.caughtUp = false;
+    if (!_running)
+        return;
+    if (_scheduled)
+        _dirty = true;          // The pending run will go around again
+    else
+        scheduleUnLock(std::chrono::milliseconds(_config.changeDelay));
+}
+
+// Must be called with `_mutex` locked, when no run is scheduled.
+void CBLLazyIndexWorker::scheduleUnLock(Clock::duration delay) {
+    _scheduled = true;
+    retain(this);               // Released when the run is done
+    auto runTask = [](void *context) {
+        auto worker = (CBLLazyIndexWorker*)context;
+        worker->run();
+        release(worker);
+    };
+    if (delay <= Clock::duration::zero()) {
+        AsyncTasks::runBlocking(runTask, this);
+    } else {
+        // Don't run the batch on the timer's thread, which other listeners' timers share:
+        ListenerTimer::shared().schedule(Clock::now() + delay, [this, runTask] {
+            AsyncTasks::runBlocking(runTask, this);
+        });
+    }
+}
+
+void CBLLazyIndexWorker::run() {
+    {
+        LOCK(_mutex);
+        if (!_running) {
+            _scheduled = false;
+            return;
+        }
+        _dirty = false;
+    }
+    
+    auto start = Clock::now();
+    size_t count = 0;
+    bool ok = false;
+    try {
+        count = runBatch(ok);
+    } catch (...) {
+        cbl_internal::BridgeException("CBLLazyIndexWorker", nullptr);
+    }
+    auto elapsed = Clock::now() - start;
+    
+    LOCK(_mutex);
+    _stats.busyTime += std::chrono::duration<double, std::milli>(elapsed).count();
+    if (ok) {
+        if (count > 0) {
+            _stats.documentsIndexed += count;
+            _stats.batchCount++;
+            _stats.pendingChanges -= std::min<uint64_t>(_stats.pendingChanges, count);
+        }
+    } else {
+        _stats.failedBatchCount++;
+    }
+    if (_stats.busyTime > 0)
+        _stats.documentsPerSecond = _stats.documentsIndexed / (_stats.busyTime / 1000.0);
+    
+    // A full batch probably means there's more to do; a failed one will fail again, until the
+    // documents change:
+    bool more = ok && count >= _config.batchSize;
+    if (ok && !more) {
+        _stats.caughtUp = !_dirty;
+        if (!_dirty)
+            _stats.pendingChanges = 0;
+    }
+    _scheduled = false;
+    if (_running && (more || _dirty)) {
+        // Pause long enough to keep the time spent on batches within `maxBusyPercent`:
+        auto pause = elapsed * (100 - _config.maxBusyPercent) / _config.maxBusyPercent;
+        if (!more)
+            pause = std::max<Clock::duration>(pause, std::chrono::milliseconds(_config.changeDelay));
+        scheduleUnLock(pause);
+    }
+}
+
+// Updates the index with one batch; returns the number of documents in it. Called only by `run`,
+// so it doesn't need to lock `_mutex` to use the buffers.
+size_t CBLLazyIndexWorker::runBatch(bool &ok) {
+    ok = false;
+    auto updater = _index->beginUpdate(_config.batchSize);
+    if (!updater) {
+        ok = true;              // Already up to date
+        return 0;
+    }
+    
+    size_t count = updater->count(), dimension = _config.dimension;
+    for (size_t i = 0; i < count; ++i) {
+        _values[i] = updater->value(i);
+        _hasVector[i] = true;
+    }
+    if (!_config.embedder(_config.context, _values.data(), count, dimension,
+                          _vectors.data(), _hasVector.get())) {
+        // Leave the documents unindexed; the updater is discarded without being finished.
+        return count;
+    }
+    
+    for (size_t i = 0; i < count; ++i)
+        updater->setVector(i, _hasVector[i] ? &_vectors[i * dimension] : nullptr, dimension);
+    updater->finish();
+    ok = true;
+    return count;
+}
+
 #endif
@@ -31,6 +31,16 @@ CBLCollection* CBLQueryIndex_Collection(const CBLQueryIndex* index) noexcept {
     } catchAndWarn()
 }
 
+CBLQueryIndexStats CBLQueryIndex_Stats(const CBLQueryIndex* index) noexcept {
+    try {
+        return index->collection()->database()->indexUsage().get(index->name());
+    } catchAndWarn()
+}
+
+void CBLDatabase_SetIndexUsageTracking(CBLDatabase* db, bool enabled) noexcept {
+    db->indexUsage().setEnabled(enabled);
+}
+
 #ifdef COUCHBASE_ENTERPRISE
 
 CBLIndexUpdater* _cbl_nullable CBLQueryIndex_BeginUpdate(CBLQueryIndex* index, size_t limit,
@@ -63,6 +73,15 @@ bool CBLIndexUpdater_SetVector(CBLIndexUpdater* updater, size_t index, const flo
     } catchAndBridge(outError)
 }
 
+bool CBLIndexUpdater_SetVectors(CBLIndexUpdater* updater, size_t startIndex, const float vectors[],
+                                size_t count, size_t dimension, CBLError* _cbl_nullable outError) noexcept
+{
+    try {
+        updater->setVectors(startIndex, vectors, count, dimension);
+        return true;
+    } catchAndBridge(outError)
+}
+
 void CBLIndexUpdater_SkipVector(CBLIndexUpdater* updater, size_t index) noexcept {
     try {
         updater->skipVector(index);
@@ -76,4 +95,33 @@ bool CBLIndexUpdater_Finish(CBLIndexUpdater* updater, CBLError* _cbl_nullable ou
     } catchAndBridge(outError)
 }
 
+CBLLazyIndexWorker* _cbl_nullable CBLLazyIndexWorker_Create(CBLQueryIndex* index,
+                                                            const CBLLazyIndexWorkerConfiguration* config,
+                                                            CBLError* _cbl_nullable outError) noexcept
+{
+    try {
+        if (!config->embedder || config->dimension == 0) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "A lazy index worker requires an embedder and a dimension.");
+        }
+        return retain(new CBLLazyIndexWorker(index, *config));
+    } catchAndBridge(outError)
+}
+
+void CBLLazyIndexWorker_Start(CBLLazyIndexWorker* worker) noexcept {
+    try {
+        worker->start();
+    } catchAndWarn()
+}
+
+void CBLLazyIndexWorker_Stop(CBLLazyIndexWorker* worker) noexcept {
+    try {
+        worker->stop();
+    } catchAndWarn()
+}
+
+CBLLazyIndexWorkerStats CBLLazyIndexWorker_Stats(const CBLLazyIndexWorker* worker) noexcept {
+    return worker->stats();
+}
+
 #endif
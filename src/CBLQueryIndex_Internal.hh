@@ -18,10 +18,17 @@
 
 #pragma once
 #include "access_lock.hh"
+#include "CBLCollection.h"
+#include "CBLQueryIndex.h"
 #include "CBLDatabase_Internal.hh"
 #include "Internal.hh"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 CBL_ASSUME_NONNULL_BEGIN
 
@@ -42,6 +49,42 @@ private:
     litecore::shared_access_lock<Retained<C4Index>> _c4Index;
 };
 
+/** Creates an index on one of LiteCore's async-task threads. */
+struct CBLIndexBuild final : public CBLRefCounted {
+public:
+    using Builder = std::function<void()>;
+    
+    CBLIndexBuild(slice name, Builder builder,
+                  CBLIndexBuildCallback _cbl_nullable callback, void* _cbl_nullable context)
+    :_name(name)
+    ,_builder(std::move(builder))
+    ,_callback(callback)
+    ,_context(context)
+    { }
+    
+    slice name() const                  {return _name;}
+    CBLIndexBuildState state() const    {return _state.load();}
+    
+    void start();
+    
+    /** Returns true if the build hasn't started, and now won't. */
+    bool cancel() {
+        CBLIndexBuildState state = kCBLIndexBuildPending;
+        return _state.compare_exchange_strong(state, kCBLIndexBuildCancelled)
+            || state == kCBLIndexBuildCancelled;
+    }
+    
+private:
+    void run();
+    void callBack(CBLIndexBuildState state, const CBLError* _cbl_nullable error);
+    
+    alloc_slice const                       _name;
+    Builder const                           _builder;       // Creates the index
+    CBLIndexBuildCallback _cbl_nullable     _callback;
+    void* _cbl_nullable const               _context;       // Passed to _callback
+    std::atomic<CBLIndexBuildState>         _state {kCBLIndexBuildPending};
+};
+
 #ifdef COUCHBASE_ENTERPRISE
 
 struct CBLIndexUpdater final : public CBLRefCounted {
@@ -56,6 +99,8 @@ public:
 
     void setVector(size_t index, const float* _cbl_nullable vector, size_t dimension);
 
+    void setVectors(size_t startIndex, const float* vectors, size_t count, size_t dimension);
+
     void skipVector(size_t index);
 
     void finish();
@@ -81,6 +126,47 @@ private:
     std::unordered_map<FLDict, Retained<CBLBlob>>           _blobs;        // Cached CBLBLobs, keyed by FLDict
 };
 
+/** Updates a lazy vector index in the background, one batch at a time, whenever its collection
+    changes. Batches run on LiteCore's async-task threads; pauses and change delays use the
+    shared ListenerTimer. */
+struct CBLLazyIndexWorker final : public CBLRefCounted {
+public:
+    CBLLazyIndexWorker(CBLQueryIndex* index, const CBLLazyIndexWorkerConfiguration& config);
+    
+    ~CBLLazyIndexWorker();
+    
+    void start();
+    
+    void stop();
+    
+    CBLLazyIndexWorkerStats stats() const;
+    
+private:
+    using Clock = std::chrono::steady_clock;
+    
+    static void changed(void* _cbl_nullable context, const CBLCollectionChange* change);
+    void changed(unsigned numDocs);
+    void scheduleUnLock(Clock::duration delay);
+    void run();
+    size_t runBatch(bool &ok);
+    
+    std::mutex                                              _startStopMutex;
+    mutable std::mutex                                      _mutex;
+    
+    Retained<CBLQueryIndex> const                           _index;
+    CBLLazyIndexWorkerConfiguration const                   _config;
+    
+    Retained<CBLListenerToken>                              _listenerToken;
+    bool                                                    _running {false};
+    bool                                                    _scheduled {false};   // A run is pending
+    bool                                                    _dirty {false};       // Changed since the run began
+    CBLLazyIndexWorkerStats                                 _stats {};
+    // Buffers for one batch, used only by runBatch():
+    std::vector<FLValue>                                    _values;
+    std::vector<float>                                      _vectors;
+    std::unique_ptr<bool[]>                                 _hasVector;
+};
+
 #endif
 
 CBL_ASSUME_NONNULL_END
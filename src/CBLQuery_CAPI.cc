@@ -21,6 +21,8 @@
 #include "CBLDatabase_Internal.hh"
 #include "CBLCollection_Internal.hh"
 #include "CBLQuery_Internal.hh"
+#include "FullTextMatcher.hh"
+#include <algorithm>
 #include <string>
 
 using namespace std;
@@ -41,6 +43,12 @@ CBLQuery* CBLDatabase_CreateQuery(const CBLDatabase* db,
     } catchAndBridge(outError)
 }
 
+CBLQueryCacheStats CBLDatabase_QueryCacheStats(const CBLDatabase* db) noexcept {
+    try {
+        return db->queryCacheStats();
+    } catchAndWarn();
+}
+
 FLDict CBLQuery_Parameters(const CBLQuery* query) noexcept {
     return query->parameters();
 }
@@ -49,12 +57,65 @@ void CBLQuery_SetParameters(CBLQuery* query, FLDict parameters) noexcept {
     query->setParameters(parameters);
 }
 
+void CBLQuery_SetParamInt64(CBLQuery* query, FLString name, int64_t value) noexcept {
+    query->setParameter(name, [=](FLSlot slot) {FLSlot_SetInt(slot, value);});
+}
+
+void CBLQuery_SetParamDouble(CBLQuery* query, FLString name, double value) noexcept {
+    query->setParameter(name, [=](FLSlot slot) {FLSlot_SetDouble(slot, value);});
+}
+
+void CBLQuery_SetParamString(CBLQuery* query, FLString name, FLString value) noexcept {
+    query->setParameter(name, [=](FLSlot slot) {FLSlot_SetString(slot, value);});
+}
+
+void CBLQuery_SetParamBool(CBLQuery* query, FLString name, bool value) noexcept {
+    query->setParameter(name, [=](FLSlot slot) {FLSlot_SetBool(slot, value);});
+}
+
+void CBLQuery_SetParamValue(CBLQuery* query, FLString name, FLValue value) noexcept {
+    query->setParameter(name, [=](FLSlot slot) {FLSlot_SetValue(slot, value);});
+}
+
+void CBLQuery_SetParamVector(CBLQuery* query, FLString name,
+                             const float vector[], size_t dimensions) noexcept
+{
+    query->setParameter(name, [=](FLSlot slot) {
+        FLMutableArray array = FLMutableArray_New();
+        for (size_t i = 0; i < dimensions; ++i)
+            FLSlot_SetFloat(FLMutableArray_Append(array), vector[i]);
+        FLSlot_SetValue(slot, (FLValue)array);
+        FLMutableArray_Release(array);
+    });
+}
+
+void CBLQuery_SetResultCacheSize(CBLQuery* query, uint32_t maxEntries) noexcept {
+    query->setResultCacheSize(maxEntries);
+}
+
+CBLQueryResultCacheStats CBLQuery_ResultCacheStats(const CBLQuery* query) noexcept {
+    return query->resultCacheStats();
+}
+
 CBLResultSet* CBLQuery_Execute(CBLQuery* query, CBLError* outError) noexcept {
     try {
         return query->execute().detach();
     } catchAndBridge(outError)
 }
 
+CBLResultSet* CBLQuery_ExecuteWithStats(CBLQuery* query, CBLError* outError) noexcept {
+    try {
+        return query->execute(true).detach();
+    } catchAndBridge(outError)
+}
+
+void CBLQuery_SetStatsSampler(uint32_t sampleInterval,
+                              CBLQueryStatsCallback callback,
+                              void* context) noexcept
+{
+    CBLResultSet::setSampler(sampleInterval, callback, context);
+}
+
 FLSliceResult CBLQuery_Explain(const CBLQuery* query) noexcept {
     try {
         return FLSliceResult(query->explain());
@@ -76,6 +137,59 @@ CBLListenerToken* CBLQuery_AddChangeListener(CBLQuery* query,
     return query->addChangeListener(listener, context).detach();
 }
 
+CBLListenerToken* CBLQuery_AddChangeListenerWithOptions(CBLQuery* query,
+                                                        CBLQueryChangeListener listener,
+                                                        void *context,
+                                                        const CBLQueryChangeListenerOptions* options) noexcept
+{
+    return query->addChangeListener(listener, context, options).detach();
+}
+
+uint32_t CBLQuery_CoalescedChangeCount(const CBLQuery* query,
+                                       CBLListenerToken *token) noexcept
+{
+    auto listener = query->getChangeListener(token);
+    return listener ? listener->coalescedChanges() : 0;
+}
+
+namespace {
+    struct QueryDiffContext {
+        CBLQueryDiffListener listener;
+        void* context;
+        QueryDiffer differ;
+    };
+}
+
+CBLListenerToken* CBLQuery_AddDiffListener(CBLQuery* query,
+                                           CBLQueryDiffListener listener,
+                                           void *context) noexcept
+{
+    auto wrappedContext = new QueryDiffContext{listener, context, {}};
+    
+    // Listener calls are serialized by the token, so the differ needs no locking:
+    auto wrappedListener = [](void* context, CBLQuery* query, CBLListenerToken* token) {
+        auto ctx = static_cast<QueryDiffContext*>(context);
+        try {
+            auto listener = query->getChangeListener(token);
+            if (!listener)
+                return;
+            Retained<CBLResultSet> rs = listener->resultSet();
+            auto &changes = ctx->differ.diff(rs);
+            if (!changes.empty())
+                ctx->listener(ctx->context, query, changes.data(), changes.size());
+        } catch (...) {
+            BridgeException(__FUNCTION__, nullptr);
+        }
+    };
+    
+    auto token = query->addChangeListener(wrappedListener, wrappedContext);
+    token->extraInfo().pointer = wrappedContext;
+    token->extraInfo().destructor = [](void* ctx) {
+        delete static_cast<QueryDiffContext*>(ctx);
+    };
+    return std::move(token).detach();
+}
+
 CBLResultSet* CBLQuery_CopyCurrentResults(const CBLQuery* query,
                                           CBLListenerToken *token,
                                           CBLError *outError) noexcept
@@ -89,18 +203,88 @@ CBLResultSet* CBLQuery_CopyCurrentResults(const CBLQuery* query,
     return listener->resultSet().detach();
 }
 
+bool CBLQuery_ExecuteToJSON(CBLQuery* query,
+                            CBLQueryJSONWriteCallback callback,
+                            void* context,
+                            CBLQueryJSONFormat format,
+                            CBLError* outError) noexcept
+{
+    try {
+        bool finished = query->executeToJSON(format, [&](slice chunk) {
+            return callback(context, chunk);
+        });
+        if (!finished && outError)
+            outError->code = 0;
+        return finished;
+    } catchAndBridge(outError)
+}
+
+CBLQueryExecution* CBLQuery_ExecuteAsync(CBLQuery* query,
+                                         CBLQueryExecuteCallback callback,
+                                         void* context) noexcept
+{
+    try {
+        auto execution = retained(new CBLQueryExecution(query, callback, context));
+        execution->start();
+        return std::move(execution).detach();
+    } catchAndWarn();
+}
+
+bool CBLQueryExecution_Cancel(CBLQueryExecution* execution) noexcept {
+    return execution->cancel();
+}
+
+void CBLQuery_SetAsyncExecutor(CBLQueryExecutor executor, void* context) noexcept {
+    CBLQueryExecution::setExecutor(executor, context);
+}
+
 void CBLQuery_SetListenerCallbackDelay(int delayMS) noexcept {
 #ifdef DEBUG
     ListenerToken<CBLQueryChangeListener>::setC4QueryObserverCallbackDelay(delayMS);
 #endif
 }
 
+/** Private API */
+uint64_t CBLResultSet_HeapAllocationCount(void) noexcept {
+    return CBLResultSet::heapAllocationCount();
+}
+
 bool CBLResultSet_Next(CBLResultSet* rs) noexcept {
     try {
         return rs->next();
     } catchAndWarn();
 }
 
+size_t CBLResultSet_NextBatch(CBLResultSet* rs, size_t maxRows, FLValue outValues[]) noexcept {
+    try {
+        return rs->nextBatch(maxRows, outValues);
+    } catchAndWarn();
+}
+
+size_t CBLResultSet_ReadColumnDoubles(CBLResultSet* rs, unsigned column, double outValues[],
+                                      size_t maxRows, uint8_t* outNullBitmap) noexcept
+{
+    try {
+        return rs->readColumn(column, outValues, maxRows, outNullBitmap);
+    } catchAndWarn();
+}
+
+size_t CBLResultSet_ReadColumnInt64s(CBLResultSet* rs, unsigned column, int64_t outValues[],
+                                     size_t maxRows, uint8_t* outNullBitmap) noexcept
+{
+    try {
+        return rs->readColumn(column, outValues, maxRows, outNullBitmap);
+    } catchAndWarn();
+}
+
+size_t CBLResultSet_ReadColumnStrings(CBLResultSet* rs, unsigned column, FLString outValues[],
+                                      size_t maxRows, uint8_t* outNullBitmap) noexcept
+{
+    try {
+        return rs->readColumn(column, outValues, maxRows, outNullBitmap);
+    } catchAndWarn();
+}
+
 FLValue CBLResultSet_ValueForKey(const CBLResultSet* rs, FLString property) noexcept {
     return rs->property(property);
 }
@@ -117,6 +301,68 @@ FLDict CBLResultSet_ResultDict(const CBLResultSet *rs) noexcept {
     return rs->asDict();
 }
 
+void CBLResultSet_SetReuseResults(CBLResultSet *rs, bool reuse) noexcept {
+    rs->setReuseResults(reuse);
+}
+
 CBLQuery* CBLResultSet_GetQuery(const CBLResultSet *rs) noexcept {
     return rs->query();
 }
+
+FLMutableArray CBLResultSet_CopyCursor(const CBLResultSet* rs,
+                                       const unsigned keyColumns[],
+                                       size_t numKeyColumns) noexcept
+{
+    try {
+        return FLMutableArray_Retain(rs->copyCursor(keyColumns, numKeyColumns));
+    } catchAndWarn();
+}
+
+void CBLQuery_SetCursor(CBLQuery* query, FLArray cursor) noexcept {
+    query->setCursor(cursor);
+}
+
+FLMutableArray CBLDatabase_QueryCollections(CBLDatabase* db,
+                                            FLString queryTemplate,
+                                            const CBLCollection* const collections[],
+                                            size_t numCollections,
+                                            FLDict parameters,
+                                            const CBLQuerySortColumn sortColumns[],
+                                            size_t numSortColumns,
+                                            uint64_t limit,
+                                            CBLError* outError) noexcept
+{
+    try {
+        return FLMutableArray_Retain(db->queryCollections(queryTemplate, collections, numCollections,
+                                                          parameters, sortColumns, numSortColumns,
+                                                          limit));
+    } catchAndBridge(outError)
+}
+
+size_t CBLFullText_FindMatches(FLString text,
+                               FLString terms,
+                               CBLFullTextMatch outMatches[],
+                               size_t maxMatches) noexcept
+{
+    try {
+        auto matches = FullTextMatcher(terms).matches(text);
+        std::copy_n(matches.begin(), std::min(maxMatches, matches.size()), outMatches);
+        return matches.size();
+    } catchAndWarn()
+}
+
+FLSliceResult CBLFullText_Snippet(FLString text,
+                                  FLString terms,
+                                  const CBLFullTextSnippetOptions* options) noexcept
+{
+    try {
+        return FLSliceResult(FullTextMatcher(terms).snippet(text, options ? *options
+                                                                          : CBLFullTextSnippetOptions{}));
+    } catchAndWarn()
+}
+
+bool CBLResultSet_GetStats(const CBLResultSet* rs, CBLQueryStats* outStats) noexcept {
+    try {
+        return rs->getStats(*outStats);
+    } catchAndWarn();
+}
@@ -22,16 +22,26 @@
 #include "Internal.hh"
 #include "Listener.hh"
 #include "ContextManager.hh"
+#include "MemoryStats.hh"
+#include "ObjectPool.hh"
+#include "Trace.hh"
 #include "c4Query.hh"
 #include "access_lock.hh"
 #include "fleece/Expert.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include "fleece/function_ref.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #ifdef DEBUG
-#include <chrono>
 #include <thread>
 #endif
 
@@ -57,14 +67,17 @@ public:
     }
 
     unsigned columnCount() const {
-        return _c4query.useLocked()->columnCount();
+        return unsigned(columns().titles.size());
     }
 
     slice columnName(unsigned col) const {
-        return _c4query.useLocked()->columnTitle(col);
+        auto &titles = columns().titles;
+        return (col < titles.size()) ? slice(titles[col]) : nullslice;
     }
 
     Dict parameters() const {
+        if (_boundParameters)
+            return _boundParameters;
         if (!_parameters)
             return nullptr;
         return ValueFromData(_parameters, kFLTrusted).asDict();
@@ -82,62 +95,248 @@ public:
         _encodeParameters(enc);
     }
 
-    inline Retained<CBLResultSet> execute();
+    /** Binds the values of a keyset-pagination cursor to the parameters `cursor0`, `cursor1`... */
+    void setCursor(Array cursor) {
+        auto c4query = _c4query.useLocked();
+        uint32_t i = 0;
+        for (Array::iterator iter(cursor); iter; ++iter, ++i) {
+            std::string name = "cursor" + std::to_string(i);
+            Value value = iter.value();
+            setParameter(name, [=](FLSlot slot) {FLSlot_SetValue(slot, value);});
+        }
+    }
+
+    /** Binds a single parameter, leaving the others as they are. The bindings are only encoded
+        when the query next runs, so binding several parameters costs one encoding. `setter`
+        is called with the parameter's FLSlot. */
+    template <class SETTER>
+    void setParameter(slice name, SETTER setter) {
+        auto c4query = _c4query.useLocked();
+        if (!_boundParameters) {
+            Dict current = parameters();
+            _boundParameters = current ? current.mutableCopy() : MutableDict::newDict();
+        }
+        setter(FLMutableDict_Set(_boundParameters, name));
+        _parametersChanged = true;
+        // A live query's observer runs with the C4Query's own parameters, so update it now:
+        if (!_listeners.empty())
+            _flushParameters(c4query.get());
+    }
 
-    using ColumnNamesMap = std::unordered_map<slice, uint32_t>;
+    /** Runs the query. If `profile` is true, or the execution is picked by the stats sampler,
+        the result set collects a \ref CBLQueryStats. */
+    inline Retained<CBLResultSet> execute(bool profile =false);
+
+    /** Implements \ref CBLQuery_SetResultCacheSize. */
+    void setResultCacheSize(uint32_t maxEntries) {
+        auto c4query = _c4query.useLocked();
+        _resultCacheSize = maxEntries;
+        while (_resultCache.size() > maxEntries)
+            _resultCache.pop_back();
+    }
+
+    CBLQueryResultCacheStats resultCacheStats() const {
+        auto c4query = _c4query.useLocked();
+        CBLQueryResultCacheStats stats = _resultCacheStats;
+        stats.count = uint32_t(_resultCache.size());
+        return stats;
+    }
+
+    /** What the query plan (see `explain`) reveals about the query's use of indexes. */
+    struct Plan {
+        Doc     indexesUsed;            // Fleece array of index names
+        bool    fullScan {false};
+        bool    usesTempBTree {false};
+    };
+
+    const Plan& plan() const;
+
+    /// Milliseconds taken to compile the query; 0 if it came from the query cache.
+    double compileTime() const          {return _compileTime;}
+
+    /** Runs the query and passes its results as JSON to `write`, in chunks. Returns false if
+        `write` returned false. */
+    bool executeToJSON(CBLQueryJSONFormat format, fleece::function_ref<bool(slice)> write);
 
     int columnNamed(slice name) const {
-        call_once(_onceColumnNames, [this]{
-            ColumnNamesMap names;
-            unsigned nCols = columnCount();
-            names.reserve(nCols);
-            for (unsigned col = 0; col < nCols; ++col)
-                names.insert({columnName(col), col});
-            _columnNames = names;
-        });
-        auto i = _columnNames->find(name);
-        return (i != _columnNames->end()) ? i->second : -1;
+        auto &indexes = columns().indexes;
+        auto i = indexes.find(name);
+        return (i != indexes.end()) ? i->second : -1;
     }
 
     inline Retained<CBLListenerToken> addChangeListener(CBLQueryChangeListener listener,
-                                                        void* _cbl_nullable context);
+                                                        void* _cbl_nullable context,
+                                                        const CBLQueryChangeListenerOptions* _cbl_nullable options =nullptr);
 
     ListenerToken<CBLQueryChangeListener>* getChangeListener(CBLListenerToken *token) const {
         return _listeners.find(token);
     }
 
+    /** True while the current thread is running a query with `execute`, rather than, say,
+        updating an index as a document is saved. */
+    static bool isExecuting()                   {return sExecuting > 0;}
+
+    /** Called when a prediction made while executing times out, leaving it without output;
+        the results of that execution aren't cached, since they're missing it. */
+    static void predictionTimedOut()            {++sTimedOutPredictions;}
+
 private:
     friend struct CBLDatabase;
+    friend struct CBLResultSet;
     friend struct cbl_internal::ListenerToken<CBLQueryChangeListener>;
 
+    // Marks the current thread as running a query, for `isExecuting`:
+    struct Executing {
+        Executing()                             {++sExecuting;}
+        ~Executing()                            {--sExecuting;}
+    };
+    static inline thread_local int sExecuting = 0;
+    static inline thread_local unsigned sTimedOutPredictions = 0;
+
+    // Results kept by the result cache: the enumerator of a released result set, which can be
+    // restarted, and the parameters and data version it was run with.
+    struct CachedResults {
+        alloc_slice             parameters;
+        uint64_t                dataVersion;
+        C4Query::Enumerator     results;
+    };
+
+    // The column titles are copied, since the C4Query may be replaced (see _makeExclusive)
+    // and they're needed for every result row.
+    struct Columns {
+        std::vector<alloc_slice>            titles;     // Column titles, by index
+        std::unordered_map<slice, uint32_t> indexes;    // Maps column title to index
+    };
+
+    const Columns& columns() const {
+        call_once(_onceColumns, [this]{
+            auto c4query = _c4query.useLocked();
+            unsigned nCols = c4query->columnCount();
+            _columns.titles.reserve(nCols);
+            _columns.indexes.reserve(nCols);
+            for (unsigned col = 0; col < nCols; ++col) {
+                _columns.titles.emplace_back(c4query->columnTitle(col));
+                _columns.indexes.insert({_columns.titles.back(), col});
+            }
+        });
+        return _columns;
+    }
+
     CBLQuery(const CBLDatabase *db,
              Retained<C4Query>&& c4query,
-             const litecore::access_lock<Retained<C4Database>> &owner)
+             const litecore::access_lock<Retained<C4Database>> &owner,
+             CBLQueryLanguage language,
+             slice queryString,
+             bool shared,
+             double compileTime)
     :_c4query(std::move(c4query), owner)
     ,_database(db)
+    ,_language(language)
+    ,_queryString(queryString)
+    ,_compileTime(compileTime)
+    ,_shared(shared)
     { }
 
     void _encodeParameters(Encoder &enc) {
+        alloc_slice encodedParameters = enc.finish();
+        if (!encodedParameters)
+            C4Error::raise(FleeceDomain, enc.error(), "%s", enc.errorMessage());
+        auto c4query = _c4query.useLocked();
+        _boundParameters = nullptr;
+        _parametersChanged = false;
+        _parameters = encodedParameters;
+        // A shared C4Query must not keep one CBLQuery's parameters; they're passed to run() instead.
+        if (!_shared)
+            c4query->setParameters(encodedParameters);
+    }
+
+    // Encodes the parameters bound by `setParameter`, if they've changed. Must be called with
+    // the C4Query locked.
+    void _flushParameters(C4Query *c4query) {
+        if (!_parametersChanged)
+            return;
+        Encoder enc;
+        enc.writeValue(_boundParameters);
         alloc_slice encodedParameters = enc.finish();
         if (!encodedParameters)
             C4Error::raise(FleeceDomain, enc.error(), "%s", enc.errorMessage());
         _parameters = encodedParameters;
-        _c4query.useLocked()->setParameters(encodedParameters);
+        _parametersChanged = false;
+        if (!_shared)
+            c4query->setParameters(encodedParameters);
+    }
+
+    // Removes the cached results for the current parameters, returning them if they're of
+    // `dataVersion`. Must be called with the C4Query locked.
+    std::optional<C4Query::Enumerator> _takeCachedResults(uint64_t dataVersion) {
+        for (auto i = _resultCache.begin(); i != _resultCache.end(); ++i) {
+            if (i->parameters == _parameters) {
+                std::optional<C4Query::Enumerator> results;
+                if (i->dataVersion == dataVersion) {
+                    results.emplace(std::move(i->results));
+                    results->restart();
+                    ++_resultCacheStats.hits;
+                } else {
+                    ++_resultCacheStats.invalidations;
+                }
+                _resultCache.erase(i);
+                return results;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // Called by a result set from `execute`, when it's freed, to cache its results.
+    void _cacheResults(alloc_slice parameters, uint64_t dataVersion, C4Query::Enumerator &&results) {
+        auto c4query = _c4query.useLocked();
+        if (_resultCacheSize == 0)
+            return;
+        _resultCache.remove_if([&](const CachedResults &c) {return c.parameters == parameters;});
+        _resultCache.push_front({std::move(parameters), dataVersion, std::move(results)});
+        if (_resultCache.size() > _resultCacheSize)
+            _resultCache.pop_back();
+    }
+
+    // An observer runs the C4Query with its own parameters, so a query that shares its C4Query
+    // with the database's query cache gets a private copy before a listener is added.
+    void _makeExclusive() {
+        auto c4query = _c4query.useLocked();
+        _flushParameters(c4query.get());
+        if (!_shared)
+            return;
+        Retained<C4Query> exclusive = _database->compileQuery(_language, _queryString, nullptr);
+        if (!exclusive)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Couldn't recompile query");
+        if (_parameters)
+            exclusive->setParameters(_parameters);
+        c4query.get() = std::move(exclusive);
+        _shared = false;
     }
 
     litecore::shared_access_lock<Retained<C4Query>> _c4query;           // Thread-safe access to C4Query
     RetainedConst<CBLDatabase>                      _database;          // Owning database
+    CBLQueryLanguage const                          _language;          // Query language
+    alloc_slice const                               _queryString;       // Query source (JSON5 converted)
+    double const                                    _compileTime;       // Milliseconds to compile
+    bool                                            _shared;            // C4Query is in the query cache
     alloc_slice                                     _parameters;        // Fleece-encoded param values
-    mutable std::optional<ColumnNamesMap>           _columnNames;       // Maps colum name to index
-    mutable std::once_flag                          _onceColumnNames;   // For lazy init of _columnNames
+    MutableDict                                     _boundParameters;   // Set by setParameter()
+    bool                                            _parametersChanged {false}; // Must re-encode
+    mutable Columns                                 _columns;           // Column titles and indexes
+    mutable std::once_flag                          _onceColumns;       // For lazy init of _columns
+    mutable Plan                                    _plan;              // Parsed from explain()
+    mutable std::once_flag                          _oncePlan;          // For lazy init of _plan
     Listeners<CBLQueryChangeListener>               _listeners;         // Query listeners
+    std::list<CachedResults>                        _resultCache;       // Most recently used first
+    uint32_t                                        _resultCacheSize {0}; // Max entries; 0 if disabled
+    CBLQueryResultCacheStats                        _resultCacheStats {};
 };
 
 
 #pragma mark - RESULT SET CLASS:
 
 
-struct CBLResultSet final : public CBLRefCounted {
+struct CBLResultSet final : public CBLRefCounted, public cbl_internal::Pooled<CBLResultSet> {
 public:
     CBLResultSet(CBLQuery* query, C4Query::Enumerator qe);
     
@@ -145,18 +344,51 @@ public:
 
     bool next();
 
+    size_t nextBatch(size_t maxRows, FLValue _cbl_nullable outValues[]);
+
+    size_t readColumn(unsigned col, double outValues[], size_t maxRows, uint8_t* _cbl_nullable outNulls);
+    size_t readColumn(unsigned col, int64_t outValues[], size_t maxRows, uint8_t* _cbl_nullable outNulls);
+    size_t readColumn(unsigned col, FLString outValues[], size_t maxRows, uint8_t* _cbl_nullable outNulls);
+
     Value property(slice prop) const;
 
     Value column(unsigned col) const    {return _enum.column(col);}
 
     Array asArray() const;
 
+    /// Copies the current row's values of the given columns, as a keyset-pagination cursor.
+    MutableArray copyCursor(const unsigned keyColumns[], size_t numKeyColumns) const;
+
     Dict asDict() const;
 
+    /// If true, asArray() and asDict() refill the same containers for every row.
+    void setReuseResults(bool reuse)    {_reuseResults = reuse;}
+
     CBLQuery* query() const             {return _query;}
 
     static Retained<CBLResultSet> containing(Value v);
 
+    /// Starts collecting stats, timed from `start`. If `sampled`, they'll be passed to the
+    /// stats sampler's callback when the results have been read or the result set is freed.
+    void startProfiling(std::chrono::steady_clock::time_point start, bool sampled);
+
+    /// Gets the stats, returning false if the execution isn't being profiled.
+    bool getStats(CBLQueryStats &outStats) const;
+
+    /// Returns true if the stats sampler wants the next execution to be profiled.
+    static bool shouldSample();
+
+    /// Makes the result set give its results to the query's result cache when it's freed.
+    void cacheWhenFreed(alloc_slice parameters, uint64_t dataVersion) {
+        _cacheParameters = std::move(parameters);
+        _cacheDataVersion = dataVersion;
+    }
+
+    /// Traces reading the first row as a child of the given span, the execution's.
+    void traceFirstRow(cbl_internal::TraceSpan::Context execution)  {_firstRowTrace = execution;}
+
+    static void setSampler(uint32_t interval, CBLQueryStatsCallback _cbl_nullable, void* _cbl_nullable context);
+
     CBLBlob* getBlob(Dict blobDict, const C4BlobKey&);
     
 #ifdef COUCHBASE_ENTERPRISE
@@ -164,23 +396,110 @@ public:
 #endif
 
 private:
-    using ValueToBlobMap = std::unordered_map<FLDict, Retained<CBLBlob>>;
+    using ValueToBlobMap = cbl_internal::LazyValueMap<CBLBlob>;
 #ifdef COUCHBASE_ENTERPRISE
-    using ValueToEncryptableMap = std::unordered_map<FLDict, Retained<CBLEncryptable>>;
+    using ValueToEncryptableMap = cbl_internal::LazyValueMap<CBLEncryptable>;
 #endif
 
+    template <class T, class ACCESSOR>
+    size_t readColumn(unsigned col, FLValueType type, T outValues[], size_t maxRows,
+                      uint8_t* _cbl_nullable outNulls, ACCESSOR accessor);
+
+    struct Profile {
+        std::chrono::steady_clock::time_point   start;          // When the execution began
+        CBLQueryStats                           stats {};       // Timings are updated as rows are read
+        bool                                    sampled;        // Report to the sampler when done?
+        bool                                    finished {false};
+    };
+
+    bool readRow();
+    void profileRow(bool more);
+    void reportSample();
+
     Retained<CBLQuery> const     _query;        // The query
     C4Query::Enumerator          _enum;         // The query enumerator
+    alloc_slice                  _cacheParameters;      // Parameters, if results are to be cached
+    uint64_t                     _cacheDataVersion {0}; // Data version, if results are to be cached
     fleece::MutableArray mutable _asArray;      // Column values as a Fleece Array
     fleece::MutableDict  mutable _asDict;       // Column names/values as a Fleece Dict
+    bool                 mutable _asArrayCurrent {false};   // Is _asArray filled in for this row?
+    bool                 mutable _asDictCurrent {false};    // Is _asDict filled in for this row?
+    bool                         _reuseResults {false};     // Refill _asArray/_asDict per row?
     Doc                          _fleeceDoc;    // Fleece Doc that owns the column values
     ValueToBlobMap               _blobs;        // Cached CBLBLobs, keyed by FLDict
 #ifdef COUCHBASE_ENTERPRISE
     ValueToEncryptableMap        _encryptables; // Cached CBLEncryptables, keyed by FLDict
 #endif
+    std::unique_ptr<Profile>     _profile;      // Only if the execution is being profiled
+    cbl_internal::TraceSpan::Context _firstRowTrace; // Parent of the first row's span, if traced
+    cbl_internal::MemoryAccount  _memory {cbl_internal::MemoryCategory::kResultSets, this, sizeof(CBLResultSet)};
+};
+
+
+#pragma mark - ASYNC EXECUTION:
+
+
+struct CBLQueryExecution final : public CBLRefCounted {
+public:
+    CBLQueryExecution(CBLQuery* query, CBLQueryExecuteCallback callback, void* _cbl_nullable context)
+    :_query(query)
+    ,_callback(callback)
+    ,_context(context)
+    { }
+
+    /** Hands the execution to the current executor. */
+    void start();
+
+    /** Returns true if the callback hasn't been (and now won't be) called. */
+    bool cancel() {
+        State state = _state.load();
+        while (state == kPending || state == kRunning) {
+            if (_state.compare_exchange_weak(state, kCancelled))
+                return true;
+        }
+        return state == kCancelled;
+    }
+
+    static void setExecutor(CBLQueryExecutor _cbl_nullable executor, void* _cbl_nullable context);
+
+private:
+    enum State {kPending, kRunning, kCalledBack, kCancelled};
+
+    void run();
+
+    Retained<CBLQuery> const        _query;         // The query to run
+    CBLQueryExecuteCallback const   _callback;      // Called with the results
+    void* _cbl_nullable const       _context;       // Passed to _callback
+    std::atomic<State>              _state {kPending};
 };
 
 
+#pragma mark - QUERY DIFFER:
+
+
+namespace cbl_internal {
+
+    /** Computes the row-level changes between successive result sets of a live query,
+        identifying rows by their first column. */
+    class QueryDiffer {
+    public:
+        /** Returns the changes from the previous result set, and remembers this one's rows.
+            The changes are valid until the next call. */
+        const std::vector<CBLQueryRowChange>& diff(CBLResultSet* rs);
+
+    private:
+        using RowIndex = std::unordered_map<std::string, uint32_t>;     // Row key -> index
+
+        static std::string rowKey(Array row);
+
+        Doc                             _rows, _oldRows;    // Encoded arrays of rows
+        RowIndex                        _index, _oldIndex;
+        std::vector<CBLQueryRowChange>  _changes;
+    };
+
+}
+
+
 #pragma mark - QUERY LISTENER:
 
 
@@ -193,13 +512,20 @@ namespace cbl_internal {
     public:
         ListenerToken(CBLQuery *query,
                       CBLQueryChangeListener callback,
-                      void* _cbl_nullable context)
+                      void* _cbl_nullable context,
+                      const CBLQueryChangeListenerOptions* _cbl_nullable options =nullptr)
         :CBLListenerToken((const void*)callback, context)
         ,_query(query)
         {
+            if (options && options->minIntervalMS > 0) {
+                _minInterval = std::chrono::milliseconds(options->minIntervalMS);
+                _maxLatency = std::max(_minInterval,
+                                       Clock::duration(std::chrono::milliseconds(options->maxLatencyMS)));
+            }
+            
             _stoppable = std::make_unique<CBLQueryListenerStoppable>(this);
             
-            auto ctx = ContextManager::shared().registerObject(this);
+            auto ctx = _contextID = ContextManager::shared().registerObject(this);
             
             query->_c4query.useLocked([&](C4Query *c4query) {
                 _c4obs = c4query->observe([ctx](C4QueryObserver* c4obs) {
@@ -229,8 +555,9 @@ namespace cbl_internal {
             return (CBLQueryChangeListener)_callback;
         }
 
-        void call() {
+        void call(uint32_t coalescedChanges) {
             std::lock_guard<std::recursive_mutex> lock(_mutex);
+            _coalescedChanges = coalescedChanges;
             CBLQueryChangeListener cb = callback();
             if (cb) {
                 cb(_context, _query, this);
@@ -240,12 +567,18 @@ namespace cbl_internal {
         Retained<CBLResultSet> resultSet() {
             return new CBLResultSet(_query, _c4obs->getEnumerator(false));
         }
+
+        /// The number of observer notifications coalesced into the latest call.
+        uint32_t coalescedChanges() {
+            std::lock_guard<std::recursive_mutex> lock(_mutex);
+            return _coalescedChanges;
+        }
         
         // CBLListenerToken :
         
         void willRemove() override {
             setEnabled(false);
-            ContextManager::shared().unregisterObject(this);
+            ContextManager::shared().unregisterObject(_contextID);
         }
         
         // For Testing :
@@ -269,25 +602,87 @@ namespace cbl_internal {
             }
         };
         
+        using Clock = std::chrono::steady_clock;
+
         void queryChanged();    // defn is in CBLDatabase.cc, to prevent circular hdr dependency
+        void coalesceChange();
+        void scheduleCoalesceTimer(Clock::time_point when);
+        void coalesceTimerFired();
+        Clock::time_point coalesceDeadline() const;
 
         Retained<CBLQuery>  _query;
         Retained<C4QueryObserver> _c4obs;
         std::unique_ptr<CBLQueryListenerStoppable> _stoppable;
         bool _isEnabled {false};
+        void* _cbl_nullable _contextID {nullptr};   // Handle from ContextManager
+        uint32_t _coalescedChanges {0};         // Reported by the latest call; guarded by _mutex
+
+        // Coalescing state (see CBLQueryChangeListenerOptions); guarded by _coalesceMutex:
+        Clock::duration _minInterval {0}, _maxLatency {0};
+        std::mutex _coalesceMutex;
+        Clock::time_point _firstPendingChange, _lastPendingChange;
+        uint32_t _pendingChanges {0};
+        bool _timerScheduled {false};
     };
 }
 
 
-inline fleece::Retained<CBLResultSet> CBLQuery::execute() {
-    auto qe = _c4query.useLocked()->run();
-    return retained(new CBLResultSet(this, std::move(qe)));
+inline fleece::Retained<CBLResultSet> CBLQuery::execute(bool profile) {
+    bool sampled = !profile && CBLResultSet::shouldSample();
+    auto start = std::chrono::steady_clock::now();
+    cbl_internal::TraceSpan span(kCBLTraceQueryExecute, _queryString);
+
+    // Get the plan before locking: the first call to `plan` locks the query to explain it.
+    auto &usage = _database->indexUsage();
+    const Plan* usagePlan = usage.enabled() ? &plan() : nullptr;
+
+    auto c4query = _c4query.useLocked();
+    _flushParameters(c4query.get());
+
+    // Get the data version before running the query, so results can't be cached under a
+    // version older than a change they're missing. Profiled executions always run the query.
+    uint64_t dataVersion = 0;
+    std::optional<C4Query::Enumerator> cached;
+    if (_resultCacheSize > 0) {
+        dataVersion = _database->dataVersion();
+        if (dataVersion && !profile && !sampled)
+            cached = _takeCachedResults(dataVersion);
+        if (!cached)
+            ++_resultCacheStats.misses;
+    }
+
+    Retained<CBLResultSet> rs;
+    if (cached) {
+        if (span)
+            span.addItems(uint64_t(cached->getRowCount()));
+        rs = new CBLResultSet(this, std::move(*cached));
+    } else {
+        Executing executing;
+        unsigned timedOut = sTimedOutPredictions;
+        auto qe = c4query->run(_parameters);
+        if (sTimedOutPredictions != timedOut)
+            dataVersion = 0;        // Don't cache results missing a prediction's output
+        if (usagePlan)
+            usage.record(usagePlan->indexesUsed.root().asArray(), uint64_t(qe.getRowCount()));
+        if (span)
+            span.addItems(uint64_t(qe.getRowCount()));
+        rs = new CBLResultSet(this, std::move(qe));
+    }
+    if (dataVersion)
+        rs->cacheWhenFreed(_parameters, dataVersion);
+    if (profile || sampled)
+        rs->startProfiling(start, sampled);
+    if (span)
+        rs->traceFirstRow(span.context());
+    return rs;
 }
 
 
 inline fleece::Retained<CBLListenerToken>
-CBLQuery::addChangeListener(CBLQueryChangeListener listener, void* _cbl_nullable context) {
-    auto token = retained(new ListenerToken<CBLQueryChangeListener>(this, listener, context));
+CBLQuery::addChangeListener(CBLQueryChangeListener listener, void* _cbl_nullable context,
+                            const CBLQueryChangeListenerOptions* _cbl_nullable options) {
+    _makeExclusive();
+    auto token = retained(new ListenerToken<CBLQueryChangeListener>(this, listener, context, options));
     _listeners.add(token);
     token->setEnabled(true);
     return token;
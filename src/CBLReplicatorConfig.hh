@@ -45,6 +45,7 @@ struct CBLEndpoint {
     virtual C4String remoteDatabaseName() const =0;
     virtual CBLEndpoint* clone() const =0;
     virtual std::string desc() const =0;
+    virtual const C4SocketFactory* _cbl_nullable socketFactory() const {return nullptr;}
 #ifdef COUCHBASE_ENTERPRISE
     virtual CBLDatabase* _cbl_nullable otherLocalDB() const     {return nullptr;}
 #endif
@@ -57,13 +58,13 @@ protected:
 namespace cbl_internal {
     // Concrete Endpoint for remote URLs
     struct CBLURLEndpoint : public CBLEndpoint {
-        CBLURLEndpoint(fleece::slice url)
+        CBLURLEndpoint(fleece::slice url, bool anyScheme =false)
         :_url(url)
         {
             if (!C4Address::fromURL(_url, &_address, (fleece::slice*)&_dbName)) {
                 C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
                                "Invalid URLEndpoint url '%.*s'", FMTSLICE(_url));
-            } else if (_address.scheme != kC4Replicator2Scheme &&
+            } else if (!anyScheme && _address.scheme != kC4Replicator2Scheme &&
                        _address.scheme != kC4Replicator2TLSScheme) {
                 C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
                                "Invalid scheme for URLEndpoint url '%.*s'. It must be either 'ws:' or 'wss:'.",
@@ -75,11 +76,26 @@ namespace cbl_internal {
         C4String remoteDatabaseName() const override            {return _dbName;}
         virtual CBLEndpoint* clone() const override             {return new CBLURLEndpoint(_url);}
         virtual std::string desc() const override               {return _url.asString();}
+        fleece::slice url() const                               {return _url;}
     private:
         fleece::alloc_slice _url;
         C4String _dbName = { };
     };
 
+    // Concrete Endpoint for remotes reached through an app's transport (CBLTransport.cc)
+    struct CBLTransportEndpoint : public CBLURLEndpoint {
+        CBLTransportEndpoint(const CBLTransportFactory &factory, fleece::slice url);
+
+        const CBLTransportFactory& factory() const              {return _factory;}
+        const C4SocketFactory* socketFactory() const override   {return &_c4Factory;}
+        virtual CBLEndpoint* clone() const override {
+            return new CBLTransportEndpoint(_factory, url());
+        }
+    private:
+        CBLTransportFactory _factory;
+        C4SocketFactory     _c4Factory;     // Its context points to this endpoint
+    };
+
 #ifdef COUCHBASE_ENTERPRISE
     // Concrete Endpoint for local databases
     struct CBLLocalEndpoint : public CBLEndpoint {
@@ -217,11 +233,15 @@ namespace cbl_internal
             }
             
             if (collections) {
-                // Copy replication collections, channels, and document ids:
+                // Copy replication collections, channels, document ids and filter expressions:
                 for (int i = 0; i < collectionCount; i++) {
                     CBLReplicationCollection col = collections[i];
                     col.channels = FLArray_MutableCopy(col.channels, kFLDeepCopyImmutables);
                     col.documentIDs = FLArray_MutableCopy(col.documentIDs, kFLDeepCopyImmutables);
+                    col.pushFilterExpression = copyString(col.pushFilterExpression,
+                                                          _filterExpressions.emplace_back());
+                    col.pullFilterExpression = copyString(col.pullFilterExpression,
+                                                          _filterExpressions.emplace_back());
                     _effectiveCollections.push_back(col);
                 }
                 collections = _effectiveCollections.data();
@@ -328,6 +348,23 @@ namespace cbl_internal
                 enc.writeUInt(kCBLDefaultReplicatorHeartbeat);
             }
             
+            if (checkpointInterval > 0) {
+                enc.writeKey(slice(kC4ReplicatorCheckpointInterval));
+                enc.writeUInt(checkpointInterval);
+            }
+
+            bool noDeltas = disableDeltas;
+        #ifdef COUCHBASE_ENTERPRISE
+            // Both databases are in this process, so a delta saves no bandwidth; it just costs a
+            // diff on the sending side and a patch on the receiving side:
+            if (endpoint->otherLocalDB())
+                noDeltas = true;
+        #endif
+            if (noDeltas) {
+                enc.writeKey(slice(kC4ReplicatorOptionDisableDeltas));
+                enc.writeBool(true);
+            }
+
         #ifdef __CBL_REPLICATOR_NETWORK_INTERFACE__
             if (networkInterface.buf) {
                 enc.writeKey(slice(kC4SocketOptionNetworkInterface));
@@ -416,6 +453,7 @@ namespace cbl_internal
         alloc_slice                             _pinnedServerCert, _trustedRootCerts;
         CBLProxySettings                        _proxy;
         alloc_slice                             _proxyHostname, _proxyUsername, _proxyPassword;
+        std::vector<alloc_slice>                _filterExpressions;
     #ifdef __CBL_REPLICATOR_NETWORK_INTERFACE__
         alloc_slice                             _networkInterface;
     #endif
@@ -30,6 +30,15 @@ CBLEndpoint* CBLEndpoint_CreateWithURL(FLString url, CBLError* _cbl_nullable out
     } catchAndBridge(outError)
 }
 
+CBLEndpoint* CBLEndpoint_CreateWithTransport(const CBLTransportFactory* factory,
+                                             FLString url,
+                                             CBLError* _cbl_nullable outError) noexcept
+{
+    try {
+        return new CBLTransportEndpoint(*factory, url);
+    } catchAndBridge(outError)
+}
+
 #ifdef COUCHBASE_ENTERPRISE
 CBLEndpoint* CBLEndpoint_CreateWithLocalDB(CBLDatabase* db) noexcept {
     try {
@@ -63,6 +72,10 @@ FLSlice CBLReplicator_UserAgent(const CBLReplicator* repl) noexcept {
     return repl->getUserAgent();
 }
 
+FLSliceResult CBLReplicator_OptionsJSON(const CBLReplicator* repl) noexcept {
+    return FLSliceResult(repl->optionsJSON());
+}
+
 CBLReplicator* CBLReplicator_Create(const CBLReplicatorConfiguration* conf, CBLError *outError) noexcept {
     try {
         return retain(new CBLReplicator(*conf));
@@ -77,6 +90,10 @@ CBLReplicatorStatus CBLReplicator_Status(CBLReplicator* repl) noexcept {
     return repl->status();
 }
 
+CBLReplicatorMetrics CBLReplicator_GetMetrics(CBLReplicator* repl) noexcept {
+    return repl->metrics();
+}
+
 void CBLReplicator_Start(CBLReplicator* repl, bool reset) noexcept        {repl->start(reset);}
 void CBLReplicator_Stop(CBLReplicator* repl) noexcept                     {repl->stop();}
 void CBLReplicator_SetHostReachable(CBLReplicator* repl, bool r) noexcept {repl->setHostReachable(r);}
@@ -129,6 +146,29 @@ bool CBLReplicator_IsDocumentPending2(CBLReplicator *repl,
     } catchAndBridge(outError)
 }
 
+bool CBLReplicator_ArePendingDocuments(CBLReplicator *repl,
+                                       const FLString docIDs[],
+                                       size_t count,
+                                       const CBLCollection* collection,
+                                       bool outPending[],
+                                       CBLError* _cbl_nullable outError) noexcept {
+    try {
+        repl->arePendingDocuments(docIDs, count, collection, outPending);
+        return true;
+    } catchAndBridge(outError)
+}
+
+bool CBLReplicator_PullDocumentsNow(CBLReplicator *repl,
+                                    const CBLCollection* collection,
+                                    const FLString docIDs[],
+                                    size_t count,
+                                    CBLError* _cbl_nullable outError) noexcept {
+    try {
+        repl->pullDocumentsNow(collection, docIDs, count);
+        return true;
+    } catchAndBridge(outError)
+}
+
 CBLListenerToken* CBLReplicator_AddChangeListener(CBLReplicator* repl,
                                                   CBLReplicatorChangeListener listener,
                                                   void *context) noexcept
@@ -21,15 +21,25 @@
 #include "CBLDocument_Internal.hh"
 #include "CBLCollection_Internal.hh"
 #include "ConflictResolver.hh"
+#include "FilterExpression.hh"
+#include "PropertyCryptoBatcher.hh"
+#include "Trace.hh"
 #include "Internal.hh"
+#include "MemoryStats.hh"
+#include "LockTiming.hh"
+#include "ReplicatorMetrics.hh"
 #include "c4Replicator.hh"
 #include "c4Private.h"
 #include "StringUtil.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
 #include <algorithm>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 CBL_ASSUME_NONNULL_BEGIN
@@ -95,7 +105,14 @@ public:
             if (_conf.replicatorType != kCBLReplicatorTypePush)
                 col.pull = type;
             
-            if (replCol.pushFilter) {
+            // Compile the filter expressions now, so a bad one fails replicator creation:
+            auto& filters = _filterExpressions[spec];
+            if (replCol.pushFilterExpression.buf)
+                filters.push = make_unique<FilterExpression>(replCol.pushFilterExpression);
+            if (replCol.pullFilterExpression.buf)
+                filters.pull = make_unique<FilterExpression>(replCol.pullFilterExpression);
+            
+            if (replCol.pushFilter || filters.push) {
                 col.pushFilter = [](C4CollectionSpec collectionSpec,
                                     C4String docID,
                                     C4String revID,
@@ -106,7 +123,7 @@ public:
                 };
             }
             
-            if (replCol.pullFilter) {
+            if (replCol.pullFilter || filters.pull) {
                 col.pullFilter = [](C4CollectionSpec collectionSpec,
                                     C4String docID,
                                     C4String revID,
@@ -133,7 +150,11 @@ public:
         
         params.callbackContext = this;
         params.onStatusChanged = [](C4Replicator* c4repl, C4ReplicatorStatus status, void *ctx) {
-            ((CBLReplicator*)ctx)->_statusChanged(status);
+            auto repl = (CBLReplicator*)ctx;
+            // Don't hold back document events past the end of replication:
+            if (status.level == kC4Idle || status.level == kC4Stopped)
+                repl->_flushDocuments();
+            repl->_statusChanged(status);
         };
         params.onDocumentsEnded = [](C4Replicator* c4repl,
                                      bool pushing,
@@ -144,7 +165,7 @@ public:
         };
         
 #ifdef COUCHBASE_ENTERPRISE
-        if (_conf.propertyEncryptor || _conf.documentPropertyEncryptor) {
+        if (_conf.propertyEncryptor || _conf.documentPropertyEncryptor || _conf.documentPropertyBatchEncryptor) {
             params.propertyEncryptor = [](void* ctx,
                                           C4CollectionSpec spec,
                                           C4String documentID,
@@ -160,7 +181,7 @@ public:
             };
         }
         
-        if (_conf.propertyDecryptor || _conf.documentPropertyDecryptor) {
+        if (_conf.propertyDecryptor || _conf.documentPropertyDecryptor || _conf.documentPropertyBatchDecryptor) {
             params.propertyDecryptor = [](void* ctx,
                                           C4CollectionSpec spec,
                                           C4String documentID,
@@ -180,6 +201,9 @@ public:
         // Encode replicator options dict:
         alloc_slice options = encodeOptions();
         params.optionsDictFleece = options;
+
+        // A custom transport replaces the built-in WebSocket:
+        params.socketFactory = _conf.endpoint->socketFactory();
         
         // Generate replicator id for logging purpose:
         std::stringstream ss;
@@ -208,9 +232,18 @@ public:
         });
         
         _c4status = _c4repl->getStatus();
-        _useInitialStatus = true;
         
         _stoppable = make_unique<CBLReplicatorStoppable>(this);
+        
+        unsigned maxResolvers = _conf.maxConcurrentConflictResolvers;
+        unsigned batchSize = _conf.conflictResolverBatchSize;
+        _conflictResolverPool = new ConflictResolverPool(_db,
+            maxResolvers ? maxResolvers : kCBLDefaultReplicatorMaxConcurrentConflictResolvers,
+            batchSize ? batchSize : kCBLDefaultReplicatorConflictResolverBatchSize,
+            _conf.conflictResolverBatchDelay,
+            [this](size_t batchSize, double resolveMS, double saveMS) {
+                _conflictBatchFinished(batchSize, resolveMS, saveMS);
+            });
     }
     
     CBLCollection* _cbl_nullable defaultCollection() {
@@ -228,9 +261,9 @@ public:
     void stop()                                             {_c4repl->stop();}
 
     void start(bool reset) {
-        LOCK(_mutex);
+        TIMED_LOCK(_mutex, kReplicator);
         _retainSelf = this;     // keep myself from being freed until the replicator stops
-        _useInitialStatus = false;
+        _metrics.started();
         
         if (_db->registerStoppable(_stoppable.get())) {
             SyncLog(Info, "%s Starting", desc().c_str());
@@ -238,13 +271,18 @@ public:
         } else
             CBL_Log(kCBLLogDomainReplicator, kCBLLogWarning,
                     "%s Couldn't start the replicator as the database is closing or closed.", desc().c_str());
+        // Until the first status change arrives, readers should see the started status:
+        _c4status = _c4repl->getStatus();
+        _startGeneration = _publishStatus().generation;
     }
 
-    CBLReplicatorStatus status() {
-        LOCK(_mutex);
-        if (_useInitialStatus)
-            return {}; // Allow to return initial status with zero progress.complete
-        return effectiveStatus(_c4repl->getStatus());
+    CBLReplicatorMetrics metrics() const {
+        return _metrics.snapshot();
+    }
+
+    // Lock-free. Before the first start this is all zeroes, including progress.complete.
+    CBLReplicatorStatus status() const {
+        return _statusSnapshot.load();
     }
 
     MutableDict pendingDocumentIDs(const CBLCollection* col) const {
@@ -267,13 +305,147 @@ public:
         return _c4repl->isDocumentPending(docID, col->spec());
     }
 
+    void arePendingDocuments(const FLString docIDs[], size_t count,
+                             const CBLCollection* col, bool outPending[]) const {
+        checkCollectionParam(col);
+        if (count == 1) {
+            outPending[0] = _c4repl->isDocumentPending(docIDs[0], col->spec());
+            return;
+        }
+        // Get all the pending IDs in one pass, then look up each of the given ones:
+        std::fill(outPending, outPending + count, false);
+        if (count == 0)
+            return;
+        alloc_slice arrayData(_c4repl->pendingDocIDs(col->spec()));
+        if (!arrayData)
+            return;
+        Doc doc(arrayData, kFLTrusted);
+        std::vector<slice> pending;
+        pending.reserve(doc.asArray().count());
+        for (Array::iterator i(doc.asArray()); i; ++i)
+            pending.push_back(i->asString());
+        std::sort(pending.begin(), pending.end());
+        for (size_t i = 0; i < count; ++i)
+            outPending[i] = std::binary_search(pending.begin(), pending.end(), slice(docIDs[i]));
+    }
+
+    // LiteCore pulls changes in sequence order and can't be told to skip ahead, so the
+    // documents are pulled by a one-shot replicator of their own, which reports them as mine.
+    // Only one runs at a time per collection; IDs requested meanwhile are pulled together by the
+    // next one, so that bursts of requests don't each leave a checkpoint behind.
+    void pullDocumentsNow(const CBLCollection* col, const FLString docIDs[], size_t count) {
+        checkCollectionParam(col);
+        if (_conf.replicatorType == kCBLReplicatorTypePush)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "The replicator doesn't pull.");
+        if (count == 0)
+            return;
+
+        std::set<string> ids;
+        for (size_t i = 0; i < count; ++i)
+            ids.emplace(slice(docIDs[i]));
+        C4Database::CollectionSpec spec = _collections.find(col->spec())->first;  // Stable slices
+        {
+            TIMED_LOCK(_mutex, kReplicator);
+            PullNow &pullNow = _pullsNow[spec];
+            if (pullNow.busy) {
+                pullNow.queued.merge(ids);
+                SyncLog(Info, "%s Queued %zu document(s) to pull now", desc().c_str(), count);
+                return;
+            }
+            pullNow.busy = true;
+        }
+        try {
+            _startPullNow(spec, std::move(ids));
+        } catch (...) {
+            TIMED_LOCK(_mutex, kReplicator);
+            _pullsNow[spec].busy = false;
+            throw;
+        }
+    }
+
+    // Starts a replicator pulling the given documents of a collection.
+    // Must not be called with _mutex locked.
+    void _startPullNow(C4Database::CollectionSpec spec, std::set<string> ids) {
+        MutableArray idArray = MutableArray::newArray();
+        for (const string &id : ids)
+            idArray.append(id);
+
+        CBLReplicatorConfiguration conf = _conf;
+        conf.replicatorType = kCBLReplicatorTypePull;
+        conf.continuous = false;
+        conf.documentListenerMaxDelay = 0;          // My own delivery window applies
+        CBLReplicationCollection replCol;
+        if (conf.database) {
+            conf.documentIDs = idArray;
+        } else {
+            replCol = _collections.at(spec);
+            replCol.documentIDs = idArray;
+            conf.collections = &replCol;
+            conf.collectionCount = 1;
+        }
+
+        Retained<CBLReplicator> pull = new CBLReplicator(conf);
+        pull->_pullingFor = this;
+        pull->_pullingSpec = spec;
+        pull->_pullingIDs = std::move(ids);
+        (void) pull->addDocumentListener(&forwardPulledDocuments, this);
+        SyncLog(Info, "%s Pulling %zu document(s) now with %s",
+                desc().c_str(), pull->_pullingIDs.size(), pull->desc().c_str());
+        pull->start(true);                          // Don't trust a checkpoint from an earlier pull
+    }
+
+    // Called when a replicator started by `_startPullNow` stops. Reports the documents it didn't
+    // pull because of an error, then starts pulling the ones requested while it ran.
+    void _pullNowStopped(CBLReplicator *pull, CBLError error) {
+        std::set<string> missed;
+        {
+            TIMED_LOCK(pull->_mutex, kReplicator);
+            missed.swap(pull->_pullingIDs);
+        }
+        C4Database::CollectionSpec spec = pull->_pullingSpec;
+        if (error.code && !missed.empty()) {
+            char buf[256];
+            SyncLog(Warning, "%s Couldn't pull %zu document(s) now: %s", desc().c_str(), missed.size(),
+                    c4error_getDescriptionC(internal(error), buf, sizeof(buf)));
+            std::vector<CBLReplicatedDocument> docs;
+            docs.reserve(missed.size());
+            for (const string &id : missed) {
+                CBLReplicatedDocument doc = {};
+                doc.scope = spec.scope;
+                doc.collection = spec.name;
+                doc.ID = slice(id);
+                doc.error = error;
+                docs.push_back(doc);
+            }
+            _deliverDocuments(false, docs.data(), docs.size());
+        }
+
+        std::set<string> next;
+        {
+            TIMED_LOCK(_mutex, kReplicator);
+            PullNow &pullNow = _pullsNow[spec];
+            next.swap(pullNow.queued);
+            if (next.empty()) {
+                pullNow.busy = false;
+                return;
+            }
+        }
+        try {
+            _startPullNow(spec, std::move(next));
+        } catch (const std::exception &x) {
+            SyncLog(Warning, "%s Couldn't start pulling queued documents now: %s", desc().c_str(), x.what());
+            TIMED_LOCK(_mutex, kReplicator);
+            _pullsNow[spec].busy = false;
+        }
+    }
+
     Retained<CBLListenerToken> addChangeListener(CBLReplicatorChangeListener listener, void *context) {
-        LOCK(_mutex);
+        TIMED_LOCK(_mutex, kReplicator);
         return _changeListeners.add(listener, context);
     }
 
     Retained<CBLListenerToken> addDocumentListener(CBLDocumentReplicationListener listener, void *context) {
-        LOCK(_mutex);
+        TIMED_LOCK(_mutex, kReplicator);
         if (_docListeners.empty()) {
             _c4repl->setProgressLevel(kC4ReplProgressPerDocument);
             _progressLevel = kC4ReplProgressPerDocument;
@@ -284,6 +456,11 @@ public:
     slice getUserAgent() const {
         return _conf.getUserAgent();
     }
+
+    /** The options passed to LiteCore, as JSON. (For tests.) */
+    alloc_slice optionsJSON() const {
+        return alloc_slice(FLValue_ToJSON(FLValue_FromData(encodeOptions(), kFLTrusted)));
+    }
     
     std::string desc() const {
         return _desc;
@@ -302,7 +479,13 @@ private:
         }
     };
     
-    alloc_slice encodeOptions() {
+    // A status made visible to `status`, for delivering to the change listeners.
+    struct PublishedStatus {
+        CBLReplicatorStatus status {};
+        uint64_t            generation {0};     // Zero if nothing was published
+    };
+
+    alloc_slice encodeOptions() const {
         Encoder enc;
         enc.beginDict();
         _conf.writeOptions(enc);
@@ -319,8 +502,9 @@ private:
     }
 
     CBLReplicatorStatus effectiveStatus(C4ReplicatorStatus c4status) {
-        LOCK(_mutex);
+        TIMED_LOCK(_mutex, kReplicator);
         auto eff = external(c4status);
+        eff.conflictResolution = _conflictStats;
         // Bump effective status to Busy if conflict resolvers are running, but pass
         // Offline status through.
         if (_activeConflictResolvers > 0) {
@@ -330,18 +514,26 @@ private:
         return eff;
     }
 
-    void bumpConflictResolverCount(int delta) {
+    // Must be called with _mutex locked. If the effective activity changes, publishes the new
+    // status; the caller should pass the result to `_deliverStatus` after unlocking.
+    PublishedStatus bumpConflictResolverCount(int delta) {
         auto curActivity = effectiveStatus(_c4status).activity;
         _activeConflictResolvers += delta;
         if (effectiveStatus(_c4status).activity != curActivity)
-            _statusChanged(_c4status);
+            return _publishStatus();
+        return {};
     }
 
     void _statusChanged(C4ReplicatorStatus c4status) {
-        LOCK(_mutex);
-        _c4status = c4status;
-        auto cblStatus = effectiveStatus(c4status);
-        
+        PublishedStatus published;
+        {
+            TIMED_LOCK(_mutex, kReplicator);
+            _c4status = c4status;
+            _metrics.progress(c4status.progress.unitsCompleted, c4status.progress.unitsTotal);
+            published = _publishStatus();
+        }
+        auto &cblStatus = published.status;
+
         SyncLog(Info, "%s Status: %s, progress=%llu/%llu, flag=%d, error=%d/%d (effective status=%s, completed=%.2f%%, docs=%llu)",
                 desc().c_str(),
                 kC4ReplicatorActivityLevelNames[c4status.level],
@@ -349,26 +541,67 @@ private:
                 c4status.flags, c4status.error.domain, c4status.error.code,
                 kC4ReplicatorActivityLevelNames[cblStatus.activity],
                 cblStatus.progress.complete, cblStatus.progress.documentCount);
-        
+        _deliverStatus(published);
+    }
+
+    // Computes the effective status and makes it the one `status` returns.
+    // Must be called with _mutex locked.
+    PublishedStatus _publishStatus() {
+        PublishedStatus published {effectiveStatus(_c4status), ++_statusGeneration};
+        _statusSnapshot.store(published.status);
+        return published;
+    }
+
+    // Calls the change listeners with a published status, unless a newer one has already been
+    // delivered. Must not be called with _mutex locked.
+    void _deliverStatus(const PublishedStatus &published) {
+        if (published.generation == 0)
+            return;
+        Retained<CBLReplicator> self = this;    // `_retainSelf` may be cleared below
+        LOCK(_statusDeliveryMutex);
+        if (published.generation <= _deliveredStatusGeneration)
+            return;
+        _deliveredStatusGeneration = published.generation;
+
+        auto &cblStatus = published.status;
         if (!_changeListeners.empty()) {
-            _changeListeners.call(this, &cblStatus);
+            // Through the database's notifications, so they can be buffered or dispatched:
+            Retained<CBLReplicator> retained = this;
+            _db->notify(this, [retained, cblStatus] {
+                retained->_changeListeners.call(retained.get(), &cblStatus);
+            });
         } else if (cblStatus.error.code) {
             char buf[256];
             SyncLog(Warning, "No listener to receive error : %s",
-                    c4error_getDescriptionC(c4status.error, buf, sizeof(buf)));
+                    c4error_getDescriptionC(internal(cblStatus.error), buf, sizeof(buf)));
         }
 
-        if (cblStatus.activity == kCBLReplicatorStopped) {
+        if (cblStatus.activity != kCBLReplicatorStopped)
+            return;
+        {
+            TIMED_LOCK(_mutex, kReplicator);
+            // If `start` was called after this status was published, I'm running again and must
+            // stay registered and retained; the new run will deliver its own Stopped status.
+            if (_c4status.level != kC4Stopped || published.generation < _startGeneration)
+                return;
             _db->unregisterStoppable(_stoppable.get());
             _retainSelf = nullptr;  // Undoes the retain in `start`; now I can be freed
         }
+        if (_pullingFor)
+            _pullingFor->_pullNowStopped(this, cblStatus.error);
     }
 
     void _documentsEnded(bool pushing,
                          size_t numDocs,
                          const C4DocumentEnded* _cbl_nonnull c4Docs[_cbl_nonnull])
     {
-        LOCK(_mutex);
+        std::optional<cbl_internal::TraceSpan> span;
+        if (!pushing && cbl_internal::TraceSpan::enabled()) {
+            span.emplace(kCBLTraceReplicatorImport, slice(_desc));
+            span->addItems(numDocs);
+        }
+        std::unique_lock<recursive_mutex> lock(_mutex);
+        PublishedStatus published;
         std::unique_ptr<std::vector<CBLReplicatedDocument>> docs;
         if (!_docListeners.empty()) {
             docs = std::make_unique<std::vector<CBLReplicatedDocument>>();
@@ -380,13 +613,18 @@ private:
         
         for (size_t i = 0; i < numDocs; ++i) {
             auto src = *c4Docs[i];
-            if (!pushing && src.error.code == kC4ErrorConflict && src.error.domain == LiteCoreDomain) {
+            bool conflict = (!pushing && src.error.code == kC4ErrorConflict && src.error.domain == LiteCoreDomain);
+            _metrics.documentEnded(pushing, src.error.code != 0 && !conflict);
+            if (conflict) {
                 // Conflict -- start an async resolver task:
                 if (auto it = _collections.find(src.collectionSpec); it != _collections.end()) {
                     auto replCol = it->second;
                     auto r = new ConflictResolver(replCol.collection, replCol.conflictResolver, _conf.context, src);
-                    bumpConflictResolverCount(1);
-                    r->runAsync( bind(&CBLReplicator::_conflictResolverFinished, this, std::placeholders::_1) );
+                    r->setBatchResolver(replCol.batchConflictResolver);
+                    r->setPriority(replCol.priority);
+                    if (auto p = bumpConflictResolverCount(1); p.generation)
+                        published = p;
+                    _conflictResolverPool->schedule(r, bind(&CBLReplicator::_conflictResolverFinished, this, std::placeholders::_1));
                 } else {
                     // Shouldn't happen unless we have a bug in LiteCore:
                     auto colPath = CBLCollection::collectionSpecToPath(src.collectionSpec);
@@ -409,27 +647,147 @@ private:
                 docs->push_back(doc);
             }
         }
-        if (docs)
-            _docListeners.call(this, pushing, unsigned(docs->size()), docs->data());
+        lock.unlock();
+        _deliverStatus(published);
+        if (docs && !docs->empty())
+            _deliverDocuments(pushing, docs->data(), docs->size());
     }
     
     void _conflictResolverFinished(ConflictResolver *resolver) {
         CBLReplicatedDocument doc = resolver->result();
-        _docListeners.call(this, false, 1, &doc);
+        _deliverDocuments(false, &doc, 1);
         delete resolver;
 
-        LOCK(_mutex);
-        bumpConflictResolverCount(-1);
+        bool last;
+        {
+            TIMED_LOCK(_mutex, kReplicator);
+            last = (_activeConflictResolvers == 1);
+        }
+        if (last)
+            _flushDocuments();          // The replicator may be about to stop
+        PublishedStatus published;
+        {
+            TIMED_LOCK(_mutex, kReplicator);
+            published = bumpConflictResolverCount(-1);
+        }
+        _deliverStatus(published);
+    }
+
+    // Calls the document listeners, or if there's a delivery window, adds the documents to the
+    // pending batch for that direction. Must not be called with _mutex locked.
+    void _deliverDocuments(bool pushing, const CBLReplicatedDocument docs[], size_t count) {
+        LOCK(_docDeliveryMutex);
+        if (_conf.documentListenerMaxDelay == 0) {
+            _callDocListeners(pushing, docs, count);
+            return;
+        }
+        PendingDocuments &pending = _pendingDocs[pushing];
+        for (size_t i = 0; i < count; ++i)
+            pending.add(docs[i]);
+        _accountMemory();
+        unsigned maxBatch = _conf.documentListenerMaxBatch;
+        if (maxBatch > 0 && pending.docs.size() >= maxBatch) {
+            _flushDocuments(pushing);
+        } else if (!pending.timerScheduled) {
+            pending.timerScheduled = true;
+            auto when = ListenerTimer::Clock::now() + std::chrono::milliseconds(_conf.documentListenerMaxDelay);
+            Retained<CBLReplicator> self = this;
+            ListenerTimer::shared().schedule(when, [self, pushing] {
+                LOCK(self->_docDeliveryMutex);
+                self->_pendingDocs[pushing].timerScheduled = false;
+                self->_flushDocuments(pushing);
+            });
+        }
+    }
+
+    // Calls the document listeners through the database's notifications, so they can be
+    // buffered or dispatched like its other listeners. Unless they're called right away, they
+    // get a copy of the documents, since `docs` is only valid during this call. The listener
+    // of a replicator started by `_startPullNow` is called directly: it only forwards them to
+    // the replicator it reports to, and must have done so by the time that hears it stopped.
+    void _callDocListeners(bool pushing, const CBLReplicatedDocument docs[], size_t count) {
+        if (_pullingFor || _db->notifiesImmediately()) {
+            _docListeners.call(this, pushing, unsigned(count), docs);
+            return;
+        }
+        auto copy = std::make_shared<PendingDocuments>();
+        for (size_t i = 0; i < count; ++i)
+            copy->add(docs[i]);
+        Retained<CBLReplicator> retained = this;
+        _db->notify(this, [retained, pushing, copy] {
+            retained->_docListeners.call(retained.get(), pushing, unsigned(copy->docs.size()),
+                                         copy->docs.data());
+        });
+    }
+
+    // The document listener of a replicator started by `_startPullNow`.
+    static void forwardPulledDocuments(void *context, CBLReplicator *pull, bool isPush,
+                                       unsigned count, const CBLReplicatedDocument* docs)
+    {
+        {
+            TIMED_LOCK(pull->_mutex, kReplicator);
+            for (unsigned i = 0; i < count; ++i)
+                pull->_pullingIDs.erase(string(slice(docs[i].ID)));
+        }
+        ((CBLReplicator*)context)->_deliverDocuments(isPush, docs, count);
+    }
+
+    // Delivers any documents held back by the delivery window.
+    void _flushDocuments() {
+        LOCK(_docDeliveryMutex);
+        _flushDocuments(false);
+        _flushDocuments(true);
+    }
+
+    // Must be called with _docDeliveryMutex locked.
+    void _flushDocuments(bool pushing) {
+        PendingDocuments &pending = _pendingDocs[pushing];
+        unsigned maxBatch = _conf.documentListenerMaxBatch;
+        size_t start = 0, total = pending.docs.size();
+        while (start < total) {
+            size_t n = maxBatch ? std::min(size_t(maxBatch), total - start) : total - start;
+            _callDocListeners(pushing, &pending.docs[start], n);
+            start += n;
+        }
+        pending.clear();
+        _accountMemory();
+    }
+
+    void _conflictBatchFinished(size_t batchSize, double resolveMS, double saveMS) {
+        _metrics.conflictResolver.recordMS(resolveMS);
+        _metrics.conflictTransaction.recordMS(saveMS);
+        double elapsedMS = resolveMS + saveMS;
+        std::unique_lock<recursive_mutex> lock(_mutex);
+        SyncLog(Info, "%s Resolved a batch of %zu conflicts in %.3fms",
+                desc().c_str(), batchSize, elapsedMS);
+        ++_conflictStats.batchCount;
+        _conflictStats.documentCount += batchSize;
+        _conflictStats.lastBatchSize = unsigned(batchSize);
+        _conflictStats.lastBatchTime = elapsedMS;
+        _conflictStats.totalTime += elapsedMS;
+        auto published = _publishStatus();      // Let listeners see the new stats
+        lock.unlock();
+        _deliverStatus(published);
     }
 
     bool _filter(C4CollectionSpec colSpec, slice docID, slice revID,
                  C4RevisionFlags flags, Dict body, bool pushing)
     {
         if (auto it = _collections.find(colSpec); it != _collections.end()) {
+            TimingStat::Timer timer(pushing ? _metrics.pushFilter : _metrics.pullFilter);
             auto replCol = it->second;
-            Retained<CBLDocument> doc = new CBLDocument(replCol.collection, docID, revID, flags, body);
+            
+            // Deleted and access-removed revisions have no properties to match:
+            auto& filters = _filterExpressions.at(colSpec);
+            auto expression = (pushing ? filters.push : filters.pull).get();
+            if (expression && !(flags & (kRevDeleted | kRevPurged)) && !expression->matches(body))
+                return false;
+            
             CBLReplicationFilter filter = pushing ? replCol.pushFilter : replCol.pullFilter;
+            if (!filter)
+                return true;
             
+            Retained<CBLDocument> doc = new CBLDocument(replCol.collection, docID, revID, flags, body);
             CBLDocumentFlags docFlags = 0;
             if (flags & kRevDeleted)
                 docFlags |= kCBLDocumentFlagsDeleted;
@@ -452,6 +810,22 @@ private:
                            C4String keyPath, C4Slice input, C4StringResult* algorithm,
                            C4StringResult* keyID, C4Error* outError)
     {
+        TimingStat::Timer timer(_metrics.propertyEncryptor);
+        if (auto batchEncryptor = _conf.documentPropertyBatchEncryptor) {
+            auto r = _encryptBatcher.process(spec, documentID, properties, keyPath, input,
+                                             nullslice, nullslice,
+                                             [&](CBLEncryptableProperty* props, size_t count,
+                                                 void* buffer, size_t capacity, CBLError* outErr) {
+                batchEncryptor(_conf.context, spec.scope, spec.name, props, count, buffer, capacity, outErr);
+            });
+            if (r.algorithm)
+                *algorithm = C4StringResult(r.algorithm);
+            if (r.keyID)
+                *keyID = C4StringResult(r.keyID);
+            *outError = internal(r.error);
+            return C4SliceResult(r.output);
+        }
+        
         CBLError error {};
         C4SliceResult result;
         if (_conf.propertyEncryptor) {
@@ -470,6 +844,18 @@ private:
                            C4String keyPath, C4Slice input, C4String algorithm,
                            C4String keyID, C4Error* outError)
     {
+        TimingStat::Timer timer(_metrics.propertyDecryptor);
+        if (auto batchDecryptor = _conf.documentPropertyBatchDecryptor) {
+            auto r = _decryptBatcher.process(spec, documentID, properties, keyPath, input,
+                                             algorithm, keyID,
+                                             [&](CBLEncryptableProperty* props, size_t count,
+                                                 void* buffer, size_t capacity, CBLError* outErr) {
+                batchDecryptor(_conf.context, spec.scope, spec.name, props, count, buffer, capacity, outErr);
+            });
+            *outError = internal(r.error);
+            return C4SliceResult(r.output);
+        }
+        
         CBLError error {};
         C4SliceResult result;
         if (_conf.propertyDecryptor) {
@@ -512,6 +898,48 @@ private:
     
     using ReplicationCollectionsMap = std::unordered_map<C4Database::CollectionSpec, CBLReplicationCollection>;
 
+    // The `pullDocumentsNow` state of a collection.
+    struct PullNow {
+        bool             busy {false};      // A replicator is pulling documents now
+        std::set<string> queued;            // The IDs to pull once it stops
+    };
+
+    struct FilterExpressions {
+        unique_ptr<FilterExpression> push, pull;
+    };
+    using FilterExpressionsMap = std::unordered_map<C4Database::CollectionSpec, FilterExpressions>;
+
+    // Document replication events held back by the delivery window, with copies of their strings:
+    struct PendingDocuments {
+        std::vector<CBLReplicatedDocument>      docs;
+        std::vector<alloc_slice>                strings;
+        bool                                    timerScheduled {false};
+
+        void add(CBLReplicatedDocument doc) {
+            doc.ID = strings.emplace_back(doc.ID);
+            doc.scope = strings.emplace_back(doc.scope);
+            doc.collection = strings.emplace_back(doc.collection);
+            docs.push_back(doc);
+        }
+
+        void clear() {
+            docs.clear();
+            strings.clear();
+        }
+
+        size_t bytes() const {
+            size_t bytes = docs.capacity() * sizeof(CBLReplicatedDocument);
+            for (auto &str : strings)
+                bytes += sizeof(str) + str.size;
+            return bytes;
+        }
+    };
+
+    // Updates the memory accounted to me. Must be called with _docDeliveryMutex locked.
+    void _accountMemory() {
+        _memory.setBytes(sizeof(CBLReplicator) + _pendingDocs[0].bytes() + _pendingDocs[1].bytes());
+    }
+
     recursive_mutex                             _mutex;
     ReplicatorConfiguration const               _conf;
     CBLDatabase*                                _db;                // Retained by _conf
@@ -520,12 +948,31 @@ private:
     string                                      _desc;
     unique_ptr<CBLReplicatorStoppable>          _stoppable;
     ReplicationCollectionsMap                   _collections;       // For filters and conflict resolver
-    bool                                        _useInitialStatus;  // For returning status before first start
+    FilterExpressionsMap                        _filterExpressions; // Compiled push/pull expressions
     C4ReplicatorStatus                          _c4status {kC4Stopped};
     Retained<CBLReplicator>                     _retainSelf;
+    Retained<CBLReplicator>                     _pullingFor;        // The replicator a `pullDocumentsNow` reports to
+    C4Database::CollectionSpec                  _pullingSpec;       // The collection it's pulling from
+    std::set<string>                            _pullingIDs;        // The IDs it has yet to report
+    std::unordered_map<C4Database::CollectionSpec, PullNow> _pullsNow;  // My `pullDocumentsNow` state
     int                                         _activeConflictResolvers {0};
+    Retained<ConflictResolverPool>              _conflictResolverPool;
+    CBLConflictResolutionStats                  _conflictStats {};
+    ReplicatorMetrics                           _metrics;
+#ifdef COUCHBASE_ENTERPRISE
+    PropertyCryptoBatcher                       _encryptBatcher {false};
+    PropertyCryptoBatcher                       _decryptBatcher {true};
+#endif
+    StatusSnapshot                              _statusSnapshot;    // Latest effective status
+    uint64_t                                    _statusGeneration {0};  // Bumped by each publish
+    uint64_t                                    _startGeneration {0};   // Published by the last `start`
     Listeners<CBLReplicatorChangeListener>      _changeListeners;
+    recursive_mutex                             _statusDeliveryMutex;   // Held while calling _changeListeners
+    uint64_t                                    _deliveredStatusGeneration {0};
     Listeners<CBLDocumentReplicationListener>   _docListeners;
+    recursive_mutex                             _docDeliveryMutex;  // Held while calling _docListeners
+    PendingDocuments                            _pendingDocs[2];    // Indexed by `pushing`
+    cbl_internal::MemoryAccount                 _memory {cbl_internal::MemoryCategory::kReplicators, this, sizeof(CBLReplicator)};
     C4ReplicatorProgressLevel                   _progressLevel {kC4ReplProgressOverall};;
 };
 
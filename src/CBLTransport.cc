@@ -0,0 +1,142 @@
+//
+// CBLTransport.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLReplicator.h"
+#include "CBLReplicatorConfig.hh"
+#include "Internal.hh"
+#include "c4Socket.h"
+
+using namespace std;
+using namespace fleece;
+
+
+// A CBLTransport is the C4Socket of the connection; its native handle is a TransportState.
+static inline C4Socket* internal(CBLTransport *transport) {return (C4Socket*)transport;}
+static inline CBLTransport* external(C4Socket *socket)   {return (CBLTransport*)socket;}
+
+
+namespace cbl_internal {
+
+    // The state of one connection. It has its own copy of the callbacks, since the connection
+    // may outlive the endpoint that opened it.
+    struct TransportState {
+        CBLTransportFactory factory;
+        void* _cbl_nullable context = nullptr;     // Set by CBLTransport_SetContext
+    };
+
+    static TransportState* stateOf(C4Socket *socket) {
+        return (TransportState*)c4Socket_getNativeHandle(socket);
+    }
+
+
+    // The C4SocketFactory callbacks, which forward to the CBLTransportFactory:
+
+    static void transportOpen(C4Socket *socket, const C4Address*, C4Slice, void *context) {
+        auto endpoint = (const CBLTransportEndpoint*)context;
+        c4Socket_setNativeHandle(socket, new TransportState{endpoint->factory()});
+        endpoint->factory().open(endpoint->factory().context, external(socket), endpoint->url());
+    }
+
+    static void transportWrite(C4Socket *socket, C4SliceResult data) {
+        stateOf(socket)->factory.send(external(socket), data);
+    }
+
+    static void transportCompletedReceive(C4Socket *socket, size_t byteCount) {
+        stateOf(socket)->factory.receiveCompleted(external(socket), byteCount);
+    }
+
+    // With WebSocket framing the replicator has already exchanged CLOSE messages:
+    static void transportClose(C4Socket *socket) {
+        stateOf(socket)->factory.close(external(socket), 0, nullslice);
+    }
+
+    // Without framing, the transport tells the peer why it's closing:
+    static void transportRequestClose(C4Socket *socket, int status, C4String message) {
+        stateOf(socket)->factory.close(external(socket), status, message);
+    }
+
+    static void transportDispose(C4Socket *socket) {
+        if (TransportState *state = stateOf(socket)) {
+            if (state->factory.dispose)
+                state->factory.dispose(external(socket));
+            c4Socket_setNativeHandle(socket, nullptr);
+            delete state;
+        }
+    }
+
+
+    CBLTransportEndpoint::CBLTransportEndpoint(const CBLTransportFactory &factory, slice url)
+    :CBLURLEndpoint(url, true)
+    ,_factory(factory)
+    {
+        if (!factory.open || !factory.send || !factory.receiveCompleted || !factory.close)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "CBLTransportFactory is missing a required callback");
+        // LiteCore only replicates with ws: and wss: addresses, and the transport gets the
+        // original URL anyway:
+        if (_address.scheme != kC4Replicator2Scheme && _address.scheme != kC4Replicator2TLSScheme)
+            _address.scheme = kC4Replicator2Scheme;
+
+        _c4Factory = { };
+        _c4Factory.framing = factory.messageFraming ? kC4NoFraming : kC4WebSocketClientFraming;
+        _c4Factory.context = this;
+        _c4Factory.open = &transportOpen;
+        _c4Factory.write = &transportWrite;
+        _c4Factory.completedReceive = &transportCompletedReceive;
+        if (factory.messageFraming)
+            _c4Factory.requestClose = &transportRequestClose;
+        else
+            _c4Factory.close = &transportClose;
+        _c4Factory.dispose = &transportDispose;
+    }
+
+}
+
+using namespace cbl_internal;
+
+
+#pragma mark - PUBLIC API:
+
+
+void CBLTransport_Opened(CBLTransport* transport) noexcept {
+    c4socket_opened(internal(transport));
+}
+
+void CBLTransport_Received(CBLTransport* transport, FLSlice data) noexcept {
+    c4socket_received(internal(transport), data);
+}
+
+void CBLTransport_SendCompleted(CBLTransport* transport, size_t byteCount) noexcept {
+    c4socket_completedWrite(internal(transport), byteCount);
+}
+
+void CBLTransport_CloseRequested(CBLTransport* transport, int status, FLString message) noexcept {
+    c4socket_closeRequested(internal(transport), status, message);
+}
+
+void CBLTransport_Closed(CBLTransport* transport, const CBLError* _cbl_nullable error) noexcept {
+    c4socket_closed(internal(transport), error ? internal(*error) : C4Error{});
+}
+
+void CBLTransport_SetContext(CBLTransport* transport, void* _cbl_nullable context) noexcept {
+    stateOf(internal(transport))->context = context;
+}
+
+void* _cbl_nullable CBLTransport_GetContext(CBLTransport* transport) noexcept {
+    return stateOf(internal(transport))->context;
+}
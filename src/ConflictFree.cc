@@ -0,0 +1,289 @@
+//
+// ConflictFree.cc
+//
+// Copyright (c) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ConflictFree.hh"
+#include "CBLDatabase_Internal.hh"
+#include "Internal.hh"
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal::ConflictFree {
+
+    static constexpr slice kCountsProperty  = "counts";
+    static constexpr slice kAddsProperty    = "adds";
+    static constexpr slice kRemovesProperty = "removes";
+
+    using TagMap = map<string, set<string>>;    // Set members to their tags
+
+
+    static bool isType(FLDict dict, slice type) {
+        return dict && Dict(dict)[kCBLTypeProperty].asString() == type;
+    }
+
+
+    // Identifies the database's changes; its public UUID is unique to it, and unlike the
+    // private UUID, it can be shared. Half of it is plenty.
+    static string replicaID(const CBLDatabase *db) {
+        C4UUID uuid = const_cast<CBLDatabase*>(db)->useLocked()->getPublicUUID();
+        return slice(uuid.bytes, 8).hexString();
+    }
+
+
+    // Returns the mutable dict in `dict[key]`, creating it with `type` if it doesn't exist.
+    static MutableDict getOrCreate(MutableDict dict, slice key, slice type) {
+        if (Value value = dict[key]; value) {
+            if (!isType(value.asDict(), type)) {
+                C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                               "Property '%.*s' isn't a %.*s", FMTSLICE(key), FMTSLICE(type));
+            }
+        } else {
+            MutableDict created = MutableDict::newDict();
+            created[kCBLTypeProperty] = type;
+            dict[key] = created;
+        }
+        return dict.getMutableDict(key);
+    }
+
+
+    // Returns the mutable dict in `dict[key]`, creating an empty one if it doesn't exist.
+    static MutableDict getOrCreate(MutableDict dict, slice key) {
+        if (!dict[key].asDict())
+            dict[key] = MutableDict::newDict();
+        return dict.getMutableDict(key);
+    }
+
+
+#pragma mark - COUNTERS:
+
+
+    bool isCounter(FLDict dict) {
+        return isType(dict, kCBLCounterType);
+    }
+
+
+    uint64_t counterValue(FLDict dict) {
+        if (!isCounter(dict))
+            return 0;
+        uint64_t sum = 0;
+        for (Dict::iterator i(Dict(dict)[kCountsProperty].asDict()); i; ++i)
+            sum += i.value().asUnsigned();
+        return sum;
+    }
+
+
+    void incrementCounter(MutableDict dict, slice key, const CBLDatabase *db, uint64_t amount) {
+        MutableDict counts = getOrCreate(getOrCreate(dict, key, kCBLCounterType), kCountsProperty);
+        string id = replicaID(db);
+        counts[slice(id)] = counts[slice(id)].asUnsigned() + amount;
+    }
+
+
+    static MutableDict mergeCounters(Dict local, Dict remote) {
+        MutableDict counts = MutableDict::newDict();
+        for (Dict::iterator i(local[kCountsProperty].asDict()); i; ++i)
+            counts[i.keyString()] = i.value().asUnsigned();
+        for (Dict::iterator i(remote[kCountsProperty].asDict()); i; ++i) {
+            if (i.value().asUnsigned() > counts[i.keyString()].asUnsigned())
+                counts[i.keyString()] = i.value().asUnsigned();
+        }
+        MutableDict counter = MutableDict::newDict();
+        counter[kCBLTypeProperty] = kCBLCounterType;
+        counter[kCountsProperty] = counts;
+        return counter;
+    }
+
+
+#pragma mark - SETS:
+
+
+    bool isORSet(FLDict dict) {
+        return isType(dict, kCBLORSetType);
+    }
+
+
+    static void readTags(Dict members, TagMap &tags) {
+        for (Dict::iterator i(members); i; ++i) {
+            auto &memberTags = tags[string(i.keyString())];
+            for (Array::iterator t(i.value().asArray()); t; ++t)
+                memberTags.insert(string(t.value().asString()));
+        }
+    }
+
+
+    static MutableArray tagArray(const set<string> &tags) {
+        MutableArray array = MutableArray::newArray();
+        for (auto &tag : tags)
+            array.append(slice(tag));
+        return array;
+    }
+
+
+    // A member is present if it has a tag that hasn't been removed.
+    static bool isPresent(Dict orset, slice member) {
+        Array removed = orset[kRemovesProperty].asDict()[member].asArray();
+        for (Array::iterator t(orset[kAddsProperty].asDict()[member].asArray()); t; ++t) {
+            bool isRemoved = false;
+            for (Array::iterator r(removed); r && !isRemoved; ++r)
+                isRemoved = (r.value().asString() == t.value().asString());
+            if (!isRemoved)
+                return true;
+        }
+        return false;
+    }
+
+
+    bool setContains(FLDict dict, slice member) {
+        return isORSet(dict) && isPresent(Dict(dict), member);
+    }
+
+
+    MutableArray setMembers(FLDict dict) {
+        if (!isORSet(dict))
+            return nullptr;
+        vector<slice> members;
+        for (Dict::iterator i(Dict(dict)[kAddsProperty].asDict()); i; ++i) {
+            if (isPresent(Dict(dict), i.keyString()))
+                members.push_back(i.keyString());
+        }
+        sort(members.begin(), members.end());
+        MutableArray result = MutableArray::newArray();
+        for (slice member : members)
+            result.append(member);
+        return result;
+    }
+
+
+    void addToSet(MutableDict dict, slice key, const CBLDatabase *db, slice member) {
+        MutableDict orset = getOrCreate(dict, key, kCBLORSetType);
+        MutableDict adds = getOrCreate(orset, kAddsProperty);
+
+        // Tag the addition with this database's ID and a number it hasn't used for the member:
+        string prefix = replicaID(db) + ":";
+        uint64_t last = 0;
+        for (slice property : {kAddsProperty, kRemovesProperty}) {
+            for (Array::iterator t(orset[property].asDict()[member].asArray()); t; ++t) {
+                string tag(t.value().asString());
+                if (tag.compare(0, prefix.size(), prefix) == 0)
+                    last = max<uint64_t>(last, strtoull(tag.c_str() + prefix.size(), nullptr, 10));
+            }
+        }
+        if (!adds[member].asArray())
+            adds[member] = MutableArray::newArray();
+        adds.getMutableArray(member).append(slice(prefix + to_string(last + 1)));
+    }
+
+
+    void removeFromSet(MutableDict dict, slice key, slice member) {
+        if (!isORSet(dict[key].asDict()))
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Property '%.*s' isn't an orset", FMTSLICE(key));
+        MutableDict orset = dict.getMutableDict(key);
+        Array added = orset[kAddsProperty].asDict()[member].asArray();
+        if (added.empty())
+            return;
+        // Remove the tags seen here, keeping them so that merges remove them too:
+        MutableDict removes = getOrCreate(orset, kRemovesProperty);
+        if (!removes[member].asArray())
+            removes[member] = MutableArray::newArray();
+        MutableArray removed = removes.getMutableArray(member);
+        for (Array::iterator t(added); t; ++t)
+            removed.append(t.value().asString());
+        orset.getMutableDict(kAddsProperty).remove(member);
+    }
+
+
+    static MutableDict mergeSets(Dict local, Dict remote) {
+        TagMap adds, removes;
+        readTags(local[kAddsProperty].asDict(), adds);
+        readTags(remote[kAddsProperty].asDict(), adds);
+        readTags(local[kRemovesProperty].asDict(), removes);
+        readTags(remote[kRemovesProperty].asDict(), removes);
+
+        MutableDict mergedAdds = MutableDict::newDict(), mergedRemoves = MutableDict::newDict();
+        for (auto &[member, tags] : adds) {
+            set<string> live;
+            auto &removed = removes[member];
+            set_difference(tags.begin(), tags.end(), removed.begin(), removed.end(),
+                           inserter(live, live.end()));
+            if (!live.empty())
+                mergedAdds[slice(member)] = tagArray(live);
+        }
+        for (auto &[member, tags] : removes) {
+            if (!tags.empty())
+                mergedRemoves[slice(member)] = tagArray(tags);
+        }
+
+        MutableDict orset = MutableDict::newDict();
+        orset[kCBLTypeProperty] = kCBLORSetType;
+        orset[kAddsProperty] = mergedAdds;
+        orset[kRemovesProperty] = mergedRemoves;
+        return orset;
+    }
+
+
+#pragma mark - MERGING:
+
+
+    // Merges `remote` into `local`, a copy of the local revision's properties. Returns false
+    // if they differ in anything but counters and sets, including a property being missing
+    // from one of them, since without their common ancestor it isn't known whether it was
+    // added or removed.
+    static bool mergeInto(MutableDict local, Dict remote) {
+        if (local.count() != remote.count())
+            return false;
+        for (Dict::iterator i(remote); i; ++i) {
+            slice key = i.keyString();
+            Value l = local.get(key), r = i.value();
+            if (!l)
+                return false;
+            if (l.isEqual(r))
+                continue;
+            Dict ld = l.asDict(), rd = r.asDict();
+            if (!ld || !rd)
+                return false;
+            if (isCounter(ld) && isCounter(rd)) {
+                local[key] = mergeCounters(ld, rd);
+            } else if (isORSet(ld) && isORSet(rd)) {
+                local[key] = mergeSets(ld, rd);
+            } else if (ld[kCBLTypeProperty] || rd[kCBLTypeProperty]) {
+                return false;       // Blobs, encryptables, or different types
+            } else if (!mergeInto(local.getMutableDict(key), rd)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+
+    MutableDict merge(Dict local, Dict remote) {
+        MutableDict merged = local.mutableCopy(kFLDeepCopyImmutables);
+        if (!mergeInto(merged, remote))
+            return nullptr;
+        return merged;
+    }
+
+}
+
@@ -0,0 +1,47 @@
+//
+// ConflictFree.hh
+//
+// Copyright (c) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLConflictFree.h"
+#include "fleece/Mutable.hh"
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** The counters and observed-remove sets described in CBLConflictFree.h. */
+    namespace ConflictFree {
+
+        bool isCounter(FLDict _cbl_nullable);
+        uint64_t counterValue(FLDict _cbl_nullable);
+        void incrementCounter(fleece::MutableDict, fleece::slice key, const CBLDatabase*, uint64_t amount);
+
+        bool isORSet(FLDict _cbl_nullable);
+        bool setContains(FLDict _cbl_nullable, fleece::slice member);
+        fleece::MutableArray setMembers(FLDict _cbl_nullable);
+        void addToSet(fleece::MutableDict, fleece::slice key, const CBLDatabase*, fleece::slice member);
+        void removeFromSet(fleece::MutableDict, fleece::slice key, fleece::slice member);
+
+        /** Merges two conflicting revisions' properties, if they differ only in counters and
+            sets. Returns null if anything else differs. */
+        fleece::MutableDict merge(fleece::Dict local, fleece::Dict remote);
+    }
+
+}
+
+CBL_ASSUME_NONNULL_END
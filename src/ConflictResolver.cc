@@ -17,6 +17,7 @@
 //
 
 #include "ConflictResolver.hh"
+#include "ConflictFree.hh"
 #include "CBLReplicator_Internal.hh"
 #include "CBLDocument_Internal.hh"
 #include "CBLCollection_Internal.hh"
@@ -24,6 +25,9 @@
 #include "c4DocEnumerator.hh"
 #include "StringUtil.hh"
 #include "Stopwatch.hh"
+#include "Trace.hh"
+#include "TaskPool.hh"
+#include <algorithm>
 #include <string>
 #include "betterassert.hh"
 
@@ -69,80 +73,156 @@ namespace cbl_internal {
     { }
 
 
-    void ConflictResolver::runAsync(CompletionHandler completionHandler) noexcept {
-        assert(completionHandler);
-        _completionHandler = completionHandler;
-        SyncLog(Info, "Scheduling async resolution of conflict in doc '%.*s'",
-                FMTSLICE(_docID));
-        c4_runAsyncTask([](void *context) { ((ConflictResolver*)context)->runNow(); },
-                        this);
-    }
-
-
     // Performs conflict resolution. Returns true on success, false on failure. Sets _error.
     bool ConflictResolver::runNow() {
-        bool ok, inConflict = false;
+        bool ok = true;
         int retryCount = 0;
         try {
-            do {
-                // Create a CBLDocument that reflects the conflict revision:
-                auto conflict = _collection->getMutableDocument(_docID);
-                if (!conflict) {
-                    SyncLog(Info, "Doc '%.*s' no longer exists, no conflict to resolve",
-                            FMTSLICE(_docID));
-                    return true;
-                }
-                
-                ok = conflict->selectNextConflictingRevision();
-                if (!ok) {
-                    // Revision is gone or not a leaf: Conflict must be resolved, so stop
-                    SyncLog(Info, "Conflict in doc '%.*s' already resolved, nothing to do",
-                            FMTSLICE(_docID));
-                    if (_completionHandler) {
-                        _completionHandler(this);       // the handler will most likely delete me
-                    }
-                    return true;
+            while (prepare() && !save()) {
+                // If a local revision is saved at the same time we'll fail with a conflict, so retry:
+                if (++retryCount >= 10) {
+                    ok = false;
+                    break;
                 }
-
-                // Now resolve the conflict:
-                if (_clientResolver)
-                    ok = customResolve(conflict);
-                else
-                    ok = defaultResolve(conflict);
-
-                if (ok) {
-                    _flags = conflict->revisionFlags();
-                    inConflict = false;
-                } else {
-                    _error = external(C4Error::make(LiteCoreDomain, kC4ErrorConflict));
-                    // If a local revision is saved at the same time we'll fail with a conflict, so retry:
-                    inConflict = (++retryCount < 10);
-                    if (inConflict) {
-                        SyncLog(Warning, "%s conflict resolution of doc '%.*s' conflicted with newer saved"
-                                " revision; retrying...",
-                                (_clientResolver ? "Custom" : "Default"), FMTSLICE(_docID));
-                    }
-                }
-            } while (inConflict);
+                SyncLog(Warning, "%s conflict resolution of doc '%.*s' conflicted with newer saved"
+                        " revision; retrying...",
+                        kind(), FMTSLICE(_docID));
+            }
         } catch (...) {
-            C4Error::fromCurrentException(internal(&_error));
+            captureException();
             ok = false;
         }
+        finish(ok);
+        return ok;
+    }
 
+
+    // Reads the conflicting revision and decides how to resolve it, without saving anything.
+    // Returns false if there's no conflict to resolve anymore. Throws on error.
+    bool ConflictResolver::prepare() {
+        if (!loadConflict())
+            return false;
+
+        // Now decide how to resolve the conflict:
+        if (mergeConflictFree())
+            return true;
+        if (_batchResolver) {
+            CBLConflict c = conflict();
+            callBatchResolver(_batchResolver, _clientResolverContext, _collection, &c, 1);
+            useResolution(c.resolved);
+        } else if (_clientResolver) {
+            customResolve();
+        } else {
+            defaultResolve();
+        }
+        return true;
+    }
+
+
+    // Reads the conflicting and local revisions. Returns false if there's no conflict anymore.
+    bool ConflictResolver::loadConflict() {
+        // Create a CBLDocument that reflects the conflict revision:
+        _conflict = _collection->getMutableDocument(_docID);
+        if (!_conflict) {
+            SyncLog(Info, "Doc '%.*s' no longer exists, no conflict to resolve",
+                    FMTSLICE(_docID));
+            return false;
+        }
+
+        if (!_conflict->selectNextConflictingRevision()) {
+            // Revision is gone or not a leaf: Conflict must be resolved, so stop
+            SyncLog(Info, "Conflict in doc '%.*s' already resolved, nothing to do",
+                    FMTSLICE(_docID));
+            _conflict = nullptr;
+            return false;
+        }
+
+        _localDoc = _collection->getDocument(_docID, false);
+        if (_localDoc && _localDoc->revisionFlags() & kRevDeleted)
+            _localDoc = nullptr;
+        return true;
+    }
+
+
+    // The remote revision, or null if it's a deletion.
+    CBLDocument* ConflictResolver::remoteDoc() const {
+        return (_conflict->revisionFlags() & kRevDeleted) ? nullptr : _conflict.get();
+    }
+
+
+    CBLConflict ConflictResolver::conflict() const {
+        // `resolved` starts out as the local revision, so that a conflict the batch resolver
+        // skips keeps it instead of being deleted:
+        return {_docID, _localDoc, remoteDoc(), _localDoc};
+    }
+
+
+    const char* ConflictResolver::kind() const {
+        if (_mergedConflictFree)
+            return "Conflict-free";
+        return _batchResolver ? "Batch" : (_clientResolver ? "Custom" : "Default");
+    }
+
+
+    // Saves the resolution decided on by prepare(). Returns false if a newer local revision
+    // was saved meanwhile, in which case it has to be prepared again. Throws on other errors.
+    bool ConflictResolver::save() {
+        auto conflict = std::move(_conflict);
+        auto resolved = std::move(_resolved);
+        _localDoc = nullptr;
+        if (!conflict->resolveConflict(_resolution, resolved)) {
+            _error = external(C4Error::make(LiteCoreDomain, kC4ErrorConflict));
+            return false;
+        }
+        _flags = conflict->revisionFlags();
+        _saved = true;
+        return true;
+    }
+
+
+    void ConflictResolver::captureException() {
+        C4Error::fromCurrentException(internal(&_error));
+        _conflict = nullptr;
+        _localDoc = nullptr;
+        _resolved = nullptr;
+    }
+
+
+    // Logs the outcome and calls the completion handler.
+    void ConflictResolver::finish(bool ok) {
         if (ok) {
-            SyncLog(Info, "Successfully resolved and saved doc '%.*s'", FMTSLICE(_docID));
+            if (_saved)
+                SyncLog(Info, "Successfully resolved and saved doc '%.*s'", FMTSLICE(_docID));
             _error = {};
         } else {
             SyncLog(Error, "%s conflict resolution of doc '%.*s' failed: %s\n%s",
-                    (_clientResolver ? "Custom" : "Default"),
+                    kind(),
                     FMTSLICE(_docID),
                     internal(_error).description().c_str(),
                     internal(_error).backtrace().c_str());
         }
-        
+
         if (_completionHandler)
             _completionHandler(this);       // the handler will most likely delete me
-        return ok;
+    }
+
+
+    // If the local and remote revisions differ only in counters and sets, merges them.
+    // Returns false if they can't be merged this way.
+    bool ConflictResolver::mergeConflictFree() {
+        CBLDocument *remote = remoteDoc();
+        if (!_localDoc || !remote)
+            return false;
+        MutableDict merged = ConflictFree::merge(_localDoc->properties(), remote->properties());
+        if (!merged)
+            return false;
+        SyncLog(Verbose, "Merged conflict-free values of doc '%.*s'", FMTSLICE(_docID));
+        auto resolved = make_retained<CBLDocument>(_docID, true);
+        resolved->setProperties(merged);
+        _resolved = resolved;
+        _resolution = CBLDocument::Resolution::useMerge;
+        _mergedConflictFree = true;
+        return true;
     }
 
 
@@ -150,57 +230,68 @@ namespace cbl_internal {
     // 1. Deleted wins
     // 2. Higher generation wins
     // 3. Higher revisionID wins
-    bool ConflictResolver::defaultResolve(CBLDocument *conflict) {
-        CBLDocument *remoteDoc = conflict;
-        if (remoteDoc->revisionFlags() & kRevDeleted)
-            remoteDoc = nullptr;
-        
-        auto localDoc = _collection->getDocument(_docID, false);
-        if (localDoc && localDoc->revisionFlags() & kRevDeleted)
-            localDoc = nullptr;
-        
-        auto resolved = defaultConflictResolver(_clientResolverContext, _docID, localDoc, remoteDoc);
+    void ConflictResolver::defaultResolve() {
+        CBLDocument *remote = remoteDoc();
+        auto resolved = defaultConflictResolver(_clientResolverContext, _docID, _localDoc, remote);
         
-        CBLDocument::Resolution resolution;
-        if (resolved == remoteDoc)
-            resolution = CBLDocument::Resolution::useRemote;
+        if (resolved == remote)
+            _resolution = CBLDocument::Resolution::useRemote;
         else
-            resolution = CBLDocument::Resolution::useLocal;
-        
-        return conflict->resolveConflict(resolution, resolved);
+            _resolution = CBLDocument::Resolution::useLocal;
+        _resolved = resolved;
     }
 
 
     // Performs custom conflict resolution.
-    bool ConflictResolver::customResolve(CBLDocument *conflict) {
-        CBLDocument *remoteDoc = conflict;
-        if (remoteDoc->revisionFlags() & kRevDeleted)
-            remoteDoc = nullptr;
-        
-        auto localDoc = _collection->getDocument(_docID, false);
-        if (localDoc && localDoc->revisionFlags() & kRevDeleted)
-            localDoc = nullptr;
-
+    void ConflictResolver::customResolve() {
         // Call the custom resolver (this could take a long time to return)
         SyncLog(Verbose, "Calling custom conflict resolver for doc '%.*s' ...",
                 FMTSLICE(_docID));
         Stopwatch st;
         const CBLDocument* resolved;
         try {
-            resolved = _clientResolver(_clientResolverContext, _docID, localDoc, remoteDoc);
+            resolved = _clientResolver(_clientResolverContext, _docID, _localDoc, remoteDoc());
         } catch (...) {
             C4Error::raise(LiteCoreDomain, kC4ErrorUnexpectedError,
                            "Custom conflict handler threw an exception");
         }
         SyncLog(Info, "Custom conflict resolver for '%.*s' took %.0fms",
                 FMTSLICE(_docID), st.elapsedMS());
+        useResolution(resolved);
+    }
 
-        // Determine the resolution type:
-        CBLDocument::Resolution resolution;
-        if (resolved == localDoc)
-            resolution = CBLDocument::Resolution::useLocal;
-        else if (resolved == conflict)
-            resolution = CBLDocument::Resolution::useRemote;
+
+    // Calls a batch resolver on some conflicts in one collection.
+    void ConflictResolver::callBatchResolver(CBLBatchConflictResolver resolver,
+                                             void* context,
+                                             CBLCollection* collection,
+                                             CBLConflict conflicts[],
+                                             size_t count)
+    {
+        SyncLog(Verbose, "Calling batch conflict resolver for %zu docs ...", count);
+        Stopwatch st;
+        try {
+            resolver(context, collection, conflicts, count);
+        } catch (...) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorUnexpectedError,
+                           "Batch conflict handler threw an exception");
+        }
+        SyncLog(Info, "Batch conflict resolver for %zu docs took %.0fms", count, st.elapsedMS());
+    }
+
+
+    // Determines the resolution type from the document returned by a custom or batch resolver.
+    void ConflictResolver::useResolution(const CBLDocument* resolved) {
+        // The remote (conflict) and local docs are retained by us. A merged doc created by the
+        // resolver is owned by us, so it's adopted:
+        _resolved = resolved;
+        if (resolved != _localDoc && resolved != _conflict)
+            CBLDocument_Release(resolved);
+
+        if (resolved == _localDoc)
+            _resolution = CBLDocument::Resolution::useLocal;
+        else if (resolved == _conflict)
+            _resolution = CBLDocument::Resolution::useRemote;
         else {
             if (resolved) {
                 // Sanity check the resolved document:
@@ -215,19 +306,8 @@ namespace cbl_internal {
                                      FMTSLICE(resolved->docID()), FMTSLICE(_docID));
                 }
             }
-            resolution = CBLDocument::Resolution::useMerge;
+            _resolution = CBLDocument::Resolution::useMerge;
         }
-
-        // Actually resolve the conflict & save the document:
-        bool result = conflict->resolveConflict(resolution, resolved);
-        
-        // The remoteDoc (conflict) and localDoc are backed by the RetainedConst and will be
-        // released by the RetainedConst destructor. For the merged doc created and returned by
-        // the custom conflict resolver, an explicit release is needed here.
-        if (resolved != localDoc && resolved != remoteDoc)
-            CBLDocument_Release(resolved);
-        
-        return result;
     }
 
     CBLReplicatedDocument ConflictResolver::result() const {
@@ -244,4 +324,202 @@ namespace cbl_internal {
         return doc;
     }
 
+
+#pragma mark - POOL:
+
+
+    ConflictResolverPool::ConflictResolverPool(CBLDatabase *db,
+                                               unsigned maxConcurrent,
+                                               unsigned batchSize,
+                                               unsigned batchDelayMS,
+                                               BatchHandler batchHandler)
+    :_db(db)
+    ,_maxConcurrent(std::max(maxConcurrent, 1u))
+    ,_batchSize(std::max(batchSize, 1u))
+    ,_batchDelay(std::chrono::milliseconds(batchDelayMS))
+    ,_batchHandler(std::move(batchHandler))
+    { }
+
+
+    void ConflictResolverPool::schedule(ConflictResolver *resolver,
+                                        ConflictResolver::CompletionHandler completionHandler)
+    {
+        assert(completionHandler);
+        resolver->_completionHandler = std::move(completionHandler);
+        SyncLog(Info, "Scheduling async resolution of conflict in doc '%.*s'",
+                FMTSLICE(resolver->_docID));
+        {
+            LOCK(_mutex);
+            if (_pending.empty())
+                _pendingSince = Clock::now();
+            auto pos = std::upper_bound(_pending.begin(), _pending.end(), resolver,
+                                        [](ConflictResolver *a, ConflictResolver *b) {
+                return a->_priority > b->_priority;
+            });
+            _pending.insert(pos, resolver);
+            if (_pending.size() == _batchSize)
+                _batchFull.notify_one();
+            if (_activeWorkers >= _maxConcurrent)
+                return;             // A running worker will get to it
+            ++_activeWorkers;
+        }
+        retain(this);               // Released when the worker is done
+        AsyncTasks::run([](void *context) {
+            auto pool = (ConflictResolverPool*)context;
+            pool->runWorker();
+            release(pool);
+        }, this);
+    }
+
+
+    // Runs batches until there are no more pending resolvers.
+    void ConflictResolverPool::runWorker() {
+        std::vector<ConflictResolver*> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (_pending.empty()) {
+                    --_activeWorkers;
+                    return;
+                }
+                // Give more conflicts a chance to arrive, if the batch isn't full:
+                if (_pending.size() < _batchSize && _batchDelay > Clock::duration::zero()) {
+                    _batchFull.wait_until(lock, _pendingSince + _batchDelay, [&] {
+                        return _pending.size() >= _batchSize;
+                    });
+                    if (_pending.empty())
+                        continue;           // Another worker took them
+                }
+                auto n = std::min(size_t(_batchSize), _pending.size());
+                batch.assign(_pending.begin(), _pending.begin() + n);
+                _pending.erase(_pending.begin(), _pending.begin() + n);
+                _pendingSince = Clock::now();
+            }
+            runBatch(batch);
+        }
+    }
+
+
+    void ConflictResolverPool::runBatch(std::vector<ConflictResolver*> &batch) {
+        TraceSpan span(kCBLTraceConflictResolution);
+        span.addItems(batch.size());
+        Stopwatch st;
+        std::vector<ConflictResolver*> toSave, saved, unchanged, failed, retry;
+
+        // First decide on the resolutions, without holding the database lock, since custom
+        // resolvers may take a while. Conflicts with batch resolvers are grouped by collection:
+        std::vector<std::vector<ConflictResolver*>> groups;
+        for (auto resolver : batch) {
+            try {
+                if (!resolver->loadConflict()) {
+                    unchanged.push_back(resolver);
+                } else if (resolver->mergeConflictFree()) {
+                    toSave.push_back(resolver);
+                } else if (resolver->_batchResolver) {
+                    auto group = std::find_if(groups.begin(), groups.end(), [&](auto &g) {
+                        return g[0]->_collection == resolver->_collection;
+                    });
+                    if (group != groups.end())
+                        group->push_back(resolver);
+                    else
+                        groups.push_back({resolver});
+                } else {
+                    if (resolver->_clientResolver)
+                        resolver->customResolve();
+                    else
+                        resolver->defaultResolve();
+                    toSave.push_back(resolver);
+                }
+            } catch (...) {
+                resolver->captureException();
+                failed.push_back(resolver);
+            }
+        }
+        for (auto &group : groups)
+            prepareBatchResolved(group, toSave, failed);
+
+        double resolveMS = st.elapsedMS();
+        Stopwatch saveTime;
+
+        // Then save them all in one transaction:
+        if (!toSave.empty()) {
+            try {
+                _db->useLocked([&](C4Database *c4db) {
+                    C4Database::Transaction t(c4db);
+                    for (auto resolver : toSave) {
+                        try {
+                            if (resolver->save())
+                                saved.push_back(resolver);
+                            else
+                                retry.push_back(resolver);  // Conflicted with a newer local revision
+                        } catch (...) {
+                            resolver->captureException();
+                            failed.push_back(resolver);
+                        }
+                    }
+                    TraceSpan commitSpan(kCBLTraceCommit);
+                    commitSpan.addItems(toSave.size());
+                    t.commit();
+                });
+            } catch (...) {
+                // The commit failed, so none of the resolutions were saved:
+                for (auto resolver : saved) {
+                    resolver->captureException();
+                    failed.push_back(resolver);
+                }
+                saved.clear();
+            }
+        }
+
+        if (_batchHandler)
+            _batchHandler(batch.size(), resolveMS, saveTime.elapsedMS());
+
+        // Now that the batch is committed, call the completion handlers (which delete the
+        // resolvers, so the batch handler had to be called first.) Retries are done one by one.
+        for (auto resolver : saved)
+            resolver->finish(true);
+        for (auto resolver : unchanged)
+            resolver->finish(true);
+        for (auto resolver : failed)
+            resolver->finish(false);
+        for (auto resolver : retry) {
+            SyncLog(Warning, "%s conflict resolution of doc '%.*s' conflicted with newer saved"
+                    " revision; retrying...",
+                    resolver->kind(), FMTSLICE(resolver->_docID));
+            resolver->runNow();
+        }
+    }
+
+
+    // Calls a collection's batch resolver on a group of its conflicts.
+    void ConflictResolverPool::prepareBatchResolved(std::vector<ConflictResolver*> &group,
+                                                    std::vector<ConflictResolver*> &toSave,
+                                                    std::vector<ConflictResolver*> &failed)
+    {
+        auto first = group[0];
+        std::vector<CBLConflict> conflicts;
+        conflicts.reserve(group.size());
+        for (auto resolver : group)
+            conflicts.push_back(resolver->conflict());
+        try {
+            ConflictResolver::callBatchResolver(first->_batchResolver, first->_clientResolverContext,
+                                                first->_collection, conflicts.data(), conflicts.size());
+        } catch (...) {
+            for (auto resolver : group) {
+                resolver->captureException();
+                failed.push_back(resolver);
+            }
+            return;
+        }
+        for (size_t i = 0; i < group.size(); ++i) {
+            try {
+                group[i]->useResolution(conflicts[i].resolved);
+                toSave.push_back(group[i]);
+            } catch (...) {
+                group[i]->captureException();
+                failed.push_back(group[i]);
+            }
+        }
+    }
+
 }
@@ -6,7 +6,13 @@
 
 #pragma once
 #include "CBLReplicatorConfig.hh"
+#include "CBLDocument_Internal.hh"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
+#include <mutex>
+#include <vector>
 
 CBL_ASSUME_NONNULL_BEGIN
 
@@ -16,7 +22,11 @@ namespace cbl_internal {
     using namespace std;
     using namespace fleece;
 
-    /** Resolves a replication conflict in a document, synchronously or asynchronously. */
+    /** Resolves a replication conflict in a document, synchronously or asynchronously.
+        Resolution has two stages, which ConflictResolverPool runs separately so it can save
+        several resolutions in one transaction: `prepare` decides on the resolution (calling the
+        custom or batch resolver, if any), then `save` saves it. Revisions that differ only in
+        conflict-free values (CBLConflictFree.h) are merged without calling a resolver. */
     class ConflictResolver {
     public:
         /// Basic constructor.
@@ -32,11 +42,8 @@ namespace cbl_internal {
 
         using CompletionHandler = function<void(ConflictResolver*)>;
 
-        /// Schedules async conflict resolution.
-        /// @param handler  Completion handler to call when finished.
-        void runAsync(CompletionHandler handler) noexcept;
-
-        /// Performs resolution synchronously.
+        /// Performs resolution synchronously, retrying if a newer local revision is saved
+        /// meanwhile, then calls the completion handler if any.
         /// @return true on success, false on failure.
         bool runNow();
 
@@ -44,18 +51,99 @@ namespace cbl_internal {
         /// to the replicator's progress listener.
         CBLReplicatedDocument result() const;
 
+        CBLCollection* collection() const       {return _collection;}
+
+        /// Sets a batch resolver, which is used instead of the custom resolver.
+        void setBatchResolver(CBLBatchConflictResolver _cbl_nullable batchResolver) {
+            _batchResolver = batchResolver;
+        }
+
+        /// Sets the priority of the resolver's collection; ConflictResolverPool runs resolvers
+        /// with higher priorities first.
+        void setPriority(int priority)           {_priority = priority;}
+
     private:
-        bool _runNow();
-        bool defaultResolve(CBLDocument *conflict);
-        bool customResolve(CBLDocument *conflict);
+        friend class ConflictResolverPool;
+
+        bool prepare();
+        bool loadConflict();
+        bool save();
+        void finish(bool ok);
+        void captureException();
+        bool mergeConflictFree();
+        void defaultResolve();
+        void customResolve();
+        void useResolution(const CBLDocument* _cbl_nullable resolved);
+        CBLConflict conflict() const;
+        const char* kind() const;
+        CBLDocument* _cbl_nullable remoteDoc() const;
+
+        static void callBatchResolver(CBLBatchConflictResolver,
+                                      void* _cbl_nullable context,
+                                      CBLCollection*,
+                                      CBLConflict conflicts[],
+                                      size_t count);
 
         Retained<CBLCollection>  _collection;
         CBLConflictResolver _cbl_nullable _clientResolver;
+        CBLBatchConflictResolver _cbl_nullable _batchResolver {nullptr};
+        int                     _priority {0};
         void* _cbl_nullable     _clientResolverContext;
         alloc_slice const       _docID;
         C4RevisionFlags         _flags {};
         CompletionHandler       _completionHandler;
         CBLError                _error {};
+        // The resolution decided on by prepare(), to be saved by save():
+        Retained<CBLDocument>   _conflict;
+        RetainedConst<CBLDocument> _localDoc;
+        CBLDocument::Resolution _resolution {};
+        RetainedConst<CBLDocument> _resolved;
+        bool                    _saved {false};
+        bool                    _mergedConflictFree {false};
+    };
+
+
+    /** Runs a replicator's conflict resolvers on a limited number of background tasks.
+        Each task takes a batch of pending conflicts (waiting up to the batch delay for enough of
+        them), and prepares their resolutions: one by one, except that conflicts in a collection
+        with a batch resolver are passed to it together. Then it saves them all in a single
+        transaction. Conflicts that can't be saved because the document changed meanwhile are
+        retried individually. */
+    class ConflictResolverPool final : public CBLRefCounted {
+    public:
+        /// Called after each batch, before the batch's completion handlers, with the times
+        /// taken to decide on the resolutions and to save them.
+        using BatchHandler = function<void(size_t batchSize, double resolveMS, double saveMS)>;
+
+        ConflictResolverPool(CBLDatabase*,
+                             unsigned maxConcurrent,
+                             unsigned batchSize,
+                             unsigned batchDelayMS,
+                             BatchHandler);
+
+        /// Schedules a resolver, after any pending ones of the same or higher priority.
+        /// Its completion handler is called when it's done, and it should delete the resolver.
+        void schedule(ConflictResolver*, ConflictResolver::CompletionHandler);
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void runWorker();
+        void runBatch(std::vector<ConflictResolver*> &batch);
+        void prepareBatchResolved(std::vector<ConflictResolver*> &group,
+                                  std::vector<ConflictResolver*> &toSave,
+                                  std::vector<ConflictResolver*> &failed);
+
+        Retained<CBLDatabase> const         _db;
+        unsigned const                      _maxConcurrent;
+        unsigned const                      _batchSize;
+        Clock::duration const               _batchDelay;
+        BatchHandler const                  _batchHandler;
+        std::mutex                          _mutex;             // Guards the members below
+        std::condition_variable             _batchFull;         // Notified when _pending fills a batch
+        std::deque<ConflictResolver*>       _pending;           // Highest priority first
+        Clock::time_point                   _pendingSince;      // When _pending became non-empty
+        unsigned                            _activeWorkers {0};
     };
 }
 
@@ -17,6 +17,8 @@
 //
 
 #include "ContextManager.hh"
+#include "LockTiming.hh"
+#include <thread>
 
 using namespace std;
 using namespace fleece;
@@ -30,25 +32,79 @@ namespace cbl_internal {
 
     ContextManager::ContextManager() { }
 
-    void* ContextManager::registerObject(CBLRefCounted* object) {
-        std::lock_guard<std::mutex> lock(_mutex);
-        _contexts.insert({(void*)object, retained(object)});
-        return object;
+    ContextManager::Slot* ContextManager::slot(uintptr_t index) const {
+        if (index / kChunkSize >= kMaxChunks)
+            return nullptr;
+        Chunk* chunk = _chunks[index / kChunkSize].load(memory_order_acquire);
+        return chunk ? &chunk->slots[index % kChunkSize] : nullptr;
     }
 
-    void ContextManager::unregisterObject(void* ptr) {
-        std::lock_guard<std::mutex> lock(_mutex);
-        if (auto i = _contexts.find(ptr); i != _contexts.end()) {
-            _contexts.erase(i);
+    void* ContextManager::registerObject(CBLRefCounted* object) {
+        TIMED_LOCK(_mutex, kContextManager);
+        uint32_t index;
+        if (!_freeSlots.empty()) {
+            index = _freeSlots.back();
+            _freeSlots.pop_back();
+        } else {
+            if (_slotCount >= kChunkSize * kMaxChunks || _slotCount >= kIndexMask)
+                C4Error::raise(LiteCoreDomain, kC4ErrorMemoryError, "Too many registered contexts");
+            index = uint32_t(_slotCount++);
+            if (index % kChunkSize == 0)
+                _chunks[index / kChunkSize].store(new Chunk, memory_order_release);
         }
+        Slot* s = slot(index);
+        s->object = retain(object);
+        uint64_t state = s->state.load(memory_order_relaxed);
+        s->state.store(state | kLiveBit, memory_order_release);
+        uint32_t generation = uint32_t(state >> 32) & kGenerationMask;
+        // Index 0 is never a valid handle, so that no handle is null:
+        return (void*)((uintptr_t(generation) << kIndexBits) | (uintptr_t(index) + 1));
     }
 
-    Retained<CBLRefCounted> ContextManager::getObject(void* ptr) {
-        std::lock_guard<std::mutex> lock(_mutex);
-        if (auto i = _contexts.find(ptr); i != _contexts.end()) {
-            return i->second;
+    void ContextManager::unregisterObject(void* handle) {
+        uintptr_t index = (uintptr_t(handle) & kIndexMask) - 1;
+        uint32_t generation = uint32_t(uintptr_t(handle) >> kIndexBits);
+        CBLRefCounted* object;
+        {
+            TIMED_LOCK(_mutex, kContextManager);
+            Slot* s = uintptr_t(handle) ? slot(index) : nullptr;
+            if (!s)
+                return;
+            uint64_t state = s->state.load(memory_order_acquire);
+            if (!(state & kLiveBit) || (uint32_t(state >> 32) & kGenerationMask) != generation)
+                return;
+            // Bump the generation so no new lookups match, then wait for the current ones, which
+            // only hold the slot long enough to retain the object:
+            uint64_t next = (state & ~(kLiveBit | kReadersMask)) + (uint64_t(1) << 32);
+            while (!s->state.compare_exchange_weak(state, next | (state & kReadersMask),
+                                                   memory_order_acq_rel))
+                ;
+            while (s->state.load(memory_order_acquire) & kReadersMask)
+                std::this_thread::yield();
+            object = s->object;
+            s->object = nullptr;
+            _freeSlots.push_back(uint32_t(index));
         }
-        return nullptr;
+        release(object);
+    }
+
+    Retained<CBLRefCounted> ContextManager::getObject(void* handle) {
+        if (!handle)
+            return nullptr;
+        uintptr_t index = (uintptr_t(handle) & kIndexMask) - 1;
+        uint32_t generation = uint32_t(uintptr_t(handle) >> kIndexBits);
+        Slot* s = slot(index);
+        if (!s)
+            return nullptr;
+        // Register as a reader, if the slot still holds this handle's object:
+        uint64_t state = s->state.load(memory_order_acquire);
+        do {
+            if (!(state & kLiveBit) || (uint32_t(state >> 32) & kGenerationMask) != generation)
+                return nullptr;
+        } while (!s->state.compare_exchange_weak(state, state + 1, memory_order_acquire));
+        Retained<CBLRefCounted> object = s->object;
+        s->state.fetch_sub(1, memory_order_release);
+        return object;
     }
 
 }
@@ -18,40 +18,68 @@
 
 #pragma once
 #include "Internal.hh"
+#include <atomic>
+#include <cstdint>
 #include <mutex>
-#include <unordered_map>
+#include <vector>
 
 CBL_ASSUME_NONNULL_BEGIN
 
 namespace cbl_internal {
 
     /**
-     Thread-safe context manager for retaining and mapping the object with its pointer value which can be used
-     as a (captured) context for LiteCore's callback which could be either in C++ or C. This would allow the
-     callback to verify that the context pointer value is still valid or not before using it. The implementation simply
-     stores the object in a map by using its memory address as the key and returns the memory address as
-     the pointer value.
-      
-     @note
-     There is a chance that a new registered objects may have the same memory address as the ones previously
-     unregistered. This implementation can be improved to reduce a chance of reusing the same memory address
-     by generating integer keys with reuseable integer number + cycle count as inspired by the implementation of
-     C# GCHandle. For now, the context object MUST BE validated for its originality before use. */
+     Thread-safe context manager for retaining and mapping an object to an opaque handle, which can be
+     used as a (captured) context for LiteCore's callback which could be either in C++ or C. This allows
+     the callback to verify that the context is still valid before using it.
+
+     A handle is the index of a slot in a table, plus the generation of the object that was
+     registered in it. Unregistering an object increments its slot's generation, so the old handle
+     stops matching even after the slot is reused for another object. `getObject` doesn't take a
+     lock; registering and unregistering, which are much rarer, do. */
     class ContextManager {
     public:
         static ContextManager& shared();
         
+        /** Registers an object, retaining it, and returns a new handle for it. */
         void* registerObject(CBLRefCounted* object);
         
-        void unregisterObject(void* ptr);
+        /** Unregisters the object with this handle and releases it; no-op if there is none. */
+        void unregisterObject(void* _cbl_nullable handle);
         
-        fleece::Retained<CBLRefCounted> getObject(void* ptr);
+        /** Returns the object registered with this handle, or null if it's been unregistered. */
+        fleece::Retained<CBLRefCounted> getObject(void* _cbl_nullable handle);
         
     private:
+        // Handles are pointer-sized, so 32-bit platforms get fewer slots and generations:
+        static constexpr unsigned kIndexBits = (sizeof(void*) >= 8) ? 32 : 20;
+        static constexpr uintptr_t kIndexMask = (uintptr_t(1) << kIndexBits) - 1;
+        static constexpr uint32_t kGenerationMask = (sizeof(void*) >= 8) ? UINT32_MAX
+                                                                          : (1u << (32 - kIndexBits)) - 1;
+        static constexpr size_t kChunkSize = 256;                       // Slots per chunk
+        static constexpr size_t kMaxChunks = 4096;                      // => 1M slots
+
+        // A slot's state packs its generation (high 32 bits), whether an object is registered
+        // (bit 31), and the number of getObject calls currently retaining the object.
+        static constexpr uint64_t kLiveBit = uint64_t(1) << 31;
+        static constexpr uint64_t kReadersMask = kLiveBit - 1;
+
+        struct Slot {
+            std::atomic<uint64_t>       state {0};
+            CBLRefCounted* _cbl_nullable object {nullptr};
+        };
+
+        struct Chunk {
+            Slot slots[kChunkSize];
+        };
+
         ContextManager();
+
+        Slot* _cbl_nullable slot(uintptr_t index) const;
         
-        std::mutex _mutex;
-        std::unordered_map<void*, fleece::Retained<CBLRefCounted>> _contexts;
+        std::mutex _mutex;                                              // For register/unregister
+        std::atomic<Chunk*> _chunks[kMaxChunks] {};                     // Allocated as needed, never freed
+        size_t _slotCount {0};                                          // Slots allocated so far
+        std::vector<uint32_t> _freeSlots;                               // Indexes of unused slots
     };
 
 }
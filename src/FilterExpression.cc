@@ -0,0 +1,473 @@
+//
+// FilterExpression.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "FilterExpression.hh"
+#include "c4Error.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    namespace {
+
+        // Three-valued logic, as in N1QL, where MISSING and NULL operands give `unknown`:
+        enum class Truth { no, yes, unknown };
+
+        Truth truth(bool b)     {return b ? Truth::yes : Truth::no;}
+
+        enum class Op { eq, ne, lt, le, gt, ge };
+
+        struct KeyPathFree {
+            void operator() (FLKeyPath path) const      {FLKeyPath_Free(path);}
+        };
+        using KeyPath = unique_ptr<remove_pointer_t<FLKeyPath>, KeyPathFree>;
+
+        struct Literal {
+            FLValueType type;
+            double      number  = 0;
+            bool        boolean = false;
+            string      str;
+
+            explicit Literal(FLValueType t)     :type(t) { }
+
+            // Compares `v` with this literal, returning <0, 0 or >0. Values of different types
+            // are ordered by type as N1QL collates them: booleans, numbers, strings, arrays,
+            // dictionaries, then binary data.
+            int compare(FLValue v) const {
+                FLValueType vType = FLValue_GetType(v);
+                if (vType != type)
+                    return collationRank(vType) - collationRank(type);
+                switch (type) {
+                    case kFLNumber: {
+                        double d = FLValue_AsDouble(v);
+                        return (d < number) ? -1 : (d > number);
+                    }
+                    case kFLBoolean:
+                        return int(FLValue_AsBool(v)) - int(boolean);
+                    default:
+                        return FLSlice_Compare(FLValue_AsString(v), slice(str));
+                }
+            }
+
+            static int collationRank(FLValueType t) {
+                switch (t) {
+                    case kFLBoolean: return 1;
+                    case kFLNumber:  return 2;
+                    case kFLString:  return 3;
+                    case kFLArray:   return 4;
+                    case kFLDict:    return 5;
+                    case kFLData:    return 6;
+                    default:         return 0;      // Null; never compared
+                }
+            }
+        };
+
+        [[noreturn]] void fail(slice expression, const char *problem) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery,
+                           "Invalid filter expression '%.*s': %s", FMTSLICE(expression), problem);
+        }
+
+    }
+
+
+    struct FilterExpression::Node {
+        enum Kind { kAnd, kOr, kNot, kTruthy, kCompare, kIn, kIsNull, kIsMissing, kIsValued };
+
+        Kind                    kind;
+        Op                      op = Op::eq;
+        bool                    negated = false;        // For NOT IN and IS NOT
+        unique_ptr<Node>        left, right;
+        KeyPath                 path;
+        vector<Literal>         literals;
+
+        explicit Node(Kind k)   :kind(k) { }
+
+        Truth eval(FLValue root) const {
+            switch (kind) {
+                case kAnd: {
+                    Truth l = left->eval(root);
+                    if (l == Truth::no)
+                        return l;
+                    Truth r = right->eval(root);
+                    return (r == Truth::yes) ? l : r;
+                }
+                case kOr: {
+                    Truth l = left->eval(root);
+                    if (l == Truth::yes)
+                        return l;
+                    Truth r = right->eval(root);
+                    return (r == Truth::no) ? l : r;
+                }
+                case kNot: {
+                    Truth t = left->eval(root);
+                    return (t == Truth::unknown) ? t : truth(t == Truth::no);
+                }
+                default:
+                    break;
+            }
+
+            FLValue value = root ? FLKeyPath_Eval(path.get(), root) : nullptr;
+            switch (kind) {
+                case kIsMissing:
+                    return truth((value == nullptr) != negated);
+                case kIsNull:
+                    if (!value)
+                        return Truth::unknown;
+                    return truth((FLValue_GetType(value) == kFLNull) != negated);
+                case kIsValued:
+                    return truth((value && FLValue_GetType(value) != kFLNull) != negated);
+                default:
+                    break;
+            }
+
+            if (!value || FLValue_GetType(value) == kFLNull)
+                return Truth::unknown;
+            switch (kind) {
+                case kTruthy:
+                    switch (FLValue_GetType(value)) {
+                        case kFLBoolean: return truth(FLValue_AsBool(value));
+                        case kFLNumber:  return truth(FLValue_AsDouble(value) != 0);
+                        case kFLString:  return truth(FLValue_AsString(value).size > 0);
+                        case kFLArray:   return truth(FLArray_Count(FLValue_AsArray(value)) > 0);
+                        case kFLDict:    return truth(FLDict_Count(FLValue_AsDict(value)) > 0);
+                        default:         return Truth::no;
+                    }
+                case kIn:
+                    for (auto &lit : literals) {
+                        if (lit.compare(value) == 0)
+                            return truth(!negated);
+                    }
+                    return truth(negated);
+                case kCompare: {
+                    int cmp = literals[0].compare(value);
+                    switch (op) {
+                        case Op::eq: return truth(cmp == 0);
+                        case Op::ne: return truth(cmp != 0);
+                        case Op::lt: return truth(cmp < 0);
+                        case Op::le: return truth(cmp <= 0);
+                        case Op::gt: return truth(cmp > 0);
+                        case Op::ge: return truth(cmp >= 0);
+                    }
+                    return Truth::no;
+                }
+                default:
+                    return Truth::no;
+            }
+        }
+    };
+
+
+    /** Recursive-descent parser:
+            expr    := and (OR and)*
+            and     := not (AND not)*
+            not     := NOT not | primary
+            primary := '(' expr ')' | operand [op operand | [NOT] IN list | IS [NOT] keyword]  */
+    class FilterExpression::Parser {
+    public:
+        explicit Parser(slice expression)
+        :_expression(expression)
+        ,_pos((const char*)expression.buf)
+        ,_end((const char*)expression.end())
+        { }
+
+        unique_ptr<Node> parse() {
+            auto node = parseOr();
+            skipSpace();
+            if (_pos != _end)
+                fail(_expression, "unexpected text after the end of the expression");
+            return node;
+        }
+
+    private:
+        struct Operand {
+            KeyPath             path;
+            unique_ptr<Literal> literal;
+        };
+
+        unique_ptr<Node> parseOr() {
+            auto node = parseAnd();
+            while (keyword("OR"))
+                node = binary(Node::kOr, std::move(node), parseAnd());
+            return node;
+        }
+
+        unique_ptr<Node> parseAnd() {
+            auto node = parseNot();
+            while (keyword("AND"))
+                node = binary(Node::kAnd, std::move(node), parseNot());
+            return node;
+        }
+
+        unique_ptr<Node> parseNot() {
+            if (keyword("NOT")) {
+                auto node = make_unique<Node>(Node::kNot);
+                node->left = parseNot();
+                return node;
+            }
+            return parsePrimary();
+        }
+
+        unique_ptr<Node> parsePrimary() {
+            if (punct("(")) {
+                auto node = parseOr();
+                if (!punct(")"))
+                    fail(_expression, "missing ')'");
+                return node;
+            }
+
+            Operand lhs = parseOperand();
+            if (keyword("IS")) {
+                bool negated = keyword("NOT");
+                Node::Kind kind;
+                if (keyword("NULL"))
+                    kind = Node::kIsNull;
+                else if (keyword("MISSING"))
+                    kind = Node::kIsMissing;
+                else if (keyword("VALUED"))
+                    kind = Node::kIsValued;
+                else
+                    fail(_expression, "expected NULL, MISSING or VALUED after IS");
+                return propertyNode(kind, std::move(lhs), negated);
+            }
+
+            bool notIn = keyword("NOT");
+            if (notIn || keyword("IN")) {
+                if (notIn && !keyword("IN"))
+                    fail(_expression, "expected IN after NOT");
+                auto node = propertyNode(Node::kIn, std::move(lhs), notIn);
+                if (!punct("["))
+                    fail(_expression, "expected '[' after IN");
+                do {
+                    Operand item = parseOperand();
+                    if (!item.literal)
+                        fail(_expression, "IN list may only contain literals");
+                    node->literals.push_back(std::move(*item.literal));
+                } while (punct(","));
+                if (!punct("]"))
+                    fail(_expression, "missing ']'");
+                return node;
+            }
+
+            Op op;
+            if (!parseOp(op))
+                return propertyNode(Node::kTruthy, std::move(lhs));
+
+            Operand rhs = parseOperand();
+            if (lhs.literal && rhs.path) {
+                // Normalize `literal op property` to `property op' literal`:
+                swap(lhs, rhs);
+                op = flip(op);
+            }
+            if (rhs.path || !lhs.path)
+                fail(_expression, "comparisons must be between a property and a literal");
+            auto node = propertyNode(Node::kCompare, std::move(lhs));
+            node->op = op;
+            node->literals.push_back(std::move(*rhs.literal));
+            return node;
+        }
+
+        unique_ptr<Node> propertyNode(Node::Kind kind, Operand operand, bool negated =false) {
+            if (!operand.path)
+                fail(_expression, "expected a property");
+            auto node = make_unique<Node>(kind);
+            node->path = std::move(operand.path);
+            node->negated = negated;
+            return node;
+        }
+
+        static unique_ptr<Node> binary(Node::Kind kind, unique_ptr<Node> l, unique_ptr<Node> r) {
+            auto node = make_unique<Node>(kind);
+            node->left = std::move(l);
+            node->right = std::move(r);
+            return node;
+        }
+
+        static Op flip(Op op) {
+            switch (op) {
+                case Op::lt: return Op::gt;
+                case Op::le: return Op::ge;
+                case Op::gt: return Op::lt;
+                case Op::ge: return Op::le;
+                default:     return op;
+            }
+        }
+
+        bool parseOp(Op &op) {
+            skipSpace();
+            static constexpr struct {const char *str; Op op;} kOps[] = {
+                {"==", Op::eq}, {"!=", Op::ne}, {"<>", Op::ne}, {"<=", Op::le}, {">=", Op::ge},
+                {"=", Op::eq},  {"<", Op::lt},  {">", Op::gt},
+            };
+            for (auto &entry : kOps) {
+                if (punct(entry.str)) {
+                    op = entry.op;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        Operand parseOperand() {
+            skipSpace();
+            Operand result;
+            if (_pos == _end)
+                fail(_expression, "unexpected end of expression");
+
+            char c = *_pos;
+            if (c == '\'' || c == '"') {
+                result.literal = make_unique<Literal>(kFLString);
+                result.literal->str = parseString(c);
+            } else if (isDigit(c) || ((c == '-' || c == '.') && _pos + 1 < _end && isDigit(_pos[1]))) {
+                result.literal = make_unique<Literal>(kFLNumber);
+                string digits(_pos, _end);
+                char *numEnd;
+                result.literal->number = strtod(digits.c_str(), &numEnd);
+                _pos += numEnd - digits.c_str();
+            } else if (keyword("TRUE")) {
+                result.literal = make_unique<Literal>(kFLBoolean);
+                result.literal->boolean = true;
+            } else if (keyword("FALSE")) {
+                result.literal = make_unique<Literal>(kFLBoolean);
+            } else if (isIdentStart(c) || c == '`') {
+                string spec = parsePath();
+                FLError flErr;
+                result.path.reset(FLKeyPath_New(FLStr(spec.c_str()), &flErr));
+                if (!result.path)
+                    fail(_expression, "invalid property path");
+            } else {
+                fail(_expression, "expected a property or a literal");
+            }
+            return result;
+        }
+
+        // Reads `a.b[0].c`, converting it to a Fleece key-path specifier:
+        string parsePath() {
+            string spec;
+            while (true) {
+                if (_pos < _end && *_pos == '`') {
+                    const char *start = ++_pos;
+                    while (_pos < _end && *_pos != '`')
+                        ++_pos;
+                    if (_pos == _end || _pos == start)
+                        fail(_expression, "unterminated or empty `name`");
+                    for (auto p = start; p < _pos; ++p) {
+                        if (*p == '.' || *p == '[' || *p == '\\' || (p == start && *p == '$'))
+                            spec += '\\';
+                        spec += *p;
+                    }
+                    ++_pos;
+                } else {
+                    if (_pos == _end || !isIdentStart(*_pos))
+                        fail(_expression, "expected a property name");
+                    while (_pos < _end && isIdentChar(*_pos))
+                        spec += *_pos++;
+                }
+                while (_pos < _end && *_pos == '[') {
+                    const char *start = _pos++;
+                    if (_pos < _end && *_pos == '-')
+                        ++_pos;
+                    while (_pos < _end && isDigit(*_pos))
+                        ++_pos;
+                    if (_pos == _end || *_pos != ']' || !isDigit(_pos[-1]))
+                        fail(_expression, "invalid array index");
+                    spec.append(start, ++_pos);
+                }
+                if (_pos == _end || *_pos != '.')
+                    return spec;
+                spec += *_pos++;
+            }
+        }
+
+        // Reads a quoted string; a doubled quote character stands for one quote.
+        string parseString(char quote) {
+            string str;
+            ++_pos;
+            while (true) {
+                if (_pos == _end)
+                    fail(_expression, "unterminated string");
+                char c = *_pos++;
+                if (c == quote) {
+                    if (_pos < _end && *_pos == quote)
+                        ++_pos;
+                    else
+                        break;
+                }
+                str += c;
+            }
+            return str;
+        }
+
+        // Consumes a case-insensitive keyword, if it's next and followed by a non-identifier char.
+        bool keyword(const char *word) {
+            skipSpace();
+            size_t len = strlen(word);
+            if (size_t(_end - _pos) < len || (_pos + len < _end && isIdentChar(_pos[len])))
+                return false;
+            for (size_t i = 0; i < len; ++i) {
+                if (toupper((unsigned char)_pos[i]) != word[i])
+                    return false;
+            }
+            _pos += len;
+            return true;
+        }
+
+        bool punct(const char *str) {
+            skipSpace();
+            size_t len = strlen(str);
+            if (size_t(_end - _pos) < len || memcmp(_pos, str, len) != 0)
+                return false;
+            _pos += len;
+            return true;
+        }
+
+        void skipSpace() {
+            while (_pos < _end && isspace((unsigned char)*_pos))
+                ++_pos;
+        }
+
+        static bool isDigit(char c)         {return isdigit((unsigned char)c);}
+        static bool isIdentStart(char c)    {return isalpha((unsigned char)c) || c == '_';}
+        static bool isIdentChar(char c)     {return isalnum((unsigned char)c) || c == '_' || c == '$';}
+
+        slice const         _expression;
+        const char*         _pos;
+        const char* const   _end;
+    };
+
+
+    FilterExpression::FilterExpression(slice expression)
+    :_root(Parser(expression).parse())
+    { }
+
+
+    FilterExpression::~FilterExpression() = default;
+
+
+    bool FilterExpression::matches(FLDict properties) const {
+        return _root->eval((FLValue)properties) == Truth::yes;
+    }
+
+}
@@ -0,0 +1,50 @@
+//
+// FilterExpression.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/Fleece.h"
+#include "fleece/slice.hh"
+#include <memory>
+
+namespace cbl_internal {
+
+    /** A replication filter expression, in a subset of N1QL WHERE-clause syntax, compiled into a
+        tree that's evaluated directly on a document's Fleece properties.
+        Supported: property paths (`a.b[0]`, with `backquoted` names), string, number and boolean
+        literals, the comparisons `= == != <> < <= > >=` between a property and a literal,
+        `[NOT] IN [literal, ...]`, `IS [NOT] NULL|MISSING|VALUED`, bare properties (tested for
+        truthiness), `AND`, `OR`, `NOT` and parentheses.
+        As in N1QL, a comparison with a missing or null property is neither true nor false, so
+        that `NOT` of it doesn't match either. Values of different types are never equal, and
+        are ordered by type as N1QL collates them. */
+    class FilterExpression {
+    public:
+        /** Compiles the expression, throwing a kC4ErrorInvalidQuery exception if it's invalid. */
+        explicit FilterExpression(fleece::slice expression);
+        ~FilterExpression();
+
+        /** Returns true if the properties satisfy the expression. Thread-safe. */
+        bool matches(FLDict properties) const;
+
+        struct Node;
+    private:
+        class Parser;
+        std::unique_ptr<Node> _root;
+    };
+
+}
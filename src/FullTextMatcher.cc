@@ -0,0 +1,185 @@
+//
+// FullTextMatcher.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "FullTextMatcher.hh"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    static constexpr unsigned kDefaultSnippetWords = 15;
+
+
+    static bool isWordChar(char c) {
+        return (uint8_t)c >= 0x80 || isalnum((uint8_t)c);
+    }
+
+
+    static string lowercase(slice word) {
+        string result(word);
+        for (char &c : result) {
+            if ((uint8_t)c < 0x80)
+                c = (char)tolower((uint8_t)c);
+        }
+        return result;
+    }
+
+
+    FullTextMatcher::FullTextMatcher(slice terms) {
+        auto s = (const char*)terms.buf;
+        bool negated = false;
+        for (size_t i = 0; i < terms.size; ) {
+            if (!isWordChar(s[i])) {
+                ++i;
+                continue;
+            }
+            size_t start = i;
+            while (i < terms.size && isWordChar(s[i]))
+                ++i;
+            slice word(s + start, i - start);
+            if (start > 0 && s[start - 1] == '/')
+                continue;                       // The distance in `NEAR/3`
+            if (i < terms.size && s[i] == ':')
+                continue;                       // A column filter
+            if (word == "AND"_sl || word == "OR"_sl || word == "NEAR"_sl)
+                continue;
+            if (word == "NOT"_sl) {
+                negated = true;
+                continue;
+            }
+            if (negated) {
+                negated = false;
+                continue;
+            }
+            Term term {lowercase(word), i < terms.size && s[i] == '*'};
+            auto same = [&](const Term &t) {return t.word == term.word && t.prefix == term.prefix;};
+            if (std::none_of(_terms.begin(), _terms.end(), same))
+                _terms.push_back(std::move(term));
+        }
+    }
+
+
+    int FullTextMatcher::match(slice word) const {
+        string lower = lowercase(word);
+        for (size_t i = 0; i < _terms.size(); ++i) {
+            auto &term = _terms[i];
+            if (term.prefix ? slice(lower).hasPrefix(slice(term.word)) : lower == term.word)
+                return int(i);
+        }
+        return -1;
+    }
+
+
+    vector<FullTextMatcher::Word> FullTextMatcher::words(slice text) const {
+        vector<Word> result;
+        auto s = (const char*)text.buf;
+        for (size_t i = 0; i < text.size; ) {
+            if (!isWordChar(s[i])) {
+                ++i;
+                continue;
+            }
+            size_t start = i;
+            while (i < text.size && isWordChar(s[i]))
+                ++i;
+            result.push_back({start, i - start, match(slice(s + start, i - start))});
+        }
+        return result;
+    }
+
+
+    vector<CBLFullTextMatch> FullTextMatcher::matches(slice text) const {
+        vector<CBLFullTextMatch> result;
+        for (auto &word : words(text)) {
+            if (word.term >= 0)
+                result.push_back({word.offset, word.length});
+        }
+        return result;
+    }
+
+
+    alloc_slice FullTextMatcher::snippet(slice text, const CBLFullTextSnippetOptions &options) const {
+        slice startMark = options.startMark.buf ? slice(options.startMark) : "<b>"_sl;
+        slice endMark   = options.endMark.buf   ? slice(options.endMark)   : "</b>"_sl;
+        slice ellipsis  = options.ellipsis.buf  ? slice(options.ellipsis)  : "..."_sl;
+        size_t maxWords = options.maxWords ? options.maxWords : kDefaultSnippetWords;
+
+        auto ws = words(text);
+        if (ws.empty())
+            return alloc_slice(text);
+        size_t first = 0;
+        if (ws.size() > maxWords) {
+            // Find the run of words with the most different terms, then the most matches:
+            int bestTerms = 0, bestMatches = 0;
+            vector<bool> seen(_terms.size());
+            for (size_t start = 0; start + maxWords <= ws.size(); ++start) {
+                std::fill(seen.begin(), seen.end(), false);
+                int nTerms = 0, nMatches = 0;
+                for (size_t i = start; i < start + maxWords; ++i) {
+                    if (int t = ws[i].term; t >= 0) {
+                        ++nMatches;
+                        if (!seen[t]) {
+                            seen[t] = true;
+                            ++nTerms;
+                        }
+                    }
+                }
+                if (nTerms > bestTerms || (nTerms == bestTerms && nMatches > bestMatches)) {
+                    bestTerms = nTerms;
+                    bestMatches = nMatches;
+                    first = start;
+                }
+            }
+            // Center the matches in it:
+            if (bestMatches > 0) {
+                size_t firstMatch = first, lastMatch = first + maxWords - 1;
+                while (ws[firstMatch].term < 0)
+                    ++firstMatch;
+                while (ws[lastMatch].term < 0)
+                    --lastMatch;
+                size_t slack = maxWords - (lastMatch - firstMatch + 1);
+                first = std::min(firstMatch - std::min(firstMatch, slack / 2), ws.size() - maxWords);
+            }
+        }
+        size_t end = std::min(first + maxWords, ws.size());
+
+        auto s = (const char*)text.buf;
+        size_t pos = (first == 0) ? 0 : ws[first].offset;
+        size_t to  = (end == ws.size()) ? text.size : ws[end - 1].offset + ws[end - 1].length;
+        string result;
+        if (first > 0)
+            result.append((const char*)ellipsis.buf, ellipsis.size);
+        for (size_t i = first; i < end; ++i) {
+            auto &word = ws[i];
+            if (word.term < 0)
+                continue;
+            result.append(s + pos, word.offset - pos);
+            result.append((const char*)startMark.buf, startMark.size);
+            result.append(s + word.offset, word.length);
+            result.append((const char*)endMark.buf, endMark.size);
+            pos = word.offset + word.length;
+        }
+        result.append(s + pos, to - pos);
+        if (end < ws.size())
+            result.append((const char*)ellipsis.buf, ellipsis.size);
+        return alloc_slice(result);
+    }
+
+}
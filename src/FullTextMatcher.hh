@@ -0,0 +1,57 @@
+//
+// FullTextMatcher.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLQuery.h"
+#include "fleece/slice.hh"
+#include <string>
+#include <vector>
+
+namespace cbl_internal {
+
+    /** Finds the words of a text that match the terms of a full-text `MATCH()` expression, to
+        locate and highlight them, as described in CBLQuery.h. Words are runs of ASCII letters
+        and digits and non-ASCII characters; only ASCII letters are compared case-insensitively. */
+    class FullTextMatcher {
+    public:
+        explicit FullTextMatcher(fleece::slice terms);
+
+        /** The words of the text that match a term. */
+        std::vector<CBLFullTextMatch> matches(fleece::slice text) const;
+
+        /** An excerpt of the text with the matches marked. */
+        fleece::alloc_slice snippet(fleece::slice text, const CBLFullTextSnippetOptions&) const;
+
+    private:
+        struct Term {
+            std::string word;               // Lowercased
+            bool        prefix;             // Ended with `*`
+        };
+
+        struct Word {
+            size_t      offset, length;
+            int         term;               // Index of the matching term, or -1
+        };
+
+        std::vector<Word> words(fleece::slice text) const;
+        int match(fleece::slice word) const;
+
+        std::vector<Term> _terms;
+    };
+
+}
@@ -0,0 +1,79 @@
+//
+// IndexUsage.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLQueryIndex.h"
+#include "c4Base.h"
+#include "fleece/Fleece.hh"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** Counts, per index name, the query executions whose plans use each of a database's indexes.
+        It only counts while enabled, since it needs each query's plan. Thread-safe. */
+    class IndexUsage {
+    public:
+        bool enabled() const                {return _enabled.load(std::memory_order_relaxed);}
+
+        void setEnabled(bool enabled) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _enabled = enabled;
+            if (!enabled)
+                _stats.clear();
+        }
+
+        /** Records an execution whose plan uses `indexesUsed`, returning `rows` rows. */
+        void record(fleece::Array indexesUsed, uint64_t rows) {
+            if (indexesUsed.empty())
+                return;
+            auto now = CBLTimestamp(c4_now());
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (fleece::Array::iterator i(indexesUsed); i; ++i) {
+                auto &stats = _stats[std::string(i.value().asString())];
+                ++stats.queryCount;
+                stats.rowsReturned += rows;
+                stats.lastUsed = now;
+            }
+        }
+
+        CBLQueryIndexStats get(fleece::slice name) const {
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto i = _stats.find(std::string(name));
+            return i != _stats.end() ? i->second : CBLQueryIndexStats{};
+        }
+
+        /** Forgets an index's statistics, when it's deleted. */
+        void forget(fleece::slice name) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stats.erase(std::string(name));
+        }
+
+    private:
+        mutable std::mutex                                      _mutex;
+        std::atomic<bool>                                       _enabled {false};
+        std::unordered_map<std::string, CBLQueryIndexStats>     _stats;     // By index name
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
@@ -22,8 +22,10 @@
 #include "fleece/Fleece.h"
 #include "fleece/FLExpert.h"
 #include "betterassert.hh"
+#include "Base64.hh"
 #include "FilePath.hh"
 #include <mutex>
+#include <string>
 
 
 using namespace fleece;
@@ -57,6 +59,19 @@ namespace cbl_internal {
         return json;
     }
 
+    alloc_slice decodeBase64(slice str) {
+        // Fleece's decoder only takes the standard alphabet:
+        if (str.findByte('-') || str.findByte('_')) {
+            std::string standard(str);
+            for (char &c : standard) {
+                if (c == '-')       c = '+';
+                else if (c == '_')  c = '/';
+            }
+            return base64::decode(slice(standard));
+        }
+        return base64::decode(str);
+    }
+
 #ifdef __ANDROID__
 
     static CBLInitContext sInitContext;
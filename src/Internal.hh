@@ -85,6 +85,9 @@ namespace cbl_internal {
 
     fleece::alloc_slice convertJSON5(fleece::slice json5);
 
+    /** Decodes standard or URL-safe Base64, returning nullslice if it's invalid. */
+    fleece::alloc_slice decodeBase64(fleece::slice str);
+
 #ifdef __ANDROID__
 
     void initContext(CBLInitContext context);
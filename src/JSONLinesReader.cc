@@ -0,0 +1,132 @@
+//
+// JSONLinesReader.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "JSONLinesReader.hh"
+#include "Internal.hh"
+#include "c4Document.hh"
+#include "fleece/Fleece.hh"
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    // Batches smaller than this are parsed on the calling thread:
+    static constexpr size_t kMinLinesPerThread = 64;
+
+
+    JSONLinesReader::JSONLinesReader(const string &path, slice idProperty, unsigned threads)
+    :_in(path, ios::binary)
+    ,_idProperty(idProperty)
+    ,_threads(threads ? threads : max(thread::hardware_concurrency(), 1u))
+    {
+        if (!_in)
+            C4Error::raise(LiteCoreDomain, kC4ErrorNotFound, "Can't open %s", path.c_str());
+        _in.seekg(0, ios::end);
+        _totalBytes = uint64_t(_in.tellg());
+        _in.seekg(0, ios::beg);
+    }
+
+
+    vector<JSONLinesReader::Document> JSONLinesReader::read(size_t count) {
+        vector<string> lines;
+        vector<uint64_t> lineNos;
+        string line;
+        while (lines.size() < count && getline(_in, line)) {
+            _bytesRead += line.size() + 1;
+            ++_lineNo;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.find_first_not_of(" \t") == string::npos)
+                continue;
+            lines.push_back(std::move(line));
+            lineNos.push_back(_lineNo);
+        }
+        _bytesRead = min(_bytesRead, _totalBytes);
+
+        vector<Document> docs(lines.size());
+        size_t nThreads = min(size_t(_threads), lines.size() / kMinLinesPerThread);
+        if (nThreads <= 1) {
+            for (size_t i = 0; i < lines.size(); ++i)
+                docs[i] = parse(lines[i], lineNos[i]);
+            return docs;
+        }
+
+        // Each thread parses a contiguous run of lines, so the first error is the first line's:
+        vector<exception_ptr> errors(nThreads);
+        vector<thread> threads;
+        size_t perThread = (lines.size() + nThreads - 1) / nThreads;
+        for (size_t t = 0; t < nThreads; ++t) {
+            threads.emplace_back([&, t] {
+                try {
+                    size_t end = min(lines.size(), (t + 1) * perThread);
+                    for (size_t i = t * perThread; i < end; ++i)
+                        docs[i] = parse(lines[i], lineNos[i]);
+                } catch (...) {
+                    errors[t] = current_exception();
+                }
+            });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (auto &error : errors) {
+            if (error)
+                rethrow_exception(error);
+        }
+        return docs;
+    }
+
+
+    JSONLinesReader::Document JSONLinesReader::parse(slice line, uint64_t lineNo) const {
+        Document doc;
+        Encoder enc;
+        enc.convertJSON(line);
+        FLError flErr;
+        doc.fleece = enc.finish(&flErr);
+        if (!doc.fleece)
+            C4Error::raise(FleeceDomain, flErr, "Invalid JSON on line %llu", (unsigned long long)lineNo);
+        Dict root = ValueFromData(doc.fleece, kFLTrusted).asDict();
+        if (!root)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "Line %llu isn't a JSON object", (unsigned long long)lineNo);
+
+        if (!_idProperty.empty()) {
+            Value id = root[slice(_idProperty)];
+            if (id.type() == kFLString && id.asString())
+                doc.docID = alloc_slice(id.asString());
+            else if (id.isInteger())
+                doc.docID = alloc_slice(id.isUnsigned() ? to_string(id.asUnsigned())
+                                                        : to_string(id.asInt()));
+        }
+        if (!doc.docID)
+            doc.docID = C4Document::createDocID();
+
+        // Only properties that could belong to a blob make it worth looking for one:
+        doc.mayHaveBlobs = line.find("\"digest\""_sl) || line.find("\"_attachments\""_sl);
+#ifdef COUCHBASE_ENTERPRISE
+        // Encryptables have to be validated, which needs the regular save path:
+        if (line.find("\"encryptable\""_sl))
+            doc.json = alloc_slice(line);
+#endif
+        return doc;
+    }
+
+}
@@ -0,0 +1,59 @@
+//
+// JSONLinesReader.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/slice.hh"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cbl_internal {
+
+    /** Reads a file of JSON Lines in batches, parsing each batch's lines into Fleece on several
+        threads, for \ref CBLCollection_ImportJSONLines. The Fleece doesn't use the database's
+        shared keys, since they can only change in a transaction; it's fast to re-encode. */
+    class JSONLinesReader {
+    public:
+        struct Document {
+            fleece::alloc_slice docID;          // Generated if the line has no ID property
+            fleece::alloc_slice fleece;         // The properties, without shared keys
+            fleece::alloc_slice json;           // The JSON, kept only if it has encryptables
+            bool                mayHaveBlobs;
+        };
+
+        JSONLinesReader(const std::string &path, fleece::slice idProperty, unsigned threads);
+
+        /** Reads and parses up to `count` documents. Returns an empty vector at the end of the
+            file. Throws if a line isn't a JSON object. */
+        std::vector<Document> read(size_t count);
+
+        uint64_t bytesRead() const              {return _bytesRead;}
+        uint64_t totalBytes() const             {return _totalBytes;}
+
+    private:
+        Document parse(fleece::slice line, uint64_t lineNo) const;
+
+        std::ifstream           _in;
+        std::string const       _idProperty;
+        unsigned const          _threads;
+        uint64_t                _bytesRead {0}, _totalBytes {0};
+        uint64_t                _lineNo {0};
+    };
+
+}
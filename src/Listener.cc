@@ -17,12 +17,18 @@
 //
 
 #include "Listener.hh"
+#include "CBLDatabase_Internal.hh"
 
 using namespace std;
 
 
 void CBLListenerToken::remove() {
-    auto oldOwner = _owner;
+    // Claim the owner under the mutex, so if two threads remove the token only one goes on:
+    cbl_internal::ListenersBase* oldOwner;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mutex);
+        oldOwner = std::exchange(_owner, nullptr);
+    }
     if (oldOwner) {
         willRemove();
         removed();
@@ -31,57 +37,215 @@ void CBLListenerToken::remove() {
 }
 
 
-NotificationQueue::NotificationQueue(CBLDatabase *database)
-:_database(database)
-,_state(State())
+void ListenersBase::remove(CBLListenerToken* t) {
+    TIMED_LOCK(_mutex, kListeners);
+    auto i = _index.find(t);
+    if (i == _index.end()) {
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                "Removing listener token %p, which isn't registered (already removed?)", (void*)t);
+        return;
+    }
+    _tokens.erase(i->second);
+    _index.erase(i);
+    invalidateSnapshot();
+}
+
+
+ListenerTimer& ListenerTimer::shared() {
+    // Never deleted: at exit the pending functions may retain queries, databases and
+    // replicators, so joining the thread from a static destructor could hang or crash.
+    static auto sTimer = new ListenerTimer;
+    return *sTimer;
+}
+
+
+ListenerTimer::ListenerTimer()
+:_thread([this] {runLoop();})
 { }
 
-void NotificationQueue::setCallback(CBLNotificationsReadyCallback callback, void *context) {
-    auto pending = _state.useLocked<Notifications>([&](State &state) {
-        state.callback = callback;
-        state.context = context;
-        return callback ? nullptr : std::move(state.queue);
-    });
-    call(pending);
-}
-
-
-void NotificationQueue::add(Notification notification) {
-    bool notifyNow = false;
-    CBLNotificationsReadyCallback readyCallback = nullptr;
-    void* readyContext;
-
-    _state.useLocked([&](State &state) {
-        if (state.callback) {
-            bool first = !state.queue;
-            if (first)
-                state.queue.reset( new vector<Notification> );
-            state.queue->push_back(notification);
-            if (first) {
-                readyCallback = state.callback;
-                readyContext = state.context;
-            }
+
+void ListenerTimer::schedule(Clock::time_point when, function<void()> fn) {
+    {
+        LOCK(_mutex);
+        _scheduled.emplace(when, std::move(fn));
+    }
+    _cond.notify_one();
+}
+
+
+void ListenerTimer::runLoop() {
+    unique_lock<mutex> lock(_mutex);
+    for (;;) {
+        if (_scheduled.empty()) {
+            _cond.wait(lock);
+        } else if (auto first = _scheduled.begin(); first->first > Clock::now()) {
+            _cond.wait_until(lock, first->first);
         } else {
-            notifyNow = true;
+            auto fn = std::move(first->second);
+            _scheduled.erase(first);
+            lock.unlock();
+            fn();
+            lock.lock();
         }
-    });
+    }
+}
+
+
+NotificationQueue::NotificationQueue(CBLDatabase *database)
+:_database(database)
+{
+    _callbacks.emplace_back(new Callback{nullptr, nullptr, nullptr});
+    _callback = _callbacks.back().get();
+}
+
+
+NotificationQueue::~NotificationQueue() {
+    // Unsent notifications are discarded:
+    for (Notification *n = _head.load(); n; ) {
+        Notification *next = n->_next;
+        delete n;
+        n = next;
+    }
+    // (No lane can have notifications, since their work items keep the database alive.)
+}
+
+
+void NotificationQueue::setCallback(CBLNotificationsReadyCallback callback, void *context) {
+    setCallback({callback, nullptr, context});
+}
+
 
-    if (notifyNow)
-        notification();                         // immediate notification
-    else if (readyCallback)
-        readyCallback(readyContext, _database); // notify that notifications are queued
+void NotificationQueue::setExecutor(CBLNotificationExecutor executor, void *context) {
+    setCallback({nullptr, executor, context});
+}
+
+
+void NotificationQueue::setCallback(const Callback &newCallback) {
+    {
+        LOCK(_callbacksMutex);
+        _callbacks.emplace_back(new Callback(newCallback));
+        _callback.store(_callbacks.back().get(), memory_order_release);
+    }
+    if (!newCallback.callback)
+        notifyAll();
+}
+
+
+void NotificationQueue::add(const void *key, Notification *notification) {
+    const Callback *cb = _callback.load(memory_order_acquire);
+    if (cb->executor) {
+        addToLane(cb, key, notification);
+        return;
+    } else if (!cb->callback) {
+        // Immediate notification:
+        unique_ptr<Notification> n(notification);
+        (*n)();
+        return;
+    }
+
+    Notification *head = _head.load(memory_order_relaxed);
+    do {
+        notification->_next = head;
+    } while (!_head.compare_exchange_weak(head, notification,
+                                          memory_order_release, memory_order_relaxed));
+    if (!head)
+        cb->callback(cb->context, _database);   // notify that notifications are queued
+
+    // If buffering was turned off meanwhile, setCallback may have already emptied the queue:
+    if (!_callback.load(memory_order_acquire)->callback)
+        notifyAll();
 }
 
 
 void NotificationQueue::notifyAll() {
-    auto queue = std::move(_state.useLocked()->queue);
-    call(queue);
+    // Take the whole queue, and reverse it so the notifications are called in order:
+    Notification *n = _head.exchange(nullptr, memory_order_acquire);
+    Notification *first = nullptr;
+    while (n) {
+        Notification *next = n->_next;
+        n->_next = first;
+        first = n;
+        n = next;
+    }
+    call(first);
 }
 
 
-void NotificationQueue::call(const Notifications &queue) {
-    if (queue) {
-        for (Notification &n : *queue)
-            n();
+void NotificationQueue::call(Notification *first) {
+    while (first) {
+        unique_ptr<Notification> n(first);
+        first = first->_next;
+        (*n)();
     }
 }
+
+
+#pragma mark - EXECUTOR:
+
+
+void NotificationQueue::addToLane(const Callback *cb, const void *key, Notification *notification) {
+    shared_ptr<Lane> idleLane;
+    {
+        LOCK(_lanesMutex);
+        auto &lane = _lanes[key];
+        if (!lane)
+            lane = make_shared<Lane>(key);
+        if (lane->last)
+            lane->last->_next = notification;
+        else
+            lane->first = notification;
+        lane->last = notification;
+        if (!lane->scheduled) {
+            lane->scheduled = true;
+            idleLane = lane;
+        }
+    }
+    // Call the executor outside the lock, since it may run the work item right away:
+    if (idleLane)
+        submit(cb, std::move(idleLane));
+}
+
+
+void NotificationQueue::submit(const Callback *cb, shared_ptr<Lane> lane) {
+    if (cb->executor)
+        cb->executor(cb->context, _database, new CBLNotificationWorkItem(this, _database, std::move(lane)));
+    else
+        runLane(std::move(lane));               // The executor's been cleared; just call them
+}
+
+
+void NotificationQueue::runLane(shared_ptr<Lane> lane) {
+    while (true) {
+        Notification *first;
+        {
+            LOCK(_lanesMutex);
+            first = lane->first;
+            lane->first = lane->last = nullptr;
+        }
+        call(first);
+
+        {
+            LOCK(_lanesMutex);
+            if (!lane->first) {
+                // Idle again, so the next notification will start a new work item:
+                lane->scheduled = false;
+                if (auto i = _lanes.find(lane->key); i != _lanes.end() && i->second == lane)
+                    _lanes.erase(i);
+                return;
+            }
+        }
+        // More notifications arrived while this batch ran. Give them to the executor as a new
+        // work item, instead of looping, so one busy lane can't monopolize an executor thread:
+        const Callback *cb = _callback.load(memory_order_acquire);
+        if (cb->executor) {
+            submit(cb, std::move(lane));
+            return;
+        }
+    }
+}
+
+
+void CBLNotificationWorkItem::run() {
+    unique_ptr<CBLNotificationWorkItem> self(this);
+    _queue->runLane(_lane);
+}
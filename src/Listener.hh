@@ -19,11 +19,24 @@
 #pragma once
 #include "CBLDatabase.h"
 #include "Internal.hh"
+#include "LockTiming.hh"
+#include "ObjectPool.hh"
 #include "fleece/InstanceCounted.hh"
-#include <access_lock.hh>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <functional>
+#include <iterator>
+#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <thread>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "betterassert.hh"
 
@@ -31,7 +44,9 @@ CBL_ASSUME_NONNULL_BEGIN
 
 namespace cbl_internal {
     class ListenersBase;
+    class NotificationQueue;
 }
+struct CBLNotificationWorkItem;
 
 
 /** Abstract base class of listener tokens. (In the public API, as an opaque typedef.) */
@@ -109,7 +124,14 @@ namespace cbl_internal {
 
 
 
-    /** Manages a set of CBLListenerTokens. Thread-safe. */
+    /** Manages a set of CBLListenerTokens. Thread-safe.
+        The tokens are kept in the order they were added, with a hash index so that adding,
+        finding and removing one takes constant time however many there are. (Collections can
+        have tens of thousands of document listeners.)
+        Dispatch iterates an immutable snapshot of the tokens, which is built on the first
+        dispatch after a change and then shared, so it doesn't hold the mutex or copy the list.
+        Tokens removed after a snapshot was taken are still in it, but they won't be called:
+        CBLListenerToken::remove() clears the callback first, under the token's own mutex. */
     class ListenersBase {
     public:
         ~ListenersBase() {
@@ -117,53 +139,71 @@ namespace cbl_internal {
         }
 
         void add(CBLListenerToken* t) {
-            LOCK(_mutex);
+            TIMED_LOCK(_mutex, kListeners);
             _tokens.emplace_back(t);
+            _index.emplace(t, std::prev(_tokens.end()));
             t->addedTo(this);
+            invalidateSnapshot();
         }
 
-        void remove(CBLListenerToken* t) {
-            LOCK(_mutex);
-            for (auto i = _tokens.begin(); i != _tokens.end(); ++i) {
-                if (i->get() == t) {
-                    _tokens.erase(i);
-                    return;
-                }
-            }
-            assert(false);
-        }
+        /** Removes a token. Logs a warning and does nothing if it isn't one of mine. */
+        void remove(CBLListenerToken* t);
 
         void clear() {
-            LOCK(_mutex);
+            TIMED_LOCK(_mutex, kListeners);
             for (auto &tok : _tokens)
                 tok->removed();
+            _index.clear();
             _tokens.clear();
+            invalidateSnapshot();
         }
 
         bool contains(CBLListenerToken *token) const {
-            LOCK(_mutex);
-            for (auto &tok : _tokens) {
-                if (tok == token)
-                    return true;
-            }
-            return false;
+            TIMED_LOCK(_mutex, kListeners);
+            return _index.find(token) != _index.end();
         }
 
         bool empty() const {
-            LOCK(_mutex);
+            TIMED_LOCK(_mutex, kListeners);
             return _tokens.empty();
         }
 
         using Tokens = std::vector<fleece::Retained<CBLListenerToken>>;
 
-        Tokens tokens() const {
-            LOCK(_mutex);
-            return _tokens;
+        /** Returns an immutable snapshot of the tokens, in the order they were added. */
+        std::shared_ptr<const Tokens> tokens() const {
+            if (auto current = snapshot())
+                return current;
+            TIMED_LOCK(_mutex, kListeners);
+            auto current = snapshot();              // (Another thread may have built it)
+            if (!current) {
+                current = std::make_shared<const Tokens>(_tokens.begin(), _tokens.end());
+                setSnapshot(current);
+            }
+            return current;
         }
 
     private:
+        using TokenList = std::list<fleece::Retained<CBLListenerToken>>;
+
+        std::shared_ptr<const Tokens> snapshot() const {
+            std::lock_guard<std::mutex> lock(_snapshotMutex);
+            return _snapshot;
+        }
+
+        void setSnapshot(std::shared_ptr<const Tokens> snapshot) const {
+            std::lock_guard<std::mutex> lock(_snapshotMutex);
+            _snapshot = std::move(snapshot);
+        }
+
+        // Must be called with the mutex locked:
+        void invalidateSnapshot()       {setSnapshot(nullptr);}
+
         mutable std::mutex _mutex;
-        Tokens _tokens;
+        TokenList _tokens;                                                  // In order added
+        std::unordered_map<const CBLListenerToken*, TokenList::iterator> _index;
+        mutable std::mutex _snapshotMutex;              // Only held to copy _snapshot; after _mutex
+        mutable std::shared_ptr<const Tokens> _snapshot;                    // Guarded by _snapshotMutex
     };
 
 
@@ -187,47 +227,173 @@ namespace cbl_internal {
 
         template <class... Args>
         void call(Args... args) const {
-            for (auto &lp : tokens())
+            auto snapshot = tokens();
+            for (auto &lp : *snapshot)
                 ((ListenerToken<LISTENER>*)lp.get())->call(args...);
         }
     };
 
 
-    using Notification = std::function<void()>;
+    /** Runs functions at given times, on a single background thread. Used to deliver listener
+        calls that are deferred so they can be coalesced. The shared instance lives until the
+        process exits. */
+    class ListenerTimer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static ListenerTimer& shared();
+
+        /** Schedules a function to be called at (or soon after) a time. */
+        void schedule(Clock::time_point when, std::function<void()> fn);
+
+    private:
+        ListenerTimer();
+        void runLoop();
+
+        std::mutex                                          _mutex;
+        std::condition_variable                             _cond;
+        std::multimap<Clock::time_point, std::function<void()>> _scheduled;
+        std::thread                                         _thread;    // Must be last
+    };
+
+
+    /** A pending call to a listener, as queued by NotificationQueue. The callable is stored in
+        the record itself unless it's unusually big, so queueing it costs one allocation.
+        Records come from a per-thread pool, which only saves that allocation when they're
+        freed on the thread that queued them; when another thread calls `notifyAll`, as with
+        buffered notifications drained elsewhere, the writer's pool runs dry and each record
+        comes from the heap. */
+    class Notification : public Pooled<Notification> {
+    public:
+        template <class FN>
+        explicit Notification(FN &&fn) {
+            using F = std::decay_t<FN>;
+            if constexpr (sizeof(F) <= kStorageSize && alignof(F) <= alignof(std::max_align_t)) {
+                new (&_storage) F(std::forward<FN>(fn));
+                _invoke = [](void *storage) {(*(F*)storage)();};
+                _destroy = [](void *storage) {((F*)storage)->~F();};
+            } else {
+                *(F**)&_storage = new F(std::forward<FN>(fn));
+                _invoke = [](void *storage) {(**(F**)storage)();};
+                _destroy = [](void *storage) {delete *(F**)storage;};
+            }
+        }
+
+        ~Notification()                                 {_destroy(&_storage);}
 
+        Notification(const Notification&) =delete;
+        Notification& operator=(const Notification&) =delete;
 
-    /** Manages a queue of pending calls to listeners. Owned by CBLDatabase. Thread-safe. */
+        void operator() ()                              {_invoke(&_storage);}
+
+    private:
+        friend class NotificationQueue;
+        static constexpr size_t kStorageSize = 48;
+
+        void (*_invoke)(void*);
+        void (*_destroy)(void*);
+        Notification* _cbl_nullable _next {nullptr};                // Next in the queue
+        alignas(std::max_align_t) unsigned char _storage[kStorageSize];
+    };
+
+
+    /** Manages a queue of pending calls to listeners. Owned by CBLDatabase. Thread-safe.
+        Adding a notification is lock-free: the queue is an intrusive stack that producers push
+        onto with a CAS, and that `notifyAll` takes in one exchange and reverses into FIFO order.
+
+        Alternatively the client can set an executor. Then each notification goes into a "lane"
+        named by its key (the collection or query it's about), and whenever a lane that was idle
+        gets a notification, the lane's pending notifications are handed to the executor as a
+        CBLNotificationWorkItem. A lane has at most one work item out at a time, so different
+        lanes' notifications can run in parallel while each lane's stay in order. */
     class NotificationQueue {
     public:
         NotificationQueue(CBLDatabase*);
+        ~NotificationQueue();
 
-        /** Sets or clears the client callback. */
+        /** Sets or clears the client callback. (Clears the executor.) */
         void setCallback(CBLNotificationsReadyCallback _cbl_nullable callback, void* _cbl_nullable context);
 
+        /** Sets or clears the client executor. (Clears the callback.) */
+        void setExecutor(CBLNotificationExecutor _cbl_nullable executor, void* _cbl_nullable context);
+
         /** If there is a callback, this adds a notification to the queue, and if the queue was
             empty, invokes the callback to tell the client.
-            If there is no callback, it calls the notification directly. */
-        void add(Notification);
+            If there is an executor, this adds the notification to the lane for `key`, and if the
+            lane was idle, gives the executor a work item for it.
+            Otherwise it calls the notification directly. */
+        template <class FN>
+        void add(const void* key, FN &&fn)      {add(key, new Notification(std::forward<FN>(fn)));}
+
+        void add(const void* key, Notification* _cbl_nonnull);
 
-        /** Calls all queued notifications and clears the queue. */
+        /** Calls all queued notifications and clears the queue. (Doesn't affect lanes.) */
         void notifyAll();
 
+        /** True if there's neither a callback nor an executor, so `add` calls notifications
+            directly. */
+        bool immediate() const {
+            const Callback *cb = _callback.load(std::memory_order_acquire);
+            return !cb->callback && !cb->executor;
+        }
 
-    private:
-        using Notifications = std::unique_ptr<std::vector<Notification>>;
 
-        void call(const Notifications&);
+    private:
+        friend struct ::CBLNotificationWorkItem;
 
-        struct State {
-            CBLNotificationsReadyCallback _cbl_nullable callback {nullptr};
+        struct Callback {
+            CBLNotificationsReadyCallback _cbl_nullable callback;
+            CBLNotificationExecutor _cbl_nullable executor;
             void* _cbl_nullable context;
-            Notifications queue;
         };
 
+        struct Lane {
+            explicit Lane(const void* k)            :key(k) { }
+            const void* const key;
+            Notification* _cbl_nullable first {nullptr};     // Oldest notification
+            Notification* _cbl_nullable last {nullptr};      // Newest notification
+            bool scheduled {false};                         // True while a work item is out
+        };
+
+        void setCallback(const Callback&);
+        void addToLane(const Callback*, const void* key, Notification*);
+        void submit(const Callback*, std::shared_ptr<Lane>);
+        void runLane(std::shared_ptr<Lane>);
+        static void call(Notification* _cbl_nullable first);
+
         CBLDatabase* const _database;
-        litecore::access_lock<State> _state;
+        std::atomic<Notification*> _head {nullptr};                 // Newest notification first
+        std::atomic<const Callback*> _callback;                     // Current callback; not null
+        std::mutex _callbacksMutex;                                 // Guards _callbacks
+        // Every callback that was ever set, so that add() never reads a freed one. (This only
+        // grows when the client calls CBLDatabase_BufferNotifications or _SetNotificationExecutor.)
+        std::vector<std::unique_ptr<const Callback>> _callbacks;
+        std::mutex _lanesMutex;                                     // Guards _lanes and their contents
+        std::unordered_map<const void*, std::shared_ptr<Lane>> _lanes;  // Only non-idle lanes
     };
 
 }
 
+
+/** A batch of notifications from one lane of a NotificationQueue, as handed to the client's
+    executor. (In the public API, as an opaque typedef.) */
+struct CBLNotificationWorkItem {
+    /** Calls the lane's pending notifications, and deletes this. */
+    void run();
+
+private:
+    friend class cbl_internal::NotificationQueue;
+    using Lane = cbl_internal::NotificationQueue::Lane;
+
+    CBLNotificationWorkItem(cbl_internal::NotificationQueue* queue,
+                            CBLRefCounted* database,
+                            std::shared_ptr<Lane> lane)
+    :_queue(queue), _database(database), _lane(std::move(lane))
+    { }
+
+    cbl_internal::NotificationQueue* const   _queue;
+    fleece::Retained<CBLRefCounted> const    _database;      // Keeps _queue alive
+    std::shared_ptr<Lane> const              _lane;
+};
+
 CBL_ASSUME_NONNULL_END
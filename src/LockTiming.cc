@@ -0,0 +1,84 @@
+//
+// LockTiming.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LockTiming.hh"
+#include <sstream>
+
+using namespace std;
+
+namespace cbl_internal {
+
+    static const char* const kSiteNames[LockTiming::kNumSites] = {
+        "database", "collection", "listeners", "contextManager", "replicator"
+    };
+
+
+    void LockTiming::setEnabled(bool enabled) {
+        for (auto &s : sSites) {
+            s.acquisitions = 0;
+            s.contended = 0;
+            s.waitNanos = 0;
+            s.maxHoldNanos = 0;
+            for (auto &count : s.waitHistogram)
+                count = 0;
+        }
+        sEnabled.store(enabled, memory_order_relaxed);
+    }
+
+
+    CBLLockStats LockTiming::stats(Site site) {
+        auto &s = sSites[site];
+        CBLLockStats result {kSiteNames[site], s.acquisitions, s.contended, s.waitNanos, s.maxHoldNanos};
+        for (unsigned i = 0; i < kCBLLockWaitBuckets; ++i)
+            result.waitHistogram[i] = s.waitHistogram[i];
+        return result;
+    }
+
+
+    CBLLockWaitStats LockTiming::totals() {
+        CBLLockWaitStats result {};
+        for (unsigned site = 0; site < kNumSites; ++site) {
+            auto &s = sSites[site];
+            result.acquisitions += s.acquisitions;
+            result.contended += s.contended;
+            result.waitNanos += s.waitNanos;
+        }
+        return result;
+    }
+
+
+    string LockTiming::dump() {
+        stringstream out;
+        out << "{";
+        for (unsigned site = 0; site < kNumSites; ++site) {
+            CBLLockStats s = stats(Site(site));
+            out << (site ? ", " : "") << "\"" << s.name << "\": {"
+                << "\"acquisitions\": " << s.acquisitions
+                << ", \"contended\": " << s.contended
+                << ", \"waitNanos\": " << s.waitNanos
+                << ", \"maxHoldNanos\": " << s.maxHoldNanos
+                << ", \"waitHistogram\": [";
+            for (unsigned i = 0; i < kCBLLockWaitBuckets; ++i)
+                out << (i ? ", " : "") << s.waitHistogram[i];
+            out << "]}";
+        }
+        out << "}";
+        return out.str();
+    }
+
+}
@@ -0,0 +1,174 @@
+//
+// LockTiming.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLPrivate.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <type_traits>
+
+namespace cbl_internal {
+
+    /** The stats LockTiming keeps for each instrumented lock. */
+    struct LockSiteStats {
+        std::atomic<uint64_t> acquisitions {0};
+        std::atomic<uint64_t> contended {0};
+        std::atomic<uint64_t> waitNanos {0};
+        std::atomic<uint64_t> maxHoldNanos {0};
+        std::atomic<uint64_t> waitHistogram[kCBLLockWaitBuckets] {};
+    };
+
+
+    /** Measures how often the instrumented locks are acquired, how long threads wait for them,
+        and how long they're held, per named lock (see \ref CBL_SetLockTiming.) While it's
+        disabled, which is the default, it costs one relaxed atomic load per lock. */
+    class LockTiming {
+    public:
+        /** The instrumented locks. Each name covers every instance of that kind of lock. */
+        enum Site : unsigned {
+            kDatabase,              // C4DatabaseAccessLock (litecore::access_lock)
+            kCollection,            // C4CollectionAccessLock (litecore::shared_access_lock)
+            kListeners,             // ListenersBase::_mutex
+            kContextManager,        // ContextManager::_mutex
+            kReplicator,            // CBLReplicator::_mutex
+            kNumSites
+        };
+
+        using clock = std::chrono::steady_clock;
+
+        static bool enabled()           {return sEnabled.load(std::memory_order_relaxed);}
+
+        /** Enables or disables timing, and resets the stats. */
+        static void setEnabled(bool enabled);
+
+        /** The totals of all the locks' stats. */
+        static CBLLockWaitStats totals();
+
+        /** The stats of one lock. */
+        static CBLLockStats stats(Site);
+
+        /** All the locks' stats as a JSON object, keyed by lock name. */
+        static std::string dump();
+
+        // Called by TimedLock:
+        static void acquired(Site site, bool contended, clock::duration wait) noexcept {
+            auto &s = sSites[site];
+            uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(wait).count();
+            s.acquisitions.fetch_add(1, std::memory_order_relaxed);
+            if (contended) {
+                s.contended.fetch_add(1, std::memory_order_relaxed);
+                s.waitNanos.fetch_add(nanos, std::memory_order_relaxed);
+            }
+            s.waitHistogram[bucket(nanos)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static void released(Site site, clock::duration hold) noexcept {
+            auto &max = sSites[site].maxHoldNanos;
+            uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(hold).count();
+            uint64_t prev = max.load(std::memory_order_relaxed);
+            while (nanos > prev && !max.compare_exchange_weak(prev, nanos, std::memory_order_relaxed))
+                ;
+        }
+
+    private:
+        // Bucket i counts waits under 10^i microseconds; the last bucket counts the rest.
+        static unsigned bucket(uint64_t nanos) noexcept {
+            unsigned i = 0;
+            for (uint64_t limit = 1000; i < kCBLLockWaitBuckets - 1 && nanos >= limit; limit *= 10)
+                ++i;
+            return i;
+        }
+
+        static inline std::atomic<bool> sEnabled {false};
+        static inline LockSiteStats     sSites[kNumSites];
+    };
+
+
+    /** A lock guard that, while lock timing is enabled, records its wait and hold times. */
+    template <class MUTEX>
+    class TimedLock {
+    public:
+        /** Locks the mutex until destructed. */
+        TimedLock(MUTEX &mutex, LockTiming::Site site)
+        :_mutex(mutex)
+        ,_site(site)
+        {
+            if (LockTiming::enabled())
+                timedLock();
+            else
+                _mutex.lock();
+            _locked = true;
+        }
+
+        /** Locks the mutex until destructed, but only if lock timing is enabled. This is for
+            recursive mutexes the caller is about to lock itself, which then costs little. */
+        TimedLock(MUTEX &mutex, LockTiming::Site site, std::defer_lock_t)
+        :_mutex(mutex)
+        ,_site(site)
+        {
+            if (LockTiming::enabled()) {
+                timedLock();
+                _locked = true;
+            }
+        }
+
+        ~TimedLock() {
+            if (_timed && _recordHold)
+                LockTiming::released(_site, LockTiming::clock::now() - _acquiredAt);
+            if (_locked)
+                _mutex.unlock();
+        }
+
+        /** Don't record the hold time, because the caller goes on holding the lock after this. */
+        void skipHoldTime()             {_recordHold = false;}
+
+        TimedLock(const TimedLock&) =delete;
+        TimedLock& operator=(const TimedLock&) =delete;
+
+    private:
+        void timedLock() {
+            bool contended = !_mutex.try_lock();
+            LockTiming::clock::duration wait {};
+            if (contended) {
+                auto start = LockTiming::clock::now();
+                _mutex.lock();
+                _acquiredAt = LockTiming::clock::now();
+                wait = _acquiredAt - start;
+            } else {
+                _acquiredAt = LockTiming::clock::now();
+            }
+            _timed = true;
+            LockTiming::acquired(_site, contended, wait);
+        }
+
+        MUTEX&                      _mutex;
+        LockTiming::Site            _site;
+        bool                        _locked {false};
+        bool                        _timed {false};
+        bool                        _recordHold {true};
+        LockTiming::clock::time_point _acquiredAt;
+    };
+
+}
+
+/** Like LOCK, but timed under the given LockTiming::Site while lock timing is enabled. */
+#define TIMED_LOCK(MUTEX, SITE) \
+    cbl_internal::TimedLock<std::remove_const_t<decltype(MUTEX)>> _lock(MUTEX, cbl_internal::LockTiming::SITE)
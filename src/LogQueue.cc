@@ -0,0 +1,204 @@
+//
+// LogQueue.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LogQueue.hh"
+#include <chrono>
+#include <cstdint>
+
+using namespace std;
+using namespace fleece;
+using namespace litecore;
+
+namespace cbl_internal {
+
+    static constexpr size_t kDefaultCapacity = 4096;
+
+    // A backstop for a wake-up that races with the thread going to sleep:
+    static constexpr auto kMaxSleep = chrono::milliseconds(100);
+
+
+    static size_t roundUpCapacity(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        return n;
+    }
+
+
+    LogQueue::LogQueue(const CBLLogAsyncOptions &options, Deliverer deliver)
+    :_mask(roundUpCapacity(options.capacity ? options.capacity : kDefaultCapacity) - 1)
+    ,_dropPolicy(options.dropPolicy)
+    ,_deliver(deliver)
+    ,_slots(new Slot[_mask + 1])
+    {
+        for (size_t i = 0; i <= _mask; ++i)
+            _slots[i].sequence.store(i, memory_order_relaxed);
+        _thread = thread([this] {run();});
+    }
+
+
+    // A slot is free to write at position `pos` when its sequence is `pos`, and ready to read
+    // when it's `pos + 1`. Reading it sets it to `pos + capacity`, freeing it for the next lap.
+    LogQueue::Slot* LogQueue::claimToWrite(size_t &pos) {
+        pos = _writePos.load(memory_order_relaxed);
+        while (true) {
+            Slot &slot = _slots[pos & _mask];
+            auto diff = intptr_t(slot.sequence.load(memory_order_acquire)) - intptr_t(pos);
+            if (diff == 0) {
+                if (_writePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                    return &slot;
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = _writePos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+
+    LogQueue::Slot* LogQueue::claimToRead(size_t &pos) {
+        pos = _readPos.load(memory_order_relaxed);
+        while (true) {
+            Slot &slot = _slots[pos & _mask];
+            auto diff = intptr_t(slot.sequence.load(memory_order_acquire)) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (_readPos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                    return &slot;
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = _readPos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+
+    bool LogQueue::hasMessage() const {
+        size_t pos = _readPos.load(memory_order_relaxed);
+        return _slots[pos & _mask].sequence.load(memory_order_acquire) == pos + 1;
+    }
+
+
+    bool LogQueue::hasRoom() const {
+        size_t pos = _writePos.load(memory_order_relaxed);
+        return _slots[pos & _mask].sequence.load(memory_order_acquire) == pos;
+    }
+
+
+    void LogQueue::push(C4LogDomain domain, C4LogLevel level, bool toConsole, bool toCallback,
+                        slice text)
+    {
+        size_t pos;
+        Slot *slot;
+        while (!(slot = claimToWrite(pos))) {
+            if (_dropPolicy == kCBLLogDropOldest) {
+                size_t oldestPos;
+                if (Slot *oldest = claimToRead(oldestPos)) {
+                    release(oldest, oldestPos);
+                    ++_dropped;
+                    ++_done;
+                }
+            } else if (_dropPolicy == kCBLLogBlock && this_thread::get_id() != _thread.get_id()) {
+                // Wait for the thread to free a slot. (The thread itself can't wait for room, if
+                // the callback logs; and once it's stopping, no room will come.)
+                unique_lock<mutex> lock(_mutex);
+                if (_stopping) {
+                    ++_dropped;
+                    return;
+                }
+                ++_blockedWriters;
+                _cond.notify_one();
+                _roomCond.wait_for(lock, kMaxSleep, [this] {return _stopping || hasRoom();});
+                --_blockedWriters;
+            } else {
+                ++_dropped;
+                return;
+            }
+        }
+        Message &message = slot->message;
+        message.domain = domain;
+        message.level = level;
+        message.toConsole = toConsole;
+        message.toCallback = toCallback;
+        message.timestamp = LogDecoder::now();
+        message.text.assign((const char*)text.buf, text.size);
+        slot->sequence.store(pos + 1, memory_order_release);
+        ++_queued;
+
+        atomic_thread_fence(memory_order_seq_cst);
+        if (_sleeping.load(memory_order_relaxed))
+            wake();
+    }
+
+
+    void LogQueue::wake() {
+        { lock_guard<mutex> lock(_mutex); }
+        _cond.notify_one();
+    }
+
+
+    void LogQueue::flush() {
+        if (this_thread::get_id() == _thread.get_id())
+            return;
+        uint64_t target = _queued;
+        unique_lock<mutex> lock(_mutex);
+        while (_done < target && !_stopping) {
+            _cond.notify_one();
+            _doneCond.wait_for(lock, kMaxSleep);
+        }
+    }
+
+
+    void LogQueue::stop() {
+        {
+            lock_guard<mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _cond.notify_one();
+        _roomCond.notify_all();
+        if (_thread.joinable() && this_thread::get_id() != _thread.get_id())
+            _thread.join();
+    }
+
+
+    void LogQueue::run() {
+        while (true) {
+            size_t pos;
+            if (Slot *slot = claimToRead(pos)) {
+                _deliver(slot->message);
+                release(slot, pos);
+                ++_done;
+                if (_blockedWriters.load() > 0) {
+                    { lock_guard<mutex> lock(_mutex); }
+                    _roomCond.notify_all();
+                }
+                continue;
+            }
+
+            unique_lock<mutex> lock(_mutex);
+            _doneCond.notify_all();
+            if (_stopping)
+                break;
+            _sleeping = true;
+            atomic_thread_fence(memory_order_seq_cst);
+            _cond.wait_for(lock, kMaxSleep, [this] {return _stopping || hasMessage();});
+            _sleeping = false;
+        }
+    }
+
+}
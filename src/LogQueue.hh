@@ -0,0 +1,106 @@
+//
+// LogQueue.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLLog.h"
+#include "c4Base.h"
+#include "LogDecoder.hh"
+#include "fleece/slice.hh"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace cbl_internal {
+
+    /** A bounded queue of log messages, delivered by a background thread, for
+        \ref CBLLog_SetAsync. Logging threads only copy the message into a slot of a lock-free
+        ring buffer; the thread does the console writes and calls the callback.
+        The ring is a multi-producer queue in which each slot's sequence number says whether it's
+        free to write or ready to read. Slots keep their strings, so once they've grown to fit
+        the messages, queueing one doesn't allocate. */
+    class LogQueue {
+    public:
+        struct Message {
+            C4LogDomain                         domain;
+            C4LogLevel                          level;
+            bool                                toConsole;
+            bool                                toCallback;
+            litecore::LogDecoder::Timestamp     timestamp;
+            std::string                         text;
+        };
+
+        using Deliverer = void (*)(const Message&);
+
+        LogQueue(const CBLLogAsyncOptions &options, Deliverer deliver);
+
+        ~LogQueue()                             {stop();}
+
+        /** Queues a message, or drops it according to the drop policy. */
+        void push(C4LogDomain domain, C4LogLevel level, bool toConsole, bool toCallback,
+                  fleece::slice text);
+
+        /** Waits until the messages queued before the call have been delivered. */
+        void flush();
+
+        /** Delivers the messages still queued, then stops the thread. Messages queued after
+            this aren't delivered. */
+        void stop();
+
+        uint64_t dropped() const                {return _dropped;}
+
+        /** True if called by the thread that delivers the messages, i.e. by the log callback. */
+        bool onQueueThread() const              {return std::this_thread::get_id() == _thread.get_id();}
+
+    private:
+        struct Slot {
+            std::atomic<size_t>     sequence;
+            Message                 message;
+        };
+
+        Slot* claimToWrite(size_t &pos);        // Returns nullptr if full
+        Slot* claimToRead(size_t &pos);         // Returns nullptr if empty
+        bool hasMessage() const;
+        bool hasRoom() const;
+        void release(Slot *slot, size_t pos)    {slot->sequence.store(pos + _mask + 1, std::memory_order_release);}
+        void wake();
+        void run();
+
+        size_t const                        _mask;          // capacity - 1
+        CBLLogDropPolicy const              _dropPolicy;
+        Deliverer const                     _deliver;
+        std::unique_ptr<Slot[]>             _slots;
+
+        alignas(64) std::atomic<size_t>     _writePos {0};
+        alignas(64) std::atomic<size_t>     _readPos {0};
+        std::atomic<uint64_t>               _queued {0}, _done {0}, _dropped {0};
+        std::atomic<unsigned>               _blockedWriters {0};    // Waiting in push() for room
+
+        std::mutex                          _mutex;
+        std::condition_variable             _cond;          // Wakes the thread
+        std::condition_variable             _doneCond;      // Wakes flush()
+        std::condition_variable             _roomCond;      // Wakes push() waiting for room
+        std::atomic<bool>                   _sleeping {false};
+        bool                                _stopping {false};
+        std::thread                         _thread;        // Must be last
+    };
+
+}
@@ -0,0 +1,95 @@
+//
+// LogThrottle.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "LogThrottle.hh"
+#include "Internal.hh"
+#include <chrono>
+
+using namespace std;
+
+namespace cbl_internal {
+
+    LogThrottle::DomainState* LogThrottle::find(C4LogDomain domain) {
+        size_t count = _domainCount.load(memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            if (_domains[i].domain.load(memory_order_relaxed) == domain)
+                return &_domains[i];
+        }
+        return nullptr;
+    }
+
+
+    void LogThrottle::set(C4LogDomain domain, const CBLLogThrottle &throttle) {
+        LOCK(_mutex);
+        DomainState *state = find(domain);
+        if (!state) {
+            size_t count = _domainCount.load(memory_order_relaxed);
+            if (count == kMaxDomains)
+                C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported, "Too many throttled log domains");
+            state = &_domains[count];
+            state->domain.store(domain, memory_order_relaxed);
+            _domainCount.store(count + 1, memory_order_release);
+        }
+        state->sampleRate = throttle.sampleRate;
+        state->maxPerSecond = throttle.maxPerSecond;
+
+        bool active = false;
+        for (size_t i = 0; i < _domainCount; ++i)
+            active = active || _domains[i].sampleRate > 1 || _domains[i].maxPerSecond > 0;
+        _active = active;
+    }
+
+
+    bool LogThrottle::allow(C4LogDomain domain, C4LogLevel level, const char *format) {
+        if (!_active || level >= kC4LogWarning)
+            return true;
+        DomainState *state = find(domain);
+        if (!state)
+            return true;
+
+        uint32_t sampleRate = state->sampleRate;
+        if (sampleRate > 1 && state->counter++ % sampleRate != 0) {
+            ++_throttled;
+            return false;
+        }
+
+        uint32_t maxPerSecond = state->maxPerSecond;
+        if (maxPerSecond > 0) {
+            auto second = chrono::duration_cast<chrono::seconds>(
+                                    chrono::steady_clock::now().time_since_epoch()).count();
+            LOCK(_mutex);
+            auto i = _sites.find(format);
+            if (i == _sites.end() && _sites.size() >= kMaxSites) {
+                std::erase_if(_sites, [&](auto &entry) {return entry.second.second != second;});
+            }
+            Site &site = (i != _sites.end())              ? i->second
+                       : (_sites.size() < kMaxSites)      ? _sites[format]
+                                                          : _overflowSite;
+            if (site.second != second) {
+                site.second = second;
+                site.count = 0;
+            }
+            if (++site.count > maxPerSecond) {
+                ++_throttled;
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,76 @@
+//
+// LogThrottle.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLLog.h"
+#include "c4Base.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace cbl_internal {
+
+    /** Samples and rate-limits the messages of log domains, for \ref CBLLog_SetDomainThrottle.
+        It's applied to a message's format string before it's formatted; each format string is
+        a message site, with its own rate limit. Warnings and errors always pass.
+        Sites are told apart by the format's address, not its contents, which is only right for
+        string literals: a format built at run time is a new site every time it's logged. So
+        there are at most `kMaxSites`; when that many are known, the ones idle in the current
+        second are forgotten, and if none are, new sites share a single rate limit. */
+    class LogThrottle {
+    public:
+        void set(C4LogDomain domain, const CBLLogThrottle &throttle);
+
+        /** True if any domain is throttled. */
+        bool active() const                         {return _active;}
+
+        /** Returns false if the message should be dropped. */
+        bool allow(C4LogDomain domain, C4LogLevel level, const char *format);
+
+        uint64_t throttled() const                  {return _throttled;}
+
+    private:
+        static constexpr size_t kMaxDomains = 32;
+        static constexpr size_t kMaxSites = 4096;
+
+        struct DomainState {
+            std::atomic<C4LogDomain>    domain {nullptr};
+            std::atomic<uint32_t>       sampleRate {0};
+            std::atomic<uint32_t>       maxPerSecond {0};
+            std::atomic<uint64_t>       counter {0};
+        };
+
+        struct Site {
+            int64_t                     second {0};         // The current one-second window
+            uint32_t                    count {0};          // Messages in it
+        };
+
+        DomainState* find(C4LogDomain domain);      // Returns nullptr if not throttled
+
+        DomainState                                 _domains[kMaxDomains];
+        std::atomic<size_t>                         _domainCount {0};
+        std::atomic<bool>                           _active {false};
+        std::atomic<uint64_t>                       _throttled {0};
+
+        std::mutex                                  _mutex;
+        std::unordered_map<const char*, Site>       _sites;     // Keyed by format's address
+        Site                                        _overflowSite;  // Used when _sites is full
+    };
+
+}
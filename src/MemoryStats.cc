@@ -0,0 +1,102 @@
+//
+// MemoryStats.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "MemoryStats.hh"
+#include "CBLLog.h"
+#include "Backtrace.hh"
+#include "fleece/InstanceCounted.hh"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// SQLite is linked into LiteCore; this is its total heap usage, including page caches.
+extern "C" int64_t sqlite3_memory_used(void);
+
+using namespace std;
+
+namespace cbl_internal {
+
+    namespace {
+        struct Tracked {
+            const void*                 owner;
+            MemoryCategory              category;
+            shared_ptr<fleece::Backtrace> backtrace;
+        };
+
+        const char* const kCategoryNames[] = {
+            "document", "result set", "blob", "replicator", "database"
+        };
+
+        // Tracked objects, keyed by their MemoryAccount's address. (Never freed, since objects
+        // may outlive static destruction.)
+        mutex& sTrackedMutex = *new mutex;
+        unordered_map<const MemoryAccount*, Tracked>& sTracked = *new unordered_map<const MemoryAccount*, Tracked>;
+    }
+
+
+    CBLMemoryStats MemoryAccount::stats() {
+        auto usage = [](MemoryCategory category) {
+            auto &totals = sTotals[size_t(category)];
+            return CBLMemoryUsage {uint64_t(max(totals.count.load(), int64_t(0))),
+                                   uint64_t(max(totals.bytes.load(), int64_t(0)))};
+        };
+        CBLMemoryStats stats;
+        stats.documents = usage(MemoryCategory::kDocuments);
+        stats.resultSets = usage(MemoryCategory::kResultSets);
+        stats.blobs = usage(MemoryCategory::kBlobs);
+        stats.replicators = usage(MemoryCategory::kReplicators);
+        stats.databases = {usage(MemoryCategory::kDatabases).count,
+                           uint64_t(max(sqlite3_memory_used(), int64_t(0)))};
+        stats.totalObjects = fleece::InstanceCounted::liveInstanceCount();
+        return stats;
+    }
+
+
+    void MemoryAccount::setTracking(bool tracking) {
+        sTracking = tracking;
+    }
+
+
+    void MemoryAccount::track(const void* owner) {
+        // Skip the frames of this function and the constructor:
+        auto backtrace = fleece::Backtrace::capture(2);
+        lock_guard<mutex> lock(sTrackedMutex);
+        sTracked[this] = {owner, _category, std::move(backtrace)};
+        sTrackedCount = sTracked.size();
+    }
+
+
+    void MemoryAccount::untrack() {
+        lock_guard<mutex> lock(sTrackedMutex);
+        sTracked.erase(this);
+        sTrackedCount = sTracked.size();
+    }
+
+
+    unsigned MemoryAccount::dumpTracked() {
+        lock_guard<mutex> lock(sTrackedMutex);
+        for (auto &[account, tracked] : sTracked) {
+            string backtrace = tracked.backtrace ? tracked.backtrace->toString() : "(none)";
+            CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning, "Live %s %p (%zu bytes) allocated at:\n%s",
+                    kCategoryNames[size_t(tracked.category)], tracked.owner, account->bytes(),
+                    backtrace.c_str());
+        }
+        return unsigned(sTracked.size());
+    }
+
+}
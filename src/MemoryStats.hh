@@ -0,0 +1,96 @@
+//
+// MemoryStats.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLBase.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** The categories of \ref CBLMemoryStats. */
+    enum class MemoryCategory : uint8_t {
+        kDocuments, kResultSets, kBlobs, kReplicators, kDatabases,
+        kCount
+    };
+
+    /** The live objects of a MemoryCategory, and the bytes they hold. */
+    struct MemoryTotals {
+        std::atomic<int64_t> count {0};
+        std::atomic<int64_t> bytes {0};
+    };
+
+
+    /** Counts an object and the bytes it holds in its category's totals, reported by
+        \ref CBL_GetMemoryStats, from its construction to its destruction. An object keeps one
+        as a member, and updates its size when the data it owns changes. Costs two relaxed
+        atomic adds per object, and one per size change. */
+    class MemoryAccount {
+    public:
+        MemoryAccount(MemoryCategory category, const void* owner, size_t bytes) noexcept
+        :_bytes(bytes)
+        ,_category(category)
+        {
+            auto &totals = sTotals[size_t(category)];
+            totals.count.fetch_add(1, std::memory_order_relaxed);
+            totals.bytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (sTracking.load(std::memory_order_relaxed)) [[unlikely]]
+                track(owner);
+        }
+
+        ~MemoryAccount() {
+            auto &totals = sTotals[size_t(_category)];
+            totals.count.fetch_sub(1, std::memory_order_relaxed);
+            totals.bytes.fetch_sub(_bytes, std::memory_order_relaxed);
+            if (sTrackedCount.load(std::memory_order_relaxed) > 0) [[unlikely]]
+                untrack();
+        }
+
+        size_t bytes() const                    {return _bytes;}
+
+        void setBytes(size_t bytes) noexcept {
+            sTotals[size_t(_category)].bytes.fetch_add(int64_t(bytes) - int64_t(_bytes),
+                                                       std::memory_order_relaxed);
+            _bytes = bytes;
+        }
+
+        MemoryAccount(const MemoryAccount&) =delete;
+        MemoryAccount& operator=(const MemoryAccount&) =delete;
+
+        static CBLMemoryStats stats();
+        static void setTracking(bool tracking);
+        static unsigned dumpTracked();
+
+    private:
+        void track(const void* owner);
+        void untrack();
+
+        size_t                  _bytes;
+        MemoryCategory const    _category;
+
+        static inline MemoryTotals          sTotals[size_t(MemoryCategory::kCount)];
+        static inline std::atomic<bool>     sTracking {false};
+        static inline std::atomic<size_t>   sTrackedCount {0};
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
@@ -0,0 +1,149 @@
+//
+// ObjectPool.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "fleece/Fleece.h"
+#include "fleece/RefCounted.hh"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace cbl_internal {
+
+    /** Mixin that gives a class a small per-thread free list of memory blocks, so that objects
+        created and released in tight loops (like documents and result sets) rarely go to the
+        global allocator. Usage: `struct Foo : Base, Pooled<Foo> { ... }`.
+        Blocks freed on a thread are reused by the next allocation on that same thread, so this
+        doesn't help objects that are created on one thread and freed on another: the producer's
+        list stays empty, and the consumer's fills up and then frees to the global allocator. */
+    template <class T, size_t kMaxPooled = 32>
+    class Pooled {
+    public:
+        static void* operator new(size_t size) {
+            if (size == sizeof(T)) {
+                if (auto pool = freeList(); pool && !pool->empty()) {
+                    void* block = pool->back();
+                    pool->pop_back();
+                    return block;
+                }
+            }
+            sHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+
+        static void operator delete(void* block, size_t size) noexcept {
+            if (size == sizeof(T)) {
+                if (auto pool = freeList(); pool && pool->size() < kMaxPooled) {
+                    pool->push_back(block);
+                    return;
+                }
+            }
+            ::operator delete(block);
+        }
+
+        /** Frees the blocks in the calling thread's free list, returning the number of bytes.
+            Other threads' free lists can't be touched from here; they're freed the next time
+            their thread creates or deletes a `T`, and aren't counted in the result. */
+        static size_t releaseFreeList() noexcept {
+            auto pool = freeList();
+            if (!pool)
+                return 0;
+            sTrimEpoch.fetch_add(1, std::memory_order_relaxed);
+            return pool->release();
+        }
+
+        /** The number of instances whose memory came from the global allocator, not the pool. */
+        static uint64_t heapAllocationCount() {
+            return sHeapAllocations.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct FreeList : std::vector<void*> {
+            FreeList()          {reserve(kMaxPooled);}
+            ~FreeList() {
+                release();
+                destroyed() = true;
+            }
+
+            size_t release() noexcept {
+                size_t bytes = size() * sizeof(T);
+                for (void* block : *this)
+                    ::operator delete(block);
+                clear();
+                epoch = sTrimEpoch.load(std::memory_order_relaxed);
+                return bytes;
+            }
+
+            uint32_t epoch = sTrimEpoch.load(std::memory_order_relaxed);
+        };
+
+        // Returns null while the thread is exiting, after its free list has been destroyed.
+        // Empties the list first if `releaseFreeList` was called since it was last used.
+        static FreeList* freeList() noexcept {
+            if (destroyed())
+                return nullptr;
+            thread_local FreeList tFreeList;
+            if (tFreeList.epoch != sTrimEpoch.load(std::memory_order_relaxed)) [[unlikely]]
+                tFreeList.release();
+            return &tFreeList;
+        }
+
+        // Trivially destructible, so it stays valid until the thread is gone:
+        static bool& destroyed() noexcept {
+            thread_local bool tDestroyed = false;
+            return tDestroyed;
+        }
+
+        static inline std::atomic<uint64_t> sHeapAllocations {0};
+        static inline std::atomic<uint32_t> sTrimEpoch {0};       // Bumped by `releaseFreeList`
+    };
+
+
+    /** A map from Fleece Dicts to the objects wrapping them (blobs, encryptables) that doesn't
+        allocate anything until the first object is added, since most documents and result rows
+        never create any. */
+    template <class V>
+    class LazyValueMap {
+    public:
+        V* find(FLDict dict) const {
+            if (_map) {
+                if (auto i = _map->find(dict); i != _map->end())
+                    return i->second;
+            }
+            return nullptr;
+        }
+
+        V* insert(FLDict dict, V* value) {
+            if (!_map)
+                _map = std::make_unique<Map>();
+            return _map->emplace(dict, value).first->second;
+        }
+
+        void clear()                    {if (_map) _map->clear();}
+        bool empty() const              {return !_map || _map->empty();}
+
+    private:
+        using Map = std::unordered_map<FLDict, fleece::Retained<V>>;
+        std::unique_ptr<Map> _map;
+    };
+
+}
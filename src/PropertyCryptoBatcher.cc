@@ -0,0 +1,203 @@
+//
+// PropertyCryptoBatcher.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "PropertyCryptoBatcher.hh"
+
+#ifdef COUCHBASE_ENTERPRISE
+
+#include "Internal.hh"
+#include "CBLEncryptable_Internal.hh"
+#include "CBLLog_Internal.hh"
+#include "c4Document.hh"
+#include "fleece/Fleece.h"
+#include <cstring>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    // How LiteCore stores an encrypted property in a document body. (LiteCore doesn't export
+    // these; `process` checks each batch against what LiteCore asked for, so if they ever
+    // drift, batching just turns itself off.)
+    static constexpr slice kEncryptedKeyPrefix  = "encrypted$"_sl;
+    static constexpr slice kCiphertextProperty  = "ciphertext"_sl;
+    static constexpr slice kAlgorithmProperty   = "alg"_sl;
+    static constexpr slice kKeyIDProperty       = "kid"_sl;
+
+    // Room each output gets beyond the size of its input, for IVs, tags and padding:
+    static constexpr size_t kOutputOverhead     = 64;
+
+
+    string PropertyCryptoBatcher::normalizedPath(slice keyPath) {
+        if (keyPath.hasPrefix("$"_sl))
+            keyPath.moveStart(1);
+        if (keyPath.hasPrefix("."_sl))
+            keyPath.moveStart(1);
+        return string(keyPath);
+    }
+
+
+    // Finds the properties LiteCore will ask to (en|de)crypt, and their inputs in the same form.
+    void PropertyCryptoBatcher::findProperties(FLDict properties, vector<Item> &items) const {
+        FLDeepIterator i = FLDeepIterator_New((FLValue)properties);
+        for (; FLDeepIterator_GetValue(i); FLDeepIterator_Next(i)) {
+            FLDict dict = FLValue_AsDict(FLDeepIterator_GetValue(i));
+            if (!dict)
+                continue;
+            slice key = FLDeepIterator_GetKey(i);
+            alloc_slice path(FLDeepIterator_GetPathString(i));
+            if (!_decrypting) {
+                FLValue value = CBLEncryptable::valueOf(dict);
+                if (!value)
+                    continue;
+                // LiteCore encrypts the value's canonical JSON:
+                items.push_back({normalizedPath(path), alloc_slice(FLValue_ToJSONX(value, false, true))});
+            } else {
+                if (!key.hasPrefix(kEncryptedKeyPrefix))
+                    continue;
+                FLValue ciphertext = FLDict_Get(dict, kCiphertextProperty);
+                alloc_slice input;
+                if (FLValue_GetType(ciphertext) == kFLString)
+                    input = decodeBase64(FLValue_AsString(ciphertext));
+                else
+                    input = alloc_slice(FLValue_AsData(ciphertext));
+                if (!input)
+                    continue;
+                // The key path names the property as it was before it was encrypted:
+                string keyPath = normalizedPath(path);
+                if (slice(keyPath).hasSuffix(key)) {
+                    keyPath.resize(keyPath.size() - key.size);
+                    key.moveStart(kEncryptedKeyPrefix.size);
+                    keyPath.append((const char*)key.buf, key.size);
+                }
+                items.push_back({std::move(keyPath), std::move(input),
+                                 alloc_slice(FLValue_AsString(FLDict_Get(dict, kAlgorithmProperty))),
+                                 alloc_slice(FLValue_AsString(FLDict_Get(dict, kKeyIDProperty)))});
+            }
+            FLDeepIterator_SkipChildren(i);
+        }
+        FLDeepIterator_Free(i);
+    }
+
+
+    PropertyCryptoBatcher::Result PropertyCryptoBatcher::process(C4CollectionSpec spec,
+                                                                 slice docID,
+                                                                 FLDict properties,
+                                                                 slice keyPath,
+                                                                 slice input,
+                                                                 slice algorithm,
+                                                                 slice keyID,
+                                                                 const BatchFn &batchFn)
+    {
+        lock_guard<mutex> lock(_mutex);
+        string path = normalizedPath(keyPath);
+
+        // Use the result from the last batch, if this property was in it:
+        if (properties == _properties && docID == _docID
+                && slice(spec.scope) == _scope && slice(spec.name) == _collection) {
+            if (auto i = _pending.find(path); i != _pending.end() && i->second.first == input) {
+                Result result = std::move(i->second.second);
+                _pending.erase(i);
+                return result;
+            }
+        }
+
+        // Otherwise start a new batch, with the requested property first:
+        _pending.clear();
+        _items.clear();
+        _items.push_back({path, alloc_slice(input), alloc_slice(algorithm), alloc_slice(keyID)});
+        if (properties && !_mismatched) {
+            findProperties(properties, _items);
+            // Remove the requested property's own entry. If it isn't there, LiteCore's format
+            // isn't what `findProperties` expects, and the rest of the batch would be wasted:
+            bool found = false;
+            for (auto i = _items.begin() + 1; i != _items.end(); ++i) {
+                if (i->keyPath == path && i->input == input) {
+                    _items.erase(i);
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) {
+                _mismatched = true;
+                _items.resize(1);
+                CBL_Log(kCBLLogDomainReplicator, kCBLLogWarning,
+                        "Property %s batching is off: LiteCore asked for a property that wasn't "
+                        "found in the document", (_decrypting ? "decryption" : "encryption"));
+            }
+        }
+
+        // Give every key path the same form as LiteCore's, and pack the inputs together:
+        string prefix((const char*)keyPath.buf, keyPath.size - path.size());
+        _keyPaths.clear();
+        _keyPaths.push_back(string(keyPath));
+        size_t inputSize = 0;
+        for (auto &item : _items) {
+            if (&item != &_items[0])
+                _keyPaths.push_back(prefix + item.keyPath);
+            inputSize += item.input.size;
+        }
+        _inputBuffer.resize(inputSize);
+        if (size_t outputSize = inputSize + kOutputOverhead * _items.size(); _outputBuffer.size() < outputSize)
+            _outputBuffer.resize(outputSize);
+
+        _batch.clear();
+        size_t offset = 0;
+        for (size_t i = 0; i < _items.size(); ++i) {
+            auto &item = _items[i];
+            if (item.input.size > 0)
+                memcpy(&_inputBuffer[offset], item.input.buf, item.input.size);
+            CBLEncryptableProperty prop {};
+            prop.documentID = docID;
+            prop.keyPath = slice(_keyPaths[i]);
+            prop.input = slice(_inputBuffer.data() + offset, item.input.size);
+            if (_decrypting) {
+                prop.algorithm = item.algorithm;
+                prop.kid = item.keyID;
+            }
+            _batch.push_back(prop);
+            offset += item.input.size;
+        }
+
+        CBLError error {};
+        batchFn(_batch.data(), _batch.size(), _outputBuffer.data(), _outputBuffer.size(), &error);
+
+        // Copy the results out of the buffers before they're reused:
+        Result result;
+        for (size_t i = 0; i < _batch.size(); ++i) {
+            auto &prop = _batch[i];
+            Result r {alloc_slice(prop.output), alloc_slice(prop.algorithm), alloc_slice(prop.kid), error};
+            if (_decrypting)
+                r.algorithm = r.keyID = nullslice;
+            if (i == 0)
+                result = std::move(r);
+            else
+                _pending.emplace(_items[i].keyPath, make_pair(_items[i].input, std::move(r)));
+        }
+
+        _properties = properties;
+        _docID = alloc_slice(docID);
+        _scope = alloc_slice(spec.scope);
+        _collection = alloc_slice(spec.name);
+        return result;
+    }
+
+}
+
+#endif
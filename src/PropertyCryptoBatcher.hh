@@ -0,0 +1,92 @@
+//
+// PropertyCryptoBatcher.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLReplicator.h"
+#include "c4ReplicatorTypes.h"
+#include "fleece/slice.hh"
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef COUCHBASE_ENTERPRISE
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** Adapts LiteCore's one-property-at-a-time encryption and decryption callbacks to a
+        \ref CBLBatchPropertyEncryptor or \ref CBLBatchPropertyDecryptor.
+        LiteCore asks for each property of a revision in turn, passing the whole document each time;
+        on the first request for a revision, this finds all of the document's (en|de)cryptable
+        properties and hands them to the app in one batch, then answers the rest of the revision's
+        requests from the results. A request that doesn't match a batched property just gets a
+        batch of its own; if the requested property itself wasn't found in the document, which
+        means LiteCore formats something differently than expected, every later request does. */
+    class PropertyCryptoBatcher {
+    public:
+        using BatchFn = std::function<void(CBLEncryptableProperty*, size_t, void*, size_t, CBLError*)>;
+
+        /** The outcome of encrypting or decrypting one property. */
+        struct Result {
+            fleece::alloc_slice output, algorithm, keyID;
+            CBLError            error {};
+        };
+
+        explicit PropertyCryptoBatcher(bool decrypting)
+        :_decrypting(decrypting)
+        { }
+
+        /** Returns the result for one property, calling `batchFn` with it and the rest of the
+            document's properties unless an earlier batch already included it. Thread-safe;
+            `batchFn` is never called concurrently. */
+        Result process(C4CollectionSpec spec, fleece::slice docID, FLDict properties,
+                       fleece::slice keyPath, fleece::slice input,
+                       fleece::slice algorithm, fleece::slice keyID,
+                       const BatchFn &batchFn);
+
+    private:
+        struct Item {
+            std::string         keyPath;        // Normalized
+            fleece::alloc_slice input, algorithm, keyID;
+        };
+
+        void findProperties(FLDict properties, std::vector<Item> &items) const;
+        static std::string normalizedPath(fleece::slice keyPath);
+
+        bool const                              _decrypting;
+        bool                                    _mismatched {false};    // Stop batching
+        std::mutex                              _mutex;
+        // The last batch's document, and the results not yet asked for:
+        fleece::alloc_slice                     _docID, _scope, _collection;
+        FLDict _cbl_nullable                    _properties {nullptr};
+        std::unordered_map<std::string, std::pair<fleece::alloc_slice, Result>> _pending;
+        // Reused between batches:
+        std::vector<Item>                       _items;
+        std::vector<std::string>                _keyPaths;
+        std::vector<CBLEncryptableProperty>     _batch;
+        std::vector<uint8_t>                    _inputBuffer, _outputBuffer;
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
+
+#endif
@@ -0,0 +1,132 @@
+//
+// QueryCache.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLQuery.h"
+#include "c4Query.hh"
+#include "fleece/RefCounted.hh"
+#include "fleece/slice.hh"
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** A least-recently-used cache of compiled C4Queries, keyed by query language and text.
+        It is not thread-safe; CBLDatabase only uses it while holding its C4Database lock. */
+    class QueryCache {
+    public:
+        explicit QueryCache(size_t capacity)
+        :_capacity(capacity)
+        { }
+
+        size_t capacity() const             {return _capacity;}
+
+        /** Returns the cached query compiled from this text, marking it most recently used,
+            or null if there is none. */
+        C4Query* _cbl_nullable get(C4QueryLanguage language, fleece::slice text) {
+            if (_capacity == 0)
+                return nullptr;
+            auto i = _index.find(key(language, text));
+            if (i == _index.end()) {
+                ++_stats.misses;
+                return nullptr;
+            }
+            _lru.splice(_lru.begin(), _lru, i->second);
+            ++_stats.hits;
+            return i->second->query;
+        }
+
+        /** Adds a newly compiled query, evicting the least recently used one if the cache is full. */
+        void put(C4QueryLanguage language, fleece::slice text, C4Query* query) {
+            if (_capacity == 0)
+                return;
+            std::string k = key(language, text);
+            if (auto i = _index.find(k); i != _index.end()) {
+                i->second->query = query;
+                _lru.splice(_lru.begin(), _lru, i->second);
+                return;
+            }
+            if (_lru.size() >= _capacity) {
+                _index.erase(_lru.back().key);
+                _lru.pop_back();
+                ++_stats.evictions;
+            }
+            _lru.push_front({std::move(k), query});
+            _index.emplace(_lru.front().key, _lru.begin());
+        }
+
+        /** Drops all cached queries, since they may have been compiled against indexes or
+            collections that changed. */
+        void invalidate() {
+            if (_lru.empty())
+                return;
+            clear();
+            ++_stats.invalidations;
+        }
+
+        void clear() {
+            _index.clear();
+            _lru.clear();
+        }
+
+        /** Drops the least recently used queries until at most `keep` are left, returning the
+            number dropped. */
+        size_t trim(size_t keep) {
+            size_t dropped = 0;
+            while (_lru.size() > keep) {
+                _index.erase(_lru.back().key);
+                _lru.pop_back();
+                ++dropped;
+            }
+            return dropped;
+        }
+
+        size_t count() const                {return _lru.size();}
+
+        CBLQueryCacheStats stats() const {
+            CBLQueryCacheStats stats = _stats;
+            stats.count = uint32_t(_lru.size());
+            return stats;
+        }
+
+    private:
+        struct Entry {
+            std::string                 key;
+            fleece::Retained<C4Query>   query;
+        };
+        using LRUList = std::list<Entry>;
+
+        static std::string key(C4QueryLanguage language, fleece::slice text) {
+            std::string k(1, char(language));
+            k.append((const char*)text.buf, text.size);
+            return k;
+        }
+
+        size_t const                                                _capacity;
+        LRUList                                                     _lru;       // Most recent first
+        std::unordered_map<std::string_view, LRUList::iterator>     _index;     // Keys point into _lru
+        CBLQueryCacheStats                                          _stats {};
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
@@ -0,0 +1,191 @@
+//
+// ReplicatorMetrics.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLReplicator.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** Lock-free accumulator of operation times, with a log-scale histogram.
+        Recording and reading are both just relaxed atomic operations. */
+    class TimingStat {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /** Measures the time from its creation until it's destroyed. */
+        class Timer {
+        public:
+            explicit Timer(TimingStat &stat)    :_stat(stat), _start(Clock::now()) { }
+            ~Timer()                            {_stat.record(Clock::now() - _start);}
+        private:
+            TimingStat&         _stat;
+            Clock::time_point   _start;
+        };
+
+        void record(Clock::duration duration) {
+            auto ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+            _count.fetch_add(1, std::memory_order_relaxed);
+            _totalNS.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t max = _maxNS.load(std::memory_order_relaxed);
+            while (ns > max && !_maxNS.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+                ;
+            _histogram[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void recordMS(double ms) {
+            record(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms)));
+        }
+
+        CBLTimingStats snapshot() const {
+            CBLTimingStats stats {};
+            stats.count = _count.load(std::memory_order_relaxed);
+            stats.totalTime = _totalNS.load(std::memory_order_relaxed) / 1.0e6;
+            stats.maxTime = _maxNS.load(std::memory_order_relaxed) / 1.0e6;
+            for (int i = 0; i < kCBLTimingHistogramBuckets; ++i)
+                stats.histogram[i] = _histogram[i].load(std::memory_order_relaxed);
+            return stats;
+        }
+
+    private:
+        // Bucket 0 is under 1µs, and each bucket after that is 10x longer:
+        static int bucket(uint64_t ns) {
+            int i = 0;
+            for (uint64_t limit = 1000; ns >= limit && i < kCBLTimingHistogramBuckets - 1; limit *= 10)
+                ++i;
+            return i;
+        }
+
+        std::atomic<uint64_t> _count {0};
+        std::atomic<uint64_t> _totalNS {0};
+        std::atomic<uint64_t> _maxNS {0};
+        std::atomic<uint64_t> _histogram[kCBLTimingHistogramBuckets] {};
+    };
+
+
+    /** A replicator's metrics. Everything is atomic, so `snapshot` can be called on any thread
+        without locking. */
+    class ReplicatorMetrics {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        void started() {
+            _startTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+            _pushedAtStart.store(_pushed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            _pulledAtStart.store(_pulled.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        void documentEnded(bool pushing, bool failed) {
+            (pushing ? _pushed : _pulled).fetch_add(1, std::memory_order_relaxed);
+            if (failed)
+                _errors.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void progress(uint64_t completed, uint64_t total) {
+            _unitsCompleted.store(completed, std::memory_order_relaxed);
+            _unitsTotal.store(total, std::memory_order_relaxed);
+        }
+
+        TimingStat pushFilter, pullFilter, conflictResolver, conflictTransaction;
+        TimingStat propertyEncryptor, propertyDecryptor;
+
+        CBLReplicatorMetrics snapshot() const {
+            CBLReplicatorMetrics m {};
+            m.documentsPushed = _pushed.load(std::memory_order_relaxed);
+            m.documentsPulled = _pulled.load(std::memory_order_relaxed);
+            m.documentErrors = _errors.load(std::memory_order_relaxed);
+            if (auto start = _startTime.load(std::memory_order_relaxed); start != 0) {
+                auto elapsed = Clock::now() - Clock::time_point(Clock::duration(start));
+                m.activeTime = std::chrono::duration<double, std::milli>(elapsed).count();
+                if (m.activeTime > 0) {
+                    double seconds = m.activeTime / 1000.0;
+                    m.documentsPushedPerSecond = (m.documentsPushed - _pushedAtStart.load(std::memory_order_relaxed)) / seconds;
+                    m.documentsPulledPerSecond = (m.documentsPulled - _pulledAtStart.load(std::memory_order_relaxed)) / seconds;
+                }
+            }
+            m.progressUnitsCompleted = _unitsCompleted.load(std::memory_order_relaxed);
+            m.progressUnitsTotal = _unitsTotal.load(std::memory_order_relaxed);
+            m.pushFilter = pushFilter.snapshot();
+            m.pullFilter = pullFilter.snapshot();
+            m.conflictResolver = conflictResolver.snapshot();
+            m.conflictTransaction = conflictTransaction.snapshot();
+            m.propertyEncryptor = propertyEncryptor.snapshot();
+            m.propertyDecryptor = propertyDecryptor.snapshot();
+            return m;
+        }
+
+    private:
+        std::atomic<Clock::rep> _startTime {0};         // Clock ticks since epoch; 0 if never started
+        std::atomic<uint64_t>   _pushed {0}, _pulled {0}, _errors {0};
+        std::atomic<uint64_t>   _pushedAtStart {0}, _pulledAtStart {0};
+        std::atomic<uint64_t>   _unitsCompleted {0}, _unitsTotal {0};
+    };
+
+
+    /** A seqlock holding a replicator's latest status, so it can be read on any thread without
+        waiting for a lock. A reader only retries if it overlaps a write, which is just a copy.
+        Writers must be serialized by the caller. The initial value is all zeroes. */
+    class StatusSnapshot {
+    public:
+        void store(const CBLReplicatorStatus &status) {
+            uint64_t words[kWords] {};
+            memcpy(words, &status, sizeof(status));
+            auto seq = _seq.load(std::memory_order_relaxed);
+            _seq.store(seq + 1, std::memory_order_relaxed);     // Odd while writing
+            std::atomic_thread_fence(std::memory_order_release);
+            for (size_t i = 0; i < kWords; ++i)
+                _words[i].store(words[i], std::memory_order_relaxed);
+            _seq.store(seq + 2, std::memory_order_release);
+        }
+
+        CBLReplicatorStatus load() const {
+            uint64_t words[kWords];
+            for (;;) {
+                auto seq = _seq.load(std::memory_order_acquire);
+                if ((seq & 1) == 0) {
+                    for (size_t i = 0; i < kWords; ++i)
+                        words[i] = _words[i].load(std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (_seq.load(std::memory_order_relaxed) == seq)
+                        break;
+                }
+                std::this_thread::yield();
+            }
+            CBLReplicatorStatus status;
+            memcpy(&status, words, sizeof(status));
+            return status;
+        }
+
+    private:
+        static_assert(std::is_trivially_copyable_v<CBLReplicatorStatus>);
+        static constexpr size_t kWords = (sizeof(CBLReplicatorStatus) + 7) / 8;
+
+        std::atomic<uint64_t> _seq {0};
+        std::atomic<uint64_t> _words[kWords] {};
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
@@ -0,0 +1,196 @@
+//
+// TaskPool.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "TaskPool.hh"
+#include "Internal.hh"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#else
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace cbl_internal {
+
+    // Applies the priority and affinity to the calling thread. These are best-effort: a process
+    // may not be allowed to raise its priority, or the CPUs may not exist, and then the thread
+    // just runs as it would have.
+    static void configureCurrentThread(CBLThreadPriority priority, uint64_t cpuAffinity) {
+#ifdef _WIN32
+        if (priority != kCBLThreadPriorityNormal)
+            SetThreadPriority(GetCurrentThread(), (priority == kCBLThreadPriorityLow)
+                              ? THREAD_PRIORITY_BELOW_NORMAL : THREAD_PRIORITY_ABOVE_NORMAL);
+        if (cpuAffinity)
+            SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(cpuAffinity));
+#elif defined(__APPLE__)
+        if (priority != kCBLThreadPriorityNormal)
+            pthread_set_qos_class_self_np((priority == kCBLThreadPriorityLow)
+                                          ? QOS_CLASS_UTILITY : QOS_CLASS_USER_INITIATED, 0);
+        (void)cpuAffinity;      // Apple platforms don't support setting affinity
+#else
+        if (priority != kCBLThreadPriorityNormal) {
+            // On Linux, each thread has its own nice value:
+            auto tid = id_t(syscall(SYS_gettid));
+            setpriority(PRIO_PROCESS, tid, (priority == kCBLThreadPriorityLow) ? 10 : -5);
+        }
+        if (cpuAffinity) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (unsigned cpu = 0; cpu < 64; ++cpu) {
+                if (cpuAffinity & (uint64_t(1) << cpu))
+                    CPU_SET(cpu, &cpus);
+            }
+            sched_setaffinity(0, sizeof(cpus), &cpus);
+        }
+#endif
+    }
+
+
+#pragma mark - WORKER POOL:
+
+
+    WorkerPool::WorkerPool(unsigned nThreads, CBLThreadPriority priority, uint64_t cpuAffinity) {
+        for (unsigned i = 0; i < nThreads; ++i) {
+            _threads.emplace_back([this, priority, cpuAffinity] {
+                configureCurrentThread(priority, cpuAffinity);
+                workLoop();
+            });
+        }
+    }
+
+
+    WorkerPool::~WorkerPool() {
+        {
+            LOCK(_mutex);
+            _stopping = true;
+        }
+        _cond.notify_all();
+        for (auto &thread : _threads)
+            thread.join();
+    }
+
+
+    void WorkerPool::enqueue(CBLTask task, void* context) {
+        {
+            LOCK(_mutex);
+            _tasks.emplace_back(task, context);
+        }
+        _cond.notify_one();
+    }
+
+
+    void WorkerPool::workLoop() {
+        unique_lock<mutex> lock(_mutex);
+        while (true) {
+            _cond.wait(lock, [this] {return _stopping || !_tasks.empty();});
+            if (_tasks.empty())
+                return;     // Stopping, and every task has run
+            auto [task, context] = _tasks.front();
+            _tasks.pop_front();
+            lock.unlock();
+            task(context);
+            lock.lock();
+        }
+    }
+
+
+#pragma mark - ASYNC TASKS:
+
+
+    static mutex                        sMutex;
+    static CBLThreadPoolConfiguration   sConfig {};
+    // Created by the first task, if configured. It's never deleted: at exit its workers may be
+    // running tasks that use objects already destroyed by then, so joining them from a static
+    // destructor could hang or crash. The OS ends them with the process.
+    static WorkerPool*                  sPool = nullptr;
+    static bool                         sStarted = false;
+
+
+    void AsyncTasks::configure(const CBLThreadPoolConfiguration &config) {
+        if (!config.executor) {
+            if (config.workerCount > kCBLMaxThreadPoolWorkers)
+                C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Too many thread pool workers");
+            if (config.priority > kCBLThreadPriorityHigh)
+                C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "Invalid thread priority");
+        }
+        LOCK(sMutex);
+        if (sStarted)
+            C4Error::raise(LiteCoreDomain, kC4ErrorUnsupported,
+                           "The thread pool can't be configured after background work has started");
+        sConfig = config;
+    }
+
+
+    bool AsyncTasks::configured() {
+        LOCK(sMutex);
+        return sConfig.executor || sConfig.workerCount > 0;
+    }
+
+
+    void AsyncTasks::run(CBLTask task, void* context) {
+        CBLTaskExecutor executor;
+        void* executorContext;
+        WorkerPool* pool = nullptr;
+        {
+            LOCK(sMutex);
+            sStarted = true;
+            executor = sConfig.executor;
+            executorContext = sConfig.executorContext;
+            if (!executor && sConfig.workerCount > 0) {
+                if (!sPool)
+                    sPool = new WorkerPool(sConfig.workerCount, sConfig.priority,
+                                           sConfig.cpuAffinity);
+                pool = sPool;
+            }
+        }
+        if (executor)
+            executor(executorContext, task, context);
+        else if (pool)
+            pool->enqueue(task, context);
+        else
+            c4_runAsyncTask(task, context);
+    }
+
+
+    void AsyncTasks::runBlocking(CBLTask task, void* context) {
+        bool isConfigured;
+        {
+            LOCK(sMutex);
+            isConfigured = sConfig.executor || sConfig.workerCount > 0;
+            sStarted = true;
+        }
+        if (isConfigured) {
+            run(task, context);
+        } else {
+            // Like the configured pool, it's never deleted:
+            static auto sBlockingPool = new WorkerPool(
+                                        std::clamp(std::thread::hardware_concurrency(), 2u, 4u));
+            sBlockingPool->enqueue(task, context);
+        }
+    }
+
+}
@@ -0,0 +1,81 @@
+//
+// TaskPool.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLPlatform.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** A fixed number of worker threads running queued tasks in order. Destructing it waits for
+        the queued tasks to finish. */
+    class WorkerPool {
+    public:
+        explicit WorkerPool(unsigned nThreads,
+                            CBLThreadPriority priority = kCBLThreadPriorityNormal,
+                            uint64_t cpuAffinity = 0);
+        ~WorkerPool();
+
+        void enqueue(CBLTask task, void* _cbl_nullable context);
+
+        WorkerPool(const WorkerPool&) =delete;
+        WorkerPool& operator=(const WorkerPool&) =delete;
+
+    private:
+        void workLoop();
+
+        std::mutex                                  _mutex;
+        std::condition_variable                     _cond;
+        std::deque<std::pair<CBLTask, void*>>       _tasks;
+        std::vector<std::thread>                    _threads;
+        bool                                        _stopping {false};
+    };
+
+
+    /** Runs CBL's own background tasks (conflict resolution, async writes, index builds...) as
+        configured by \ref CBL_ConfigureThreadPool: on an app's executor, on a WorkerPool, or by
+        default on LiteCore's shared threads via `c4_runAsyncTask`. */
+    class AsyncTasks {
+    public:
+        /** Sets the configuration; throws if it's invalid or a task has already run. */
+        static void configure(const CBLThreadPoolConfiguration&);
+
+        /** True if the app configured threads or an executor, not just LiteCore's threads. */
+        static bool configured();
+
+        /** Runs a task asynchronously. */
+        static void run(CBLTask task, void* _cbl_nullable context);
+
+        /** Runs a task that may block for a long time, such as prewarming a database, building
+            an index or writing queued documents. Unless the app configured threads or an
+            executor, it runs on a few threads of CBL's own rather than LiteCore's shared ones,
+            which the replicator and observers need. */
+        static void runBlocking(CBLTask task, void* _cbl_nullable context);
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
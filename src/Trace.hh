@@ -0,0 +1,154 @@
+//
+// Trace.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLLog.h"
+#include "fleece/slice.hh"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** A traced operation, reported to the callback set by \ref CBL_SetTraceCallback as a begin
+        event when constructed and an end event when destructed. While there's no callback, it
+        does nothing but check for one. Spans constructed while another one is alive on the same
+        thread are its children. */
+    class TraceSpan {
+    public:
+        /** The IDs a span's children refer to. */
+        struct Context {
+            uint64_t traceID {0};
+            uint64_t spanID {0};
+        };
+
+        /** Sets the callback and its context together, so an event never goes to one with the
+            other's context. Events already being posted may still reach the old callback. */
+        static void setCallback(CBLTraceCallback _cbl_nullable callback, void* _cbl_nullable context) {
+            std::shared_ptr<const Sink> sink;
+            if (callback)
+                sink = std::make_shared<const Sink>(Sink{callback, context});
+            std::lock_guard<std::mutex> lock(sSinkMutex);
+            sSink = std::move(sink);
+            sEnabled.store(callback != nullptr, std::memory_order_relaxed);
+        }
+
+        static bool enabled()                   {return sEnabled.load(std::memory_order_relaxed);}
+
+        /** Begins a span, a child of the innermost span on this thread, if any. */
+        explicit TraceSpan(CBLTraceOperation op, fleece::slice subject = fleece::nullslice)
+        :_subject(subject)
+        ,_op(op)
+        {
+            if (enabled())
+                begin(sCurrent ? sCurrent->context() : Context{});
+        }
+
+        /** Begins a span, a child of the given one, which may be on another thread or over. */
+        TraceSpan(CBLTraceOperation op, fleece::slice subject, Context parent)
+        :_subject(subject)
+        ,_op(op)
+        {
+            if (enabled())
+                begin(parent);
+        }
+
+        ~TraceSpan() {
+            if (!_context.spanID)
+                return;
+            sCurrent = _outer;
+            auto duration = std::chrono::steady_clock::now() - _start;
+            post(true, std::uncaught_exceptions() > _uncaught,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+        }
+
+        /** True if the span is being traced. */
+        explicit operator bool() const          {return _context.spanID != 0;}
+
+        Context context() const                 {return _context;}
+
+        void addBytes(uint64_t n)               {_bytes += n;}
+        void addItems(uint64_t n)               {_items += n;}
+        void setFailed()                        {_failed = true;}
+
+        TraceSpan(const TraceSpan&) =delete;
+        TraceSpan& operator=(const TraceSpan&) =delete;
+
+    private:
+        void begin(Context parent) {
+            _parent = parent;
+            _context.spanID = ++sLastSpanID;
+            _context.traceID = parent.traceID ? parent.traceID : _context.spanID;
+            _outer = sCurrent;
+            sCurrent = this;
+            _uncaught = std::uncaught_exceptions();
+            _start = std::chrono::steady_clock::now();
+            post(false, false, 0);
+        }
+
+        struct Sink {
+            CBLTraceCallback    callback;
+            void* _cbl_nullable context;
+        };
+
+        void post(bool end, bool failed, uint64_t durationNanos) {
+            std::shared_ptr<const Sink> sink;
+            {
+                std::lock_guard<std::mutex> lock(sSinkMutex);
+                sink = sSink;
+            }
+            if (!sink)
+                return;
+            CBLTraceEvent event {};
+            event.operation = _op;
+            event.end = end;
+            event.failed = failed || _failed;
+            event.traceID = _context.traceID;
+            event.spanID = _context.spanID;
+            event.parentSpanID = _parent.spanID;
+            event.subject = _subject;
+            event.durationNanos = durationNanos;
+            event.byteCount = _bytes;
+            event.itemCount = _items;
+            sink->callback(sink->context, &event);
+        }
+
+        fleece::slice               _subject;
+        Context                     _context, _parent;
+        TraceSpan* _cbl_nullable    _outer {nullptr};
+        std::chrono::steady_clock::time_point _start;
+        uint64_t                    _bytes {0}, _items {0};
+        int                         _uncaught {0};
+        CBLTraceOperation           _op;
+        bool                        _failed {false};
+
+        static inline std::atomic<bool>             sEnabled {false};   // Fast check for `sSink`
+        static inline std::mutex                    sSinkMutex;         // Only held to copy `sSink`
+        static inline std::shared_ptr<const Sink>   sSink;              // Guarded by sSinkMutex
+        static inline std::atomic<uint64_t>         sLastSpanID {0};
+        static inline thread_local TraceSpan* _cbl_nullable sCurrent {nullptr};
+    };
+
+}
+
+CBL_ASSUME_NONNULL_END
@@ -0,0 +1,272 @@
+//
+// VectorDistance.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "VectorDistance.hh"
+
+#ifdef COUCHBASE_ENTERPRISE
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+#   define CBL_VECTOR_AVX2
+#   include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#   define CBL_VECTOR_NEON
+#   include <arm_neon.h>
+#endif
+
+namespace cbl_internal {
+
+    // The kernels compute a dot product, a squared distance, or the three dot products that
+    // make up a cosine (a·b, a·a, b·b) in one pass.
+    struct Kernels {
+        float (*dot)(const float*, const float*, size_t);
+        float (*l2Squared)(const float*, const float*, size_t);
+        void  (*cosineParts)(const float*, const float*, size_t, float &ab, float &aa, float &bb);
+        const char* name;
+    };
+
+
+#pragma mark - SCALAR:
+
+
+    static float dotScalar(const float *a, const float *b, size_t n) {
+        float sum = 0;
+        for (size_t i = 0; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    static float l2SquaredScalar(const float *a, const float *b, size_t n) {
+        float sum = 0;
+        for (size_t i = 0; i < n; ++i) {
+            float d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    static void cosinePartsScalar(const float *a, const float *b, size_t n,
+                                  float &ab, float &aa, float &bb) {
+        ab = aa = bb = 0;
+        for (size_t i = 0; i < n; ++i) {
+            ab += a[i] * b[i];
+            aa += a[i] * a[i];
+            bb += b[i] * b[i];
+        }
+    }
+
+
+#pragma mark - AVX2:
+
+
+#ifdef CBL_VECTOR_AVX2
+    // Compiled for AVX2 and FMA whatever the target, and only called if the CPU has them.
+    #define AVX2_FN __attribute__((target("avx2,fma")))
+
+    AVX2_FN static inline float hsum(__m256 v) {
+        __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+        sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+        return _mm_cvtss_f32(sum);
+    }
+
+    // Two accumulators of 8 floats each hide the latency of the FMAs.
+    AVX2_FN static float dotAVX2(const float *a, const float *b, size_t n) {
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+        }
+        if (i + 8 <= n) {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+            i += 8;
+        }
+        float sum = hsum(_mm256_add_ps(sum0, sum1));
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    AVX2_FN static float l2SquaredAVX2(const float *a, const float *b, size_t n) {
+        __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+            sum0 = _mm256_fmadd_ps(d0, d0, sum0);
+            sum1 = _mm256_fmadd_ps(d1, d1, sum1);
+        }
+        if (i + 8 <= n) {
+            __m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+            sum0 = _mm256_fmadd_ps(d, d, sum0);
+            i += 8;
+        }
+        float sum = hsum(_mm256_add_ps(sum0, sum1));
+        for (; i < n; ++i) {
+            float d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    AVX2_FN static void cosinePartsAVX2(const float *a, const float *b, size_t n,
+                                        float &ab, float &aa, float &bb) {
+        __m256 sumAB = _mm256_setzero_ps(), sumAA = _mm256_setzero_ps(), sumBB = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256 va = _mm256_loadu_ps(a + i), vb = _mm256_loadu_ps(b + i);
+            sumAB = _mm256_fmadd_ps(va, vb, sumAB);
+            sumAA = _mm256_fmadd_ps(va, va, sumAA);
+            sumBB = _mm256_fmadd_ps(vb, vb, sumBB);
+        }
+        ab = hsum(sumAB);
+        aa = hsum(sumAA);
+        bb = hsum(sumBB);
+        for (; i < n; ++i) {
+            ab += a[i] * b[i];
+            aa += a[i] * a[i];
+            bb += b[i] * b[i];
+        }
+    }
+#endif
+
+
+#pragma mark - NEON:
+
+
+#ifdef CBL_VECTOR_NEON
+    static float dotNEON(const float *a, const float *b, size_t n) {
+        float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+            sum1 = vfmaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+        if (i + 4 <= n) {
+            sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+            i += 4;
+        }
+        float sum = vaddvq_f32(vaddq_f32(sum0, sum1));
+        for (; i < n; ++i)
+            sum += a[i] * b[i];
+        return sum;
+    }
+
+    static float l2SquaredNEON(const float *a, const float *b, size_t n) {
+        float32x4_t sum0 = vdupq_n_f32(0), sum1 = vdupq_n_f32(0);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            float32x4_t d0 = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+            float32x4_t d1 = vsubq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+            sum0 = vfmaq_f32(sum0, d0, d0);
+            sum1 = vfmaq_f32(sum1, d1, d1);
+        }
+        if (i + 4 <= n) {
+            float32x4_t d = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+            sum0 = vfmaq_f32(sum0, d, d);
+            i += 4;
+        }
+        float sum = vaddvq_f32(vaddq_f32(sum0, sum1));
+        for (; i < n; ++i) {
+            float d = a[i] - b[i];
+            sum += d * d;
+        }
+        return sum;
+    }
+
+    static void cosinePartsNEON(const float *a, const float *b, size_t n,
+                                float &ab, float &aa, float &bb) {
+        float32x4_t sumAB = vdupq_n_f32(0), sumAA = vdupq_n_f32(0), sumBB = vdupq_n_f32(0);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            float32x4_t va = vld1q_f32(a + i), vb = vld1q_f32(b + i);
+            sumAB = vfmaq_f32(sumAB, va, vb);
+            sumAA = vfmaq_f32(sumAA, va, va);
+            sumBB = vfmaq_f32(sumBB, vb, vb);
+        }
+        ab = vaddvq_f32(sumAB);
+        aa = vaddvq_f32(sumAA);
+        bb = vaddvq_f32(sumBB);
+        for (; i < n; ++i) {
+            ab += a[i] * b[i];
+            aa += a[i] * a[i];
+            bb += b[i] * b[i];
+        }
+    }
+#endif
+
+
+#pragma mark - DISPATCH:
+
+
+    static Kernels pickKernels() {
+#if defined(CBL_VECTOR_AVX2)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return {dotAVX2, l2SquaredAVX2, cosinePartsAVX2, "avx2"};
+#elif defined(CBL_VECTOR_NEON)
+        return {dotNEON, l2SquaredNEON, cosinePartsNEON, "neon"};
+#endif
+        return {dotScalar, l2SquaredScalar, cosinePartsScalar, "scalar"};
+    }
+
+    static const Kernels& kernels() noexcept {
+        static const Kernels sKernels = pickKernels();
+        return sKernels;
+    }
+
+
+    float VectorDot(const float *a, const float *b, size_t dimensions) noexcept {
+        return kernels().dot(a, b, dimensions);
+    }
+
+
+    float VectorL2Squared(const float *a, const float *b, size_t dimensions) noexcept {
+        return kernels().l2Squared(a, b, dimensions);
+    }
+
+
+    float VectorDistance(CBLDistanceMetric metric, const float *a, const float *b,
+                         size_t dimensions) noexcept
+    {
+        switch (metric) {
+            case kCBLDistanceMetricEuclidean:
+                return sqrtf(kernels().l2Squared(a, b, dimensions));
+            case kCBLDistanceMetricDot:
+                return -kernels().dot(a, b, dimensions);
+            case kCBLDistanceMetricCosine: {
+                float ab, aa, bb;
+                kernels().cosineParts(a, b, dimensions, ab, aa, bb);
+                float norms = sqrtf(aa) * sqrtf(bb);
+                return (norms > 0) ? 1.0f - ab / norms : 1.0f;
+            }
+            default:
+                return kernels().l2Squared(a, b, dimensions);
+        }
+    }
+
+
+    const char* VectorKernelName() noexcept {
+        return kernels().name;
+    }
+
+}
+
+#endif
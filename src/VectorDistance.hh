@@ -0,0 +1,50 @@
+//
+// VectorDistance.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLQueryIndexTypes.h"
+#include <cstddef>
+
+#ifdef COUCHBASE_ENTERPRISE
+
+CBL_ASSUME_NONNULL_BEGIN
+
+namespace cbl_internal {
+
+    /** Exact distances between vectors of floats. The kernels use AVX2 on x86-64 CPUs that
+        support it, NEON on ARM64, and plain loops elsewhere; `VectorKernelName` says which. */
+
+    /** The dot product. */
+    float VectorDot(const float *a, const float *b, size_t dimensions) noexcept;
+
+    /** The squared Euclidean distance. */
+    float VectorL2Squared(const float *a, const float *b, size_t dimensions) noexcept;
+
+    /** The distance by the given metric, as APPROX_VECTOR_DISTANCE defines it, so smaller is
+        nearer: the dot-product distance is the negative dot product, and the cosine distance is
+        1 - cosine similarity. 0 means \ref kCBLDistanceMetricEuclideanSquared. */
+    float VectorDistance(CBLDistanceMetric, const float *a, const float *b, size_t dimensions) noexcept;
+
+    /** "avx2", "neon" or "scalar". */
+    const char* VectorKernelName() noexcept;
+
+}
+
+CBL_ASSUME_NONNULL_END
+
+#endif
@@ -0,0 +1,504 @@
+//
+// VectorIndexAdvisor.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "VectorIndexAdvisor.hh"
+
+#ifdef COUCHBASE_ENTERPRISE
+
+#include "CBLCollection_Internal.hh"
+#include "CBLQuery_Internal.hh"
+#include "Internal.hh"
+#include "VectorDistance.hh"
+#include "VectorSearch.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <string>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    static constexpr unsigned kK                    = 10;       // Recall@k
+    static constexpr unsigned kDefaultSampleSize    = 2000;
+    static constexpr double   kDefaultTargetRecall  = 0.9;
+    static constexpr size_t   kMaxQueries           = 100;
+    static constexpr unsigned kMaxCentroids         = 64000;
+    static constexpr unsigned kKMeansIterations     = 10;
+    static constexpr unsigned kPQBits               = 8;
+    static constexpr unsigned kPQIterations         = 5;
+    static constexpr size_t   kPQTrainingSize       = 1000;     // Sample rows used to train PQ codes
+    // When maxTrainingSize isn't set, an index trains on up to this many vectors per centroid:
+    static constexpr uint64_t kTrainingPerCentroid  = 256;
+    static constexpr uint64_t kRowOverhead          = 8;        // Bytes per vector besides its code
+
+    using Clock = chrono::steady_clock;
+
+    static double secondsSince(Clock::time_point start) {
+        return chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    static uint64_t codeSize(const C4VectorEncoding &enc, unsigned dimensions) {
+        switch (enc.type) {
+            case kC4VectorEncodingSQ:   return (uint64_t(enc.bits) * dimensions + 7) / 8;
+            case kC4VectorEncodingPQ:   return (uint64_t(enc.bits) * enc.pq_subquantizers + 7) / 8;
+            default:                    return uint64_t(dimensions) * sizeof(float);
+        }
+    }
+
+
+    VectorIndexAdvisor::VectorIndexAdvisor(vector<float> sample, unsigned dimensions,
+                                           CBLDistanceMetric metric, uint64_t totalCount)
+    :_dimensions(dimensions)
+    ,_metric(metric)
+    {
+        size_t count = sample.size() / dimensions;
+        _queryCount = clamp<size_t>(count / 10, 1, kMaxQueries);
+        _baseCount = count - _queryCount;
+        _totalCount = max<uint64_t>(totalCount, _baseCount);
+
+        // Cosine distance ranks normalized vectors the same as Euclidean distance:
+        if (_metric == kCBLDistanceMetricCosine) {
+            for (size_t i = 0; i < count; ++i) {
+                float *v = &sample[i * dimensions];
+                float norm = sqrtf(VectorDot(v, v, dimensions));
+                if (norm > 0)
+                    for (size_t j = 0; j < dimensions; ++j)
+                        v[j] /= norm;
+            }
+        }
+        _queries.assign(sample.begin() + _baseCount * dimensions, sample.end());
+        sample.resize(_baseCount * dimensions);
+        _base = std::move(sample);
+
+        size_t k = min<size_t>(kK, _baseCount);
+        vector<pair<float, uint32_t>> distances(_baseCount);
+        for (size_t q = 0; q < _queryCount; ++q) {
+            for (size_t i = 0; i < _baseCount; ++i)
+                distances[i] = {distance(&_queries[q * dimensions], &_base[i * dimensions]), uint32_t(i)};
+            partial_sort(distances.begin(), distances.begin() + k, distances.end());
+            vector<uint32_t> nearest(k);
+            for (size_t i = 0; i < k; ++i)
+                nearest[i] = distances[i].second;
+            _nearest.push_back(std::move(nearest));
+        }
+    }
+
+
+    // Smaller is nearer.
+    float VectorIndexAdvisor::distance(const float *a, const float *b) const {
+        if (_metric == kCBLDistanceMetricDot)
+            return -VectorDot(a, b, _dimensions);
+        return VectorL2Squared(a, b, _dimensions);
+    }
+
+
+    // Lloyd's algorithm, on `count` rows `stride` floats apart, of which the first `dimensions`
+    // are used. Returns `k` centroids.
+    vector<float> VectorIndexAdvisor::kmeans(const float *data, size_t count, size_t stride,
+                                             size_t dimensions, size_t k, unsigned iterations)
+    {
+        k = min(k, count);
+        vector<uint32_t> order(count);
+        iota(order.begin(), order.end(), 0);
+        shuffle(order.begin(), order.end(), _random);
+        vector<float> centroids(k * dimensions);
+        for (size_t c = 0; c < k; ++c)
+            memcpy(&centroids[c * dimensions], data + order[c] * stride, dimensions * sizeof(float));
+
+        vector<float> sums(k * dimensions);
+        vector<size_t> sizes(k);
+        for (unsigned iter = 0; iter < iterations; ++iter) {
+            fill(sums.begin(), sums.end(), 0.0f);
+            fill(sizes.begin(), sizes.end(), 0);
+            for (size_t i = 0; i < count; ++i) {
+                const float *row = data + i * stride;
+                size_t best = 0;
+                float bestDistance = INFINITY;
+                for (size_t c = 0; c < k; ++c) {
+                    float d = VectorL2Squared(row, &centroids[c * dimensions], dimensions);
+                    if (d < bestDistance) {
+                        bestDistance = d;
+                        best = c;
+                    }
+                }
+                for (size_t j = 0; j < dimensions; ++j)
+                    sums[best * dimensions + j] += row[j];
+                ++sizes[best];
+            }
+            for (size_t c = 0; c < k; ++c) {
+                float *centroid = &centroids[c * dimensions];
+                if (sizes[c] > 0) {
+                    for (size_t j = 0; j < dimensions; ++j)
+                        centroid[j] = sums[c * dimensions + j] / sizes[c];
+                } else {
+                    // Restart an empty cluster from a random row:
+                    memcpy(centroid, data + (_random() % count) * stride, dimensions * sizeof(float));
+                }
+            }
+        }
+        return centroids;
+    }
+
+
+    // Returns the base vectors as they'd be after encoding and decoding.
+    vector<float> VectorIndexAdvisor::encode(const C4VectorEncoding &enc,
+                                             double &outTrainTime, double &outEncodeTime)
+    {
+        const size_t d = _dimensions;
+        vector<float> result(_base);
+        outTrainTime = outEncodeTime = 0;
+        if (enc.type == kC4VectorEncodingSQ) {
+            // Uniform quantization of each dimension between its minimum and maximum:
+            auto start = Clock::now();
+            vector<float> lo(d, INFINITY), hi(d, -INFINITY);
+            for (size_t i = 0; i < _baseCount; ++i) {
+                for (size_t j = 0; j < d; ++j) {
+                    lo[j] = min(lo[j], _base[i * d + j]);
+                    hi[j] = max(hi[j], _base[i * d + j]);
+                }
+            }
+            outTrainTime = secondsSince(start);
+            start = Clock::now();
+            float levels = float((1u << enc.bits) - 1);
+            for (size_t i = 0; i < _baseCount; ++i) {
+                for (size_t j = 0; j < d; ++j) {
+                    float step = (hi[j] - lo[j]) / levels;
+                    float &x = result[i * d + j];
+                    x = (step > 0) ? lo[j] + roundf((x - lo[j]) / step) * step : lo[j];
+                }
+            }
+            outEncodeTime = secondsSince(start);
+        } else if (enc.type == kC4VectorEncodingPQ) {
+            // Each subvector is replaced by the nearest of 2^bits centroids for its subspace:
+            const size_t m = enc.pq_subquantizers, sub = d / m, codes = size_t(1) << enc.bits;
+            for (size_t s = 0; s < m; ++s) {
+                auto start = Clock::now();
+                auto centroids = kmeans(&_base[s * sub], min(_baseCount, kPQTrainingSize), d, sub,
+                                        codes, kPQIterations);
+                outTrainTime += secondsSince(start);
+                start = Clock::now();
+                size_t k = centroids.size() / sub;
+                for (size_t i = 0; i < _baseCount; ++i) {
+                    float *subvector = &result[i * d + s * sub];
+                    size_t best = 0;
+                    float bestDistance = INFINITY;
+                    for (size_t c = 0; c < k; ++c) {
+                        float dist = VectorL2Squared(subvector, &centroids[c * sub], sub);
+                        if (dist < bestDistance) {
+                            bestDistance = dist;
+                            best = c;
+                        }
+                    }
+                    memcpy(subvector, &centroids[best * sub], sub * sizeof(float));
+                }
+                outEncodeTime += secondsSince(start);
+            }
+        }
+        return result;
+    }
+
+
+    // The mean recall@k of the queries, searching the nearest `probes` lists of encoded vectors.
+    double VectorIndexAdvisor::recall(const vector<float> &encoded,
+                                      const vector<vector<uint32_t>> &lists,
+                                      const vector<vector<uint32_t>> &queryOrder,
+                                      size_t probes) const
+    {
+        double total = 0;
+        vector<pair<float, uint32_t>> found;
+        for (size_t q = 0; q < _queryCount; ++q) {
+            const float *query = &_queries[q * _dimensions];
+            found.clear();
+            for (size_t p = 0; p < probes; ++p) {
+                for (uint32_t i : lists[queryOrder[q][p]])
+                    found.emplace_back(distance(query, &encoded[i * _dimensions]), i);
+            }
+            size_t k = min(found.size(), _nearest[q].size());
+            partial_sort(found.begin(), found.begin() + k, found.end());
+            size_t hits = 0;
+            for (size_t i = 0; i < k; ++i) {
+                if (find(_nearest[q].begin(), _nearest[q].end(), found[i].second) != _nearest[q].end())
+                    ++hits;
+            }
+            total += double(hits) / _nearest[q].size();
+        }
+        return total / _queryCount;
+    }
+
+
+    vector<VectorIndexAdvisor::Candidate> VectorIndexAdvisor::evaluate() {
+        const size_t d = _dimensions;
+        const uint64_t n = _totalCount;
+
+        // Centroids: the recommended square root of the number of vectors, and half and twice that:
+        unsigned recommended = clamp<unsigned>(unsigned(lround(sqrt(double(n)))), 1, kMaxCentroids);
+        vector<unsigned> centroidCounts {max(1u, recommended / 2), recommended,
+                                         min(kMaxCentroids, recommended * 2)};
+        centroidCounts.erase(unique(centroidCounts.begin(), centroidCounts.end()), centroidCounts.end());
+
+        // Encodings: none, the scalar quantizers, and product quantizers of 2, 4 and 8 dimensions
+        // per byte:
+        vector<C4VectorEncoding> encodings;
+        encodings.push_back({kC4VectorEncodingNone});
+        for (unsigned bits : {8u, 6u, 4u}) {
+            C4VectorEncoding enc {kC4VectorEncodingSQ};
+            enc.bits = bits;
+            encodings.push_back(enc);
+        }
+        for (unsigned sub : {2u, 4u, 8u}) {
+            if (d % sub == 0 && d / sub >= 2) {
+                C4VectorEncoding enc {kC4VectorEncodingPQ};
+                enc.pq_subquantizers = unsigned(d / sub);
+                enc.bits = kPQBits;
+                encodings.push_back(enc);
+            }
+        }
+
+        struct Encoded {
+            vector<float>   vectors;
+            double          trainTime, encodeTime;
+        };
+        vector<Encoded> encoded;
+        for (auto &enc : encodings) {
+            Encoded e;
+            e.vectors = encode(enc, e.trainTime, e.encodeTime);
+            encoded.push_back(std::move(e));
+        }
+
+        vector<Candidate> candidates;
+        for (unsigned centroids : centroidCounts) {
+            // Simulate with as many vectors per centroid as the full index would have:
+            size_t sampleCentroids = centroids;
+            if (n > _baseCount)
+                sampleCentroids = size_t(max(1l, lround(double(centroids) * _baseCount / n)));
+            sampleCentroids = min(sampleCentroids, _baseCount);
+
+            auto start = Clock::now();
+            auto centers = kmeans(_base.data(), _baseCount, d, d, sampleCentroids, kKMeansIterations);
+            double trainTime = secondsSince(start);
+            sampleCentroids = centers.size() / d;
+
+            start = Clock::now();
+            vector<vector<uint32_t>> lists(sampleCentroids);
+            for (size_t i = 0; i < _baseCount; ++i) {
+                size_t best = 0;
+                float bestDistance = INFINITY;
+                for (size_t c = 0; c < sampleCentroids; ++c) {
+                    float dist = distance(&_base[i * d], &centers[c * d]);
+                    if (dist < bestDistance) {
+                        bestDistance = dist;
+                        best = c;
+                    }
+                }
+                lists[best].push_back(uint32_t(i));
+            }
+            double assignTime = secondsSince(start);
+
+            vector<vector<uint32_t>> queryOrder(_queryCount);
+            for (size_t q = 0; q < _queryCount; ++q) {
+                vector<pair<float, uint32_t>> order(sampleCentroids);
+                for (size_t c = 0; c < sampleCentroids; ++c)
+                    order[c] = {distance(&_queries[q * d], &centers[c * d]), uint32_t(c)};
+                sort(order.begin(), order.end());
+                for (auto &o : order)
+                    queryOrder[q].push_back(o.second);
+            }
+
+            // Scale the sample's timings up to the full index:
+            uint64_t trainingSize = min(n, kTrainingPerCentroid * centroids);
+            double scale = double(n) / _baseCount;
+            double centroidScale = double(centroids) / sampleCentroids;
+            double coarseTime = trainTime * (double(trainingSize) / _baseCount) * centroidScale
+                              + assignTime * scale * centroidScale;
+
+            for (size_t e = 0; e < encodings.size(); ++e) {
+                auto &enc = encodings[e];
+                uint64_t tables = 0;
+                if (enc.type == kC4VectorEncodingSQ)
+                    tables = 2 * d * sizeof(float);
+                else if (enc.type == kC4VectorEncodingPQ)
+                    tables = (uint64_t(1) << enc.bits) * d * sizeof(float);
+                uint64_t memory = n * (codeSize(enc, _dimensions) + kRowOverhead)
+                                + uint64_t(centroids) * d * sizeof(float) + tables;
+                size_t quantizerSampleSize = (enc.type == kC4VectorEncodingPQ)
+                                             ? min(_baseCount, kPQTrainingSize) : _baseCount;
+                double buildTime = coarseTime
+                                 + encoded[e].trainTime * double(trainingSize) / quantizerSampleSize
+                                 + encoded[e].encodeTime * scale;
+
+                // Probes: powers of two up to all of the sample's centroids, and the same share
+                // of the full index's centroids:
+                for (size_t sampleProbes = 1; ; sampleProbes = min(sampleProbes * 2, sampleCentroids)) {
+                    Candidate candidate {};
+                    candidate.centroids = centroids;
+                    candidate.encoding = enc;
+                    candidate.numProbes = clamp<unsigned>(unsigned(lround(double(sampleProbes) * centroids
+                                                                          / sampleCentroids)),
+                                                          1, centroids);
+                    candidate.estimate.recall = recall(encoded[e].vectors, lists, queryOrder, sampleProbes);
+                    candidate.estimate.memory = memory;
+                    candidate.estimate.buildTime = buildTime;
+                    candidate.estimate.sampleSize = unsigned(_baseCount + _queryCount);
+                    candidate.queryCost = double(centroids) * d * sizeof(float)
+                                        + double(candidate.numProbes) * n / centroids * codeSize(enc, _dimensions);
+                    candidates.push_back(candidate);
+                    if (sampleProbes >= sampleCentroids)
+                        break;
+                }
+            }
+        }
+        return candidates;
+    }
+
+
+    const VectorIndexAdvisor::Candidate& VectorIndexAdvisor::choose(const vector<Candidate> &candidates,
+                                                                    double targetRecall,
+                                                                    uint64_t memoryBudget,
+                                                                    bool &outMeetsTargets)
+    {
+        auto withinBudget = [&](const Candidate &c) {
+            return memoryBudget == 0 || c.estimate.memory <= memoryBudget;
+        };
+        const Candidate *best = nullptr;
+
+        // The fastest to query of those that meet both targets:
+        for (auto &c : candidates) {
+            if (withinBudget(c) && c.estimate.recall >= targetRecall) {
+                if (!best || c.queryCost < best->queryCost
+                          || (c.queryCost == best->queryCost && c.estimate.memory < best->estimate.memory))
+                    best = &c;
+            }
+        }
+        outMeetsTargets = (best != nullptr);
+        if (best)
+            return *best;
+
+        // Else the best recall within the budget:
+        for (auto &c : candidates) {
+            if (withinBudget(c)) {
+                if (!best || c.estimate.recall > best->estimate.recall
+                          || (c.estimate.recall == best->estimate.recall && c.queryCost < best->queryCost))
+                    best = &c;
+            }
+        }
+        if (best)
+            return *best;
+
+        // Else the smallest:
+        for (auto &c : candidates) {
+            if (!best || c.estimate.memory < best->estimate.memory)
+                best = &c;
+        }
+        return *best;
+    }
+
+
+    // Reads up to `sampleSize` vectors of the index's expression from the collection, chosen at
+    // random: the first rows in storage order are usually the oldest documents, which may not
+    // be distributed like the rest. (SQLite keeps only the top `sampleSize` rows while sorting,
+    // so this reads the collection once.)
+    static vector<float> sampleVectors(const CBLCollection *collection,
+                                       const CBLVectorIndexConfiguration &config,
+                                       unsigned sampleSize)
+    {
+        string limit = to_string(sampleSize), expression(slice(config.expression));
+        string name(collection->name()), scope(collection->scopeName());
+        string queryString;
+        if (config.expressionLanguage == kCBLJSONLanguage) {
+            queryString = "{\"WHAT\": [" + expression + "], \"FROM\": [{\"COLLECTION\": \"" + name
+                        + "\", \"SCOPE\": \"" + scope + "\"}], \"ORDER_BY\": [[\"RANDOM()\"]], \"LIMIT\": "
+                        + limit + "}";
+        } else {
+            queryString = "SELECT " + expression + " FROM `" + scope + "`.`" + name
+                        + "` ORDER BY RANDOM() LIMIT " + limit;
+        }
+        auto query = collection->database()->createQuery(config.expressionLanguage, slice(queryString), nullptr);
+        if (!query)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Invalid vector index expression.");
+
+        const size_t d = config.dimensions;
+        vector<float> sample;
+        auto results = query->execute();
+        while (results->next()) {
+            size_t pos = sample.size();
+            sample.resize(pos + d);
+            if (!ReadVector(results->column(0), unsigned(d), &sample[pos]))
+                sample.resize(pos);
+        }
+        return sample;
+    }
+
+
+    void AdviseVectorIndex(const CBLCollection *collection,
+                           CBLVectorIndexConfiguration &config,
+                           const CBLVectorIndexAdvisorOptions &options,
+                           CBLVectorIndexEstimate &outEstimate)
+    {
+        if (!config.expression.buf)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "expression is required.");
+        if (config.isLazy) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "A lazy index's expression doesn't return vectors to sample.");
+        }
+        if (config.dimensions < 2 || config.dimensions > 4096)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "dimensions must be >= 2 and <= 4096.");
+        if (options.targetRecall < 0 || options.targetRecall > 1)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "targetRecall must be >= 0 and <= 1.");
+
+        unsigned sampleSize = options.sampleSize ? options.sampleSize : kDefaultSampleSize;
+        auto sample = sampleVectors(collection, config, sampleSize);
+        size_t count = sample.size() / config.dimensions;
+        if (count <= kK) {
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter,
+                           "The collection has only %zu vectors of %u dimensions; more than %u are needed.",
+                           count, config.dimensions, kK);
+        }
+
+        auto metric = config.metric ? config.metric : kCBLDistanceMetricEuclidean;
+        VectorIndexAdvisor advisor(std::move(sample), config.dimensions, metric, collection->count());
+        auto candidates = advisor.evaluate();
+        bool meetsTargets;
+        auto &best = VectorIndexAdvisor::choose(candidates,
+                                                options.targetRecall > 0 ? options.targetRecall
+                                                                         : kDefaultTargetRecall,
+                                                options.memoryBudget, meetsTargets);
+
+        config.centroids = best.centroids;
+        config.numProbes = best.numProbes;
+        switch (best.encoding.type) {
+            case kC4VectorEncodingSQ:
+                config.encoding = new CBLVectorEncodingSQ(CBLScalarQuantizerType(best.encoding.bits));
+                break;
+            case kC4VectorEncodingPQ:
+                config.encoding = new CBLVectorEncodingPQ(best.encoding.pq_subquantizers, best.encoding.bits);
+                break;
+            default:
+                config.encoding = new CBLVectorEncodingNone();
+                break;
+        }
+        outEstimate = best.estimate;
+        outEstimate.meetsTargets = meetsTargets;
+    }
+
+}
+
+#endif
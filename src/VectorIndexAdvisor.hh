@@ -0,0 +1,93 @@
+//
+// VectorIndexAdvisor.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLQueryIndexTypes.h"
+#include "c4IndexTypes.h"
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#ifdef COUCHBASE_ENTERPRISE
+
+CBL_ASSUME_NONNULL_BEGIN
+
+struct CBLCollection;
+
+namespace cbl_internal {
+
+    /** Estimates the recall, size and build time of vector index configurations by simulating
+        them on a sample of vectors: each candidate's centroids are found by k-means, the vectors
+        are encoded and decoded with its encoding, and the sample's queries are searched through
+        its nearest centroids and compared with a brute-force search.
+        A sample smaller than the collection is simulated with proportionally fewer centroids and
+        probes, so that the lists searched hold the same share of the vectors. */
+    class VectorIndexAdvisor {
+    public:
+        struct Candidate {
+            unsigned                centroids;
+            C4VectorEncoding        encoding;
+            unsigned                numProbes;
+            CBLVectorIndexEstimate  estimate;
+            double                  queryCost;      // Bytes scanned per query
+        };
+
+        /** `sample` holds vectors of `dimensions` floats; `totalCount` is the number of vectors
+            the index will hold. A tenth of the sample, up to 100 vectors, is used as queries. */
+        VectorIndexAdvisor(std::vector<float> sample, unsigned dimensions,
+                           CBLDistanceMetric metric, uint64_t totalCount);
+
+        /** Simulates every candidate configuration. */
+        std::vector<Candidate> evaluate();
+
+        /** Picks the candidate to recommend, as described by \ref CBLCollection_AdviseVectorIndex. */
+        static const Candidate& choose(const std::vector<Candidate> &candidates,
+                                       double targetRecall, uint64_t memoryBudget,
+                                       bool &outMeetsTargets);
+
+    private:
+        float distance(const float *a, const float *b) const;
+        std::vector<float> kmeans(const float *data, size_t count, size_t stride,
+                                  size_t dimensions, size_t k, unsigned iterations);
+        std::vector<float> encode(const C4VectorEncoding&, double &outTrainTime, double &outEncodeTime);
+        double recall(const std::vector<float> &encoded,
+                      const std::vector<std::vector<uint32_t>> &lists,
+                      const std::vector<std::vector<uint32_t>> &queryOrder,
+                      size_t probes) const;
+
+        unsigned const                          _dimensions;
+        CBLDistanceMetric const                 _metric;
+        uint64_t                                _totalCount;
+        std::vector<float>                      _base, _queries;
+        size_t                                  _baseCount, _queryCount;
+        std::vector<std::vector<uint32_t>>      _nearest;       // Brute-force results per query
+        std::mt19937                            _random {12345};
+    };
+
+
+    /** Implements \ref CBLCollection_AdviseVectorIndex. */
+    void AdviseVectorIndex(const CBLCollection *collection,
+                           CBLVectorIndexConfiguration &config,
+                           const CBLVectorIndexAdvisorOptions &options,
+                           CBLVectorIndexEstimate &outEstimate);
+
+}
+
+CBL_ASSUME_NONNULL_END
+
+#endif
@@ -0,0 +1,327 @@
+//
+// VectorSearch.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "VectorSearch.hh"
+
+#ifdef COUCHBASE_ENTERPRISE
+
+#include "CBLCollection_Internal.hh"
+#include "CBLQuery_Internal.hh"
+#include "Internal.hh"
+#include "VectorDistance.hh"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+namespace cbl_internal {
+
+    static constexpr uint64_t kDefaultMaxScanCount  = 50000;
+    static constexpr unsigned kMaxIndexedLimit      = 10000;    // APPROX_VECTOR_DISTANCE's LIMIT
+    static constexpr double   kOverFetch            = 1.5;      // Margin on a post-filter's fetch
+
+    using Nearest = vector<pair<float, alloc_slice>>;           // Distances and doc IDs
+
+
+    bool ReadVector(Value value, unsigned dimensions, float outVector[]) {
+        if (Array array = value.asArray(); array) {
+            if (array.count() != dimensions)
+                return false;
+            unsigned i = 0;
+            for (Array::iterator iter(array); iter; ++iter)
+                outVector[i++] = iter.value().asFloat();
+            return true;
+        }
+        // Base64 or binary little-endian floats:
+        alloc_slice data = value.asString() ? decodeBase64(value.asString())
+                                            : alloc_slice(value.asData());
+        if (data.size != dimensions * sizeof(float))
+            return false;
+        memcpy(outVector, data.buf, data.size);
+        return true;
+    }
+
+
+    static const char* metricName(CBLDistanceMetric metric) {
+        switch (metric) {
+            case kCBLDistanceMetricCosine:      return "COSINE";
+            case kCBLDistanceMetricEuclidean:   return "EUCLIDEAN";
+            case kCBLDistanceMetricDot:         return "DOT";
+            default:                            return "EUCLIDEAN_SQUARED";
+        }
+    }
+
+
+    // Builds a query of the collection, selecting `what` (a comma-separated list).
+    static string queryString(const CBLCollection *collection, const CBLVectorSearch &search,
+                              const string &what, const string &orderBy ="", unsigned limit =0)
+    {
+        string name(collection->name()), scope(collection->scopeName());
+        string where(slice(search.where));
+        string str;
+        if (search.expressionLanguage == kCBLJSONLanguage) {
+            str = "{\"WHAT\": [" + what + "], \"FROM\": [{\"COLLECTION\": \"" + name
+                + "\", \"SCOPE\": \"" + scope + "\"}]";
+            if (!where.empty())
+                str += ", \"WHERE\": " + where;
+            if (!orderBy.empty())
+                str += ", \"ORDER_BY\": [" + orderBy + "], \"LIMIT\": " + to_string(limit);
+            str += "}";
+        } else {
+            str = "SELECT " + what + " FROM `" + scope + "`.`" + name + "`";
+            if (!where.empty())
+                str += " WHERE " + where;
+            if (!orderBy.empty())
+                str += " ORDER BY " + orderBy + " LIMIT " + to_string(limit);
+        }
+        return str;
+    }
+
+
+    // The doc ID and `expression`, as a query's WHAT.
+    static string idAnd(const CBLVectorSearch &search, const string &expression) {
+        if (search.expressionLanguage == kCBLJSONLanguage)
+            return "[\"._id\"], " + expression;
+        return "META().id, " + expression;
+    }
+
+
+    static Retained<CBLQuery> createQuery(const CBLCollection *collection,
+                                          const CBLVectorSearch &search, const string &str)
+    {
+        auto query = collection->database()->createQuery(search.expressionLanguage, slice(str), nullptr);
+        if (!query)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidQuery, "Invalid vector search expression or condition.");
+        return query;
+    }
+
+
+    // The number of documents matching the search's condition. Counting only evaluates the
+    // condition, which is much cheaper than computing distances, and can use a value index.
+    static uint64_t countMatches(const CBLCollection *collection, const CBLVectorSearch &search) {
+        string what = (search.expressionLanguage == kCBLJSONLanguage) ? "[\"COUNT()\", [\".\"]]"
+                                                                      : "COUNT(*)";
+        auto results = createQuery(collection, search, queryString(collection, search, what))->execute();
+        return results->next() ? results->column(0).asUnsigned() : 0;
+    }
+
+
+    // Computes the distance of every matching document, keeping the nearest. The condition is
+    // evaluated as the documents are scanned, so only the matching ones' vectors are read.
+    static void scan(const CBLCollection *collection, const CBLVectorSearch &search,
+                     const float target[], unsigned dimensions, Nearest &outNearest)
+    {
+        string expression(slice(search.expression));
+        auto query = createQuery(collection, search,
+                                 queryString(collection, search, idAnd(search, expression)));
+
+        // A max-heap of the nearest so far, so the farthest of them is on top:
+        priority_queue<pair<float, alloc_slice>> nearest;
+        vector<float> v(dimensions);
+        auto results = query->execute();
+        while (results->next()) {
+            if (!ReadVector(results->column(1), dimensions, v.data()))
+                continue;
+            float distance = VectorDistance(search.metric, target, v.data(), dimensions);
+            if (nearest.size() < search.limit) {
+                nearest.emplace(distance, alloc_slice(results->column(0).asString()));
+            } else if (distance < nearest.top().first) {
+                nearest.pop();
+                nearest.emplace(distance, alloc_slice(results->column(0).asString()));
+            }
+        }
+
+        outNearest.resize(nearest.size());
+        for (size_t i = nearest.size(); i > 0; --i) {
+            outNearest[i - 1] = nearest.top();
+            nearest.pop();
+        }
+    }
+
+
+    // Compiles an APPROX_VECTOR_DISTANCE query returning `fetch` rows, which the condition is
+    // applied to afterwards. Returns null if there's no vector index to use.
+    static Retained<CBLQuery> indexQuery(const CBLCollection *collection,
+                                         const CBLVectorSearch &search, unsigned fetch)
+    {
+        string expression(slice(search.expression)), distance;
+        if (search.expressionLanguage == kCBLJSONLanguage) {
+            distance = "[\"APPROX_VECTOR_DISTANCE()\", " + expression + ", [\"$target\"], \""
+                     + metricName(search.metric) + "\"]";
+        } else {
+            distance = "APPROX_VECTOR_DISTANCE(" + expression + ", $target, \""
+                     + metricName(search.metric) + "\")";
+        }
+        try {
+            return createQuery(collection, search,
+                               queryString(collection, search, idAnd(search, distance), distance, fetch));
+        } catch (...) {
+            C4Error error = C4Error::fromCurrentException();
+            if (error.domain == LiteCoreDomain && error.code == kC4ErrorMissingIndex)
+                return nullptr;
+            throw;
+        }
+    }
+
+
+    static void searchIndex(CBLQuery *query, const float target[], unsigned dimensions,
+                            unsigned limit, Nearest &outNearest)
+    {
+        MutableArray targetArray = MutableArray::newArray();
+        for (unsigned i = 0; i < dimensions; ++i)
+            targetArray.append(target[i]);
+        MutableDict params = MutableDict::newDict();
+        params["target"] = targetArray;
+        query->setParameters(params);
+
+        auto results = query->execute();
+        while (outNearest.size() < limit && results->next())
+            outNearest.emplace_back(results->column(1).asFloat(),
+                                    alloc_slice(results->column(0).asString()));
+    }
+
+
+#pragma mark - PLANNER:
+
+
+    // How a search will run.
+    struct VectorSearchPlan {
+        uint64_t            total;          // Documents in the collection
+        uint64_t            candidates;     // Documents matching the condition, if `counted`
+        bool                counted {false};
+        unsigned            fetch {0};      // Rows the index query fetches before filtering
+        Retained<CBLQuery>  query;          // The index query, or null to scan
+
+        double selectivity() const {return total ? double(candidates) / total : 1.0;}
+    };
+
+
+    static void checkSearch(const CBLVectorSearch &search) {
+        if (!search.expression.buf)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "expression is required.");
+        if (search.limit < 1)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "limit must be >= 1.");
+    }
+
+
+    // Chooses between scanning the matching documents, filtering before computing distances
+    // (pre-filtering), and querying a vector index then filtering its results (post-filtering).
+    // A post-filtered query fetches enough rows that, at the condition's selectivity, `limit`
+    // of them should match; when that's more than an index query can return, or there's no
+    // index, the search pre-filters.
+    // The matching documents are only counted when that decides the plan, since counting reads
+    // them all; the collection's size rules out an index whenever it's small enough to scan.
+    static VectorSearchPlan planSearch(const CBLCollection *collection, const CBLVectorSearch &search) {
+        checkSearch(search);
+        uint64_t maxScanCount = search.maxScanCount ? search.maxScanCount : kDefaultMaxScanCount;
+
+        VectorSearchPlan plan;
+        plan.total = plan.candidates = collection->count();
+        plan.counted = !search.where.buf;
+        if (plan.total <= maxScanCount || plan.total == 0)
+            return plan;
+
+        // There's no point counting without an index to use:
+        Retained<CBLQuery> probe = indexQuery(collection, search, search.limit);
+        if (!probe)
+            return plan;
+        if (search.where.buf) {
+            plan.candidates = countMatches(collection, search);
+            plan.counted = true;
+            if (plan.candidates <= maxScanCount || plan.candidates == 0)
+                return plan;
+        }
+
+        double fetch = search.where.buf ? ceil(search.limit / plan.selectivity() * kOverFetch)
+                                        : search.limit;
+        if (fetch > kMaxIndexedLimit)
+            return plan;
+        plan.fetch = unsigned(fetch);
+        plan.query = (plan.fetch == search.limit) ? probe : indexQuery(collection, search, plan.fetch);
+        return plan;
+    }
+
+
+    MutableArray FindNearestVectors(const CBLCollection *collection, const CBLVectorSearch &search,
+                                    const float target[], unsigned dimensions)
+    {
+        if (dimensions < 2 || dimensions > 4096)
+            C4Error::raise(LiteCoreDomain, kC4ErrorInvalidParameter, "dimensions must be >= 2 and <= 4096.");
+        VectorSearchPlan plan = planSearch(collection, search);
+
+        Nearest nearest;
+        if (plan.query) {
+            searchIndex(plan.query, target, dimensions, search.limit, nearest);
+            // If the condition matched fewer rows than expected, pre-filter after all, rather
+            // than returning too few:
+            if (search.where.buf && nearest.size() < search.limit) {
+                nearest.clear();
+                plan.query = nullptr;
+            }
+        }
+        if (!plan.query)
+            scan(collection, search, target, dimensions, nearest);
+
+        auto result = FLMutableArray_New();
+        for (auto &[distance, docID] : nearest) {
+            auto item = FLMutableDict_New();
+            FLMutableDict_SetString(item, "id"_sl, docID);
+            FLMutableDict_SetFloat(item, "distance"_sl, distance);
+            FLMutableArray_AppendDict(result, item);
+            FLMutableDict_Release(item);
+        }
+        return result;
+    }
+
+
+    alloc_slice ExplainVectorSearch(const CBLCollection *collection, const CBLVectorSearch &search) {
+        VectorSearchPlan plan = planSearch(collection, search);
+        if (!plan.counted) {
+            plan.candidates = countMatches(collection, search);     // Only explaining needs it
+            plan.counted = true;
+        }
+        char selectivity[32];
+        snprintf(selectivity, sizeof(selectivity), "%.3g", plan.selectivity());
+        string str;
+        if (plan.query) {
+            str = "vector index";
+            if (search.where.buf)
+                str += ", post-filter: fetch " + to_string(plan.fetch) + " of "
+                     + to_string(plan.total) + " documents (selectivity " + selectivity + ")";
+            else
+                str += ": fetch " + to_string(plan.fetch) + " of " + to_string(plan.total) + " documents";
+        } else {
+            str = "exact scan";
+            if (search.where.buf)
+                str += ", pre-filter: " + to_string(plan.candidates) + " of "
+                     + to_string(plan.total) + " documents (selectivity " + selectivity + ")";
+            else
+                str += ": " + to_string(plan.total) + " documents";
+        }
+        return alloc_slice(str);
+    }
+
+}
+
+#endif
@@ -0,0 +1,48 @@
+//
+// VectorSearch.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include "CBLQueryIndexTypes.h"
+#include "fleece/Mutable.hh"
+
+#ifdef COUCHBASE_ENTERPRISE
+
+CBL_ASSUME_NONNULL_BEGIN
+
+struct CBLCollection;
+
+namespace cbl_internal {
+
+    /** Reads a vector of `dimensions` floats, stored as a vector index expects: an array of
+        numbers, or little-endian floats as data or in Base64. Returns false if it isn't one. */
+    bool ReadVector(fleece::Value value, unsigned dimensions, float outVector[]);
+
+    /** Implements \ref CBLCollection_FindNearestVectors. */
+    fleece::MutableArray FindNearestVectors(const CBLCollection *collection,
+                                            const CBLVectorSearch &search,
+                                            const float target[], unsigned dimensions);
+
+    /** Implements \ref CBLCollection_ExplainVectorSearch. */
+    fleece::alloc_slice ExplainVectorSearch(const CBLCollection *collection,
+                                            const CBLVectorSearch &search);
+
+}
+
+CBL_ASSUME_NONNULL_END
+
+#endif
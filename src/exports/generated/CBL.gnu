@@ -4,7 +4,13 @@ CBL_C {
 		CBL_Release;
 		CBL_InstanceCount;
 		CBL_DumpInstances;
+		CBL_GetMemoryStats;
+		CBL_SetMemoryTracking;
+		CBL_DumpTrackedObjects;
 		CBL_Now;
+		CBL_ConfigureThreadPool;
+		CBL_RunBackgroundMaintenance;
+		CBL_CancelBackgroundMaintenance;
 		CBLError_Message;
 		CBLListener_Remove;
 		kCBLTypeProperty;
@@ -21,6 +27,9 @@ CBL_C {
 		CBLBlob_Equals;
 		CBLBlob_Properties;
 		CBLBlob_Content;
+		CBLBlob_MapContent;
+		CBLBlobMapping_Content;
+		CBLBlobMapping_IsMapped;
 		CBLBlob_OpenContentStream;
 		CBLBlob_CreateJSON;
 		CBLBlob_CreateWithData;
@@ -29,9 +38,12 @@ CBL_C {
 		CBLBlobReader_Position;
 		CBLBlobReader_Seek;
 		CBLBlobReader_Close;
+		CBLBlobReader_SetReadahead;
+		CBLBlobReader_ReadV;
 		CBLBlobWriter_Create;
 		CBLBlobWriter_Close;
 		CBLBlobWriter_Write;
+		CBLBlobWriter_WriteAt;
 		CBLDatabase_GetBlob;
 		CBLDatabase_SaveBlob;
 		CBLDatabaseConfiguration_Default;
@@ -46,13 +58,27 @@ CBL_C {
 		CBLDatabase_Config;
 		CBLDatabase_Count;
 		CBLDatabase_Delete;
+		CBLDatabase_AcquireReader;
 		CBLDatabase_BeginTransaction;
 		CBLDatabase_EndTransaction;
 		CBLDatabase_PerformMaintenance;
+		CBLDatabase_CreateMaintenanceTask;
+		CBLMaintenanceTask_Run;
+		CBLMaintenanceTask_Progress;
+		CBLDatabase_EnableBackgroundMaintenance;
+		CBLDatabase_DisableBackgroundMaintenance;
+		CBLDatabase_GetStorageStats;
+		CBLDatabase_Export;
+		CBLDatabase_ExportToFile;
+		CBLDatabase_Prewarm;
+		CBLDatabase_TrimMemory;
+		CBL_TrimMemory;
 		CBLDatabase_AddChangeListener;
 		CBLDatabase_AddDocumentChangeListener;
 		CBLDatabase_BufferNotifications;
 		CBLDatabase_SendNotifications;
+		CBLDatabase_SetNotificationExecutor;
+		CBLNotificationWorkItem_Run;
 		CBLDatabase_CreateValueIndex;
 		CBLDatabase_CreateFullTextIndex;
 		CBLDatabase_DeleteIndex;
@@ -70,24 +96,56 @@ CBL_C {
 		CBLCollection_Name;
 		CBLCollection_FullName;
 		CBLCollection_Database;
+		CBLCollection_AcquireReader;
 		CBLCollection_Count;
 		CBLCollection_GetDocument;
 		CBLCollection_SaveDocument;
 		CBLCollection_SaveDocumentWithConcurrencyControl;
 		CBLCollection_SaveDocumentWithConflictHandler;
+		CBLCollection_SaveDocuments;
+		CBLCollection_SaveJSON;
+		CBLCollection_ImportJSONLines;
 		CBLCollection_DeleteDocument;
 		CBLCollection_DeleteDocumentWithConcurrencyControl;
+		CBLCollection_SaveDocumentAsync;
+		CBLCollection_DeleteDocumentAsync;
 		CBLCollection_PurgeDocument;
 		CBLCollection_PurgeDocumentByID;
 		CBLCollection_GetDocumentExpiration;
 		CBLCollection_SetDocumentExpiration;
+		CBLCollection_PurgeDocuments;
+		CBLCollection_DeleteDocuments;
+		CBLCollection_SetDocumentExpirations;
+		CBLCollection_AppendDocuments;
+		CBLCollection_PurgeDocumentsWithPrefix;
+		CBLCollection_StartExpirationSweeper;
+		CBLExpirationSweeper_Scan;
+		CBLExpirationSweeper_Backlog;
+		CBLExpirationSweeper_Stop;
+		CBLCollection_CreateAggregateView;
+		CBLAggregateView_Results;
+		CBLAggregateView_AddChangeListener;
+		CBLCollection_GetDocuments;
 		CBLCollection_GetMutableDocument;
 		CBLCollection_AddChangeListener;
+		CBLCollection_AddChangeBatchListener;
+		CBLCollection_ChangesSince;
+		CBLChangeFeedBatch_Count;
+		CBLChangeFeedBatch_Entry;
+		CBLChangeFeedBatch_LastSequence;
 		CBLCollection_AddDocumentChangeListener;
 		CBLCollection_CreateArrayIndex;
 		CBLCollection_CreateValueIndex;
 		CBLCollection_CreateFullTextIndex;
 		CBLCollection_DeleteIndex;
+		CBLCollection_SuspendIndexes;
+		CBLCollection_ResumeIndexes;
+		CBLCollection_CreateValueIndexAsync;
+		CBLCollection_CreateFullTextIndexAsync;
+		CBLCollection_CreateArrayIndexAsync;
+		CBLIndexBuild_IndexName;
+		CBLIndexBuild_State;
+		CBLIndexBuild_Cancel;
 		CBLCollection_GetIndex;
 		CBLCollection_GetIndexNames;
 		CBLCollection_GetIndexesInfo;
@@ -104,6 +162,7 @@ CBL_C {
 		CBLDocument_Create;
 		CBLDocument_CreateWithID;
 		CBLDocument_MutableCopy;
+		CBLDocument_ReleaseAll;
 		CBLDocument_Properties;
 		CBLDocument_MutableProperties;
 		CBLDocument_SetProperties;
@@ -120,36 +179,95 @@ CBL_C {
 		CBLDatabase_PurgeDocumentByID;
 		CBLDatabase_GetDocumentExpiration;
 		CBLDatabase_SetDocumentExpiration;
+		kCBLCounterType;
+		kCBLORSetType;
+		FLDict_IsCounter;
+		FLDict_GetCounterValue;
+		FLMutableDict_IncrementCounter;
+		FLDict_IsORSet;
+		FLDict_ORSetContains;
+		FLDict_GetORSetMembers;
+		FLMutableDict_AddToORSet;
+		FLMutableDict_RemoveFromORSet;
 		CBL_Log;
 		CBL_LogMessage;
 		CBLLog_Callback;
 		CBLLog_SetCallback;
 		CBLLog_CallbackLevel;
 		CBLLog_SetCallbackLevel;
+		CBLLog_StructuredCallback;
+		CBLLog_SetStructuredCallback;
 		CBLLog_ConsoleLevel;
 		CBLLog_SetConsoleLevel;
 		CBLLog_FileConfig;
 		CBLLog_SetFileConfig;
+		CBLLog_DomainLevel;
+		CBLLog_SetDomainLevel;
+		CBLLog_SetDomainThrottle;
+		CBLLog_ThrottledMessageCount;
+		CBLLog_SetAsync;
+		CBLLog_Flush;
+		CBLLog_DroppedMessageCount;
+		CBL_SetTraceCallback;
 		CBLDatabase_CreateQuery;
+		CBLDatabase_QueryCacheStats;
 		CBLQuery_Parameters;
 		CBLQuery_SetParameters;
+		CBLQuery_SetParamInt64;
+		CBLQuery_SetParamDouble;
+		CBLQuery_SetParamString;
+		CBLQuery_SetParamBool;
+		CBLQuery_SetParamValue;
+		CBLQuery_SetParamVector;
+		CBLQuery_SetResultCacheSize;
+		CBLQuery_ResultCacheStats;
 		CBLQuery_Execute;
+		CBLQuery_ExecuteToJSON;
+		CBLQuery_ExecuteAsync;
+		CBLQuery_SetAsyncExecutor;
+		CBLQuery_ExecuteWithStats;
+		CBLQuery_SetStatsSampler;
+		CBLResultSet_GetStats;
+		CBLQueryExecution_Cancel;
 		CBLQuery_Explain;
 		CBLQuery_ColumnCount;
 		CBLQuery_ColumnName;
 		CBLQuery_AddChangeListener;
+		CBLQuery_AddChangeListenerWithOptions;
+		CBLQuery_CoalescedChangeCount;
 		CBLQuery_CopyCurrentResults;
+		CBLQuery_AddDiffListener;
 		CBLResultSet_Next;
+		CBLResultSet_NextBatch;
+		CBLResultSet_ReadColumnDoubles;
+		CBLResultSet_ReadColumnInt64s;
+		CBLResultSet_ReadColumnStrings;
 		CBLResultSet_ValueAtIndex;
 		CBLResultSet_ValueForKey;
 		CBLResultSet_ResultArray;
 		CBLResultSet_ResultDict;
+		CBLResultSet_SetReuseResults;
 		CBLResultSet_GetQuery;
+		CBLResultSet_CopyCursor;
+		CBLQuery_SetCursor;
+		CBLDatabase_QueryCollections;
+		CBLFullText_FindMatches;
+		CBLFullText_Snippet;
 		CBLQueryIndex_Collection;
 		CBLQueryIndex_Name;
+		CBLQueryIndex_Stats;
+		CBLDatabase_SetIndexUsageTracking;
 		kCBLAuthDefaultCookieName;
 		CBLEndpoint_CreateWithURL;
+		CBLEndpoint_CreateWithTransport;
 		CBLEndpoint_Free;
+		CBLTransport_Opened;
+		CBLTransport_Received;
+		CBLTransport_SendCompleted;
+		CBLTransport_CloseRequested;
+		CBLTransport_Closed;
+		CBLTransport_SetContext;
+		CBLTransport_GetContext;
 		CBLAuth_CreatePassword;
 		CBLAuth_CreateSession;
 		CBLAuth_Free;
@@ -160,13 +278,17 @@ CBL_C {
 		CBLReplicator_SetHostReachable;
 		CBLReplicator_SetSuspended;
 		CBLReplicator_Status;
+		CBLReplicator_GetMetrics;
 		CBLReplicator_PendingDocumentIDs;
 		CBLReplicator_PendingDocumentIDs2;
 		CBLReplicator_IsDocumentPending;
 		CBLReplicator_IsDocumentPending2;
+		CBLReplicator_ArePendingDocuments;
+		CBLReplicator_PullDocumentsNow;
 		CBLReplicator_AddChangeListener;
 		CBLReplicator_AddDocumentReplicationListener;
 		CBLReplicator_UserAgent;
+		CBLReplicator_OptionsJSON;
 		CBLDefaultConflictResolver;
 		CBLCollection_DeleteDocumentByID;
 		CBLCollection_LastSequence;
@@ -174,13 +296,23 @@ CBL_C {
 		CBLDatabase_LastSequence;
 		CBLDocument_CanonicalRevisionID;
 		CBLDocument_GetRevisionHistory;
+		CBLDocument_HeapAllocationCount;
 		CBLError_GetCaptureBacktraces;
 		CBLError_SetCaptureBacktraces;
 		CBLQuery_SetListenerCallbackDelay;
+		CBLResultSet_HeapAllocationCount;
+		CBL_SetLockTiming;
+		CBL_LockWaitStats;
+		CBL_GetLockStats;
+		CBL_DumpLockStats;
 		CBLLog_BeginExpectingExceptions;
 		CBLLog_EndExpectingExceptions;
 		kCBLDefaultDatabaseFullSync;
 		kCBLDefaultDatabaseMmapDisabled;
+		kCBLDefaultDatabaseQueryCacheSize;
+		kCBLDefaultAsyncWriteLimit;
+		kCBLDefaultImportBatchSize;
+		kCBLDefaultExportChunkSize;
 		kCBLDefaultLogFileUsePlaintext;
 		kCBLDefaultLogFileUsePlainText;
 		kCBLDefaultLogFileMaxSize;
@@ -195,6 +327,8 @@ CBL_C {
 		kCBLDefaultReplicatorMaxAttemptsWaitTime;
 		kCBLDefaultReplicatorDisableAutoPurge;
 		kCBLDefaultReplicatorAcceptParentCookies;
+		kCBLDefaultReplicatorMaxConcurrentConflictResolvers;
+		kCBLDefaultReplicatorConflictResolverBatchSize;
 		kFLNullValue;
 		kFLUndefinedValue;
 		kFLEmptyArray;
@@ -0,0 +1,200 @@
+//
+// AllocationCounter.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "AllocationCounter.hh"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#if defined(__has_feature)
+#   if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer) || __has_feature(memory_sanitizer)
+#       define CBL_TEST_SANITIZED
+#   endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#   define CBL_TEST_SANITIZED
+#endif
+
+#if !defined(_WIN32) && !defined(CBL_TEST_SANITIZED)
+#   define CBL_TEST_COUNT_ALLOCATIONS
+#   if defined(__GLIBC__)
+#       define CBL_TEST_COUNT_MALLOC
+#   endif
+#endif
+
+
+// Every allocation on a thread increments its counter; AllocationCounter just compares values.
+static thread_local uint64_t tAllocations = 0;
+
+
+AllocationCounter::AllocationCounter()
+:_start(tAllocations)
+{ }
+
+AllocationCounter::~AllocationCounter() = default;
+
+uint64_t AllocationCounter::count() const {
+    return (_stopped ? _end : tAllocations) - _start;
+}
+
+void AllocationCounter::stop() {
+    if (!_stopped) {
+        _end = tAllocations;
+        _stopped = true;
+    }
+}
+
+bool AllocationCounter::supported() {
+#ifdef CBL_TEST_COUNT_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool AllocationCounter::countsMalloc() {
+#ifdef CBL_TEST_COUNT_MALLOC
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+#ifdef CBL_TEST_COUNT_MALLOC
+
+// glibc lets the executable interpose malloc for the whole process, shared libraries included;
+// its own implementations remain available under these names. The whole family is replaced, so
+// that every block is allocated and freed by the same implementation.
+extern "C" {
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void* __libc_valloc(size_t);
+    void* __libc_pvalloc(size_t);
+    void  __libc_free(void*);
+
+    void* malloc(size_t size) {
+        ++tAllocations;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) {
+        ++tAllocations;
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* block, size_t size) {
+        ++tAllocations;
+        return __libc_realloc(block, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) {
+        ++tAllocations;
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) {
+        ++tAllocations;
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** outBlock, size_t alignment, size_t size) {
+        if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+        ++tAllocations;
+        void* block = __libc_memalign(alignment, size);
+        if (!block)
+            return ENOMEM;
+        *outBlock = block;
+        return 0;
+    }
+
+    void* valloc(size_t size) {
+        ++tAllocations;
+        return __libc_valloc(size);
+    }
+
+    void* pvalloc(size_t size) {
+        ++tAllocations;
+        return __libc_pvalloc(size);
+    }
+
+    void free(void* block) {
+        __libc_free(block);
+    }
+}
+
+#endif
+
+
+#ifdef CBL_TEST_COUNT_ALLOCATIONS
+
+static void* countedNew(size_t size, bool nothrow) {
+#ifndef CBL_TEST_COUNT_MALLOC
+    ++tAllocations;                         // (else malloc counts it)
+#endif
+    void* block = malloc(size ? size : 1);
+    if (!block && !nothrow)
+        throw std::bad_alloc();
+    return block;
+}
+
+static void* countedAlignedNew(size_t size, std::align_val_t align, bool nothrow) {
+#ifndef CBL_TEST_COUNT_MALLOC
+    ++tAllocations;                         // (else posix_memalign counts it)
+#endif
+    void* block = nullptr;
+    size_t alignment = std::max(size_t(align), sizeof(void*));
+    if (posix_memalign(&block, alignment, size ? size : 1) != 0)
+        block = nullptr;
+    if (!block && !nothrow)
+        throw std::bad_alloc();
+    return block;
+}
+
+void* operator new(size_t size)                                  {return countedNew(size, false);}
+void* operator new[](size_t size)                                {return countedNew(size, false);}
+void* operator new(size_t size, const std::nothrow_t&) noexcept   {return countedNew(size, true);}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {return countedNew(size, true);}
+
+void* operator new(size_t size, std::align_val_t al)             {return countedAlignedNew(size, al, false);}
+void* operator new[](size_t size, std::align_val_t al)           {return countedAlignedNew(size, al, false);}
+void* operator new(size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return countedAlignedNew(size, al, true);
+}
+void* operator new[](size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+    return countedAlignedNew(size, al, true);
+}
+
+void operator delete(void* block) noexcept                                  {free(block);}
+void operator delete[](void* block) noexcept                                {free(block);}
+void operator delete(void* block, const std::nothrow_t&) noexcept           {free(block);}
+void operator delete[](void* block, const std::nothrow_t&) noexcept         {free(block);}
+void operator delete(void* block, size_t) noexcept                          {free(block);}
+void operator delete[](void* block, size_t) noexcept                        {free(block);}
+void operator delete(void* block, std::align_val_t) noexcept                {free(block);}
+void operator delete[](void* block, std::align_val_t) noexcept              {free(block);}
+void operator delete(void* block, size_t, std::align_val_t) noexcept        {free(block);}
+void operator delete[](void* block, size_t, std::align_val_t) noexcept      {free(block);}
+void operator delete(void* block, std::align_val_t, const std::nothrow_t&) noexcept   {free(block);}
+void operator delete[](void* block, std::align_val_t, const std::nothrow_t&) noexcept {free(block);}
+
+#endif
@@ -0,0 +1,56 @@
+//
+// AllocationCounter.hh
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+#include <cstdint>
+
+/** Counts the heap allocations made by the current thread while it's in scope: calls to
+    `operator new`, and on platforms where the test binary can interpose it, to `malloc`.
+    These are counted in the CBL library too, since the test binary's `operator new` replaces
+    the library's. That's why it's only linked into its own test binary, CBL_C_AllocationTests,
+    which is only built on Linux.
+    Scopes may nest; each counts everything allocated during its lifetime.
+
+    Don't use Catch assertions inside the scope, since they allocate; read `count()` after. */
+class AllocationCounter {
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+
+    /** The number of allocations so far. */
+    uint64_t count() const;
+
+    /** Stops counting; `count()` then stays the same. */
+    void stop();
+
+    /** False on platforms or builds where allocations can't be counted (Windows, where the
+        library has its own heap, and sanitizer builds, which replace the allocator themselves.)
+        Tests should skip their checks then, since every count is zero. */
+    static bool supported();
+
+    /** True if `malloc` calls are counted, not only `operator new`. */
+    static bool countsMalloc();
+
+    AllocationCounter(const AllocationCounter&) =delete;
+    AllocationCounter& operator=(const AllocationCounter&) =delete;
+
+private:
+    uint64_t _start;
+    uint64_t _end {0};
+    bool     _stopped {false};
+};
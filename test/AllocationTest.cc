@@ -0,0 +1,208 @@
+//
+// AllocationTest.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CBLTest.hh"
+#include "AllocationCounter.hh"
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+
+// Allocation budgets of hot paths. The paths that allocate nothing must stay that way; the
+// others may only go down. These include LiteCore's and SQLite's allocations, where `malloc`
+// is counted (see AllocationCounter::countsMalloc), so they're upper bounds for all platforms.
+static constexpr uint64_t kGetDocumentBudget = 24;     // CBLCollection_GetDocument + release
+static constexpr uint64_t kDispatchBudget = 8;         // Sending one collection change
+
+
+class AllocationTest : public CBLTest {
+public:
+    AllocationTest() {
+        if (!AllocationCounter::supported())
+            CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning,
+                    "Skipping allocation checks; allocations can't be counted on this platform");
+    }
+};
+
+
+TEST_CASE_METHOD(AllocationTest, "Allocation Counter", "[Allocation]") {
+    if (!AllocationCounter::supported())
+        return;
+    AllocationCounter outer;
+    uint64_t nNew, nNone, nOuter;
+    {
+        AllocationCounter inner;
+        auto p = make_unique<int>(17);
+        vector<int> v(100);
+        nNew = inner.count();
+    }
+    {
+        AllocationCounter inner;
+        int x = 17;
+        (void)x;
+        nNone = inner.count();
+    }
+    outer.stop();
+    nOuter = outer.count();
+    auto p = make_unique<int>(4);               // not counted, since outer stopped
+    CHECK(nNew == 2);
+    CHECK(nNone == 0);
+    CHECK(nOuter >= nNew);
+    CHECK(outer.count() == nOuter);
+}
+
+
+TEST_CASE_METHOD(AllocationTest, "Get Document Allocations", "[Allocation]") {
+    createDocWithJSON(defaultCollection, "doc1", R"({"name": "Bob", "age": 42})");
+    CBLError error {};
+    auto getDoc = [&] {
+        const CBLDocument* doc = CBLCollection_GetDocument(defaultCollection, "doc1"_sl, &error);
+        bool found = (doc != nullptr);
+        CBLDocument_Release(doc);
+        return found;
+    };
+    REQUIRE(getDoc());                          // warms up caches and pools
+
+    constexpr int kIterations = 100;
+    bool allFound = true;
+    AllocationCounter counter;
+    for (int i = 0; i < kIterations; ++i)
+        allFound = getDoc() && allFound;
+    counter.stop();
+    CHECK(allFound);
+    if (AllocationCounter::supported()) {
+        INFO("CBLCollection_GetDocument allocates " << counter.count() / kIterations << " times");
+        CHECK(counter.count() <= kGetDocumentBudget * kIterations);
+    }
+}
+
+
+TEST_CASE_METHOD(AllocationTest, "Document Property Read Allocations", "[Allocation]") {
+    createDocWithJSON(defaultCollection, "doc1",
+                      R"({"name": "Bob", "age": 42, "address": {"city": "Springfield"}, "tags": ["a", "b"]})");
+    CBLError error {};
+    const CBLDocument* doc = CBLCollection_GetDocument(defaultCollection, "doc1"_sl, &error);
+    REQUIRE(doc);
+    CBLDocument* mdoc = CBLCollection_GetMutableDocument(defaultCollection, "doc1"_sl, &error);
+    REQUIRE(mdoc);
+    CBLDocument_Properties(doc);                // the first access may create the Dict
+    CBLDocument_MutableProperties(mdoc);
+
+    // Reading properties, nested ones too, allocates nothing:
+    size_t total = 0;
+    AllocationCounter counter;
+    for (const CBLDocument* d : {doc, (const CBLDocument*)mdoc}) {
+        FLDict props = CBLDocument_Properties(d);
+        total += FLValue_AsString(FLDict_Get(props, "name"_sl)).size;
+        total += size_t(FLValue_AsInt(FLDict_Get(props, "age"_sl)));
+        FLDict address = FLValue_AsDict(FLDict_Get(props, "address"_sl));
+        total += FLValue_AsString(FLDict_Get(address, "city"_sl)).size;
+        FLArray tags = FLValue_AsArray(FLDict_Get(props, "tags"_sl));
+        for (uint32_t i = 0; i < FLArray_Count(tags); ++i)
+            total += FLValue_AsString(FLArray_Get(tags, i)).size;
+        total += CBLDocument_ID(d).size + CBLDocument_RevisionID(d).size;
+    }
+    counter.stop();
+    CHECK(total == 2 * (3 + 42 + 11 + 2 + 4 + CBLDocument_RevisionID(doc).size));
+    if (AllocationCounter::supported())
+        CHECK(counter.count() == 0);
+
+    CBLDocument_Release(mdoc);
+    CBLDocument_Release(doc);
+}
+
+
+TEST_CASE_METHOD(AllocationTest, "Result Set Row Allocations", "[Allocation]") {
+    for (int i = 0; i < 100; ++i)
+        createDocWithJSON(defaultCollection, "doc" + to_string(i),
+                          R"({"name": "Bob", "n": )" + to_string(i) + "}");
+    CBLError error {};
+    int errPos;
+    CBLQuery* query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                              "SELECT name, n FROM _ ORDER BY n"_sl, &errPos, &error);
+    REQUIRE(query);
+    CBLResultSet* rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+
+    // Reading the first row associates the result set with its data, and the first calls to
+    // ResultArray and ResultDict create the collections they then reuse:
+    REQUIRE(CBLResultSet_Next(rs));
+    CBLResultSet_ResultArray(rs);
+    CBLResultSet_ResultDict(rs);
+
+    // Then reading rows and columns, by index or name or as a collection, allocates nothing:
+    int64_t sum = 0;
+    int rows = 1;
+    AllocationCounter counter;
+    while (CBLResultSet_Next(rs)) {
+        ++rows;
+        sum += FLValue_AsInt(CBLResultSet_ValueAtIndex(rs, 1));
+        sum += FLValue_AsString(CBLResultSet_ValueForKey(rs, "name"_sl)).size;
+        sum += FLValue_AsInt(FLArray_Get(CBLResultSet_ResultArray(rs), 1));
+        sum += FLValue_AsString(FLDict_Get(CBLResultSet_ResultDict(rs), "name"_sl)).size;
+    }
+    counter.stop();
+    CHECK(rows == 100);
+    CHECK(sum == 2 * (99 * 100 / 2) + 2 * 3 * 99);
+    if (AllocationCounter::supported())
+        CHECK(counter.count() == 0);
+
+    CBLResultSet_Release(rs);
+    CBLQuery_Release(query);
+}
+
+
+TEST_CASE_METHOD(AllocationTest, "Listener Dispatch Allocations", "[Allocation]") {
+    static int sCalls;
+    sCalls = 0;
+    auto listener = [](void*, const CBLCollectionChange*) {++sCalls;};
+    CBLDatabase_BufferNotifications(db, [](void*, CBLDatabase*) { }, nullptr);
+
+    vector<CBLListenerToken*> tokens;
+    int saves = 0;
+    // Saves a document, then counts the allocations of sending the change to the listeners:
+    auto dispatch = [&] {
+        createDocWithJSON(defaultCollection, "doc" + to_string(++saves), "{}");
+        AllocationCounter counter;
+        CBLDatabase_SendNotifications(db);
+        counter.stop();
+        return counter.count();
+    };
+
+    tokens.push_back(CBLCollection_AddChangeListener(defaultCollection, listener, nullptr));
+    dispatch();                                 // warm up
+    uint64_t oneListener = dispatch();
+
+    for (int i = 0; i < 9; ++i)
+        tokens.push_back(CBLCollection_AddChangeListener(defaultCollection, listener, nullptr));
+    dispatch();                                 // builds the new snapshot of the listeners
+    uint64_t tenListeners = dispatch();
+
+    CHECK(sCalls == 2 + 20);
+    if (AllocationCounter::supported()) {
+        CHECK(oneListener <= kDispatchBudget);
+        // Calling more listeners costs no more allocations:
+        CHECK(tenListeners <= oneListener);
+    }
+
+    for (auto token : tokens)
+        CBLListener_Remove(token);
+    CBLDatabase_BufferNotifications(db, nullptr, nullptr);
+}
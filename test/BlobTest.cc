@@ -18,7 +18,11 @@
 
 #include "CBLTest.hh"
 #include "CBLPrivate.h"
+#include "Stopwatch.hh"
 #include <string>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using namespace fleece;
 using namespace std;
@@ -141,6 +145,170 @@ TEST_CASE_METHOD(BlobTest, "Create blob with stream", "[Blob]") {
     CBLDocument_Release(doc);
 }
 
+TEST_CASE_METHOD(BlobTest, "Read blob stream with readahead", "[Blob]") {
+    string content;
+    for (size_t i = 0; i < 20000; ++i)
+        content += char('a' + i % 26);
+    CBLError error;
+    CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, slice(content));
+    auto doc = CBLDocument_CreateWithID("doc1"_sl);
+    FLMutableDict_SetBlob(CBLDocument_MutableProperties(doc), "blob"_sl, blob);
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+
+    CBLBlobReadStream *in = CBLBlob_OpenContentStream(blob, &error);
+    REQUIRE(in);
+    CBLBlobReader_SetReadahead(in, 5000);   // Rounded up to 8KB
+
+    SECTION("Small reads and seeks") {
+        char buf[100];
+        for (int64_t pos : {0, 50, 4090, 8100, 8150, 100, 19950, 19990}) {
+            CHECK(CBLBlobReader_Seek(in, pos, kCBLSeekModeFromStart, &error) == pos);
+            size_t expected = std::min(size_t(100), content.size() - size_t(pos));
+            REQUIRE(CBLBlobReader_Read(in, buf, sizeof(buf), &error) == int(expected));
+            CHECK(memcmp(buf, &content[size_t(pos)], expected) == 0);
+            CHECK(CBLBlobReader_Position(in) == uint64_t(pos) + expected);
+        }
+        CHECK(CBLBlobReader_Read(in, buf, sizeof(buf), &error) == 0);
+    }
+
+    SECTION("Large read") {
+        vector<char> buf(content.size() + 10);
+        CHECK(CBLBlobReader_Seek(in, 10, kCBLSeekModeFromStart, &error) == 10);
+        REQUIRE(CBLBlobReader_Read(in, buf.data(), 100, &error) == 100);
+        REQUIRE(CBLBlobReader_Read(in, buf.data() + 100, buf.size() - 100, &error) == int(content.size() - 10 - 100));
+        CHECK(memcmp(buf.data(), &content[10], content.size() - 10) == 0);
+    }
+
+    SECTION("Vectored read") {
+        char buf1[30], buf2[500], buf3[40], buf4[10];
+        CBLBlobReadRange ranges[] = {
+            {15000, buf1, sizeof(buf1), 0},
+            {10, buf2, sizeof(buf2), 0},
+            {19980, buf3, sizeof(buf3), 0},     // Runs past EOF
+            {30000, buf4, sizeof(buf4), 0},     // Starts past EOF
+        };
+        CHECK(CBLBlobReader_ReadV(in, ranges, 4, &error) == 30 + 500 + 20);
+        CHECK(ranges[0].bytesRead == 30);
+        CHECK(memcmp(buf1, &content[15000], 30) == 0);
+        CHECK(ranges[1].bytesRead == 500);
+        CHECK(memcmp(buf2, &content[10], 500) == 0);
+        CHECK(ranges[2].bytesRead == 20);
+        CHECK(memcmp(buf3, &content[19980], 20) == 0);
+        CHECK(ranges[3].bytesRead == 0);
+        CHECK(CBLBlobReader_Position(in) == 0);
+    }
+
+    CBLBlobReader_Close(in);
+    CBLDocument_Release(doc);
+    CBLBlob_Release(blob);
+}
+
+
+TEST_CASE_METHOD(BlobTest, "Create blob with chunks from multiple threads", "[Blob]") {
+    static constexpr size_t kChunkSize = 1000, kChunkCount = 40, kThreadCount = 4;
+    string content;
+    for (size_t i = 0; i < kChunkSize * kChunkCount; ++i)
+        content += char('a' + i % 26);
+
+    CBLError error;
+    CBLBlobWriteStream* ws = CBLBlobWriter_Create(db, &error);
+    REQUIRE(ws);
+    // Each thread writes every kThreadCount'th chunk, last to first:
+    vector<thread> threads;
+    atomic<int> failures {0};
+    for (size_t t = 0; t < kThreadCount; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t c = kChunkCount - kThreadCount + t; c < kChunkCount; c -= kThreadCount) {
+                CBLError err;
+                if (!CBLBlobWriter_WriteAt(ws, c * kChunkSize, &content[c * kChunkSize], kChunkSize, &err))
+                    ++failures;
+            }
+        });
+    }
+    for (auto &th : threads)
+        th.join();
+    CHECK(failures == 0);
+
+    CBLBlob* blob = CBLBlob_CreateWithStream("text/plain"_sl, ws);
+    REQUIRE(blob);
+    CBLBlob* expected = CBLBlob_CreateWithData("text/plain"_sl, slice(content));
+    CHECK(slice(CBLBlob_Digest(blob)) == slice(CBLBlob_Digest(expected)));
+    CHECK(CBLBlob_Length(blob) == content.size());
+
+    auto doc = CBLDocument_CreateWithID("doc1"_sl);
+    FLMutableDict_SetBlob(CBLDocument_MutableProperties(doc), "blob"_sl, blob);
+    CHECK(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+    FLSliceResult gotContent = CBLBlob_Content(blob, &error);
+    CHECK(slice(gotContent) == slice(content));
+    FLSliceResult_Release(gotContent);
+
+    CBLDocument_Release(doc);
+    CBLBlob_Release(blob);
+    CBLBlob_Release(expected);
+}
+
+
+TEST_CASE_METHOD(BlobTest, "Write blob chunks with overlaps and gaps", "[Blob]") {
+    static constexpr slice kBlobContent = "This is the content of the blob.";
+    CBLError error;
+    CBLBlobWriteStream* ws = CBLBlobWriter_Create(db, &error);
+    REQUIRE(ws);
+    REQUIRE(CBLBlobWriter_WriteAt(ws, 20, &kBlobContent[20], 5, &error));
+    {
+        ExpectingExceptions x;
+        CHECK(!CBLBlobWriter_WriteAt(ws, 18, &kBlobContent[18], 5, &error));
+        CHECK(error.domain == kCBLDomain);
+        CHECK(error.code == kCBLErrorInvalidParameter);
+        CHECK(!CBLBlobWriter_WriteAt(ws, 22, &kBlobContent[22], 5, &error));
+        CHECK(error.code == kCBLErrorInvalidParameter);
+    }
+    REQUIRE(CBLBlobWriter_Write(ws, &kBlobContent[0], 10, &error));
+    {
+        // There's still a gap between 10 and 20:
+        ExpectingExceptions x;
+        CHECK(CBLBlob_CreateWithStream("text/plain"_sl, ws) == nullptr);
+    }
+    CBLBlobWriter_Close(ws);
+}
+
+
+TEST_CASE_METHOD(BlobTest, "Map blob content", "[Blob]") {
+    static constexpr slice kBlobContent = "This is the content of the mapped blob.";
+    CBLError error;
+    CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, kBlobContent);
+    REQUIRE(blob);
+
+    // Before it's saved, the content can only be copied:
+    CBLBlobMapping* mapping = CBLBlob_MapContent(blob, &error);
+    REQUIRE(mapping);
+    CHECK(!CBLBlobMapping_IsMapped(mapping));
+    CHECK(slice(CBLBlobMapping_Content(mapping)) == kBlobContent);
+    CBLBlobMapping_Release(mapping);
+
+    auto doc = CBLDocument_CreateWithID("doc1"_sl);
+    auto props = CBLDocument_MutableProperties(doc);
+    FLMutableDict_SetBlob(props, "blob"_sl, blob);
+    CHECK(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+    CBLBlob_Release(blob);
+    CBLDocument_Release(doc);
+
+    auto savedDoc = CBLCollection_GetDocument(defaultCollection, "doc1"_sl, &error);
+    REQUIRE(savedDoc);
+    auto savedBlob = FLDict_GetBlob(FLValue_AsDict(FLDict_Get(CBLDocument_Properties(savedDoc), "blob"_sl)));
+    REQUIRE(savedBlob);
+    mapping = CBLBlob_MapContent(savedBlob, &error);
+    REQUIRE(mapping);
+#ifndef _WIN32
+    CHECK(CBLBlobMapping_IsMapped(mapping));
+#endif
+    CBLDocument_Release(savedDoc);
+
+    // The mapping outlives the blob and its document:
+    CHECK(slice(CBLBlobMapping_Content(mapping)) == kBlobContent);
+    CBLBlobMapping_Release(mapping);
+}
+
+
 TEST_CASE_METHOD(BlobTest, "Create JSON from Blob", "[Blob]") {
     alloc_slice content1("This is the content of the blob 1.");
     CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, content1);
@@ -193,3 +361,37 @@ TEST_CASE_METHOD(BlobTest, "Check Is Blob", "[Blob]") {
     
     CBLDocument_Release(doc);
 }
+
+
+TEST_CASE_METHOD(BlobTest, "Benchmark Multi-Threaded Blob Creation", "[Blob][Perf][.slow]") {
+    constexpr unsigned kBlobsPerThread = 10000;
+    
+    for (unsigned numThreads : {1, 2, 4, 8, 16}) {
+        atomic<unsigned> notFound {0};
+        Stopwatch st;
+        vector<thread> threads;
+        for (unsigned t = 0; t < numThreads; ++t) {
+            threads.emplace_back([=, &notFound] {
+                for (unsigned i = 0; i < kBlobsPerThread; ++i) {
+                    string content = "Blob " + to_string(i) + " from thread " + to_string(t);
+                    CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, slice(content));
+                    // Look the blob up again from its properties, as when setting it in a doc:
+                    FLMutableDict props = FLDict_MutableCopy(CBLBlob_Properties(blob), kFLDefaultCopy);
+                    const CBLBlob* found = FLDict_GetBlob(props);
+                    if (found != blob)
+                        ++notFound;
+                    FLMutableDict_Release(props);
+                    CBLBlob_Release(blob);
+                }
+            });
+        }
+        for (auto &t : threads)
+            t.join();
+        st.stop();
+        CHECK(notFound == 0);
+        
+        auto count = numThreads * kBlobsPerThread;
+        cout << numThreads << " threads: created " << count << " blobs in " << st.elapsedMS()
+             << " ms (" << (count / st.elapsed()) << " blobs/sec)" << endl;
+    }
+}
@@ -0,0 +1,252 @@
+//
+// CRUDBenchmark.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// The CBL_C_Benchmarks tool: measures the throughput and latency of inserting, updating,
+// reading and deleting documents of several sizes, and reports them as a table and optionally
+// as JSON, to track performance between releases. With `--json -` the JSON goes to stdout and
+// the table to stderr.
+//
+// Usage: CBL_C_Benchmarks [--ops N] [--sizes 100,1000,...] [--dir PATH] [--json PATH|-]
+
+#include "cbl/CouchbaseLite.h"
+#include "fleece/Fleece.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace fleece;
+
+namespace {
+
+    using Clock = chrono::steady_clock;
+
+    struct Options {
+        size_t          ops = 2000;                         // Operations per phase
+        vector<size_t>  sizes {100, 1000, 10000, 100000};   // Document body sizes in bytes
+        string          dir;                                // Database directory
+        string          jsonPath;                           // Empty for none, "-" for stdout
+    };
+
+    struct Result {
+        string          operation;
+        size_t          docSize;
+        size_t          ops;
+        double          seconds;
+        double          p50, p99, p999;                     // Latencies in microseconds
+    };
+
+    [[noreturn]] void fail(const char *what, const CBLError &error) {
+        FLSliceResult message = CBLError_Message(&error);
+        cerr << "CBL_C_Benchmarks: " << what << " failed: " << string(slice(message)) << "\n";
+        FLSliceResult_Release(message);
+        exit(1);
+    }
+
+    [[noreturn]] void usage() {
+        cerr << "Usage: CBL_C_Benchmarks [--ops N] [--sizes 100,1000,...] [--dir PATH] [--json PATH|-]\n";
+        exit(2);
+    }
+
+    Options parseOptions(int argc, const char* argv[]) {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            string arg = argv[i];
+            if (i + 1 >= argc)
+                usage();
+            string value = argv[++i];
+            if (arg == "--ops") {
+                options.ops = strtoul(value.c_str(), nullptr, 10);
+            } else if (arg == "--sizes") {
+                options.sizes.clear();
+                stringstream in(value);
+                string size;
+                while (getline(in, size, ','))
+                    options.sizes.push_back(strtoul(size.c_str(), nullptr, 10));
+            } else if (arg == "--dir") {
+                options.dir = value;
+            } else if (arg == "--json") {
+                options.jsonPath = value;
+            } else {
+                usage();
+            }
+        }
+        if (options.ops == 0 || options.sizes.empty())
+            usage();
+        if (options.dir.empty())
+            options.dir = (filesystem::temp_directory_path() / "CBL_C_Benchmarks").string();
+        return options;
+    }
+
+    string docID(size_t i) {
+        char id[32];
+        snprintf(id, sizeof(id), "doc-%09zu", i);
+        return id;
+    }
+
+    // Sets the properties of a document to a few small fields plus a body of `size` bytes.
+    void fillDocument(CBLDocument *doc, size_t i, size_t size, int revision) {
+        FLMutableDict props = CBLDocument_MutableProperties(doc);
+        FLMutableDict_SetInt(props, "index"_sl, int64_t(i));
+        FLMutableDict_SetInt(props, "revision"_sl, revision);
+        string body(size, char('a' + (i + revision) % 26));
+        FLMutableDict_SetString(props, "body"_sl, slice(body));
+    }
+
+    // Times `op` on each of `count` documents, each run in its own transaction as an app's
+    // individual writes would be.
+    template <class Op>
+    Result measure(const char *operation, size_t docSize, size_t count, Op op) {
+        vector<double> latencies(count);
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            auto t0 = Clock::now();
+            op(i);
+            latencies[i] = chrono::duration<double, micro>(Clock::now() - t0).count();
+        }
+        double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+        sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[min(count - 1, size_t(p * double(count)))];
+        };
+        return {operation, docSize, count, seconds, percentile(0.50), percentile(0.99), percentile(0.999)};
+    }
+
+    vector<Result> runSize(const Options &options, size_t docSize) {
+        CBLError error {};
+        CBLDatabaseConfiguration config = {slice(options.dir)};
+        if (!CBL_DeleteDatabase("bench"_sl, slice(options.dir), &error) && error.code != 0)
+            fail("Deleting the database", error);
+        CBLDatabase *db = CBLDatabase_Open("bench"_sl, &config, &error);
+        if (!db)
+            fail("Opening the database", error);
+        CBLCollection *collection = CBLDatabase_DefaultCollection(db, &error);
+        if (!collection)
+            fail("Getting the default collection", error);
+
+        vector<Result> results;
+        size_t n = options.ops;
+
+        results.push_back(measure("insert", docSize, n, [&](size_t i) {
+            CBLDocument *doc = CBLDocument_CreateWithID(slice(docID(i)));
+            fillDocument(doc, i, docSize, 0);
+            if (!CBLCollection_SaveDocument(collection, doc, &error))
+                fail("Inserting a document", error);
+            CBLDocument_Release(doc);
+        }));
+
+        results.push_back(measure("update", docSize, n, [&](size_t i) {
+            CBLDocument *doc = CBLCollection_GetMutableDocument(collection, slice(docID(i)), &error);
+            if (!doc)
+                fail("Reading a document to update", error);
+            fillDocument(doc, i, docSize, 1);
+            if (!CBLCollection_SaveDocument(collection, doc, &error))
+                fail("Updating a document", error);
+            CBLDocument_Release(doc);
+        }));
+
+        // Reads in a scattered order, so that they don't just follow the insertion order:
+        results.push_back(measure("read", docSize, n, [&](size_t i) {
+            size_t which = (i * 7919) % n;
+            const CBLDocument *doc = CBLCollection_GetDocument(collection, slice(docID(which)), &error);
+            if (!doc)
+                fail("Reading a document", error);
+            FLValue body = FLDict_Get(CBLDocument_Properties(doc), "body"_sl);
+            if (FLValue_AsString(body).size != docSize)
+                fail("Reading a document's body", CBLError {kCBLDomain, kCBLErrorCorruptData});
+            CBLDocument_Release(doc);
+        }));
+
+        results.push_back(measure("delete", docSize, n, [&](size_t i) {
+            const CBLDocument *doc = CBLCollection_GetDocument(collection, slice(docID(i)), &error);
+            if (!doc || !CBLCollection_DeleteDocument(collection, doc, &error))
+                fail("Deleting a document", error);
+            CBLDocument_Release(doc);
+        }));
+
+        CBLCollection_Release(collection);
+        if (!CBLDatabase_Delete(db, &error))
+            fail("Deleting the database", error);
+        CBLDatabase_Release(db);
+        return results;
+    }
+
+    void printTable(FILE *out, const vector<Result> &results) {
+        fprintf(out, "%-8s %9s %8s %12s %10s %10s %10s\n",
+                "op", "doc size", "ops", "ops/sec", "p50 us", "p99 us", "p99.9 us");
+        for (auto &r : results) {
+            fprintf(out, "%-8s %9zu %8zu %12.0f %10.1f %10.1f %10.1f\n",
+                    r.operation.c_str(), r.docSize, r.ops, double(r.ops) / r.seconds,
+                    r.p50, r.p99, r.p999);
+        }
+    }
+
+    void writeJSON(ostream &out, const vector<Result> &results) {
+        out << "{\"version\": \"" << CBLITE_VERSION << "\", \"build\": " << CBLITE_BUILD_NUMBER
+            << ", \"results\": [";
+        const char *sep = "\n  ";
+        for (auto &r : results) {
+            char line[256];
+            snprintf(line, sizeof(line),
+                     "{\"operation\": \"%s\", \"docSize\": %zu, \"ops\": %zu, \"seconds\": %.6f, "
+                     "\"opsPerSec\": %.1f, \"p50Micros\": %.2f, \"p99Micros\": %.2f, \"p999Micros\": %.2f}",
+                     r.operation.c_str(), r.docSize, r.ops, r.seconds, double(r.ops) / r.seconds,
+                     r.p50, r.p99, r.p999);
+            out << sep << line;
+            sep = ",\n  ";
+        }
+        out << "\n]}\n";
+    }
+
+}
+
+
+int main(int argc, const char* argv[]) {
+    Options options = parseOptions(argc, argv);
+    filesystem::create_directories(options.dir);
+    CBLLog_SetConsoleLevel(kCBLLogWarning);
+
+    vector<Result> results;
+    for (size_t size : options.sizes) {
+        auto sizeResults = runSize(options, size);
+        results.insert(results.end(), sizeResults.begin(), sizeResults.end());
+    }
+
+    // With JSON on stdout, the table goes to stderr so the output can be piped to a parser:
+    printTable(options.jsonPath == "-" ? stderr : stdout, results);
+    if (options.jsonPath == "-") {
+        writeJSON(cout, results);
+    } else if (!options.jsonPath.empty()) {
+        ofstream out(options.jsonPath);
+        writeJSON(out, results);
+        if (!out) {
+            cerr << "CBL_C_Benchmarks: Couldn't write " << options.jsonPath << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
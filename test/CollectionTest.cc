@@ -18,8 +18,16 @@
 
 #include "CBLTest.hh"
 #include "CBLPrivate.h"
+#include "Stopwatch.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 using namespace fleece;
 using namespace std;
@@ -685,6 +693,103 @@ TEST_CASE_METHOD(CollectionTest, "Collection Database", "[Collection]") {
     CBLCollection_Release(col2);
 }
 
+TEST_CASE_METHOD(CollectionTest, "Collection Count Stays Current", "[Collection]") {
+    CBLError error = {};
+    CBLCollection* col = CBLDatabase_CreateCollection(db, "colA"_sl, "scopeA"_sl, &error);
+    REQUIRE(col);
+    CHECK(CBLCollection_Count(col) == 0);
+    
+    createNumberedDocsWithPrefix(col, 10, "doc");
+    CHECK(CBLCollection_Count(col) == 10);
+    CHECK(CBLCollection_Count(col) == 10);
+    
+    REQUIRE(CBLCollection_DeleteDocumentByID(col, "doc1"_sl, &error));
+    CHECK(CBLCollection_Count(col) == 9);
+    REQUIRE(CBLCollection_PurgeDocumentByID(col, "doc2"_sl, &error));
+    CHECK(CBLCollection_Count(col) == 8);
+    
+    // Another object for the same collection shares the count:
+    CBLCollection* col2 = CBLDatabase_Collection(db, "colA"_sl, "scopeA"_sl, &error);
+    REQUIRE(col2);
+    CHECK(CBLCollection_Count(col2) == 8);
+    createNumberedDocsWithPrefix(col2, 2, "doc", 100);
+    CHECK(CBLCollection_Count(col) == 10);
+    CBLCollection_Release(col2);
+    
+    // Inside a transaction, the count includes the uncommitted changes:
+    REQUIRE(CBLDatabase_BeginTransaction(db, &error));
+    createNumberedDocsWithPrefix(col, 5, "doc", 200);
+    CHECK(CBLCollection_Count(col) == 15);
+    REQUIRE(CBLDatabase_EndTransaction(db, false, &error));
+    CHECK(CBLCollection_Count(col) == 10);
+    
+    // Commits on another connection are seen:
+    CBLDatabase* db2 = openDB();
+    CBLCollection* otherCol = CBLDatabase_Collection(db2, "colA"_sl, "scopeA"_sl, &error);
+    REQUIRE(otherCol);
+    createNumberedDocsWithPrefix(otherCol, 3, "doc", 300);
+    CHECK(CBLCollection_Count(otherCol) == 13);
+    CHECK(CBLCollection_Count(col) == 13);
+    CBLCollection_Release(otherCol);
+    CBLDatabase_Release(db2);
+    
+    // After the collection is deleted, its count isn't cached:
+    REQUIRE(CBLDatabase_DeleteCollection(db, "colA"_sl, "scopeA"_sl, &error));
+    {
+        ExpectingExceptions x;
+        CHECK(CBLCollection_Count(col) == 0);
+    }
+    CBLCollection_Release(col);
+}
+
+TEST_CASE_METHOD(CollectionTest, "Collection Reader", "[Collection]") {
+    CBLError error = {};
+    CBLCollection* sensors = CBLDatabase_CreateCollection(db, "sensors"_sl, "scopeA"_sl, &error);
+    REQUIRE(sensors);
+    CBLCollection* uiState = CBLDatabase_CreateCollection(db, "ui_state"_sl, "scopeA"_sl, &error);
+    REQUIRE(uiState);
+    createNumberedDocsWithPrefix(uiState, 10, "doc");
+    
+    CBLCollection* reader = CBLCollection_AcquireReader(uiState, &error);
+    REQUIRE(reader);
+    CHECK(reader != uiState);
+    CHECK(CBLCollection_FullName(reader) == "scopeA.ui_state"_sl);
+    CBLDatabase* readerDB = CBLCollection_Database(reader);
+    CHECK(readerDB != db);
+    CHECK(CBLCollection_Count(reader) == 10);
+    
+    // The reader's connection stays out of the pool while the collection is in use:
+    CBLDatabase* otherReader = CBLDatabase_AcquireReader(db, &error);
+    REQUIRE(otherReader);
+    CHECK(otherReader != readerDB);
+    CBLDatabase_Release(otherReader);
+    
+    // Reads don't wait for writes in a transaction on the database, and see only what's committed:
+    REQUIRE(CBLDatabase_BeginTransaction(db, &error));
+    createNumberedDocsWithPrefix(sensors, 10, "reading");
+    createNumberedDocsWithPrefix(uiState, 5, "doc", 100);
+    size_t readCount = 0;
+    thread([&] {
+        readCount = CBLCollection_Count(reader);
+    }).join();
+    CHECK(readCount == 10);
+    REQUIRE(CBLDatabase_EndTransaction(db, true, &error));
+    CHECK(CBLCollection_Count(reader) == 15);
+    
+    // It can't write:
+    {
+        ExpectingExceptions x;
+        CBLDocument* doc = CBLDocument_CreateWithID("new"_sl);
+        CHECK(!CBLCollection_SaveDocument(reader, doc, &error));
+        CheckError(error, kCBLErrorNotWriteable);
+        CBLDocument_Release(doc);
+    }
+    
+    CBLCollection_Release(reader);
+    CBLCollection_Release(uiState);
+    CBLCollection_Release(sensors);
+}
+
 TEST_CASE_METHOD(CollectionTest, "Scope Database", "[Collection]") {
     CBLError error = {};
     
@@ -783,6 +888,37 @@ TEST_CASE_METHOD(CollectionTest, "Delete then Get Collection from Different DB I
     CBLDatabase_Release(db2);
 }
 
+TEST_CASE_METHOD(CollectionTest, "Get Collection from Different DB Instance During Delete", "[Collection]") {
+    CBLDatabase* db2 = openDB();
+    for (int round = 0; round < 20; ++round) {
+        CBLError error = {};
+        CBLCollection* col = CBLDatabase_CreateCollection(db, "colA"_sl, "scopeA"_sl, &error);
+        REQUIRE(col);
+        CBLCollection_Release(col);
+        
+        // Keep looking the collection up through db2 while db deletes it:
+        std::atomic<bool> stop {false};
+        std::thread lookup([&] {
+            while (!stop) {
+                CBLError lookupError;
+                CBLCollection_Release(CBLDatabase_Collection(db2, "colA"_sl, "scopeA"_sl, &lookupError));
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        bool deleted = CBLDatabase_DeleteCollection(db, "colA"_sl, "scopeA"_sl, &error);
+        stop = true;
+        lookup.join();
+        REQUIRE(deleted);
+        
+        // A lookup racing with the deletion mustn't leave the deleted collection cached:
+        CBLCollection* stale = CBLDatabase_Collection(db2, "colA"_sl, "scopeA"_sl, &error);
+        CHECK(!stale);
+        CHECK(error.code == 0);
+        CBLCollection_Release(stale);
+    }
+    CBLDatabase_Release(db2);
+}
+
 TEST_CASE_METHOD(CollectionTest, "Delete and Recreate then Get Collection from Different DB Instances", "[Collection]") {
     CBLError error = {};
     CBLCollection* col1a = CBLDatabase_CreateCollection(db, "colA"_sl, "scopeA"_sl, &error);
@@ -823,6 +959,35 @@ TEST_CASE_METHOD(CollectionTest, "Delete and Recreate then Get Collection from D
     CBLDatabase_Release(db2);
 }
 
+TEST_CASE_METHOD(CollectionTest, "Get Scope after Delete from Different DB Instance", "[Collection]") {
+    CBLError error = {};
+    CBLCollection* col1a = CBLDatabase_CreateCollection(db, "colA"_sl, "scopeA"_sl, &error);
+    REQUIRE(col1a);
+    
+    // Looking up the collection and scope repeatedly gives a new object each time:
+    CBLDatabase* db2 = openDB();
+    CBLCollection* col1b = CBLDatabase_Collection(db2, "colA"_sl, "scopeA"_sl, &error);
+    REQUIRE(col1b);
+    CBLCollection* col1c = CBLDatabase_Collection(db2, "colA"_sl, "scopeA"_sl, &error);
+    REQUIRE(col1c);
+    CHECK(col1b != col1c);
+    CBLScope* scope = CBLDatabase_Scope(db2, "scopeA"_sl, &error);
+    REQUIRE(scope);
+    CBLScope_Release(scope);
+    
+    // Deleting its only collection from db deletes the scope for db2 too:
+    REQUIRE(CBLDatabase_DeleteCollection(db, "colA"_sl, "scopeA"_sl, &error));
+    CHECK(!CBLDatabase_Scope(db2, "scopeA"_sl, &error));
+    CHECK(error.code == 0);
+    CHECK(!CBLDatabase_Collection(db2, "colA"_sl, "scopeA"_sl, &error));
+    CHECK(error.code == 0);
+    
+    CBLCollection_Release(col1a);
+    CBLCollection_Release(col1b);
+    CBLCollection_Release(col1c);
+    CBLDatabase_Release(db2);
+}
+
 TEST_CASE_METHOD(CollectionTest, "Delete Collection then Use Collection", "[Collection]") {
     CBLError error = {};
     CBLCollection* col = CBLDatabase_CreateCollection(db, "colA"_sl, "scopeA"_sl, &error);
@@ -1111,3 +1276,378 @@ TEST_CASE_METHOD(CollectionTest, "Scheduled collection notifications at database
     CBLListener_Remove(barToken);
 }
 
+TEST_CASE_METHOD(CollectionTest, "Collection notifications on an executor") {
+    CBLError error = {};
+    CBLCollection* colA = CBLDatabase_CreateCollection(db, "colA"_sl, kCBLDefaultScopeName, &error);
+    REQUIRE(colA);
+
+    struct State {
+        std::vector<CBLNotificationWorkItem*> workItems;
+        size_t defaultDocs = 0, colADocs = 0;
+    } state;
+
+    auto defaultToken = CBLCollection_AddChangeListener(defaultCollection, [](void *context, const CBLCollectionChange* change) {
+        ((State*)context)->defaultDocs += change->numDocs;
+    }, &state);
+    auto colAToken = CBLCollection_AddChangeListener(colA, [](void *context, const CBLCollectionChange* change) {
+        ((State*)context)->colADocs += change->numDocs;
+    }, &state);
+
+    CBLDatabase_SetNotificationExecutor(db, [](void *context, CBLDatabase*, CBLNotificationWorkItem* item) {
+        ((State*)context)->workItems.push_back(item);
+    }, &state);
+
+    // Changes to one collection go into one work item until it runs:
+    createDocWithPair(defaultCollection, "a1", "greeting", "hi");
+    createDocWithPair(defaultCollection, "a2", "greeting", "hi");
+    CHECK(state.workItems.size() == 1);
+    createDocWithPair(colA, "b1", "greeting", "hi");
+    CHECK(state.workItems.size() == 2);
+    CHECK(state.defaultDocs == 0);
+    CHECK(state.colADocs == 0);
+
+    // Running the work items calls the listeners:
+    auto items = std::move(state.workItems);
+    state.workItems.clear();
+    for (auto item : items)
+        CBLNotificationWorkItem_Run(item);
+    CHECK(state.defaultDocs == 2);
+    CHECK(state.colADocs == 1);
+    CHECK(state.workItems.empty());
+
+    // The next change starts a new work item:
+    createDocWithPair(defaultCollection, "a3", "greeting", "hi");
+    REQUIRE(state.workItems.size() == 1);
+    CBLNotificationWorkItem_Run(state.workItems[0]);
+    state.workItems.clear();
+    CHECK(state.defaultDocs == 3);
+
+    // Without the executor, listeners are called immediately again:
+    CBLDatabase_SetNotificationExecutor(db, nullptr, nullptr);
+    createDocWithPair(colA, "b2", "greeting", "hi");
+    CHECK(state.workItems.empty());
+    CHECK(state.colADocs == 2);
+
+    CBLListener_Remove(defaultToken);
+    CBLListener_Remove(colAToken);
+    CBLCollection_Release(colA);
+}
+
+TEST_CASE_METHOD(CollectionTest, "Remove Collection Listener During Notification") {
+    // The first listener removes the second one, which mustn't be called after that:
+    struct State {
+        CBLListenerToken* secondToken = nullptr;
+        int firstCalls = 0, secondCalls = 0;
+    } state;
+    
+    auto firstToken = CBLCollection_AddChangeListener(defaultCollection, [](void *context, const CBLCollectionChange*) {
+        auto state = (State*)context;
+        ++state->firstCalls;
+        if (state->secondToken) {
+            CBLListener_Remove(state->secondToken);
+            state->secondToken = nullptr;
+        }
+    }, &state);
+    state.secondToken = CBLCollection_AddChangeListener(defaultCollection, [](void *context, const CBLCollectionChange*) {
+        ++((State*)context)->secondCalls;
+    }, &state);
+    
+    createDocWithPair(defaultCollection, "foo", "greeting", "Howdy!");
+    CHECK(state.firstCalls == 1);
+    CHECK(state.secondCalls == 0);
+    
+    createDocWithPair(defaultCollection, "bar", "greeting", "yo.");
+    CHECK(state.firstCalls == 2);
+    CHECK(state.secondCalls == 0);
+    
+    CBLListener_Remove(firstToken);
+}
+
+
+TEST_CASE_METHOD(CollectionTest, "Benchmark Many Document Listeners", "[Collection][Perf][.slow]") {
+    constexpr unsigned kNumListeners = 20000;
+    constexpr unsigned kNumUpdates = 1000;
+    
+    static unsigned sCalls;
+    sCalls = 0;
+    auto listener = [](void *context, const CBLDocumentChange *change) {++sCalls;};
+    
+    vector<string> docIDs;
+    for (unsigned i = 0; i < kNumListeners; ++i)
+        docIDs.push_back("doc-" + to_string(i));
+    
+    Stopwatch st;
+    vector<CBLListenerToken*> tokens;
+    for (auto &docID : docIDs)
+        tokens.push_back(CBLCollection_AddDocumentChangeListener(defaultCollection, slice(docID),
+                                                                 listener, nullptr));
+    WARN("Added " << kNumListeners << " document listeners in " << st.elapsedMS() << " ms");
+    
+    // Each update should only notify its own document's listener:
+    st.reset();
+    for (unsigned i = 0; i < kNumUpdates; ++i)
+        createDocWithPair(defaultCollection, slice(docIDs[i * (kNumListeners / kNumUpdates)]), "n", "1");
+    WARN("Saved " << kNumUpdates << " docs in " << st.elapsedMS() << " ms");
+    CHECK(sCalls == kNumUpdates);
+    
+    // Remove in random order, which used to be quadratic:
+    shuffle(tokens.begin(), tokens.end(), std::mt19937(1234));
+    st.reset();
+    for (auto token : tokens)
+        CBLListener_Remove(token);
+    WARN("Removed " << kNumListeners << " document listeners in " << st.elapsedMS() << " ms");
+}
+
+
+TEST_CASE_METHOD(CollectionTest, "Collection change batch notifications") {
+    struct Entry {
+        string docID;
+        string revID;
+        uint64_t sequence;
+        uint32_t bodySize;
+        bool deleted;
+        bool external;
+    };
+    vector<vector<Entry>> batches;
+    
+    auto token = CBLCollection_AddChangeBatchListener(defaultCollection, [](void *context, const CBLCollectionChangeBatch* batch) {
+        vector<Entry> entries;
+        for (size_t i = 0; i < batch->numChanges; ++i) {
+            auto &c = batch->changes[i];
+            entries.push_back({string(slice(c.docID)), string(slice(c.revID)), c.sequence, c.bodySize,
+                               c.deleted, c.external});
+        }
+        ((vector<vector<Entry>>*)context)->push_back(std::move(entries));
+    }, &batches);
+    
+    // Legacy listeners get the same changes in chunks of 100:
+    defaultListenerCalls = 0;
+    auto legacyToken = CBLCollection_AddChangeListener(defaultCollection, [](void *context, const CBLCollectionChange* change) {
+        ++defaultListenerCalls;
+    }, nullptr);
+    
+    CBLDatabase_BufferNotifications(db, notificationsReady, this);
+    constexpr int kNumDocs = 250;
+    for (int i = 0; i < kNumDocs; ++i)
+        createDocWithPair(defaultCollection, "doc-" + to_string(i), "greeting", "Howdy!");
+    CBLDatabase_SendNotifications(db);
+    
+    CHECK(defaultListenerCalls == 3);
+    REQUIRE(batches.size() == 1);
+    REQUIRE(batches[0].size() == kNumDocs);
+    for (int i = 0; i < kNumDocs; ++i) {
+        auto &entry = batches[0][i];
+        CHECK(entry.docID == "doc-" + to_string(i));
+        CHECK(entry.revID.size() > 0);
+        CHECK(entry.sequence == uint64_t(i + 1));
+        CHECK(entry.bodySize > 0);
+        CHECK(!entry.deleted);
+        CHECK(!entry.external);
+    }
+    
+    CBLError error;
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "doc-7"_sl, &error));
+    CBLDatabase_SendNotifications(db);
+    REQUIRE(batches.size() == 2);
+    REQUIRE(batches[1].size() == 1);
+    CHECK(batches[1][0].docID == "doc-7");
+    CHECK(batches[1][0].sequence == uint64_t(kNumDocs + 1));
+    CHECK(batches[1][0].deleted);
+    
+    CBLListener_Remove(token);
+    CBLListener_Remove(legacyToken);
+}
+
+
+TEST_CASE_METHOD(CollectionTest, "Collection change feed") {
+    CBLError error;
+    for (int i = 0; i < 25; ++i)
+        createDocWithPair(defaultCollection, "doc-" + to_string(i), "n", to_string(i));
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "doc-3"_sl, &error));
+    
+    // Read it in batches of 10:
+    vector<CBLChangeFeedEntry> entries;
+    vector<CBLChangeFeedBatch*> batches;
+    uint64_t since = 0;
+    while (true) {
+        CBLChangeFeedBatch* batch = CBLCollection_ChangesSince(defaultCollection, since, 10, true, 0, &error);
+        REQUIRE(batch);
+        batches.push_back(batch);
+        size_t count = CBLChangeFeedBatch_Count(batch);
+        CHECK(count <= 10);
+        if (count == 0) {
+            CHECK(CBLChangeFeedBatch_LastSequence(batch) == since);
+            break;
+        }
+        for (size_t i = 0; i < count; ++i)
+            entries.push_back(CBLChangeFeedBatch_Entry(batch, i));
+        since = CBLChangeFeedBatch_LastSequence(batch);
+    }
+    CHECK(batches.size() == 4);
+    REQUIRE(entries.size() == 25);
+    for (size_t i = 0; i + 1 < entries.size(); ++i)
+        CHECK(entries[i].sequence < entries[i + 1].sequence);
+    CHECK(slice(entries[0].docID) == "doc-0"_sl);
+    CHECK(slice(entries[0].revID).size > 0);
+    CHECK(Dict(entries[0].body)["n"].asString() == "0"_sl);
+    // doc-3 appears once, at the sequence of its deletion:
+    auto &last = entries.back();
+    CHECK(slice(last.docID) == "doc-3"_sl);
+    CHECK(last.deleted);
+    CHECK(!last.body);
+    CHECK(last.sequence == 26);
+    for (auto batch : batches)
+        CBLChangeFeedBatch_Release(batch);
+    
+    // Without bodies:
+    CBLChangeFeedBatch* batch = CBLCollection_ChangesSince(defaultCollection, 20, 0, false, 0, &error);
+    REQUIRE(batch);
+    CHECK(CBLChangeFeedBatch_Count(batch) == 6);
+    CHECK(!CBLChangeFeedBatch_Entry(batch, 0).body);
+    CBLChangeFeedBatch_Release(batch);
+    
+    // Long-polling waits for a change made by another thread:
+    thread writer([&] {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        createDocWithPair(defaultCollection, "late", "n", "26");
+    });
+    batch = CBLCollection_ChangesSince(defaultCollection, 26, 0, false, 10000, &error);
+    writer.join();
+    REQUIRE(batch);
+    REQUIRE(CBLChangeFeedBatch_Count(batch) == 1);
+    CHECK(slice(CBLChangeFeedBatch_Entry(batch, 0).docID) == "late"_sl);
+    CHECK(CBLChangeFeedBatch_LastSequence(batch) == 27);
+    CBLChangeFeedBatch_Release(batch);
+    
+    // ...and gives up after the timeout:
+    batch = CBLCollection_ChangesSince(defaultCollection, 27, 0, false, 50, &error);
+    REQUIRE(batch);
+    CHECK(CBLChangeFeedBatch_Count(batch) == 0);
+    CBLChangeFeedBatch_Release(batch);
+}
+
+
+
+static void saveOrder(CBLCollection* col, slice docID, slice type, double amount) {
+    CBLDocument* doc = CBLDocument_CreateWithID(docID);
+    FLMutableDict props = CBLDocument_MutableProperties(doc);
+    FLMutableDict_SetString(props, "type"_sl, type);
+    FLMutableDict_SetDouble(props, "amount"_sl, amount);
+    CBLError error;
+    REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+    CBLDocument_Release(doc);
+}
+
+
+TEST_CASE_METHOD(CollectionTest, "Aggregate view") {
+    saveOrder(defaultCollection, "o1"_sl, "book"_sl, 10);
+    saveOrder(defaultCollection, "o2"_sl, "book"_sl, 5);
+    saveOrder(defaultCollection, "o3"_sl, "toy"_sl, 7);
+    createDocWithPair(defaultCollection, "untyped", "amount", "12");
+    
+    FLString sums[] = {"amount"_sl};
+    CBLAggregateViewConfiguration config = {"type"_sl, sums, 1};
+    CBLError error;
+    CBLAggregateView* view = CBLCollection_CreateAggregateView(defaultCollection, config, &error);
+    REQUIRE(view);
+    
+    // Groups are in JSON order, so the documents without a type come first:
+    auto checkResults = [&](const char* expected) {
+        FLMutableArray results = CBLAggregateView_Results(view);
+        alloc_slice json = FLValue_ToJSON((FLValue)results);
+        CHECK(json == slice(expected));
+        FLMutableArray_Release(results);
+    };
+    checkResults(R"([{"count":1,"sums":{"amount":0}},)"
+                 R"({"count":2,"group":"book","sums":{"amount":15}},)"
+                 R"({"count":1,"group":"toy","sums":{"amount":7}}])");
+    
+    vector<string> deltas;
+    auto token = CBLAggregateView_AddChangeListener(view, [](void *context, CBLAggregateView*, FLArray deltas) {
+        ((vector<string>*)context)->push_back(string(alloc_slice(FLValue_ToJSON((FLValue)deltas))));
+    }, &deltas);
+    
+    CBLDatabase_BufferNotifications(db, notificationsReady, this);
+    saveOrder(defaultCollection, "o2"_sl, "toy"_sl, 5);         // Moves from book to toy
+    saveOrder(defaultCollection, "o4"_sl, "game"_sl, 20);
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "o1"_sl, &error));
+    CBLDatabase_SendNotifications(db);
+    
+    REQUIRE(deltas.size() == 1);
+    CHECK(deltas[0] == R"([{"count":-2,"group":"book","sums":{"amount":-15}},)"
+                       R"({"count":1,"group":"game","sums":{"amount":20}},)"
+                       R"({"count":1,"group":"toy","sums":{"amount":5}}])");
+    checkResults(R"([{"count":1,"sums":{"amount":0}},)"
+                 R"({"count":1,"group":"game","sums":{"amount":20}},)"
+                 R"({"count":2,"group":"toy","sums":{"amount":12}}])");
+    
+    // A save that doesn't change the aggregates isn't reported:
+    saveOrder(defaultCollection, "o3"_sl, "toy"_sl, 7);
+    CBLDatabase_SendNotifications(db);
+    CHECK(deltas.size() == 1);
+    
+    // Purged documents are taken out too:
+    REQUIRE(CBLCollection_PurgeDocumentByID(defaultCollection, "o4"_sl, &error));
+    CBLDatabase_SendNotifications(db);
+    REQUIRE(deltas.size() == 2);
+    CHECK(deltas[1] == R"([{"count":-1,"group":"game","sums":{"amount":-20}}])");
+
+    CBLListener_Remove(token);
+    CBLAggregateView_Release(view);
+    
+    ExpectingExceptions x;
+    config.groupBy = kFLSliceNull;
+    CHECK(!CBLCollection_CreateAggregateView(defaultCollection, config, &error));
+    CheckError(error, kCBLErrorInvalidParameter);
+}
+
+
+TEST_CASE_METHOD(CollectionTest, "Aggregate view created during writes") {
+    static constexpr int kNumDocs = 50, kNumWrites = 2000;
+    char docID[20];
+    for (int i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "o%02d", i);
+        saveOrder(defaultCollection, slice(docID), "book"_sl, 1);
+    }
+    
+    // Keep moving documents between groups, and deleting and recreating some, while the view's
+    // initial scan runs:
+    std::atomic<bool> stop {false};
+    std::thread writer([&] {
+        CBLError error;
+        for (int n = 0; n < kNumWrites && !stop; ++n) {
+            char id[20];
+            snprintf(id, sizeof(id), "o%02d", n % kNumDocs);
+            if (n % 7 == 0)
+                CBLCollection_DeleteDocumentByID(defaultCollection, slice(id), &error);
+            else {
+                // (Not using saveOrder, since Catch's assertions aren't thread-safe.)
+                CBLDocument* doc = CBLDocument_CreateWithID(slice(id));
+                FLMutableDict props = CBLDocument_MutableProperties(doc);
+                FLMutableDict_SetString(props, "type"_sl, (n % 2) ? "toy"_sl : "book"_sl);
+                FLMutableDict_SetDouble(props, "amount"_sl, n);
+                CBLCollection_SaveDocument(defaultCollection, doc, &error);
+                CBLDocument_Release(doc);
+            }
+        }
+    });
+    
+    FLString sums[] = {"amount"_sl};
+    CBLAggregateViewConfiguration config = {"type"_sl, sums, 1};
+    CBLError error;
+    CBLAggregateView* view = CBLCollection_CreateAggregateView(defaultCollection, config, &error);
+    stop = !view;
+    writer.join();
+    REQUIRE(view);
+    
+    // The view must agree with one created after the writes:
+    CBLAggregateView* fresh = CBLCollection_CreateAggregateView(defaultCollection, config, &error);
+    REQUIRE(fresh);
+    FLMutableArray results = CBLAggregateView_Results(view);
+    FLMutableArray expected = CBLAggregateView_Results(fresh);
+    CHECK(alloc_slice(FLValue_ToJSON((FLValue)results)) == alloc_slice(FLValue_ToJSON((FLValue)expected)));
+    FLMutableArray_Release(results);
+    FLMutableArray_Release(expected);
+    CBLAggregateView_Release(fresh);
+    CBLAggregateView_Release(view);
+}
@@ -19,6 +19,7 @@
 #include "CBLTest_Cpp.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <deque>
 #include <string>
 
 #include "cbl++/CouchbaseLite.hh"
@@ -527,3 +528,41 @@ TEST_CASE_METHOD(CBLTest_Cpp, "Collection Listener Token") {
     CHECK(!listenerToken.context());
     listenerToken.remove(); // Noops
 }
+
+
+TEST_CASE_METHOD(CollectionTest_Cpp, "C++ Collection batch operations", "[Collection]") {
+    deque<MutableDocument> docs;
+    for (int i = 0; i < 5; ++i) {
+        MutableDocument doc("doc-" + to_string(i));
+        doc["n"] = i;
+        docs.push_back(std::move(doc));
+    }
+    {
+        Transaction t(defaultCollection);
+        auto results = defaultCollection.saveDocuments(docs);
+        REQUIRE(results.size() == 5);
+        for (auto &result : results)
+            CHECK(result.code == 0);
+        t.commit();
+    }
+    CHECK(defaultCollection.count() == 5);
+
+    vector<slice> ids {"doc-3", "nope", "doc-0"};
+    auto got = defaultCollection.getDocuments(ids);
+    REQUIRE(got.size() == 3);
+    REQUIRE(got[0]);
+    CHECK(got[0].properties()["n"].asInt() == 3);
+    CHECK(!got[1]);
+    REQUIRE(got[2]);
+    CHECK(got[2].id() == "doc-0");
+
+    vector<slice> expiring {"doc-1", "doc-2"};
+    vector<CBLTimestamp> times {CBL_Now() + 60000, CBL_Now() + 60000};
+    CHECK(defaultCollection.setDocumentExpirations(expiring, times) == 2);
+    CHECK(defaultCollection.getDocumentExpiration("doc-1") == times[0]);
+    CHECK_THROWS_AS(defaultCollection.setDocumentExpirations(expiring, span(times).first(1)),
+                    std::invalid_argument);
+
+    CHECK(defaultCollection.purgeDocuments(ids) == 2);
+    CHECK(defaultCollection.count() == 3);
+}
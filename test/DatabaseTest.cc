@@ -20,6 +20,12 @@
 #include "CBLPrivate.h"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -336,6 +342,153 @@ TEST_CASE_METHOD(DatabaseTest, "Database Encryption") {
     CHECK(!CBL_DatabaseExists("encdb"_sl, nullslice));
 }
 
+
+TEST_CASE_METHOD(DatabaseTest, "Incremental Database Rekey") {
+    CBL_DeleteDatabase("rekeydb"_sl, nullslice, nullptr);
+    CBL_DeleteDatabase("rekeydb~rekey"_sl, nullslice, nullptr);
+    
+    CBLError error {};
+    CBLDatabase *rekeydb = CBLDatabase_Open("rekeydb"_sl, nullptr, &error);
+    REQUIRE(rekeydb);
+    for (int i = 0; i < 25; ++i)
+        createDocWithPair(rekeydb, slice("doc-" + to_string(i)), "foo"_sl, "bar"_sl);
+    
+    CBLEncryptionKey key {};
+    CBLEncryptionKey_FromPassword(&key, "sekrit"_sl);
+    
+    // Each step copies at most 10 documents:
+    CBLRekeyProgress progress {};
+    REQUIRE(CBLDatabase_RekeyStep(rekeydb, &key, 10, &progress, &error));
+    CHECK(progress.documentsCopied == 10);
+    CHECK(progress.sequencesRemaining == 15);
+    
+    // Changes made between steps are copied too:
+    createDocWithPair(rekeydb, "doc-new"_sl, "foo"_sl, "baz"_sl);
+    CBLCollection* col = CBLDatabase_DefaultCollection(rekeydb, &error);
+    REQUIRE(CBLCollection_PurgeDocumentByID(col, "doc-0"_sl, &error));
+    CBLCollection_Release(col);
+    
+    REQUIRE(CBLDatabase_RekeyStep(rekeydb, &key, 10, &progress, &error));
+    CHECK(progress.documentsCopied == 10);
+    CHECK(progress.sequencesRemaining == 6);
+    
+    // A different key can't continue this rekey:
+    {
+        ExpectingExceptions x;
+        CBLEncryptionKey key2 {};
+        CBLEncryptionKey_FromPassword(&key2, "wrongpassword"_sl);
+        CHECK(!CBLDatabase_RekeyStep(rekeydb, &key2, 10, &progress, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+    
+    REQUIRE(CBLDatabase_FinishRekey(rekeydb, &key, &error));
+    CBLDatabase_Release(rekeydb);
+    CHECK(!CBL_DatabaseExists("rekeydb~rekey"_sl, nullslice));
+    
+    // The database now needs the new key:
+    {
+        ExpectingExceptions x;
+        CHECK(!CBLDatabase_Open("rekeydb"_sl, nullptr, &error));
+        CheckError(error, kCBLErrorNotADatabaseFile);
+    }
+    CBLDatabaseConfiguration config = {nullslice, key};
+    rekeydb = CBLDatabase_Open("rekeydb"_sl, &config, &error);
+    REQUIRE(rekeydb);
+    col = CBLDatabase_DefaultCollection(rekeydb, &error);
+    CHECK(CBLCollection_Count(col) == 25);
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "doc-0"_sl, &error);
+    CHECK(!doc);
+    doc = CBLCollection_GetDocument(col, "doc-new"_sl, &error);
+    REQUIRE(doc);
+    CHECK(Dict(CBLDocument_Properties(doc))["foo"].asString() == "baz"_sl);
+    CBLDocument_Release(doc);
+    CBLCollection_Release(col);
+    
+    CHECK(CBLDatabase_Delete(rekeydb, &error));
+    CBLDatabase_Release(rekeydb);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Incremental Database Rekey Copies Everything") {
+    CBL_DeleteDatabase("rekeydb"_sl, nullslice, nullptr);
+    CBL_DeleteDatabase("rekeydb~rekey"_sl, nullslice, nullptr);
+    
+    CBLError error {};
+    CBLDatabase *rekeydb = CBLDatabase_Open("rekeydb"_sl, nullptr, &error);
+    REQUIRE(rekeydb);
+    CBLCollection* col = CBLDatabase_DefaultCollection(rekeydb, &error);
+    for (int i = 0; i < 5; ++i)
+        createDocWithPair(col, slice("doc-" + to_string(i)), "foo"_sl, "bar"_sl);
+    CBLCollection* tenant = CBLDatabase_CreateCollection(rekeydb, "a"_sl, "tenants"_sl, &error);
+    REQUIRE(tenant);
+    for (int i = 0; i < 5; ++i)
+        createDocWithPair(tenant, slice("old-" + to_string(i)), "foo"_sl, "bar"_sl);
+    
+    CBLEncryptionKey key {};
+    CBLEncryptionKey_FromPassword(&key, "sekrit"_sl);
+    CBLRekeyProgress progress {};
+    
+    // A full-text index's options can't be copied, so it has to be deleted first:
+    CBLFullTextIndexConfiguration ftsIndex = {};
+    ftsIndex.expressionLanguage = kCBLN1QLLanguage;
+    ftsIndex.expressions = "foo"_sl;
+    ftsIndex.language = "en/english"_sl;
+    REQUIRE(CBLCollection_CreateFullTextIndex(col, "fts"_sl, ftsIndex, &error));
+    {
+        ExpectingExceptions x;
+        CHECK(!CBLDatabase_RekeyStep(rekeydb, &key, 100, &progress, &error));
+        CheckError(error, kCBLErrorUnsupported);
+    }
+    REQUIRE(CBLCollection_DeleteIndex(col, "fts"_sl, &error));
+    CBLValueIndexConfiguration valueIndex = {};
+    valueIndex.expressionLanguage = kCBLN1QLLanguage;
+    valueIndex.expressions = "foo"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(col, "byFoo"_sl, valueIndex, &error));
+    
+    REQUIRE(CBLDatabase_RekeyStep(rekeydb, &key, 100, &progress, &error));
+    CHECK(progress.documentsCopied == 10);
+    CHECK(progress.sequencesRemaining == 0);
+    
+    // Recreate the collection with more sequences than it had, which reuses the checkpoint's:
+    CBLCollection_Release(tenant);
+    REQUIRE(CBLDatabase_DeleteCollection(rekeydb, "a"_sl, "tenants"_sl, &error));
+    tenant = CBLDatabase_CreateCollection(rekeydb, "a"_sl, "tenants"_sl, &error);
+    REQUIRE(tenant);
+    for (int i = 0; i < 8; ++i)
+        createDocWithPair(tenant, slice("new-" + to_string(i)), "foo"_sl, "baz"_sl);
+    CBLCollection_Release(tenant);
+    
+    // Setting an expiration doesn't change the document's sequence:
+    CBLTimestamp expiration = CBL_Now() + 3600 * 1000;
+    REQUIRE(CBLCollection_SetDocumentExpiration(col, "doc-1"_sl, expiration, &error));
+    CBLCollection_Release(col);
+    
+    REQUIRE(CBLDatabase_FinishRekey(rekeydb, &key, &error));
+    CBLDatabase_Release(rekeydb);
+    
+    CBLDatabaseConfiguration config = {nullslice, key};
+    rekeydb = CBLDatabase_Open("rekeydb"_sl, &config, &error);
+    REQUIRE(rekeydb);
+    tenant = CBLDatabase_Collection(rekeydb, "a"_sl, "tenants"_sl, &error);
+    REQUIRE(tenant);
+    CHECK(CBLCollection_Count(tenant) == 8);
+    const CBLDocument* doc = CBLCollection_GetDocument(tenant, "old-0"_sl, &error);
+    CHECK(!doc);
+    CBLCollection_Release(tenant);
+    
+    col = CBLDatabase_DefaultCollection(rekeydb, &error);
+    CHECK(CBLCollection_GetDocumentExpiration(col, "doc-1"_sl, &error) == expiration);
+    FLMutableArray indexNames = CBLCollection_GetIndexNames(col, &error);
+    REQUIRE(indexNames);
+    REQUIRE(FLArray_Count(indexNames) == 1);
+    CHECK(slice(FLValue_AsString(FLArray_Get(indexNames, 0))) == "byFoo"_sl);
+    FLMutableArray_Release(indexNames);
+    CBLCollection_Release(col);
+    
+    CHECK(CBLDatabase_Delete(rekeydb, &error));
+    CBLDatabase_Release(rekeydb);
+}
+
 #endif
 
 #pragma mark - Full Sync:
@@ -616,6 +769,215 @@ TEST_CASE_METHOD(DatabaseTest, "Maintenance : Compact and Integrity Check") {
 }
 
 
+TEST_CASE_METHOD(DatabaseTest, "Maintenance : Task") {
+    CBLError error;
+    for (int i = 0; i < 100; i++)
+        createDocWithPair(db, "doc" + to_string(i), "foo", "bar");
+    
+    CBLMaintenanceType types[] = {kCBLMaintenanceTypeIntegrityCheck,
+                                  kCBLMaintenanceTypeCompact,
+                                  kCBLMaintenanceTypeOptimize};
+    CBLMaintenanceTask* task = CBLDatabase_CreateMaintenanceTask(db, types, 3, &error);
+    REQUIRE(task);
+    auto progress = CBLMaintenanceTask_Progress(task);
+    CHECK(progress.stepsCompleted == 0);
+    CHECK(progress.stepsRemaining == 3);
+    // Operations not performed yet are estimated from the file size, not as free:
+    CHECK(progress.nextStepEstimatedMs > 0);
+    CHECK(progress.estimatedRemainingMs >= 3);
+    
+    // With no budget, one step is performed per call:
+    REQUIRE(CBLMaintenanceTask_Run(task, 0, &error));
+    progress = CBLMaintenanceTask_Progress(task);
+    CHECK(progress.stepsCompleted == 1);
+    CHECK(progress.stepsRemaining == 2);
+    
+    // The database can be used between calls:
+    createDocWithPair(db, "another", "foo", "bar");
+    
+    REQUIRE(CBLMaintenanceTask_Run(task, 60000, &error));
+    progress = CBLMaintenanceTask_Progress(task);
+    CHECK(progress.stepsCompleted == 3);
+    CHECK(progress.stepsRemaining == 0);
+    CHECK(progress.estimatedRemainingMs == 0);
+    REQUIRE(CBLMaintenanceTask_Run(task, 0, &error));
+    CHECK(CBLMaintenanceTask_Progress(task).stepsCompleted == 3);
+    CBLMaintenanceTask_Release(task);
+    CHECK(CBLCollection_Count(defaultCollection) == 101);
+    
+    // Invalid type:
+    {
+        ExpectingExceptions x;
+        CBLMaintenanceType badTypes[] = {CBLMaintenanceType(99)};
+        CHECK(!CBLDatabase_CreateMaintenanceTask(db, badTypes, 1, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Maintenance : Background") {
+    CBLError error;
+    for (int i = 0; i < 100; i++)
+        createDocWithPair(db, "doc" + to_string(i), "foo", "bar");
+
+    CBLMaintenanceType types[] = {kCBLMaintenanceTypeOptimize, kCBLMaintenanceTypeCompact};
+    REQUIRE(CBLDatabase_EnableBackgroundMaintenance(db, types, 2, &error));
+    REQUIRE(CBLDatabase_EnableBackgroundMaintenance(otherDB, types, 1, &error));
+
+    // With no budget, one operation is performed per call, continuing where the last one left off:
+    CHECK(!CBL_RunBackgroundMaintenance(0));
+    CHECK(!CBL_RunBackgroundMaintenance(0));
+    CHECK(CBL_RunBackgroundMaintenance(0));
+
+    // Once they're all done, the next call starts over:
+    CHECK(!CBL_RunBackgroundMaintenance(0));
+    CHECK(CBL_RunBackgroundMaintenance(60000));
+
+    // Closing a database disables it:
+    REQUIRE(CBLDatabase_Close(otherDB, &error));
+    CHECK(!CBL_RunBackgroundMaintenance(0));
+    CHECK(CBL_RunBackgroundMaintenance(0));
+    {
+        ExpectingExceptions x;
+        CHECK(!CBLDatabase_EnableBackgroundMaintenance(otherDB, types, 1, &error));
+        CheckError(error, kCBLErrorNotOpen);
+    }
+
+    CBLDatabase_DisableBackgroundMaintenance(db);
+    CHECK(CBL_RunBackgroundMaintenance(0));
+    CHECK(CBLCollection_Count(defaultCollection) == 100);
+
+    // Invalid type:
+    {
+        ExpectingExceptions x;
+        CBLMaintenanceType badTypes[] = {CBLMaintenanceType(99)};
+        CHECK(!CBLDatabase_EnableBackgroundMaintenance(db, badTypes, 1, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Storage Stats") {
+    CBLError error;
+    for (int i = 0; i < 100; i++)
+        createDocWithPair(db, "doc" + to_string(i), "foo", "bar");
+    
+    FLDict stats = CBLDatabase_GetStorageStats(db, &error);
+    REQUIRE(stats);
+    Dict dict(stats);
+    CHECK(dict["databaseBytes"].asInt() > 0);
+    CHECK(dict["totalBytes"].asInt() >= dict["databaseBytes"].asInt() + dict["walBytes"].asInt());
+    CHECK(dict["blobCount"].asInt() == 0);
+    Dict col = dict["collections"].asDict()["_default._default"].asDict();
+    CHECK(col["documentCount"].asInt() == 100);
+    CHECK(col["lastSequence"].asInt() == 100);
+    CHECK(dict["maintenance"].asDict().empty());
+    Dict sharedKeys = dict["sharedKeys"].asDict();
+    CHECK(sharedKeys["count"].asInt() >= 1);    // "foo"
+    CHECK(sharedKeys["capacity"].asInt() == 2048);
+    FLDict_Release(stats);
+    
+    REQUIRE(CBLDatabase_PerformMaintenance(db, kCBLMaintenanceTypeCompact, &error));
+    stats = CBLDatabase_GetStorageStats(db, &error);
+    REQUIRE(stats);
+    Dict compact = Dict(stats)["maintenance"].asDict()["compact"].asDict();
+    CHECK(compact["count"].asInt() == 1);
+    CHECK(compact["lastReclaimedBytes"].asInt() >= 0);
+    CHECK(!Dict(stats)["maintenance"].asDict()["reindex"]);
+    FLDict_Release(stats);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Export") {
+    CBLError error;
+    for (int i = 0; i < 100; i++)
+        createDocWithPair(db, "doc" + to_string(i), "foo", "bar");
+    {
+        CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, "Hi there"_sl);
+        auto doc = CBLDocument_CreateWithID("withBlob"_sl);
+        FLMutableDict_SetBlob(CBLDocument_MutableProperties(doc), "blob"_sl, blob);
+        REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+        CBLDocument_Release(doc);
+        CBLBlob_Release(blob);
+    }
+    
+    CBLExportOptions options = {};
+    options.chunkSize = 1000;
+    string output;
+    vector<size_t> chunkSizes;
+    auto exportLines = [&](const CBLExportOptions &opts) {
+        output.clear();
+        chunkSizes.clear();
+        auto write = [](void *context, FLSlice chunk) {
+            auto test = (pair<string*, vector<size_t>*>*)context;
+            test->first->append((const char*)chunk.buf, chunk.size);
+            test->second->push_back(chunk.size);
+            return true;
+        };
+        pair<string*, vector<size_t>*> context {&output, &chunkSizes};
+        FLDict checkpoint = CBLDatabase_Export(db, &opts, write, &context, &error);
+        REQUIRE(checkpoint);
+        vector<alloc_slice> lines;
+        for (size_t start = 0, end; (end = output.find('\n', start)) != string::npos; start = end + 1)
+            lines.emplace_back(output.substr(start, end - start));
+        return make_pair(checkpoint, lines);
+    };
+    auto type = [](slice line) {
+        Doc doc = Doc::fromJSON(line);
+        return string(doc.asDict()["type"].asString());
+    };
+    
+    auto [checkpoint, lines] = exportLines(options);
+    REQUIRE(lines.size() == 1 + 1 + 1 + 101 + 1);
+    CHECK(type(lines[0]) == "header");
+    CHECK(type(lines[1]) == "collection");
+    CHECK(type(lines.back()) == "end");
+    CHECK(std::count_if(lines.begin(), lines.end(), [&](slice l) {return type(l) == "document";}) == 101);
+    CHECK(std::count_if(lines.begin(), lines.end(), [&](slice l) {return type(l) == "blob";}) == 1);
+    for (size_t i = 0; i + 1 < chunkSizes.size(); ++i)
+        CHECK(chunkSizes[i] == 1000);
+    CHECK(Dict(checkpoint)["_default._default"].asInt() == 101);
+    
+    // An incremental export has only the changes:
+    createDocWithPair(db, "doc5", "foo", "baz");
+    const CBLDocument* doc = CBLCollection_GetDocument(defaultCollection, "doc6"_sl, &error);
+    REQUIRE(doc);
+    REQUIRE(CBLCollection_DeleteDocument(defaultCollection, doc, &error));
+    CBLDocument_Release(doc);
+    
+    options.since = checkpoint;
+    auto [checkpoint2, lines2] = exportLines(options);
+    REQUIRE(lines2.size() == 1 + 1 + 2 + 1);
+    Dict updated = Doc::fromJSON(lines2[2]).asDict();
+    CHECK(updated["id"].asString() == "doc5"_sl);
+    CHECK(updated["body"].asDict()["foo"].asString() == "baz"_sl);
+    Dict deleted = Doc::fromJSON(lines2[3]).asDict();
+    CHECK(deleted["id"].asString() == "doc6"_sl);
+    CHECK(deleted["deleted"].asBool());
+    CHECK(Dict(checkpoint2)["_default._default"].asInt() == 103);
+    FLDict_Release(checkpoint);
+    FLDict_Release(checkpoint2);
+    
+    // To a file:
+    string path = string(databaseDir()) + "/export.jsonl";
+    FLDict checkpoint3 = CBLDatabase_ExportToFile(db, slice(path), nullptr, &error);
+    REQUIRE(checkpoint3);
+    FLDict_Release(checkpoint3);
+    ifstream in(path);
+    string line;
+    size_t nLines = 0;
+    while (getline(in, line))
+        ++nLines;
+    CHECK(nLines == 1 + 1 + 1 + 100 + 1);       // doc6 is deleted
+    {
+        ExpectingExceptions x;
+        auto fail = [](void*, FLSlice) {return false;};
+        CHECK(!CBLDatabase_Export(db, nullptr, fail, nullptr, &error));
+        CheckError(error, kCBLErrorIOError);
+    }
+}
+
+
 TEST_CASE_METHOD(DatabaseTest, "Maintenance : Reindex") {
     CBLError error;
     CBLValueIndexConfiguration config = {};
@@ -663,6 +1025,231 @@ TEST_CASE_METHOD(DatabaseTest, "Maintenance : FullOptimize") {
 }
 
 
+TEST_CASE_METHOD(DatabaseTest, "Prewarm") {
+    CBLValueIndexConfiguration index1 = {};
+    index1.expressionLanguage = kCBLN1QLLanguage;
+    index1.expressions = "name.first"_sl;
+    CBLError error;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "index1"_sl, index1, &error));
+    
+    ImportJSONLines("names_100.json", defaultCollection);
+    
+    struct Result {
+        mutex               m;
+        condition_variable  cond;
+        bool                done = false;
+        uint64_t            bytesRead = 0;
+    };
+    auto prewarm = [&](FLArray names, uint64_t budget) {
+        Result result;
+        CBLDatabase_Prewarm(db, names, budget, [](void* context, uint64_t bytesRead) {
+            auto r = (Result*)context;
+            lock_guard<mutex> lock(r->m);
+            r->bytesRead = bytesRead;
+            r->done = true;
+            r->cond.notify_one();
+        }, &result);
+        unique_lock<mutex> lock(result.m);
+        REQUIRE(result.cond.wait_for(lock, 10s, [&]{return result.done;}));
+        return result.bytesRead;
+    };
+    
+    uint64_t all = prewarm(nullptr, 0);
+    CHECK(all > 0);
+    
+    auto names = MutableArray::newArray();
+    names.append("index1"_sl);
+    uint64_t some = prewarm(names, 200);
+    CHECK(some >= 200);
+    CHECK(some < all);
+    
+    // Unknown indexes are ignored:
+    names = MutableArray::newArray();
+    names.append("nonexistent"_sl);
+    CHECK(prewarm(names, 0) == 0);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Prewarm Reads Every Row Once") {
+    // More rows than a prewarming page, with many equal first keys, and more than a page of
+    // rows missing the first key:
+    CBLValueIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "n, s"_sl;
+    CBLError error;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "byNS"_sl, index, &error));
+    constexpr int kWithKey = 2500, kWithoutKey = 1200;
+    char docID[20];
+    REQUIRE(CBLDatabase_BeginTransaction(db, &error));
+    for (int i = 0; i < kWithKey; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%04d", i);
+        createDocWithJSON(defaultCollection, docID, "{\"n\":" + to_string(i % 10) + ",\"s\":\"x\"}");
+    }
+    for (int i = 0; i < kWithoutKey; ++i) {
+        snprintf(docID, sizeof(docID), "nokey-%04d", i);
+        createDocWithJSON(defaultCollection, docID, R"({"s":"x"})");
+    }
+    REQUIRE(CBLDatabase_EndTransaction(db, true, &error));
+    
+    struct Result {
+        mutex               m;
+        condition_variable  cond;
+        bool                done = false;
+        uint64_t            bytesRead = 0;
+    } result;
+    auto names = MutableArray::newArray();
+    names.append("byNS"_sl);
+    CBLDatabase_Prewarm(db, names, 0, [](void* context, uint64_t bytesRead) {
+        auto r = (Result*)context;
+        lock_guard<mutex> lock(r->m);
+        r->bytesRead = bytesRead;
+        r->done = true;
+        r->cond.notify_one();
+    }, &result);
+    unique_lock<mutex> lock(result.m);
+    REQUIRE(result.cond.wait_for(lock, 30s, [&]{return result.done;}));
+    
+    // Index rows are the doc ID, `n` (8 bytes, also when missing) and `s`; document rows are
+    // the doc ID and the body's JSON:
+    uint64_t indexBytes = kWithKey * (8 + 8 + 1) + kWithoutKey * (10 + 8 + 1);
+    uint64_t docBytes = kWithKey * (8 + strlen(R"({"n":0,"s":"x"})"))
+                      + kWithoutKey * (10 + strlen(R"({"s":"x"})"));
+    CHECK(result.bytesRead == indexBytes + docBytes);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Trim Memory") {
+    // Reopen the database with the query cache enabled:
+    CBLError error;
+    CBLCollection_Release(defaultCollection);
+    REQUIRE(CBLDatabase_Close(db, &error));
+    CBLDatabase_Release(db);
+    CBLDatabaseConfiguration config = databaseConfig();
+    config.queryCacheSize = 4;
+    db = CBLDatabase_Open(kDatabaseName, &config, &error);
+    REQUIRE(db);
+    defaultCollection = CBLDatabase_DefaultCollection(db, &error);
+    REQUIRE(defaultCollection);
+    
+    for (slice str : {"SELECT name FROM _"_sl, "SELECT birthday FROM _"_sl,
+                      "SELECT gender FROM _"_sl, "SELECT likes FROM _"_sl}) {
+        CBLQuery* q = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, str, nullptr, &error);
+        REQUIRE(q);
+        CBLQuery_Release(q);
+    }
+    CHECK(CBLDatabase_QueryCacheStats(db).count == 4);
+    
+    // A released document's memory is kept for reuse by this thread:
+    CBLDocument_Release(CBLDocument_Create());
+    
+    CBLMemoryTrimStats stats = CBLDatabase_TrimMemory(db, kCBLMemoryTrimModerate);
+    CHECK(stats.queriesReleased == 2);
+    CHECK(stats.bytesFreed > 0);
+    CHECK(CBLDatabase_QueryCacheStats(db).count == 2);
+    
+    stats = CBLDatabase_TrimMemory(db, kCBLMemoryTrimCritical);
+    CHECK(stats.queriesReleased == 2);
+    CHECK(CBLDatabase_QueryCacheStats(db).count == 0);
+    
+    stats = CBL_TrimMemory(kCBLMemoryTrimCritical);
+    CHECK(stats.queriesReleased == 0);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Database Reader") {
+    CBLError error;
+    createDocWithPair(db, "doc1", "foo", "bar1");
+    
+    CBLDatabase* reader = CBLDatabase_AcquireReader(db, &error);
+    REQUIRE(reader);
+    CHECK(reader != db);
+    CBLCollection* readerCollection = CBLDatabase_DefaultCollection(reader, &error);
+    REQUIRE(readerCollection);
+    CHECK(CBLCollection_Count(readerCollection) == 1);
+    
+    // The reader sees only committed changes:
+    REQUIRE(CBLDatabase_BeginTransaction(db, &error));
+    createDocWithPair(db, "doc2", "foo", "bar2");
+    CHECK(CBLCollection_Count(readerCollection) == 1);
+    const CBLDocument* doc = CBLCollection_GetDocument(readerCollection, "doc2"_sl, &error);
+    CHECK(!doc);
+    REQUIRE(CBLDatabase_EndTransaction(db, true, &error));
+    CHECK(CBLCollection_Count(readerCollection) == 2);
+    doc = CBLCollection_GetDocument(readerCollection, "doc2"_sl, &error);
+    CHECK(doc);
+    CBLDocument_Release(doc);
+    
+    // It can't write:
+    {
+        ExpectingExceptions x;
+        CBLDocument* newDoc = CBLDocument_CreateWithID("doc3"_sl);
+        CHECK(!CBLCollection_SaveDocument(readerCollection, newDoc, &error));
+        CheckError(error, kCBLErrorNotWriteable);
+        CBLDocument_Release(newDoc);
+    }
+    CBLCollection_Release(readerCollection);
+    
+    // A released reader is reused:
+    CBLDatabase_Release(reader);
+    CBLDatabase* reader2 = CBLDatabase_AcquireReader(db, &error);
+    CHECK(reader2 == reader);
+    CBLDatabase_Release(reader2);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Group Commit") {
+    auto config = databaseConfig();
+    config.groupCommitWindow = 20;
+    
+    auto dbname = "groupcommitdb"_sl;
+    CBL_DeleteDatabase(dbname, config.directory, nullptr);
+    CBLError error {};
+    CBLDatabase* groupDB = CBLDatabase_Open(dbname, &config, &error);
+    REQUIRE(groupDB);
+    CHECK(CBLDatabase_Config(groupDB).groupCommitWindow == 20);
+    CBLCollection* collection = CBLDatabase_DefaultCollection(groupDB, &error);
+    REQUIRE(collection);
+    
+    // Concurrent saves each get their own result:
+    static constexpr int kThreads = 8, kDocsPerThread = 10;
+    std::atomic<int> saved {0};
+    vector<thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kDocsPerThread; ++i) {
+                string docID = "doc-" + to_string(t) + "-" + to_string(i);
+                CBLDocument* doc = CBLDocument_CreateWithID(slice(docID));
+                FLMutableDict_SetInt(CBLDocument_MutableProperties(doc), "thread"_sl, t);
+                CBLError saveError {};
+                if (CBLCollection_SaveDocument(collection, doc, &saveError) && CBLDocument_RevisionID(doc))
+                    ++saved;
+                CBLDocument_Release(doc);
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    CHECK(saved == kThreads * kDocsPerThread);
+    CHECK(CBLCollection_Count(collection) == kThreads * kDocsPerThread);
+    
+    // A conflicting save fails by itself:
+    CBLDocument* doc1 = CBLCollection_GetMutableDocument(collection, "doc-0-0"_sl, &error);
+    CBLDocument* doc2 = CBLCollection_GetMutableDocument(collection, "doc-0-0"_sl, &error);
+    REQUIRE(doc1);
+    REQUIRE(doc2);
+    CHECK(CBLCollection_SaveDocument(collection, doc1, &error));
+    CHECK(!CBLCollection_SaveDocumentWithConcurrencyControl(collection, doc2,
+                                                             kCBLConcurrencyControlFailOnConflict, &error));
+    CheckError(error, kCBLErrorConflict);
+    CBLDocument_Release(doc1);
+    CBLDocument_Release(doc2);
+    
+    CBLCollection_Release(collection);
+    CHECK(CBLDatabase_Delete(groupDB, &error));
+    CBLDatabase_Release(groupDB);
+}
+
+
 #pragma mark - Transaction:
 
 
@@ -1094,3 +1681,121 @@ TEST_CASE_METHOD(DatabaseTest, "Use Deleted Database") {
     
     testInvalidDatabase();
 }
+
+TEST_CASE_METHOD(DatabaseTest, "Lock Timing Stats") {
+    CBL_SetLockTiming(true);
+    auto token = CBLCollection_AddChangeListener(defaultCollection, [](void*, const CBLCollectionChange*) { },
+                                                 nullptr);
+    createNumberedDocsWithPrefix(defaultCollection, 10, "doc-");
+    CBLListener_Remove(token);
+
+    CBLLockStats stats[16];
+    unsigned count = CBL_GetLockStats(stats, 16);
+    CBLLockWaitStats totals = CBL_LockWaitStats();
+    alloc_slice dump(CBL_DumpLockStats());
+    CBL_SetLockTiming(false);
+
+    REQUIRE(count >= 5);
+    uint64_t acquisitions = 0, storageAcquisitions = 0;
+    for (unsigned i = 0; i < count; ++i) {
+        uint64_t histogramTotal = 0;
+        for (auto n : stats[i].waitHistogram)
+            histogramTotal += n;
+        CHECK(histogramTotal == stats[i].acquisitions);
+        CHECK(stats[i].contended <= stats[i].acquisitions);
+        if (stats[i].name == "database"s || stats[i].name == "collection"s)
+            storageAcquisitions += stats[i].acquisitions;
+        else if (stats[i].name == "listeners"s)
+            CHECK(stats[i].acquisitions > 0);
+        acquisitions += stats[i].acquisitions;
+    }
+    CHECK(storageAcquisitions > 0);
+    CHECK(totals.acquisitions >= acquisitions);      // (Background threads may lock too)
+    CHECK(dump.containsBytes("\"collection\": {\"acquisitions\": "_sl));
+
+    // Disabling timing resets the stats:
+    CHECK(CBL_LockWaitStats().acquisitions == 0);
+}
+
+TEST_CASE_METHOD(DatabaseTest, "Memory Stats") {
+    createDocWithPair(defaultCollection, "doc1", "greeting", "hello");
+    CBLMemoryStats before = CBL_GetMemoryStats();
+    CHECK(before.databases.count >= 1);
+    CHECK(before.databases.bytes > 0);
+
+    CBLError error;
+    const CBLDocument* doc = CBLCollection_GetDocument(defaultCollection, "doc1"_sl, &error);
+    REQUIRE(doc);
+    string content(10000, 'x');
+    CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, slice(content));
+    int errPos;
+    CBLQuery* query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, "SELECT greeting FROM _"_sl,
+                                              &errPos, &error);
+    REQUIRE(query);
+    CBLResultSet* results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    CHECK(CBLResultSet_Next(results));
+
+    CBLMemoryStats during = CBL_GetMemoryStats();
+    CHECK(during.documents.count == before.documents.count + 1);
+    CHECK(during.documents.bytes > before.documents.bytes);
+    CHECK(during.blobs.count == before.blobs.count + 1);
+    CHECK(during.blobs.bytes >= before.blobs.bytes + content.size());
+    CHECK(during.resultSets.count == before.resultSets.count + 1);
+    CHECK(during.resultSets.bytes > before.resultSets.bytes);
+    CHECK(during.totalObjects > before.totalObjects);
+
+    CBLResultSet_Release(results);
+    CBLQuery_Release(query);
+    CBLBlob_Release(blob);
+    CBLDocument_Release(doc);
+
+    CBLMemoryStats after = CBL_GetMemoryStats();
+    CHECK(after.documents.count == before.documents.count);
+    CHECK(after.documents.bytes == before.documents.bytes);
+    CHECK(after.blobs.count == before.blobs.count);
+    CHECK(after.blobs.bytes == before.blobs.bytes);
+    CHECK(after.resultSets.count == before.resultSets.count);
+
+    // Tracking records the objects created while it's on, until they're freed:
+    CBL_SetMemoryTracking(true);
+    doc = CBLCollection_GetDocument(defaultCollection, "doc1"_sl, &error);
+    REQUIRE(doc);
+    CBL_SetMemoryTracking(false);
+    CHECK(CBL_DumpTrackedObjects() == 1);
+    CBLDocument_Release(doc);
+    CHECK(CBL_DumpTrackedObjects() == 0);
+}
+
+
+TEST_CASE_METHOD(DatabaseTest, "Thread Pool Configuration") {
+    ExpectingExceptions x;
+    CBLError error {};
+    CBLThreadPoolConfiguration config {};
+    config.workerCount = kCBLMaxThreadPoolWorkers + 1;
+    CHECK(!CBL_ConfigureThreadPool(&config, &error));
+    CheckError(error, kCBLErrorInvalidParameter);
+
+    // Once background work has run, it's too late to configure the threads:
+    struct Result {
+        mutex               m;
+        condition_variable  cond;
+        bool                done = false;
+    } result;
+    CBLDatabase_Prewarm(db, nullptr, 0, [](void* context, uint64_t) {
+        auto r = (Result*)context;
+        lock_guard<mutex> lock(r->m);
+        r->done = true;
+        r->cond.notify_one();
+    }, &result);
+    {
+        unique_lock<mutex> lock(result.m);
+        REQUIRE(result.cond.wait_for(lock, 10s, [&]{return result.done;}));
+    }
+
+    config.workerCount = 2;
+    config.priority = kCBLThreadPriorityLow;
+    error = {};
+    CHECK(!CBL_ConfigureThreadPool(&config, &error));
+    CheckError(error, kCBLErrorUnsupported);
+}
@@ -20,7 +20,12 @@
 #include "CBLPrivate.h"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <vector>
 
 using namespace fleece;
 using namespace std;
@@ -326,6 +331,28 @@ TEST_CASE_METHOD(DocumentTest, "Get Non Existing Document") {
     CHECK(error.code == 0);
 }
 
+TEST_CASE_METHOD(DocumentTest, "Get Documents in Batch", "[Document]") {
+    createDocument(col, "foo", "greeting", "Howdy!");
+    createDocument(col, "bar", "greeting", "Hello!");
+    createDocument(col, "baz", "greeting", "Hi!");
+    
+    CBLError error;
+    CHECK(CBLCollection_DeleteDocumentByID(col, "baz"_sl, &error));
+    
+    FLString docIDs[4] = {"foo"_sl, "missing"_sl, "baz"_sl, "bar"_sl};
+    const CBLDocument* docs[4];
+    REQUIRE(CBLCollection_GetDocuments(col, docIDs, 4, docs, &error));
+    REQUIRE(docs[0]);
+    CHECK(CBLDocument_ID(docs[0]) == "foo"_sl);
+    CHECK(Dict(CBLDocument_Properties(docs[0])).toJSONString() == "{\"greeting\":\"Howdy!\"}");
+    CHECK(docs[1] == nullptr);
+    CHECK(docs[2] == nullptr);
+    REQUIRE(docs[3]);
+    CHECK(CBLDocument_ID(docs[3]) == "bar"_sl);
+    CHECK(CBLDocument_Collection(docs[3]) == col);
+    CBLDocument_ReleaseAll(docs, 4);
+}
+
 TEST_CASE_METHOD(DocumentTest, "Get Document with Empty ID", "[Document]") {
     CBLError error;
     ExpectingExceptions x;
@@ -420,6 +447,107 @@ TEST_CASE_METHOD(DocumentTest, "Save Document Twice", "[Document]") {
     CBLDocument_Release(savedDoc);
 }
 
+TEST_CASE_METHOD(DocumentTest, "Save Small Change to Large Document", "[Document]") {
+    // Large enough for the changes to be encoded as a delta to the saved revision:
+    constexpr int kNumKeys = 1000;
+    const string filler(50, 'x');
+    {
+        CBLDocument* doc = CBLDocument_CreateWithID("foo"_sl);
+        FLMutableDict props = CBLDocument_MutableProperties(doc);
+        for (int i = 0; i < kNumKeys; ++i)
+            FLMutableDict_SetString(props, slice("key" + to_string(i)), slice(filler));
+        FLMutableDict_SetInt(props, "counter"_sl, 0);
+        CBLError error;
+        REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+        CBLDocument_Release(doc);
+    }
+    
+    for (int n = 1; n <= 3; ++n) {
+        CBLError error;
+        CBLDocument* doc = CBLCollection_GetMutableDocument(col, "foo"_sl, &error);
+        REQUIRE(doc);
+        FLMutableDict props = CBLDocument_MutableProperties(doc);
+        FLMutableDict_SetInt(props, "counter"_sl, n);
+        REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+        CBLDocument_Release(doc);
+    }
+    
+    CBLError error;
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "foo"_sl, &error);
+    REQUIRE(doc);
+    Dict props = CBLDocument_Properties(doc);
+    CHECK(props.count() == kNumKeys + 1);
+    CHECK(props["counter"].asInt() == 3);
+    CHECK(props["key0"].asString() == slice(filler));
+    CHECK(props["key999"].asString() == slice(filler));
+    CBLDocument_Release(doc);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Repeated Saves Keep Document Body Bounded", "[Document]") {
+    constexpr int kNumKeys = 1000;
+    const string filler(50, 'x');
+    {
+        CBLDocument* doc = CBLDocument_CreateWithID("foo"_sl);
+        FLMutableDict props = CBLDocument_MutableProperties(doc);
+        for (int i = 0; i < kNumKeys; ++i)
+            FLMutableDict_SetString(props, slice("key" + to_string(i)), slice(filler));
+        CBLError error;
+        REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+        CBLDocument_Release(doc);
+    }
+
+    // The memory stats count a loaded document's revision body:
+    auto loadedBytes = [&] {
+        CBLError error;
+        const CBLDocument* doc = CBLCollection_GetDocument(col, "foo"_sl, &error);
+        REQUIRE(doc);
+        uint64_t bytes = CBL_GetMemoryStats().documents.bytes;
+        CBLDocument_Release(doc);
+        return bytes;
+    };
+    uint64_t initialBytes = loadedBytes();
+
+    // Each save replaces a large value; its old copy is left behind in a delta-encoded body,
+    // so without an occasional full re-encode the body would grow by ~200KB here:
+    for (int n = 1; n <= 200; ++n) {
+        CBLError error;
+        CBLDocument* doc = CBLCollection_GetMutableDocument(col, "foo"_sl, &error);
+        REQUIRE(doc);
+        FLMutableDict props = CBLDocument_MutableProperties(doc);
+        FLMutableDict_SetString(props, "big"_sl, slice(string(1000, char('a' + n % 26))));
+        FLMutableDict_SetInt(props, "counter"_sl, n);
+        REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+        CBLDocument_Release(doc);
+    }
+
+    CHECK(loadedBytes() < 3 * initialBytes);
+
+    CBLError error;
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "foo"_sl, &error);
+    REQUIRE(doc);
+    Dict props = CBLDocument_Properties(doc);
+    CHECK(props.count() == kNumKeys + 2);
+    CHECK(props["counter"].asInt() == 200);
+    CHECK(props["big"].asString() == slice(string(1000, char('a' + 200 % 26))));
+    CHECK(props["key999"].asString() == slice(filler));
+    CBLDocument_Release(doc);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Reused Document Allocations", "[Document]") {
+    createDocWithPair(col, "foo", "greeting", "Howdy!");
+    
+    // Documents read and released in a loop should reuse the memory of the previous one:
+    constexpr int kIterations = 1000;
+    uint64_t heapAllocations = CBLDocument_HeapAllocationCount();
+    for (int i = 0; i < kIterations; ++i) {
+        CBLError error;
+        const CBLDocument* doc = CBLCollection_GetDocument(col, "foo"_sl, &error);
+        REQUIRE(doc);
+        CBLDocument_Release(doc);
+    }
+    CHECK(CBLDocument_HeapAllocationCount() - heapAllocations <= 1);
+}
+
 TEST_CASE_METHOD(DocumentTest, "Save Document with LastWriteWin", "[Document]") {
     CBLDocument* doc = CBLDocument_CreateWithID("foo"_sl);
     FLMutableDict props = CBLDocument_MutableProperties(doc);
@@ -700,6 +828,372 @@ TEST_CASE_METHOD(DocumentTest, "Save Document into Different Collection", "[Docu
     CBLDocument_Release(doc);
 }
 
+TEST_CASE_METHOD(DocumentTest, "Save Documents in Batch", "[Document]") {
+    static constexpr size_t kNumDocs = 100;
+    vector<CBLDocument*> docs;
+    for (size_t i = 0; i < kNumDocs; i++) {
+        char docID[20];
+        snprintf(docID, sizeof(docID), "doc-%03zu", i);
+        CBLDocument* doc = CBLDocument_CreateWithID(slice(docID));
+        FLMutableDict_SetInt(CBLDocument_MutableProperties(doc), "n"_sl, int64_t(i));
+        docs.push_back(doc);
+    }
+    
+    vector<CBLError> results(kNumDocs);
+    CBLError error;
+    REQUIRE(CBLCollection_SaveDocuments(col, docs.data(), kNumDocs,
+                                        kCBLConcurrencyControlFailOnConflict,
+                                        results.data(), &error));
+    CHECK(CBLCollection_Count(col) == kNumDocs);
+    CHECK(CBLCollection_LastSequence(col) == kNumDocs);
+    for (size_t i = 0; i < kNumDocs; i++) {
+        CHECK(results[i].code == 0);
+        CHECK(CBLDocument_Sequence(docs[i]) == i + 1);
+        CHECK(CBLDocument_Collection(docs[i]) == col);
+    }
+    
+    for (auto doc : docs)
+        CBLDocument_Release(doc);
+    
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "doc-042"_sl, &error);
+    REQUIRE(doc);
+    CHECK(Dict(CBLDocument_Properties(doc))["n"].asInt() == 42);
+    CBLDocument_Release(doc);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Save Documents in Batch with Conflict", "[Document]") {
+    createDocument(col, "foo", "greeting", "Howdy!");
+    
+    CBLError error;
+    CBLDocument* stale = CBLCollection_GetMutableDocument(col, "foo"_sl, &error);
+    REQUIRE(stale);
+    createDocument(col, "bar", "greeting", "Hello!");
+    {
+        CBLDocument* foo = CBLCollection_GetMutableDocument(col, "foo"_sl, &error);
+        FLMutableDict_SetString(CBLDocument_MutableProperties(foo), "name"_sl, "bob"_sl);
+        REQUIRE(CBLCollection_SaveDocument(col, foo, &error));
+        CBLDocument_Release(foo);
+    }
+    
+    FLMutableDict_SetString(CBLDocument_MutableProperties(stale), "name"_sl, "sally"_sl);
+    CBLDocument* fresh = CBLDocument_CreateWithID("baz"_sl);
+    CBLDocument* docs[2] = {stale, fresh};
+    
+    SECTION("FailOnConflict with Results") {
+        CBLError results[2];
+        REQUIRE(CBLCollection_SaveDocuments(col, docs, 2, kCBLConcurrencyControlFailOnConflict,
+                                            results, &error));
+        CHECK(results[0].domain == kCBLDomain);
+        CHECK(results[0].code == kCBLErrorConflict);
+        CHECK(results[1].code == 0);
+        CHECK(CBLCollection_Count(col) == 3);
+    }
+    
+    SECTION("FailOnConflict without Results") {
+        ExpectingExceptions x;
+        CHECK(!CBLCollection_SaveDocuments(col, docs, 2, kCBLConcurrencyControlFailOnConflict,
+                                           nullptr, &error));
+        CHECK(error.domain == kCBLDomain);
+        CHECK(error.code == kCBLErrorConflict);
+        CHECK(CBLCollection_Count(col) == 2);
+        CHECK(CBLDocument_Sequence(fresh) == 0);
+    }
+    
+    SECTION("LastWriteWins") {
+        CBLError results[2];
+        REQUIRE(CBLCollection_SaveDocuments(col, docs, 2, kCBLConcurrencyControlLastWriteWins,
+                                            results, &error));
+        CHECK(results[0].code == 0);
+        CHECK(results[1].code == 0);
+        CHECK(CBLCollection_Count(col) == 3);
+        
+        const CBLDocument* foo = CBLCollection_GetDocument(col, "foo"_sl, &error);
+        REQUIRE(foo);
+        CHECK(Dict(CBLDocument_Properties(foo)).toJSONString() == "{\"greeting\":\"Howdy!\",\"name\":\"sally\"}");
+        CBLDocument_Release(foo);
+    }
+    
+    CBLDocument_Release(stale);
+    CBLDocument_Release(fresh);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Save Documents Asynchronously", "[Document]") {
+    struct Completions {
+        mutex m;
+        condition_variable cond;
+        vector<string> docIDs;
+        vector<int> errorCodes;
+        
+        void wait(size_t count) {
+            unique_lock<mutex> lock(m);
+            cond.wait(lock, [&] {return docIDs.size() >= count;});
+        }
+    } completions;
+    
+    auto callback = [](void* context, const CBLDocument* doc, const CBLError* error) {
+        auto c = (Completions*)context;
+        lock_guard<mutex> lock(c->m);
+        c->docIDs.push_back(string(slice(CBLDocument_ID(doc))));
+        c->errorCodes.push_back(error ? error->code : 0);
+        c->cond.notify_all();
+    };
+    
+    static constexpr size_t kNumDocs = 50;
+    vector<CBLDocument*> docs;
+    CBLError error;
+    for (size_t i = 0; i < kNumDocs; i++) {
+        char docID[20];
+        snprintf(docID, sizeof(docID), "doc-%03zu", i);
+        CBLDocument* doc = CBLDocument_CreateWithID(slice(docID));
+        FLMutableDict_SetInt(CBLDocument_MutableProperties(doc), "n"_sl, int64_t(i));
+        REQUIRE(CBLCollection_SaveDocumentAsync(col, doc, kCBLConcurrencyControlFailOnConflict,
+                                                callback, &completions, &error));
+        docs.push_back(doc);
+    }
+    completions.wait(kNumDocs);
+    CHECK(CBLCollection_Count(col) == kNumDocs);
+    for (size_t i = 0; i < kNumDocs; i++) {
+        // Callbacks are called in the order the writes were queued:
+        CHECK(completions.docIDs[i] == string(slice(CBLDocument_ID(docs[i]))));
+        CHECK(completions.errorCodes[i] == 0);
+        CHECK(CBLDocument_Sequence(docs[i]) > 0);
+    }
+    
+    // A conflict is reported to the callback:
+    CBLDocument* stale = CBLCollection_GetMutableDocument(col, "doc-000"_sl, &error);
+    REQUIRE(stale);
+    REQUIRE(CBLCollection_SaveDocument(col, docs[0], &error));
+    REQUIRE(CBLCollection_SaveDocumentAsync(col, stale, kCBLConcurrencyControlFailOnConflict,
+                                            callback, &completions, &error));
+    REQUIRE(CBLCollection_DeleteDocumentAsync(col, docs[1], kCBLConcurrencyControlFailOnConflict,
+                                              callback, &completions, &error));
+    completions.wait(kNumDocs + 2);
+    CHECK(completions.errorCodes[kNumDocs] == kCBLErrorConflict);
+    CHECK(completions.errorCodes[kNumDocs + 1] == 0);
+    CHECK(CBLCollection_Count(col) == kNumDocs - 1);
+    CBLDocument_Release(stale);
+    
+    // An immutable document can't be saved:
+    {
+        ExpectingExceptions x;
+        const CBLDocument* immutable = CBLCollection_GetDocument(col, "doc-002"_sl, &error);
+        REQUIRE(immutable);
+        CHECK(!CBLCollection_SaveDocumentAsync(col, const_cast<CBLDocument*>(immutable),
+                                               kCBLConcurrencyControlLastWriteWins,
+                                               callback, &completions, &error));
+        CHECK(error.code == kCBLErrorNotWriteable);
+        CBLDocument_Release(immutable);
+    }
+    
+    for (auto doc : docs)
+        CBLDocument_Release(doc);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Save Documents Asynchronously with Limit", "[Document]") {
+    auto config = databaseConfig();
+    config.asyncWriteLimit = 5;
+    
+    auto dbname = "asyncwritedb"_sl;
+    CBL_DeleteDatabase(dbname, config.directory, nullptr);
+    CBLError error {};
+    CBLDatabase* asyncDB = CBLDatabase_Open(dbname, &config, &error);
+    REQUIRE(asyncDB);
+    CHECK(CBLDatabase_Config(asyncDB).asyncWriteLimit == 5);
+    CBLCollection* collection = CBLDatabase_DefaultCollection(asyncDB, &error);
+    REQUIRE(collection);
+    
+    // Block the writer in the first write's callback, so that later writes stay queued:
+    struct Gate {
+        mutex m;
+        condition_variable cond;
+        bool entered = false, open = false;
+    } gate;
+    auto blockingCallback = [](void* context, const CBLDocument*, const CBLError*) {
+        auto g = (Gate*)context;
+        unique_lock<mutex> lock(g->m);
+        g->entered = true;
+        g->cond.notify_all();
+        g->cond.wait(lock, [&] {return g->open;});
+    };
+    
+    vector<CBLDocument*> docs;
+    docs.push_back(CBLDocument_CreateWithID("first"_sl));
+    REQUIRE(CBLCollection_SaveDocumentAsync(collection, docs[0], kCBLConcurrencyControlLastWriteWins,
+                                            blockingCallback, &gate, &error));
+    {
+        unique_lock<mutex> lock(gate.m);
+        gate.cond.wait(lock, [&] {return gate.entered;});
+    }
+    
+    size_t queued = 0;
+    {
+        ExpectingExceptions x;
+        for (int i = 0; i < 10; i++) {
+            CBLDocument* doc = CBLDocument_CreateWithID(slice("doc-" + to_string(i)));
+            docs.push_back(doc);
+            if (CBLCollection_SaveDocumentAsync(collection, doc, kCBLConcurrencyControlLastWriteWins,
+                                                nullptr, nullptr, &error)) {
+                ++queued;
+            } else {
+                CHECK(error.domain == kCBLDomain);
+                CHECK(error.code == kCBLErrorBusy);
+            }
+        }
+    }
+    CHECK(queued == 5);
+    {
+        lock_guard<mutex> lock(gate.m);
+        gate.open = true;
+        gate.cond.notify_all();
+    }
+    
+    // Closing the database waits for the queued writes:
+    REQUIRE(CBLDatabase_Close(asyncDB, &error));
+    CBLCollection_Release(collection);
+    CBLDatabase_Release(asyncDB);
+    asyncDB = CBLDatabase_Open(dbname, &config, &error);
+    REQUIRE(asyncDB);
+    collection = CBLDatabase_DefaultCollection(asyncDB, &error);
+    CHECK(CBLCollection_Count(collection) == queued + 1);
+    
+    for (auto doc : docs)
+        CBLDocument_Release(doc);
+    CBLCollection_Release(collection);
+    CHECK(CBLDatabase_Delete(asyncDB, &error));
+    CBLDatabase_Release(asyncDB);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Save Document from JSON", "[Document]") {
+    CBLError error;
+    REQUIRE(CBLCollection_SaveJSON(col, "foo"_sl, "{\"greeting\":\"Howdy!\"}"_sl,
+                                   kCBLConcurrencyControlFailOnConflict, &error));
+    CHECK(CBLCollection_Count(col) == 1);
+    
+    auto checkGreeting = [&](slice greeting) {
+        const CBLDocument* doc = CBLCollection_GetDocument(col, "foo"_sl, &error);
+        REQUIRE(doc);
+        CHECK(Dict(CBLDocument_Properties(doc))["greeting"].asString() == greeting);
+        CBLDocument_Release(doc);
+    };
+    
+    SECTION("FailOnConflict") {
+        CHECK(!CBLCollection_SaveJSON(col, "foo"_sl, "{\"greeting\":\"Hello!\"}"_sl,
+                                      kCBLConcurrencyControlFailOnConflict, &error));
+        CHECK(error.domain == kCBLDomain);
+        CHECK(error.code == kCBLErrorConflict);
+        checkGreeting("Howdy!"_sl);
+    }
+    
+    SECTION("LastWriteWins") {
+        REQUIRE(CBLCollection_SaveJSON(col, "foo"_sl, "{\"greeting\":\"Hello!\"}"_sl,
+                                       kCBLConcurrencyControlLastWriteWins, &error));
+        CHECK(CBLCollection_Count(col) == 1);
+        checkGreeting("Hello!"_sl);
+    }
+    
+    SECTION("Invalid JSON") {
+        ExpectingExceptions x;
+        CHECK(!CBLCollection_SaveJSON(col, "bar"_sl, "{\"greeting\":"_sl,
+                                      kCBLConcurrencyControlLastWriteWins, &error));
+        CHECK(error.domain == kCBLFleeceDomain);
+        CHECK(!CBLCollection_SaveJSON(col, "bar"_sl, "[1, 2, 3]"_sl,
+                                      kCBLConcurrencyControlLastWriteWins, &error));
+        CHECK(error.domain == kCBLDomain);
+        CHECK(error.code == kCBLErrorInvalidParameter);
+        CHECK(CBLCollection_Count(col) == 1);
+    }
+}
+
+TEST_CASE_METHOD(DocumentTest, "Import JSON Lines", "[Document]") {
+    CBLError error;
+    string path = string(databaseDir()) + "/import.jsonl";
+    auto writeFile = [&](unsigned count, const char *lastLine) {
+        ofstream out(path, ios::trunc);
+        for (unsigned i = 1; i <= count; ++i) {
+            out << "{\"id\":\"doc-" << i << "\",\"n\":" << i << "}\n";
+            if (i == 10)
+                out << "\n";
+        }
+        if (lastLine)
+            out << lastLine << "\n";
+    };
+    writeFile(250, nullptr);
+    
+    CBLValueIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "n"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(col, "byNumber"_sl, index, &error));
+    
+    CBLImportOptions options = {};
+    options.batchSize = 100;
+    options.threads = 2;
+    vector<CBLImportProgress> reports;
+    auto callback = [](void *context, const CBLImportProgress *progress) {
+        ((vector<CBLImportProgress>*)context)->push_back(*progress);
+        return true;
+    };
+    CBLImportProgress progress;
+    REQUIRE(CBLCollection_ImportJSONLines(col, slice(path), "id"_sl, &options, callback, &reports,
+                                          &progress, &error));
+    CHECK(progress.documentsImported == 250);
+    CHECK(progress.documentsSkipped == 0);
+    CHECK(progress.bytesRead == progress.totalBytes);
+    CHECK(progress.documentsPerSecond > 0);
+    REQUIRE(reports.size() == 3);
+    CHECK(reports[0].documentsImported == 100);
+    CHECK(reports[0].bytesRead < reports[1].bytesRead);
+    CHECK(CBLCollection_Count(col) == 250);
+    
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "doc-42"_sl, &error);
+    REQUIRE(doc);
+    CHECK(Dict(CBLDocument_Properties(doc))["n"].asInt() == 42);
+    CBLDocument_Release(doc);
+    
+    // The index was suspended during the import, and created again:
+    FLArray names = CBLCollection_GetIndexNames(col, &error);
+    REQUIRE(names);
+    CHECK(Array(names).count() == 1);
+    FLArray_Release(names);
+    
+    SECTION("FailOnConflict") {
+        options.concurrency = kCBLConcurrencyControlFailOnConflict;
+        REQUIRE(CBLCollection_ImportJSONLines(col, slice(path), "id"_sl, &options, nullptr, nullptr,
+                                              &progress, &error));
+        CHECK(progress.documentsImported == 0);
+        CHECK(progress.documentsSkipped == 250);
+    }
+    
+    SECTION("Generated IDs") {
+        REQUIRE(CBLCollection_ImportJSONLines(col, slice(path), nullslice, nullptr, nullptr, nullptr,
+                                              &progress, &error));
+        CHECK(progress.documentsImported == 250);
+        CHECK(CBLCollection_Count(col) == 500);
+    }
+    
+    SECTION("Stopped") {
+        auto stop = [](void*, const CBLImportProgress*) {return false;};
+        writeFile(350, nullptr);
+        REQUIRE(CBLCollection_ImportJSONLines(col, slice(path), "id"_sl, &options, stop, nullptr,
+                                              &progress, &error));
+        CHECK(progress.documentsImported == 100);
+        CHECK(CBLCollection_Count(col) == 250);
+    }
+    
+    SECTION("Invalid line") {
+        ExpectingExceptions x;
+        writeFile(300, "[1, 2, 3]");
+        CHECK(!CBLCollection_ImportJSONLines(col, slice(path), "id"_sl, &options, nullptr, nullptr,
+                                             &progress, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+        CHECK(progress.documentsImported == 300);
+        CHECK(CBLCollection_Count(col) == 300);
+        
+        CHECK(!CBLCollection_ImportJSONLines(col, "/nonexistent/file.jsonl"_sl, "id"_sl, nullptr,
+                                             nullptr, nullptr, nullptr, &error));
+        CheckError(error, kCBLErrorNotFound);
+    }
+}
+
 #pragma mark - Timestamp
 
 /*
@@ -989,6 +1483,93 @@ TEST_CASE_METHOD(DocumentTest, "Purge Document from Different Collection", "[Doc
     CBLDocument_Release(doc);
 }
 
+TEST_CASE_METHOD(DocumentTest, "Purge Documents in Batches", "[Document]") {
+    vector<string> ids;
+    for (int i = 0; i < 250; ++i) {
+        ids.push_back("doc-" + to_string(i));
+        createDocument(col, ids.back(), "foo", "bar");
+    }
+    ids.push_back("nonexistent");
+    vector<FLString> docIDs;
+    for (int i = 0; i < 200; ++i)
+        docIDs.push_back(slice(ids[i]));
+    docIDs.push_back(slice(ids.back()));
+    
+    vector<size_t> reports;
+    auto callback = [](void *context, size_t completed, size_t total) {
+        CHECK(total == 201);
+        ((vector<size_t>*)context)->push_back(completed);
+        return true;
+    };
+    CBLError error;
+    size_t purged = 0;
+    REQUIRE(CBLCollection_PurgeDocuments(col, docIDs.data(), docIDs.size(), 100, callback, &reports,
+                                         &purged, &error));
+    CHECK(purged == 200);
+    CHECK(reports == vector<size_t>{100, 200, 201});
+    CHECK(CBLCollection_Count(col) == 50);
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "doc-10"_sl, &error);
+    CHECK(!doc);
+    
+    // Stopping after the first batch:
+    for (int i = 0; i < 200; ++i)
+        createDocument(col, ids[i], "foo", "bar");
+    auto stop = [](void*, size_t, size_t) {return false;};
+    REQUIRE(CBLCollection_PurgeDocuments(col, docIDs.data(), docIDs.size(), 100, stop, nullptr,
+                                         &purged, &error));
+    CHECK(purged == 100);
+    CHECK(CBLCollection_Count(col) == 150);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Delete Documents in Batches", "[Document]") {
+    vector<string> ids;
+    for (int i = 0; i < 250; ++i) {
+        ids.push_back("doc-" + to_string(i));
+        createDocument(col, ids.back(), "foo", "bar");
+    }
+    vector<FLString> docIDs;
+    for (int i = 0; i < 200; ++i)
+        docIDs.push_back(slice(ids[i]));
+    docIDs.push_back("nonexistent"_sl);
+    docIDs.push_back(slice(ids[0]));            // Already deleted by then
+
+    vector<size_t> reports;
+    auto callback = [](void *context, size_t completed, size_t total) {
+        CHECK(total == 202);
+        ((vector<size_t>*)context)->push_back(completed);
+        return true;
+    };
+    vector<CBLError> results(docIDs.size());
+    CBLError error;
+    size_t deleted = 0;
+    REQUIRE(CBLCollection_DeleteDocuments(col, docIDs.data(), docIDs.size(), 100,
+                                          kCBLConcurrencyControlFailOnConflict, callback, &reports,
+                                          results.data(), &deleted, &error));
+    CHECK(deleted == 200);
+    CHECK(reports == vector<size_t>{100, 200, 202});
+    CHECK(CBLCollection_Count(col) == 50);
+    CHECK(results[0].code == 0);
+    CHECK(results[199].code == 0);
+    CHECK(results[200].code == kCBLErrorNotFound);
+    CHECK(results[201].code == kCBLErrorNotFound);
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "doc-10"_sl, &error);
+    CHECK(!doc);
+
+    // Stopping after the first batch leaves the rest's results alone:
+    docIDs.clear();
+    for (int i = 200; i < 250; ++i)
+        docIDs.push_back(slice(ids[i]));
+    results.assign(docIDs.size(), CBLError{kCBLDomain, kCBLErrorUnexpectedError});
+    auto stop = [](void*, size_t, size_t) {return false;};
+    REQUIRE(CBLCollection_DeleteDocuments(col, docIDs.data(), docIDs.size(), 20,
+                                          kCBLConcurrencyControlLastWriteWins, stop, nullptr,
+                                          results.data(), &deleted, &error));
+    CHECK(deleted == 20);
+    CHECK(results[19].code == 0);
+    CHECK(results[20].code == kCBLErrorUnexpectedError);
+    CHECK(CBLCollection_Count(col) == 30);
+}
+
 #pragma mark - Document Expiry:
 
 TEST_CASE_METHOD(DocumentTest, "Document Expiration", "[Document][Expiry]") {
@@ -1047,6 +1628,150 @@ TEST_CASE_METHOD(DocumentTest, "Get and Set Expiration on Non Existing Doc", "[D
     CheckError(error, kCBLErrorNotFound);
 }
 
+TEST_CASE_METHOD(DocumentTest, "Set Document Expirations in Batches", "[Document][Expiry]") {
+    vector<string> ids;
+    for (int i = 0; i < 30; ++i) {
+        ids.push_back("doc-" + to_string(i));
+        createDocument(col, ids.back(), "foo", "bar");
+    }
+    ids.push_back("NonExistingDoc");
+    
+    CBLTimestamp future = CBL_Now() + 1000;
+    vector<FLString> docIDs;
+    vector<CBLTimestamp> expirations;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        docIDs.push_back(slice(ids[i]));
+        expirations.push_back((i % 2 == 0) ? future : 0);
+    }
+    
+    CBLError error;
+    size_t updated = 0;
+    REQUIRE(CBLCollection_SetDocumentExpirations(col, docIDs.data(), expirations.data(), docIDs.size(),
+                                                 7, nullptr, nullptr, &updated, &error));
+    CHECK(updated == 30);
+    CHECK(CBLCollection_GetDocumentExpiration(col, "doc-0"_sl, &error) == future);
+    CHECK(CBLCollection_GetDocumentExpiration(col, "doc-1"_sl, &error) == 0);
+    CHECK(CBLCollection_GetDocumentExpiration(col, "doc-28"_sl, &error) == future);
+    
+    this_thread::sleep_for(2000ms);
+    CHECK(CBLCollection_Count(col) == 15);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Append Documents and Purge by Prefix", "[Document]") {
+    createDocument(col, "sensorB:0005", "value", "existing");
+    
+    vector<string> ids;
+    vector<FLMutableDict> bodies;
+    for (const char* sensor : {"sensorA", "sensorB"}) {
+        for (int t = 0; t < 10; ++t) {
+            char id[32];
+            snprintf(id, sizeof(id), "%s:%04d", sensor, t);
+            ids.push_back(id);
+            FLMutableDict body = FLMutableDict_New();
+            FLMutableDict_SetInt(body, "t"_sl, t);
+            bodies.push_back(body);
+        }
+    }
+    vector<FLString> docIDs;
+    for (auto &id : ids)
+        docIDs.push_back(slice(id));
+    
+    // The existing document isn't replaced:
+    CBLError error;
+    size_t appended = 0;
+    REQUIRE(CBLCollection_AppendDocuments(col, docIDs.data(), (const FLDict*)bodies.data(),
+                                          docIDs.size(), 7, nullptr, nullptr, &appended, &error));
+    CHECK(appended == 19);
+    CHECK(CBLCollection_Count(col) == 20);
+    const CBLDocument* doc = CBLCollection_GetDocument(col, "sensorB:0005"_sl, &error);
+    REQUIRE(doc);
+    CHECK(Dict(CBLDocument_Properties(doc))["value"].asString() == "existing"_sl);
+    CBLDocument_Release(doc);
+    for (auto body : bodies)
+        FLMutableDict_Release(body);
+    
+    size_t purged = 0;
+    REQUIRE(CBLCollection_PurgeDocumentsWithPrefix(col, "sensorA:"_sl, 4, nullptr, nullptr,
+                                                   &purged, &error));
+    CHECK(purged == 10);
+    CHECK(CBLCollection_Count(col) == 10);
+    doc = CBLCollection_GetDocument(col, "sensorA:0003"_sl, &error);
+    CHECK(!doc);
+    doc = CBLCollection_GetDocument(col, "sensorB:0003"_sl, &error);
+    CHECK(doc);
+    CBLDocument_Release(doc);
+    
+    {
+        ExpectingExceptions x;
+        FLString emptyID = kFLSliceNull;
+        FLDict body = FLDict(FLMutableDict_New());
+        CHECK(!CBLCollection_AppendDocuments(col, &emptyID, &body, 1, 0, nullptr, nullptr,
+                                             &appended, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+        CHECK(appended == 0);
+        FLDict_Release(body);
+    }
+}
+
+TEST_CASE_METHOD(DocumentTest, "Expiration Sweeper", "[Document][Expiry]") {
+    vector<string> ids;
+    for (int i = 0; i < 20; ++i) {
+        ids.push_back("doc-" + to_string(i));
+        createDocument(col, ids.back(), "foo", "bar");
+    }
+    
+    CBLTimestamp soon = CBL_Now() + 500;
+    vector<FLString> docIDs;
+    vector<CBLTimestamp> expirations;
+    for (auto &id : ids) {
+        docIDs.push_back(slice(id));
+        expirations.push_back(soon);
+    }
+    
+    CBLError error;
+    size_t updated = 0;
+    REQUIRE(CBLCollection_SetDocumentExpirations(col, docIDs.data(), expirations.data(), docIDs.size(),
+                                                 0, nullptr, nullptr, &updated, &error));
+    
+    SECTION("Rate Limited") {
+        CBLExpirationSweeperOptions options = {};
+        options.maxPurgesPerSecond = 10;
+        options.chunkSize = 5;
+        options.scanIntervalMs = 60 * 1000;
+        CBLExpirationSweeper* sweeper = CBLCollection_StartExpirationSweeper(col, &options, &error);
+        REQUIRE(sweeper);
+        REQUIRE(CBLExpirationSweeper_Scan(sweeper, &error));
+        
+        // 20 documents in chunks of 5 at 10 per second are purged half a second apart:
+        CBLExpirationBacklog backlog = CBLExpirationSweeper_Backlog(sweeper);
+        CHECK(backlog.lastScan > 0);
+        CHECK(backlog.pendingDocuments == 20);
+        CHECK(backlog.nextPurge >= soon);
+        CHECK(backlog.backlogClearedAt - backlog.nextPurge >= 1500);
+        
+        set<CBLTimestamp> purgeTimes;
+        for (auto &id : ids) {
+            CBLTimestamp exp = CBLCollection_GetDocumentExpiration(col, slice(id), &error);
+            CHECK(exp >= soon);
+            purgeTimes.insert(exp);
+        }
+        CHECK(purgeTimes.size() == 4);
+        
+        CBLExpirationSweeper_Stop(sweeper);
+        CBLExpirationSweeper_Release(sweeper);
+    }
+    
+    SECTION("Invalid Window") {
+        CBLTimeWindow window = {1500, 60};
+        CBLExpirationSweeperOptions options = {};
+        options.windows = &window;
+        options.windowCount = 1;
+        ExpectingExceptions x;
+        CHECK(!CBLCollection_StartExpirationSweeper(col, &options, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+}
+
 #pragma mark - Blobs:
 
 TEST_CASE_METHOD(DocumentTest, "Set blob in document", "[Document][Blob]") {
@@ -1215,6 +1940,77 @@ TEST_CASE_METHOD(DocumentTest, "Set blob in array", "[Document][Blob]") {
     CBLDocument_Release(doc);
 }
 
+#pragma mark - Conflict-Free Values:
+
+TEST_CASE_METHOD(DocumentTest, "Conflict-Free Counter", "[Document]") {
+    CBLError error;
+    auto doc = CBLDocument_CreateWithID("counted"_sl);
+    auto props = CBLDocument_MutableProperties(doc);
+    REQUIRE(FLMutableDict_IncrementCounter(props, "likes"_sl, db, 1, &error));
+    REQUIRE(FLMutableDict_IncrementCounter(props, "likes"_sl, db, 2, &error));
+    CHECK(FLValue_IsCounter(FLDict_Get(props, "likes"_sl)));
+    CHECK(FLValue_GetCounterValue(FLDict_Get(props, "likes"_sl)) == 3);
+    REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+    CBLDocument_Release(doc);
+    
+    doc = CBLCollection_GetMutableDocument(col, "counted"_sl, &error);
+    REQUIRE(doc);
+    props = CBLDocument_MutableProperties(doc);
+    CHECK(FLValue_GetCounterValue(FLDict_Get(props, "likes"_sl)) == 3);
+    REQUIRE(FLMutableDict_IncrementCounter(props, "likes"_sl, db, 4, &error));
+    CHECK(FLValue_GetCounterValue(FLDict_Get(props, "likes"_sl)) == 7);
+    // One database's increments add up to one total:
+    CHECK(FLDict_Count(FLValue_AsDict(FLDict_Get(FLValue_AsDict(FLDict_Get(props, "likes"_sl)),
+                                                 "counts"_sl))) == 1);
+    
+    // Only counters can be incremented:
+    FLMutableDict_SetString(props, "name"_sl, "Zegpold"_sl);
+    {
+        ExpectingExceptions x;
+        CHECK(!FLMutableDict_IncrementCounter(props, "name"_sl, db, 1, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+    CHECK(!FLValue_IsCounter(FLDict_Get(props, "name"_sl)));
+    CHECK(FLValue_GetCounterValue(FLDict_Get(props, "name"_sl)) == 0);
+    CBLDocument_Release(doc);
+}
+
+TEST_CASE_METHOD(DocumentTest, "Conflict-Free Set", "[Document]") {
+    CBLError error;
+    auto doc = CBLDocument_CreateWithID("tagged"_sl);
+    auto props = CBLDocument_MutableProperties(doc);
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, db, "red"_sl, &error));
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, db, "green"_sl, &error));
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, db, "blue"_sl, &error));
+    REQUIRE(FLMutableDict_RemoveFromORSet(props, "tags"_sl, "green"_sl, &error));
+    REQUIRE(FLMutableDict_RemoveFromORSet(props, "tags"_sl, "purple"_sl, &error));
+    REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+    CBLDocument_Release(doc);
+    
+    doc = CBLCollection_GetMutableDocument(col, "tagged"_sl, &error);
+    REQUIRE(doc);
+    props = CBLDocument_MutableProperties(doc);
+    FLDict tags = FLValue_AsDict(FLDict_Get(props, "tags"_sl));
+    CHECK(FLDict_IsORSet(tags));
+    CHECK(FLDict_ORSetContains(tags, "red"_sl));
+    CHECK(!FLDict_ORSetContains(tags, "green"_sl));
+    FLMutableArray members = FLDict_GetORSetMembers(tags);
+    CHECK(Array(members).toJSONString() == R"(["blue","red"])");
+    FLMutableArray_Release(members);
+    
+    // Adding a removed member again works:
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, db, "green"_sl, &error));
+    CHECK(FLDict_ORSetContains(FLValue_AsDict(FLDict_Get(props, "tags"_sl)), "green"_sl));
+    
+    {
+        ExpectingExceptions x;
+        CHECK(!FLMutableDict_RemoveFromORSet(props, "nothing"_sl, "red"_sl, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+    CHECK(!FLDict_GetORSetMembers(props));
+    CBLDocument_Release(doc);
+}
+
 #pragma mark - Listeners:
 
 TEST_CASE_METHOD(DocumentTest, "Collection Change Notifications", "[Document]") {
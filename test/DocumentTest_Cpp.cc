@@ -85,6 +85,40 @@ TEST_CASE_METHOD(DocumentTest_Cpp, "C++ New Document with Auto ID", "[Document]"
     CHECK((doc.properties() == immDoc.properties()));
 }
 
+TEST_CASE_METHOD(DocumentTest_Cpp, "C++ Borrowed Document and Collection", "[Document]") {
+    unsigned instances = CBL_InstanceCount();
+    CBLDocument* cdoc = CBLDocument_CreateWithID("foo"_sl);
+    {
+        // A view of a C reference doesn't take ownership:
+        DocumentRef doc(cdoc);
+        CHECK(doc);
+        CHECK(doc->id() == "foo");
+        DocumentRef copy = doc;
+        CHECK(copy.ref() == cdoc);
+        
+        Document owned = doc.retained();
+        CHECK(owned.ref() == cdoc);
+    }
+    CHECK(Document(DocumentRef(cdoc)).id() == "foo");
+    CBLDocument_Release(cdoc);
+    CHECK(CBL_InstanceCount() == instances);
+    
+    // A view of a wrapper has the wrapper's API:
+    auto countDocs = [](BorrowedCollection col) {return col->count();};
+    MutableDocument doc1("doc1");
+    doc1["greeting"] = "hi";
+    defaultCollection.saveDocument(doc1);
+    CHECK(countDocs(defaultCollection) == 1);
+    
+    // detach() hands the reference over to the caller:
+    MutableDocument mdoc("bar");
+    CBLDocument* detached = mdoc.detach();
+    CHECK(!mdoc);
+    REQUIRE(detached);
+    CHECK(slice(CBLDocument_ID(detached)) == "bar"_sl);
+    CBLDocument_Release(detached);
+}
+
 TEST_CASE_METHOD(DocumentTest_Cpp, "C++ Mutable Copy Mutable Document", "[Document]") {
     MutableDocument doc("foo");
     doc["greeting"] = "Howdy!";
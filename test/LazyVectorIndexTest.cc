@@ -19,6 +19,9 @@
 #include "VectorSearchTest.hh"
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <functional>
+#include <thread>
 
 #ifdef VECTOR_SEARCH_TEST_ENABLED
 
@@ -767,6 +770,57 @@ TEST_CASE_METHOD(VectorSearchTest, "TestIndexUpdaterSetFloatArrayVectors", "[Vec
     CBLResultSet_Release(results);
 }
 
+/**
+ * TestIndexUpdaterSetVectorsInBulk
+ *
+ * Test that vectors set in bulk, from two threads on disjoint ranges, are all indexed.
+ */
+TEST_CASE_METHOD(VectorSearchTest, "TestIndexUpdaterSetVectorsInBulk", "[VectorSearch][LazyVectorIndex]") {
+    CBLError error {};
+    
+    CBLVectorIndexConfiguration config { kCBLN1QLLanguage, "word"_sl, 300, 8, true };
+    createWordsIndex(config);
+    
+    auto index = getWordsIndex();
+    auto updater = CBLQueryIndex_BeginUpdate(index, 10, &error);
+    REQUIRE(updater);
+    size_t count = CBLIndexUpdater_Count(updater);
+    REQUIRE(count == 10);
+    
+    // Collect the vectors contiguously, as a batch embedding model would return them:
+    vector<string> updatedWords {};
+    vector<float> vectors;
+    for (size_t i = 0; i < count; i++) {
+        auto word = FLValue_AsString(CBLIndexUpdater_Value(updater, i));
+        auto vector = vectorForWord(word);
+        REQUIRE(vector.size() == 300);
+        vectors.insert(vectors.end(), vector.begin(), vector.end());
+        updatedWords.push_back(slice(word).asString());
+    }
+    
+    bool ok1 = false, ok2 = false;
+    thread t1([&] { ok1 = CBLIndexUpdater_SetVectors(updater, 0, &vectors[0], 5, 300, nullptr); });
+    thread t2([&] { ok2 = CBLIndexUpdater_SetVectors(updater, 5, &vectors[5 * 300], 5, 300, nullptr); });
+    t1.join();
+    t2.join();
+    CHECK(ok1);
+    CHECK(ok2);
+    
+    CHECK(CBLIndexUpdater_Finish(updater, &error));
+    CheckNoError(error);
+    CBLIndexUpdater_Release(updater);
+    CBLQueryIndex_Release(index);
+    
+    // Query:
+    auto results = executeWordsQuery(300, "word");
+    auto words = wordResults(results);
+    CHECK(words.size() == 10);
+    for (auto& word : updatedWords) {
+        CHECK(find(words.begin(), words.end(), word) != words.end());
+    }
+    CBLResultSet_Release(results);
+}
+
 /**
  * 20. TestIndexUpdaterSetInvalidVectorDimensions
  *
@@ -1171,4 +1225,106 @@ TEST_CASE_METHOD(VectorSearchTest, "TestIndexUpdaterUseAfterFinished", "[VectorS
     CBLQueryIndex_Release(index);
 }
 
+/**
+ * TestLazyIndexWorker
+ *
+ * Description
+ * Test that a CBLLazyIndexWorker updates a lazy vector index in batches until it has caught up,
+ * using its embedder to compute the vectors, and that a failing embedder leaves the index stale.
+ */
+TEST_CASE_METHOD(VectorSearchTest, "TestLazyIndexWorker", "[VectorSearch][LazyVectorIndex]") {
+    CBLError error {};
+    
+    CBLVectorIndexConfiguration config { kCBLN1QLLanguage, "word"_sl, 300, 8, true };
+    createWordsIndex(config);
+    auto index = getWordsIndex();
+    
+    struct Context {
+        VectorSearchTest* test;
+        bool fail;
+        atomic<int> calls {0};
+    } context {this, false};
+    
+    auto embedder = [](void* ctx, const FLValue values[], size_t count, size_t dimension,
+                       float vectors[], bool hasVector[]) -> bool {
+        auto context = (Context*)ctx;
+        ++context->calls;
+        if (context->fail)
+            return false;
+        for (size_t i = 0; i < count; i++) {
+            auto vector = context->test->vectorForWord(FLValue_AsString(values[i]));
+            hasVector[i] = (vector.size() == dimension);
+            if (hasVector[i])
+                copy(vector.begin(), vector.end(), &vectors[i * dimension]);
+        }
+        return true;
+    };
+    
+    auto waitFor = [](CBLLazyIndexWorker* worker, function<bool(const CBLLazyIndexWorkerStats&)> fn) {
+        for (int i = 0; i < 1000; i++) {
+            if (fn(CBLLazyIndexWorker_Stats(worker)))
+                return true;
+            this_thread::sleep_for(10ms);
+        }
+        return false;
+    };
+    
+    CBLLazyIndexWorkerConfiguration workerConfig {};
+    workerConfig.embedder = embedder;
+    workerConfig.context = &context;
+    workerConfig.dimension = 300;
+    workerConfig.batchSize = 100;
+    
+    SECTION("Catch Up") {
+        auto worker = CBLLazyIndexWorker_Create(index, &workerConfig, &error);
+        REQUIRE(worker);
+        CBLLazyIndexWorker_Start(worker);
+        CHECK(waitFor(worker, [](auto &stats) { return stats.caughtUp; }));
+        CBLLazyIndexWorker_Stop(worker);
+        
+        auto stats = CBLLazyIndexWorker_Stats(worker);
+        CHECK(stats.documentsIndexed == 300);
+        CHECK(stats.batchCount == 3);
+        CHECK(stats.failedBatchCount == 0);
+        CHECK(stats.pendingChanges == 0);
+        CHECK(stats.documentsPerSecond > 0);
+        CBLLazyIndexWorker_Release(worker);
+        
+        auto updater = CBLQueryIndex_BeginUpdate(index, 100, &error);
+        CHECK(!updater);
+        CheckNoError(error);
+        
+        auto results = executeWordsQuery(300, "word");
+        CHECK(wordResults(results).size() == 300);
+        CBLResultSet_Release(results);
+    }
+    
+    SECTION("Failing Embedder") {
+        context.fail = true;
+        auto worker = CBLLazyIndexWorker_Create(index, &workerConfig, &error);
+        REQUIRE(worker);
+        CBLLazyIndexWorker_Start(worker);
+        CHECK(waitFor(worker, [](auto &stats) { return stats.failedBatchCount > 0; }));
+        
+        // The failed batch isn't retried until the collection changes:
+        this_thread::sleep_for(100ms);
+        CBLLazyIndexWorker_Stop(worker);
+        auto stats = CBLLazyIndexWorker_Stats(worker);
+        CHECK(stats.failedBatchCount == 1);
+        CHECK(stats.documentsIndexed == 0);
+        CHECK(!stats.caughtUp);
+        CHECK(context.calls == 1);
+        CBLLazyIndexWorker_Release(worker);
+    }
+    
+    SECTION("Invalid Configuration") {
+        workerConfig.embedder = nullptr;
+        ExpectingExceptions x;
+        CHECK(!CBLLazyIndexWorker_Create(index, &workerConfig, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+    
+    CBLQueryIndex_Release(index);
+}
+
 #endif
@@ -19,9 +19,13 @@
 #include "CBLTest.hh"
 #include "cbl/CouchbaseLite.h"
 #include "fleece/Fleece.hh"
+#include <algorithm>
 #include <array>
+#include <chrono>
 #include <dirent.h>
+#include <map>
 #include <sys/stat.h>
+#include <thread>
 
 #ifndef _MSC_VER
 #include <unistd.h>
@@ -77,8 +81,11 @@ public:
         }
         
         // Reset log callback:
+        CBLLog_SetAsync(nullptr);
+        CBLLog_SetStructuredCallback(nullptr);
         CBLLog_SetCallback(nullptr);
         CBLLog_SetCallbackLevel(kCBLLogNone);
+        CBL_SetTraceCallback(nullptr, nullptr);
     }
     
     void prepareLogDir() {
@@ -329,3 +336,283 @@ TEST_CASE_METHOD(LogTest, "Log Message", "[Log]") {
     CHECK(recs[0] == "foo bar");
     CHECK(recs[1] == "hello world");
 }
+
+
+TEST_CASE_METHOD(LogTest, "Async Logging", "[Log][CustomLog]") {
+    static vector<string> recs;
+    static thread::id callbackThread;
+    recs.clear();
+    CBLLog_SetCallback([](CBLLogDomain domain, CBLLogLevel level, FLString msg) {
+        callbackThread = this_thread::get_id();
+        recs.push_back(string(msg));
+    });
+    CBLLog_SetCallbackLevel(kCBLLogInfo);
+    
+    CBLLogAsyncOptions options = {};
+    CBLLog_SetAsync(&options);
+    for (int i = 0; i < 100; ++i)
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "message %d", i);
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogVerbose, "not logged");
+    CBLLog_Flush();
+    
+    // The messages arrive in order, on another thread:
+    REQUIRE(recs.size() == 100);
+    for (int i = 0; i < 100; ++i)
+        CHECK(recs[i] == "message " + to_string(i));
+    CHECK(callbackThread != this_thread::get_id());
+    CHECK(CBLLog_DroppedMessageCount() == 0);
+    
+    // Messages longer than the formatting buffer:
+    recs.clear();
+    string longMessage(1000, 'x');
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "%s", longMessage.c_str());
+    CBLLog_Flush();
+    REQUIRE(recs.size() == 1);
+    CHECK(recs[0] == longMessage);
+    
+    // When the buffer is full, messages are dropped and counted:
+    SECTION("Drop Newest") {
+        options.dropPolicy = kCBLLogDropNewest;
+    }
+    SECTION("Drop Oldest") {
+        options.dropPolicy = kCBLLogDropOldest;
+    }
+    options.capacity = 4;
+    CBLLog_SetAsync(&options);
+    CBLLog_SetCallback([](CBLLogDomain domain, CBLLogLevel level, FLString msg) {
+        this_thread::sleep_for(chrono::milliseconds(20));
+        recs.push_back(string(msg));
+    });
+    recs.clear();
+    for (int i = 0; i < 20; ++i)
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "message %d", i);
+    CBLLog_Flush();
+    CHECK(CBLLog_DroppedMessageCount() > 0);
+    CHECK(recs.size() + CBLLog_DroppedMessageCount() == 20);
+    if (options.dropPolicy == kCBLLogDropOldest)
+        CHECK(recs.back() == "message 19");
+    else
+        CHECK(recs.front() == "message 0");
+    
+    // Turning async logging off delivers on the logging thread again:
+    CBLLog_SetAsync(nullptr);
+    recs.clear();
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "sync");
+    REQUIRE(recs.size() == 1);
+    CHECK(recs[0] == "sync");
+}
+
+
+TEST_CASE_METHOD(LogTest, "Structured Logging", "[Log][CustomLog]") {
+    struct Record {
+        CBLLogDomain domain;
+        CBLLogLevel level;
+        uint64_t timestamp;
+        string format;
+        vector<CBLLogArg> args;
+        vector<string> strings;
+    };
+    static vector<Record> recs;
+    recs.clear();
+    CBLLog_SetStructuredCallback([](const CBLLogRecord* r) {
+        Record rec {r->domain, r->level, r->timestamp, string(slice(r->format))};
+        for (size_t i = 0; i < r->argCount; ++i) {
+            rec.args.push_back(r->args[i]);
+            rec.strings.push_back(string(slice(r->args[i].stringValue)));
+        }
+        recs.push_back(std::move(rec));
+    });
+    CHECK(CBLLog_StructuredCallback() != nullptr);
+    CBLLog_SetCallbackLevel(kCBLLogInfo);
+    
+    const char* name = "db";
+    CBL_Log(kCBLLogDomainQuery, kCBLLogInfo, "%d docs (%llu bytes) in %.3f sec from %s, %.*s %p",
+            -12, 1234567890123ull, 0.5, name, 3, "abcdef", (void*)name);
+    CBL_Log(kCBLLogDomainQuery, kCBLLogVerbose, "not logged");
+    CBL_LogMessage(kCBLLogDomainDatabase, kCBLLogWarning, "100%"_sl);
+    
+    REQUIRE(recs.size() == 2);
+    auto &rec = recs[0];
+    CHECK(rec.domain == kCBLLogDomainQuery);
+    CHECK(rec.level == kCBLLogInfo);
+    CHECK(rec.timestamp > 0);
+    CHECK(rec.format == "%d docs (%llu bytes) in %.3f sec from %s, %.*s %p");
+    REQUIRE(rec.args.size() == 6);
+    CHECK(rec.args[0].type == kCBLLogArgInt);
+    CHECK(rec.args[0].intValue == -12);
+    CHECK(rec.args[1].type == kCBLLogArgUInt);
+    CHECK(rec.args[1].uintValue == 1234567890123ull);
+    CHECK(rec.args[2].type == kCBLLogArgDouble);
+    CHECK(rec.args[2].doubleValue == 0.5);
+    CHECK(rec.args[3].type == kCBLLogArgString);
+    CHECK(rec.strings[3] == "db");
+    CHECK(rec.strings[4] == "abc");
+    CHECK(rec.args[5].type == kCBLLogArgPointer);
+    CHECK(rec.args[5].uintValue == uintptr_t(name));
+    
+    CHECK(recs[1].format == "%.*s");
+    REQUIRE(recs[1].args.size() == 1);
+    CHECK(recs[1].strings[0] == "100%");
+    CHECK(recs[1].timestamp >= rec.timestamp);
+    
+    // The plain callback still gets formatted messages alongside:
+    static vector<string> messages;
+    messages.clear();
+    CBLLog_SetCallback([](CBLLogDomain domain, CBLLogLevel level, FLString msg) {
+        messages.push_back(string(msg));
+    });
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "foo %s", "bar");
+    REQUIRE(messages.size() == 1);
+    CHECK(messages[0] == "foo bar");
+    CHECK(recs.size() == 3);
+    
+    CBLLog_SetStructuredCallback(nullptr);
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "foo %s", "baz");
+    CHECK(recs.size() == 3);
+    REQUIRE(messages.size() == 2);
+    CHECK(messages[1] == "foo baz");
+}
+
+
+TEST_CASE_METHOD(LogTest, "Log Domain Levels and Throttling", "[Log][CustomLog]") {
+    static vector<string> recs;
+    recs.clear();
+    CBLLog_SetCallback([](CBLLogDomain domain, CBLLogLevel level, FLString msg) {
+        recs.push_back(string(msg));
+    });
+    CBLLog_SetCallbackLevel(kCBLLogInfo);
+    
+    // Domain levels:
+    CHECK(CBLLog_DomainLevel("Query"_sl) == kCBLLogDebug);
+    REQUIRE(CBLLog_SetDomainLevel("Query"_sl, kCBLLogWarning));
+    CHECK(CBLLog_DomainLevel("Query"_sl) == kCBLLogWarning);
+    CHECK(!CBLLog_SetDomainLevel("NoSuchDomain"_sl, kCBLLogWarning));
+    CBL_Log(kCBLLogDomainQuery, kCBLLogInfo, "query info");
+    CBL_Log(kCBLLogDomainQuery, kCBLLogWarning, "query warning");
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "db info");
+    CHECK(recs == vector<string>{"query warning", "db info"});
+    REQUIRE(CBLLog_SetDomainLevel("Query"_sl, kCBLLogDebug));
+    
+    // Sampling:
+    CBLError error;
+    uint64_t throttled = CBLLog_ThrottledMessageCount();
+    REQUIRE(CBLLog_SetDomainThrottle("DB"_sl, {2, 0}, &error));
+    recs.clear();
+    for (int i = 0; i < 10; ++i)
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "sampled %d", i);
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogWarning, "warning");
+    CBL_Log(kCBLLogDomainQuery, kCBLLogInfo, "other domain");
+    CHECK(recs.size() == 7);
+    CHECK(recs.back() == "other domain");
+    CHECK(CBLLog_ThrottledMessageCount() == throttled + 5);
+    
+    // Rate limiting, per format string (a second may go by, giving another 3):
+    REQUIRE(CBLLog_SetDomainThrottle("DB"_sl, {0, 3}, &error));
+    recs.clear();
+    for (int i = 0; i < 20; ++i)
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "limited %d", i);
+    CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "another site");
+    CHECK(recs.size() >= 4);
+    CHECK(recs.size() <= 7);
+    CHECK(recs[0] == "limited 0");
+    CHECK(recs.back() == "another site");
+    
+    // Turned off:
+    REQUIRE(CBLLog_SetDomainThrottle("DB"_sl, {0, 0}, &error));
+    recs.clear();
+    for (int i = 0; i < 10; ++i)
+        CBL_Log(kCBLLogDomainDatabase, kCBLLogInfo, "limited %d", i);
+    CHECK(recs.size() == 10);
+    
+    ExpectingExceptions x;
+    CHECK(!CBLLog_SetDomainThrottle("NoSuchDomain"_sl, {2, 0}, &error));
+    CheckError(error, kCBLErrorNotFound);
+}
+
+
+TEST_CASE_METHOD(LogTest, "Tracing", "[Log]") {
+    struct Span {
+        CBLTraceOperation op;
+        uint64_t id, parent, trace;
+        string subject;
+        bool ended = false;
+        uint64_t bytes = 0, items = 0;
+    };
+    map<uint64_t, Span> spans;
+    CBL_SetTraceCallback([](void *context, const CBLTraceEvent *event) {
+        auto &spans = *(map<uint64_t, Span>*)context;
+        if (!event->end) {
+            CHECK(spans.find(event->spanID) == spans.end());
+            spans[event->spanID] = {event->operation, event->spanID, event->parentSpanID,
+                                    event->traceID, string(slice(event->subject))};
+        } else {
+            Span &span = spans.at(event->spanID);
+            CHECK(!span.ended);
+            CHECK(!event->failed);
+            span.ended = true;
+            span.bytes = event->byteCount;
+            span.items = event->itemCount;
+        }
+    }, &spans);
+
+    auto spanOf = [&](CBLTraceOperation op) -> const Span& {
+        auto i = find_if(spans.begin(), spans.end(), [&](auto &s) {return s.second.op == op;});
+        REQUIRE(i != spans.end());
+        return i->second;
+    };
+
+    // Save a document with a blob:
+    CBLError error;
+    string blobContent(1000, 'x');
+    CBLDocument* doc = CBLDocument_CreateWithID("doc1"_sl);
+    CBLBlob* blob = CBLBlob_CreateWithData("text/plain"_sl, slice(blobContent));
+    FLMutableDict_SetBlob(CBLDocument_MutableProperties(doc), "blob"_sl, blob);
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+    CBLBlob_Release(blob);
+    CBLDocument_Release(doc);
+
+    const Span &save = spanOf(kCBLTraceSave);
+    CHECK(save.subject == "doc1");
+    CHECK(save.parent == 0);
+    CHECK(save.trace == save.id);
+    CHECK(save.items == 1);
+    const Span &encode = spanOf(kCBLTraceEncode);
+    CHECK(encode.parent == save.id);
+    CHECK(encode.trace == save.id);
+    CHECK(encode.bytes > 0);
+    const Span &install = spanOf(kCBLTraceBlobInstall);
+    CHECK(install.parent == encode.id);
+    CHECK(install.bytes == blobContent.size());
+    const Span &commit = spanOf(kCBLTraceCommit);
+    CHECK(commit.parent == save.id);
+    CHECK(commit.items == 1);
+
+    // Run a query and read its results:
+    int errPos;
+    CBLQuery* query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, "SELECT meta().id FROM _"_sl,
+                                              &errPos, &error);
+    REQUIRE(query);
+    CBLResultSet* results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    while (CBLResultSet_Next(results)) { }
+    CBLResultSet_Release(results);
+    CBLQuery_Release(query);
+
+    CHECK(spanOf(kCBLTraceQueryCompile).subject == "SELECT meta().id FROM _");
+    const Span &execute = spanOf(kCBLTraceQueryExecute);
+    CHECK(execute.parent == 0);
+    CHECK(execute.items == 1);
+    const Span &firstRow = spanOf(kCBLTraceQueryFirstRow);
+    CHECK(firstRow.parent == execute.id);
+    CHECK(firstRow.trace == execute.id);
+    CHECK(firstRow.items == 1);
+
+    for (auto &[id, span] : spans)
+        CHECK(span.ended);
+
+    // Turned off:
+    CBL_SetTraceCallback(nullptr, nullptr);
+    size_t count = spans.size();
+    createDocWithPair(defaultCollection, "doc2", "foo", "bar");
+    CHECK(spans.size() == count);
+}
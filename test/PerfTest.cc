@@ -19,8 +19,13 @@
 #include "CBLTest_Cpp.hh"
 #include "Stopwatch.hh"
 #include "Benchmark.hh"
+#include "CBLPrivate.h"
+#include <atomic>
 #include <fstream>
+#include <random>
 #include <stdarg.h>
+#include <thread>
+#include <vector>
 
 #ifdef __ANDROID__
 #include <android/log.h>
@@ -140,6 +145,19 @@ TEST_CASE_METHOD(PerfTest, "Benchmark Import iTunesMusicLibrary", "[Perf][.slow]
     readRandomDocs(defaultCollection.ref(), numDocs, 100000);
 }
 
+TEST_CASE_METHOD(PerfTest, "Benchmark Bulk Import iTunesMusicLibrary", "[Perf][.slow]") {
+    printLog("Importing docs ...");
+    Stopwatch st;
+    CBLImportProgress progress {};
+    CBLError error {};
+    CHECK(CBLCollection_ImportJSONLines(defaultCollection.ref(),
+                                        slice(GetAssetFilePath("iTunesMusicLibrary.json")),
+                                        nullslice, nullptr, nullptr, nullptr, &progress, &error));
+    st.stop();
+    CHECK(progress.documentsImported == 12189);
+    printReport(st, "Bulk Importing Result", unsigned(progress.documentsImported), "doc");
+}
+
 // NOTE:
 // Download https://github.com/arangodb/example-datasets/raw/master/RandomUsers/names_300000.json
 // to tests/assets before building and running this test.
@@ -167,3 +185,285 @@ TEST_CASE_METHOD(PerfTest, "Benchmark Query Names", "[Perf][.slow]") {
         }
     }
 }
+
+TEST_CASE_METHOD(PerfTest, "Benchmark Document Properties Access", "[Perf][.slow]") {
+    constexpr size_t kNumReads = 10000;
+    const string filler(100, 'x');
+    
+    for (size_t docSize : {1024, 10 * 1024, 100 * 1024}) {
+        // Create a document of roughly the given size, made of 100-byte string properties:
+        string docID = "doc-" + to_string(docSize);
+        cbl::MutableDocument newDoc(docID);
+        auto props = newDoc.properties();
+        for (size_t i = 0; i < docSize / filler.size(); ++i)
+            props[slice("key" + to_string(i))] = slice(filler);
+        defaultCollection.saveDocument(newDoc);
+        
+        Benchmark b;
+        for (size_t readNo = 0; readNo < kNumReads; ++readNo) {
+            CBLError err {};
+            auto doc = CBLCollection_GetDocument(defaultCollection.ref(), slice(docID), &err);
+            REQUIRE(doc);
+            b.start();
+            Dict properties = CBLDocument_Properties(doc);
+            CHECK(properties["key0"].asString() == slice(filler));
+            b.stop();
+            CBLDocument_Release(doc);
+        }
+        string what = "Properties access of " + to_string(docSize / 1024) + "KB doc";
+        printReport(b, what.c_str(), 1, "doc");
+    }
+}
+
+TEST_CASE_METHOD(PerfTest, "Benchmark Buffered Notifications", "[Perf][.slow]") {
+    constexpr unsigned kWriters = 4;
+    constexpr unsigned kSavesPerWriter = 5000;
+    
+    // Each writer saves its own document over and over; each save queues a notification:
+    atomic<unsigned> notified {0};
+    vector<CBLListenerToken*> tokens;
+    for (unsigned w = 0; w < kWriters; ++w) {
+        string docID = "writer-" + to_string(w);
+        tokens.push_back(CBLCollection_AddDocumentChangeListener(defaultCollection.ref(), slice(docID),
+                                                                 [](void *context, const CBLDocumentChange*) {
+            ++*(atomic<unsigned>*)context;
+        }, &notified));
+    }
+    
+    atomic<bool> ready {false};
+    CBLDatabase_BufferNotifications(db.ref(), [](void *context, CBLDatabase*) {
+        *(atomic<bool>*)context = true;
+    }, &ready);
+    
+    printLog("Saving docs on %u threads ...", kWriters);
+    Stopwatch st;
+    atomic<unsigned> writersDone {0};
+    vector<thread> writers;
+    for (unsigned w = 0; w < kWriters; ++w) {
+        writers.emplace_back([&, w] {
+            string docID = "writer-" + to_string(w);
+            for (unsigned i = 0; i < kSavesPerWriter; ++i) {
+                CBLError error {};
+                CBLDocument* doc = CBLDocument_CreateWithID(slice(docID));
+                FLMutableDict_SetUInt(CBLDocument_MutableProperties(doc), "i"_sl, i);
+                CHECK(CBLCollection_SaveDocumentWithConcurrencyControl(defaultCollection.ref(), doc,
+                                                                       kCBLConcurrencyControlLastWriteWins,
+                                                                       &error));
+                CBLDocument_Release(doc);
+            }
+            ++writersDone;
+        });
+    }
+    
+    // Meanwhile, deliver the notifications as they're queued:
+    while (writersDone < kWriters) {
+        if (ready.exchange(false))
+            CBLDatabase_SendNotifications(db.ref());
+        else
+            this_thread::yield();
+    }
+    for (auto &writer : writers)
+        writer.join();
+    CBLDatabase_SendNotifications(db.ref());
+    st.stop();
+    
+    CHECK(notified > 0);
+    printReport(st, "Buffered notifications", notified, "notification");
+    
+    for (auto token : tokens)
+        CBLListener_Remove(token);
+}
+
+TEST_CASE_METHOD(PerfTest, "Benchmark Concurrent Metadata Reads", "[Perf][.slow]") {
+    constexpr unsigned kReadsPerThread = 20000;
+    ImportJSONLines("names_100.json", defaultCollection.ref());
+    
+    CBLError error {};
+    int errPos;
+    auto query = CBLDatabase_CreateQuery(db.ref(), kCBLN1QLLanguage,
+                                         "SELECT name, gender FROM _"_sl, &errPos, &error);
+    REQUIRE(query);
+    
+    // Counts take the database's lock, so compare reading them through it with reading
+    // them through a reader per thread; a query's column count is read without a lock.
+    enum Mode {kCollection, kReaders, kQueryColumns};
+    const char* kModeNames[] = {"Count via database", "Count via readers", "Query column count"};
+    for (Mode mode : {kCollection, kReaders, kQueryColumns}) {
+        for (unsigned nThreads : {1, 2, 4, 8}) {
+            vector<CBLCollection*> collections(nThreads, defaultCollection.ref());
+            if (mode == kReaders) {
+                for (auto &col : collections) {
+                    col = CBLCollection_AcquireReader(defaultCollection.ref(), &error);
+                    REQUIRE(col);
+                }
+            }
+            
+            Stopwatch st;
+            vector<thread> threads;
+            for (unsigned t = 0; t < nThreads; ++t) {
+                threads.emplace_back([&, t] {
+                    uint64_t sum = 0;
+                    for (unsigned i = 0; i < kReadsPerThread; ++i) {
+                        if (mode == kQueryColumns)
+                            sum += CBLQuery_ColumnCount(query);
+                        else
+                            sum += CBLCollection_Count(collections[t]);
+                    }
+                    CHECK(sum > 0);
+                });
+            }
+            for (auto &t : threads)
+                t.join();
+            st.stop();
+            
+            string what = string(kModeNames[mode]) + " on " + to_string(nThreads) + " threads";
+            printReport(st, what.c_str(), nThreads * kReadsPerThread, "read");
+            
+            if (mode == kReaders) {
+                for (auto col : collections)
+                    CBLCollection_Release(col);
+            }
+        }
+    }
+    CBLQuery_Release(query);
+}
+
+TEST_CASE_METHOD(PerfTest, "Benchmark Database Open", "[Perf][.slow]") {
+    constexpr unsigned kCollections = 40, kRepeats = 50;
+    CBLDatabaseConfiguration config = CBLTest::databaseConfig();
+    CBLError error {};
+    CBL_DeleteDatabase("opentest"_sl, config.directory, nullptr);
+    
+    CBLDatabase* opendb = CBLDatabase_Open("opentest"_sl, &config, &error);
+    REQUIRE(opendb);
+    for (unsigned i = 0; i < kCollections; ++i) {
+        string name = "coll" + to_string(i);
+        CBLCollection* col = CBLDatabase_CreateCollection(opendb, slice(name), "scope"_sl, &error);
+        REQUIRE(col);
+        createDocWithPair(col, "doc"_sl, "name"_sl, slice(name));
+        CBLCollection_Release(col);
+    }
+    CHECK(CBLDatabase_Close(opendb, &error));
+    CBLDatabase_Release(opendb);
+    
+    // Time each stage from opening to the first query's results, as an app launch would:
+    Benchmark open, collection, firstQuery;
+    for (unsigned i = 0; i < kRepeats; ++i) {
+        open.start();
+        opendb = CBLDatabase_Open("opentest"_sl, &config, &error);
+        open.stop();
+        REQUIRE(opendb);
+        
+        collection.start();
+        CBLCollection* col = CBLDatabase_Collection(opendb, "coll7"_sl, "scope"_sl, &error);
+        collection.stop();
+        REQUIRE(col);
+        
+        firstQuery.start();
+        int errPos;
+        CBLQuery* query = CBLDatabase_CreateQuery(opendb, kCBLN1QLLanguage,
+                                                  "SELECT name FROM scope.coll7"_sl, &errPos, &error);
+        REQUIRE(query);
+        CBLResultSet* results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        CHECK(CBLResultSet_Next(results));
+        firstQuery.stop();
+        
+        CBLResultSet_Release(results);
+        CBLQuery_Release(query);
+        CBLCollection_Release(col);
+        CHECK(CBLDatabase_Close(opendb, &error));
+        CBLDatabase_Release(opendb);
+    }
+    printReport(open, "Open database");
+    printReport(collection, "Get first collection");
+    printReport(firstQuery, "Run first query");
+    
+    CHECK(CBL_DeleteDatabase("opentest"_sl, config.directory, &error));
+}
+
+TEST_CASE_METHOD(PerfTest, "Benchmark Concurrent Mixed Workloads", "[Perf][.slow]") {
+    constexpr unsigned kDocs = 1000, kOpsPerThread = 5000;
+    for (unsigned i = 0; i < kDocs; ++i) {
+        CBLError error {};
+        CBLDocument* doc = CBLDocument_CreateWithID(slice("doc-" + to_string(i)));
+        FLMutableDict_SetUInt(CBLDocument_MutableProperties(doc), "n"_sl, i);
+        REQUIRE(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+        CBLDocument_Release(doc);
+    }
+    
+    // Each thread does 90% reads -- document reads or queries -- and 10% writes:
+    enum Workload {kReadWrite, kQueryWrite, kReadWriteListeners};
+    const char* kWorkloadNames[] = {"90/10 read/write", "90/10 query/write", "90/10 read/write with listeners"};
+    for (Workload workload : {kReadWrite, kQueryWrite, kReadWriteListeners}) {
+        atomic<unsigned> notified {0};
+        CBLListenerToken* token = nullptr;
+        if (workload == kReadWriteListeners) {
+            token = CBLCollection_AddChangeListener(defaultCollection.ref(),
+                                                    [](void *context, const CBLCollectionChange *change) {
+                *(atomic<unsigned>*)context += change->numDocs;
+            }, &notified);
+        }
+        
+        for (unsigned nThreads : {1, 2, 4, 8}) {
+            CBL_SetLockTiming(true);
+            Stopwatch st;
+            vector<thread> threads;
+            for (unsigned t = 0; t < nThreads; ++t) {
+                threads.emplace_back([&, t] {
+                    CBLError error {};
+                    int errPos;
+                    CBLQuery* query = CBLDatabase_CreateQuery(db.ref(), kCBLN1QLLanguage,
+                                                              "SELECT meta().id FROM _ WHERE n BETWEEN $lo AND $lo + 10"_sl,
+                                                              &errPos, &error);
+                    CHECK(query);
+                    if (!query)
+                        return;
+                    minstd_rand random(t + 1);
+                    for (unsigned i = 0; i < kOpsPerThread; ++i) {
+                        unsigned n = random() % kDocs;
+                        string docID = "doc-" + to_string(n);
+                        if (random() % 10 == 0) {
+                            CBLDocument* doc = CBLDocument_CreateWithID(slice(docID));
+                            FLMutableDict_SetUInt(CBLDocument_MutableProperties(doc), "n"_sl, n);
+                            CHECK(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+                            CBLDocument_Release(doc);
+                        } else if (workload == kQueryWrite) {
+                            CBLQuery_SetParamInt64(query, "lo"_sl, n);
+                            CBLResultSet* results = CBLQuery_Execute(query, &error);
+                            CHECK(results);
+                            while (CBLResultSet_Next(results)) { }
+                            CBLResultSet_Release(results);
+                        } else {
+                            const CBLDocument* doc = CBLCollection_GetDocument(defaultCollection.ref(),
+                                                                               slice(docID), &error);
+                            CHECK(doc);
+                            CBLDocument_Release(doc);
+                        }
+                    }
+                    CBLQuery_Release(query);
+                });
+            }
+            for (auto &t : threads)
+                t.join();
+            st.stop();
+            CBLLockWaitStats locks = CBL_LockWaitStats();
+            alloc_slice lockStats(CBL_DumpLockStats());
+            CBL_SetLockTiming(false);
+            
+            unsigned ops = nThreads * kOpsPerThread;
+            string what = string(kWorkloadNames[workload]) + " on " + to_string(nThreads) + " threads";
+            printReport(st, what.c_str(), ops, "op");
+            printLog("    Lock waits: %llu of %llu acquisitions (%.1f%%), %.3f ms total, %.3f ms per thread",
+                     (unsigned long long)locks.contended, (unsigned long long)locks.acquisitions,
+                     locks.acquisitions ? 100.0 * locks.contended / locks.acquisitions : 0.0,
+                     locks.waitNanos / 1e6, locks.waitNanos / 1e6 / nThreads);
+            printLog("    Per lock: %.*s", (int)lockStats.size, (const char*)lockStats.buf);
+        }
+        
+        if (token) {
+            CHECK(notified > 0);
+            CBLListener_Remove(token);
+        }
+    }
+}
@@ -0,0 +1,384 @@
+//
+// QueryPerfTest.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "VectorSearchTest.hh"      // (for VECTOR_SEARCH_TEST_ENABLED)
+#include "Stopwatch.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+
+/** A query latency regression suite: it generates a dataset of people and their orders, by
+    default a million people, and times point lookups, range scans, a join, GROUP BY, full-text
+    search, UNNEST and (with vector search) nearest-neighbor queries over it. Each query's
+    `CBLQuery_Explain` plan is recorded with its latencies, so that a plan change shows up next
+    to the slowdown it causes.
+
+    Environment variables:
+    - CBL_QUERY_PERF_DOCS: the number of people (default 1000000.) The dataset is kept between
+      runs, in a database named after the size, since generating it takes a while.
+    - CBL_QUERY_PERF_REPORT: where to write the JSON report (default QueryPerf.json in the
+      test database directory.)
+    - CBL_QUERY_PERF_BASELINE: a previous report; the test fails if a query's plan differs from
+      it or its median latency grew by more than CBL_QUERY_PERF_TOLERANCE (default 0.25). */
+class QueryPerfTest : public CBLTest {
+public:
+    static constexpr unsigned kGeneratorVersion = 1;   // Bump when the dataset changes
+    static constexpr unsigned kRuns = 50;              // Timed executions per query
+    static constexpr unsigned kCities = 1000;
+    static constexpr unsigned kVocabulary = 5000;      // Distinct words in bios and tags
+    static constexpr unsigned kDimensions = 32;        // Of the people's vectors
+
+    struct Result {
+        string name, sql;
+        size_t rows = 0;
+        double p50 = 0, p99 = 0, mean = 0;             // Milliseconds
+        string plan;
+    };
+
+    size_t numDocs;
+    CBLDatabase* perfDB {nullptr};
+    CBLCollection* people {nullptr};
+    CBLCollection* orders {nullptr};
+    vector<string> words;
+    mt19937 rng {42};
+    vector<Result> results;
+
+    QueryPerfTest() {
+        const char* docs = getenv("CBL_QUERY_PERF_DOCS");
+        numDocs = docs ? strtoul(docs, nullptr, 10) : 1000000;
+        REQUIRE(numDocs > 0);
+#ifdef VECTOR_SEARCH_TEST_ENABLED
+        EnableVectorSearch();
+#endif
+        makeWords();
+        openDataset();
+    }
+
+    ~QueryPerfTest() {
+        CBLCollection_Release(people);
+        CBLCollection_Release(orders);
+        if (perfDB) {
+            CBLError error {};
+            CBLDatabase_Close(perfDB, &error);
+            CBLDatabase_Release(perfDB);
+        }
+    }
+
+#pragma mark - Dataset generator:
+
+    // Pronounceable made-up words, so full-text search tokenizes and stems them like real ones.
+    void makeWords() {
+        static const char* kSyllables[] = {"ka", "lo", "mi", "ne", "ru", "sa", "to", "vi", "ber",
+                                           "dan", "fel", "gor", "han", "jus", "mor", "pel"};
+        mt19937 wordRNG(7);
+        uniform_int_distribution<size_t> syllable(0, size(kSyllables) - 1), length(2, 4);
+        while (words.size() < kVocabulary) {
+            string word;
+            for (size_t n = length(wordRNG); n > 0; --n)
+                word += kSyllables[syllable(wordRNG)];
+            words.push_back(word);
+        }
+    }
+
+    // A word, the first ones being far more common than the last, as in natural text.
+    const string& randomWord() {
+        double u = uniform_real_distribution<double>(0, 1)(rng);
+        auto i = size_t(pow(double(kVocabulary), u)) - 1;
+        return words[min(i, words.size() - 1)];
+    }
+
+    static string personID(size_t i)      {return "person-" + to_string(i);}
+    static string cityName(size_t i)      {return "city-" + to_string(i);}
+
+    void openDataset(bool reset = false) {
+        auto config = databaseConfig();
+        string name = "QueryPerf-v" + to_string(kGeneratorVersion) + "-" + to_string(numDocs);
+        CBLError error {};
+        if (reset)
+            REQUIRE(CBL_DeleteDatabase(slice(name), config.directory, &error));
+        perfDB = CBLDatabase_Open(slice(name), &config, &error);
+        REQUIRE(perfDB);
+        people = CBLDatabase_CreateCollection(perfDB, "people"_sl, "perf"_sl, &error);
+        REQUIRE(people);
+        orders = CBLDatabase_CreateCollection(perfDB, "orders"_sl, "perf"_sl, &error);
+        REQUIRE(orders);
+        if (CBLCollection_Count(people) != numDocs) {
+            if (CBLCollection_Count(people) > 0) {
+                // An earlier run was interrupted while generating, so start over:
+                CBLCollection_Release(people);
+                CBLCollection_Release(orders);
+                REQUIRE(CBLDatabase_Close(perfDB, &error));
+                CBLDatabase_Release(perfDB);
+                openDataset(true);
+                return;
+            }
+            Stopwatch st;
+            generate();
+            printf("Generated %zu people and %zu orders in %.1f sec\n",
+                   numDocs, numDocs / 2, st.elapsed());
+        }
+        // Always, since a run may have been interrupted after generating but before indexing.
+        // Creating an index that already exists does nothing:
+        createIndexes();
+    }
+
+    void generate() {
+        constexpr size_t kBatchSize = 10000;
+        uniform_int_distribution<unsigned> age(18, 90), city(0, kCities - 1), nTags(1, 5);
+        uniform_real_distribution<double> amount(1, 500);
+#ifdef VECTOR_SEARCH_TEST_ENABLED
+        uniform_real_distribution<float> coordinate(-1, 1);
+#endif
+        CBLError error {};
+        for (size_t start = 0; start < numDocs; start += kBatchSize) {
+            REQUIRE(CBLDatabase_BeginTransaction(perfDB, &error));
+            for (size_t i = start; i < min(numDocs, start + kBatchSize); ++i) {
+                CBLDocument* doc = CBLDocument_CreateWithID(slice(personID(i)));
+                MutableDict props = CBLDocument_MutableProperties(doc);
+                props["n"_sl] = int64_t(i);
+                props["name"_sl] = slice(randomWord() + " " + randomWord());
+                props["age"_sl] = int64_t(age(rng));
+                props["city"_sl] = slice(cityName(city(rng)));
+                auto tags = MutableArray::newArray();
+                for (unsigned t = nTags(rng); t > 0; --t)
+                    tags.append(slice(randomWord()));
+                props["tags"_sl] = tags;
+                string bio;
+                for (int w = 0; w < 30; ++w)
+                    (bio += randomWord()) += ' ';
+                props["bio"_sl] = slice(bio);
+#ifdef VECTOR_SEARCH_TEST_ENABLED
+                auto vector = MutableArray::newArray();
+                for (unsigned d = 0; d < kDimensions; ++d)
+                    vector.append(coordinate(rng));
+                props["vector"_sl] = vector;
+#endif
+                REQUIRE(CBLCollection_SaveDocument(people, doc, &error));
+                CBLDocument_Release(doc);
+
+                if (i % 2 == 0) {
+                    CBLDocument* order = CBLDocument_CreateWithID(slice("order-" + to_string(i)));
+                    MutableDict oprops = CBLDocument_MutableProperties(order);
+                    oprops["customer"_sl] = slice(personID(uniform_int_distribution<size_t>(0, numDocs - 1)(rng)));
+                    oprops["amount"_sl] = amount(rng);
+                    oprops["status"_sl] = (i % 10 == 0) ? "open"_sl : "shipped"_sl;
+                    REQUIRE(CBLCollection_SaveDocument(orders, order, &error));
+                    CBLDocument_Release(order);
+                }
+            }
+            REQUIRE(CBLDatabase_EndTransaction(perfDB, true, &error));
+        }
+    }
+
+    void createIndexes() {
+        CBLError error {};
+        CBLValueIndexConfiguration value {kCBLN1QLLanguage, "age"_sl};
+        REQUIRE(CBLCollection_CreateValueIndex(people, "age"_sl, value, &error));
+        value.expressions = "city"_sl;
+        REQUIRE(CBLCollection_CreateValueIndex(people, "city"_sl, value, &error));
+        value.expressions = "customer"_sl;
+        REQUIRE(CBLCollection_CreateValueIndex(orders, "customer"_sl, value, &error));
+
+        CBLFullTextIndexConfiguration fts {kCBLN1QLLanguage, "bio"_sl, true};
+        REQUIRE(CBLCollection_CreateFullTextIndex(people, "bio"_sl, fts, &error));
+
+        CBLArrayIndexConfiguration array {kCBLN1QLLanguage, "tags"_sl};
+        REQUIRE(CBLCollection_CreateArrayIndex(people, "tags"_sl, array, &error));
+
+#ifdef VECTOR_SEARCH_TEST_ENABLED
+        CBLVectorIndexConfiguration vector {kCBLN1QLLanguage, "vector"_sl, kDimensions,
+                                            max(1u, unsigned(sqrt(double(numDocs))))};
+        REQUIRE(CBLCollection_CreateVectorIndex(people, "vector"_sl, vector, &error));
+#endif
+    }
+
+#pragma mark - Benchmarking:
+
+    // Runs a query `kRuns` times, each time with the parameters `setParams` puts in the dict,
+    // reading every row, and records its latencies and plan.
+    void measure(const string &name, const string &sql, function<void(MutableDict)> setParams = nullptr) {
+        CBLError error {};
+        int errPos;
+        CBLQuery* query = CBLDatabase_CreateQuery(perfDB, kCBLN1QLLanguage, slice(sql), &errPos, &error);
+        INFO("Query: " << sql);
+        REQUIRE(query);
+
+        Result result;
+        result.name = name;
+        result.sql = sql;
+        result.plan = string(alloc_slice(CBLQuery_Explain(query)));
+
+        vector<double> latencies;
+        for (unsigned run = 0; run <= kRuns; ++run) {
+            if (setParams) {
+                auto params = MutableDict::newDict();
+                setParams(params);
+                CBLQuery_SetParameters(query, params);
+            }
+            Stopwatch st;
+            CBLResultSet* rs = CBLQuery_Execute(query, &error);
+            REQUIRE(rs);
+            size_t rows = 0;
+            while (CBLResultSet_Next(rs)) {
+                CBLResultSet_ValueAtIndex(rs, 0);
+                ++rows;
+            }
+            CBLResultSet_Release(rs);
+            st.stop();
+            if (run == 0)
+                continue;                               // warm-up run
+            latencies.push_back(st.elapsedMS());
+            result.rows += rows;
+        }
+        CBLQuery_Release(query);
+
+        sort(latencies.begin(), latencies.end());
+        result.p50 = latencies[latencies.size() / 2];
+        result.p99 = latencies[min(latencies.size() - 1, size_t(0.99 * latencies.size()))];
+        for (double l : latencies)
+            result.mean += l / latencies.size();
+        result.rows /= kRuns;
+        printf("%-14s p50 %9.3f ms, p99 %9.3f ms, mean %9.3f ms; %zu rows\n",
+               name.c_str(), result.p50, result.p99, result.mean, result.rows);
+        results.push_back(std::move(result));
+    }
+
+    string reportJSON() const {
+        JSONEncoder enc;
+        enc.beginDict();
+        enc.writeKey("version"_sl);
+        enc.writeString(slice(CBLITE_VERSION));
+        enc.writeKey("docs"_sl);
+        enc.writeUInt(numDocs);
+        enc.writeKey("queries"_sl);
+        enc.beginArray();
+        for (auto &r : results) {
+            enc.beginDict();
+            enc.writeKey("name"_sl);    enc.writeString(slice(r.name));
+            enc.writeKey("query"_sl);   enc.writeString(slice(r.sql));
+            enc.writeKey("rows"_sl);    enc.writeUInt(r.rows);
+            enc.writeKey("p50Ms"_sl);   enc.writeDouble(r.p50);
+            enc.writeKey("p99Ms"_sl);   enc.writeDouble(r.p99);
+            enc.writeKey("meanMs"_sl);  enc.writeDouble(r.mean);
+            enc.writeKey("plan"_sl);    enc.writeString(slice(r.plan));
+            enc.endDict();
+        }
+        enc.endArray();
+        enc.endDict();
+        return string(enc.finish());
+    }
+
+    // Writes the report, and compares it with the baseline report, if any.
+    void report() {
+        const char* reportPath = getenv("CBL_QUERY_PERF_REPORT");
+        string path = reportPath ? reportPath : string(databaseDir()) + kPathSeparator + "QueryPerf.json";
+        {
+            ofstream out(path);
+            out << reportJSON();
+            CHECK(out.good());
+        }
+        printf("Wrote %s\n", path.c_str());
+
+        const char* baselinePath = getenv("CBL_QUERY_PERF_BASELINE");
+        if (!baselinePath)
+            return;
+        ifstream in(baselinePath);
+        REQUIRE(in);
+        stringstream json;
+        json << in.rdbuf();
+        Doc baselineDoc = Doc::fromJSON(json.str());
+        Dict baseline = baselineDoc.root().asDict();
+        REQUIRE(baseline);
+        const char* toleranceStr = getenv("CBL_QUERY_PERF_TOLERANCE");
+        double tolerance = toleranceStr ? strtod(toleranceStr, nullptr) : 0.25;
+        if (baseline["docs"_sl].asUnsigned() != numDocs)
+            WARN("The baseline was measured with " << baseline["docs"_sl].asUnsigned() << " docs, not " << numDocs);
+
+        for (Array::iterator i(baseline["queries"_sl].asArray()); i; ++i) {
+            Dict old = i.value().asDict();
+            string name(old["name"_sl].asString());
+            auto r = find_if(results.begin(), results.end(), [&](auto &r) {return r.name == name;});
+            if (r == results.end())
+                continue;
+            INFO("Query " << name);
+            CHECK(r->plan == string(old["plan"_sl].asString()));
+            double oldP50 = old["p50Ms"_sl].asDouble();
+            INFO("p50 was " << oldP50 << " ms, is " << r->p50 << " ms");
+            CHECK(r->p50 <= oldP50 * (1 + tolerance));
+        }
+    }
+};
+
+
+TEST_CASE_METHOD(QueryPerfTest, "Benchmark Query Latency", "[Perf][.slow]") {
+    uniform_int_distribution<size_t> anyDoc(0, numDocs - 1);
+    uniform_int_distribution<unsigned> anyAge(18, 88), anyCity(0, kCities - 1);
+
+    measure("point-id",
+            "SELECT name, age FROM perf.people WHERE meta().id = $id",
+            [&](MutableDict p) {p["id"_sl] = slice(personID(anyDoc(rng)));});
+    measure("point-city",
+            "SELECT meta().id FROM perf.people WHERE city = $city LIMIT 1",
+            [&](MutableDict p) {p["city"_sl] = slice(cityName(anyCity(rng)));});
+    measure("range-age",
+            "SELECT meta().id, age FROM perf.people WHERE age BETWEEN $lo AND $lo + 2 ORDER BY age LIMIT 1000",
+            [&](MutableDict p) {p["lo"_sl] = int64_t(anyAge(rng));});
+    measure("range-count",
+            "SELECT COUNT(*) FROM perf.people WHERE age BETWEEN $lo AND $lo + 2",
+            [&](MutableDict p) {p["lo"_sl] = int64_t(anyAge(rng));});
+    measure("join",
+            "SELECT p.name, o.amount FROM perf.people AS p JOIN perf.orders AS o "
+            "ON o.customer = meta(p).id WHERE p.city = $city",
+            [&](MutableDict p) {p["city"_sl] = slice(cityName(anyCity(rng)));});
+    measure("group-by",
+            "SELECT city, COUNT(*), AVG(age) FROM perf.people GROUP BY city ORDER BY city");
+    measure("group-by-join",
+            "SELECT o.status, COUNT(*), SUM(o.amount) FROM perf.orders AS o "
+            "JOIN perf.people AS p ON meta(p).id = o.customer WHERE p.age < $lo GROUP BY o.status",
+            [&](MutableDict p) {p["lo"_sl] = 20;});
+    measure("fts",
+            "SELECT meta().id FROM perf.people WHERE MATCH(bio, $term) ORDER BY RANK(bio) LIMIT 20",
+            [&](MutableDict p) {p["term"_sl] = slice(randomWord());});
+    measure("fts-and",
+            "SELECT meta().id FROM perf.people WHERE MATCH(bio, $term) AND age > 60 LIMIT 20",
+            [&](MutableDict p) {p["term"_sl] = slice(randomWord() + " " + randomWord());});
+    measure("unnest",
+            "SELECT meta(p).id FROM perf.people AS p UNNEST p.tags AS tag WHERE tag = $tag",
+            [&](MutableDict p) {p["tag"_sl] = slice(randomWord());});
+    measure("unnest-group",
+            "SELECT tag, COUNT(*) FROM perf.people AS p UNNEST p.tags AS tag "
+            "WHERE p.city = $city GROUP BY tag",
+            [&](MutableDict p) {p["city"_sl] = slice(cityName(anyCity(rng)));});
+#ifdef VECTOR_SEARCH_TEST_ENABLED
+    uniform_real_distribution<float> coordinate(-1, 1);
+    measure("vector",
+            "SELECT meta().id FROM perf.people ORDER BY APPROX_VECTOR_DISTANCE(vector, $vector) LIMIT 10",
+            [&](MutableDict p) {
+                auto v = MutableArray::newArray();
+                for (unsigned d = 0; d < kDimensions; ++d)
+                    v.append(coordinate(rng));
+                p["vector"_sl] = v;
+            });
+#endif
+
+    report();
+}
@@ -25,6 +25,9 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
+#include <string>
+#include <vector>
 
 using namespace std;
 using namespace fleece;
@@ -326,6 +329,199 @@ TEST_CASE_METHOD(QueryTest, "Query Parameters", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Query Typed Parameters", "[Query]") {
+    CBLError error;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT count(*) AS n FROM _ WHERE contact.address.zip BETWEEN $zip0 AND $zip1"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    
+    // Individual bindings are added to those already set:
+    {
+        auto params = MutableDict::newDict();
+        params["zip0"] = "30000";
+        CBLQuery_SetParameters(query, params);
+    }
+    CBLQuery_SetParamString(query, "zip1"_sl, "39999"_sl);
+    FLDict params = CBLQuery_Parameters(query);
+    CHECK(FLValue_AsString(FLDict_Get(params, "zip0"_sl)) == "30000"_sl);
+    CHECK(FLValue_AsString(FLDict_Get(params, "zip1"_sl)) == "39999"_sl);
+    
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    CHECK(FLValue_AsInt(CBLResultSet_ValueAtIndex(results, 0)) == 7);
+    CBLResultSet_Release(results);
+    
+    // Rebinding replaces the value:
+    CBLQuery_SetParamString(query, "zip1"_sl, "30000"_sl);
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    CHECK(FLValue_AsInt(CBLResultSet_ValueAtIndex(results, 0)) == 0);
+    CBLResultSet_Release(results);
+    results = nullptr;
+    
+    // Setting all the parameters discards the individual bindings:
+    CBLQuery_SetParameters(query, MutableDict::newDict());
+    CHECK(FLDict_Count(CBLQuery_Parameters(query)) == 0);
+    
+    float target[3] = {1.0f, 0.5f, -2.0f};
+    CBLQuery_SetParamVector(query, "target"_sl, target, 3);
+    CBLQuery_SetParamDouble(query, "distance"_sl, 0.25);
+    params = CBLQuery_Parameters(query);
+    CHECK(Dict(params).toJSONString() == R"({"distance":0.25,"target":[1,0.5,-2]})");
+    CBLQuery_Release(query);
+    
+    // Paginate with a changing integer parameter:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id FROM _ ORDER BY meta().id LIMIT 30 OFFSET $offset"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    vector<string> ids;
+    for (int64_t offset = 0; offset < 120; offset += 30) {
+        CBLQuery_SetParamInt64(query, "offset"_sl, offset);
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        while (CBLResultSet_Next(results))
+            ids.emplace_back(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0)));
+        CBLResultSet_Release(results);
+    }
+    results = nullptr;
+    REQUIRE(ids.size() == 100);
+    CHECK(ids.front() == "0000001");
+    CHECK(ids.back() == "0000100");
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Keyset Pagination", "[Query]") {
+    CBLError error;
+    CBLValueIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "name.first, meta().id"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "byFirstName"_sl, index, &error));
+    
+    // The expected order:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id FROM _ ORDER BY name.first, meta().id"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    vector<string> expected;
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    while (CBLResultSet_Next(results))
+        expected.emplace_back(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0)));
+    CBLResultSet_Release(results);
+    results = nullptr;
+    CBLQuery_Release(query);
+    REQUIRE(expected.size() == 100);
+    
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id, name.first FROM _ "
+                                    "WHERE name.first > $cursor0 OR (name.first = $cursor0 AND meta().id > $cursor1) "
+                                    "ORDER BY name.first, meta().id LIMIT 30"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    
+    // Start before every key:
+    FLMutableArray cursor = FLMutableArray_New();
+    FLMutableArray_AppendString(cursor, ""_sl);
+    FLMutableArray_AppendString(cursor, ""_sl);
+    
+    vector<string> ids;
+    int pages = 0;
+    while (cursor) {
+        CBLQuery_SetCursor(query, cursor);
+        FLMutableArray_Release(cursor);
+        cursor = nullptr;
+        
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        while (CBLResultSet_Next(results)) {
+            ids.emplace_back(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0)));
+            FLMutableArray_Release(cursor);
+            const unsigned keyColumns[2] = {1, 0};
+            cursor = CBLResultSet_CopyCursor(results, keyColumns, 2);
+        }
+        CBLResultSet_Release(results);
+        results = nullptr;
+        ++pages;
+    }
+    CHECK(pages == 5);      // The last page is empty
+    CHECK(ids == expected);
+    
+    // The binding outlives the cursor array and the result set it came from:
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    CHECK(!CBLResultSet_Next(results));
+    CBLResultSet_Release(results);
+    results = nullptr;
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Many Collections", "[Query]") {
+    // Each tenant's orders have every third total, so the merged totals are 0...29:
+    vector<CBLCollection*> tenants;
+    for (int t = 0; t < 3; ++t) {
+        CBLCollection* col = CreateCollection(db, "orders" + to_string(t), "tenants");
+        for (int i = 0; i < 10; ++i) {
+            int total = 3 * i + t;
+            createDocWithJSON(col, "order" + to_string(total), "{\"total\":" + to_string(total) + "}");
+        }
+        tenants.push_back(col);
+    }
+    
+    CBLError error;
+    const CBLQuerySortColumn sortColumns[1] = {{1, false}};
+    FLMutableDict params = FLMutableDict_New();
+    FLMutableDict_SetInt(params, "min"_sl, 5);
+    FLMutableArray rows = CBLDatabase_QueryCollections(db,
+        "SELECT meta().id, total FROM {{collection}} WHERE total >= $min ORDER BY total"_sl,
+        tenants.data(), tenants.size(), params, sortColumns, 1, 12, &error);
+    FLMutableDict_Release(params);
+    REQUIRE(rows);
+    REQUIRE(FLArray_Count(rows) == 12);
+    for (uint32_t i = 0; i < 12; ++i) {
+        FLArray row = FLValue_AsArray(FLArray_Get(rows, i));
+        CHECK(FLValue_AsInt(FLArray_Get(row, 1)) == 5 + i);
+        CHECK(slice(FLValue_AsString(FLArray_Get(row, 0))) == slice("order" + to_string(5 + i)));
+    }
+    FLMutableArray_Release(rows);
+    
+    // Descending, without a limit:
+    const CBLQuerySortColumn descending[1] = {{0, true}};
+    rows = CBLDatabase_QueryCollections(db, "SELECT total FROM {{collection}} ORDER BY total DESC"_sl,
+                                        tenants.data(), tenants.size(), nullptr, descending, 1, 0,
+                                        &error);
+    REQUIRE(rows);
+    REQUIRE(FLArray_Count(rows) == 30);
+    for (uint32_t i = 0; i < 30; ++i)
+        CHECK(FLValue_AsInt(FLArray_Get(FLValue_AsArray(FLArray_Get(rows, i)), 0)) == 29 - i);
+    FLMutableArray_Release(rows);
+    
+    {
+        ExpectingExceptions x;
+        CHECK(!CBLDatabase_QueryCollections(db, "SELECT total FROM _"_sl, tenants.data(),
+                                            tenants.size(), nullptr, nullptr, 0, 0, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+        
+        const CBLQuerySortColumn outOfRange[1] = {{1, false}};
+        CHECK(!CBLDatabase_QueryCollections(db, "SELECT total FROM {{collection}} ORDER BY total"_sl,
+                                            tenants.data(), tenants.size(), nullptr, outOfRange, 1,
+                                            0, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+        
+        CHECK(!CBLDatabase_QueryCollections(db, "SELECT total FRM {{collection}}"_sl,
+                                            tenants.data(), tenants.size(), nullptr, nullptr, 0, 0,
+                                            &error));
+        CheckError(error, kCBLErrorInvalidQuery);
+    }
+    
+    for (auto col : tenants)
+        CBLCollection_Release(col);
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Create and Delete Value Index", "[Query]") {
     CBLError error;
     int errPos;
@@ -372,6 +568,76 @@ TEST_CASE_METHOD(QueryTest, "Create and Delete Value Index", "[Query]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest, "Create Partial Value Index", "[Query]") {
+    CBLError error;
+    int errPos;
+    
+    CBLValueIndexConfiguration config = {};
+    config.expressionLanguage = kCBLN1QLLanguage;
+    config.expressions = "name.last"_sl;
+    config.where = "gender = 'female'"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "femaleLastNames"_sl, config, &error));
+    
+    // A query with the index's condition uses the index:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.last FROM _ WHERE gender = 'female' AND name.last > 'M'"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    alloc_slice explanation1(CBLQuery_Explain(query));
+    CHECK(explanation1.find("USING INDEX femaleLastNames"_sl));
+    CBLQuery_Release(query);
+    
+    // A query without it can't:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.last FROM _ WHERE name.last > 'M'"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    alloc_slice explanation2(CBLQuery_Explain(query));
+    CHECK(!explanation2.find("femaleLastNames"_sl));
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Create Value Index with Included Expressions", "[Query]") {
+    CBLError error;
+    int errPos;
+
+    CBLValueIndexConfiguration config = {};
+    SECTION("N1QL") {
+        config.expressionLanguage = kCBLN1QLLanguage;
+        config.expressions = "name.last"_sl;
+        config.includedExpressions = "name.first, birthday"_sl;
+    }
+    SECTION("JSON") {
+        config.expressionLanguage = kCBLJSONLanguage;
+        config.expressions = R"([[".name.last"]])"_sl;
+        config.includedExpressions = R"([[".name.first"], [".birthday"]])"_sl;
+    }
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "lastNames"_sl, config, &error));
+
+    // A query returning the included properties still uses the index:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first, birthday FROM _ WHERE name.last = 'Laserna'"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    alloc_slice explanation(CBLQuery_Explain(query));
+    CHECK(explanation.find("lastNames"_sl));
+    CBLResultSet* rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+    REQUIRE(CBLResultSet_Next(rs));
+    CHECK(FLValue_AsString(CBLResultSet_ValueAtIndex(rs, 0)) == "Lue"_sl);
+    CHECK(!CBLResultSet_Next(rs));
+    CBLResultSet_Release(rs);
+
+    // Included expressions must be in the same syntax:
+    ExpectingExceptions x;
+    config.expressionLanguage = kCBLJSONLanguage;
+    config.expressions = R"([[".name.last"]])"_sl;
+    config.includedExpressions = "name.first"_sl;
+    CHECK(!CBLCollection_CreateValueIndex(defaultCollection, "bad"_sl, config, &error));
+    CHECK(error.code == kCBLErrorInvalidParameter);
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Create and Delete Full-Text Index", "[Query]") {
     CBLError error;
     int errPos;
@@ -403,101 +669,925 @@ TEST_CASE_METHOD(QueryTest, "Create and Delete Full-Text Index", "[Query]") {
     CHECK(explanation1.find("SCAN <idx1> VIRTUAL TABLE INDEX"_sl));
     CBLQuery_Release(query);
     
-    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
-                                    "SELECT product.name FROM _ WHERE match(index2, 'chilli')"_sl,
-                                    &errPos, &error);
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT product.name FROM _ WHERE match(index2, 'chilli')"_sl,
+                                    &errPos, &error);
+    
+    alloc_slice explanation2(CBLQuery_Explain(query));
+    CHECK(explanation2.find("JOIN \"kv_default::index2\" AS \"<idx1>\""));
+    CHECK(explanation2.find("SCAN <idx1> VIRTUAL TABLE INDEX"_sl));
+    CBLQuery_Release(query);
+    query = nullptr;
+    
+    CHECK(CBLCollection_DeleteIndex(defaultCollection, "index1"_sl, &error));
+    CHECK(CBLCollection_DeleteIndex(defaultCollection, "index2"_sl, &error));
+    
+    indexNames = CBLCollection_GetIndexNames(defaultCollection, &error);
+    CHECK(FLArray_Count(indexNames) == 0);
+    CHECK(Array(indexNames).toJSONString() == R"([])");
+    FLArray_Release(indexNames);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Suspend and Resume Indexes", "[Query]") {
+    CBLError error;
+    int errPos;
+    
+    CBLValueIndexConfiguration index1 = {};
+    index1.expressionLanguage = kCBLN1QLLanguage;
+    index1.expressions = "name.first"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "index1"_sl, index1, &error));
+    
+    CBLFullTextIndexConfiguration index2 = {};
+    index2.expressionLanguage = kCBLJSONLanguage;
+    index2.expressions = R"([[".name.last"]])"_sl;
+    index2.ignoreAccents = true;
+    REQUIRE(CBLCollection_CreateFullTextIndex(defaultCollection, "index2"_sl, index2, &error));
+    
+    REQUIRE(CBLCollection_SuspendIndexes(defaultCollection, &error));
+    FLArray indexNames = CBLCollection_GetIndexNames(defaultCollection, &error);
+    CHECK(FLArray_Count(indexNames) == 0);
+    FLArray_Release(indexNames);
+    
+    // Import while the indexes are suspended:
+    CBLDocument* doc = CBLDocument_CreateWithID("zed"_sl);
+    REQUIRE(CBLDocument_SetJSON(doc, R"({"name": {"first": "Zed", "last": "Zébra"}})"_sl, &error));
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+    CBLDocument_Release(doc);
+    
+    SECTION("Resume") { }
+    
+    SECTION("Resume After Reopening") {
+        CBLCollection_Release(defaultCollection);
+        REQUIRE(CBLDatabase_Close(db, &error));
+        CBLDatabase_Release(db);
+        CBLDatabaseConfiguration config = databaseConfig();
+        db = CBLDatabase_Open(kDatabaseName, &config, &error);
+        REQUIRE(db);
+        defaultCollection = CBLDatabase_DefaultCollection(db, &error);
+        REQUIRE(defaultCollection);
+    }
+    
+    REQUIRE(CBLCollection_ResumeIndexes(defaultCollection, &error));
+    indexNames = CBLCollection_GetIndexNames(defaultCollection, &error);
+    CHECK(Array(indexNames).toJSONString() == R"(["index1","index2"])");
+    FLArray_Release(indexNames);
+    
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first FROM _ ORDER BY name.first"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    alloc_slice explanation(CBLQuery_Explain(query));
+    CHECK(explanation.find("USING INDEX index1"_sl));
+    CBLQuery_Release(query);
+    
+    // The full-text index includes the imported document, and kept its options:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id FROM _ WHERE match(index2, 'zebra')"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    CHECK(countResults(results) == 1);
+    
+    // Nothing is suspended any more:
+    REQUIRE(CBLCollection_ResumeIndexes(defaultCollection, &error));
+}
+
+
+/** For keeping track of asynchronous index creations. */
+struct IndexBuildState {
+    bool waitForEnd() {
+        unique_lock<mutex> lock(_mutex);
+        return _cond.wait_for(lock, 10s, [&] {
+            return !states.empty() && states.back() != kCBLIndexBuildRunning;
+        });
+    }
+    
+    static void callback(void* context, CBLIndexBuild* build, CBLIndexBuildState state, const CBLError* error) {
+        auto self = (IndexBuildState*)context;
+        lock_guard<mutex> lock(self->_mutex);
+        self->states.push_back(state);
+        if (error)
+            self->error = *error;
+        self->_cond.notify_all();
+    }
+    
+    vector<CBLIndexBuildState> states;
+    CBLError error {};
+    
+private:
+    mutex _mutex;
+    condition_variable _cond;
+};
+
+
+TEST_CASE_METHOD(QueryTest, "Create Index Async", "[Query]") {
+    CBLError error;
+    int errPos;
+    IndexBuildState state;
+    
+    CBLValueIndexConfiguration index1 = {};
+    index1.expressionLanguage = kCBLN1QLLanguage;
+    index1.expressions = "name.first"_sl;
+    CBLIndexBuild* build = CBLCollection_CreateValueIndexAsync(defaultCollection, "index1"_sl, index1,
+                                                               IndexBuildState::callback, &state);
+    REQUIRE(build);
+    CHECK(CBLIndexBuild_IndexName(build) == "index1"_sl);
+    REQUIRE(state.waitForEnd());
+    CHECK(state.states == vector<CBLIndexBuildState>{kCBLIndexBuildRunning, kCBLIndexBuildFinished});
+    CHECK(CBLIndexBuild_State(build) == kCBLIndexBuildFinished);
+    CHECK(!CBLIndexBuild_Cancel(build));    // Already finished
+    CBLIndexBuild_Release(build);
+    
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first FROM _ ORDER BY name.first"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    alloc_slice explanation(CBLQuery_Explain(query));
+    CHECK(explanation.find("USING INDEX index1"_sl));
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Create Index Async With Invalid Expression", "[Query]") {
+    ExpectingExceptions x;
+    IndexBuildState state;
+    
+    CBLFullTextIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "name.first, ("_sl;
+    CBLIndexBuild* build = CBLCollection_CreateFullTextIndexAsync(defaultCollection, "index"_sl, index,
+                                                                  IndexBuildState::callback, &state);
+    REQUIRE(build);
+    REQUIRE(state.waitForEnd());
+    CHECK(state.states == vector<CBLIndexBuildState>{kCBLIndexBuildRunning, kCBLIndexBuildFailed});
+    CHECK(state.error.code != 0);
+    CHECK(CBLIndexBuild_State(build) == kCBLIndexBuildFailed);
+    CBLIndexBuild_Release(build);
+    
+    CBLError error;
+    FLArray indexNames = CBLCollection_GetIndexNames(defaultCollection, &error);
+    CHECK(FLArray_Count(indexNames) == 0);
+    FLArray_Release(indexNames);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Cache", "[Query]") {
+    // Reopen the database with the query cache enabled:
+    CBLError error;
+    CBLCollection_Release(defaultCollection);
+    REQUIRE(CBLDatabase_Close(db, &error));
+    CBLDatabase_Release(db);
+    CBLDatabaseConfiguration config = databaseConfig();
+    config.queryCacheSize = 2;
+    db = CBLDatabase_Open(kDatabaseName, &config, &error);
+    REQUIRE(db);
+    defaultCollection = CBLDatabase_DefaultCollection(db, &error);
+    REQUIRE(defaultCollection);
+    CHECK(CBLDatabase_Config(db).queryCacheSize == 2);
+    
+    const slice kQuery = "SELECT name FROM _ WHERE birthday like $date"_sl;
+    int errPos;
+    CBLQuery* q1 = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, kQuery, &errPos, &error);
+    REQUIRE(q1);
+    CBLQuery* q2 = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, kQuery, &errPos, &error);
+    REQUIRE(q2);
+    
+    CBLQueryCacheStats stats = CBLDatabase_QueryCacheStats(db);
+    CHECK(stats.misses == 1);
+    CHECK(stats.hits == 1);
+    CHECK(stats.count == 1);
+    
+    // Queries from the cache have their own parameters:
+    MutableDict params1 = MutableDict::newDict();
+    params1["date"] = "1959-%";
+    CBLQuery_SetParameters(q1, params1);
+    MutableDict params2 = MutableDict::newDict();
+    params2["date"] = "0000-%";
+    CBLQuery_SetParameters(q2, params2);
+    
+    CBLResultSet* rs = CBLQuery_Execute(q1, &error);
+    REQUIRE(rs);
+    CHECK(countResults(rs) == 3);
+    CBLResultSet_Release(rs);
+    rs = CBLQuery_Execute(q2, &error);
+    REQUIRE(rs);
+    CHECK(countResults(rs) == 0);
+    CBLResultSet_Release(rs);
+    CHECK(Dict(CBLQuery_Parameters(q1))["date"].asString() == "1959-%"_sl);
+    
+    CBLQuery_Release(q1);
+    CBLQuery_Release(q2);
+    
+    // Fill the cache past its size:
+    for (slice str : {"SELECT name FROM _"_sl, "SELECT birthday FROM _"_sl}) {
+        CBLQuery* q = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, str, &errPos, &error);
+        REQUIRE(q);
+        CBLQuery_Release(q);
+    }
+    stats = CBLDatabase_QueryCacheStats(db);
+    CHECK(stats.misses == 3);
+    CHECK(stats.evictions == 1);
+    CHECK(stats.count == 2);
+    
+    // Creating an index empties the cache:
+    CBLValueIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "birthday"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "birthday"_sl, index, &error));
+    stats = CBLDatabase_QueryCacheStats(db);
+    CHECK(stats.invalidations == 1);
+    CHECK(stats.count == 0);
+    
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, "SELECT name FROM _"_sl, &errPos, &error);
+    REQUIRE(query);
+    CHECK(CBLDatabase_QueryCacheStats(db).misses == 4);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result Cache", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name FROM _ WHERE birthday like $date"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    CBLQuery_SetResultCacheSize(query, 2);
+    auto run = [&](slice date) {
+        CBLQuery_SetParamString(query, "date"_sl, date);
+        CBLResultSet* rs = CBLQuery_Execute(query, &error);
+        REQUIRE(rs);
+        int n = countResults(rs);
+        CBLResultSet_Release(rs);
+        return n;
+    };
+
+    // The second run with the same parameters returns the cached results:
+    CHECK(run("1959-%"_sl) == 3);
+    CHECK(run("1959-%"_sl) == 3);
+    CHECK(run("1961-%"_sl) == 2);
+    CHECK(run("1959-%"_sl) == 3);
+    CBLQueryResultCacheStats stats = CBLQuery_ResultCacheStats(query);
+    CHECK(stats.hits == 2);
+    CHECK(stats.misses == 2);
+    CHECK(stats.count == 2);
+
+    // A result set still in use isn't shared:
+    CBLQuery_SetParamString(query, "date"_sl, "1959-%"_sl);
+    CBLResultSet* rs1 = CBLQuery_Execute(query, &error);
+    REQUIRE(rs1);
+    CBLResultSet* rs2 = CBLQuery_Execute(query, &error);
+    REQUIRE(rs2);
+    CHECK(countResults(rs2) == 3);
+    CHECK(countResults(rs1) == 3);
+    CBLResultSet_Release(rs1);
+    CBLResultSet_Release(rs2);
+    CHECK(CBLQuery_ResultCacheStats(query).misses == 3);
+
+    // A change to the database makes the results stale:
+    createDocWithJSON(defaultCollection, "newborn", R"({"name": {"first": "Tiny"}, "birthday": "1959-01-01"})");
+    CHECK(run("1959-%"_sl) == 4);
+    stats = CBLQuery_ResultCacheStats(query);
+    CHECK(stats.invalidations == 1);
+    CHECK(stats.misses == 4);
+    CHECK(run("1959-%"_sl) == 4);
+    CHECK(CBLQuery_ResultCacheStats(query).hits == 4);
+
+    // Disabling the cache empties it:
+    CBLQuery_SetResultCacheSize(query, 0);
+    CHECK(CBLQuery_ResultCacheStats(query).count == 0);
+    CHECK(run("1959-%"_sl) == 4);
+    CHECK(CBLQuery_ResultCacheStats(query).hits == 4);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result Cache With Another Connection", "[Query]") {
+    CBLError error;
+    int errPos;
+    // Start watching the data version before the collection exists:
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, "SELECT name FROM _"_sl, &errPos, &error);
+    REQUIRE(query);
+    CBLQuery_SetResultCacheSize(query, 1);
+    CBLResultSet* rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+    CBLResultSet_Release(rs);
+    CBLQuery_Release(query);
+    
+    // Another connection creates a collection and writes to it:
+    CBLDatabaseConfiguration config = databaseConfig();
+    CBLDatabase* db2 = CBLDatabase_Open(kDatabaseName, &config, &error);
+    REQUIRE(db2);
+    CBLCollection* late2 = CBLDatabase_CreateCollection(db2, "late"_sl, kFLSliceNull, &error);
+    REQUIRE(late2);
+    createDocWithPair(late2, "doc1", "n", "1");
+    
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, "SELECT COUNT(*) FROM late"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    CBLQuery_SetResultCacheSize(query, 1);
+    auto count = [&] {
+        CBLResultSet* rs = CBLQuery_Execute(query, &error);
+        REQUIRE(rs);
+        REQUIRE(CBLResultSet_Next(rs));
+        int64_t n = FLValue_AsInt(CBLResultSet_ValueAtIndex(rs, 0));
+        CBLResultSet_Release(rs);
+        return n;
+    };
+    CHECK(count() == 1);
+    CHECK(count() == 1);
+    CHECK(CBLQuery_ResultCacheStats(query).hits == 1);
+    
+    // A write through the other connection to the new collection makes the results stale:
+    createDocWithPair(late2, "doc2", "n", "2");
+    CHECK(count() == 2);
+    CHECK(CBLQuery_ResultCacheStats(query).invalidations == 1);
+    
+    CBLCollection_Release(late2);
+    REQUIRE(CBLDatabase_Close(db2, &error));
+    CBLDatabase_Release(db2);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Index Usage Statistics", "[Query]") {
+    CBLError error;
+    CBLValueIndexConfiguration config = {};
+    config.expressionLanguage = kCBLN1QLLanguage;
+    config.expressions = "name.first"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "byFirstName"_sl, config, &error));
+    CBLQueryIndex* index = CBLCollection_GetIndex(defaultCollection, "byFirstName"_sl, &error);
+    REQUIRE(index);
+
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first FROM _ WHERE name.first > 'A' ORDER BY name.first"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+
+    // Nothing is recorded until tracking is enabled:
+    CBLResultSet* rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+    CBLResultSet_Release(rs);
+    CHECK(CBLQueryIndex_Stats(index).queryCount == 0);
+
+    CBLDatabase_SetIndexUsageTracking(db, true);
+    rs = CBLQuery_Execute(query, &error);
+    REQUIRE(rs);
+    auto count = countResults(rs);
+    CBLResultSet_Release(rs);
+
+    CBLQueryIndexStats stats = CBLQueryIndex_Stats(index);
+    CHECK(stats.queryCount == 1);
+    CHECK(stats.rowsReturned == uint64_t(count));
+    CHECK(stats.lastUsed > 0);
+
+    // Disabling tracking clears the statistics:
+    CBLDatabase_SetIndexUsageTracking(db, false);
+    CHECK(CBLQueryIndex_Stats(index).queryCount == 0);
+    CBLQueryIndex_Release(index);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result As Dict", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+
+    CHECK(CBLQuery_ColumnCount(query) == 1);
+    CHECK(CBLQuery_ColumnName(query, 0) == "name"_sl);
+
+    alloc_slice explanation(CBLQuery_Explain(query));
+    cerr << string(explanation);
+
+    static const slice kExpectedFirst[3] = {"Tyesha",  "Eddie",     "Diedre"};
+    static const slice kExpectedLast [3] = {"Loehrer", "Colangelo", "Clinton"};
+
+    int n = 0;
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    while (CBLResultSet_Next(results)) {
+        FLDict result = CBLResultSet_ResultDict(results);
+        FLValue name = FLDict_Get(result, "name"_sl);
+        FLDict dict = FLValue_AsDict(name);
+        CHECK(dict);
+        slice first  = FLValue_AsString(FLDict_Get(dict, "first"_sl));
+        slice last   = FLValue_AsString(FLDict_Get(dict, "last"_sl));
+        REQUIRE(n < 3);
+        CHECK(first == kExpectedFirst[n]);
+        CHECK(last == kExpectedLast[n]);
+        ++n;
+        cerr << first << " " << last << "\n";
+    }
+    CHECK(n == 3);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result Dict Reused Across Rows", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first, likes[1] AS like FROM _"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    CBLResultSet_SetReuseResults(results, true);
+    FLDict firstDict = nullptr;
+    FLArray firstArray = nullptr;
+    int n = 0, nMissing = 0;
+    while (CBLResultSet_Next(results)) {
+        FLDict dict = CBLResultSet_ResultDict(results);
+        FLArray array = CBLResultSet_ResultArray(results);
+        if (!firstDict) {
+            firstDict = dict;
+            firstArray = array;
+        }
+        CHECK(dict == firstDict);
+        CHECK(array == firstArray);
+        
+        FLValue like = CBLResultSet_ValueForKey(results, "like"_sl);
+        CHECK(FLDict_Get(dict, "first"_sl) == CBLResultSet_ValueAtIndex(results, 0));
+        CHECK(FLDict_Get(dict, "like"_sl) == like);
+        CHECK(FLDict_Count(dict) == (like ? 2 : 1));
+        CHECK(FLArray_Count(array) == 2);
+        if (!like) {
+            CHECK(FLValue_GetType(FLArray_Get(array, 1)) == kFLUndefined);
+            ++nMissing;
+        }
+        ++n;
+    }
+    CHECK(n == 100);
+    CHECK(nMissing > 0);
+    CHECK(nMissing < 100);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result Dict Retained Past Its Row", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first FROM _ ORDER BY name.first"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    FLDict dict = FLDict_Retain(CBLResultSet_ResultDict(results));
+    FLArray array = FLArray_Retain(CBLResultSet_ResultArray(results));
+    alloc_slice first(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0)));
+    
+    // Without opting in to reuse, the next row gets new containers, so retained ones keep
+    // their row's values:
+    while (CBLResultSet_Next(results)) {
+        CHECK(CBLResultSet_ResultDict(results) != dict);
+        CHECK(CBLResultSet_ResultArray(results) != array);
+    }
+    CHECK(slice(FLValue_AsString(FLDict_Get(dict, "first"_sl))) == first);
+    CHECK(slice(FLValue_AsString(FLArray_Get(array, 0))) == first);
+    FLDict_Release(dict);
+    FLArray_Release(array);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result As Array", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name, foo FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+
+    REQUIRE(CBLQuery_ColumnCount(query) == 2);
+    CHECK(CBLQuery_ColumnName(query, 0) == "name"_sl);
+    CHECK(CBLQuery_ColumnName(query, 1) == "foo"_sl);
+
+    alloc_slice explanation(CBLQuery_Explain(query));
+    cerr << string(explanation);
+
+    static const slice kExpectedFirst[3] = {"Tyesha",  "Eddie",     "Diedre"};
+    static const slice kExpectedLast [3] = {"Loehrer", "Colangelo", "Clinton"};
+
+    int n = 0;
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    while (CBLResultSet_Next(results)) {
+        FLArray result = CBLResultSet_ResultArray(results);
+        REQUIRE(FLArray_Count(result) == 2);
+        FLValue name = FLArray_Get(result, 0);
+        FLDict dict = FLValue_AsDict(name);
+        CHECK(dict);
+        slice first  = FLValue_AsString(FLDict_Get(dict, "first"_sl));
+        slice last   = FLValue_AsString(FLDict_Get(dict, "last"_sl));
+        REQUIRE(n < 3);
+        CHECK(first == kExpectedFirst[n]);
+        CHECK(last == kExpectedLast[n]);
+        cerr << first << " " << last << "\n";
+        FLValue foo = FLArray_Get(result, 1);
+        CHECK(FLValue_GetType(foo) == kFLUndefined);
+        ++n;
+    }
+    CHECK(n == 3);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Reused Result Set Allocations", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name FROM _ WHERE birthday like '1959-%'"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    
+    // Result sets executed and released in a loop should reuse the memory of the previous one:
+    constexpr int kIterations = 1000;
+    uint64_t heapAllocations = CBLResultSet_HeapAllocationCount();
+    for (int i = 0; i < kIterations; ++i) {
+        CBLResultSet* rs = CBLQuery_Execute(query, &error);
+        REQUIRE(rs);
+        int n = 0;
+        while (CBLResultSet_Next(rs))
+            ++n;
+        CHECK(n == 3);
+        CBLResultSet_Release(rs);
+    }
+    CHECK(CBLResultSet_HeapAllocationCount() - heapAllocations <= 1);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Result Batch", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first, foo FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    REQUIRE(CBLQuery_ColumnCount(query) == 2);
+    
+    static const slice kExpectedFirst[3] = {"Tyesha",  "Eddie",     "Diedre"};
+    
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    FLValue values[2 * 2];
+    REQUIRE(CBLResultSet_NextBatch(results, 2, values) == 2);
+    CHECK(FLValue_AsString(values[0]) == kExpectedFirst[0]);
+    CHECK(values[1] == nullptr);
+    CHECK(FLValue_AsString(values[2]) == kExpectedFirst[1]);
+    CHECK(values[3] == nullptr);
+    
+    // The current result is the last one in the batch:
+    CHECK(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0)) == kExpectedFirst[1]);
+    
+    REQUIRE(CBLResultSet_NextBatch(results, 2, values) == 1);
+    CHECK(FLValue_AsString(values[0]) == kExpectedFirst[2]);
+    
+    // Values from earlier batches are still valid:
+    CBLResultSet_Release(results);
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    FLValue all[3 * 2];
+    REQUIRE(CBLResultSet_NextBatch(results, 1, &all[0]) == 1);
+    REQUIRE(CBLResultSet_NextBatch(results, 2, &all[2]) == 2);
+    CHECK(CBLResultSet_NextBatch(results, 2, values) == 0);
+    for (int i = 0; i < 3; ++i)
+        CHECK(FLValue_AsString(all[2 * i]) == kExpectedFirst[i]);
+}
+
+
+TEST_CASE_METHOD(QueryTest, "Query Read Typed Columns", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT length(name.first), name.first, foo FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    
+    static const slice kExpectedFirst[3] = {"Tyesha",  "Eddie",     "Diedre"};
+    
+    SECTION("Doubles") {
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        double values[4];
+        uint8_t nulls = 0xFF;
+        REQUIRE(CBLResultSet_ReadColumnDoubles(results, 0, values, 4, &nulls) == 3);
+        CHECK(values[0] == 6.0);
+        CHECK(values[1] == 5.0);
+        CHECK(values[2] == 6.0);
+        CHECK(nulls == 0);
+        CHECK(CBLResultSet_ReadColumnDoubles(results, 0, values, 4, nullptr) == 0);
+    }
+    
+    SECTION("Int64s") {
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        int64_t values[2];
+        REQUIRE(CBLResultSet_ReadColumnInt64s(results, 0, values, 2, nullptr) == 2);
+        CHECK(values[0] == 6);
+        CHECK(values[1] == 5);
+        REQUIRE(CBLResultSet_ReadColumnInt64s(results, 0, values, 2, nullptr) == 1);
+        CHECK(values[0] == 6);
+    }
+    
+    SECTION("Strings") {
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        FLString values[3];
+        uint8_t nulls = 0xFF;
+        REQUIRE(CBLResultSet_ReadColumnStrings(results, 1, values, 3, &nulls) == 3);
+        for (int i = 0; i < 3; ++i)
+            CHECK(slice(values[i]) == kExpectedFirst[i]);
+        CHECK(nulls == 0);
+    }
+    
+    SECTION("Missing") {
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        double values[3];
+        uint8_t nulls = 0;
+        REQUIRE(CBLResultSet_ReadColumnDoubles(results, 2, values, 3, &nulls) == 3);
+        CHECK(values[0] == 0.0);
+        CHECK(nulls == 0b111);
+    }
+    
+    SECTION("Invalid Column") {
+        results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        double values[3];
+        ExpectingExceptions x;
+        CHECK(CBLResultSet_ReadColumnDoubles(results, 3, values, 3, nullptr) == 0);
+    }
+}
+
+
+/** For keeping track of asynchronous query executions. */
+struct AsyncState {
+    void completed(CBLResultSet* _cbl_nullable rs) {
+        lock_guard<mutex> lock(_mutex);
+        if (rs)
+            _resultCounts.push_back(countResults(rs));
+        else
+            ++_errors;
+        _cond.notify_all();
+    }
+    
+    bool waitForCount(size_t target) {
+        unique_lock<mutex> lock(_mutex);
+        return _cond.wait_for(lock, 5s, [&] {return _resultCounts.size() + _errors >= target;});
+    }
     
-    alloc_slice explanation2(CBLQuery_Explain(query));
-    CHECK(explanation2.find("JOIN \"kv_default::index2\" AS \"<idx1>\""));
-    CHECK(explanation2.find("SCAN <idx1> VIRTUAL TABLE INDEX"_sl));
-    CBLQuery_Release(query);
-    query = nullptr;
+    vector<int> resultCounts() {
+        lock_guard<mutex> lock(_mutex);
+        return _resultCounts;
+    }
     
-    CHECK(CBLCollection_DeleteIndex(defaultCollection, "index1"_sl, &error));
-    CHECK(CBLCollection_DeleteIndex(defaultCollection, "index2"_sl, &error));
+    static void callback(void* context, CBLQuery* query, CBLResultSet* rs, const CBLError* error) {
+        ((AsyncState*)context)->completed(rs);
+    }
     
-    indexNames = CBLCollection_GetIndexNames(defaultCollection, &error);
-    CHECK(FLArray_Count(indexNames) == 0);
-    CHECK(Array(indexNames).toJSONString() == R"([])");
-    FLArray_Release(indexNames);
-}
+private:
+    mutex _mutex;
+    condition_variable _cond;
+    vector<int> _resultCounts;
+    int _errors {0};
+};
 
 
-TEST_CASE_METHOD(QueryTest, "Query Result As Dict", "[Query]") {
+TEST_CASE_METHOD(QueryTest, "Query Execute Async", "[Query]") {
     CBLError error;
     int errPos;
     query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
-                                    "SELECT name FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    "SELECT name FROM _ WHERE birthday like '1959-%'"_sl,
                                     &errPos, &error);
     REQUIRE(query);
+    AsyncState state;
+    unsigned instanceCount = CBL_InstanceCount();
+    
+    // Several executions of the same query may be pending at once:
+    constexpr int kExecutions = 4;
+    CBLQueryExecution* executions[kExecutions];
+    for (int i = 0; i < kExecutions; ++i) {
+        executions[i] = CBLQuery_ExecuteAsync(query, AsyncState::callback, &state);
+        REQUIRE(executions[i]);
+    }
+    REQUIRE(state.waitForCount(kExecutions));
+    CHECK(state.resultCounts() == vector<int>(kExecutions, 3));
+    for (auto execution : executions) {
+        CHECK(!CBLQueryExecution_Cancel(execution));   // Already finished
+        CBLQueryExecution_Release(execution);
+    }
+    
+    // The worker threads release their references just after calling back:
+    for (int i = 0; i < 100 && CBL_InstanceCount() > instanceCount; ++i)
+        this_thread::sleep_for(10ms);
+    CHECK(CBL_InstanceCount() == instanceCount);
+}
 
-    CHECK(CBLQuery_ColumnCount(query) == 1);
-    CHECK(CBLQuery_ColumnName(query, 0) == "name"_sl);
 
-    alloc_slice explanation(CBLQuery_Explain(query));
-    cerr << string(explanation);
+TEST_CASE_METHOD(QueryTest, "Query Execute Async With Executor", "[Query]") {
+    CBLError error;
+    int errPos;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name FROM _ WHERE birthday like '1959-%'"_sl,
+                                    &errPos, &error);
+    REQUIRE(query);
+    AsyncState state;
+    
+    // An executor that just collects the tasks, so the test can decide when they run:
+    using Tasks = vector<pair<CBLQueryTask, void*>>;
+    Tasks tasks;
+    CBLQuery_SetAsyncExecutor([](void* context, CBLQueryTask task, void* taskContext) {
+        ((Tasks*)context)->emplace_back(task, taskContext);
+    }, &tasks);
+    
+    CBLQueryExecution* cancelled = CBLQuery_ExecuteAsync(query, AsyncState::callback, &state);
+    CBLQueryExecution* completed = CBLQuery_ExecuteAsync(query, AsyncState::callback, &state);
+    CBLQuery_SetAsyncExecutor(nullptr, nullptr);
+    REQUIRE(tasks.size() == 2);
+    
+    CHECK(CBLQueryExecution_Cancel(cancelled));
+    CHECK(CBLQueryExecution_Cancel(cancelled));
+    for (auto &[task, taskContext] : tasks)
+        task(taskContext);
+    CHECK(state.resultCounts() == vector<int>{3});
+    CHECK(!CBLQueryExecution_Cancel(completed));
+    
+    CBLQueryExecution_Release(cancelled);
+    CBLQueryExecution_Release(completed);
+}
 
-    static const slice kExpectedFirst[3] = {"Tyesha",  "Eddie",     "Diedre"};
-    static const slice kExpectedLast [3] = {"Loehrer", "Colangelo", "Clinton"};
 
-    int n = 0;
-    results = CBLQuery_Execute(query, &error);
-    REQUIRE(results);
-    while (CBLResultSet_Next(results)) {
-        FLDict result = CBLResultSet_ResultDict(results);
-        FLValue name = FLDict_Get(result, "name"_sl);
-        FLDict dict = FLValue_AsDict(name);
-        CHECK(dict);
-        slice first  = FLValue_AsString(FLDict_Get(dict, "first"_sl));
-        slice last   = FLValue_AsString(FLDict_Get(dict, "last"_sl));
-        REQUIRE(n < 3);
-        CHECK(first == kExpectedFirst[n]);
-        CHECK(last == kExpectedLast[n]);
-        ++n;
-        cerr << first << " " << last << "\n";
-    }
-    CHECK(n == 3);
+static bool appendJSON(void* context, FLSlice chunk) {
+    auto chunks = (vector<string>*)context;
+    chunks->push_back(string(slice(chunk)));
+    return true;
 }
 
 
-TEST_CASE_METHOD(QueryTest, "Query Result As Array", "[Query]") {
+TEST_CASE_METHOD(QueryTest, "Query Execute To JSON", "[Query]") {
     CBLError error;
     int errPos;
     query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
-                                    "SELECT name, foo FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    "SELECT name.first, foo FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
                                     &errPos, &error);
     REQUIRE(query);
+    vector<string> chunks;
+    
+    SECTION("JSON Array") {
+        REQUIRE(CBLQuery_ExecuteToJSON(query, appendJSON, &chunks, kCBLQueryJSONArray, &error));
+        string json;
+        for (auto &chunk : chunks)
+            json += chunk;
+        CHECK(json == R"([{"first":"Tyesha"},{"first":"Eddie"},{"first":"Diedre"}])");
+    }
+    
+    SECTION("NDJSON") {
+        REQUIRE(CBLQuery_ExecuteToJSON(query, appendJSON, &chunks, kCBLQueryNDJSON, &error));
+        string json;
+        for (auto &chunk : chunks)
+            json += chunk;
+        CHECK(json == "{\"first\":\"Tyesha\"}\n{\"first\":\"Eddie\"}\n{\"first\":\"Diedre\"}\n");
+    }
+    
+    SECTION("No Results") {
+        CBLQuery_Release(query);
+        query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                        "SELECT name FROM _ WHERE birthday = 'never'"_sl,
+                                        &errPos, &error);
+        REQUIRE(query);
+        REQUIRE(CBLQuery_ExecuteToJSON(query, appendJSON, &chunks, kCBLQueryJSONArray, &error));
+        REQUIRE(chunks.size() == 1);
+        CHECK(chunks[0] == "[]");
+        chunks.clear();
+        REQUIRE(CBLQuery_ExecuteToJSON(query, appendJSON, &chunks, kCBLQueryNDJSON, &error));
+        CHECK(chunks.empty());
+    }
+    
+    SECTION("Multiple Chunks") {
+        CBLQuery_Release(query);
+        query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, "SELECT * FROM _"_sl, &errPos, &error);
+        REQUIRE(query);
+        REQUIRE(CBLQuery_ExecuteToJSON(query, appendJSON, &chunks, kCBLQueryJSONArray, &error));
+        string json;
+        for (auto &chunk : chunks)
+            json += chunk;
+        Doc doc = Doc::fromJSON(json);
+        REQUIRE(doc);
+        CHECK(doc.root().asArray().count() == 100);
+        
+        chunks.clear();
+        REQUIRE(CBLQuery_ExecuteToJSON(query, appendJSON, &chunks, kCBLQueryNDJSON, &error));
+        json.clear();
+        for (auto &chunk : chunks)
+            json += chunk;
+        size_t nLines = 0;
+        for (size_t start = 0, end; (end = json.find('\n', start)) != string::npos; start = end + 1) {
+            CHECK(Doc::fromJSON(json.substr(start, end - start)).root().asDict());
+            ++nLines;
+        }
+        CHECK(nLines == 100);
+    }
+    
+    SECTION("Stop Writing") {
+        auto stop = [](void* context, FLSlice chunk) {
+            ++*(int*)context;
+            return false;
+        };
+        int calls = 0;
+        CHECK(!CBLQuery_ExecuteToJSON(query, stop, &calls, kCBLQueryJSONArray, &error));
+        CHECK(error.code == 0);
+        CHECK(calls == 1);
+    }
+}
 
-    REQUIRE(CBLQuery_ColumnCount(query) == 2);
-    CHECK(CBLQuery_ColumnName(query, 0) == "name"_sl);
-    CHECK(CBLQuery_ColumnName(query, 1) == "foo"_sl);
 
-    alloc_slice explanation(CBLQuery_Explain(query));
-    cerr << string(explanation);
+TEST_CASE_METHOD(QueryTest, "Query Execute With Stats", "[Query]") {
+    CBLError error;
+    CBLQueryStats stats;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first FROM _ ORDER BY name.first"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    
+    // Without profiling there are no stats:
+    CBLResultSet* results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    CHECK(!CBLResultSet_GetStats(results, &stats));
+    CBLResultSet_Release(results);
+    
+    results = CBLQuery_ExecuteWithStats(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    REQUIRE(CBLResultSet_GetStats(results, &stats));
+    CHECK(stats.compileTime > 0.0);
+    CHECK(stats.rowsReturned == 1);
+    CHECK(stats.firstRowTime > 0.0);
+    while (CBLResultSet_Next(results))
+        ;
+    REQUIRE(CBLResultSet_GetStats(results, &stats));
+    CHECK(stats.rowsReturned == 100);
+    CHECK(stats.totalTime >= stats.firstRowTime);
+    CHECK(stats.fullScan);
+    CHECK(stats.usesTempBTree);
+    CHECK(FLArray_Count(stats.indexesUsed) == 0);
+    CBLResultSet_Release(results);
+    CBLQuery_Release(query);
+    
+    CBLValueIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "name.first"_sl;
+    REQUIRE(CBLCollection_CreateValueIndex(defaultCollection, "byFirstName"_sl, index, &error));
+    
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name.first FROM _ ORDER BY name.first"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    results = CBLQuery_ExecuteWithStats(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_GetStats(results, &stats));
+    CHECK(!stats.fullScan);
+    CHECK(!stats.usesTempBTree);
+    CHECK(Array(stats.indexesUsed).toJSONString() == R"(["byFirstName"])");
+    CBLResultSet_Release(results);
+}
 
-    static const slice kExpectedFirst[3] = {"Tyesha",  "Eddie",     "Diedre"};
-    static const slice kExpectedLast [3] = {"Loehrer", "Colangelo", "Clinton"};
 
-    int n = 0;
+TEST_CASE_METHOD(QueryTest, "Query Stats Sampler", "[Query]") {
+    CBLError error;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name FROM _ WHERE birthday like '1959-%'"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    
+    vector<uint64_t> sampledRows;
+    CBLQuery_SetStatsSampler(3, [](void* context, const CBLQuery* query, const CBLQueryStats* stats) {
+        ((vector<uint64_t>*)context)->push_back(stats->rowsReturned);
+    }, &sampledRows);
+    
+    for (int i = 0; i < 3; ++i) {
+        CBLResultSet* results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        CHECK(countResults(results) == 3);
+        CBLResultSet_Release(results);
+    }
+    
+    // An execution that's released before reading all of its rows is still reported:
+    CBLResultSet* results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    CBLResultSet_Release(results);
+    
+    CBLQuery_SetStatsSampler(0, nullptr, nullptr);
+    CHECK(sampledRows == vector<uint64_t>{3, 1});
+    
+    sampledRows.clear();
     results = CBLQuery_Execute(query, &error);
     REQUIRE(results);
-    while (CBLResultSet_Next(results)) {
-        FLArray result = CBLResultSet_ResultArray(results);
-        REQUIRE(FLArray_Count(result) == 2);
-        FLValue name = FLArray_Get(result, 0);
-        FLDict dict = FLValue_AsDict(name);
-        CHECK(dict);
-        slice first  = FLValue_AsString(FLDict_Get(dict, "first"_sl));
-        slice last   = FLValue_AsString(FLDict_Get(dict, "last"_sl));
-        REQUIRE(n < 3);
-        CHECK(first == kExpectedFirst[n]);
-        CHECK(last == kExpectedLast[n]);
-        cerr << first << " " << last << "\n";
-        FLValue foo = FLArray_Get(result, 1);
-        CHECK(FLValue_GetType(foo) == kFLUndefined);
-        ++n;
-    }
-    CHECK(n == 3);
+    CHECK(countResults(results) == 3);
+    CBLResultSet_Release(results);
+    CHECK(sampledRows.empty());
 }
 
 
@@ -764,6 +1854,200 @@ TEST_CASE_METHOD(QueryTest, "Query Listener and Coalescing notification", "[Quer
     this_thread::sleep_for(500ms);
 }
 
+TEST_CASE_METHOD(QueryTest, "Query Listener with Coalescing Options", "[Query][LiveQuery]") {
+    CBLError error;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT name FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    
+    struct CoalescingState : ListenerState {
+        atomic<uint32_t> coalesced {0};
+    } state;
+    
+    cerr << "Adding listener\n";
+    CBLQueryChangeListenerOptions options = {1500, 5000};
+    CBLListenerToken* listenerToken = CBLQuery_AddChangeListenerWithOptions(query, [](void *context, CBLQuery* query, CBLListenerToken* token) {
+        auto state = (CoalescingState*)context;
+        state->coalesced = CBLQuery_CoalescedChangeCount(query, token);
+        state->receivedCallback(context, query, token);
+    }, &state, &options);
+    CHECK(CBLQuery_CoalescedChangeCount(query, listenerToken) == 0);
+    
+    cerr << "Waiting for listener...\n";
+    REQUIRE(state.waitForCount(1));
+    CHECK(state.resultCount() == 3);
+    CHECK(state.coalesced == 1);
+    
+    cerr << "Deleting docs, far enough apart that each changes the results...\n";
+    state.reset();
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "0000012"_sl, &error));
+    this_thread::sleep_for(1000ms); // Max delay before refreshing result in LiteCore is 500ms
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "0000046"_sl, &error));
+    
+    cerr << "Sleeping to see if the notifications are coalesced ...\n";
+    this_thread::sleep_for(3000ms);
+    REQUIRE(state.waitForCount(1));
+    CHECK(state.resultCount() == 1);
+    CHECK(state.coalesced == 2);
+    
+    CBLListener_Remove(listenerToken);
+    listenerToken = nullptr;
+    cerr << "Sleeping to ensure async cleanup ..." << endl;
+    this_thread::sleep_for(500ms);
+}
+
+
+/** For keeping track of the changes reported to a diff listener. */
+struct DiffListenerState {
+    struct Change {
+        CBLQueryRowChangeType type;
+        uint32_t index;
+        string key;
+        uint32_t oldIndex;
+    };
+    
+    vector<Change> changes() {
+        lock_guard<mutex> lock(_mutex);
+        return _changes;
+    }
+    
+    void receivedChanges(const CBLQueryRowChange changes[], size_t numChanges) {
+        lock_guard<mutex> lock(_mutex);
+        ++_count;
+        _changes.clear();
+        for (size_t i = 0; i < numChanges; ++i) {
+            REQUIRE(FLArray_Count(changes[i].row) == 2);
+            _changes.push_back({changes[i].type, changes[i].index,
+                                string(FLValue_AsString(changes[i].key)), changes[i].oldIndex});
+        }
+    }
+    
+    bool waitForCount(int target) {
+        int timeoutCount = 0;
+        while (timeoutCount++ < 50) {
+            {
+                lock_guard<mutex> lock(_mutex);
+                if (_count == target)
+                    return true;
+            }
+            this_thread::sleep_for(100ms);
+        }
+        return false;
+    }
+    
+private:
+    std::mutex _mutex;
+    int _count {0};
+    vector<Change> _changes;
+};
+
+
+TEST_CASE_METHOD(QueryTest, "Query Diff Listener", "[Query][LiveQuery]") {
+    CBLError error;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id, gender FROM _ WHERE birthday like '1959-%' ORDER BY birthday"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+    
+    cerr << "Adding diff listener\n";
+    DiffListenerState state;
+    CBLListenerToken* listenerToken = CBLQuery_AddDiffListener(query, [](void *context, CBLQuery* query,
+                                                                         const CBLQueryRowChange changes[],
+                                                                         size_t numChanges) {
+        ((DiffListenerState*)context)->receivedChanges(changes, numChanges);
+    }, &state);
+    
+    cerr << "Waiting for listener...\n";
+    REQUIRE(state.waitForCount(1));
+    auto changes = state.changes();
+    REQUIRE(changes.size() == 3);
+    for (uint32_t i = 0; i < 3; ++i) {
+        CHECK(changes[i].type == kCBLQueryRowInserted);
+        CHECK(changes[i].index == i);
+    }
+    CHECK(changes[0].key == "0000046");
+    CHECK(changes[1].key == "0000091");
+    CHECK(changes[2].key == "0000012");
+    
+    cerr << "Updating a doc...\n";
+    CBLDocument* doc = CBLCollection_GetMutableDocument(defaultCollection, "0000091"_sl, &error);
+    REQUIRE(doc);
+    FLMutableDict_SetString(CBLDocument_MutableProperties(doc), "gender"_sl, "unknown"_sl);
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+    CBLDocument_Release(doc);
+    
+    REQUIRE(state.waitForCount(2));
+    changes = state.changes();
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].type == kCBLQueryRowUpdated);
+    CHECK(changes[0].index == 1);
+    CHECK(changes[0].key == "0000091");
+    
+    cerr << "Deleting a doc...\n";
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "0000046"_sl, &error));
+    
+    REQUIRE(state.waitForCount(3));
+    changes = state.changes();
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].type == kCBLQueryRowRemoved);
+    CHECK(changes[0].index == 0);
+    CHECK(changes[0].key == "0000046");
+    
+    CBLListener_Remove(listenerToken);
+    listenerToken = nullptr;
+    cerr << "Sleeping to ensure async cleanup ..." << endl;
+    this_thread::sleep_for(500ms);
+}
+
+TEST_CASE_METHOD(QueryTest, "Query Diff Listener Reordering", "[Query][LiveQuery]") {
+    createDocWithJSON(defaultCollection, "a", R"({"diffRank": 1})");
+    createDocWithJSON(defaultCollection, "b", R"({"diffRank": 2})");
+    createDocWithJSON(defaultCollection, "c", R"({"diffRank": 3})");
+
+    CBLError error;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id, diffRank FROM _ WHERE diffRank IS VALUED ORDER BY diffRank"_sl,
+                                    nullptr, &error);
+    REQUIRE(query);
+
+    DiffListenerState state;
+    CBLListenerToken* listenerToken = CBLQuery_AddDiffListener(query, [](void *context, CBLQuery* query,
+                                                                         const CBLQueryRowChange changes[],
+                                                                         size_t numChanges) {
+        ((DiffListenerState*)context)->receivedChanges(changes, numChanges);
+    }, &state);
+    REQUIRE(state.waitForCount(1));
+    CHECK(state.changes().size() == 3);
+
+    // Moving "c" to the front reports it alone as moved; "a" and "b" only shift:
+    CBLDocument* doc = CBLCollection_GetMutableDocument(defaultCollection, "c"_sl, &error);
+    REQUIRE(doc);
+    FLMutableDict_SetInt(CBLDocument_MutableProperties(doc), "diffRank"_sl, 0);
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+    CBLDocument_Release(doc);
+
+    REQUIRE(state.waitForCount(2));
+    auto changes = state.changes();
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].type == kCBLQueryRowMoved);
+    CHECK(changes[0].key == "c");
+    CHECK(changes[0].index == 0);
+    CHECK(changes[0].oldIndex == 2);
+
+    // Removing "c" shifts the others back without moving them:
+    REQUIRE(CBLCollection_DeleteDocumentByID(defaultCollection, "c"_sl, &error));
+    REQUIRE(state.waitForCount(3));
+    changes = state.changes();
+    REQUIRE(changes.size() == 1);
+    CHECK(changes[0].type == kCBLQueryRowRemoved);
+    CHECK(changes[0].index == 0);
+
+    CBLListener_Remove(listenerToken);
+    this_thread::sleep_for(500ms);
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Query Default Collection", "[Query]") {
     string queryString;
     
@@ -1115,6 +2399,49 @@ TEST_CASE_METHOD(QueryTest, "FTS Join with Collections", "[Query]"){
     CHECK(n == 1);
 }
 
+TEST_CASE_METHOD(QueryTest, "FTS Matches and Snippets", "[Query]") {
+    CBLError error;
+    int errPos;
+    createDocWithJSON(defaultCollection, "fox1", R"({"text": "The quick brown fox jumps over the lazy dog"})");
+    createDocWithJSON(defaultCollection, "fox2", R"({"text": "A slow red fox naps"})");
+
+    CBLFullTextIndexConfiguration index = {};
+    index.expressionLanguage = kCBLN1QLLanguage;
+    index.expressions = "text"_sl;
+    REQUIRE(CBLCollection_CreateFullTextIndex(defaultCollection, "textIndex"_sl, index, &error));
+
+    // The indexed text comes from the index pass, along with the rank:
+    const slice kTerms = "Quick NOT lazy fox*"_sl;
+    query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage,
+                                    "SELECT meta().id, text FROM _ WHERE MATCH(textIndex, 'quick fox') "
+                                    "ORDER BY RANK(textIndex)"_sl, &errPos, &error);
+    REQUIRE(query);
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    CHECK(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0)) == "fox1"_sl);
+    slice text = FLValue_AsString(CBLResultSet_ValueAtIndex(results, 1));
+
+    CBLFullTextMatch matches[4];
+    REQUIRE(CBLFullText_FindMatches(text, kTerms, matches, 4) == 2);
+    CHECK(slice((const char*)text.buf + matches[0].offset, matches[0].length) == "quick"_sl);
+    CHECK(slice((const char*)text.buf + matches[1].offset, matches[1].length) == "fox"_sl);
+    CHECK(CBLFullText_FindMatches(text, kTerms, nullptr, 0) == 2);
+
+    alloc_slice snippet = CBLFullText_Snippet(text, kTerms, nullptr);
+    CHECK(snippet == "The <b>quick</b> brown <b>fox</b> jumps over the lazy dog"_sl);
+
+    CBLFullTextSnippetOptions options = {};
+    options.startMark = "["_sl;
+    options.endMark = "]"_sl;
+    options.ellipsis = "…"_sl;
+    options.maxWords = 3;
+    snippet = CBLFullText_Snippet(text, kTerms, &options);
+    CHECK(snippet == "…[quick] brown [fox]…"_sl);
+    CHECK(!CBLResultSet_Next(results));
+}
+
+
 TEST_CASE_METHOD(QueryTest, "Test Select All Result Key", "[Query]") {
     CBLError error {};
     auto flowers = CreateCollection(db, "flowers", "test");
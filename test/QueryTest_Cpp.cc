@@ -19,8 +19,10 @@
 #include "CBLTest.hh"
 #include "CBLTest_Cpp.hh"
 #include "cbl/CouchbaseLite.h"
+#include "cbl++/Coroutines.hh"
 #include "fleece/Fleece.hh"
 #include "fleece/Mutable.hh"
+#include <future>
 #include <iostream>
 #include <mutex>
 #include <thread>
@@ -75,6 +77,153 @@ TEST_CASE_METHOD(QueryTest_Cpp, "Query C++ API", "[Query][QueryCpp]") {
 }
 
 
+TEST_CASE_METHOD(QueryTest_Cpp, "Query Result Batches C++ API", "[Query][QueryCpp]") {
+    Query query = db.createQuery(kCBLN1QLLanguage, "SELECT name.first, birthday FROM _ ORDER BY birthday");
+    
+    vector<string> expected;
+    for (auto &result : query.execute())
+        expected.push_back(string(result[0].asString()));
+    REQUIRE(expected.size() == 100);
+    
+    vector<string> firstNames;
+    size_t nBatches = 0;
+    auto results = query.execute();
+    ResultBatch batch;
+    while (results.nextBatch(30, batch)) {
+        REQUIRE(batch.columnCount() == 2);
+        CHECK(batch.count() <= 30);
+        for (size_t row = 0; row < batch.count(); ++row) {
+            firstNames.push_back(string(batch.value(row, 0).asString()));
+            CHECK(batch.value(row, 1).type() == kFLString);
+        }
+        ++nBatches;
+    }
+    CHECK(nBatches == 4);
+    CHECK(firstNames == expected);
+}
+
+
+namespace {
+    struct NameRow {
+        string                  first;
+        string                  gender;
+        int64_t                 likes {-1};
+        optional<string>        nickname;
+        alloc_slice             birthday;
+    };
+}
+
+template<> struct cbl::RowMapping<NameRow> {
+    static constexpr auto columns = std::make_tuple(cbl::column(0, &NameRow::first),
+                                                    cbl::column("gender", &NameRow::gender),
+                                                    cbl::column("nLikes", &NameRow::likes),
+                                                    cbl::column("nickname", &NameRow::nickname),
+                                                    cbl::column(4, &NameRow::birthday));
+};
+
+namespace {
+    struct MissingColumnRow {string zip;};
+}
+
+template<> struct cbl::RowMapping<MissingColumnRow> {
+    static constexpr auto columns = std::make_tuple(cbl::column("zip", &MissingColumnRow::zip));
+};
+
+namespace {
+    struct CountRow {int64_t n {-1};};
+}
+
+template<> struct cbl::RowMapping<CountRow> {
+    static constexpr auto columns = std::make_tuple(cbl::column("n", &CountRow::n));
+};
+
+
+TEST_CASE_METHOD(QueryTest_Cpp, "Query Typed Rows C++ API", "[Query][QueryCpp]") {
+    Query query = db.createQuery(kCBLN1QLLanguage, "SELECT name.first, gender, ARRAY_COUNT(likes) AS nLikes,"
+                                                   " name.nickname, birthday FROM _ ORDER BY birthday");
+    vector<NameRow> expected;
+    for (auto &result : query.execute()) {
+        expected.push_back({string(result[0].asString()), string(result[1].asString()),
+                            result[2].asInt(), nullopt, alloc_slice(result[4].asString())});
+    }
+    REQUIRE(expected.size() == 100);
+
+    size_t n = 0;
+    for (const NameRow &row : query.execute<NameRow>()) {
+        REQUIRE(n < expected.size());
+        CHECK(row.first == expected[n].first);
+        CHECK(row.gender == expected[n].gender);
+        CHECK(row.likes == expected[n].likes);
+        CHECK(!row.nickname);
+        CHECK(row.birthday == expected[n].birthday);
+        ++n;
+    }
+    CHECK(n == expected.size());
+
+    auto rows = query.execute<NameRow>();
+    NameRow row;
+    REQUIRE(rows.next(row));
+    CHECK(row.first == expected[0].first);
+
+    CHECK_THROWS_AS(query.execute<MissingColumnRow>(), std::invalid_argument);
+}
+
+
+
+namespace {
+    // A coroutine that starts running when called, and fulfils a future when it returns:
+    struct TestCoroutine {
+        struct promise_type {
+            std::promise<void> done;
+            TestCoroutine get_return_object()               {return {done.get_future()};}
+            std::suspend_never initial_suspend() noexcept   {return {};}
+            std::suspend_never final_suspend() noexcept     {return {};}
+            void return_void()                              {done.set_value();}
+            void unhandled_exception()                      {done.set_exception(std::current_exception());}
+        };
+        std::future<void> finished;
+    };
+}
+
+
+TEST_CASE_METHOD(QueryTest_Cpp, "Query Coroutines C++ API", "[Query][QueryCpp]") {
+    Query query = db.createQuery(kCBLN1QLLanguage, "SELECT name.first FROM _ ORDER BY name.first");
+    CollectionChangeStream changes(defaultCollection);
+
+    // The coroutine resumes on other threads, so it only records what happens for the checks:
+    size_t nRows = 0, nBatches = 0, nStreamedRows = 0;
+    bool saved = false, deleted = false;
+    vector<alloc_slice> changedIDs;
+    auto coroutine = [&]() -> TestCoroutine {
+        ResultSet results = co_await awaitExecute(query);
+        for (CBL_UNUSED auto &result : results)
+            ++nRows;
+
+        ResultStream stream(query, 30);
+        while (const ResultBatch *batch = co_await stream.next()) {
+            ++nBatches;
+            nStreamedRows += batch->count();
+        }
+
+        MutableDocument doc("coroutine");
+        doc["greeting"] = "hello";
+        saved = co_await awaitSave(defaultCollection, doc);
+        if (auto docIDs = co_await changes.next())
+            changedIDs = std::move(*docIDs);
+        deleted = co_await awaitDelete(defaultCollection, doc);
+    };
+    coroutine().finished.get();
+
+    CHECK(nRows == 100);
+    CHECK(nBatches == 4);
+    CHECK(nStreamedRows == 100);
+    CHECK(saved);
+    CHECK(changedIDs == vector<alloc_slice>{alloc_slice("coroutine")});
+    CHECK(deleted);
+    CHECK(!defaultCollection.getDocument("coroutine"));
+}
+
+
 static int countResults(ResultSet &results) {
     int n = 0;
     for (CBL_UNUSED auto &result : results)
@@ -82,6 +231,25 @@ static int countResults(ResultSet &results) {
     return n;
 }
 
+TEST_CASE_METHOD(QueryTest_Cpp, "Query Execute Async C++ API", "[Query][QueryCpp]") {
+    Query query = db.createQuery(kCBLN1QLLanguage, "SELECT name FROM _ WHERE birthday like '1959-%'");
+    unsigned instanceCount = CBL_InstanceCount();
+    {
+        auto execution1 = query.executeAsync();
+        auto execution2 = query.executeAsync();
+        auto results1 = execution1.get();
+        auto results2 = execution2.get();
+        CHECK(countResults(results1) == 3);
+        CHECK(countResults(results2) == 3);
+        CHECK(!execution1.cancel());
+    }
+    
+    // The worker threads release their references just after calling back:
+    for (int i = 0; i < 100 && CBL_InstanceCount() > instanceCount; ++i)
+        this_thread::sleep_for(10ms);
+    CHECK(CBL_InstanceCount() == instanceCount);
+}
+
 TEST_CASE_METHOD(QueryTest_Cpp, "Query Listener C++ API", "[Query][QueryCpp]") {
     Query query(db, kCBLN1QLLanguage, "SELECT name FROM _ WHERE birthday like '1959-%' ORDER BY birthday");
     {
@@ -218,3 +386,71 @@ TEST_CASE_METHOD(QueryTest_Cpp, "C++ Query Parameters", "[Query][QueryCpp]") {
     }
     CHECK(n == 1);
 }
+
+
+TEST_CASE_METHOD(QueryTest_Cpp, "C++ Prepared Query", "[Query][QueryCpp]") {
+    static constexpr QueryString kCount = "SELECT count(*) AS n FROM _";
+    PreparedQuery<kCount + " WHERE contact.address.zip BETWEEN $zip0 AND $zip1 AND $all"
+                         + " AND gender != '$zip0'"> query;
+    static_assert(query.parameterNames.size() == 3);
+    static_assert(query.parameterNames[2] == "all");
+
+    auto count = [&](auto zip0, auto zip1, bool all) {
+        int64_t n = -1;
+        for (auto &result : query.execute(db, zip0, zip1, all))
+            n = result[0].asInt();
+        return n;
+    };
+    CHECK(count("30000", "39999", true) == 7);
+    CHECK(count(string("30000"), "30000"_sl, true) == 0);
+    CHECK(count("30000", "39999", false) == 0);
+
+    auto typed = query.executeRows<CountRow>(db, "30000", "39999", true);
+    CountRow row;
+    REQUIRE(typed.next(row));
+    CHECK(row.n == 7);
+
+    // Concurrent executions don't see each other's arguments:
+    std::atomic<int> wrong {0};
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, all = (t % 2 == 0)] {
+            for (int i = 0; i < 20; ++i) {
+                if (count("30000", "39999", all) != (all ? 7 : 0))
+                    ++wrong;
+            }
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+    CHECK(wrong == 0);
+
+    query.forget(db);
+    CHECK(count("30000", "39999", true) == 7);
+}
+
+
+TEST_CASE_METHOD(QueryTest_Cpp, "C++ Query Vectors", "[Query][QueryCpp]") {
+    const vector<float> target {1.0f, 2.5f, -3.0f};
+    Query query = db.createQuery(kCBLN1QLLanguage, "SELECT ARRAY_LENGTH($v) AS n, $v[1] AS second FROM _ LIMIT 1");
+    query.setParameter("v", target);
+    int n = 0;
+    for (auto &result : query.execute()) {
+        CHECK(result[0].asInt() == 3);
+        CHECK(result[1].asFloat() == 2.5f);
+        ++n;
+    }
+    CHECK(n == 1);
+
+    // A vector stored as data is read in place when it's aligned, else an empty span:
+    auto array = MutableArray::newArray();
+    array.append().setData(slice(target.data(), target.size() * sizeof(float)));
+    array.append() = "not a vector";
+    auto vec = asVector(array[0]);
+    if (!vec.empty()) {
+        CHECK(vec.data() == array[0].asData().buf);
+        CHECK(std::equal(vec.begin(), vec.end(), target.begin(), target.end()));
+    }
+    CHECK(asVector(array[1]).empty());
+    CHECK(asVector(fleece::Value()).empty());
+}
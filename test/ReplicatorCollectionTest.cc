@@ -19,7 +19,9 @@
 #include "ReplicatorTest.hh"
 #include "CBLPrivate.h"
 #include "fleece/Fleece.hh"
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #ifdef COUCHBASE_ENTERPRISE
 
@@ -596,6 +598,316 @@ TEST_CASE_METHOD(ReplicatorCollectionTest, "Conflict Resolver with Collections",
     CBLDocument_Release(bar1);
 }
 
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Batched Conflict Resolution with Collections", "[Replicator]") {
+    static constexpr unsigned kNumDocs = 20;
+    char docID[20];
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        createDocWithJSON(cx[0], docID, kDefaultDocContent);
+    }
+    
+    auto cols = collectionConfigs({cx[0]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.collections[0].conflictResolver = [](void *context,
+                                                FLString documentID,
+                                                const CBLDocument *localDocument,
+                                                const CBLDocument *remoteDocument) -> const CBLDocument* {
+        return remoteDocument;
+    };
+    config.maxConcurrentConflictResolvers = 2;
+    config.conflictResolverBatchSize = 8;
+    config.replicatorType = kCBLReplicatorTypePush;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    // Change every doc on both sides:
+    CBLError error {};
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        for (auto col : {cx[0], cy[0]}) {
+            auto doc = CBLCollection_GetMutableDocument(col, slice(docID), &error);
+            REQUIRE(doc);
+            REQUIRE(CBLDocument_SetJSON(doc, slice(col == cx[0] ? "{\"side\":\"local\"}"
+                                                                : "{\"side\":\"remote\"}"), &error));
+            REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+            CBLDocument_Release(doc);
+        }
+    }
+    
+    resetReplicator();
+    config.replicatorType = kCBLReplicatorTypePull;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        auto doc = CBLCollection_GetDocument(cx[0], slice(docID), &error);
+        REQUIRE(doc);
+        CHECK(Dict(CBLDocument_Properties(doc)).toJSONString() == "{\"side\":\"remote\"}");
+        CBLDocument_Release(doc);
+    }
+    
+    // Each batch saved up to 8 resolutions in one transaction:
+    auto stats = CBLReplicator_Status(repl).conflictResolution;
+    CHECK(stats.documentCount == kNumDocs);
+    CHECK(stats.batchCount >= (kNumDocs + 7) / 8);
+    CHECK(stats.lastBatchSize >= 1);
+    CHECK(stats.lastBatchSize <= 8);
+    CHECK(stats.totalTime >= stats.lastBatchTime);
+}
+
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Conflict Resolution by Collection Priority", "[Replicator]") {
+    static constexpr unsigned kNumDocs = 10;
+    char docID[20];
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        createDocWithJSON(cx[0], docID, kDefaultDocContent);
+        createDocWithJSON(cx[1], docID, kDefaultDocContent);
+    }
+    
+    static std::vector<std::string> sResolvedIn;
+    sResolvedIn.clear();
+    auto resolver = [](void *context,
+                       FLString documentID,
+                       const CBLDocument *localDocument,
+                       const CBLDocument *remoteDocument) -> const CBLDocument* {
+        sResolvedIn.push_back(CollectionPath(CBLDocument_Collection(remoteDocument)));
+        return remoteDocument;
+    };
+    
+    auto cols = collectionConfigs({cx[0], cx[1]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.collections[0].conflictResolver = resolver;
+    config.collections[1].conflictResolver = resolver;
+    config.collections[1].priority = 1;
+    config.replicatorType = kCBLReplicatorTypePush;
+    expectedDocumentCount = 2 * kNumDocs;
+    replicate();
+    
+    CBLError error {};
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        for (auto col : {cx[0], cy[0], cx[1], cy[1]}) {
+            auto doc = CBLCollection_GetMutableDocument(col, slice(docID), &error);
+            REQUIRE(doc);
+            REQUIRE(CBLDocument_SetJSON(doc, slice(col == cx[0] || col == cx[1] ? "{\"side\":\"local\"}"
+                                                                                : "{\"side\":\"remote\"}"), &error));
+            REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+            CBLDocument_Release(doc);
+        }
+    }
+    
+    // One resolver, and one batch that waits for all the conflicts:
+    resetReplicator();
+    config.maxConcurrentConflictResolvers = 1;
+    config.conflictResolverBatchSize = 2 * kNumDocs;
+    config.conflictResolverBatchDelay = 5000;
+    config.replicatorType = kCBLReplicatorTypePull;
+    expectedDocumentCount = 2 * kNumDocs;
+    replicate();
+    
+    REQUIRE(sResolvedIn.size() == 2 * kNumDocs);
+    for (unsigned i = 0; i < 2 * kNumDocs; ++i)
+        CHECK(sResolvedIn[i] == (i < kNumDocs ? "scopeA.colB" : "scopeA.colA"));
+}
+
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Batch Conflict Resolver with Collections", "[Replicator]") {
+    static constexpr unsigned kNumDocs = 10;
+    char docID[20];
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        createDocWithJSON(cx[0], docID, kDefaultDocContent);
+    }
+    
+    static size_t sCalls, sConflicts, sMaxBatch;
+    sCalls = sConflicts = sMaxBatch = 0;
+    auto cols = collectionConfigs({cx[0]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.collections[0].batchConflictResolver = [](void *context,
+                                                     CBLCollection *collection,
+                                                     CBLConflict conflicts[],
+                                                     size_t count) {
+        ++sCalls;
+        sConflicts += count;
+        sMaxBatch = std::max(sMaxBatch, count);
+        // Even-numbered docs keep the local revision, odd ones take the remote:
+        for (size_t i = 0; i < count; ++i) {
+            bool even = (((const char*)conflicts[i].documentID.buf)[5] - '0') % 2 == 0;
+            conflicts[i].resolved = even ? conflicts[i].localDocument : conflicts[i].remoteDocument;
+        }
+    };
+    config.conflictResolverBatchSize = 4;
+    config.conflictResolverBatchDelay = 100;
+    config.replicatorType = kCBLReplicatorTypePush;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    // Change every doc on both sides:
+    CBLError error {};
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        for (auto col : {cx[0], cy[0]}) {
+            auto doc = CBLCollection_GetMutableDocument(col, slice(docID), &error);
+            REQUIRE(doc);
+            REQUIRE(CBLDocument_SetJSON(doc, slice(col == cx[0] ? "{\"side\":\"local\"}"
+                                                                : "{\"side\":\"remote\"}"), &error));
+            REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+            CBLDocument_Release(doc);
+        }
+    }
+    
+    resetReplicator();
+    config.replicatorType = kCBLReplicatorTypePull;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    CHECK(sConflicts == kNumDocs);
+    CHECK(sCalls < kNumDocs);
+    CHECK(sMaxBatch <= 4);
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        auto doc = CBLCollection_GetDocument(cx[0], slice(docID), &error);
+        REQUIRE(doc);
+        CHECK(Dict(CBLDocument_Properties(doc)).toJSONString() ==
+              (i % 2 == 0 ? "{\"side\":\"local\"}" : "{\"side\":\"remote\"}"));
+        CBLDocument_Release(doc);
+    }
+}
+
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Batch Conflict Resolver Skipping Conflicts", "[Replicator]") {
+    static constexpr unsigned kNumDocs = 6;
+    char docID[20];
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        createDocWithJSON(cx[0], docID, kDefaultDocContent);
+    }
+    
+    auto cols = collectionConfigs({cx[0]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.collections[0].batchConflictResolver = [](void *context,
+                                                     CBLCollection *collection,
+                                                     CBLConflict conflicts[],
+                                                     size_t count) {
+        // Only odd-numbered docs are resolved, to the remote revision; the rest are skipped:
+        for (size_t i = 0; i < count; ++i) {
+            CHECK(conflicts[i].resolved == conflicts[i].localDocument);
+            bool odd = (((const char*)conflicts[i].documentID.buf)[5] - '0') % 2 == 1;
+            if (odd)
+                conflicts[i].resolved = conflicts[i].remoteDocument;
+        }
+    };
+    config.replicatorType = kCBLReplicatorTypePush;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    CBLError error {};
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        for (auto col : {cx[0], cy[0]}) {
+            auto doc = CBLCollection_GetMutableDocument(col, slice(docID), &error);
+            REQUIRE(doc);
+            REQUIRE(CBLDocument_SetJSON(doc, slice(col == cx[0] ? "{\"side\":\"local\"}"
+                                                                : "{\"side\":\"remote\"}"), &error));
+            REQUIRE(CBLCollection_SaveDocument(col, doc, &error));
+            CBLDocument_Release(doc);
+        }
+    }
+    
+    resetReplicator();
+    config.replicatorType = kCBLReplicatorTypePull;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    // The skipped conflicts kept the local revision rather than deleting the doc:
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        auto doc = CBLCollection_GetDocument(cx[0], slice(docID), &error);
+        REQUIRE(doc);
+        CHECK(Dict(CBLDocument_Properties(doc)).toJSONString() ==
+              (i % 2 == 0 ? "{\"side\":\"local\"}" : "{\"side\":\"remote\"}"));
+        CBLDocument_Release(doc);
+    }
+}
+
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Coalesced Document Replication Listener", "[Replicator]") {
+    static constexpr unsigned kNumDocs = 50;
+    char docID[20];
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        createDocWithJSON(cx[0], docID, kDefaultDocContent);
+    }
+    
+    auto cols = collectionConfigs({cx[0]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.replicatorType = kCBLReplicatorTypePush;
+    config.documentListenerMaxDelay = 1000;
+    config.documentListenerMaxBatch = 20;
+    
+    CBLError error {};
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+    
+    std::vector<unsigned> batchSizes;
+    auto token = CBLReplicator_AddDocumentReplicationListener(repl, [](void *context, CBLReplicator *r,
+                                                                       bool isPush,
+                                                                       unsigned numDocuments,
+                                                                       const CBLReplicatedDocument* documents) {
+        ((std::vector<unsigned>*)context)->push_back(numDocuments);
+    }, &batchSizes);
+    
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    // Every document was reported by the time the replicator stopped, in batches of up to 20:
+    CHECK(replicatedDocs.size() == kNumDocs);
+    unsigned total = 0;
+    for (auto n : batchSizes) {
+        CHECK(n <= 20);
+        total += n;
+    }
+    CHECK(total == kNumDocs);
+    CBLListener_Remove(token);
+}
+
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Replicator Metrics", "[Replicator]") {
+    static constexpr unsigned kNumDocs = 20;
+    char docID[20];
+    for (unsigned i = 0; i < kNumDocs; ++i) {
+        snprintf(docID, sizeof(docID), "doc-%02u", i);
+        createDocWithJSON(cx[0], docID, kDefaultDocContent);
+    }
+    
+    auto cols = collectionConfigs({cx[0]});
+    cols[0].pushFilter = [](void *context, CBLDocument* doc, CBLDocumentFlags flags) -> bool {
+        return true;
+    };
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.replicatorType = kCBLReplicatorTypePush;
+    expectedDocumentCount = kNumDocs;
+    replicate();
+    
+    CBLReplicatorMetrics metrics = CBLReplicator_GetMetrics(repl);
+    CHECK(metrics.activeTime > 0);
+    CHECK(metrics.documentsPushed == kNumDocs);
+    CHECK(metrics.documentsPulled == 0);
+    CHECK(metrics.documentErrors == 0);
+    CHECK(metrics.documentsPushedPerSecond > 0);
+    CHECK(metrics.pushFilter.count == kNumDocs);
+    CHECK(metrics.pushFilter.maxTime <= metrics.pushFilter.totalTime);
+    uint64_t histogramTotal = 0;
+    for (auto n : metrics.pushFilter.histogram)
+        histogramTotal += n;
+    CHECK(histogramTotal == metrics.pushFilter.count);
+    CHECK(metrics.pullFilter.count == 0);
+    CHECK(metrics.conflictResolver.count == 0);
+}
+
 TEST_CASE_METHOD(ReplicatorCollectionTest, "Resolve Pending Conflicts", "[Replicator]") {
     createDocWithJSON(cx[0], "foo1", kDefaultDocContent);
     
@@ -879,6 +1191,68 @@ TEST_CASE_METHOD(ReplicatorCollectionTest, "Collection Pull Filters", "[Replicat
     REQUIRE(!bar3);
 }
 
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Collection Filter Expressions", "[Replicator]") {
+    createDocWithJSON(cx[0], "foo1", "{\"type\":\"order\", \"total\":150}");
+    createDocWithJSON(cx[0], "foo2", "{\"type\":\"order\", \"total\":50}");
+    createDocWithJSON(cx[0], "foo3", "{\"type\":\"note\", \"total\":500}");
+    // Mixed types collate as in N1QL, where strings sort after numbers and booleans before:
+    createDocWithJSON(cx[0], "foo4", "{\"type\":\"order\", \"total\":\"5\"}");
+    createDocWithJSON(cx[0], "foo5", "{\"type\":\"order\", \"total\":true}");
+    
+    createDocWithJSON(cy[1], "bar1", "{\"tags\":[\"a\"], \"owner\":{\"name\":\"pat\"}}");
+    createDocWithJSON(cy[1], "bar2", "{\"tags\":[\"b\"], \"owner\":{\"name\":\"pat\"}}");
+    createDocWithJSON(cy[1], "bar3", "{\"tags\":[\"a\"]}");
+    
+    static int sFilterCalls;
+    sFilterCalls = 0;
+    auto pullFilter = [](void *context, CBLDocument* doc, CBLDocumentFlags flags) -> bool {
+        ++sFilterCalls;     // Only called for docs that match the expression
+        return slice(CBLDocument_ID(doc)) != "bar3"_sl;
+    };
+    
+    auto cols = collectionConfigs({cx[0], cx[1]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    
+    config.collections[0].pushFilterExpression = "type = 'order' AND total > 100"_sl;
+    config.collections[1].pullFilterExpression = "tags[0] IN ['a', 'c'] OR owner.name IS MISSING"_sl;
+    config.collections[1].pullFilter = pullFilter;
+    
+    config.replicatorType = kCBLReplicatorTypePushAndPull;
+    expectedDocumentCount = 3;
+    replicate();
+    
+    CHECK(sFilterCalls == 2);
+    
+    CHECK(CBLCollection_Count(cy[0]) == 2);
+    CBLError error {};
+    auto foo1 = CBLCollection_GetDocument(cy[0], "foo1"_sl, &error);
+    REQUIRE(foo1);
+    CBLDocument_Release(foo1);
+    auto foo4 = CBLCollection_GetDocument(cy[0], "foo4"_sl, &error);
+    REQUIRE(foo4);
+    CBLDocument_Release(foo4);
+    
+    CHECK(CBLCollection_Count(cx[1]) == 1);
+    auto bar1 = CBLCollection_GetDocument(cx[1], "bar1"_sl, &error);
+    REQUIRE(bar1);
+    CBLDocument_Release(bar1);
+}
+
+TEST_CASE_METHOD(ReplicatorCollectionTest, "Invalid Collection Filter Expression", "[Replicator]") {
+    ExpectingExceptions x;
+    
+    auto cols = collectionConfigs({cx[0]});
+    config.collections = cols.data();
+    config.collectionCount = cols.size();
+    config.collections[0].pushFilterExpression = "type = 'order' AND"_sl;
+    
+    CBLError error {};
+    CBLReplicator* r = CBLReplicator_Create(&config, &error);
+    REQUIRE(!r);
+    CheckError(error, kCBLErrorInvalidQuery);
+}
+
 TEST_CASE_METHOD(ReplicatorCollectionTest, "Collection Document Pending", "[Replicator]") {
     createDocWithJSON(cx[0], "foo1", kDefaultDocContent);
     createDocWithJSON(cx[0], "foo2", kDefaultDocContent);
@@ -966,6 +1340,15 @@ TEST_CASE_METHOD(ReplicatorCollectionTest, "Collection Document Pending", "[Repl
     FLDict_Release(pending2);
     
     CHECK(CBLReplicator_IsDocumentPending2(repl, "bar1"_sl, cx[1], &error));
+    
+    // Check several docs at once:
+    FLString ids[] = {"foo1"_sl, "foo2"_sl, "foo3"_sl, "nope"_sl};
+    bool pending[4];
+    REQUIRE(CBLReplicator_ArePendingDocuments(repl, ids, 4, cx[0], pending, &error));
+    CHECK(!pending[0]);
+    CHECK(pending[1]);
+    CHECK(!pending[2]);
+    CHECK(!pending[3]);
 }
 
 #endif
@@ -18,6 +18,10 @@
 
 #include "ReplicatorTest.hh"
 #include "CBLPrivate.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <mutex>
 #include <string>
 
 
@@ -99,6 +103,61 @@ TEST_CASE_METHOD(ReplicatorLocalTest, "Continuous Push to local db", "[Replicato
 }
 
 
+TEST_CASE_METHOD(ReplicatorLocalTest, "Checkpoint Interval", "[Replicator]") {
+    config.replicatorType = kCBLReplicatorTypePush;
+    
+    // By default LiteCore's own interval is used:
+    CBLError error;
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+    CHECK(!replicatorOptions(repl)["checkpointInterval"]);
+    resetReplicator();
+    
+    config.checkpointInterval = 1;
+    createNumberedDocsWithPrefix(defaultCollection, 20, "doc");
+    replicate();
+    CHECK(replicatorOptions(repl)["checkpointInterval"].asUnsigned() == 1);
+    CHECK(replicatedDocIDs.size() == 20);
+    CHECK(otherDBDefaultCol.count() == 20);
+    resetReplicator();
+    
+    // A new replicator resumes from the saved checkpoint, so it only pushes the new docs:
+    createNumberedDocsWithPrefix(defaultCollection, 5, "doc", 21);
+    replicatedDocIDs.clear();
+    replicate();
+    CHECK(replicatedDocIDs.size() == 5);
+    CHECK(otherDBDefaultCol.count() == 25);
+}
+
+
+TEST_CASE_METHOD(ReplicatorLocalTest, "Local Replication Sends Whole Revisions", "[Replicator]") {
+    config.replicatorType = kCBLReplicatorTypePush;
+    
+    MutableDocument doc("big");
+    doc["text"] = string(10000, 'a');
+    doc["count"] = 1;
+    defaultCollection.saveDocument(doc);
+    replicate();
+    
+    // Deltas are turned off even though the config didn't ask for it:
+    CHECK(!config.disableDeltas);
+    CHECK(replicatorOptions(repl)["noDeltas"].asBool());
+    resetReplicator();
+    
+    // A small change to a big revision, which a remote peer would get as a delta, still arrives:
+    doc = defaultCollection.getMutableDocument("big");
+    doc["count"] = 2;
+    defaultCollection.saveDocument(doc);
+    replicatedDocIDs.clear();
+    replicate();
+    CHECK(asVector(replicatedDocIDs) == vector<string>{"big"});
+    Document copied = otherDBDefaultCol.getDocument("big");
+    REQUIRE(copied);
+    CHECK(copied["count"].asInt() == 2);
+    CHECK(copied["text"].asString().size == 10000);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLocalTest, "Set Suspended", "[Replicator]") {
     config.replicatorType = kCBLReplicatorTypePush;
     config.continuous = true;
@@ -118,6 +177,34 @@ TEST_CASE_METHOD(ReplicatorLocalTest, "Set Suspended", "[Replicator]") {
 }
 
 
+TEST_CASE_METHOD(ReplicatorLocalTest, "Status While Change Listener Is Running", "[Replicator]") {
+    config.replicatorType = kCBLReplicatorTypePush;
+    
+    MutableDocument doc("foo");
+    doc["greeting"] = "Howdy!";
+    defaultCollection.saveDocument(doc);
+    
+    // Reading the status on another thread must not wait for a listener to return:
+    struct Context { int calls = 0; int statusReads = 0; } ctx;
+    CBLError error;
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+    auto token = CBLReplicator_AddChangeListener(repl, [](void *context, CBLReplicator *r,
+                                                          const CBLReplicatorStatus *status) {
+        auto ctx = (Context*)context;
+        ++ctx->calls;
+        auto reader = std::async(std::launch::async, [r] {return CBLReplicator_Status(r);});
+        if (reader.wait_for(5s) == std::future_status::ready)
+            ++ctx->statusReads;
+    }, &ctx);
+    
+    replicate();
+    CBLListener_Remove(token);
+    CHECK(ctx.calls > 0);
+    CHECK(ctx.statusReads == ctx.calls);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLocalTest, "Pending Documents", "[Replicator]") {
     config.replicatorType = kCBLReplicatorTypePush;
     
@@ -161,6 +248,83 @@ TEST_CASE_METHOD(ReplicatorLocalTest, "Pending Documents", "[Replicator]") {
     CHECK(error.code == 0);
 }
 
+
+TEST_CASE_METHOD(ReplicatorLocalTest, "Pull Documents Now", "[Replicator]") {
+    config.replicatorType = kCBLReplicatorTypePull;
+
+    for (const char *docID : {"foo1", "foo2", "foo3"}) {
+        MutableDocument doc(docID);
+        doc["greeting"] = "Howdy!";
+        otherDBDefaultCol.saveDocument(doc);
+    }
+
+    CBLError error;
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+
+    // The replicator's document listener hears about the documents, though it isn't running:
+    struct Context {
+        std::mutex mutex;
+        vector<string> docIDs;
+        std::promise<vector<string>> pulled;
+    } ctx;
+    auto token = CBLReplicator_AddDocumentReplicationListener(repl, [](void *context, CBLReplicator *r,
+                                                                       bool isPush,
+                                                                       unsigned numDocuments,
+                                                                       const CBLReplicatedDocument* documents) {
+        auto ctx = (Context*)context;
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        for (unsigned i = 0; i < numDocuments; ++i)
+            ctx->docIDs.push_back(string(slice(documents[i].ID)));
+        if (ctx->docIDs.size() == 2)
+            ctx->pulled.set_value(ctx->docIDs);
+    }, &ctx);
+
+    FLString docIDs[] = {"foo2"_sl, "foo3"_sl};
+    REQUIRE(CBLReplicator_PullDocumentsNow(repl, defaultCollection.ref(), docIDs, 2, &error));
+    auto pulled = ctx.pulled.get_future();
+    REQUIRE(pulled.wait_for(10s) == std::future_status::ready);
+    auto ids = pulled.get();
+    std::sort(ids.begin(), ids.end());
+    CHECK(ids == vector<string>{"foo2", "foo3"});
+
+    CHECK(!defaultCollection.getDocument("foo1"));
+    CHECK(defaultCollection.getDocument("foo2"));
+    CHECK(defaultCollection.getDocument("foo3"));
+
+    // IDs requested while a pull is running are queued, and pulled when it stops:
+    for (const char *docID : {"foo4", "foo5"}) {
+        MutableDocument doc(docID);
+        doc["greeting"] = "Hi!";
+        otherDBDefaultCol.saveDocument(doc);
+    }
+    {
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        ctx.docIDs.clear();
+        ctx.pulled = std::promise<vector<string>>();
+    }
+    pulled = ctx.pulled.get_future();
+    FLString firstID[] = {"foo4"_sl}, secondID[] = {"foo5"_sl};
+    REQUIRE(CBLReplicator_PullDocumentsNow(repl, defaultCollection.ref(), firstID, 1, &error));
+    REQUIRE(CBLReplicator_PullDocumentsNow(repl, defaultCollection.ref(), secondID, 1, &error));
+    REQUIRE(pulled.wait_for(10s) == std::future_status::ready);
+    ids = pulled.get();
+    std::sort(ids.begin(), ids.end());
+    CHECK(ids == vector<string>{"foo4", "foo5"});
+    CHECK(defaultCollection.getDocument("foo4"));
+    CHECK(defaultCollection.getDocument("foo5"));
+    CBLListener_Remove(token);
+
+    // A push replicator can't pull:
+    config.replicatorType = kCBLReplicatorTypePush;
+    resetReplicator();
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+    ExpectingExceptions x;
+    CHECK(!CBLReplicator_PullDocumentsNow(repl, defaultCollection.ref(), docIDs, 2, &error));
+    CHECK(error.code == kCBLErrorInvalidParameter);
+}
+
 /*
  https://github.com/couchbaselabs/couchbase-lite-api/blob/master/spec/tests/T0005-Version-Vector.md
  4. DefaultConflictResolverDeleteWins
@@ -629,6 +793,76 @@ TEST_CASE_METHOD(ReplicatorConflictTest, "Custom resolver : merge", "[Replicator
 }
 
 
+TEST_CASE_METHOD(ReplicatorLocalTest, "Conflict-free values merge without resolver", "[Replicator][Conflict]") {
+    CBLError error;
+    static int resolverCalls;
+    resolverCalls = 0;
+    config.conflictResolver = [](void*, FLString, const CBLDocument *local, const CBLDocument*) {
+        ++resolverCalls;
+        return local;
+    };
+    
+    // Save a doc with a counter and a set, and push it:
+    auto doc = CBLDocument_CreateWithID("post"_sl);
+    auto props = CBLDocument_MutableProperties(doc);
+    FLMutableDict_SetString(props, "title"_sl, "Hello"_sl);
+    REQUIRE(FLMutableDict_IncrementCounter(props, "likes"_sl, db.ref(), 1, &error));
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, db.ref(), "news"_sl, &error));
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, db.ref(), "draft"_sl, &error));
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+    CBLDocument_Release(doc);
+    
+    config.replicatorType = kCBLReplicatorTypePush;
+    replicate();
+    
+    // Change the counter and set in both databases:
+    doc = CBLCollection_GetMutableDocument(defaultCollection.ref(), "post"_sl, &error);
+    props = CBLDocument_MutableProperties(doc);
+    REQUIRE(FLMutableDict_IncrementCounter(props, "likes"_sl, db.ref(), 2, &error));
+    REQUIRE(FLMutableDict_RemoveFromORSet(props, "tags"_sl, "draft"_sl, &error));
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+    CBLDocument_Release(doc);
+    
+    doc = CBLCollection_GetMutableDocument(otherDBDefaultCol.ref(), "post"_sl, &error);
+    props = CBLDocument_MutableProperties(doc);
+    REQUIRE(FLMutableDict_IncrementCounter(props, "likes"_sl, otherDB.ref(), 10, &error));
+    REQUIRE(FLMutableDict_AddToORSet(props, "tags"_sl, otherDB.ref(), "sports"_sl, &error));
+    REQUIRE(CBLCollection_SaveDocument(otherDBDefaultCol.ref(), doc, &error));
+    CBLDocument_Release(doc);
+    
+    // Pull; the conflict is merged without calling the resolver:
+    config.replicatorType = kCBLReplicatorTypePull;
+    resetReplicator();
+    replicate();
+    CHECK(resolverCalls == 0);
+    
+    auto merged = CBLCollection_GetDocument(defaultCollection.ref(), "post"_sl, &error);
+    REQUIRE(merged);
+    Dict mergedProps(CBLDocument_Properties(merged));
+    CHECK(mergedProps["title"].asString() == "Hello"_sl);
+    CHECK(FLValue_GetCounterValue(mergedProps["likes"]) == 13);
+    FLMutableArray tags = FLDict_GetORSetMembers(mergedProps["tags"].asDict());
+    CHECK(Array(tags).toJSONString() == R"(["news","sports"])");
+    FLMutableArray_Release(tags);
+    CBLDocument_Release(merged);
+    
+    // Conflicts in other properties still go to the resolver:
+    doc = CBLCollection_GetMutableDocument(defaultCollection.ref(), "post"_sl, &error);
+    FLMutableDict_SetString(CBLDocument_MutableProperties(doc), "title"_sl, "Hi"_sl);
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+    CBLDocument_Release(doc);
+    
+    doc = CBLCollection_GetMutableDocument(otherDBDefaultCol.ref(), "post"_sl, &error);
+    FLMutableDict_SetString(CBLDocument_MutableProperties(doc), "title"_sl, "Hey"_sl);
+    REQUIRE(CBLCollection_SaveDocument(otherDBDefaultCol.ref(), doc, &error));
+    CBLDocument_Release(doc);
+    
+    resetReplicator();
+    replicate();
+    CHECK(resolverCalls == 1);
+}
+
+
 TEST_CASE_METHOD(ReplicatorLocalTest, "Document Replication Listener", "[Replicator]") {
     // No listener:
     MutableDocument doc("foo");
@@ -656,6 +890,28 @@ TEST_CASE_METHOD(ReplicatorLocalTest, "Document Replication Listener", "[Replica
     CHECK(replicatedDocIDs.empty());
 }
 
+TEST_CASE_METHOD(ReplicatorLocalTest, "Buffered Replicator Notifications", "[Replicator]") {
+    MutableDocument doc("foo");
+    doc["greeting"] = "Howdy!";
+    defaultCollection.saveDocument(doc);
+    
+    std::atomic<int> readyCalls {0};
+    CBLDatabase_BufferNotifications(db.ref(), [](void *context, CBLDatabase*) {
+        ++*(std::atomic<int>*)context;
+    }, &readyCalls);
+    
+    // The listeners' calls are queued, not made on the replicator's thread:
+    config.replicatorType = kCBLReplicatorTypePush;
+    replicate();
+    CHECK(readyCalls > 0);
+    CHECK(replicatedDocIDs.empty());
+    
+    // `replicate` removed the listeners, so the queued calls are dropped:
+    CBLDatabase_SendNotifications(db.ref());
+    CHECK(replicatedDocIDs.empty());
+    CBLDatabase_BufferNotifications(db.ref(), nullptr, nullptr);
+}
+
 TEST_CASE_METHOD(ReplicatorLocalTest, "DocIDs Push Filters", "[Replicator]") {
     MutableDocument doc1("foo1");
     doc1["greeting"] = "Howdy!";
@@ -785,4 +1041,53 @@ TEST_CASE_METHOD(ReplicatorFilterTest, "Pull Filter", "[Replicator][Filter]") {
 }
 
 
+
+TEST_CASE_METHOD(ReplicatorLocalTest, "Incremental Rekey Keeps Replication State", "[Replicator]") {
+    CBL_DeleteDatabase("rekeydb"_sl, nullslice, nullptr);
+    CBL_DeleteDatabase("rekeydb~rekey"_sl, nullslice, nullptr);
+
+    CBLError error {};
+    CBLDatabase *rekeydb = CBLDatabase_Open("rekeydb"_sl, nullptr, &error);
+    REQUIRE(rekeydb);
+    createDocWithPair(rekeydb, "foo1"_sl, "greeting"_sl, "Howdy!"_sl);
+    createDocWithPair(rekeydb, "foo2"_sl, "greeting"_sl, "Hello!"_sl);
+
+    config.database = rekeydb;
+    config.replicatorType = kCBLReplicatorTypePush;
+    replicate();
+    CHECK(asVector(replicatedDocIDs) == vector<string>{"foo1", "foo2"});
+    resetReplicator();
+
+    // A database that has replicated can be rekeyed incrementally:
+    CBLEncryptionKey key {};
+    CBLEncryptionKey_FromPassword(&key, "sekrit"_sl);
+    CBLRekeyProgress progress {};
+    REQUIRE(CBLDatabase_RekeyStep(rekeydb, &key, 100, &progress, &error));
+    CHECK(progress.documentsCopied == 2);
+    createDocWithPair(rekeydb, "foo3"_sl, "greeting"_sl, "Hi!"_sl);
+    REQUIRE(CBLDatabase_FinishRekey(rekeydb, &key, &error));
+    CBLDatabase_Release(rekeydb);
+
+    // The copy knows which revisions the other database has, so only the new one is pending:
+    CBLDatabaseConfiguration dbConfig = {nullslice, key};
+    rekeydb = CBLDatabase_Open("rekeydb"_sl, &dbConfig, &error);
+    REQUIRE(rekeydb);
+    config.database = rekeydb;
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+    CHECK(!CBLReplicator_IsDocumentPending(repl, "foo1"_sl, &error));
+    CHECK(!CBLReplicator_IsDocumentPending(repl, "foo2"_sl, &error));
+    CHECK(CBLReplicator_IsDocumentPending(repl, "foo3"_sl, &error));
+    CHECK(error.code == 0);
+
+    replicatedDocIDs.clear();
+    replicate();
+    CHECK(replicatedDocIDs.count("foo3") == 1);
+    CHECK(otherDBDefaultCol.count() == 3);
+    resetReplicator();
+
+    CHECK(CBLDatabase_Delete(rekeydb, &error));
+    CBLDatabase_Release(rekeydb);
+}
+
 #endif // COUCHBASE_ENTERPRISE
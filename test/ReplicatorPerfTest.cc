@@ -0,0 +1,252 @@
+//
+// ReplicatorPerfTest.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "ReplicatorTest.hh"
+#include <atomic>
+#include <cstdlib>
+#include <string>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef COUCHBASE_ENTERPRISE     // Local-to-local replication and property encryption are EE features
+
+
+/** Measures replication throughput: pushing and pulling many documents, plain, with blobs,
+    with encrypted properties, or in conflict with the other side's. The other side is a local
+    database, or a Sync Gateway at CBL_TEST_SERVER_URL (see ReplicatorTest.cc). */
+class ReplicatorPerfTest : public ReplicatorTest {
+public:
+    static constexpr unsigned kDocs = 100000;
+    static constexpr size_t kBodySize = 500;        // Bytes of text per document
+    static constexpr size_t kBlobSize = 4096;       // Bytes per blob
+
+    enum Payload {kPlain, kBlobs, kEncrypted};
+
+    Database otherDB;
+    uint64_t payloadBytes = 0;                      // Size of the documents' text and blobs
+    std::atomic<bool> firstDocSeen {false};
+    time firstDocTime;
+
+    ReplicatorPerfTest()
+    :otherDB(openDatabaseNamed("otherDB", true)) // empty
+    ,ReplicatorTest()
+    {
+        enableDocReplicationListener = false;
+        config.propertyEncryptor = [](void*, FLString, FLDict, FLString, FLSlice input,
+                                      FLStringResult*, FLStringResult*, CBLError*) {
+            return xorCipher(input);
+        };
+        config.propertyDecryptor = [](void*, FLString, FLDict, FLString, FLSlice input,
+                                      FLString, FLString, CBLError*) {
+            return xorCipher(input);
+        };
+    }
+
+    ~ReplicatorPerfTest() {
+        otherDB.close();
+        otherDB = nullptr;
+    }
+
+    static FLSliceResult xorCipher(FLSlice input) {
+        alloc_slice output(input);
+        for (size_t i = 0; i < input.size; ++i)
+            (uint8_t&)output[i] = output[i] ^ 'K';
+        return FLSliceResult(output);
+    }
+
+    // Starts over with an empty database, replicating with the other one -- also emptied, unless
+    // `keepOther` is true -- or with `url`.
+    void reset(bool keepOther = false, const string &url = "") {
+        resetReplicator();
+        db.close();
+        db = openDatabaseNamed(kDatabaseName, true);
+        defaultCollection = db.getDefaultCollection();
+        if (!keepOther) {
+            otherDB.close();
+            otherDB = openDatabaseNamed("otherDB", true);
+        }
+        config.database = db.ref();
+
+        CBLEndpoint_Free(config.endpoint);
+        CBLError error {};
+        if (url.empty())
+            config.endpoint = CBLEndpoint_CreateWithLocalDB(otherDB.ref());
+        else
+            config.endpoint = CBLEndpoint_CreateWithURL(slice(url), &error);
+        REQUIRE(config.endpoint);
+        payloadBytes = 0;
+    }
+
+    // Saves `kDocs` documents with the given payload in one transaction.
+    void populate(Database &database, Payload payload, const string &variant, const string &idPrefix = "doc-") {
+        CBLCollection* collection = database.getDefaultCollection().ref();
+        string body(kBodySize, variant.back());
+        string blobData(kBlobSize, variant.back());
+        CBLError error {};
+        Transaction t(database);
+        for (unsigned i = 0; i < kDocs; ++i) {
+            CBLDocument* doc = CBLDocument_CreateWithID(slice(idPrefix + to_string(i)));
+            FLMutableDict props = CBLDocument_MutableProperties(doc);
+            FLMutableDict_SetString(props, "variant"_sl, slice(variant));
+            if (payload == kEncrypted)
+                FLSlot_SetEncryptableString(FLMutableDict_Set(props, "body"_sl), slice(body));
+            else
+                FLMutableDict_SetString(props, "body"_sl, slice(body));
+            payloadBytes += kBodySize;
+            if (payload == kBlobs) {
+                CBLBlob* blob = CBLBlob_CreateWithData("application/octet-stream"_sl, slice(blobData));
+                FLMutableDict_SetBlob(props, "blob"_sl, blob);
+                CBLBlob_Release(blob);
+                payloadBytes += kBlobSize;
+            }
+            REQUIRE(CBLCollection_SaveDocument(collection, doc, &error));
+            CBLDocument_Release(doc);
+        }
+        t.commit();
+    }
+
+    // The size of the text and blobs of the documents in the local database, as pulled.
+    uint64_t localPayloadBytes() {
+        CBLError error {};
+        int errPos;
+        CBLQuery* query = CBLDatabase_CreateQuery(db.ref(), kCBLN1QLLanguage,
+                                                  "SELECT IFMISSINGORNULL(LENGTH(body), LENGTH(body.value)),"
+                                                  " IFMISSINGORNULL(blob.length, 0) FROM _"_sl, &errPos, &error);
+        REQUIRE(query);
+        CBLResultSet* results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        uint64_t bytes = 0;
+        while (CBLResultSet_Next(results)) {
+            bytes += FLValue_AsUnsigned(CBLResultSet_ValueAtIndex(results, 0));
+            bytes += FLValue_AsUnsigned(CBLResultSet_ValueAtIndex(results, 1));
+        }
+        CBLResultSet_Release(results);
+        CBLQuery_Release(query);
+        return bytes;
+    }
+
+    // The process's peak resident memory so far, in MB, or 0 if unknown.
+    static double peakMemoryMB() {
+#ifdef _WIN32
+        return 0;
+#else
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1048576.0;         // bytes
+#else
+        return usage.ru_maxrss / 1024.0;            // kilobytes
+#endif
+#endif
+    }
+
+    // Runs the replicator to completion and reports its throughput. If `payloadBytes` is zero,
+    // it's measured from what was pulled.
+    void run(const string &what) {
+        CBLError error {};
+        repl = CBLReplicator_Create(&config, &error);
+        REQUIRE(repl);
+        firstDocSeen = false;
+        auto token = CBLReplicator_AddDocumentReplicationListener(repl, [](void *context, CBLReplicator*,
+                                                                           bool, unsigned,
+                                                                           const CBLReplicatedDocument*) {
+            auto test = (ReplicatorPerfTest*)context;
+            if (!test->firstDocSeen.exchange(true))
+                test->firstDocTime = clock::now();
+        }, this);
+
+        double memoryBefore = peakMemoryMB();
+        time start = clock::now();
+        CBLReplicator_Start(repl, false);
+        CBLReplicatorStatus status;
+        do {
+            this_thread::sleep_for(10ms);
+            status = CBLReplicator_Status(repl);
+        } while (status.activity != kCBLReplicatorStopped);
+        double elapsed = std::chrono::duration_cast<seconds>(clock::now() - start).count();
+        CBLListener_Remove(token);
+
+        CHECK(status.error.code == 0);
+        if (payloadBytes == 0)
+            payloadBytes = localPayloadBytes();
+        CBLReplicatorMetrics metrics = CBLReplicator_GetMetrics(repl);
+        uint64_t docs = metrics.documentsPushed + metrics.documentsPulled;
+        double firstDoc = firstDocSeen ? std::chrono::duration_cast<seconds>(firstDocTime - start).count() : 0;
+        double memoryAfter = peakMemoryMB();
+        cerr << what << ": " << docs << " docs in " << elapsed << " sec: "
+             << docs / elapsed << " docs/sec, " << payloadBytes / elapsed / 1e6 << " MB/sec of payload; "
+             << "first doc after " << firstDoc * 1000 << " ms; peak memory " << memoryAfter << " MB"
+             << " (+" << (memoryAfter - memoryBefore) << " MB)\n";
+        if (status.conflictResolution.documentCount > 0)
+            cerr << "    Resolved " << status.conflictResolution.documentCount << " conflicts in "
+                 << status.conflictResolution.totalTime << " ms\n";
+    }
+};
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Benchmark Local Replication", "[Perf][.slow]") {
+    // Pushes the documents to the other database, then pulls them back into an empty one,
+    // which also decrypts what the push encrypted:
+    const char* kPayloadNames[] = {"plain", "with blobs", "with encryption"};
+    for (Payload payload : {kPlain, kBlobs, kEncrypted}) {
+        reset();
+        populate(db, payload, "push");
+        config.replicatorType = kCBLReplicatorTypePush;
+        run(string("Push ") + kPayloadNames[payload]);
+
+        reset(true);
+        config.replicatorType = kCBLReplicatorTypePull;
+        run(string("Pull ") + kPayloadNames[payload]);
+    }
+
+    // Every pulled document conflicts with a local one, which the default resolver resolves:
+    reset();
+    populate(otherDB, kPlain, "remote");
+    payloadBytes = 0;
+    populate(db, kPlain, "local");
+    config.replicatorType = kCBLReplicatorTypePull;
+    run("Pull with conflicts");
+}
+
+
+TEST_CASE_METHOD(ReplicatorPerfTest, "Benchmark Sync Gateway Replication", "[Perf][.slow][.Server]") {
+    const char *url = getenv("CBL_TEST_SERVER_URL");            // e.g. "ws://localhost:4984"
+    if (!url) {
+        CBL_Log(kCBLLogDomainReplicator, kCBLLogWarning, "Skipping test; server URL not configured");
+        return;
+    }
+    // Each run pushes new documents, then pulls everything in the server's database into an
+    // empty one; so the pulls are of all the documents pushed so far, of every payload.
+    string scratchURL = string(url) + "/scratch";
+    string runID = to_string(CBL_Now());
+    const char* kPayloadNames[] = {"plain", "with blobs", "with encryption"};
+    for (Payload payload : {kPlain, kBlobs, kEncrypted}) {
+        reset(false, scratchURL);
+        populate(db, payload, "push", runID + "-" + to_string(payload) + "-");
+        config.replicatorType = kCBLReplicatorTypePush;
+        run(string("Push to Sync Gateway ") + kPayloadNames[payload]);
+
+        reset(false, scratchURL);
+        config.replicatorType = kCBLReplicatorTypePull;
+        run(string("Pull from Sync Gateway after pushing ") + kPayloadNames[payload]);
+    }
+}
+
+#endif
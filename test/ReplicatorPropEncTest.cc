@@ -28,6 +28,8 @@ public:
     Collection otherDBDefaultCol = otherDB.getDefaultCollection();
     int encryptCount = 0;
     int decryptCount = 0;
+    int encryptBatchCount = 0;
+    int decryptBatchCount = 0;
     
     slice keyID = nullptr;
     slice algorithm = nullptr;
@@ -150,6 +152,43 @@ public:
         return FLSliceResult(decrypted);
     }
     
+    void setupBatchEncryptionCallback() {
+        config.documentPropertyBatchEncryptor = [](void* context, FLString scope, FLString collection,
+                                                   CBLEncryptableProperty props[], size_t count,
+                                                   void* buffer, size_t capacity, CBLError* error)
+        {
+            auto test = (ReplicatorPropertyEncryptionTest*)context;
+            test->encryptBatchCount++;
+            test->encryptCount += int(count);
+            xorBatch(props, count, buffer, capacity);
+        };
+        
+        config.documentPropertyBatchDecryptor = [](void* context, FLString scope, FLString collection,
+                                                   CBLEncryptableProperty props[], size_t count,
+                                                   void* buffer, size_t capacity, CBLError* error)
+        {
+            auto test = (ReplicatorPropertyEncryptionTest*)context;
+            test->decryptBatchCount++;
+            test->decryptCount += int(count);
+            for (size_t i = 0; i < count; ++i)
+                CHECK(slice(props[i].algorithm) == "CB_MOBILE_CUSTOM"_sl);
+            xorBatch(props, count, buffer, capacity);
+        };
+    }
+    
+    // Same cipher as `encrypt` and `decrypt`, but writing all the outputs into one buffer:
+    static void xorBatch(CBLEncryptableProperty props[], size_t count, void* buffer, size_t capacity) {
+        auto out = (uint8_t*)buffer;
+        for (size_t i = 0; i < count; ++i) {
+            slice input = props[i].input;
+            REQUIRE(out + input.size <= (uint8_t*)buffer + capacity);
+            for (size_t j = 0; j < input.size; ++j)
+                out[j] = ((const uint8_t*)input.buf)[j] ^ 'K';
+            props[i].output = {out, input.size};
+            out += input.size;
+        }
+    }
+    
     void createEncryptedDoc(CBLCollection* collection, FLString docID, FLString secret ="Secret 1"_sl) {
         auto doc = CBLDocument_CreateWithID(docID);
         FLMutableDict props = CBLDocument_MutableProperties(doc);
@@ -294,6 +333,46 @@ TEST_CASE_METHOD(ReplicatorPropertyEncryptionTest, "Save and Get document with E
     CBLDocument_Release(doc);
 }
 
+TEST_CASE_METHOD(ReplicatorPropertyEncryptionTest, "Set and Read Encryptables in Place", "[Encryptable]") {
+    auto doc = CBLDocument_CreateWithID("doc1"_sl);
+    FLMutableDict props = CBLDocument_MutableProperties(doc);
+    FLSlot_SetEncryptableNull(FLMutableDict_Set(props, "null"_sl));
+    FLSlot_SetEncryptableBool(FLMutableDict_Set(props, "bool"_sl), true);
+    FLSlot_SetEncryptableInt(FLMutableDict_Set(props, "int"_sl), -256);
+    FLSlot_SetEncryptableUInt(FLMutableDict_Set(props, "uint"_sl), 1024);
+    FLSlot_SetEncryptableDouble(FLMutableDict_Set(props, "double"_sl), 35.61);
+    FLSlot_SetEncryptableString(FLMutableDict_Set(props, "string"_sl), "foo"_sl);
+    FLSlot_SetString(FLMutableDict_Set(props, "plain"_sl), "bar"_sl);
+    
+    // The same as setting CBLEncryptables:
+    auto encryptable = CBLEncryptable_CreateWithString("foo"_sl);
+    CHECK(Dict(FLValue_AsDict(FLDict_Get(props, "string"_sl))).toJSON(false, true) ==
+          Dict(CBLEncryptable_Properties(encryptable)).toJSON(false, true));
+    CBLEncryptable_Release(encryptable);
+    
+    CBLError error;
+    REQUIRE(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+    CBLDocument_Release(doc);
+    
+    auto saved = CBLCollection_GetDocument(defaultCollection.ref(), "doc1"_sl, &error);
+    REQUIRE(saved);
+    Dict savedProps = CBLDocument_Properties(saved);
+    CHECK(FLValue_GetType(FLValue_GetEncryptableContent(savedProps["null"])) == kFLNull);
+    CHECK(FLValue_AsBool(FLValue_GetEncryptableContent(savedProps["bool"])) == true);
+    CHECK(FLValue_AsInt(FLValue_GetEncryptableContent(savedProps["int"])) == -256);
+    CHECK(FLValue_AsUnsigned(FLValue_GetEncryptableContent(savedProps["uint"])) == 1024);
+    CHECK(FLValue_AsDouble(FLValue_GetEncryptableContent(savedProps["double"])) == 35.61);
+    CHECK(slice(FLValue_AsString(FLValue_GetEncryptableContent(savedProps["string"]))) == "foo"_sl);
+    CHECK(!FLValue_GetEncryptableContent(savedProps["plain"]));
+    CHECK(!FLValue_GetEncryptableContent(savedProps["missing"]));
+    
+    // It reads the same value as the CBLEncryptable:
+    auto getEncryptable = FLValue_GetEncryptableValue(savedProps["string"]);
+    REQUIRE(getEncryptable);
+    CHECK(CBLEncryptable_Value(getEncryptable) == FLValue_GetEncryptableContent(savedProps["string"]));
+    CBLDocument_Release(saved);
+}
+
 TEST_CASE_METHOD(ReplicatorPropertyEncryptionTest, "Unsupport : Encryptables in array", "[Encryptable]") {
     CBLError error;
     auto doc = CBLDocument_CreateWithID("doc1"_sl);
@@ -509,6 +588,72 @@ TEST_CASE_METHOD(ReplicatorPropertyEncryptionTest, "Encrypt and decrypt multiple
     }
 }
 
+TEST_CASE_METHOD(ReplicatorPropertyEncryptionTest, "Batch encrypt and decrypt multiple properties", "[Replicator][Encryptable]") {
+    {
+        auto doc = CBLDocument_CreateWithID("doc1"_sl);
+        auto props = CBLDocument_MutableProperties(doc);
+        
+        auto secret1 = CBLEncryptable_CreateWithString("Secret 1"_sl);
+        FLMutableDict_SetEncryptableValue(props, "secret1"_sl, secret1);
+        
+        auto secret2 = CBLEncryptable_CreateWithInt(10);
+        FLMutableDict_SetEncryptableValue(props, "secret2"_sl, secret2);
+        
+        auto nestedDict = FLMutableDict_New();
+        auto secret3 = CBLEncryptable_CreateWithBool(true);
+        FLMutableDict_SetEncryptableValue(nestedDict, "secret3"_sl, secret3);
+        FLSlot_SetDict(FLMutableDict_Set(props, "nested"_sl), nestedDict);
+        
+        CBLError error;
+        CHECK(CBLCollection_SaveDocument(defaultCollection.ref(), doc, &error));
+        
+        CBLDocument_Release(doc);
+        FLMutableDict_Release(nestedDict);
+        CBLEncryptable_Release(secret1);
+        CBLEncryptable_Release(secret2);
+        CBLEncryptable_Release(secret3);
+        
+        config.replicatorType = kCBLReplicatorTypePushAndPull;
+        setupBatchEncryptionCallback();
+        replicate();
+        
+        // The ciphertexts are the same as from the per-property encryptor:
+        doc = CBLCollection_GetMutableDocument(otherDBDefaultCol.ref(), "doc1"_sl, &error);
+        props = CBLDocument_MutableProperties(doc);
+        CHECK(Dict(FLValue_AsDict(FLDict_Get(props, "encrypted$secret1"_sl))).toJSON(false, true) ==
+              "{\"alg\":\"CB_MOBILE_CUSTOM\",\"ciphertext\":\"aRguKDkuP2t6aQ==\"}");
+        CHECK(Dict(FLValue_AsDict(FLDict_Get(props, "encrypted$secret2"_sl))).toJSON(false, true) ==
+              "{\"alg\":\"CB_MOBILE_CUSTOM\",\"ciphertext\":\"ens=\"}");
+        auto nested = FLValue_AsDict(FLDict_Get(props, "nested"_sl));
+        CHECK(Dict(FLValue_AsDict(FLDict_Get(nested, "encrypted$secret3"_sl))).toJSON(false, true) ==
+              "{\"alg\":\"CB_MOBILE_CUSTOM\",\"ciphertext\":\"Pzk+Lg==\"}");
+        
+        CHECK(encryptBatchCount == 1);
+        CHECK(encryptCount == 3);
+        CBLDocument_Release(doc);
+    }
+    
+    {
+        resetDBAndReplicator();
+        replicate();
+        
+        CBLError error;
+        auto doc = CBLCollection_GetMutableDocument(defaultCollection.ref(), "doc1"_sl, &error);
+        auto props = CBLDocument_Properties(doc);
+        CHECK(Dict(FLValue_AsDict(FLDict_Get(props, "secret1"_sl))).toJSON(false, true) ==
+              "{\"@type\":\"encryptable\",\"value\":\"Secret 1\"}");
+        CHECK(Dict(FLValue_AsDict(FLDict_Get(props, "secret2"_sl))).toJSON(false, true) ==
+              "{\"@type\":\"encryptable\",\"value\":10}");
+        auto nested = FLValue_AsDict(FLDict_Get(props, "nested"_sl));
+        CHECK(Dict(FLValue_AsDict(FLDict_Get(nested, "secret3"_sl))).toJSON(false, true) ==
+              "{\"@type\":\"encryptable\",\"value\":true}");
+        
+        CHECK(decryptBatchCount == 1);
+        CHECK(decryptCount == 3);
+        CBLDocument_Release(doc);
+    }
+}
+
 TEST_CASE_METHOD(ReplicatorPropertyEncryptionTest, "No encryptor : crypto error", "[Replicator][Encryptable]") {
     auto doc = CBLDocument_CreateWithID("doc1"_sl);
     auto props = CBLDocument_MutableProperties(doc);
@@ -17,6 +17,9 @@
 //
 
 #include "ReplicatorTest.hh"
+#include <algorithm>
+#include <future>
+#include <mutex>
 
 using namespace fleece;
 
@@ -69,6 +72,176 @@ TEST_CASE_METHOD(ReplicatorTest, "Bad url", "[Replicator]") {
     CHECK(error.code == kCBLErrorInvalidParameter);
 }
 
+TEST_CASE_METHOD(ReplicatorTest, "Transport Endpoint", "[Replicator]") {
+    CBLTransportFactory factory = {};
+    factory.messageFraming = true;
+    factory.open = [](void*, CBLTransport*, FLString) { };
+    factory.send = [](CBLTransport*, FLSliceResult data) {FLSliceResult_Release(data);};
+    factory.receiveCompleted = [](CBLTransport*, size_t) { };
+    factory.close = [](CBLTransport*, int, FLString) { };
+
+    // Any scheme is allowed:
+    CBLError error;
+    CBLEndpoint* endpoint = CBLEndpoint_CreateWithTransport(&factory, "quic://peer:4443/db"_sl, &error);
+    REQUIRE(endpoint);
+
+    config.endpoint = endpoint;
+    repl = CBLReplicator_Create(&config, &error);
+    CHECK(repl);
+
+    {
+        ExpectingExceptions x;
+        // No db:
+        CHECK(!CBLEndpoint_CreateWithTransport(&factory, "quic://peer:4443"_sl, &error));
+        CHECK(error.code == kCBLErrorInvalidParameter);
+        // Missing callback:
+        factory.send = nullptr;
+        CHECK(!CBLEndpoint_CreateWithTransport(&factory, "quic://peer:4443/db"_sl, &error));
+        CHECK(error.domain == kCBLDomain);
+        CHECK(error.code == kCBLErrorInvalidParameter);
+    }
+}
+
+// A scripted peer on the other end of a transport: it accepts the connection, and when the
+// replicator sends its first message, closes it with a policy-violation status. Its actions run
+// on threads of its own, since the transport's callbacks mustn't call back into the replicator.
+struct LoopbackPeer {
+    bool messageFraming;
+    std::mutex mutex;
+    vector<thread> threads;
+    alloc_slice firstSent;
+    size_t sendCount {0}, receivedBytes {0};
+    int closeStatus {-1};
+    int disposeCount {0};
+
+    explicit LoopbackPeer(bool framing) :messageFraming(framing) { }
+
+    ~LoopbackPeer() {
+        while (true) {
+            vector<thread> running;
+            {
+                lock_guard<std::mutex> lock(mutex);
+                running.swap(threads);
+            }
+            if (running.empty())
+                break;
+            for (auto &t : running)
+                t.join();
+        }
+    }
+
+    bool waitForDispose() {
+        for (int i = 0; i < 50; ++i) {
+            {
+                lock_guard<std::mutex> lock(mutex);
+                if (disposeCount > 0)
+                    return true;
+            }
+            this_thread::sleep_for(100ms);
+        }
+        return false;
+    }
+
+    void async(std::function<void()> fn) {
+        lock_guard<std::mutex> lock(mutex);
+        threads.emplace_back(std::move(fn));
+    }
+
+    CBLTransportFactory factory() {
+        CBLTransportFactory factory = {};
+        factory.messageFraming = messageFraming;
+        factory.context = this;
+        factory.open = [](void *context, CBLTransport *transport, FLString) {
+            auto peer = (LoopbackPeer*)context;
+            CBLTransport_SetContext(transport, peer);
+            peer->async([=] {CBLTransport_Opened(transport);});
+        };
+        factory.send = [](CBLTransport *transport, FLSliceResult data) {
+            auto peer = (LoopbackPeer*)CBLTransport_GetContext(transport);
+            size_t size = data.size;
+            bool first;
+            {
+                lock_guard<std::mutex> lock(peer->mutex);
+                first = (peer->sendCount++ == 0);
+                if (first)
+                    peer->firstSent = alloc_slice(data.buf, data.size);
+            }
+            FLSliceResult_Release(data);
+            peer->async([=] {
+                CBLTransport_SendCompleted(transport, size);
+                if (!first)
+                    return;
+                if (peer->messageFraming) {
+                    CBLTransport_CloseRequested(transport, 1008, "Go away"_sl);
+                } else {
+                    // An unmasked WebSocket CLOSE frame with status 1008:
+                    static const uint8_t kCloseFrame[] = {0x88, 0x02, 0x03, 0xF0};
+                    CBLTransport_Received(transport, {kCloseFrame, sizeof(kCloseFrame)});
+                }
+            });
+        };
+        factory.receiveCompleted = [](CBLTransport *transport, size_t byteCount) {
+            auto peer = (LoopbackPeer*)CBLTransport_GetContext(transport);
+            lock_guard<std::mutex> lock(peer->mutex);
+            peer->receivedBytes += byteCount;
+        };
+        factory.close = [](CBLTransport *transport, int status, FLString) {
+            auto peer = (LoopbackPeer*)CBLTransport_GetContext(transport);
+            {
+                lock_guard<std::mutex> lock(peer->mutex);
+                peer->closeStatus = status;
+            }
+            peer->async([=] {CBLTransport_Closed(transport, nullptr);});
+        };
+        factory.dispose = [](CBLTransport *transport) {
+            auto peer = (LoopbackPeer*)CBLTransport_GetContext(transport);
+            lock_guard<std::mutex> lock(peer->mutex);
+            ++peer->disposeCount;
+        };
+        return factory;
+    }
+};
+
+TEST_CASE_METHOD(ReplicatorTest, "Transport Endpoint Loopback", "[Replicator]") {
+    bool messageFraming = false;
+    SECTION("Byte stream") {
+        messageFraming = false;
+    }
+    SECTION("Message framing") {
+        messageFraming = true;
+    }
+    LoopbackPeer peer(messageFraming);
+    CBLTransportFactory factory = peer.factory();
+
+    CBLError error;
+    config.endpoint = CBLEndpoint_CreateWithTransport(&factory, "ipc://peer/db"_sl, &error);
+    REQUIRE(config.endpoint);
+    expectedError = {kCBLWebSocketDomain, 1008};
+    replicate();
+
+    CBLReplicator_Release(repl);
+    repl = nullptr;
+    CBLEndpoint_Free(config.endpoint);
+    config.endpoint = nullptr;
+
+    REQUIRE(peer.waitForDispose());
+    lock_guard<std::mutex> lock(peer.mutex);
+    CHECK(peer.sendCount > 0);
+    REQUIRE(peer.firstSent.size >= 2);
+    if (messageFraming) {
+        // A bare BLIP message, whose first byte is its message number:
+        CHECK(peer.firstSent[0] == 0x01);
+        CHECK(peer.closeStatus == 1008);       // Passed on from CBLTransport_CloseRequested
+    } else {
+        // A masked binary WebSocket frame, as a client sends:
+        CHECK(peer.firstSent[0] == 0x82);
+        CHECK((peer.firstSent[1] & 0x80) != 0);
+        CHECK(peer.closeStatus == 0);          // The replicator answered the CLOSE frame itself
+        CHECK(peer.sendCount >= 2);
+    }
+    CHECK(peer.disposeCount == 1);
+}
+
 #ifndef __ANDROID__
 // On Android emulator, the error returned is kCBLNetErrDNSFailure which is a transient error.
 TEST_CASE_METHOD(ReplicatorTest, "Fake Replicate", "[Replicator]") {
@@ -89,6 +262,54 @@ TEST_CASE_METHOD(ReplicatorTest, "Fake Replicate", "[Replicator]") {
     expectedError = {kCBLNetworkDomain, kCBLNetErrUnknownHost};
     replicate();
 }
+
+// On Android emulator, the error returned is kCBLNetErrDNSFailure which is a transient error.
+TEST_CASE_METHOD(ReplicatorTest, "Pull Documents Now From Unreachable Endpoint", "[Replicator]") {
+    CBLError error;
+    config.endpoint = CBLEndpoint_CreateWithURL("ws://fsdfds.vzcsg/foobar"_sl, &error);
+    REQUIRE(config.endpoint);
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+
+    // Each requested document is reported to the document listeners with the error:
+    struct Context {
+        std::mutex mutex;
+        vector<ReplicatedDoc> docs;
+        std::promise<void> done;
+    } ctx;
+    auto token = CBLReplicator_AddDocumentReplicationListener(repl, [](void *context, CBLReplicator *r,
+                                                                       bool isPush,
+                                                                       unsigned numDocuments,
+                                                                       const CBLReplicatedDocument* documents) {
+        auto ctx = (Context*)context;
+        std::lock_guard<std::mutex> lock(ctx->mutex);
+        for (unsigned i = 0; i < numDocuments; ++i) {
+            ReplicatedDoc doc {};
+            doc.docID = string(slice(documents[i].ID));
+            doc.flags = documents[i].flags;
+            doc.error = documents[i].error;
+            ctx->docs.push_back(doc);
+        }
+        if (ctx->docs.size() == 2)
+            ctx->done.set_value();
+    }, &ctx);
+
+    FLString docIDs[] = {"foo1"_sl, "foo2"_sl};
+    REQUIRE(CBLReplicator_PullDocumentsNow(repl, defaultCollection.ref(), docIDs, 2, &error));
+    REQUIRE(ctx.done.get_future().wait_for(10s) == std::future_status::ready);
+    CBLListener_Remove(token);
+
+    std::sort(ctx.docs.begin(), ctx.docs.end(), [](auto &a, auto &b) {return a.docID < b.docID;});
+    REQUIRE(ctx.docs.size() == 2);
+    for (auto &doc : ctx.docs) {
+        CHECK(doc.error.domain == kCBLNetworkDomain);
+        CHECK(doc.error.code == kCBLNetErrUnknownHost);
+    }
+    CHECK(ctx.docs[0].docID == "foo1");
+    CHECK(ctx.docs[1].docID == "foo2");
+    CHECK(!defaultCollection.getDocument("foo1"));
+    CHECK(CBLReplicator_Status(repl).activity == kCBLReplicatorStopped);
+}
 #endif
 
 #ifndef __ANDROID__
@@ -240,6 +461,33 @@ TEST_CASE_METHOD(ReplicatorTest, "Check userAgent header", "[Replicator]") {
     CBLReplicator_Release(repl1);
 }
 
+TEST_CASE_METHOD(ReplicatorTest, "Disable Deltas", "[Replicator]") {
+    CBLError error;
+    config.endpoint = CBLEndpoint_CreateWithURL("ws://localhost:4984/db"_sl, &error);
+    REQUIRE(config.endpoint);
+    
+    // By default the replicator may use deltas with a remote peer:
+    repl = CBLReplicator_Create(&config, &error);
+    REQUIRE(repl);
+    CHECK(!replicatorOptions(repl)["noDeltas"]);
+    CBLReplicator_Release(repl);
+    repl = nullptr;
+    
+    SECTION("C API") {
+        config.disableDeltas = true;
+        repl = CBLReplicator_Create(&config, &error);
+        REQUIRE(repl);
+        CHECK(replicatorOptions(repl)["noDeltas"].asBool());
+    }
+    SECTION("C++ API") {
+        ReplicatorConfiguration cppConfig({ReplicationCollection(defaultCollection)},
+                                          Endpoint::urlEndpoint("ws://localhost:4984/db"_sl));
+        cppConfig.enableDeltas = false;
+        Replicator cppRepl(cppConfig);
+        CHECK(replicatorOptions(cppRepl.ref())["noDeltas"].asBool());
+    }
+}
+
 #pragma mark - ACTUAL-NETWORK TESTS:
 
 
@@ -6,6 +6,7 @@
 
 #pragma once
 #include "CBLTest_Cpp.hh"
+#include "CBLPrivate.h"
 #include "cbl++/CouchbaseLite.hh"
 #include <chrono>
 #include <iostream>
@@ -221,6 +222,12 @@ public:
         this_thread::sleep_for(500ms);
     }
 
+    /** The options the replicator passes to LiteCore. */
+    static Doc replicatorOptions(CBLReplicator *r) {
+        alloc_slice json(CBLReplicator_OptionsJSON(r));
+        return Doc::fromJSON(json);
+    }
+
     static vector<string> asVector(const set<string> strings) {
         vector<string> out;
         for (const string &s : strings)
@@ -0,0 +1,267 @@
+//
+// VectorSearchPerfTest.cc
+//
+// Copyright (C) 2026 Couchbase, Inc All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "VectorSearchTest.hh"
+#include "Stopwatch.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <unordered_set>
+
+#ifdef COUCHBASE_ENTERPRISE
+
+#ifdef VECTOR_SEARCH_TEST_ENABLED
+
+/** Measures how vector index configurations trade build time, size, query latency and recall:
+    for each configuration it builds an index over a dataset's base vectors in the default
+    collection, then runs the dataset's queries and compares the results with a brute-force
+    search. */
+class VectorSearchPerfTest : public VectorSearchTest {
+public:
+    using Vectors = vector<vector<float>>;
+
+    static constexpr unsigned kK = 10;                  // Recall@k
+
+    struct Config {
+        string              name;
+        CBLVectorEncoding*  encoding;                   // Freed by `run`
+        unsigned            centroids;
+        unsigned            numProbes;                  // 0 for the default
+    };
+
+    // Reads vectors in the .fvecs format used by the standard ANN benchmark datasets:
+    // each vector is a little-endian int32 dimension followed by that many floats.
+    static Vectors readFVecs(const string &filename, size_t maxCount = SIZE_MAX) {
+        auto path = GetAssetFilePath(filename);
+        INFO("Reading vectors from " << path);
+        ifstream in(path, ios::binary);
+        REQUIRE(in);
+        Vectors result;
+        int32_t dimension;
+        while (result.size() < maxCount && in.read((char*)&dimension, sizeof(dimension))) {
+            REQUIRE(dimension > 0);
+            vector<float> v(dimension);
+            REQUIRE(in.read((char*)v.data(), dimension * sizeof(float)));
+            result.push_back(std::move(v));
+        }
+        REQUIRE(!result.empty());
+        return result;
+    }
+
+    // Saves each base vector in a document whose ID is its index.
+    void importVectors(const Vectors &base) {
+        CBLError error {};
+        REQUIRE(CBLDatabase_BeginTransaction(db, &error));
+        for (size_t i = 0; i < base.size(); ++i) {
+            CBLDocument* doc = CBLDocument_CreateWithID(slice(to_string(i)));
+            auto array = MutableArray::newArray();
+            for (float f : base[i])
+                array.append(f);
+            FLMutableDict_SetArray(CBLDocument_MutableProperties(doc), "vector"_sl, array);
+            REQUIRE(CBLCollection_SaveDocument(defaultCollection, doc, &error));
+            CBLDocument_Release(doc);
+        }
+        REQUIRE(CBLDatabase_EndTransaction(db, true, &error));
+    }
+
+    // The indexes of the `k` base vectors nearest to each query, by Euclidean distance.
+    static vector<vector<size_t>> bruteForce(const Vectors &base, const Vectors &queries, size_t k) {
+        vector<vector<size_t>> result;
+        vector<pair<float, size_t>> distances(base.size());
+        for (auto &query : queries) {
+            for (size_t i = 0; i < base.size(); ++i) {
+                float d = 0;
+                for (size_t j = 0; j < query.size(); ++j)
+                    d += (base[i][j] - query[j]) * (base[i][j] - query[j]);
+                distances[i] = {d, i};
+            }
+            auto n = min(k, distances.size());
+            partial_sort(distances.begin(), distances.begin() + n, distances.end());
+            vector<size_t> nearest;
+            for (size_t i = 0; i < n; ++i)
+                nearest.push_back(distances[i].second);
+            result.push_back(std::move(nearest));
+        }
+        return result;
+    }
+
+    // The total size of the database's files, after compacting it.
+    uint64_t databaseSize() {
+        CBLError error {};
+        CHECK(CBLDatabase_PerformMaintenance(db, kCBLMaintenanceTypeCompact, &error));
+        alloc_slice path = CBLDatabase_Path(db);
+        uint64_t size = 0;
+        for (auto &entry : filesystem::recursive_directory_iterator(string(path))) {
+            if (entry.is_regular_file())
+                size += entry.file_size();
+        }
+        return size;
+    }
+
+    // Runs a query, returning the doc IDs of the results as base vector indexes.
+    vector<size_t> search(CBLQuery* query, const vector<float> &target) {
+        auto array = MutableArray::newArray();
+        for (float f : target)
+            array.append(f);
+        auto params = MutableDict::newDict();
+        params["vector"_sl] = array;
+        CBLQuery_SetParameters(query, params);
+
+        CBLError error {};
+        auto results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        vector<size_t> ids;
+        while (CBLResultSet_Next(results)) {
+            slice docID = FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0));
+            ids.push_back(stoul(string(docID)));
+        }
+        CBLResultSet_Release(results);
+        return ids;
+    }
+
+    void run(const char *dataset, const Vectors &base, const Vectors &queries, vector<Config> configs) {
+        auto dimensions = (unsigned)base[0].size();
+        printf("---- %s: %zu vectors of %u dimensions, %zu queries\n",
+               dataset, base.size(), dimensions, queries.size());
+
+        Stopwatch importTime;
+        importVectors(base);
+        importTime.stop();
+        printf("Importing: %.3f ms\n", importTime.elapsedMS());
+
+        auto truth = bruteForce(base, queries, kK);
+        auto baseSize = databaseSize();
+
+        string sql = "SELECT meta().id FROM _ ORDER BY APPROX_VECTOR_DISTANCE(vector, $vector) LIMIT "
+                   + to_string(kK);
+
+        for (auto &config : configs) {
+            CBLVectorIndexConfiguration indexConfig { kCBLN1QLLanguage, "vector"_sl, dimensions,
+                                                      config.centroids };
+            indexConfig.encoding = config.encoding;
+            indexConfig.numProbes = config.numProbes;
+
+            CBLError error {};
+            Stopwatch createTime;
+            REQUIRE(CBLCollection_CreateVectorIndex(defaultCollection, "vectors"_sl, indexConfig, &error));
+            createTime.stop();
+            CBLVectorEncoding_Free(config.encoding);
+
+            CBLQuery* query = CBLDatabase_CreateQuery(db, kCBLN1QLLanguage, slice(sql), nullptr, &error);
+            REQUIRE(query);
+
+            // The first query brings the index up to date, training it:
+            Stopwatch trainTime;
+            search(query, queries[0]);
+            trainTime.stop();
+            bool trained = CBLCollection_IsIndexTrained(defaultCollection, "vectors"_sl, &error);
+
+            vector<double> latencies;
+            double recall = 0;
+            for (size_t q = 0; q < queries.size(); ++q) {
+                Stopwatch st;
+                auto found = search(query, queries[q]);
+                st.stop();
+                latencies.push_back(st.elapsedMS());
+                unordered_set<size_t> expected(truth[q].begin(), truth[q].end());
+                auto hits = count_if(found.begin(), found.end(), [&](size_t i) {return expected.count(i) > 0;});
+                recall += double(hits) / truth[q].size();
+            }
+            recall /= queries.size();
+            sort(latencies.begin(), latencies.end());
+            auto percentile = [&](double p) {
+                return latencies[min(latencies.size() - 1, size_t(p * latencies.size()))];
+            };
+            CBLQuery_Release(query);
+
+            auto indexSize = int64_t(databaseSize()) - int64_t(baseSize);
+            printf("%-8s centroids %5u, probes %3u: create %9.3f ms, %s %9.3f ms, "
+                   "size %8.1f KB; query p50 %7.3f ms, p99 %7.3f ms; recall@%u %.3f\n",
+                   config.name.c_str(), config.centroids, config.numProbes, createTime.elapsedMS(),
+                   (trained ? "train" : "untrained, first query"), trainTime.elapsedMS(), indexSize / 1024.0,
+                   percentile(0.5), percentile(0.99), kK, recall);
+
+            REQUIRE(CBLCollection_DeleteIndex(defaultCollection, "vectors"_sl, &error));
+        }
+    }
+
+    // Every encoding, with the recommended number of centroids and with the default and a
+    // larger number of probes.
+    static vector<Config> standardConfigs(size_t numVectors, unsigned dimensions) {
+        auto centroids = max(1u, unsigned(sqrt(double(numVectors))));
+        unsigned subquantizers = 16;
+        while (subquantizers > 2 && dimensions % subquantizers != 0)
+            --subquantizers;
+        vector<Config> configs;
+        for (unsigned probes : {0u, 32u}) {
+            configs.push_back({"None", CBLVectorEncoding_CreateNone(), centroids, probes});
+            configs.push_back({"SQ4", CBLVectorEncoding_CreateScalarQuantizer(kCBLSQ4), centroids, probes});
+            configs.push_back({"SQ6", CBLVectorEncoding_CreateScalarQuantizer(kCBLSQ6), centroids, probes});
+            configs.push_back({"SQ8", CBLVectorEncoding_CreateScalarQuantizer(kCBLSQ8), centroids, probes});
+            configs.push_back({"PQ" + to_string(subquantizers) + "x8",
+                               CBLVectorEncoding_CreateProductQuantizer(subquantizers, 8), centroids, probes});
+        }
+        return configs;
+    }
+};
+
+// Uses the vectors of the words in words_db, with a sample of them as the queries.
+TEST_CASE_METHOD(VectorSearchPerfTest, "Benchmark Vector Index Words", "[Perf][.slow][VectorSearch]") {
+    Vectors base;
+    for (const char *sql : {"SELECT vector FROM words", "SELECT vector FROM extwords"}) {
+        CBLError error {};
+        auto query = CBLDatabase_CreateQuery(wordDB, kCBLN1QLLanguage, slice(sql), nullptr, &error);
+        REQUIRE(query);
+        auto results = CBLQuery_Execute(query, &error);
+        REQUIRE(results);
+        while (CBLResultSet_Next(results)) {
+            Array array = FLValue_AsArray(CBLResultSet_ValueAtIndex(results, 0));
+            vector<float> v;
+            for (Array::iterator i(array); i; ++i)
+                v.push_back(i.value().asFloat());
+            if (!v.empty())
+                base.push_back(std::move(v));
+        }
+        CBLResultSet_Release(results);
+        CBLQuery_Release(query);
+    }
+    REQUIRE(!base.empty());
+
+    Vectors queries;
+    for (size_t i = 0; i < base.size(); i += 10)
+        queries.push_back(base[i]);
+
+    run("words", base, queries, standardConfigs(base.size(), (unsigned)base[0].size()));
+}
+
+// NOTE:
+// Download ftp://ftp.irisa.fr/local/texmex/corpus/siftsmall.tar.gz and copy
+// siftsmall_base.fvecs and siftsmall_query.fvecs to test/assets before building and running this test.
+TEST_CASE_METHOD(VectorSearchPerfTest, "Benchmark Vector Index SIFT", "[Perf][.slow][VectorSearch]") {
+    auto base = readFVecs("siftsmall_base.fvecs");
+    auto queries = readFVecs("siftsmall_query.fvecs");
+    REQUIRE(queries[0].size() == base[0].size());
+
+    run("siftsmall", base, queries, standardConfigs(base.size(), (unsigned)base[0].size()));
+}
+
+#endif
+
+#endif
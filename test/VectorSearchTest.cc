@@ -17,6 +17,11 @@
 //
 
 #include "VectorSearchTest.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
 
 #ifdef COUCHBASE_ENTERPRISE
 
@@ -405,6 +410,206 @@ TEST_CASE_METHOD(VectorSearchTest, "TestCreateVectorIndexUsingPredictionModel",
     CBLResultSet_Release(results);
 }
 
+TEST_CASE_METHOD(VectorSearchTest, "TestPrecomputePredictions", "[VectorSearch]") {
+    // A model that only predicts in batches, using the WordEmbedding model for each input:
+    struct BatchModel {
+        VectorSearchTest* test;
+        size_t batches = 0, inputs = 0, maxBatch = 0;
+    } batchModel {this};
+    
+    auto batchPrediction = [](void* context, const FLDict inputs[], size_t count, FLMutableDict outputs[]) {
+        auto m = (BatchModel*)context;
+        m->batches++;
+        m->inputs += count;
+        m->maxBatch = std::max(m->maxBatch, count);
+        for (size_t i = 0; i < count; ++i) {
+            auto word = fleece::Dict(inputs[i])["word"].asString();
+            if (!word) { continue; }
+            auto vector = m->test->vectorArrayForWord(word, kWordsCollectionName);
+            if (!vector) {
+                vector = m->test->vectorArrayForWord(word, kExtWordsCollectionName);
+            }
+            if (!vector) { continue; }
+            auto output = MutableDict(FLMutableDict_New());
+            output["vector"] = MutableArray(vector);
+            FLArray_Release(vector);
+            outputs[i] = output;
+        }
+    };
+    
+    CBLPredictiveModel model {};
+    model.context = &batchModel;
+    model.batchPrediction = batchPrediction;
+    model.batchSize = 64;
+    CBL_RegisterPredictiveModel("WordEmbeddingBatch"_sl, model);
+    
+    CBLError error {};
+    SECTION("Precompute") {
+        REQUIRE(CBL_PrecomputePredictions("WordEmbeddingBatch"_sl, wordsCollection, "{\"word\": word}"_sl, &error));
+        CHECK(batchModel.inputs == 300);
+        CHECK(batchModel.batches == 5);
+        CHECK(batchModel.maxBatch == 64);
+        
+        // Indexing uses the precomputed outputs:
+        auto expr = "prediction(WordEmbeddingBatch, {\"word\": word}).vector"_sl;
+        CBLVectorIndexConfiguration config { kCBLN1QLLanguage, expr, 300, 8 };
+        createWordsIndex(config);
+        
+        auto results = executeWordsQuery(350, expr.asString());
+        CHECK(CountResults(results) == 300);
+        CBLResultSet_Release(results);
+        CHECK(batchModel.inputs == 300);
+        
+        // So does every query calling the model, not only the first:
+        CBLQuery* query = CBLDatabase_CreateQuery(wordDB, kCBLN1QLLanguage,
+                                                  "SELECT prediction(WordEmbeddingBatch, {\"word\": word}) FROM words"_sl,
+                                                  nullptr, &error);
+        REQUIRE(query);
+        for (int i = 0; i < 2; ++i) {
+            results = CBLQuery_Execute(query, &error);
+            REQUIRE(results);
+            CHECK(CountResults(results) == 300);
+            CBLResultSet_Release(results);
+        }
+        CBLQuery_Release(query);
+        CHECK(batchModel.inputs == 300);
+        
+        // A new document's input is predicted by itself:
+        auto doc = CBLCollection_GetDocument(extwordsCollection, "word1"_sl, &error);
+        REQUIRE(doc);
+        copyDocument(wordsCollection, "word301", doc);
+        CBLDocument_Release(doc);
+        
+        results = executeWordsQuery(350, expr.asString());
+        CHECK(CountResults(results) == 301);
+        CBLResultSet_Release(results);
+        CHECK(batchModel.inputs == 301);
+        CHECK(batchModel.batches == 6);
+    }
+    
+    SECTION("Errors") {
+        ExpectingExceptions x;
+        CHECK(!CBL_PrecomputePredictions("NoSuchModel"_sl, wordsCollection, "{\"word\": word}"_sl, &error));
+        CheckError(error, kCBLErrorNotFound);
+        
+        CHECK(!CBL_PrecomputePredictions(kWordsPredictiveModelName, wordsCollection, "{\"word\": word}"_sl, &error));
+        CheckError(error, kCBLErrorUnsupported);
+        
+        CHECK(!CBL_PrecomputePredictions("WordEmbeddingBatch"_sl, wordsCollection, "{\"word\": "_sl, &error));
+        CheckError(error, kCBLErrorInvalidQuery);
+        CHECK(batchModel.batches == 0);
+    }
+    
+    CBL_UnregisterPredictiveModel("WordEmbeddingBatch"_sl);
+}
+
+TEST_CASE_METHOD(VectorSearchTest, "TestPredictionCache", "[VectorSearch]") {
+    struct CountingModel {
+        VectorSearchTest* test;
+        size_t calls = 0;
+    } countingModel {this};
+    
+    auto prediction = [](void* context, FLDict input) -> FLMutableDict {
+        auto m = (CountingModel*)context;
+        m->calls++;
+        auto word = fleece::Dict(input)["word"].asString();
+        auto vector = word ? m->test->vectorArrayForWord(word, kWordsCollectionName) : nullptr;
+        if (!vector) { return nullptr; }
+        auto output = MutableDict(FLMutableDict_New());
+        output["vector"] = MutableArray(vector);
+        FLArray_Release(vector);
+        return output;
+    };
+    
+    CBLPredictiveModel model {};
+    model.context = &countingModel;
+    model.prediction = prediction;
+    
+    size_t expectedCalls = 0;
+    SECTION("Cache") {
+        model.cacheSize = 10 * 1024 * 1024;
+        expectedCalls = 300;
+    }
+    SECTION("Cache Too Small") {
+        model.cacheSize = 1024;
+        expectedCalls = 600;
+    }
+    CBL_RegisterPredictiveModel("WordEmbeddingCached"_sl, model);
+    
+    auto expr = "prediction(WordEmbeddingCached, {\"word\": word}).vector"_sl;
+    CBLVectorIndexConfiguration config { kCBLN1QLLanguage, expr, 300, 8 };
+    auto reindex = [&] {
+        createWordsIndex(config);
+        auto results = executeWordsQuery(350, expr.asString());
+        CHECK(CountResults(results) == 300);
+        CBLResultSet_Release(results);
+        deleteWordsIndex();
+    };
+    
+    reindex();
+    CHECK(countingModel.calls == 300);
+    
+    // Rebuilding the index predicts only the inputs that aren't cached:
+    reindex();
+    CHECK(countingModel.calls == expectedCalls);
+    
+    // After clearing the cache every input is predicted again:
+    CHECK(CBL_ClearPredictionCache("WordEmbeddingCached"_sl));
+    reindex();
+    CHECK(countingModel.calls == expectedCalls + 300);
+    
+    CHECK(!CBL_ClearPredictionCache("NoSuchModel"_sl));
+    CBL_UnregisterPredictiveModel("WordEmbeddingCached"_sl);
+}
+
+TEST_CASE_METHOD(VectorSearchTest, "TestPredictionTimeout", "[VectorSearch]") {
+    static atomic<int> sCalls;
+    sCalls = 0;
+    auto prediction = [](void* context, FLDict input) -> FLMutableDict {
+        this_thread::sleep_for(chrono::milliseconds(300));
+        sCalls++;
+        auto output = MutableDict(FLMutableDict_New());
+        output["result"] = fleece::Dict(input)["word"];
+        return output;
+    };
+    
+    CBLPredictiveModel model {};
+    model.prediction = prediction;
+    model.timeout = 50;
+    CBL_RegisterPredictiveModel("SlowModel"_sl, model);
+    
+    CBLError error {};
+    auto query = CBLDatabase_CreateQuery(wordDB, kCBLN1QLLanguage,
+                                         "SELECT prediction(SlowModel, {\"word\": word}).result, word "
+                                         "FROM words WHERE meta().id = 'word1'"_sl, nullptr, &error);
+    REQUIRE(query);
+    
+    // The query doesn't wait for the model, so the prediction has no output:
+    auto start = chrono::steady_clock::now();
+    auto results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    CHECK(chrono::steady_clock::now() - start < chrono::milliseconds(300));
+    REQUIRE(CBLResultSet_Next(results));
+    CHECK(!CBLResultSet_ValueAtIndex(results, 0));
+    alloc_slice word = FLValue_AsString(CBLResultSet_ValueAtIndex(results, 1));
+    CBLResultSet_Release(results);
+    
+    // Once the model returns, its output is used:
+    for (int i = 0; i < 50 && sCalls == 0; ++i)
+        this_thread::sleep_for(chrono::milliseconds(20));
+    REQUIRE(sCalls == 1);
+    this_thread::sleep_for(chrono::milliseconds(50));      // Let the output be stored
+    results = CBLQuery_Execute(query, &error);
+    REQUIRE(results);
+    REQUIRE(CBLResultSet_Next(results));
+    CHECK(slice(FLValue_AsString(CBLResultSet_ValueAtIndex(results, 0))) == word);
+    CBLResultSet_Release(results);
+    CHECK(sCalls == 1);
+    
+    CBLQuery_Release(query);
+    CBL_UnregisterPredictiveModel("SlowModel"_sl);
+}
+
 /**
  * 9. TestCreateVectorIndexUsingPredictiveModelWithInvalidVectors
  * Description
@@ -1223,6 +1428,292 @@ TEST_CASE_METHOD(VectorSearchTest, "TestNumProbes", "[VectorSearch]") {
     CHECK(numResultsFor5Probes > numResultsFor1Probes);
 }
 
+/**
+ * TestAdviseVectorIndex
+ *
+ * Description
+ * Test that the vector index advisor samples the words collection and recommends a configuration
+ * that can be used to create the index, and that it rejects lazy indexes.
+ */
+TEST_CASE_METHOD(VectorSearchTest, "TestAdviseVectorIndex", "[VectorSearch]") {
+    CBLError error {};
+    CBLVectorIndexConfiguration config { kCBLN1QLLanguage, "vector"_sl, 300 };
+    CBLVectorIndexEstimate estimate {};
+    
+    SECTION("Default Options") {
+        REQUIRE(CBLCollection_AdviseVectorIndex(wordsCollection, &config, nullptr, &estimate, &error));
+        CHECK(config.encoding);
+        CHECK(config.centroids >= 1);
+        CHECK(config.numProbes >= 1);
+        CHECK(config.numProbes <= config.centroids);
+        CHECK(estimate.sampleSize > 10);
+        CHECK(estimate.memory > 0);
+        CHECK(estimate.recall >= 0.0);
+        CHECK(estimate.recall <= 1.0);
+        CHECK(estimate.meetsTargets == (estimate.recall >= 0.9));
+        
+        createWordsIndex(config);
+        CBLVectorEncoding_Free(config.encoding);
+        auto results = executeWordsQuery(20);
+        CHECK(CountResults(results) > 0);
+        CBLResultSet_Release(results);
+    }
+    
+    SECTION("Memory Budget") {
+        // Too small for any configuration, so the smallest is recommended:
+        CBLVectorIndexAdvisorOptions options {};
+        options.memoryBudget = 1;
+        REQUIRE(CBLCollection_AdviseVectorIndex(wordsCollection, &config, &options, &estimate, &error));
+        CHECK(!estimate.meetsTargets);
+        uint64_t smallest = estimate.memory;
+        CBLVectorEncoding_Free(config.encoding);
+        
+        options.memoryBudget = 0;
+        options.targetRecall = 1.0;
+        REQUIRE(CBLCollection_AdviseVectorIndex(wordsCollection, &config, &options, &estimate, &error));
+        CHECK(estimate.memory >= smallest);
+        CBLVectorEncoding_Free(config.encoding);
+    }
+    
+    SECTION("Lazy Index") {
+        config.expression = "word"_sl;
+        config.isLazy = true;
+        ExpectingExceptions x;
+        CHECK(!CBLCollection_AdviseVectorIndex(wordsCollection, &config, nullptr, &estimate, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+}
+
+/**
+ * TestFindNearestVectors
+ *
+ * Description
+ * Test that the exact vector search, which scans the small words collection without an index,
+ * returns the same nearest words and distances as a brute-force search in double precision,
+ * for every metric; and that it applies a WHERE condition.
+ */
+TEST_CASE_METHOD(VectorSearchTest, "TestFindNearestVectors", "[VectorSearch]") {
+    CBLError error {};
+    vector<float> dinner;
+    {
+        FLError flError;
+        FLMutableArray array = FLMutableArray_NewFromJSON(kDinnerVector, &flError);
+        REQUIRE(array);
+        for (Array::iterator i(array); i; ++i)
+            dinner.push_back(i.value().asFloat());
+        FLMutableArray_Release(array);
+    }
+    REQUIRE(dinner.size() == 300);
+    
+    CBLVectorSearch search {};
+    search.expressionLanguage = kCBLN1QLLanguage;
+    search.expression = "vector"_sl;
+    search.limit = 20;
+    
+    SECTION("Exact Distances") {
+        // Brute force, in double precision:
+        auto query = CBLDatabase_CreateQuery(wordDB, kCBLN1QLLanguage,
+                                             "SELECT meta().id, vector FROM _default.words"_sl,
+                                             nullptr, &error);
+        REQUIRE(query);
+        vector<pair<string, vector<double>>> words;
+        auto rs = CBLQuery_Execute(query, &error);
+        REQUIRE(rs);
+        while (CBLResultSet_Next(rs)) {
+            Array array(FLValue_AsArray(CBLResultSet_ValueAtIndex(rs, 1)));
+            if (array.count() != 300)
+                continue;
+            vector<double> v;
+            for (Array::iterator i(array); i; ++i)
+                v.push_back(i.value().asDouble());
+            words.emplace_back(slice(FLValue_AsString(CBLResultSet_ValueAtIndex(rs, 0))).asString(), v);
+        }
+        CBLResultSet_Release(rs);
+        CBLQuery_Release(query);
+        
+        for (auto metric : {kCBLDistanceMetricEuclideanSquared, kCBLDistanceMetricEuclidean,
+                            kCBLDistanceMetricCosine, kCBLDistanceMetricDot}) {
+            vector<pair<double, string>> expected;
+            for (auto &[id, v] : words) {
+                double ab = 0, aa = 0, bb = 0, l2 = 0;
+                for (size_t i = 0; i < 300; ++i) {
+                    ab += dinner[i] * v[i];
+                    aa += double(dinner[i]) * dinner[i];
+                    bb += v[i] * v[i];
+                    l2 += (dinner[i] - v[i]) * (dinner[i] - v[i]);
+                }
+                double d;
+                switch (metric) {
+                    case kCBLDistanceMetricEuclidean:   d = sqrt(l2); break;
+                    case kCBLDistanceMetricCosine:      d = 1.0 - ab / (sqrt(aa) * sqrt(bb)); break;
+                    case kCBLDistanceMetricDot:         d = -ab; break;
+                    default:                            d = l2; break;
+                }
+                expected.emplace_back(d, id);
+            }
+            sort(expected.begin(), expected.end());
+            
+            search.metric = metric;
+            FLMutableArray nearest = CBLCollection_FindNearestVectors(wordsCollection, &search,
+                                                                      dinner.data(), 300, &error);
+            REQUIRE(nearest);
+            Array results(nearest);
+            REQUIRE(results.count() == 20);
+            for (uint32_t i = 0; i < 20; ++i) {
+                Dict result = results[i].asDict();
+                CHECK(result["id"].asString() == slice(expected[i].second));
+                CHECK(result["distance"].asDouble() == Approx(expected[i].first).margin(1e-4));
+            }
+            FLMutableArray_Release(nearest);
+        }
+    }
+    
+    SECTION("WHERE Condition") {
+        // There are 50 words in catid=1:
+        search.limit = 300;
+        search.where = "catid = 'cat1'"_sl;
+        FLMutableArray nearest = CBLCollection_FindNearestVectors(wordsCollection, &search,
+                                                                  dinner.data(), 300, &error);
+        REQUIRE(nearest);
+        Array results(nearest);
+        CHECK(results.count() == 50);
+        double last = -1;
+        for (Array::iterator i(results); i; ++i) {
+            double distance = i.value().asDict()["distance"].asDouble();
+            CHECK(distance >= last);
+            last = distance;
+        }
+        FLMutableArray_Release(nearest);
+    }
+    
+    SECTION("Invalid Parameters") {
+        ExpectingExceptions x;
+        CHECK(!CBLCollection_FindNearestVectors(wordsCollection, &search, dinner.data(), 1, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+        
+        search.limit = 0;
+        CHECK(!CBLCollection_FindNearestVectors(wordsCollection, &search, dinner.data(), 300, &error));
+        CheckError(error, kCBLErrorInvalidParameter);
+    }
+}
+
+/**
+ * TestFindNearestVectorsPerformance
+ *
+ * Description
+ * Test that on a collection as small as the words collection, the exact vector search is faster
+ * than creating a vector index and querying it. It measures wall-clock time, so it's a perf test
+ * and doesn't run by default.
+ */
+TEST_CASE_METHOD(VectorSearchTest, "TestFindNearestVectorsPerformance", "[VectorSearch][Perf][.slow]") {
+    CBLError error {};
+    vector<float> dinner;
+    {
+        FLError flError;
+        FLMutableArray array = FLMutableArray_NewFromJSON(kDinnerVector, &flError);
+        REQUIRE(array);
+        for (Array::iterator i(array); i; ++i)
+            dinner.push_back(i.value().asFloat());
+        FLMutableArray_Release(array);
+    }
+    
+    CBLVectorSearch search {};
+    search.expressionLanguage = kCBLN1QLLanguage;
+    search.expression = "vector"_sl;
+    search.limit = 20;
+    
+    auto start = chrono::steady_clock::now();
+    FLMutableArray nearest = CBLCollection_FindNearestVectors(wordsCollection, &search,
+                                                              dinner.data(), 300, &error);
+    auto scanTime = chrono::steady_clock::now() - start;
+    REQUIRE(nearest);
+    CHECK(Array(nearest).count() == 20);
+    FLMutableArray_Release(nearest);
+    
+    start = chrono::steady_clock::now();
+    CBLVectorIndexConfiguration config { kCBLN1QLLanguage, "vector"_sl, 300, 8 };
+    createWordsIndex(config);
+    auto results = executeWordsQuery(20);
+    auto indexTime = chrono::steady_clock::now() - start;
+    CHECK(CountResults(results) == 20);
+    CBLResultSet_Release(results);
+    
+    WARN("Exact search: " << chrono::duration<double, milli>(scanTime).count() << "ms; "
+         << "creating and querying an index: " << chrono::duration<double, milli>(indexTime).count() << "ms");
+    CHECK(scanTime < indexTime);
+}
+
+/**
+ * TestHybridVectorSearchPlan
+ *
+ * Description
+ * Test that a vector search with a WHERE condition pre-filters when few documents match, and
+ * post-filters through the vector index, fetching enough rows for the condition's selectivity,
+ * when more than maxScanCount match; either way every result matches the condition.
+ */
+TEST_CASE_METHOD(VectorSearchTest, "TestHybridVectorSearchPlan", "[VectorSearch]") {
+    CBLError error {};
+    vector<float> dinner;
+    {
+        FLError flError;
+        FLMutableArray array = FLMutableArray_NewFromJSON(kDinnerVector, &flError);
+        REQUIRE(array);
+        for (Array::iterator i(array); i; ++i)
+            dinner.push_back(i.value().asFloat());
+        FLMutableArray_Release(array);
+    }
+    
+    // There are 50 words in catid=1:
+    CBLVectorSearch search {};
+    search.expressionLanguage = kCBLN1QLLanguage;
+    search.expression = "vector"_sl;
+    search.where = "catid = 'cat1'"_sl;
+    search.limit = 20;
+    
+    auto explain = [&] {
+        FLSliceResult plan = CBLCollection_ExplainVectorSearch(wordsCollection, &search, &error);
+        REQUIRE(plan.buf);
+        string str = slice(plan).asString();
+        FLSliceResult_Release(plan);
+        return str;
+    };
+    
+    auto checkResults = [&] {
+        FLMutableArray nearest = CBLCollection_FindNearestVectors(wordsCollection, &search,
+                                                                  dinner.data(), 300, &error);
+        REQUIRE(nearest);
+        Array results(nearest);
+        CHECK(results.count() == 20);
+        for (Array::iterator i(results); i; ++i) {
+            auto doc = CBLCollection_GetDocument(wordsCollection, i.value().asDict()["id"].asString(), &error);
+            REQUIRE(doc);
+            CHECK(Dict(CBLDocument_Properties(doc))["catid"].asString() == "cat1"_sl);
+            CBLDocument_Release(doc);
+        }
+        FLMutableArray_Release(nearest);
+    };
+    
+    SECTION("Pre-filter") {
+        CHECK(explain() == "exact scan, pre-filter: 50 of 300 documents (selectivity 0.167)");
+        checkResults();
+    }
+    
+    SECTION("Post-filter") {
+        CBLVectorIndexConfiguration config { kCBLN1QLLanguage, "vector"_sl, 300, 8 };
+        createWordsIndex(config);
+        search.maxScanCount = 10;
+        // 20 / (50 / 300) * 1.5 = 180:
+        CHECK(explain() == "vector index, post-filter: fetch 180 of 300 documents (selectivity 0.167)");
+        checkResults();
+    }
+    
+    SECTION("No Index") {
+        search.maxScanCount = 10;
+        CHECK(explain() == "exact scan, pre-filter: 50 of 300 documents (selectivity 0.167)");
+        checkResults();
+    }
+}
+
 #endif
 
 #endif
@@ -143,4 +143,29 @@ TEST_CASE_METHOD(VectorSearchTest_Cpp, "Lazy Vector Index Sanity C++", "[VectorS
     CBLResultSet_Release(results);
 }
 
+TEST_CASE_METHOD(VectorSearchTest_Cpp, "Lazy Vector Index Bulk Update C++", "[VectorSearchCpp]") {
+    VectorIndexConfiguration config = { kCBLN1QLLanguage, "word"_sl, 300, 8};
+    config.isLazy = true;
+    _wordsColl.createVectorIndex(kWordsIndexName, config);
+    
+    IndexUpdater updater = _wordsColl.getIndex(kWordsIndexName).beginUpdate(10);
+    REQUIRE(updater);
+    REQUIRE(updater.count() == 10);
+    
+    vector<float> vectors;
+    for (size_t i = 0; i < updater.count(); i++) {
+        auto vector = vectorForWord(updater.value(i).asString());
+        REQUIRE(vector.size() == 300);
+        vectors.insert(vectors.end(), vector.begin(), vector.end());
+    }
+    CHECK_THROWS_AS(updater.setVectors(std::span(vectors).first(299), 300), std::invalid_argument);
+    updater.setVectors(std::span(vectors).first(5 * 300), 300);
+    updater.setVectors(std::span(vectors).subspan(5 * 300), 300, 5);
+    updater.finish();
+    
+    auto results = executeWordsQuery(300, "word");
+    CHECK(CountResults(results) == 10);
+    CBLResultSet_Release(results);
+}
+
 #endif
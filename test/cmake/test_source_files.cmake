@@ -26,15 +26,18 @@ function(set_test_source_files)
         ${T_DIR}/DocumentTest_Cpp.cc
         ${T_DIR}/LogTest.cc
         ${T_DIR}/PerfTest.cc
+        ${T_DIR}/QueryPerfTest.cc
         ${T_DIR}/QueryTest.cc
         ${T_DIR}/QueryTest_Cpp.cc
         ${T_DIR}/ReplicatorCollectionTest.cc
         ${T_DIR}/ReplicatorCollectionTest_Cpp.cc
         ${T_DIR}/ReplicatorEETest.cc
+        ${T_DIR}/ReplicatorPerfTest.cc
         ${T_DIR}/ReplicatorPropEncTest.cc
         ${T_DIR}/ReplicatorTest.cc
         ${T_DIR}/VectorSearchTest.cc
         ${T_DIR}/VectorSearchTest_Cpp.cc
+        ${T_DIR}/VectorSearchPerfTest.cc
         ${T_DIR}/LazyVectorIndexTest.cc
         ${T_DIR}/../vendor/couchbase-lite-core/vendor/fleece/Fleece/Support/Backtrace.cc
         ${T_DIR}/../vendor/couchbase-lite-core/vendor/fleece/Fleece/Support/LibC++Debug.cc